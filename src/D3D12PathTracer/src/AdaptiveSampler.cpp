@@ -0,0 +1,92 @@
+#include "AdaptiveSampler.h"
+#include "shaders/AdaptiveHlslCompat.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+void AdaptiveSampler::Resize(unsigned int width, unsigned int height, unsigned int tileSize)
+{
+  if (tileSize == 0)
+  {
+    throw std::invalid_argument("AdaptiveSampler: tile size must not be zero");
+  }
+
+  m_width = width;
+  m_height = height;
+  m_tileSize = tileSize;
+  m_tilesX = (width + tileSize - 1) / tileSize;
+  m_tilesY = (height + tileSize - 1) / tileSize;
+
+  Reset();
+}
+
+void AdaptiveSampler::Reset()
+{
+  const unsigned int tileCount = GetTileCount();
+
+  m_converged.assign(tileCount, false);
+  m_activeTiles.resize(tileCount);
+  for (unsigned int i = 0; i < tileCount; i++)
+  {
+    m_activeTiles[i] = i;
+  }
+}
+
+unsigned int AdaptiveSampler::ApplyTileErrors(const float* tileErrors, std::size_t tileCount)
+{
+  if (tileCount != GetTileCount())
+  {
+    //stale readback from before a resize, ignore it
+    return 0;
+  }
+
+  unsigned int retired = 0;
+  for (auto tile : m_activeTiles)
+  {
+    if (tileErrors[tile] <= m_threshold)
+    {
+      m_converged[tile] = true;
+      retired++;
+    }
+  }
+
+  if (retired > 0)
+  {
+    m_activeTiles.erase(std::remove_if(m_activeTiles.begin(), m_activeTiles.end(),
+      [&](std::uint32_t tile) { return m_converged[tile]; }), m_activeTiles.end());
+  }
+
+  return retired;
+}
+
+float AdaptiveSampler::ComputePixelError(const float sum[3], const float sumSquared[3], float sampleCount, unsigned int minSamples)
+{
+  if (sampleCount < static_cast<float>(minSamples) || sampleCount <= 0.0f)
+  {
+    return ADAPTIVE_UNCONVERGED_ERROR;
+  }
+
+  float error = 0.0f;
+  for (int c = 0; c < 3; c++)
+  {
+    error = std::max(error, Adaptive::ComputeRelativeError(sum[c], sumSquared[c], sampleCount));
+  }
+  return error;
+}
+
+void AdaptiveSampler::ComputeTileErrors(const float* accumulation, const float* moments, std::vector<float>& tileErrors) const
+{
+  tileErrors.assign(GetTileCount(), 0.0f);
+
+  for (unsigned int y = 0; y < m_height; y++)
+  {
+    for (unsigned int x = 0; x < m_width; x++)
+    {
+      const std::size_t pixel = (static_cast<std::size_t>(y) * m_width + x) * 4;
+      const float error = ComputePixelError(&accumulation[pixel], &moments[pixel], accumulation[pixel + 3], m_minSamples);
+
+      const unsigned int tile = (x / m_tileSize) + (y / m_tileSize) * m_tilesX;
+      tileErrors[tile] = std::max(tileErrors[tile], error);
+    }
+  }
+}
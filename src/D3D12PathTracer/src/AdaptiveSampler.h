@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//
+// AdaptiveSampler - CPU side of adaptive sampling.
+//
+// The image is split into square tiles. The raygen shader accumulates the first and
+// second moment of every pixel and writes the worst relative error of each dispatched
+// tile into a small buffer that is read back a few frames later. Tiles whose error
+// drops under the threshold are retired from the work list and are not dispatched
+// again until the accumulation is reset.
+//
+// ComputePixelError/ComputeTileErrors are the CPU reference of the shader math,
+// both go through ComputeRelativeError in AdaptiveHlslCompat.h. Only depends on the
+// standard library, cpurender --adaptive-report checks it against the GPU's layout.
+//
+class AdaptiveSampler
+{
+public:
+  AdaptiveSampler() = default;
+
+  // Rebuild the tile grid for a width x height image, every tile becomes active.
+  void Resize(unsigned int width, unsigned int height, unsigned int tileSize);
+
+  // Start over, every tile becomes active again (camera moved, scene changed...).
+  void Reset();
+
+  void SetThreshold(float threshold) { m_threshold = threshold; }
+  void SetMinSamples(unsigned int minSamples) { m_minSamples = minSamples; }
+  float GetThreshold() const { return m_threshold; }
+  unsigned int GetMinSamples() const { return m_minSamples; }
+
+  unsigned int GetWidth() const { return m_width; }
+  unsigned int GetHeight() const { return m_height; }
+  unsigned int GetTileSize() const { return m_tileSize; }
+  unsigned int GetTilesX() const { return m_tilesX; }
+  unsigned int GetTilesY() const { return m_tilesY; }
+  unsigned int GetTileCount() const { return m_tilesX * m_tilesY; }
+  unsigned int GetConvergedTileCount() const { return GetTileCount() - static_cast<unsigned int>(m_activeTiles.size()); }
+
+  // Tile indices (x + y * tilesX) that still need samples, in ascending order.
+  const std::vector<std::uint32_t>& GetActiveTiles() const { return m_activeTiles; }
+
+  // Feed back the per tile error measured on the GPU, one float per tile.
+  // Active tiles under the threshold are retired, returns how many were retired.
+  unsigned int ApplyTileErrors(const float* tileErrors, std::size_t tileCount);
+
+  // Relative error of one pixel given the running sums of radiance and radiance squared.
+  // Pixels that have fewer than minSamples samples never count as converged.
+  static float ComputePixelError(const float sum[3], const float sumSquared[3], float sampleCount, unsigned int minSamples);
+
+  // CPU reference of the tile error buffer. accumulation holds rgb sums and the sample
+  // count in w, moments holds the rgb sums of squares, both width x height RGBA32F.
+  void ComputeTileErrors(const float* accumulation, const float* moments, std::vector<float>& tileErrors) const;
+
+private:
+  unsigned int m_width = 0;
+  unsigned int m_height = 0;
+  unsigned int m_tileSize = 16;
+  unsigned int m_tilesX = 0;
+  unsigned int m_tilesY = 0;
+
+  float m_threshold = 0.05f;
+  unsigned int m_minSamples = 32;
+
+  std::vector<std::uint32_t> m_activeTiles;
+  std::vector<bool> m_converged;
+};
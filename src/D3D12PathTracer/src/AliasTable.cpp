@@ -0,0 +1,73 @@
+#include "AliasTable.h"
+
+#include <algorithm>
+
+namespace AliasTable {
+
+void Build(const std::vector<float>& weights, std::vector<float>& probabilities, std::vector<std::uint32_t>& aliases)
+{
+  const std::size_t count = weights.size();
+  probabilities.assign(count, 1.0f);
+  aliases.resize(count);
+  for (std::size_t i = 0; i < count; i++)
+  {
+    aliases[i] = static_cast<std::uint32_t>(i);
+  }
+
+  double total = 0.0;
+  std::uint32_t heaviest = 0;
+  for (std::size_t i = 0; i < count; i++)
+  {
+    total += std::max(weights[i], 0.0f);
+    if (weights[i] > weights[heaviest])
+    {
+      heaviest = static_cast<std::uint32_t>(i);
+    }
+  }
+
+  if (total <= 0.0)
+  {
+    return;
+  }
+
+  //scale so the average bucket holds exactly 1
+  std::vector<double> scaled(count);
+  std::vector<std::uint32_t> small;
+  std::vector<std::uint32_t> large;
+  for (std::size_t i = 0; i < count; i++)
+  {
+    scaled[i] = std::max(weights[i], 0.0f) * count / total;
+    (scaled[i] < 1.0 ? small : large).push_back(static_cast<std::uint32_t>(i));
+  }
+
+  //fill every small bucket up with a piece of a large one
+  while (!small.empty() && !large.empty())
+  {
+    const std::uint32_t s = small.back();
+    small.pop_back();
+    const std::uint32_t l = large.back();
+
+    probabilities[s] = static_cast<float>(scaled[s]);
+    aliases[s] = l;
+
+    scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+    if (scaled[l] < 1.0)
+    {
+      large.pop_back();
+      small.push_back(l);
+    }
+  }
+
+  //whatever is left is 1 up to rounding, except weights that were zero to begin with
+  for (auto l : large)
+  {
+    probabilities[l] = 1.0f;
+  }
+  for (auto s : small)
+  {
+    probabilities[s] = weights[s] > 0.0f ? 1.0f : 0.0f;
+    aliases[s] = weights[s] > 0.0f ? s : heaviest;
+  }
+}
+
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+//
+// AliasTable - Vose's alias method, O(1) sampling of a discrete distribution.
+//
+// Shared by the light list the shader samples and the CPU reference, so it
+// only depends on the standard library.
+//
+namespace AliasTable {
+
+// probabilities[i] is the chance of keeping i once bucket i is picked, aliases[i] is
+// taken otherwise. Zero weights are never picked. All weights zero gives a uniform table.
+void Build(const std::vector<float>& weights, std::vector<float>& probabilities, std::vector<std::uint32_t>& aliases);
+
+// Picks a bucket with one uniform number u in [0, 1), same walk as SampleLightIndex in Raytracing.hlsl.
+inline std::uint32_t Sample(float u, const float* probabilities, const std::uint32_t* aliases, std::uint32_t count)
+{
+  const float scaled = u * static_cast<float>(count);
+  std::uint32_t index = static_cast<std::uint32_t>(scaled);
+  index = index < count - 1 ? index : count - 1;
+  return (scaled - static_cast<float>(index)) < probabilities[index] ? index : aliases[index];
+}
+
+}
@@ -0,0 +1,291 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "json.hpp"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <direct.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+namespace Benchmark {
+
+namespace {
+
+using Json = nlohmann::json;
+
+std::string ToHex(std::uint64_t value)
+{
+  char text[17];
+  std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(value));
+  return text;
+}
+
+bool EndsWith(const std::string& text, const std::string& suffix)
+{
+  return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Scene paths hold commas rarely but may, CSV quotes those.
+std::string CsvField(const std::string& text)
+{
+  if (text.find_first_of(",\"\n") == std::string::npos)
+  {
+    return text;
+  }
+  std::string quoted = "\"";
+  for (char c : text)
+  {
+    quoted += c == '"' ? std::string("\"\"") : std::string(1, c);
+  }
+  return quoted + "\"";
+}
+
+}
+
+void SceneResult::Add(const std::string& phase, double milliseconds)
+{
+  for (Phase& existing : phases)
+  {
+    if (existing.name == phase)
+    {
+      existing.milliseconds.push_back(milliseconds);
+      return;
+    }
+  }
+  phases.push_back({ phase, { milliseconds } });
+}
+
+const Phase* SceneResult::Find(const std::string& phase) const
+{
+  for (const Phase& existing : phases)
+  {
+    if (existing.name == phase)
+    {
+      return &existing;
+    }
+  }
+  return nullptr;
+}
+
+Summary Summarize(const std::vector<double>& values)
+{
+  Summary summary;
+  if (values.empty())
+  {
+    return summary;
+  }
+
+  std::vector<double> sorted = values;
+  std::sort(sorted.begin(), sorted.end());
+  const std::size_t n = sorted.size();
+  summary.median = n % 2 == 1 ? sorted[n / 2] : 0.5 * (sorted[n / 2 - 1] + sorted[n / 2]);
+  summary.minimum = sorted.front();
+  summary.maximum = sorted.back();
+
+  double sum = 0.0;
+  for (double value : sorted)
+  {
+    sum += value;
+  }
+  summary.mean = sum / n;
+  if (n > 1)
+  {
+    double squares = 0.0;
+    for (double value : sorted)
+    {
+      squares += (value - summary.mean) * (value - summary.mean);
+    }
+    summary.variance = squares / (n - 1);
+  }
+  return summary;
+}
+
+std::string ToJson(const Report& report)
+{
+  Json scenes = Json::array();
+  for (const SceneResult& scene : report.scenes)
+  {
+    Json phases = Json::array();
+    for (const Phase& phase : scene.phases)
+    {
+      const Summary summary = Summarize(phase.milliseconds);
+      phases.push_back({ { "name", phase.name }, { "median_ms", summary.median }, { "mean_ms", summary.mean }, { "variance", summary.variance },
+                         { "min_ms", summary.minimum }, { "max_ms", summary.maximum }, { "runs_ms", phase.milliseconds } });
+    }
+    scenes.push_back({ { "scene", scene.scene }, { "triangles", scene.triangles }, { "image_hash", ToHex(scene.image_hash) }, { "phases", phases } });
+  }
+  const Json json = { { "settings", report.settings }, { "runs", report.runs }, { "scenes", scenes } };
+  return json.dump(2) + "\n";
+}
+
+std::string ToCsv(const Report& report)
+{
+  std::ostringstream csv;
+  csv << "scene,phase,runs,median_ms,mean_ms,variance,min_ms,max_ms\n";
+  char numbers[160];
+  for (const SceneResult& scene : report.scenes)
+  {
+    for (const Phase& phase : scene.phases)
+    {
+      const Summary summary = Summarize(phase.milliseconds);
+      std::snprintf(numbers, sizeof(numbers), "%zu,%.4f,%.4f,%.6f,%.4f,%.4f", phase.milliseconds.size(), summary.median, summary.mean, summary.variance,
+                    summary.minimum, summary.maximum);
+      csv << CsvField(scene.scene) << ',' << CsvField(phase.name) << ',' << numbers << '\n';
+    }
+  }
+  return csv.str();
+}
+
+bool Write(const std::string& path, const Report& report, std::string& error)
+{
+  std::ofstream file(path, std::ios::binary);
+  if (!file)
+  {
+    error = "cannot write " + path;
+    return false;
+  }
+  file << (EndsWith(path, ".csv") ? ToCsv(report) : ToJson(report));
+  if (!file)
+  {
+    error = "cannot write " + path;
+    return false;
+  }
+  return true;
+}
+
+bool ReadJson(const std::string& path, Report& report, std::string& error)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+  {
+    error = "cannot open " + path;
+    return false;
+  }
+
+  report = Report();
+  try
+  {
+    const Json json = Json::parse(file);
+    report.settings = json.at("settings").get<std::string>();
+    report.runs = json.at("runs").get<unsigned int>();
+    for (const Json& scene : json.at("scenes"))
+    {
+      SceneResult result;
+      result.scene = scene.at("scene").get<std::string>();
+      result.triangles = scene.at("triangles").get<std::uint64_t>();
+      result.image_hash = std::stoull(scene.at("image_hash").get<std::string>(), nullptr, 16);
+      for (const Json& phase : scene.at("phases"))
+      {
+        result.phases.push_back({ phase.at("name").get<std::string>(), phase.at("runs_ms").get<std::vector<double>>() });
+      }
+      report.scenes.push_back(std::move(result));
+    }
+  }
+  catch (const std::exception& e)
+  {
+    error = path + ": " + e.what();
+    return false;
+  }
+  return true;
+}
+
+Comparison Compare(const Report& report, const Report& baseline, double thresholdPercent, double minimumMilliseconds)
+{
+  Comparison comparison;
+  comparison.settings_differ = report.settings != baseline.settings;
+
+  for (const SceneResult& before : baseline.scenes)
+  {
+    auto it = std::find_if(report.scenes.begin(), report.scenes.end(), [&](const SceneResult& scene) { return scene.scene == before.scene; });
+    if (it == report.scenes.end())
+    {
+      comparison.missing.push_back(before.scene);
+      continue;
+    }
+    if (it->image_hash != before.image_hash)
+    {
+      comparison.changed_images.push_back(before.scene);
+    }
+
+    for (const Phase& phaseBefore : before.phases)
+    {
+      const Phase* phase = it->Find(phaseBefore.name);
+      if (phase == nullptr)
+      {
+        comparison.missing.push_back(before.scene + " " + phaseBefore.name);
+        continue;
+      }
+      const double baselineMedian = Summarize(phaseBefore.milliseconds).median;
+      const double median = Summarize(phase->milliseconds).median;
+      const double change = baselineMedian > 0.0 ? 100.0 * (median - baselineMedian) / baselineMedian : 0.0;
+      if (change > thresholdPercent && median - baselineMedian > minimumMilliseconds)
+      {
+        comparison.regressions.push_back({ before.scene, phaseBefore.name, baselineMedian, median, change });
+      }
+    }
+  }
+  return comparison;
+}
+
+std::vector<std::string> ListFiles(const std::string& directory, const std::string& extension)
+{
+  std::vector<std::string> names;
+#ifdef _WIN32
+  WIN32_FIND_DATAA found;
+  HANDLE find = FindFirstFileA((directory + "/*" + extension).c_str(), &found);
+  if (find != INVALID_HANDLE_VALUE)
+  {
+    do
+    {
+      if (!(found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && EndsWith(found.cFileName, extension))
+      {
+        names.push_back(found.cFileName);
+      }
+    } while (FindNextFileA(find, &found));
+    FindClose(find);
+  }
+#else
+  if (DIR* dir = opendir(directory.c_str()))
+  {
+    while (dirent* entry = readdir(dir))
+    {
+      const std::string name = entry->d_name;
+      if (entry->d_type != DT_DIR && EndsWith(name, extension))
+      {
+        names.push_back(name);
+      }
+    }
+    closedir(dir);
+  }
+#endif
+
+  std::sort(names.begin(), names.end());
+  for (std::string& name : names)
+  {
+    name = directory + "/" + name;
+  }
+  return names;
+}
+
+void MakeDirectory(const std::string& directory)
+{
+#ifdef _WIN32
+  _mkdir(directory.c_str());
+#else
+  mkdir(directory.c_str(), 0755);
+#endif
+}
+
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//
+// Benchmark - the numbers of cpurender --benchmark: phase timings of repeated runs over
+// a set of scenes, their medians and spread, JSON and CSV output, and the comparison
+// with a stored baseline that turns a slowdown into a failing exit code.
+//
+// A run is reproducible when everything it depends on is fixed: the scene file with
+// its camera, the image size, samples, depth, features and sampler, which together
+// are every input of ComputeRngSeed. Settings carries them into the report, Compare
+// only compares reports with the same settings. image_hash covers the accumulated
+// image bit for bit, every pixel is summed by one thread in sample order, so the same
+// settings give the same hash on any thread count, and a changed hash means the
+// renderer does different work rather than the same work slower.
+//
+// Only depends on the standard library (and json.hpp), cpurender --benchmark-report
+// checks it.
+//
+namespace Benchmark {
+
+struct Phase
+{
+  std::string name;
+  std::vector<double> milliseconds; // one per run
+};
+
+struct SceneResult
+{
+  std::string scene;
+  std::uint64_t triangles = 0;
+  std::uint64_t image_hash = 0;
+  std::vector<Phase> phases;
+
+  // Adds one run's time of the phase, phases keep the order they were first added in.
+  void Add(const std::string& phase, double milliseconds);
+  const Phase* Find(const std::string& phase) const;
+};
+
+struct Report
+{
+  std::string settings; // what the runs depended on, compared as a whole
+  unsigned int runs = 0;
+  std::vector<SceneResult> scenes;
+};
+
+struct Summary
+{
+  double median = 0.0;
+  double mean = 0.0;
+  double variance = 0.0; // of the sample, over runs - 1
+  double minimum = 0.0;
+  double maximum = 0.0;
+};
+
+Summary Summarize(const std::vector<double>& values);
+
+// Every phase of every scene with its summary, and the runs themselves in JSON.
+std::string ToJson(const Report& report);
+// One row per scene and phase: scene,phase,runs,median_ms,mean_ms,variance,min_ms,max_ms.
+std::string ToCsv(const Report& report);
+// Picks the format from the extension, .csv or else JSON.
+bool Write(const std::string& path, const Report& report, std::string& error);
+// Reads what ToJson wrote, the runs of every phase come back.
+bool ReadJson(const std::string& path, Report& report, std::string& error);
+
+struct Regression
+{
+  std::string scene;
+  std::string phase;
+  double baseline_median = 0.0;
+  double median = 0.0;
+  double change_percent = 0.0;
+};
+
+struct Comparison
+{
+  std::vector<Regression> regressions;   // slower by more than the threshold
+  std::vector<std::string> changed_images; // scenes whose image_hash differs
+  std::vector<std::string> missing;      // scenes or phases the baseline has and the report lacks
+  bool settings_differ = false;
+};
+
+// A phase regressed when its median is more than thresholdPercent and more than
+// minimumMilliseconds above the baseline's, the second keeps phases that take next to
+// no time from failing on timer noise.
+Comparison Compare(const Report& report, const Report& baseline, double thresholdPercent, double minimumMilliseconds);
+
+// Files in directory ending in extension, sorted, joined to the directory.
+std::vector<std::string> ListFiles(const std::string& directory, const std::string& extension);
+// Creates directory unless it exists, its parent has to.
+void MakeDirectory(const std::string& directory);
+
+}
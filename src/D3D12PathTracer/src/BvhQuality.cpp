@@ -0,0 +1,406 @@
+#include "BvhQuality.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace BvhQuality {
+
+namespace {
+
+// The layout of RayTracingHlslCompat.h and RayTracingHelper.hlsli of the fallback layer.
+const std::size_t c_headerBytes = 16;    // BVHOffsets
+const std::size_t c_nodeBytes = 32;      // AABBNode
+const std::size_t c_primitiveBytes = 40; // Primitive, its type and then a Triangle or an AABB
+const std::size_t c_instanceBytes = 116; // BVHMetadata
+const std::uint32_t c_isLeaf = 0x80000000u;
+const std::uint32_t c_isProcedural = 0x40000000u;
+const std::uint32_t c_leftNodeMask = 0x00ffffffu;
+const std::uint32_t c_triangleType = 1;
+const std::uint32_t c_proceduralType = 2;
+
+// Enough for a quad clipped by the six planes of a box, each adds a corner at most.
+const int c_maxCorners = 16;
+
+template <typename T>
+T Read(const unsigned char* bytes, std::size_t offset)
+{
+  T value;
+  std::memcpy(&value, bytes + offset, sizeof(T));
+  return value;
+}
+
+glm::vec3 ReadVec3(const unsigned char* bytes, std::size_t offset)
+{
+  return glm::vec3(Read<float>(bytes, offset), Read<float>(bytes, offset + 4), Read<float>(bytes, offset + 8));
+}
+
+double SurfaceArea(const glm::vec3& min, const glm::vec3& max)
+{
+  const glm::dvec3 e = glm::max(glm::dvec3(max) - glm::dvec3(min), glm::dvec3(0.0));
+  return 2.0 * (e.x * e.y + e.y * e.z + e.z * e.x);
+}
+
+double PolygonArea(const glm::vec3* corners, int count)
+{
+  glm::dvec3 sum(0.0);
+  for (int i = 1; i + 1 < count; i++)
+  {
+    sum += glm::cross(glm::dvec3(corners[i]) - glm::dvec3(corners[0]), glm::dvec3(corners[i + 1]) - glm::dvec3(corners[0]));
+  }
+  return 0.5 * glm::length(sum);
+}
+
+bool Overlap(const glm::vec3& minA, const glm::vec3& maxA, const glm::vec3& minB, const glm::vec3& maxB)
+{
+  return minA.x <= maxB.x && minB.x <= maxA.x && minA.y <= maxB.y && minB.y <= maxA.y && minA.z <= maxB.z && minB.z <= maxA.z;
+}
+
+bool Inside(const glm::vec3& min, const glm::vec3& max, const glm::vec3& boxMin, const glm::vec3& boxMax)
+{
+  return min.x >= boxMin.x && min.y >= boxMin.y && min.z >= boxMin.z && max.x <= boxMax.x && max.y <= boxMax.y && max.z <= boxMax.z;
+}
+
+}
+
+std::uint32_t Tree::AddTriangle(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2)
+{
+  faces.push_back({ { v0, v1, v2, v2 } });
+  primitive_faces.push_back(static_cast<std::uint32_t>(faces.size()));
+  return static_cast<std::uint32_t>(GetPrimitiveCount() - 1);
+}
+
+std::uint32_t Tree::AddBox(const glm::vec3& min, const glm::vec3& max)
+{
+  for (int axis = 0; axis < 3; axis++)
+  {
+    const int u = (axis + 1) % 3;
+    const int v = (axis + 2) % 3;
+    for (float side : { min[axis], max[axis] })
+    {
+      Face face;
+      for (int corner = 0; corner < 4; corner++)
+      {
+        face.corners[corner][axis] = side;
+        face.corners[corner][u] = corner == 1 || corner == 2 ? max[u] : min[u];
+        face.corners[corner][v] = corner >= 2 ? max[v] : min[v];
+      }
+      faces.push_back(face);
+    }
+  }
+  primitive_faces.push_back(static_cast<std::uint32_t>(faces.size()));
+  return static_cast<std::uint32_t>(GetPrimitiveCount() - 1);
+}
+
+double ClippedArea(const Face& face, const glm::vec3& min, const glm::vec3& max)
+{
+  glm::vec3 polygon[c_maxCorners];
+  glm::vec3 clipped[c_maxCorners];
+  int count = 4;
+  std::copy(std::begin(face.corners), std::end(face.corners), polygon);
+
+  // Sutherland-Hodgman, one plane of the box after the other
+  for (int plane = 0; plane < 6 && count >= 3; plane++)
+  {
+    const int axis = plane / 2;
+    const bool lower = plane % 2 == 0;
+    auto Distance = [&](const glm::vec3& p) { return lower ? p[axis] - min[axis] : max[axis] - p[axis]; };
+
+    int clippedCount = 0;
+    for (int i = 0; i < count && clippedCount + 2 <= c_maxCorners; i++)
+    {
+      const glm::vec3& current = polygon[i];
+      const glm::vec3& next = polygon[(i + 1) % count];
+      const float currentDistance = Distance(current);
+      const float nextDistance = Distance(next);
+      if (currentDistance >= 0.0f)
+      {
+        clipped[clippedCount++] = current;
+      }
+      if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f))
+      {
+        const float t = currentDistance / (currentDistance - nextDistance);
+        clipped[clippedCount++] = current + t * (next - current);
+      }
+    }
+    std::copy(clipped, clipped + clippedCount, polygon);
+    count = clippedCount;
+  }
+  return count >= 3 ? PolygonArea(polygon, count) : 0.0;
+}
+
+Metrics Analyze(const Tree& tree, const Costs& costs)
+{
+  Metrics metrics;
+  if (tree.nodes.empty())
+  {
+    return metrics;
+  }
+
+  // Depth first from the root: the leaves every node spans in that order, the leaf of
+  // every primitive (the first where one is in several) and what SAH sums
+  struct Span
+  {
+    std::uint32_t begin = 0;
+    std::uint32_t end = 0;
+  };
+  struct Entry
+  {
+    std::int32_t node;
+    std::int32_t parent;
+    std::uint32_t depth;
+    bool leaving;
+  };
+  const std::uint32_t none = std::numeric_limits<std::uint32_t>::max();
+  std::vector<Span> spans(tree.nodes.size());
+  std::vector<bool> reached(tree.nodes.size(), false);
+  std::vector<std::int32_t> parents(tree.nodes.size(), -1); // what reached a node, EPO follows no other edges
+  std::vector<std::uint32_t> primitiveLeaf(tree.GetPrimitiveCount(), none);
+  const double rootArea = SurfaceArea(tree.nodes[0].min, tree.nodes[0].max);
+  std::uint32_t leafOrder = 0;
+  double depthSum = 0.0;
+  double cost = 0.0;
+
+  std::vector<Entry> stack{ { 0, -1, 0, false } };
+  while (!stack.empty())
+  {
+    const Entry entry = stack.back();
+    stack.pop_back();
+    if (entry.leaving)
+    {
+      spans[entry.node].end = leafOrder;
+      continue;
+    }
+    if (entry.node < 0 || entry.node >= static_cast<std::int32_t>(tree.nodes.size()) || reached[entry.node])
+    {
+      continue;
+    }
+    reached[entry.node] = true;
+    parents[entry.node] = entry.parent;
+
+    const Node& node = tree.nodes[entry.node];
+    const double area = rootArea > 0.0 ? SurfaceArea(node.min, node.max) / rootArea : 1.0;
+    metrics.nodes++;
+    spans[entry.node].begin = leafOrder;
+    if (node.left < 0)
+    {
+      for (std::uint32_t i = node.first; i < node.first + node.count && i < tree.references.size(); i++)
+      {
+        const std::uint32_t primitive = tree.references[i];
+        if (primitive < primitiveLeaf.size() && primitiveLeaf[primitive] == none)
+        {
+          primitiveLeaf[primitive] = leafOrder;
+        }
+      }
+      spans[entry.node].end = ++leafOrder;
+      metrics.leaves++;
+      metrics.primitives += node.count;
+      metrics.max_depth = std::max(metrics.max_depth, entry.depth);
+      depthSum += entry.depth;
+      if (metrics.leaf_sizes.size() <= node.count)
+      {
+        metrics.leaf_sizes.resize(node.count + 1, 0);
+      }
+      metrics.leaf_sizes[node.count]++;
+      cost += costs.primitive * node.count * area;
+    }
+    else
+    {
+      cost += costs.node * area;
+      stack.push_back({ entry.node, entry.parent, entry.depth, true });
+      stack.push_back({ node.right, entry.node, entry.depth + 1, false });
+      stack.push_back({ node.left, entry.node, entry.depth + 1, false });
+    }
+  }
+  metrics.sah = cost;
+  metrics.mean_leaf_depth = metrics.leaves > 0 ? depthSum / metrics.leaves : 0.0;
+
+  // EPO: every primitive against the nodes its bounds overlap that do not hold it, the
+  // children of those are searched too since one of them may hold it
+  double totalArea = 0.0;
+  double overlap = 0.0;
+  std::vector<std::int32_t> nodes;
+  for (std::size_t primitive = 0; primitive < tree.GetPrimitiveCount(); primitive++)
+  {
+    const std::uint32_t firstFace = tree.primitive_faces[primitive];
+    const std::uint32_t endFace = tree.primitive_faces[primitive + 1];
+    glm::vec3 min(std::numeric_limits<float>::max());
+    glm::vec3 max(-std::numeric_limits<float>::max());
+    double area = 0.0;
+    for (std::uint32_t face = firstFace; face < endFace; face++)
+    {
+      for (const glm::vec3& corner : tree.faces[face].corners)
+      {
+        min = glm::min(min, corner);
+        max = glm::max(max, corner);
+      }
+      area += PolygonArea(tree.faces[face].corners, 4);
+    }
+    totalArea += area;
+    if (area <= 0.0)
+    {
+      continue;
+    }
+
+    const std::uint32_t leaf = primitiveLeaf[primitive];
+    nodes.assign(1, 0);
+    while (!nodes.empty())
+    {
+      const std::int32_t index = nodes.back();
+      nodes.pop_back();
+      const Node& node = tree.nodes[index];
+      if (!Overlap(min, max, node.min, node.max))
+      {
+        continue;
+      }
+      if (leaf < spans[index].begin || leaf >= spans[index].end)
+      {
+        double inside = 0.0;
+        if (Inside(min, max, node.min, node.max))
+        {
+          inside = area;
+        }
+        else
+        {
+          for (std::uint32_t face = firstFace; face < endFace; face++)
+          {
+            inside += ClippedArea(tree.faces[face], node.min, node.max);
+          }
+        }
+        overlap += inside * (node.left < 0 ? costs.primitive * node.count : costs.node);
+      }
+      for (std::int32_t child : { node.left, node.right })
+      {
+        if (child >= 0 && child < static_cast<std::int32_t>(tree.nodes.size()) && parents[child] == index)
+        {
+          nodes.push_back(child);
+        }
+      }
+    }
+  }
+  metrics.epo = totalArea > 0.0 ? overlap / totalArea : 0.0;
+  return metrics;
+}
+
+bool FromFallback(const void* data, std::size_t size, bool topLevel, Tree& tree, std::string& error)
+{
+  tree = Tree();
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  if (size < c_headerBytes)
+  {
+    error = "smaller than the header";
+    return false;
+  }
+
+  // offsetToVertices of a bottom level is offsetToLeafNodeMetaData of a top level
+  const std::uint32_t offsetToBoxes = Read<std::uint32_t>(bytes, 0);
+  const std::uint32_t offsetToPrimitives = Read<std::uint32_t>(bytes, 4);
+  const std::uint32_t offsetToPrimitiveMetaData = Read<std::uint32_t>(bytes, 8);
+  if (offsetToBoxes < c_headerBytes || offsetToPrimitives < offsetToBoxes + c_nodeBytes || offsetToPrimitives > size)
+  {
+    error = "the offsets of the header are outside of the " + std::to_string(size) + " bytes";
+    return false;
+  }
+  const std::size_t nodeCount = (offsetToPrimitives - offsetToBoxes) / c_nodeBytes;
+
+  // A bottom level's primitives are stored apart from the nodes, a top level makes one
+  // of each leaf's box
+  std::size_t primitiveCount = 0;
+  if (topLevel)
+  {
+    primitiveCount = (nodeCount + 1) / 2;
+    if (offsetToPrimitives + primitiveCount * c_instanceBytes > size)
+    {
+      error = "the instances of " + std::to_string(primitiveCount) + " leaves are outside of the buffer";
+      return false;
+    }
+  }
+  else
+  {
+    if (offsetToPrimitiveMetaData < offsetToPrimitives || offsetToPrimitiveMetaData > size)
+    {
+      error = "the primitives are outside of the buffer";
+      return false;
+    }
+    primitiveCount = (offsetToPrimitiveMetaData - offsetToPrimitives) / c_primitiveBytes;
+    for (std::size_t i = 0; i < primitiveCount; i++)
+    {
+      const std::size_t offset = offsetToPrimitives + i * c_primitiveBytes;
+      const std::uint32_t type = Read<std::uint32_t>(bytes, offset);
+      if (type == c_triangleType)
+      {
+        tree.AddTriangle(ReadVec3(bytes, offset + 4), ReadVec3(bytes, offset + 16), ReadVec3(bytes, offset + 28));
+      }
+      else if (type == c_proceduralType)
+      {
+        tree.AddBox(ReadVec3(bytes, offset + 4), ReadVec3(bytes, offset + 16));
+      }
+      else
+      {
+        error = "primitive " + std::to_string(i) + " has the unknown type " + std::to_string(type);
+        return false;
+      }
+    }
+  }
+
+  tree.nodes.resize(nodeCount);
+  for (std::size_t i = 0; i < nodeCount; i++)
+  {
+    const std::size_t offset = offsetToBoxes + i * c_nodeBytes;
+    const glm::vec3 center = ReadVec3(bytes, offset);
+    const std::uint32_t flags = Read<std::uint32_t>(bytes, offset + 12);
+    const glm::vec3 halfDim = ReadVec3(bytes, offset + 16);
+    const std::uint32_t second = Read<std::uint32_t>(bytes, offset + 28);
+
+    Node& node = tree.nodes[i];
+    node.min = center - halfDim;
+    node.max = center + halfDim;
+    if (flags & c_isLeaf)
+    {
+      // like BVHValidator one primitive per leaf, whatever numTriangles holds
+      const std::uint32_t leafIndex = flags & ~(c_isLeaf | c_isProcedural);
+      if (leafIndex >= primitiveCount)
+      {
+        error = "leaf " + std::to_string(i) + " points past the " + std::to_string(primitiveCount) + " primitives";
+        return false;
+      }
+      node.first = static_cast<std::uint32_t>(tree.references.size());
+      node.count = 1;
+      tree.references.push_back(topLevel ? tree.AddBox(node.min, node.max) : leafIndex);
+    }
+    else
+    {
+      node.left = static_cast<std::int32_t>(flags & c_leftNodeMask);
+      node.right = static_cast<std::int32_t>(second);
+      if (node.left == 0 || node.right == 0 || static_cast<std::size_t>(node.left) >= nodeCount || second >= nodeCount)
+      {
+        error = "node " + std::to_string(i) + " has children outside of the " + std::to_string(nodeCount) + " nodes";
+        return false;
+      }
+    }
+  }
+
+  // no node may be reached twice from the root, nodes it does not reach are left out by Analyze
+  std::vector<bool> reached(nodeCount, false);
+  std::vector<std::int32_t> stack{ 0 };
+  while (!stack.empty())
+  {
+    const std::int32_t index = stack.back();
+    stack.pop_back();
+    if (reached[index])
+    {
+      error = "node " + std::to_string(index) + " is reached twice";
+      return false;
+    }
+    reached[index] = true;
+    if (tree.nodes[index].left >= 0)
+    {
+      stack.push_back(tree.nodes[index].left);
+      stack.push_back(tree.nodes[index].right);
+    }
+  }
+  return true;
+}
+
+}
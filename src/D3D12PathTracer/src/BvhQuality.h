@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm/glm.hpp>
+
+//
+// BvhQuality - how good a bounding volume hierarchy is for any view, from the tree alone:
+//
+//   SAH  - the surface area heuristic, the expected cost of a ray through the root's box
+//          when every ray that hits a box's parent hits the box with the odds of their
+//          surface areas: the boxes' areas over the root's, weighted by the cost of a
+//          traversal step for inner nodes and of the primitives tested for leaves
+//   EPO  - end-point overlap (Aila, Karras and Laine 2013): how much of the surface of the
+//          geometry lies in boxes of nodes that do not hold it, where rays that end on it
+//          visit nodes in vain, weighted by those nodes' costs and over the whole area.
+//          Predicts how fast a tree traces better than SAH where boxes overlap
+//   the depth and the leaves by their primitive count
+//
+// A Tree is read from the CPU builder (CpuBvh::ExportTree) or from an acceleration
+// structure of the fallback layer read back from the GPU (FromFallback), so the builders
+// can be compared on the same asset. DXR acceleration structures are opaque and have none.
+//
+// Only depends on the standard library and glm, cpurender --bvh-quality-report checks it.
+//
+namespace BvhQuality {
+
+// The costs of Aila et al.: a traversal step against the test of one primitive.
+struct Costs
+{
+  double node = 1.2;
+  double primitive = 1.0;
+};
+
+struct Node
+{
+  glm::vec3 min{ 0.0f };
+  glm::vec3 max{ 0.0f };
+  std::int32_t left = -1; // children, -1 for leaves
+  std::int32_t right = -1;
+  std::uint32_t first = 0; // leaves: their primitives in Tree::references
+  std::uint32_t count = 0;
+};
+
+// A planar polygon, triangles repeat their last corner.
+struct Face
+{
+  glm::vec3 corners[4];
+};
+
+struct Tree
+{
+  std::vector<Node> nodes; // the root first
+  std::vector<std::uint32_t> references;
+  // The surface of the primitives: primitive i is faces[primitive_faces[i]] up to
+  // faces[primitive_faces[i + 1]].
+  std::vector<Face> faces;
+  std::vector<std::uint32_t> primitive_faces{ 0 };
+
+  std::uint32_t AddTriangle(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2);
+  // The six sides of a box, for the instances of a top level and procedural primitives.
+  std::uint32_t AddBox(const glm::vec3& min, const glm::vec3& max);
+  std::size_t GetPrimitiveCount() const { return primitive_faces.size() - 1; }
+};
+
+struct Metrics
+{
+  std::uint64_t nodes = 0;
+  std::uint64_t leaves = 0;
+  std::uint64_t primitives = 0; // references of the leaves
+  std::uint32_t max_depth = 0;  // of the deepest leaf, the root's is 0
+  double mean_leaf_depth = 0.0;
+  double sah = 0.0;
+  double epo = 0.0;
+  std::vector<std::uint64_t> leaf_sizes; // the number of leaves by their primitive count
+};
+
+Metrics Analyze(const Tree& tree, const Costs& costs = Costs());
+
+// The surface of a face inside the box, 0 where it is outside.
+double ClippedArea(const Face& face, const glm::vec3& min, const glm::vec3& max);
+
+// Parses an acceleration structure of the fallback layer (the BVHOffsets header, AABBNodes
+// from the root on, then the triangles of a bottom level or the instances of a top level),
+// size bytes as read back from its buffer. The primitives of a top level are the boxes of
+// its leaves, the world space bounds of the instances' bottom levels.
+bool FromFallback(const void* data, std::size_t size, bool topLevel, Tree& tree, std::string& error);
+
+}
@@ -0,0 +1,138 @@
+#include "CameraPath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+namespace CameraPath {
+
+namespace {
+
+// Slope of the spline at key i over the time of its neighbours, one sided at the ends.
+glm::vec3 Tangent(const std::vector<Keyframe>& keys, std::size_t i, glm::vec3 Keyframe::*member)
+{
+  const std::size_t previous = i > 0 ? i - 1 : i;
+  const std::size_t next = std::min(i + 1, keys.size() - 1);
+  const float span = keys[next].time - keys[previous].time;
+  return span > 0.0f ? (keys[next].*member - keys[previous].*member) / span : glm::vec3(0.0f);
+}
+
+// Cubic hermite segment between keys i and i + 1 at s in [0, 1].
+glm::vec3 Hermite(const std::vector<Keyframe>& keys, std::size_t i, float s, glm::vec3 Keyframe::*member)
+{
+  const float span = keys[i + 1].time - keys[i].time;
+  const float s2 = s * s;
+  const float s3 = s2 * s;
+  return (2.0f * s3 - 3.0f * s2 + 1.0f) * (keys[i].*member) + (s3 - 2.0f * s2 + s) * span * Tangent(keys, i, member) +
+         (-2.0f * s3 + 3.0f * s2) * (keys[i + 1].*member) + (s3 - s2) * span * Tangent(keys, i + 1, member);
+}
+
+}
+
+void Path::AddKeyframe(const Keyframe& keyframe)
+{
+  auto it = std::lower_bound(m_keyframes.begin(), m_keyframes.end(), keyframe.time,
+                             [](const Keyframe& key, float time) { return key.time < time; });
+  if (it != m_keyframes.end() && it->time == keyframe.time)
+  {
+    *it = keyframe;
+  }
+  else
+  {
+    m_keyframes.insert(it, keyframe);
+  }
+}
+
+void Path::SetDefaultFov(float fov)
+{
+  for (auto& key : m_keyframes)
+  {
+    if (key.fov <= 0.0f)
+    {
+      key.fov = fov;
+    }
+  }
+}
+
+unsigned int Path::GetFrameCount(float framesPerSecond) const
+{
+  if (m_keyframes.empty() || framesPerSecond <= 0.0f)
+  {
+    return 0;
+  }
+  // a little slack so 2 s at 30 fps is 61 frames and not 60 after rounding
+  return static_cast<unsigned int>(std::floor(GetDuration() * framesPerSecond + 1e-3f)) + 1;
+}
+
+Keyframe Path::Evaluate(float time) const
+{
+  if (m_keyframes.empty())
+  {
+    return Keyframe();
+  }
+  if (time <= m_keyframes.front().time || m_keyframes.size() == 1)
+  {
+    Keyframe key = m_keyframes.front();
+    key.time = time;
+    return key;
+  }
+  if (time >= m_keyframes.back().time)
+  {
+    Keyframe key = m_keyframes.back();
+    key.time = time;
+    return key;
+  }
+
+  // the segment whose end is the first key after time
+  auto next = std::upper_bound(m_keyframes.begin(), m_keyframes.end(), time, [](float t, const Keyframe& key) { return t < key.time; });
+  const std::size_t i = static_cast<std::size_t>(next - m_keyframes.begin()) - 1;
+  const float s = (time - m_keyframes[i].time) / (m_keyframes[i + 1].time - m_keyframes[i].time);
+
+  Keyframe key;
+  key.time = time;
+  key.eye = Hermite(m_keyframes, i, s, &Keyframe::eye);
+  key.lookat = Hermite(m_keyframes, i, s, &Keyframe::lookat);
+  key.fov = m_keyframes[i].fov + s * (m_keyframes[i + 1].fov - m_keyframes[i].fov);
+  return key;
+}
+
+bool ParseKeyframe(const std::vector<std::string>& tokens, Keyframe& keyframe)
+{
+  if (tokens.size() < 8 || tokens[0] != "keyframe")
+  {
+    return false;
+  }
+
+  float values[8] = {};
+  const std::size_t count = std::min<std::size_t>(tokens.size() - 1, 8);
+  for (std::size_t i = 0; i < count; i++)
+  {
+    char* end = nullptr;
+    values[i] = std::strtof(tokens[i + 1].c_str(), &end);
+    if (end == tokens[i + 1].c_str())
+    {
+      return false;
+    }
+  }
+
+  keyframe.time = values[0];
+  keyframe.eye = glm::vec3(values[1], values[2], values[3]);
+  keyframe.lookat = glm::vec3(values[4], values[5], values[6]);
+  keyframe.fov = count == 8 ? values[7] : 0.0f;
+  return true;
+}
+
+std::string FormatKeyframe(const Keyframe& keyframe)
+{
+  std::ostringstream line;
+  line << "keyframe " << keyframe.time << "  " << keyframe.eye.x << " " << keyframe.eye.y << " " << keyframe.eye.z << "  "
+       << keyframe.lookat.x << " " << keyframe.lookat.y << " " << keyframe.lookat.z;
+  if (keyframe.fov > 0.0f)
+  {
+    line << "  " << keyframe.fov;
+  }
+  return line.str();
+}
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <glm/glm/glm.hpp>
+
+//
+// CameraPath - keyframed camera for sequence captures.
+//
+// Keyframes come from the CAMERA block of a scene file, one line each:
+//
+//   keyframe TIME  EYE_X EYE_Y EYE_Z  LOOKAT_X LOOKAT_Y LOOKAT_Z  [FOV]
+//
+// with TIME in seconds. Eye and look-at follow a Catmull-Rom spline through the keys,
+// so pans pass through every keyframe without kinks, the field of view is blended
+// linearly. Keys without a FOV take the fov of the camera block.
+//
+namespace CameraPath {
+
+struct Keyframe
+{
+  float time = 0.0f;
+  glm::vec3 eye{ 0.0f, 0.0f, -20.0f };
+  glm::vec3 lookat{ 0.0f, 0.0f, 1.0f };
+  float fov = 0.0f; // degrees, 0 until filled in with the fov of the camera
+};
+
+class Path
+{
+public:
+  // Keeps the keys sorted by time, a key at the time of an existing one replaces it.
+  void AddKeyframe(const Keyframe& keyframe);
+  void Clear() { m_keyframes.clear(); }
+
+  // Keys that were given without a fov get this one.
+  void SetDefaultFov(float fov);
+
+  bool IsEmpty() const { return m_keyframes.empty(); }
+  const std::vector<Keyframe>& GetKeyframes() const { return m_keyframes; }
+
+  float GetStartTime() const { return m_keyframes.empty() ? 0.0f : m_keyframes.front().time; }
+  float GetDuration() const { return m_keyframes.empty() ? 0.0f : m_keyframes.back().time - m_keyframes.front().time; }
+
+  // Frames of a sequence at framesPerSecond, both ends included.
+  unsigned int GetFrameCount(float framesPerSecond) const;
+
+  // The camera at time, clamped to the first and last key.
+  Keyframe Evaluate(float time) const;
+
+private:
+  std::vector<Keyframe> m_keyframes;
+};
+
+// Parses the tokens of a keyframe line as the scene parsers split them. Returns false
+// and leaves keyframe alone if the line is not a keyframe or is missing numbers.
+bool ParseKeyframe(const std::vector<std::string>& tokens, Keyframe& keyframe);
+
+// The same line the way the scene writer puts it back into a file.
+std::string FormatKeyframe(const Keyframe& keyframe);
+
+}
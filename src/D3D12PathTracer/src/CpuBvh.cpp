@@ -0,0 +1,402 @@
+#include "CpuBvh.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "BvhQuality.h"
+
+namespace {
+
+const std::uint32_t c_maxLeafSize = 4;
+const int c_binCount = 16;
+
+struct Bounds
+{
+  glm::vec3 min{ std::numeric_limits<float>::max() };
+  glm::vec3 max{ -std::numeric_limits<float>::max() };
+
+  void Grow(const glm::vec3& p)
+  {
+    min = glm::min(min, p);
+    max = glm::max(max, p);
+  }
+
+  void Grow(const Bounds& b)
+  {
+    min = glm::min(min, b.min);
+    max = glm::max(max, b.max);
+  }
+
+  float HalfArea() const
+  {
+    const glm::vec3 e = max - min;
+    return e.x < 0.0f ? 0.0f : e.x * e.y + e.y * e.z + e.z * e.x;
+  }
+};
+
+// Slab test, returns the entry distance or infinity on a miss.
+inline float IntersectBounds(const glm::vec3& bmin, const glm::vec3& bmax, const glm::vec3& origin, const glm::vec3& invDir, float tMin, float tMax)
+{
+  const glm::vec3 t0 = (bmin - origin) * invDir;
+  const glm::vec3 t1 = (bmax - origin) * invDir;
+  const glm::vec3 tNear = glm::min(t0, t1);
+  const glm::vec3 tFar = glm::max(t0, t1);
+  const float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, tMin));
+  const float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tMax));
+  return enter <= exit ? enter : std::numeric_limits<float>::infinity();
+}
+
+}
+
+void CpuBvh::AddMesh(std::uint32_t object, const std::vector<glm::vec3>& positions, const std::vector<std::uint32_t>& indices, bool mirrored)
+{
+  for (std::size_t i = 0; i + 2 < indices.size(); i += 3)
+  {
+    Triangle triangle;
+    triangle.v0 = positions[indices[i]];
+    triangle.v1 = positions[indices[i + 1]];
+    triangle.v2 = positions[indices[i + 2]];
+    triangle.object = object;
+    triangle.primitive = static_cast<std::uint32_t>(i / 3);
+    triangle.mirrored = mirrored;
+    m_triangles.push_back(triangle);
+  }
+}
+
+void CpuBvh::Build()
+{
+  m_nodes.clear();
+  m_blocks.clear();
+
+  const std::uint32_t count = static_cast<std::uint32_t>(m_triangles.size());
+  m_order.resize(count);
+  std::vector<glm::vec3> centroids(count);
+  for (std::uint32_t i = 0; i < count; i++)
+  {
+    m_order[i] = i;
+    centroids[i] = (m_triangles[i].v0 + m_triangles[i].v1 + m_triangles[i].v2) / 3.0f;
+  }
+
+  m_nodes.reserve(count > 0 ? 2 * count / c_maxLeafSize + 1 : 1);
+  if (count == 0)
+  {
+    // a root no ray can enter keeps traversal free of special cases
+    Node empty{};
+    empty.bounds_min = glm::vec3(std::numeric_limits<float>::max());
+    empty.bounds_max = glm::vec3(-std::numeric_limits<float>::max());
+    m_nodes.push_back(empty);
+    return;
+  }
+  BuildNode(0, count, centroids);
+}
+
+std::size_t CpuBvh::GetMemoryBytes() const
+{
+  return m_nodes.size() * sizeof(Node) + m_blocks.size() * sizeof(TriangleBlock) + m_triangles.size() * sizeof(Triangle) +
+         m_order.size() * sizeof(std::uint32_t);
+}
+
+void CpuBvh::ExportTree(BvhQuality::Tree& tree) const
+{
+  tree = BvhQuality::Tree();
+  for (const Triangle& t : m_triangles)
+  {
+    tree.AddTriangle(t.v0, t.v1, t.v2);
+  }
+  tree.nodes.resize(m_nodes.size());
+  for (std::size_t i = 0; i < m_nodes.size(); i++)
+  {
+    const Node& node = m_nodes[i];
+    BvhQuality::Node& exported = tree.nodes[i];
+    exported.min = node.bounds_min;
+    exported.max = node.bounds_max;
+    if (node.count > 0)
+    {
+      exported.first = static_cast<std::uint32_t>(tree.references.size());
+      exported.count = node.count;
+      const TriangleBlock& block = m_blocks[node.offset];
+      tree.references.insert(tree.references.end(), block.triangle, block.triangle + node.count);
+    }
+    else
+    {
+      exported.left = static_cast<std::int32_t>(i + 1);
+      exported.right = static_cast<std::int32_t>(node.offset);
+    }
+  }
+}
+
+std::uint32_t CpuBvh::BuildNode(std::uint32_t begin, std::uint32_t end, const std::vector<glm::vec3>& centroids)
+{
+  const std::uint32_t nodeIndex = static_cast<std::uint32_t>(m_nodes.size());
+  m_nodes.emplace_back();
+
+  Bounds bounds;
+  Bounds centroidBounds;
+  for (std::uint32_t i = begin; i < end; i++)
+  {
+    const Triangle& t = m_triangles[m_order[i]];
+    bounds.Grow(t.v0);
+    bounds.Grow(t.v1);
+    bounds.Grow(t.v2);
+    centroidBounds.Grow(centroids[m_order[i]]);
+  }
+  m_nodes[nodeIndex].bounds_min = bounds.min;
+  m_nodes[nodeIndex].bounds_max = bounds.max;
+
+  const std::uint32_t count = end - begin;
+  if (count <= c_maxLeafSize)
+  {
+    TriangleBlock block{};
+    for (std::uint32_t lane = 0; lane < c_maxLeafSize; lane++)
+    {
+      // pad with the last triangle, culled away by a zero facing
+      const Triangle& t = m_triangles[m_order[begin + std::min(lane, count - 1)]];
+      const glm::vec3 e1 = t.v1 - t.v0;
+      const glm::vec3 e2 = t.v2 - t.v0;
+      for (int axis = 0; axis < 3; axis++)
+      {
+        block.v0[axis][lane] = t.v0[axis];
+        block.e1[axis][lane] = e1[axis];
+        block.e2[axis][lane] = e2[axis];
+      }
+      block.facing[lane] = lane < count ? (t.mirrored ? -1.0f : 1.0f) : 0.0f;
+      block.triangle[lane] = m_order[begin + std::min(lane, count - 1)];
+    }
+
+    m_nodes[nodeIndex].offset = static_cast<std::uint32_t>(m_blocks.size());
+    m_nodes[nodeIndex].count = count;
+    m_blocks.push_back(block);
+    return nodeIndex;
+  }
+
+  // Binned SAH over the centroid bounds, largest axis first
+  int bestAxis = -1;
+  int bestSplit = 0;
+  float bestCost = std::numeric_limits<float>::max();
+  for (int axis = 0; axis < 3; axis++)
+  {
+    const float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+    if (extent <= 0.0f)
+    {
+      continue;
+    }
+
+    Bounds binBounds[c_binCount];
+    std::uint32_t binCounts[c_binCount] = {};
+    const float scale = c_binCount / extent;
+    for (std::uint32_t i = begin; i < end; i++)
+    {
+      const Triangle& t = m_triangles[m_order[i]];
+      const int bin = std::min(static_cast<int>((centroids[m_order[i]][axis] - centroidBounds.min[axis]) * scale), c_binCount - 1);
+      binCounts[bin]++;
+      binBounds[bin].Grow(t.v0);
+      binBounds[bin].Grow(t.v1);
+      binBounds[bin].Grow(t.v2);
+    }
+
+    // sweep from the right, then evaluate every split from the left
+    float rightArea[c_binCount];
+    std::uint32_t rightCount[c_binCount];
+    Bounds right;
+    std::uint32_t rightSum = 0;
+    for (int bin = c_binCount - 1; bin > 0; bin--)
+    {
+      right.Grow(binBounds[bin]);
+      rightSum += binCounts[bin];
+      rightArea[bin] = right.HalfArea();
+      rightCount[bin] = rightSum;
+    }
+
+    Bounds left;
+    std::uint32_t leftSum = 0;
+    for (int split = 1; split < c_binCount; split++)
+    {
+      left.Grow(binBounds[split - 1]);
+      leftSum += binCounts[split - 1];
+      if (leftSum == 0 || rightCount[split] == 0)
+      {
+        continue;
+      }
+      const float cost = left.HalfArea() * leftSum + rightArea[split] * rightCount[split];
+      if (cost < bestCost)
+      {
+        bestCost = cost;
+        bestAxis = axis;
+        bestSplit = split;
+      }
+    }
+  }
+
+  std::uint32_t middle;
+  if (bestAxis >= 0)
+  {
+    const float extent = centroidBounds.max[bestAxis] - centroidBounds.min[bestAxis];
+    const float scale = c_binCount / extent;
+    const float minimum = centroidBounds.min[bestAxis];
+    auto it = std::partition(m_order.begin() + begin, m_order.begin() + end, [&](std::uint32_t index)
+    {
+      return std::min(static_cast<int>((centroids[index][bestAxis] - minimum) * scale), c_binCount - 1) < bestSplit;
+    });
+    middle = static_cast<std::uint32_t>(it - m_order.begin());
+  }
+  else
+  {
+    // every centroid in one point, any split is as good as another
+    middle = begin + count / 2;
+  }
+
+  BuildNode(begin, middle, centroids);
+  const std::uint32_t right = BuildNode(middle, end, centroids);
+  m_nodes[nodeIndex].offset = right;
+  m_nodes[nodeIndex].count = 0;
+  return nodeIndex;
+}
+
+template<bool AnyHit>
+bool CpuBvh::Traverse(const Ray& ray, Hit& hit, Counters* counters) const
+{
+  const glm::vec3 invDir = 1.0f / ray.direction;
+  const glm::vec3& o = ray.origin;
+  const glm::vec3& d = ray.direction;
+
+  float closest = ray.t_max;
+  std::uint32_t closestTriangle = 0;
+  float closestU = 0.0f;
+  float closestV = 0.0f;
+  bool found = false;
+
+  std::uint32_t stack[128];
+  std::uint32_t stackSize = 0;
+  std::uint32_t current = 0;
+  std::uint32_t nodes = 0;
+  std::uint32_t triangles = 0;
+
+  if (IntersectBounds(m_nodes[0].bounds_min, m_nodes[0].bounds_max, o, invDir, ray.t_min, closest) == std::numeric_limits<float>::infinity())
+  {
+    if (counters != nullptr)
+    {
+      counters->rays++;
+    }
+    return false;
+  }
+
+  for (;;)
+  {
+    const Node& node = m_nodes[current];
+    nodes++;
+    if (node.count > 0)
+    {
+      triangles += node.count;
+      const TriangleBlock& block = m_blocks[node.offset];
+      float t[4];
+      float u[4];
+      float v[4];
+
+      // Moller-Trumbore, four lanes at once
+      for (int lane = 0; lane < 4; lane++)
+      {
+        const float e1x = block.e1[0][lane], e1y = block.e1[1][lane], e1z = block.e1[2][lane];
+        const float e2x = block.e2[0][lane], e2y = block.e2[1][lane], e2z = block.e2[2][lane];
+
+        const float px = d.y * e2z - d.z * e2y;
+        const float py = d.z * e2x - d.x * e2z;
+        const float pz = d.x * e2y - d.y * e2x;
+        const float det = e1x * px + e1y * py + e1z * pz;
+        const float invDet = 1.0f / det;
+
+        const float sx = o.x - block.v0[0][lane];
+        const float sy = o.y - block.v0[1][lane];
+        const float sz = o.z - block.v0[2][lane];
+        u[lane] = (sx * px + sy * py + sz * pz) * invDet;
+
+        const float qx = sy * e1z - sz * e1y;
+        const float qy = sz * e1x - sx * e1z;
+        const float qz = sx * e1y - sy * e1x;
+        v[lane] = (d.x * qx + d.y * qy + d.z * qz) * invDet;
+        t[lane] = (e2x * qx + e2y * qy + e2z * qz) * invDet;
+
+        // det > 0 is a front face, clockwise from the ray origin
+        const bool accept = det * block.facing[lane] > 0.0f && u[lane] >= 0.0f && v[lane] >= 0.0f &&
+                            u[lane] + v[lane] <= 1.0f && t[lane] > ray.t_min && t[lane] < closest;
+        t[lane] = accept ? t[lane] : std::numeric_limits<float>::infinity();
+      }
+
+      for (int lane = 0; lane < 4; lane++)
+      {
+        if (t[lane] < closest)
+        {
+          closest = t[lane];
+          closestTriangle = block.triangle[lane];
+          closestU = u[lane];
+          closestV = v[lane];
+          found = true;
+        }
+      }
+
+      if (AnyHit && found)
+      {
+        break;
+      }
+    }
+    else
+    {
+      const std::uint32_t left = current + 1;
+      const std::uint32_t right = node.offset;
+      const float tLeft = IntersectBounds(m_nodes[left].bounds_min, m_nodes[left].bounds_max, o, invDir, ray.t_min, closest);
+      const float tRight = IntersectBounds(m_nodes[right].bounds_min, m_nodes[right].bounds_max, o, invDir, ray.t_min, closest);
+      const float inf = std::numeric_limits<float>::infinity();
+
+      if (tLeft != inf && tRight != inf)
+      {
+        // nearer child first, the other one waits on the stack
+        current = tLeft <= tRight ? left : right;
+        stack[stackSize++] = tLeft <= tRight ? right : left;
+        continue;
+      }
+      if (tLeft != inf)
+      {
+        current = left;
+        continue;
+      }
+      if (tRight != inf)
+      {
+        current = right;
+        continue;
+      }
+    }
+
+    if (stackSize == 0)
+    {
+      break;
+    }
+    current = stack[--stackSize];
+  }
+
+  if (counters != nullptr)
+  {
+    counters->rays++;
+    counters->nodes += nodes;
+    counters->triangles += triangles;
+  }
+
+  if (found)
+  {
+    const Triangle& triangle = m_triangles[closestTriangle];
+    hit.t = closest;
+    hit.barycentrics = glm::vec2(closestU, closestV);
+    hit.object = triangle.object;
+    hit.primitive = triangle.primitive;
+  }
+  return found;
+}
+
+bool CpuBvh::Intersect(const Ray& ray, Hit& hit, Counters* counters) const
+{
+  return Traverse<false>(ray, hit, counters);
+}
+
+bool CpuBvh::Occluded(const Ray& ray, Counters* counters) const
+{
+  Hit hit;
+  return Traverse<true>(ray, hit, counters);
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm/glm.hpp>
+
+namespace BvhQuality { struct Tree; }
+
+//
+// CpuBvh - bounding volume hierarchy over world space triangles for the CPU reference.
+//
+// Built with binned SAH into a depth first array of 32 byte nodes. Leaves hold up to
+// four triangles stored as one structure of arrays block (padded with triangles that
+// never hit), so a leaf is tested with straight four wide loops the compiler vectorizes.
+// Like the shaders every ray culls back faces: a triangle faces the ray when its
+// vertices are clockwise seen from the ray origin in object space.
+//
+class CpuBvh
+{
+public:
+  struct Ray
+  {
+    glm::vec3 origin;
+    glm::vec3 direction;
+    float t_min;
+    float t_max;
+  };
+
+  // barycentrics are the weights of the second and third vertex, like BuiltInTriangleIntersectionAttributes
+  struct Hit
+  {
+    float t;
+    glm::vec2 barycentrics;
+    std::uint32_t object;
+    std::uint32_t primitive;
+  };
+
+  // Adds the triangles of one instance, positions already in world space. mirrored is set
+  // when the instance transform has a negative determinant, which flips the winding.
+  void AddMesh(std::uint32_t object, const std::vector<glm::vec3>& positions, const std::vector<std::uint32_t>& indices, bool mirrored);
+
+  void Build();
+
+  // What traversals cost, added to by Intersect and Occluded when they are given one.
+  // Triangles counts the triangles of the leaves tested, not the padding of their blocks.
+  struct Counters
+  {
+    std::uint64_t rays = 0;
+    std::uint64_t nodes = 0;
+    std::uint64_t triangles = 0;
+  };
+
+  // Closest hit in (t_min, t_max).
+  bool Intersect(const Ray& ray, Hit& hit, Counters* counters = nullptr) const;
+
+  // Any hit in (t_min, t_max), for shadow rays.
+  bool Occluded(const Ray& ray, Counters* counters = nullptr) const;
+
+  std::size_t GetTriangleCount() const { return m_triangles.size(); }
+  std::size_t GetNodeCount() const { return m_nodes.size(); }
+  // Bytes the built tree keeps (nodes, leaf blocks, the triangles and their order) and
+  // those of the centroids Build allocates on top while it runs.
+  std::size_t GetMemoryBytes() const;
+  std::size_t GetBuildScratchBytes() const { return m_triangles.size() * sizeof(glm::vec3); }
+  // The built tree for BvhQuality, the triangles in the order they were added.
+  void ExportTree(BvhQuality::Tree& tree) const;
+
+private:
+  struct Triangle
+  {
+    glm::vec3 v0, v1, v2;
+    std::uint32_t object;
+    std::uint32_t primitive;
+    bool mirrored;
+  };
+
+  struct Node
+  {
+    glm::vec3 bounds_min;
+    std::uint32_t offset; // leaf: block index, interior: right child (the left one follows the node)
+    glm::vec3 bounds_max;
+    std::uint32_t count; // triangles in the leaf, 0 for interior nodes
+  };
+
+  struct TriangleBlock
+  {
+    float v0[3][4];
+    float e1[3][4];
+    float e2[3][4];
+    float facing[4]; // -1 flips the culling test of mirrored instances
+    std::uint32_t triangle[4];
+  };
+
+  std::uint32_t BuildNode(std::uint32_t begin, std::uint32_t end, const std::vector<glm::vec3>& centroids);
+  template<bool AnyHit>
+  bool Traverse(const Ray& ray, Hit& hit, Counters* counters) const;
+
+  std::vector<Triangle> m_triangles;
+  std::vector<std::uint32_t> m_order;
+  std::vector<Node> m_nodes;
+  std::vector<TriangleBlock> m_blocks;
+};
@@ -0,0 +1,893 @@
+#include "CpuPathTracer.h"
+#include "AliasTable.h"
+#include "Profiler.h"
+#include "shaders/MicrofacetHlslCompat.h"
+#include "include/stb_image_write.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+namespace CpuPathTracer {
+
+namespace {
+
+const float PI_F = 3.1415926535897932384626422832795028841971f;
+const float TWO_PI_F = 6.2831853071795864769252867665590057683943f;
+const float INV_PI_F = 0.3183098861837906715377675267450287240689f;
+const float SQRT_OF_ONE_THIRD_F = 0.5773502691896257645091487805019574556476f;
+const float RED_WAVELENGTH_UM = 0.69f;
+const float BLUE_WAVELENGTH_UM = 0.47f;
+const float GREEN_WAVELENGTH_UM = 0.53f;
+
+float PowerHeuristic(float a, float b)
+{
+  float a2 = a * a;
+  return a2 / (a2 + b * b);
+}
+
+float EvaluateFresnelDielectric(float cosThetaI, float etaI, float etaT)
+{
+  cosThetaI = glm::clamp(cosThetaI, -1.0f, 1.0f);
+
+  bool entering = cosThetaI > 0.0f;
+  float etaIb = etaI;
+  float etaTb = etaT;
+  if (!entering) {
+    etaIb = etaT;
+    etaTb = etaI;
+    cosThetaI = std::abs(cosThetaI);
+  }
+
+  float sinThetaI = std::sqrt(std::max(0.0f, 1 - cosThetaI * cosThetaI));
+  float sinThetaT = etaIb / etaTb * sinThetaI;
+
+  if (sinThetaT >= 1) {
+    return 1.0f;
+  }
+
+  float cosThetaT = std::sqrt(std::max(0.0f, 1 - sinThetaT * sinThetaT));
+
+  float Rparl = ((etaTb * cosThetaI) - (etaIb * cosThetaT)) /
+    ((etaTb * cosThetaI) + (etaIb * cosThetaT));
+  float Rperp = ((etaIb * cosThetaI) - (etaTb * cosThetaT)) /
+    ((etaIb * cosThetaI) + (etaTb * cosThetaT));
+  return (Rparl * Rparl + Rperp * Rperp) / 2;
+}
+
+float SellmeierEquation(float wavelength)
+{
+  const float B1 = 1.03961212f;
+  const float B2 = 0.231792344f;
+  const float B3 = 1.01046945f;
+  const float C1 = 0.00600069867f;
+  const float C2 = 0.0200179144f;
+  const float C3 = 103.560653f;
+
+  float wavlenSquared = wavelength * wavelength;
+
+  float term1 = (B1 * wavlenSquared) / (wavlenSquared - C1);
+  float term2 = (B2 * wavlenSquared) / (wavlenSquared - C2);
+  float term3 = (B3 * wavlenSquared) / (wavlenSquared - C3);
+
+  return std::sqrt(1.0f + term1 + term2 + term3);
+}
+
+glm::vec2 CalculateConcentricSampleDisk(float u, float v)
+{
+  glm::vec2 uOffset = 2.0f * glm::vec2(u, v) - glm::vec2(1, 1);
+  if (uOffset.x == 0 && uOffset.y == 0) {
+    return glm::vec2(0.0f, 0.0f);
+  }
+
+  float theta, r;
+  if (std::abs(uOffset.x) > std::abs(uOffset.y)) {
+    r = uOffset.x;
+    theta = PI_F / 4 * (uOffset.y / uOffset.x);
+  }
+  else {
+    r = uOffset.y;
+    theta = (PI_F / 2) - (PI_F / 4 * (uOffset.x / uOffset.y));
+  }
+  return r * glm::vec2(std::cos(theta), std::sin(theta));
+}
+
+}
+
+namespace {
+
+glm::vec3 CalculateRandomDirectionInHemisphere(const glm::vec3& normal, float u0, float u1)
+{
+  float up = std::sqrt(u0); // cos(theta)
+  float over = std::sqrt(1 - up * up); // sin(theta)
+  float around = u1 * TWO_PI_F;
+
+  glm::vec3 directionNotNormal;
+  if (std::abs(normal.x) < SQRT_OF_ONE_THIRD_F) {
+    directionNotNormal = glm::vec3(1, 0, 0);
+  }
+  else if (std::abs(normal.y) < SQRT_OF_ONE_THIRD_F) {
+    directionNotNormal = glm::vec3(0, 1, 0);
+  }
+  else {
+    directionNotNormal = glm::vec3(0, 0, 1);
+  }
+
+  glm::vec3 perpendicularDirection1 = glm::normalize(glm::cross(normal, directionNotNormal));
+  glm::vec3 perpendicularDirection2 = glm::normalize(glm::cross(normal, perpendicularDirection1));
+
+  return up * normal
+    + std::cos(around) * over * perpendicularDirection1
+    + std::sin(around) * over * perpendicularDirection2;
+}
+
+}
+
+Renderer::Renderer(const SceneCore::SceneData& scene, const Settings& settings) :
+  m_scene(scene),
+  m_settings(settings)
+{
+  m_settings.width = std::max(m_settings.width, 1u);
+  m_settings.height = std::max(m_settings.height, 1u);
+  m_settings.tile_size = std::max(m_settings.tile_size, 1u);
+
+  const auto start = std::chrono::steady_clock::now();
+
+  // one instance per object, in order, like InstanceID() on the GPU
+  for (const auto& object : m_scene.objects)
+  {
+    Instance instance{};
+    instance.object = &object;
+    instance.mesh = SceneCore::SceneData::Find(m_scene.meshes, object.mesh);
+    instance.material = SceneCore::SceneData::Find(m_scene.materials, object.material);
+    instance.albedo = SceneCore::SceneData::Find(m_scene.diffuse_textures, object.albedo_texture);
+    instance.normal = SceneCore::SceneData::Find(m_scene.normal_textures, object.normal_texture);
+    instance.metallic_roughness = SceneCore::SceneData::Find(m_scene.diffuse_textures, object.metallic_roughness_texture);
+    instance.light_offset = -1;
+    m_instances.push_back(instance);
+
+    if (instance.mesh != nullptr)
+    {
+      std::vector<glm::vec3> positions(instance.mesh->vertices.size());
+      for (std::size_t i = 0; i < positions.size(); i++)
+      {
+        positions[i] = glm::vec3(object.transform * glm::vec4(instance.mesh->vertices[i].position, 1.0f));
+      }
+      const bool mirrored = glm::determinant(glm::mat3(object.transform)) < 0.0f;
+      m_bvh.AddMesh(static_cast<std::uint32_t>(m_instances.size() - 1), positions, instance.mesh->indices, mirrored);
+    }
+  }
+  {
+    PROFILE_SCOPE("Build BVH");
+    m_bvh.Build();
+  }
+  {
+    PROFILE_SCOPE("Build light list");
+    BuildLightList();
+  }
+
+  const SceneCore::Camera& camera = m_scene.camera;
+  m_eye = camera.eye;
+  m_forward = glm::normalize(camera.lookat - camera.eye);
+  m_right = glm::normalize(glm::cross(camera.up, m_forward));
+  m_up = glm::cross(m_forward, m_right);
+  m_tanHalfFov = std::tan(glm::radians(camera.fov) * 0.5f);
+  m_aspect = static_cast<float>(m_settings.width) / static_cast<float>(m_settings.height);
+
+  const std::size_t pixelCount = static_cast<std::size_t>(m_settings.width) * m_settings.height;
+  m_accumulation.assign(pixelCount, glm::vec4(0.0f));
+  m_moments.assign(pixelCount, glm::vec3(0.0f));
+  m_albedoDepth.assign(pixelCount, glm::vec4(0.0f));
+  m_normals.assign(pixelCount, glm::vec3(0.0f));
+  m_tilesX = (m_settings.width + m_settings.tile_size - 1) / m_settings.tile_size;
+  m_tilesY = (m_settings.height + m_settings.tile_size - 1) / m_settings.tile_size;
+
+  m_statistics.build_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Same selection as Scene::BuildLightList.
+void Renderer::BuildLightList()
+{
+  m_lights.Clear();
+  for (auto& instance : m_instances)
+  {
+    if (instance.mesh == nullptr || instance.material == nullptr || instance.albedo != nullptr)
+    {
+      continue;
+    }
+    const SceneCore::Material& material = *instance.material;
+    if (material.emittance <= 0.0f || material.reflectiveness > 0.0f || material.refractiveness > 0.0f)
+    {
+      continue;
+    }
+
+    instance.light_offset = m_lights.AddMesh(instance.mesh->vertices, instance.mesh->indices, instance.object->transform, material.diffuse);
+  }
+  m_lights.Build();
+}
+
+void Renderer::GenerateCameraRay(glm::uvec2 index, glm::vec3& origin, glm::vec3& direction, Rng& rng) const
+{
+  glm::vec2 xy = glm::vec2(index) + 0.5f; // center in the middle of the pixel.
+
+  const std::uint32_t features = m_settings.features;
+  if (features & AntiAliasing)
+  {
+    float epsilonX = rng.Uniform01();
+    float epsilonY = rng.Uniform01();
+    xy.x += epsilonX;
+    xy.y += epsilonY;
+  }
+
+  glm::vec2 screenPos = xy / glm::vec2(m_settings.width, m_settings.height) * 2.0f - 1.0f;
+
+  // Invert Y for DirectX-style coordinates.
+  screenPos.y = -screenPos.y;
+
+  // The point on the near plane (at distance 1) the pixel unprojects to.
+  glm::vec3 world = m_eye + m_forward + m_right * (screenPos.x * m_tanHalfFov * m_aspect) + m_up * (screenPos.y * m_tanHalfFov);
+
+  origin = m_eye;
+  direction = glm::normalize(world - origin);
+
+  if (features & DepthOfField)
+  {
+    float lensRad = 0.5f;
+    float focalDist = 20.0f;
+    glm::vec2 disk = CalculateConcentricSampleDisk(rng.Uniform01(), rng.Uniform01());
+    glm::vec3 pLens = glm::vec3(lensRad * disk, 0.0f);
+    float ft = focalDist / std::abs(direction.z);
+    glm::vec3 pFocus = direction * ft;
+    origin += pLens;
+    direction = glm::normalize(pFocus - pLens);
+  }
+}
+
+bool Renderer::IsVisible(const glm::vec3& origin, const glm::vec3& target, Statistics& statistics) const
+{
+  glm::vec3 toTarget = target - origin;
+  float dist = glm::length(toTarget);
+
+  CpuBvh::Ray ray;
+  ray.origin = origin;
+  ray.direction = toTarget / dist;
+  ray.t_min = 0.001f;
+  ray.t_max = std::max(dist - 0.01f, 0.001f);
+  const bool occluded = m_bvh.Occluded(ray, &statistics.shadow_traversal);
+  statistics.rays[RayStats::RayStatShadowRays] += 1;
+  statistics.rays[RayStats::RayStatShadowOccluded] += occluded ? 1 : 0;
+  return !occluded;
+}
+
+void Renderer::SampleDirectLight(const glm::vec3& position, const glm::vec3& normal, const glm::vec3& throughput, ShadowRay& shadow, Rng& rng) const
+{
+  shadow.contribution = glm::vec3(0.0f);
+
+  const std::uint32_t index = AliasTable::Sample(rng.Uniform01(), m_lights.GetAliasProbabilities().data(), m_lights.GetAliases().data(),
+                                                 m_lights.GetSampleableCount());
+  const LightList::Triangle& light = m_lights.GetTriangles()[index];
+
+  // Uniform point on the triangle
+  float su = std::sqrt(rng.Uniform01());
+  float v = rng.Uniform01();
+  glm::vec3 lightPoint = light.v0 * (1.0f - su) + light.v1 * (su * (1.0f - v)) + light.v2 * (su * v);
+
+  glm::vec3 origin = position + normal * 0.01f;
+  glm::vec3 toLight = lightPoint - origin;
+  float dist2 = glm::dot(toLight, toLight);
+  glm::vec3 wi = toLight / std::sqrt(dist2);
+
+  float cosSurface = glm::dot(normal, wi);
+  float cosLight = glm::dot(glm::normalize(glm::cross(light.v1 - light.v0, light.v2 - light.v0)), -wi);
+  if (cosSurface <= 0.0f || cosLight <= 0.0f || light.pdf <= 0.0f) {
+    return;
+  }
+
+  float lightPdf = light.pdf / light.area * dist2 / cosLight;
+  float bouncePdf = cosSurface * INV_PI_F;
+
+  // the caller traces the shadow ray, right away or batched with the other paths
+  shadow.origin = origin;
+  shadow.target = lightPoint;
+  shadow.contribution = throughput * INV_PI_F * light.radiance * cosSurface * PowerHeuristic(lightPdf, bouncePdf) / lightPdf;
+}
+
+namespace {
+
+void ReflectiveBounce(const glm::vec3& specular, const glm::vec3& worldRayDirection, const glm::vec3& triangleNormal, const glm::vec3& hitPosition, float hitType, glm::vec4& color, glm::vec3& rayOrigin, glm::vec3& rayDir)
+{
+  rayDir = glm::reflect(worldRayDirection, triangleNormal);
+  rayOrigin = hitPosition + rayDir * 0.01f;
+  color = glm::vec4(glm::vec3(color) * specular, hitType);
+}
+
+// Picks between refraction and reflection with the same schlick weighting as the shader.
+glm::vec3 RefractOrReflect(float indexOfRefraction, const glm::vec3& worldRayDirection, const glm::vec3& triangleNormal, glm::vec4& color, float u)
+{
+  // adjust eta & normal according to direction of ray (inside or outside mat)
+  bool inside = glm::dot(worldRayDirection, triangleNormal) > 0.f;
+  glm::vec3 tempNormal = triangleNormal * (inside ? -1.0f : 1.0f);
+  float eta = inside ? indexOfRefraction : (1.0f / indexOfRefraction);
+
+  // normal refraction, zero on total internal reflection like HLSL refract
+  glm::vec3 newDir = glm::refract(worldRayDirection, tempNormal, eta);
+
+  // internal total reflection
+  if (glm::length(newDir) < 0.01f) {
+    color *= 0.0f;
+    newDir = glm::reflect(worldRayDirection, triangleNormal);
+  }
+
+  // use schlick's approx
+  float base = (inside ? indexOfRefraction - 1.0f : 1.0f - indexOfRefraction) / (1.0f + indexOfRefraction);
+  float schlick_0 = base * base;
+  float schlick_coef = schlick_0 +
+    (1 - schlick_0) * std::pow(1 - std::max(0.0f, glm::dot(worldRayDirection, triangleNormal)), 5.0f);
+
+  // based on coef, pick either a refraction or reflection
+  return schlick_coef < u ? glm::reflect(worldRayDirection, triangleNormal) : newDir;
+}
+
+}
+
+const char* GetMaterialClassName(MaterialClass materialClass)
+{
+  switch (materialClass)
+  {
+  case MaterialClass::Glass: return "glass";
+  case MaterialClass::Reflective: return "reflective";
+  case MaterialClass::Refractive: return "refractive";
+  case MaterialClass::Emissive: return "emissive";
+  case MaterialClass::Microfacet: return "microfacet";
+  case MaterialClass::Diffuse: return "diffuse";
+  case MaterialClass::Miss: return "miss";
+  default: return "unknown";
+  }
+}
+
+// The branch MyClosestHitShader takes, it only depends on the material.
+MaterialClass Renderer::Classify(const Instance& instance) const
+{
+  const SceneCore::Material* material = instance.material;
+  if (material == nullptr)
+  {
+    return MaterialClass::Diffuse;
+  }
+  if (material->reflectiveness > 0.0f && material->refractiveness > 0.0f)
+  {
+    return MaterialClass::Glass;
+  }
+  if (material->reflectiveness > 0.0f)
+  {
+    return MaterialClass::Reflective;
+  }
+  if (material->refractiveness > 0.0f)
+  {
+    return MaterialClass::Refractive;
+  }
+  if (material->emittance > 0.0f)
+  {
+    return MaterialClass::Emissive;
+  }
+  return material->roughness > 0.0f ? MaterialClass::Microfacet : MaterialClass::Diffuse;
+}
+
+Renderer::Surface Renderer::GetSurface(const CpuBvh::Ray& ray, const CpuBvh::Hit& hit) const
+{
+  Surface surface;
+  surface.instance = &m_instances[hit.object];
+  surface.position = ray.origin + hit.t * ray.direction;
+
+  const Instance& instance = *surface.instance;
+  const float emittance = instance.material != nullptr ? instance.material->emittance : 0.0f;
+  surface.hitType = emittance != 0.0f ? 1.0f : 0.0f; // 1 is light, 0 is not
+
+  const auto& vertices = instance.mesh->vertices;
+  const std::uint32_t* indices = &instance.mesh->indices[hit.primitive * 3];
+  const SceneCore::Vertex& a = vertices[indices[0]];
+  const SceneCore::Vertex& b = vertices[indices[1]];
+  const SceneCore::Vertex& c = vertices[indices[2]];
+  const glm::vec2 bary = hit.barycentrics;
+
+  glm::vec3 triangleNormal = a.normal + bary.x * (b.normal - a.normal) + bary.y * (c.normal - a.normal);
+  glm::vec2 triangleUV = a.uv + bary.x * (b.uv - a.uv) + bary.y * (c.uv - a.uv);
+  const glm::mat3& rotationScale = instance.object->rotation_scale;
+
+  //if texture map, then sample that instead
+  if (instance.normal != nullptr)
+  {
+    triangleNormal = instance.normal->Sample(triangleUV);
+    triangleNormal.z = -triangleNormal.z;
+    triangleNormal = (triangleNormal * 2.0f) - 1.0f;
+    triangleNormal = glm::normalize(rotationScale * triangleNormal);
+
+    glm::vec3 edge1 = b.position - a.position;
+    glm::vec3 edge2 = c.position - a.position;
+    glm::vec2 deltaUV1 = b.uv - a.uv;
+    glm::vec2 deltaUV2 = c.uv - a.uv;
+
+    float f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
+
+    glm::vec3 tangent = f * (deltaUV2.y * edge1 - deltaUV1.y * edge2);
+    tangent = rotationScale * tangent;
+    tangent = glm::normalize(tangent - glm::dot(tangent, triangleNormal) * triangleNormal);
+
+    glm::vec3 bitangent = glm::cross(triangleNormal, tangent);
+
+    // mul(triangleNormal, float3x3(tangent, bitangent, triangleNormal)), rows are the basis vectors
+    triangleNormal = glm::normalize(triangleNormal.x * tangent + triangleNormal.y * bitangent + triangleNormal.z * triangleNormal);
+  }
+  else
+  {
+    //multiply by rotation/scale matrix to correct the normals
+    triangleNormal = glm::normalize(rotationScale * triangleNormal);
+  }
+
+  surface.normal = triangleNormal;
+  surface.uv = triangleUV;
+  return surface;
+}
+
+// The albedo the denoiser divides out: the specular color of mirrors and glass, the
+// diffuse color otherwise, same as the feature MyClosestHitShader reports.
+Renderer::Features Renderer::GetFeatures(const CpuBvh::Ray& ray, const CpuBvh::Hit& hit) const
+{
+  const Surface surface = GetSurface(ray, hit);
+  const Instance& instance = *surface.instance;
+
+  Features features{ glm::vec3(0.0f), surface.normal, hit.t * glm::length(ray.direction) };
+  if (instance.material != nullptr && (instance.material->reflectiveness > 0.0f || instance.material->refractiveness > 0.0f))
+  {
+    features.albedo = instance.material->specular;
+  }
+  else if (instance.albedo != nullptr)
+  {
+    features.albedo = instance.albedo->Sample(surface.uv);
+  }
+  else if (instance.material != nullptr)
+  {
+    features.albedo = instance.material->diffuse;
+  }
+  return features;
+}
+
+void Renderer::ClosestHit(const CpuBvh::Ray& ray, const CpuBvh::Hit& hit, Payload& payload, Rng& rng) const
+{
+  payload.hitNormal = glm::vec3(0.0f);
+  payload.lightPdf = 0.0f;
+
+  const Surface surface = GetSurface(ray, hit);
+  switch (Classify(*surface.instance))
+  {
+  case MaterialClass::Glass: ShadeGlass(ray, surface, payload, rng); break;
+  case MaterialClass::Reflective: ShadeReflective(ray, surface, payload); break;
+  case MaterialClass::Refractive: ShadeRefractive(ray, surface, payload, rng); break;
+  case MaterialClass::Emissive: ShadeEmissive(ray, hit, surface, payload); break;
+  case MaterialClass::Microfacet: ShadeMicrofacet(ray, surface, payload, rng); break;
+  default: ShadeDiffuse(surface, payload, rng); break;
+  }
+}
+
+void Renderer::Miss(Payload& payload) const
+{
+  payload.color = glm::vec4(0.0f, 0.0f, 0.0f, -1.0f);
+}
+
+void Renderer::ShadeGlass(const CpuBvh::Ray& ray, const Surface& surface, Payload& payload, Rng& rng) const
+{
+  const SceneCore::Material& material = *surface.instance->material;
+  const glm::vec3 worldRayDirection = ray.direction;
+  const glm::vec3& triangleNormal = surface.normal;
+  float indexOfRefraction = material.eta;
+
+  float VdotN = glm::dot(-worldRayDirection, triangleNormal);
+  bool leaving = VdotN < 0.f;
+  float eI = leaving ? indexOfRefraction : 1.f;
+  float eT = leaving ? 1.f : indexOfRefraction;
+
+  float fresnel = EvaluateFresnelDielectric(VdotN, eI, eT) / std::abs(VdotN);
+
+  if (rng.Uniform01() < fresnel) {
+    ReflectiveBounce(material.specular, worldRayDirection, triangleNormal, surface.position, surface.hitType, payload.color, payload.rayOrigin, payload.rayDir);
+    return;
+  }
+
+  // GlassBounce: sample one wavelength, dispersion through the Sellmeier equation
+  float wavelength = 0.0f;
+  float rand = rng.Uniform01();
+  if (rand < 0.33333f)
+  {
+    wavelength = RED_WAVELENGTH_UM;
+    payload.color *= glm::vec4(3.0f, 0.00001f, 0.00001f, 0.0f);
+  }
+  else if (rand < 0.66666f)
+  {
+    wavelength = GREEN_WAVELENGTH_UM;
+    payload.color *= glm::vec4(0.00001f, 3.0f, 0.00001f, 0.0f);
+  }
+  else
+  {
+    wavelength = BLUE_WAVELENGTH_UM;
+    payload.color *= glm::vec4(0.00001f, 0.00001f, 3.0f, 0.0f);
+  }
+
+  indexOfRefraction = SellmeierEquation(wavelength);
+  payload.rayDir = RefractOrReflect(indexOfRefraction, worldRayDirection, triangleNormal, payload.color, rng.Uniform01());
+  payload.rayOrigin = surface.position + payload.rayDir * 0.01f;
+  payload.color = glm::vec4(glm::vec3(payload.color) * material.specular, surface.hitType);
+}
+
+void Renderer::ShadeReflective(const CpuBvh::Ray& ray, const Surface& surface, Payload& payload) const
+{
+  ReflectiveBounce(surface.instance->material->specular, ray.direction, surface.normal, surface.position, surface.hitType, payload.color, payload.rayOrigin, payload.rayDir);
+}
+
+void Renderer::ShadeRefractive(const CpuBvh::Ray& ray, const Surface& surface, Payload& payload, Rng& rng) const
+{
+  // RefractiveBounce
+  const SceneCore::Material& material = *surface.instance->material;
+  payload.rayDir = RefractOrReflect(material.eta, ray.direction, surface.normal, payload.color, rng.Uniform01());
+  payload.rayOrigin = surface.position + payload.rayDir * 0.01f;
+  payload.color = glm::vec4(glm::vec3(payload.color) * material.specular, surface.hitType);
+}
+
+void Renderer::ShadeEmissive(const CpuBvh::Ray& ray, const CpuBvh::Hit& hit, const Surface& surface, Payload& payload) const
+{
+  const Instance& instance = *surface.instance;
+  const SceneCore::Material& material = *instance.material;
+
+  glm::vec3 color(0.0f);
+  if (instance.albedo != nullptr)
+  {
+    color = glm::vec3(payload.color) * instance.albedo->Sample(surface.uv);
+  }
+  else
+  {
+    color = glm::vec3(payload.color) * material.diffuse;
+  }
+
+  payload.color = glm::vec4(color, material.emittance);
+
+  // How likely light sampling was to pick this point, for the MIS weight in TracePath
+  if (instance.light_offset >= 0 && m_lights.GetSampleableCount() > 0)
+  {
+    const LightList::Triangle& light = m_lights.GetTriangles()[instance.light_offset + hit.primitive];
+    glm::vec3 rayDir = glm::normalize(ray.direction);
+    float dist = hit.t * glm::length(ray.direction);
+    float cosLight = std::abs(glm::dot(glm::normalize(glm::cross(light.v1 - light.v0, light.v2 - light.v0)), rayDir));
+    if (light.area > 0.0f && cosLight > 0.0f)
+    {
+      payload.lightPdf = light.pdf / light.area * dist * dist / cosLight;
+    }
+  }
+}
+
+void Renderer::ShadeMicrofacet(const CpuBvh::Ray& ray, const Surface& surface, Payload& payload, Rng& rng) const
+{
+  // MicrofacetBounce
+  using namespace Microfacet;
+  const Instance& instance = *surface.instance;
+  const SceneCore::Material& material = *instance.material;
+
+  glm::vec3 base = instance.albedo != nullptr ? instance.albedo->Sample(surface.uv) : material.diffuse;
+  float metallic = material.metallic;
+  float roughness = material.roughness;
+  if (instance.metallic_roughness != nullptr)
+  {
+    const glm::vec3 texel = instance.metallic_roughness->Sample(surface.uv);
+    metallic *= texel.b;
+    roughness *= texel.g;
+  }
+
+  const glm::vec3 normal = glm::dot(ray.direction, surface.normal) > 0.0f ? -surface.normal : surface.normal;
+  const glm::vec3 rayDir = -glm::normalize(ray.direction);
+  const float3 n(normal.x, normal.y, normal.z);
+  const float3 tangent = MicrofacetTangent(n);
+  const float3 wo = MicrofacetToLocal(float3(rayDir.x, rayDir.y, rayDir.z), tangent, n);
+  const float3 baseColor(base.x, base.y, base.z);
+
+  float u0 = rng.Uniform01();
+  float u1 = rng.Uniform01();
+  float u2 = rng.Uniform01();
+  const float3 wi = MicrofacetSample(baseColor, metallic, roughness, wo, u0, u1, u2);
+  const float pdf = MicrofacetPdf(baseColor, metallic, roughness, wo, wi);
+  const float3 weight = pdf > 0.0f ? MicrofacetEvaluate(baseColor, metallic, roughness, wo, wi) * (1.0f / pdf) : float3();
+
+  const float3 direction = MicrofacetToWorld(wi, tangent, n);
+  payload.rayDir = glm::vec3(direction.x, direction.y, direction.z);
+  payload.rayOrigin = surface.position + payload.rayDir * 0.01f;
+  payload.color = glm::vec4(glm::vec3(payload.color) * glm::vec3(weight.x, weight.y, weight.z), 0.0f);
+}
+
+void Renderer::ShadeDiffuse(const Surface& surface, Payload& payload, Rng& rng) const
+{
+  // DiffuseBounce
+  const Instance& instance = *surface.instance;
+  float u0 = rng.Uniform01();
+  float u1 = rng.Uniform01();
+  payload.rayDir = CalculateRandomDirectionInHemisphere(surface.normal, u0, u1);
+  payload.rayOrigin = surface.position + payload.rayDir * 0.01f;
+
+  glm::vec3 color(0.0f);
+  float emittance = 0.0f;
+  if (instance.albedo != nullptr)
+  {
+    color = glm::vec3(payload.color) * instance.albedo->Sample(surface.uv);
+  }
+  else if (instance.material != nullptr)
+  {
+    color = glm::vec3(payload.color) * instance.material->diffuse;
+  }
+  if (instance.material != nullptr)
+  {
+    emittance = instance.material->emittance;
+  }
+
+  payload.color = glm::vec4(color, emittance);
+  payload.hitNormal = surface.normal;
+}
+
+// The part of TracePath's loop after the hit or miss of one bounce: adds what the path
+// found, samples a light into shadow (contribution stays zero if there is nothing to
+// trace), plays russian roulette and moves ray on. Returns false when the path ends.
+bool Renderer::AdvancePath(int i, int depth, Payload& payload, CpuBvh::Ray& ray, glm::vec3& radiance, float& bouncePdf, ShadowRay& shadow, Rng& rng) const
+{
+  shadow.contribution = glm::vec3(0.0f);
+  const bool nextEventEstimation = (m_settings.features & NextEventEstimation) && m_lights.GetSampleableCount() > 0;
+
+  if (payload.color.w == 0) {
+    bouncePdf = 0.0f;
+    if (nextEventEstimation && payload.hitNormal != glm::vec3(0.0f)) {
+      if (i < depth - 1) {
+        glm::vec3 hitPosition = payload.rayOrigin - payload.rayDir * 0.01f;
+        SampleDirectLight(hitPosition, payload.hitNormal, glm::vec3(payload.color), shadow, rng);
+      }
+      bouncePdf = std::max(glm::dot(payload.hitNormal, payload.rayDir), 0.0f) * INV_PI_F;
+    }
+
+    if ((m_settings.features & RussianRoulette) && i >= static_cast<int>(m_settings.rr_min_depth) && i < depth - 1) {
+      float survival = std::min(std::max(payload.color.r, std::max(payload.color.g, payload.color.b)), 1.0f);
+      if (rng.Uniform01() >= survival) {
+        return false;
+      }
+      payload.color = glm::vec4(glm::vec3(payload.color) / survival, payload.color.w);
+    }
+
+    ray.origin = payload.rayOrigin;
+    ray.direction = payload.rayDir;
+    payload.color.w = -1.0f;
+    if (i == depth - 1) {
+      payload.color = glm::vec4(0.0f);
+    }
+    return true;
+  }
+
+  if (payload.color.w > 0) {
+    float weight = 1.0f;
+    if (bouncePdf > 0.0f && payload.lightPdf > 0.0f) {
+      weight = PowerHeuristic(bouncePdf, payload.lightPdf);
+    }
+    radiance += glm::vec3(payload.color) * weight;
+  }
+  return false;
+}
+
+void Renderer::CountSegment(int bounce, float hit, bool alive, Statistics& statistics)
+{
+  using namespace RayStats;
+  statistics.rays[RayStatSegments] += 1;
+  statistics.rays[RayStatDepth + std::min(bounce, RAY_STATS_MAX_DEPTH - 1)] += 1;
+  statistics.rays[hit == 0 ? RayStatClosestHits : hit > 0 ? RayStatLightHits : RayStatMisses] += 1;
+  // a bounce that ends the path is russian roulette
+  statistics.rays[RayStatTerminated] += hit == 0 && !alive ? 1 : 0;
+}
+
+glm::vec3 Renderer::TracePath(glm::uvec2 pixel, std::uint32_t id, std::uint32_t sampleIndex, int depth, Statistics& statistics, Features& features, Rng& rng) const
+{
+  rng.Seed(id, sampleIndex, depth);
+
+  glm::vec3 origin;
+  glm::vec3 rayDir;
+  GenerateCameraRay(pixel, origin, rayDir, rng);
+
+  CpuBvh::Ray ray;
+  ray.origin = origin;
+  ray.direction = rayDir;
+  ray.t_min = 0.001f;
+  ray.t_max = 10000.0f;
+
+  Payload payload{ glm::vec4(1.0f, 1.0f, 1.0f, -1.0f), glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f), 0.0f };
+
+  glm::vec3 radiance(0.0f);
+  float bouncePdf = 0.0f;
+  features = Features{ glm::vec3(0.0f), glm::vec3(0.0f), 0.0f };
+  statistics.rays[RayStats::RayStatPaths] += 1;
+
+  for (int i = 0; i < depth; i++) {
+    CpuBvh::Hit hit;
+    if (m_bvh.Intersect(ray, hit, &statistics.traversal)) {
+      if (i == 0) {
+        features = GetFeatures(ray, hit);
+      }
+      ClosestHit(ray, hit, payload, rng);
+    }
+    else {
+      Miss(payload);
+    }
+    rng.Seed(id, sampleIndex, i);
+
+    ShadowRay shadow;
+    const float hitType = payload.color.w;
+    const bool alive = AdvancePath(i, depth, payload, ray, radiance, bouncePdf, shadow, rng);
+    CountSegment(i, hitType, alive, statistics);
+    if (shadow.contribution != glm::vec3(0.0f) && IsVisible(shadow.origin, shadow.target, statistics)) {
+      radiance += shadow.contribution;
+    }
+    if (!alive) {
+      break;
+    }
+  }
+
+  return radiance;
+}
+
+void Renderer::RenderTile(unsigned int tile, Statistics& statistics)
+{
+  const unsigned int x0 = (tile % m_tilesX) * m_settings.tile_size;
+  const unsigned int y0 = (tile / m_tilesX) * m_settings.tile_size;
+  const unsigned int x1 = std::min(x0 + m_settings.tile_size, m_settings.width);
+  const unsigned int y1 = std::min(y0 + m_settings.tile_size, m_settings.height);
+  const int depth = static_cast<int>(m_settings.depth);
+
+  Rng rng(m_settings.sampler, m_settings.width);
+  for (unsigned int y = y0; y < y1; y++)
+  {
+    for (unsigned int x = x0; x < x1; x++)
+    {
+      const std::uint32_t id = x + m_settings.width * y;
+      glm::vec4& accumulated = m_accumulation[id];
+      std::uint32_t sampleCount = static_cast<std::uint32_t>(accumulated.w);
+
+      for (unsigned int s = 0; s < m_settings.samples_per_pixel; s++)
+      {
+        sampleCount += 1;
+        Features features;
+        const glm::vec3 color = TracePath(glm::uvec2(x, y), id, sampleCount, depth, statistics, features, rng);
+        accumulated += glm::vec4(color, 0.0f);
+        m_moments[id] += color * color;
+        m_albedoDepth[id] += glm::vec4(features.albedo, features.distance);
+        m_normals[id] += features.normal;
+      }
+
+      accumulated.w = static_cast<float>(sampleCount);
+    }
+  }
+}
+
+bool Renderer::Render(const std::atomic<bool>* cancel)
+{
+  PROFILE_SCOPE("Render");
+  const unsigned int tileCount = m_tilesX * m_tilesY;
+  unsigned int threadCount = m_settings.threads > 0 ? m_settings.threads : std::thread::hardware_concurrency();
+  threadCount = std::max(1u, std::min(threadCount, tileCount));
+
+  m_nextTile = 0;
+  m_finishedTiles = 0;
+
+  const auto start = std::chrono::steady_clock::now();
+
+  // statistics and wavefront queues per thread, merged into the statistics at the end
+  std::vector<Wavefront> wavefronts(m_settings.wavefront ? threadCount : 0);
+  std::vector<Statistics> threadStatistics(m_settings.wavefront ? 0 : threadCount);
+
+  auto Worker = [&](unsigned int threadIndex)
+  {
+    PROFILE_SCOPE("Render tiles");
+    for (unsigned int tile = m_nextTile++; tile < tileCount; tile = m_nextTile++)
+    {
+      if (cancel != nullptr && *cancel)
+      {
+        break;
+      }
+
+      PROFILE_SCOPE("Tile");
+      if (m_settings.wavefront)
+      {
+        RenderTileWavefront(tile, wavefronts[threadIndex]);
+      }
+      else
+      {
+        RenderTile(tile, threadStatistics[threadIndex]);
+      }
+      m_finishedTiles++;
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned int i = 1; i < threadCount; i++)
+  {
+    threads.emplace_back([&Worker, i]()
+    {
+      Profiler::SetThreadName("render worker");
+      Worker(i);
+    });
+  }
+  Worker(0);
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+
+  for (const auto& wavefront : wavefronts)
+  {
+    threadStatistics.push_back(wavefront.statistics);
+  }
+  auto AddCounters = [](CpuBvh::Counters& to, const CpuBvh::Counters& from)
+  {
+    to.rays += from.rays;
+    to.nodes += from.nodes;
+    to.triangles += from.triangles;
+  };
+  for (const Statistics& lanes : threadStatistics)
+  {
+    m_statistics.paths += lanes.rays[RayStats::RayStatPaths];
+    m_statistics.segments += lanes.rays[RayStats::RayStatSegments];
+    for (std::size_t r = 0; r < RayStats::RayStatCount; r++)
+    {
+      m_statistics.rays[r] += lanes.rays[r];
+    }
+    AddCounters(m_statistics.traversal, lanes.traversal);
+    AddCounters(m_statistics.shadow_traversal, lanes.shadow_traversal);
+
+    for (std::size_t c = 0; c < MaterialClassCount; c++)
+    {
+      m_statistics.queued[c] += lanes.queued[c];
+    }
+    m_statistics.live_lanes += lanes.live_lanes;
+    m_statistics.wave_lanes += lanes.wave_lanes;
+    m_statistics.shaded_lanes += lanes.shaded_lanes;
+    m_statistics.wavefront_lanes += lanes.wavefront_lanes;
+    m_statistics.megakernel_lanes += lanes.megakernel_lanes;
+  }
+  m_statistics.render_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  return m_finishedTiles == tileCount;
+}
+
+float Renderer::GetProgress() const
+{
+  const unsigned int tileCount = m_tilesX * m_tilesY;
+  return tileCount > 0 ? static_cast<float>(m_finishedTiles) / tileCount : 1.0f;
+}
+
+std::vector<glm::vec3> Renderer::Resolve() const
+{
+  std::vector<glm::vec3> image(m_accumulation.size());
+  for (std::size_t i = 0; i < image.size(); i++)
+  {
+    const glm::vec4& accumulated = m_accumulation[i];
+    image[i] = glm::clamp(glm::vec3(accumulated) / std::max(accumulated.w, 1.0f), 0.0f, 1.0f);
+  }
+  return image;
+}
+
+bool Renderer::SavePng(const std::string& path) const
+{
+  return SavePng(path, Resolve());
+}
+
+bool Renderer::SavePng(const std::string& path, const std::vector<glm::vec3>& image) const
+{
+  std::vector<unsigned char> pixels(image.size() * 3);
+  for (std::size_t i = 0; i < image.size(); i++)
+  {
+    for (int c = 0; c < 3; c++)
+    {
+      pixels[i * 3 + c] = static_cast<unsigned char>(std::min(std::max(image[i][c], 0.0f), 1.0f) * 255.0f + 0.5f);
+    }
+  }
+  return stbi_write_png(path.c_str(), m_settings.width, m_settings.height, 3, pixels.data(), m_settings.width * 3) != 0;
+}
+
+}
@@ -0,0 +1,331 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm/glm.hpp>
+
+#include "CpuBvh.h"
+#include "LightList.h"
+#include "SceneCore.h"
+#include "shaders/RayStatsHlslCompat.h"
+#include "shaders/SamplingHlslCompat.h"
+
+//
+// CpuPathTracer - headless CPU reference of Raytracing.hlsl.
+//
+// MyRaygenShader, TracePath and MyClosestHitShader are ported line by line, with the
+// same random number sequence per pixel and sample, the same camera and the same light
+// list, so an image rendered here converges to what the GPU converges to. It serves
+// as a correctness oracle for the shaders and renders on machines without a GPU.
+// The image is split into tiles that the worker threads take from a shared counter.
+//
+// Where the shader depends on DXR details the port uses what the code says:
+// random numbers come from one state per path across TraceRay calls. Settings::sampler
+// picks the same sampler as the Sampler combo, SamplingHlslCompat.h is shared.
+//
+// Settings::wavefront renders the same paths as a wavefront integrator instead
+// (CpuWavefront.cpp): every bounce intersects all live paths of a wave, sorts the
+// hits into one queue per material class, shades each queue with its own kernel and
+// compacts the dead paths away. Each path keeps its random numbers, so both modes
+// produce the same image.
+//
+// Next to the color every pixel accumulates the squared samples and the albedo, normal
+// and distance of the first hit, the inputs of the denoiser (Denoiser.h).
+//
+// Statistics::rays counts what the RayStatistics feature of the shader counts, in the
+// same layout, with the nodes and triangles the BVH visited for them next to it, which
+// DXR does not tell.
+//
+namespace CpuPathTracer {
+
+// Same values as Feature in RayTracingHlslCompat.h.
+enum Features : std::uint32_t
+{
+  AntiAliasing = 1,
+  DepthOfField = 2,
+  NextEventEstimation = 8,
+  RussianRoulette = 16,
+};
+
+// The branches of MyClosestHitShader plus the miss shader, one wavefront queue each.
+enum class MaterialClass : std::uint32_t
+{
+  Glass,
+  Reflective,
+  Refractive,
+  Emissive,
+  Microfacet,
+  Diffuse,
+  Miss,
+  Count
+};
+
+const std::size_t MaterialClassCount = static_cast<std::size_t>(MaterialClass::Count);
+const char* GetMaterialClassName(MaterialClass materialClass);
+
+// Lanes per group when the wavefront statistics count SIMD utilization.
+const unsigned int SimdWidth = 8;
+
+struct Settings
+{
+  unsigned int width = 1280;
+  unsigned int height = 720;
+  unsigned int samples_per_pixel = 64;
+  unsigned int depth = 5;
+  std::uint32_t features = AntiAliasing | NextEventEstimation | RussianRoulette;
+  unsigned int rr_min_depth = 3;
+  unsigned int tile_size = 32;
+  unsigned int threads = 0; // 0 uses every core
+  bool wavefront = false;
+  std::uint32_t sampler = Sampling::SobolSampler;
+};
+
+struct Statistics
+{
+  std::uint64_t paths = 0;
+  std::uint64_t segments = 0; // path segments, shadow rays not included
+  double build_seconds = 0.0;
+  double render_seconds = 0.0;
+
+  // RayStatsHlslCompat.h counters, paths and segments are the first two
+  std::uint64_t rays[RayStats::RayStatCount] = {};
+  CpuBvh::Counters traversal;        // path segments
+  CpuBvh::Counters shadow_traversal; // shadow rays
+
+  // Wavefront mode only. live_lanes over wave_lanes is how full the intersection pass
+  // would be without compaction. Shading counts lanes in groups of SimdWidth:
+  // wavefront_lanes is what the per class kernels issue, megakernel_lanes what a single
+  // kernel over the same uncompacted paths would issue with every class present in a
+  // group run for the whole group.
+  std::uint64_t queued[MaterialClassCount] = {};
+  std::uint64_t live_lanes = 0;
+  std::uint64_t wave_lanes = 0;
+  std::uint64_t shaded_lanes = 0;
+  std::uint64_t wavefront_lanes = 0;
+  std::uint64_t megakernel_lanes = 0;
+};
+
+class Renderer
+{
+public:
+  // Builds the BVH and the light list, the scene has to outlive the renderer.
+  Renderer(const SceneCore::SceneData& scene, const Settings& settings);
+
+  // Adds samples_per_pixel samples to every pixel, on all threads, and blocks until done.
+  // Returns false if cancel was raised, finished tiles keep their samples.
+  bool Render(const std::atomic<bool>* cancel = nullptr);
+
+  // rgb sums and the sample count in w, same as RenderTarget2.
+  const std::vector<glm::vec4>& GetAccumulation() const { return m_accumulation; }
+  // Sums of the squared samples, same as SecondMoment.
+  const std::vector<glm::vec3>& GetMoments() const { return m_moments; }
+  // Sums of the first hit albedo with the hit distance in w and of the first hit normal,
+  // same as AlbedoDepth and NormalSum. The guides of the denoiser.
+  const std::vector<glm::vec4>& GetAlbedoDepth() const { return m_albedoDepth; }
+  const std::vector<glm::vec3>& GetNormals() const { return m_normals; }
+  // The averages clamped to [0, 1], what RenderTarget shows.
+  std::vector<glm::vec3> Resolve() const;
+  bool SavePng(const std::string& path) const;
+  // Writes an image of the same size, clamped to [0, 1], a denoised one for instance.
+  bool SavePng(const std::string& path, const std::vector<glm::vec3>& image) const;
+
+  const Settings& GetSettings() const { return m_settings; }
+  const Statistics& GetStatistics() const { return m_statistics; }
+  std::size_t GetTriangleCount() const { return m_bvh.GetTriangleCount(); }
+  std::size_t GetLightCount() const { return m_lights.GetCount(); }
+
+  // Finished tiles of the current Render call over all of them.
+  float GetProgress() const;
+
+private:
+  struct Instance
+  {
+    const SceneCore::Object* object;
+    const SceneCore::Mesh* mesh;
+    const SceneCore::Material* material;
+    const SceneCore::Texture* albedo;
+    const SceneCore::Texture* normal;
+    const SceneCore::Texture* metallic_roughness;
+    std::int64_t light_offset; // first entry in m_lights, -1 if not a light
+  };
+
+  // ComputeRngSeed and Uniform01 of the shader.
+  class Rng
+  {
+  public:
+    Rng(std::uint32_t sampler = Sampling::RandomSampler, std::uint32_t width = 1) :
+      m_sampler(sampler),
+      m_width(width)
+    {
+    }
+
+    void Seed(std::uint32_t index, std::uint32_t iteration, std::uint32_t depth)
+    {
+      m_state = WangHash((1u << 31) | (depth << 22) | iteration) ^ WangHash(index);
+      m_pixel = index;
+      m_sample = iteration - 1;
+      m_dimension = depth * Sampling::SAMPLER_DIMENSIONS_PER_SEED;
+    }
+
+    float Uniform01()
+    {
+      if (m_sampler != Sampling::RandomSampler)
+      {
+        return Sampling::SampleDimension(m_sampler, m_pixel % m_width, m_pixel / m_width, m_sample, m_dimension++);
+      }
+      m_state ^= m_state << 13;
+      m_state ^= m_state >> 17;
+      m_state ^= m_state << 5;
+      return static_cast<float>(m_state * (1.0 / 4294967296.0));
+    }
+
+  private:
+    static std::uint32_t WangHash(std::uint32_t seed)
+    {
+      seed = (seed ^ 61) ^ (seed >> 16);
+      seed *= 9;
+      seed = seed ^ (seed >> 4);
+      seed *= 0x27d4eb2d;
+      seed = seed ^ (seed >> 15);
+      return seed;
+    }
+
+    std::uint32_t m_state = 0;
+    std::uint32_t m_sampler;
+    std::uint32_t m_width;
+    std::uint32_t m_pixel = 0;
+    std::uint32_t m_sample = 0;
+    std::uint32_t m_dimension = 0;
+  };
+
+  // RayPayload of the shader.
+  struct Payload
+  {
+    glm::vec4 color;
+    glm::vec3 rayOrigin;
+    glm::vec3 rayDir;
+    glm::vec3 hitNormal;
+    float lightPdf;
+  };
+
+  // What MyClosestHitShader computes before it branches on the material.
+  struct Surface
+  {
+    const Instance* instance;
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 uv;
+    float hitType;
+  };
+
+  // What the camera ray hits first, summed into the auxiliary buffers.
+  struct Features
+  {
+    glm::vec3 albedo;
+    glm::vec3 normal;
+    float distance; // zero on a miss
+  };
+
+  // Light sample of one bounce, added if target is visible from origin.
+  struct ShadowRay
+  {
+    glm::vec3 origin;
+    glm::vec3 target;
+    glm::vec3 contribution;
+  };
+
+  // Per thread storage of the wavefront integrator, structure of arrays indexed by lane.
+  // Lanes are the live paths of a wave, packed to the front after every bounce.
+  struct Wavefront
+  {
+    // path state
+    std::vector<glm::vec3> origin;
+    std::vector<glm::vec3> direction;
+    std::vector<glm::vec4> color;
+    std::vector<float> bounce_pdf;
+    std::vector<Rng> rng;
+    std::vector<std::uint32_t> slot; // path of the wave, indexes radiance
+    std::vector<std::uint32_t> pixel; // id and sample the generator is seeded with
+    std::vector<std::uint32_t> sample;
+
+    // intersection results and shading outputs of the current bounce
+    std::vector<CpuBvh::Hit> hit;
+    std::vector<MaterialClass> material_class;
+    std::vector<glm::vec3> next_origin;
+    std::vector<glm::vec3> next_direction;
+    std::vector<glm::vec3> hit_normal;
+    std::vector<float> light_pdf;
+
+    // lane indices sorted by material class, queue c is [queue_begin[c], queue_begin[c + 1])
+    std::vector<std::uint32_t> queue;
+    std::uint32_t queue_begin[MaterialClassCount + 1];
+
+    // shadow rays of the bounce, traced after shading
+    std::vector<glm::vec3> shadow_origin;
+    std::vector<glm::vec3> shadow_target;
+    std::vector<glm::vec3> shadow_contribution;
+    std::vector<std::uint32_t> shadow_slot;
+
+    // indexed by slot, not compacted
+    std::vector<glm::vec3> radiance;
+    std::vector<Features> features;
+    std::vector<std::uint8_t> group_classes; // class bits per SimdWidth slots, for megakernel_lanes
+
+    Statistics statistics;
+
+    void Resize(std::size_t lanes);
+  };
+
+  void BuildLightList();
+  void RenderTile(unsigned int tile, Statistics& statistics);
+  void RenderTileWavefront(unsigned int tile, Wavefront& wavefront);
+  glm::vec3 TracePath(glm::uvec2 pixel, std::uint32_t id, std::uint32_t sampleIndex, int depth, Statistics& statistics, Features& features, Rng& rng) const;
+  // Counts one path segment, hit is the w of the payload color the segment came back
+  // with and alive what AdvancePath made of it.
+  static void CountSegment(int bounce, float hit, bool alive, Statistics& statistics);
+  bool AdvancePath(int bounce, int depth, Payload& payload, CpuBvh::Ray& ray, glm::vec3& radiance, float& bouncePdf, ShadowRay& shadow, Rng& rng) const;
+  void GenerateCameraRay(glm::uvec2 pixel, glm::vec3& origin, glm::vec3& direction, Rng& rng) const;
+
+  MaterialClass Classify(const Instance& instance) const;
+  Surface GetSurface(const CpuBvh::Ray& ray, const CpuBvh::Hit& hit) const;
+  Features GetFeatures(const CpuBvh::Ray& ray, const CpuBvh::Hit& hit) const;
+  void ClosestHit(const CpuBvh::Ray& ray, const CpuBvh::Hit& hit, Payload& payload, Rng& rng) const;
+  void Miss(Payload& payload) const;
+  void ShadeGlass(const CpuBvh::Ray& ray, const Surface& surface, Payload& payload, Rng& rng) const;
+  void ShadeReflective(const CpuBvh::Ray& ray, const Surface& surface, Payload& payload) const;
+  void ShadeRefractive(const CpuBvh::Ray& ray, const Surface& surface, Payload& payload, Rng& rng) const;
+  void ShadeEmissive(const CpuBvh::Ray& ray, const CpuBvh::Hit& hit, const Surface& surface, Payload& payload) const;
+  void ShadeMicrofacet(const CpuBvh::Ray& ray, const Surface& surface, Payload& payload, Rng& rng) const;
+  void ShadeDiffuse(const Surface& surface, Payload& payload, Rng& rng) const;
+
+  void SampleDirectLight(const glm::vec3& position, const glm::vec3& normal, const glm::vec3& throughput, ShadowRay& shadow, Rng& rng) const;
+  bool IsVisible(const glm::vec3& origin, const glm::vec3& target, Statistics& statistics) const;
+
+  const SceneCore::SceneData& m_scene;
+  Settings m_settings;
+  CpuBvh m_bvh;
+  std::vector<Instance> m_instances;
+  LightList m_lights;
+
+  // camera basis, the unprojection of XMMatrixLookAtLH and XMMatrixPerspectiveFovLH
+  glm::vec3 m_eye;
+  glm::vec3 m_forward;
+  glm::vec3 m_right;
+  glm::vec3 m_up;
+  float m_tanHalfFov;
+  float m_aspect;
+
+  std::vector<glm::vec4> m_accumulation;
+  std::vector<glm::vec3> m_moments;
+  std::vector<glm::vec4> m_albedoDepth;
+  std::vector<glm::vec3> m_normals;
+  unsigned int m_tilesX = 0;
+  unsigned int m_tilesY = 0;
+  std::atomic<unsigned int> m_nextTile{ 0 };
+  std::atomic<unsigned int> m_finishedTiles{ 0 };
+  Statistics m_statistics;
+};
+
+}
@@ -0,0 +1,1032 @@
+#include "CpuRender.h"
+#include "CpuRenderCommon.h"
+#include "Benchmark.h"
+#include "BvhQuality.h"
+#include "CpuPathTracer.h"
+#include "Denoiser.h"
+#include "ImageCompare.h"
+#include "ImageWriter.h"
+#include "Profiler.h"
+#include "SceneCore.h"
+#include "SceneParser.h"
+#include "SceneConvert.h"
+#include "SceneStats.h"
+#include "ShaderPermutation.h"
+#include "shaders/MicrofacetHlslCompat.h"
+#include "json.hpp"
+#include "checks/Checks.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <thread>
+
+#ifndef _WIN32
+// the Win32 build gets these from Scene.cpp and MeshLoader.cpp
+#define TINYOBJLOADER_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "include/tiny_obj_loader.h"
+#include "include/stb_image.h"
+#include "include/stb_image_write.h"
+#endif
+
+namespace CpuRender {
+
+namespace {
+
+const char* c_usage =
+  "usage: -cpu [options] [scene ...]\n"
+  "  --width N, --height N   image size (1280 x 720)\n"
+  "  --spp N                 samples per pixel (64, 16 when benchmarking)\n"
+  "  --depth N               path depth (5, like the GPU default)\n"
+  "  --rr-min-depth N        bounces before russian roulette (from the scene camera)\n"
+  "  --no-aa, --dof, --no-nee, --no-rr\n"
+  "                          toggle the same features as the Features panel\n"
+  "  --threads N             worker threads (all cores)\n"
+  "  --tile N                tile size in pixels (32)\n"
+  "  --wavefront             wavefront integrator with per material queues, reports lane use\n"
+  "  --ray-stats             rays per bounce, hits, misses and shadow rays like the Ray\n"
+  "                          statistics panel, with the BVH nodes and triangles per ray\n"
+  "  --sampler NAME          random, sobol or bluenoise (sobol)\n"
+  "  --denoise               run the a-trous denoiser over the image before saving it\n"
+  "  --denoise-iterations N  a-trous iterations, 0 to 5 (5)\n"
+  "  --microfacet-lut FILE   recompute the energy table into FILE, normally\n"
+  "                          src/shaders/MicrofacetEnergyHlslCompat.h\n"
+  "  --profile FILE          write a chrome trace of the loads, BVH builds and render\n"
+  "                          tiles of the run to FILE (chrome://tracing, perfetto)\n"
+  "  --out FILE              image to write, single scene only (cpu_render.png); the\n"
+  "                          extension picks exr, hdr, png, jpg or bmp\n"
+  "  --exr-float, --exr-uncompressed\n"
+  "                          32 bit float or uncompressed exr instead of half with zip\n"
+  "  --benchmark             time parsing, decoding, BVH and light list builds and\n"
+  "                          rendering of every scene (src/scenes/*.txt), 320 x 180 at\n"
+  "                          16 spp by default, and print the medians; saves no images\n"
+  "  --runs N                measured runs per scene after a warm-up run (5)\n"
+  "  --benchmark-out FILE    write the runs and their medians and variance, CSV for a\n"
+  "                          .csv FILE, JSON otherwise\n"
+  "  --baseline FILE         compare with a JSON --benchmark-out of the same settings,\n"
+  "                          exit code 1 if a phase got slower by more than --threshold\n"
+  "  --threshold PERCENT     slowdown of a median that fails --baseline (10)\n"
+  "  --golden DIR            render every scene (src/scenes/*.txt), 128 x 72 at 64 spp\n"
+  "                          by default, and compare them with the golden images in DIR\n"
+  "                          (src/golden) by RMSE, SSIM and FLIP, exit code 1 if one is\n"
+  "                          further off than the noise of both explains\n"
+  "  --golden-update         render the golden images into DIR instead, 1024 spp by\n"
+  "                          default\n"
+  "  --diff-out DIR          where --golden writes the FLIP heat maps, and the renders\n"
+  "                          that failed (golden_diff)\n"
+  "  --jobs N                scenes --golden renders at once (one per core)\n"
+  "  --scene-stats           print the triangles, vertices, memory, descriptors and\n"
+  "                          object overlaps of every scene (src/scenes/*.txt); renders\n"
+  "                          nothing\n"
+  "  --stats-out FILE        write the full --scene-stats reports to FILE as JSON\n"
+  "  --checks                run every check below but the measurements of rendered\n"
+  "                          references, exit code 1 if one fails\n";
+
+// The usage with the checks of checks/.
+std::string GetUsage()
+{
+  std::string usage = c_usage;
+  for (const Checks::Suite& suite : Checks::GetSuites())
+  {
+    usage += suite.usage;
+  }
+  return usage;
+}
+
+}
+
+const char* const c_samplerNames[] = { "random", "sobol", "bluenoise" };
+const std::uint32_t c_samplerCount = 3;
+
+bool LoadScene(const std::string& path, SceneCore::SceneData& scene)
+{
+  std::string error;
+  std::vector<std::string> warnings;
+  const bool loaded = SceneCore::LoadSceneFile(path, scene, error, warnings);
+  for (const auto& warning : warnings)
+  {
+    fprintf(stderr, "%s: warning: %s\n", path.c_str(), warning.c_str());
+  }
+  if (!loaded)
+  {
+    fprintf(stderr, "%s\n", error.c_str());
+  }
+  return loaded;
+}
+
+CpuPathTracer::Settings GetSceneSettings(const CpuPathTracer::Settings& settings, const SceneCore::SceneData& scene, bool rrDisabled, int rrMinDepth)
+{
+  CpuPathTracer::Settings sceneSettings = settings;
+  const bool rr = scene.camera.russian_roulette && !rrDisabled;
+  sceneSettings.features = rr ? (sceneSettings.features | CpuPathTracer::RussianRoulette) : (sceneSettings.features & ~CpuPathTracer::RussianRoulette);
+  sceneSettings.rr_min_depth = static_cast<unsigned int>(std::max(rrMinDepth >= 0 ? rrMinDepth : scene.camera.rr_min_depth, 0));
+  return sceneSettings;
+}
+
+Denoiser::Input GetDenoiserInput(const CpuPathTracer::Renderer& renderer)
+{
+  Denoiser::Input input;
+  input.width = renderer.GetSettings().width;
+  input.height = renderer.GetSettings().height;
+  input.color = renderer.GetAccumulation().data();
+  input.moments = renderer.GetMoments().data();
+  input.albedo_depth = renderer.GetAlbedoDepth().data();
+  input.normals = renderer.GetNormals().data();
+  return input;
+}
+
+const std::uint32_t c_microfacetEnergySamples = 8192;
+
+std::vector<float> ComputeMicrofacetEnergyTable()
+{
+  using namespace Microfacet;
+  std::vector<float> table(2 * MICROFACET_ENERGY_SIZE * MICROFACET_ENERGY_SIZE);
+  for (std::uint32_t r = 0; r < MICROFACET_ENERGY_SIZE; r++)
+  {
+    for (std::uint32_t c = 0; c < MICROFACET_ENERGY_SIZE; c++)
+    {
+      const std::size_t at = 2 * (r * MICROFACET_ENERGY_SIZE + c);
+      ComputeMicrofacetEnergy(float(c) / (MICROFACET_ENERGY_SIZE - 1), float(r) / (MICROFACET_ENERGY_SIZE - 1), c_microfacetEnergySamples, table[at], table[at + 1]);
+    }
+  }
+  return table;
+}
+
+// Regenerates shaders/MicrofacetEnergyHlslCompat.h after a change to the lobe.
+int WriteMicrofacetEnergy(const std::string& path)
+{
+  const std::vector<float> table = ComputeMicrofacetEnergyTable();
+  FILE* file = fopen(path.c_str(), "w");
+  if (file == nullptr)
+  {
+    fprintf(stderr, "cannot write %s\n", path.c_str());
+    return 1;
+  }
+  fprintf(file,
+          "//\n"
+          "// MicrofacetEnergyHlslCompat.h - directional albedo of the GGX lobe of MicrofacetHlslCompat.h,\n"
+          "// generated by cpu_render --microfacet-lut, do not edit.\n"
+          "//\n"
+          "// A and B of E = F0 A + B, interleaved, on a %u x %u grid from 0 to 1: the cosine of wo\n"
+          "// along a row, the roughness down the rows. %u visible normal samples per entry.\n"
+          "//\n\n"
+          "#ifndef MICROFACETENERGYHLSLCOMPAT_H\n"
+          "#define MICROFACETENERGYHLSLCOMPAT_H\n\n"
+          "static const uint MICROFACET_ENERGY_SIZE = %u;\n\n"
+          "static const float c_microfacetEnergy[%zu] =\n{\n",
+          Microfacet::MICROFACET_ENERGY_SIZE, Microfacet::MICROFACET_ENERGY_SIZE, c_microfacetEnergySamples,
+          Microfacet::MICROFACET_ENERGY_SIZE, table.size());
+  for (std::size_t i = 0; i < table.size(); i += 8)
+  {
+    fprintf(file, " ");
+    for (std::size_t j = i; j < std::min(i + 8, table.size()); j++)
+    {
+      fprintf(file, " %.6ff,", table[j]);
+    }
+    fprintf(file, "\n");
+  }
+  fprintf(file, "};\n\n#endif // MICROFACETENERGYHLSLCOMPAT_H\n");
+  const bool written = fclose(file) == 0;
+  printf("%s %s\n", written ? "wrote" : "FAILED to write", path.c_str());
+  return written ? 0 : 1;
+}
+
+// The counters of the Ray statistics panel, from the CPU reference.
+void PrintRayStatistics(const CpuPathTracer::Statistics& stats)
+{
+  using namespace RayStats;
+  const std::uint64_t* rays = stats.rays;
+  const double seconds = std::max(stats.render_seconds, 1e-9);
+  const std::uint64_t traced = rays[RayStatSegments] + rays[RayStatShadowRays];
+  auto Percent = [](std::uint64_t part, std::uint64_t whole) { return whole > 0 ? 100.0 * part / whole : 0.0; };
+  auto PerRay = [](std::uint64_t work, std::uint64_t count) { return count > 0 ? double(work) / count : 0.0; };
+
+  printf("  rays: %.3f M/s, %llu segments and %llu shadow rays (%.1f%% occluded)\n", traced / seconds / 1e6,
+         static_cast<unsigned long long>(rays[RayStatSegments]), static_cast<unsigned long long>(rays[RayStatShadowRays]),
+         Percent(rays[RayStatShadowOccluded], rays[RayStatShadowRays]));
+  printf("  segments: %.1f%% closest hit, %.1f%% light, %.1f%% miss, %.1f%% of the paths ended by russian roulette\n",
+         Percent(rays[RayStatClosestHits], rays[RayStatSegments]), Percent(rays[RayStatLightHits], rays[RayStatSegments]),
+         Percent(rays[RayStatMisses], rays[RayStatSegments]), Percent(rays[RayStatTerminated], rays[RayStatPaths]));
+  printf("  per bounce:");
+  for (int d = 0; d < RAY_STATS_MAX_DEPTH && rays[RayStatDepth + d] > 0; d++)
+  {
+    printf(" %llu", static_cast<unsigned long long>(rays[RayStatDepth + d]));
+  }
+  printf("\n");
+  printf("  bvh per segment: %.1f nodes, %.1f triangles; per shadow ray: %.1f nodes, %.1f triangles\n",
+         PerRay(stats.traversal.nodes, stats.traversal.rays), PerRay(stats.traversal.triangles, stats.traversal.rays),
+         PerRay(stats.shadow_traversal.nodes, stats.shadow_traversal.rays), PerRay(stats.shadow_traversal.triangles, stats.shadow_traversal.rays));
+}
+
+const double c_benchmarkMinimumMilliseconds = 0.5;
+
+// Everything a benchmark run depends on but the scene, see Benchmark.h.
+std::string DescribeBenchmarkSettings(const CpuPathTracer::Settings& settings, const BenchmarkOptions& options)
+{
+  const unsigned int threads = settings.threads > 0 ? settings.threads : std::max(std::thread::hardware_concurrency(), 1u);
+  char text[256];
+  snprintf(text, sizeof(text), "%ux%u, %u spp, depth %u, features %u, sampler %s, rr %s, rr min depth %d, tile %u, %s, %u threads", settings.width,
+           settings.height, settings.samples_per_pixel, settings.depth, settings.features, c_samplerNames[std::min(settings.sampler, c_samplerCount - 1)],
+           options.rr_disabled ? "off" : "scene", options.rr_min_depth, settings.tile_size, settings.wavefront ? "wavefront" : "megakernel", threads);
+  return text;
+}
+
+bool RunBenchmarkScene(const std::string& path, const CpuPathTracer::Settings& settings, const BenchmarkOptions& options, bool quiet,
+                       Benchmark::SceneResult& result, std::vector<std::pair<std::string, double>>& phases)
+{
+  std::vector<Profiler::Event> events;
+  Profiler::Collect(events);
+  events.clear();
+
+  const auto start = std::chrono::steady_clock::now();
+  SceneCore::SceneData scene;
+  std::string error;
+  std::vector<std::string> warnings;
+  if (!SceneCore::LoadSceneFile(path, scene, error, warnings))
+  {
+    fprintf(stderr, "%s\n", error.c_str());
+    return false;
+  }
+  for (const auto& warning : warnings)
+  {
+    if (!quiet)
+    {
+      fprintf(stderr, "%s: warning: %s\n", path.c_str(), warning.c_str());
+    }
+  }
+
+  CpuPathTracer::Renderer renderer(scene, GetSceneSettings(settings, scene, options.rr_disabled, options.rr_min_depth));
+  renderer.Render();
+  const double total = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+  Profiler::Collect(events);
+  auto Milliseconds = [&](const char* name)
+  {
+    double sum = 0.0;
+    for (const Profiler::Event& event : events)
+    {
+      sum += std::strcmp(event.name, name) == 0 ? (event.end - event.begin) / 1e6 : 0.0;
+    }
+    return sum;
+  };
+  const double parse = Milliseconds("Parse scene");
+  phases = {
+    { "parse", parse },
+    { "decode", std::max(Milliseconds("Load scene") - parse, 0.0) },
+    { "bvh", Milliseconds("Build BVH") },
+    { "lights", Milliseconds("Build light list") },
+    { "render", Milliseconds("Render") },
+    { "total", total },
+  };
+
+  const std::vector<glm::vec4>& accumulation = renderer.GetAccumulation();
+  result.scene = path;
+  result.triangles = renderer.GetTriangleCount();
+  result.image_hash = ShaderPermutation::Hash(accumulation.data(), accumulation.size() * sizeof(glm::vec4));
+  return true;
+}
+
+// --benchmark: a warm-up run and options.runs measured runs of every scene.
+int RunBenchmark(const CpuPathTracer::Settings& settings, const std::vector<std::string>& scenes, const BenchmarkOptions& options)
+{
+  const bool wasEnabled = Profiler::IsEnabled();
+  Profiler::SetThreadName("main");
+  Profiler::SetEnabled(true);
+
+  Benchmark::Report report;
+  report.settings = DescribeBenchmarkSettings(settings, options);
+  report.runs = options.runs;
+  printf("benchmark: %s, %u runs\n", report.settings.c_str(), options.runs);
+
+  int result = 0;
+  for (const std::string& path : scenes)
+  {
+    Benchmark::SceneResult scene;
+    std::vector<std::pair<std::string, double>> phases;
+    if (!RunBenchmarkScene(path, settings, options, false, scene, phases))
+    {
+      result = 1;
+      continue;
+    }
+
+    bool reproduced = true;
+    for (unsigned int run = 0; run < options.runs; run++)
+    {
+      Benchmark::SceneResult measured;
+      if (!RunBenchmarkScene(path, settings, options, true, measured, phases))
+      {
+        break;
+      }
+      reproduced = reproduced && measured.image_hash == scene.image_hash;
+      for (const auto& phase : phases)
+      {
+        scene.Add(phase.first, phase.second);
+      }
+    }
+
+    printf("%s: %llu triangles, image %016llx%s\n", path.c_str(), static_cast<unsigned long long>(scene.triangles),
+           static_cast<unsigned long long>(scene.image_hash), reproduced ? "" : ", NOT REPRODUCED between runs");
+    for (const Benchmark::Phase& phase : scene.phases)
+    {
+      const Benchmark::Summary summary = Benchmark::Summarize(phase.milliseconds);
+      printf("  %-8s median %10.3f ms  stddev %8.3f ms  min %10.3f ms  max %10.3f ms\n", phase.name.c_str(), summary.median, std::sqrt(summary.variance),
+             summary.minimum, summary.maximum);
+    }
+    result |= reproduced ? 0 : 1;
+    report.scenes.push_back(std::move(scene));
+  }
+  Profiler::SetEnabled(wasEnabled);
+
+  std::string error;
+  if (!options.output.empty())
+  {
+    if (!Benchmark::Write(options.output, report, error))
+    {
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+    printf("wrote %s\n", options.output.c_str());
+  }
+
+  if (!options.baseline.empty())
+  {
+    Benchmark::Report baseline;
+    if (!Benchmark::ReadJson(options.baseline, baseline, error))
+    {
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+    const Benchmark::Comparison comparison = Benchmark::Compare(report, baseline, options.threshold_percent, c_benchmarkMinimumMilliseconds);
+    if (comparison.settings_differ)
+    {
+      fprintf(stderr, "baseline %s was measured with different settings:\n  %s\n", options.baseline.c_str(), baseline.settings.c_str());
+      return 1;
+    }
+    for (const std::string& missing : comparison.missing)
+    {
+      printf("  not measured: %s\n", missing.c_str());
+    }
+    for (const std::string& changed : comparison.changed_images)
+    {
+      printf("  %s renders a different image than the baseline, its timings compare different work\n", changed.c_str());
+    }
+    for (const Benchmark::Regression& regression : comparison.regressions)
+    {
+      printf("  REGRESSION %s %s: %.3f ms -> %.3f ms (+%.1f%%)\n", regression.scene.c_str(), regression.phase.c_str(), regression.baseline_median,
+             regression.median, regression.change_percent);
+    }
+    printf("baseline %s: %zu regressions above %.1f%%\n", options.baseline.c_str(), comparison.regressions.size(), options.threshold_percent);
+    result |= comparison.regressions.empty() ? 0 : 1;
+  }
+  return result;
+}
+
+const char* const c_goldenManifest = "golden.json";
+
+const GoldenImage* GoldenManifest::Find(const std::string& scene) const
+{
+  auto it = std::find_if(images.begin(), images.end(), [&](const GoldenImage& image) { return image.scene == scene; });
+  return it != images.end() ? &*it : nullptr;
+}
+
+// What the converged image depends on besides the scene. The sampler, next event
+// estimation, russian roulette, threads and the integrator only change the noise, a
+// render with other ones still has to match.
+std::string DescribeGoldenSettings(const CpuPathTracer::Settings& settings)
+{
+  const std::uint32_t features = settings.features & (CpuPathTracer::AntiAliasing | CpuPathTracer::DepthOfField);
+  char text[128];
+  snprintf(text, sizeof(text), "%ux%u, depth %u, features %u", settings.width, settings.height, settings.depth, features);
+  return text;
+}
+
+bool ReadGoldenManifest(const std::string& path, GoldenManifest& manifest, std::string& error)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+  {
+    error = "cannot open " + path;
+    return false;
+  }
+  manifest = GoldenManifest();
+  try
+  {
+    const nlohmann::json json = nlohmann::json::parse(file);
+    manifest.settings = json.at("settings").get<std::string>();
+    for (const nlohmann::json& image : json.at("images"))
+    {
+      manifest.images.push_back({ image.at("scene").get<std::string>(), image.at("image").get<std::string>(), image.at("samples").get<unsigned int>() });
+    }
+  }
+  catch (const std::exception& e)
+  {
+    error = path + ": " + e.what();
+    return false;
+  }
+  return true;
+}
+
+bool WriteGoldenManifest(const std::string& path, const GoldenManifest& manifest)
+{
+  nlohmann::json images = nlohmann::json::array();
+  for (const GoldenImage& image : manifest.images)
+  {
+    images.push_back({ { "scene", image.scene }, { "image", image.image }, { "samples", image.samples } });
+  }
+  std::ofstream file(path, std::ios::binary);
+  file << nlohmann::json({ { "settings", manifest.settings }, { "images", images } }).dump(2) << "\n";
+  return static_cast<bool>(file);
+}
+
+std::string GetSceneName(const std::string& path)
+{
+  const std::size_t slash = path.find_last_of("/\\");
+  const std::string file = slash == std::string::npos ? path : path.substr(slash + 1);
+  return file.substr(0, file.find_last_of('.'));
+}
+
+std::vector<glm::vec3> GetMeans(const CpuPathTracer::Renderer& renderer)
+{
+  const std::vector<glm::vec4>& accumulation = renderer.GetAccumulation();
+  std::vector<glm::vec3> means(accumulation.size());
+  for (std::size_t i = 0; i < means.size(); i++)
+  {
+    means[i] = glm::vec3(accumulation[i]) / std::max(accumulation[i].w, 1.0f);
+  }
+  return means;
+}
+
+ImageWriter::Image ToImage(const std::vector<glm::vec3>& pixels, unsigned int width, unsigned int height)
+{
+  ImageWriter::Image image;
+  image.width = width;
+  image.height = height;
+  image.rgba.reserve(pixels.size() * 4);
+  for (const glm::vec3& color : pixels)
+  {
+    image.rgba.insert(image.rgba.end(), { color.r, color.g, color.b, 1.0f });
+  }
+  return image;
+}
+
+bool ReadExr(const std::string& path, std::vector<glm::vec3>& pixels, unsigned int& width, unsigned int& height)
+{
+  std::ifstream file(path, std::ios::binary);
+  const std::vector<std::uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  ImageWriter::Image image;
+  if (!file || !ImageWriter::DecodeExr(data, image))
+  {
+    return false;
+  }
+  width = image.width;
+  height = image.height;
+  pixels.resize(std::size_t(width) * height);
+  for (std::size_t i = 0; i < pixels.size(); i++)
+  {
+    pixels[i] = glm::vec3(image.rgba[i * 4], image.rgba[i * 4 + 1], image.rgba[i * 4 + 2]);
+  }
+  return true;
+}
+
+struct GoldenResult
+{
+  bool passed = false;
+  std::string message; // why it failed or what was written
+  ImageCompare::Metrics metrics;
+  ImageCompare::Metrics floor; // of the noise of the render and the golden image
+  bool compared = false;
+  GoldenImage image;
+  double seconds = 0.0;
+};
+
+// Renders one scene and either compares it with its golden image (golden is not null)
+// or writes it as the new one. Nothing is printed, the scenes run at the same time.
+GoldenResult RunGoldenScene(const std::string& path, const CpuPathTracer::Settings& settings, const GoldenOptions& options, const GoldenImage* golden)
+{
+  GoldenResult result;
+  const auto start = std::chrono::steady_clock::now();
+  SceneCore::SceneData scene;
+  std::string error;
+  std::vector<std::string> warnings;
+  if (!SceneCore::LoadSceneFile(path, scene, error, warnings))
+  {
+    result.message = error;
+    return result;
+  }
+  CpuPathTracer::Renderer renderer(scene, GetSceneSettings(settings, scene, options.rr_disabled, options.rr_min_depth));
+  renderer.Render();
+  const std::vector<glm::vec3> means = GetMeans(renderer);
+  const std::string name = GetSceneName(path);
+
+  if (golden == nullptr)
+  {
+    ImageWriter::Options exr;
+    exr.exr_pixel_type = ImageWriter::ExrPixelType::Float;
+    result.image = { path, name + ".exr", settings.samples_per_pixel };
+    result.passed = ImageWriter::Write(options.directory + "/" + result.image.image, ToImage(means, settings.width, settings.height), exr);
+    result.message = result.passed ? "wrote " + options.directory + "/" + result.image.image : "cannot write " + options.directory + "/" + result.image.image;
+  }
+  else
+  {
+    std::vector<glm::vec3> reference;
+    unsigned int width = 0, height = 0;
+    result.image = *golden;
+    if (!ReadExr(options.directory + "/" + golden->image, reference, width, height))
+    {
+      result.message = "cannot read " + options.directory + "/" + golden->image;
+    }
+    else if (width != settings.width || height != settings.height)
+    {
+      result.message = "golden image is " + std::to_string(width) + "x" + std::to_string(height);
+    }
+    else
+    {
+      std::vector<float> errors;
+      const std::vector<glm::vec3> sigma = ImageCompare::StandardError(renderer.GetAccumulation(), renderer.GetMoments(), golden->samples);
+      result.floor = ImageCompare::NoiseFloor(reference, sigma, width, height);
+      result.metrics = ImageCompare::Compare(reference, means, width, height, &errors);
+      result.compared = true;
+
+      std::vector<const char*> failed;
+      result.passed = ImageCompare::Within(result.metrics, result.floor, options.tolerance, &failed);
+      for (const char* metric : failed)
+      {
+        result.message += (result.message.empty() ? "" : ", ") + std::string(metric);
+      }
+      const std::string heatmap = options.diff_output + "/" + name + ".flip.png";
+      if (!ImageWriter::Write(heatmap, ToImage(ImageCompare::Heatmap(errors), width, height)))
+      {
+        result.passed = false;
+        result.message += (result.message.empty() ? "" : ", ") + std::string("cannot write ") + heatmap;
+      }
+      // the render itself, to look at or to take over as the golden image
+      if (!result.passed)
+      {
+        ImageWriter::Options exr;
+        exr.exr_pixel_type = ImageWriter::ExrPixelType::Float;
+        ImageWriter::Write(options.diff_output + "/" + name + ".exr", ToImage(means, width, height), exr);
+      }
+    }
+  }
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return result;
+}
+
+int RunGolden(const CpuPathTracer::Settings& settings, const std::vector<std::string>& scenes, const GoldenOptions& options, bool quiet)
+{
+  const std::string manifestPath = options.directory + "/" + c_goldenManifest;
+  const std::string description = DescribeGoldenSettings(settings);
+  GoldenManifest manifest;
+  std::string error;
+  const bool hasManifest = ReadGoldenManifest(manifestPath, manifest, error);
+  if (options.update)
+  {
+    Benchmark::MakeDirectory(options.directory);
+    if (!hasManifest || manifest.settings != description)
+    {
+      manifest = GoldenManifest();
+      manifest.settings = description;
+    }
+  }
+  else
+  {
+    if (!hasManifest)
+    {
+      fprintf(stderr, "%s, create the golden images with --golden-update\n", error.c_str());
+      return 1;
+    }
+    if (manifest.settings != description)
+    {
+      fprintf(stderr, "the golden images are %s, this run is %s\n", manifest.settings.c_str(), description.c_str());
+      return 1;
+    }
+    Benchmark::MakeDirectory(options.diff_output);
+  }
+
+  const unsigned int cores = settings.threads > 0 ? settings.threads : std::max(std::thread::hardware_concurrency(), 1u);
+  const unsigned int jobs = static_cast<unsigned int>(std::max<std::size_t>(1, std::min<std::size_t>(options.jobs > 0 ? options.jobs : cores, scenes.size())));
+  CpuPathTracer::Settings sceneSettings = settings;
+  sceneSettings.threads = std::max(cores / jobs, 1u);
+  if (!quiet)
+  {
+    printf("golden %s: %s, %u spp, sampler %s, %u scenes at once on %u threads each\n", options.update ? "update" : "comparison", description.c_str(),
+           settings.samples_per_pixel, c_samplerNames[std::min(settings.sampler, c_samplerCount - 1)], jobs, sceneSettings.threads);
+  }
+
+  std::vector<GoldenResult> results(scenes.size());
+  SceneParser::ForEachParallel(scenes.size(), jobs, [&](std::size_t i)
+  {
+    const GoldenImage* golden = manifest.Find(scenes[i]);
+    if (!options.update && golden == nullptr)
+    {
+      results[i].message = "no golden image";
+      return;
+    }
+    results[i] = RunGoldenScene(scenes[i], sceneSettings, options, options.update ? nullptr : golden);
+  });
+
+  unsigned int failures = 0;
+  for (std::size_t i = 0; i < scenes.size(); i++)
+  {
+    const GoldenResult& result = results[i];
+    failures += result.passed ? 0 : 1;
+    if (options.update && result.passed)
+    {
+      auto it = std::find_if(manifest.images.begin(), manifest.images.end(), [&](const GoldenImage& image) { return image.scene == scenes[i]; });
+      if (it != manifest.images.end())
+      {
+        *it = result.image;
+      }
+      else
+      {
+        manifest.images.push_back(result.image);
+      }
+    }
+    if (quiet)
+    {
+      continue;
+    }
+    if (!result.compared)
+    {
+      printf("%-36s %6.2f s  %s%s\n", scenes[i].c_str(), result.seconds, result.passed ? "" : "FAILED ", result.message.c_str());
+      continue;
+    }
+    const ImageCompare::Metrics& m = result.metrics;
+    const ImageCompare::Metrics& f = result.floor;
+    printf("%-36s %6.2f s  rmse %.4f (%.4f)  ssim %.4f (%.4f)  flip %.4f (%.4f)  %s%s\n", scenes[i].c_str(), result.seconds, m.rmse, f.rmse, m.ssim, f.ssim,
+           m.flip, f.flip, result.passed ? "ok" : "FAILED ", result.message.c_str());
+  }
+
+  if (options.update && !WriteGoldenManifest(manifestPath, manifest))
+  {
+    fprintf(stderr, "cannot write %s\n", manifestPath.c_str());
+    return 1;
+  }
+  if (!quiet)
+  {
+    if (options.update)
+    {
+      printf("%zu golden images in %s\n", manifest.images.size(), manifestPath.c_str());
+    }
+    else
+    {
+      printf("%u of %zu scenes differ from the golden images, heat maps in %s\n", failures, scenes.size(), options.diff_output.c_str());
+    }
+  }
+  return failures > 0 ? 1 : 0;
+}
+
+double ToMebibytes(std::uint64_t bytes)
+{
+  return bytes / (1024.0 * 1024.0);
+}
+
+void PrintSceneStats(const SceneStats::Report& report)
+{
+  std::uint32_t descriptors = 0;
+  for (const SceneStats::Descriptors& range : report.descriptors)
+  {
+    descriptors += range.allocated;
+  }
+  printf("%s: %zu models, %zu objects, %llu triangles (%llu instanced), %llu of %llu vertices unique\n", report.scene.c_str(), report.models.size(),
+         report.objects.size(), static_cast<unsigned long long>(report.triangles), static_cast<unsigned long long>(report.instanced_triangles),
+         static_cast<unsigned long long>(report.unique_vertices), static_cast<unsigned long long>(report.vertices));
+  printf("  geometry %.2f MiB, bottom levels %.2f MiB, build scratch %.2f MiB, instance descs %.1f KiB\n", ToMebibytes(report.geometry_bytes),
+         ToMebibytes(report.blas_bytes), ToMebibytes(report.scratch_bytes), report.instance_desc_bytes / 1024.0);
+  printf("  textures %.2f MiB in %zu, constant buffers %.1f KiB of which %.1f KiB padding\n", ToMebibytes(report.texture_bytes), report.textures.size(),
+         report.constant_bytes / 1024.0, report.constant_wasted_bytes / 1024.0);
+  printf("  descriptors %u, %u of %u in the heap used\n", descriptors, report.descriptor_high_water_mark, report.descriptor_capacity);
+  printf("  object bounds: %llu overlapping pairs, area ratio %.2f\n", static_cast<unsigned long long>(report.overlapping_pairs), report.area_ratio);
+  for (const SceneStats::Model& model : report.models)
+  {
+    if (!model.blas.analyzed)
+    {
+      continue;
+    }
+    const BvhQuality::Metrics& quality = model.blas.quality;
+    std::string leafSizes;
+    for (std::size_t size = 1; size < quality.leaf_sizes.size(); size++)
+    {
+      leafSizes += " " + std::to_string(size) + ":" + std::to_string(quality.leaf_sizes[size]);
+    }
+    printf("  bvh of model %d (%s): SAH %.2f, EPO %.3f, depth %u (mean %.1f), leaves by size%s\n", model.id, model.blas.source.c_str(), quality.sah,
+           quality.epo, quality.max_depth, quality.mean_leaf_depth, leafSizes.c_str());
+  }
+}
+
+int RunSceneStats(const std::vector<std::string>& scenes, const std::string& output)
+{
+  int result = 0;
+  std::vector<SceneStats::Report> reports;
+  for (const std::string& path : scenes)
+  {
+    SceneCore::SceneData scene;
+    if (!LoadScene(path, scene))
+    {
+      result = 1;
+      continue;
+    }
+    reports.push_back(SceneStats::FromSceneData(path, scene));
+    PrintSceneStats(reports.back());
+  }
+
+  if (!output.empty())
+  {
+    std::ofstream file(output, std::ios::binary);
+    file << SceneStats::ToJson(reports);
+    if (!file)
+    {
+      fprintf(stderr, "cannot write %s\n", output.c_str());
+      return 1;
+    }
+  }
+  return result;
+}
+
+int Run(const std::vector<std::string>& args)
+{
+  CpuPathTracer::Settings settings;
+  std::vector<std::string> scenes;
+  std::string output = "cpu_render.png";
+  bool benchmark = false;
+  bool sppGiven = false;
+  int rrMinDepth = -1;
+  bool rrDisabled = false;
+  bool sizeGiven = false;
+  bool denoise = false;
+  bool rayStats = false;
+  Denoiser::Settings denoiserSettings;
+  std::vector<const Checks::Suite*> suites;
+  bool allChecks = false;
+  BenchmarkOptions benchmarkOptions;
+  bool golden = false;
+  bool sceneStats = false;
+  std::string statsOutput;
+  GoldenOptions goldenOptions;
+  std::string profileOutput;
+  std::string microfacetTable;
+  ImageWriter::Options imageOptions;
+
+  for (std::size_t i = 0; i < args.size(); i++)
+  {
+    const std::string& arg = args[i];
+    const bool hasValue = i + 1 < args.size();
+    auto Value = [&]() { return static_cast<unsigned int>(std::max(atoi(args[++i].c_str()), 0)); };
+
+    if (arg == "--width" && hasValue) { settings.width = Value(); sizeGiven = true; }
+    else if (arg == "--height" && hasValue) { settings.height = Value(); sizeGiven = true; }
+    else if (arg == "--spp" && hasValue) { settings.samples_per_pixel = Value(); sppGiven = true; }
+    else if (arg == "--depth" && hasValue) settings.depth = Value();
+    else if (arg == "--rr-min-depth" && hasValue) rrMinDepth = static_cast<int>(Value());
+    else if (arg == "--threads" && hasValue) settings.threads = Value();
+    else if (arg == "--tile" && hasValue) settings.tile_size = Value();
+    else if (arg == "--out" && hasValue) output = args[++i];
+    else if (arg == "--no-aa") settings.features &= ~CpuPathTracer::AntiAliasing;
+    else if (arg == "--dof") settings.features |= CpuPathTracer::DepthOfField;
+    else if (arg == "--no-nee") settings.features &= ~CpuPathTracer::NextEventEstimation;
+    else if (arg == "--no-rr") rrDisabled = true;
+    else if (arg == "--wavefront") settings.wavefront = true;
+    else if (arg == "--ray-stats") rayStats = true;
+    else if (arg == "--sampler" && hasValue)
+    {
+      const std::string name = args[++i];
+      auto it = std::find(std::begin(c_samplerNames), std::end(c_samplerNames), name);
+      if (it == std::end(c_samplerNames))
+      {
+        fprintf(stderr, "unknown sampler %s\n%s", name.c_str(), GetUsage().c_str());
+        return 1;
+      }
+      settings.sampler = static_cast<std::uint32_t>(it - std::begin(c_samplerNames));
+    }
+    else if (arg == "--denoise") denoise = true;
+    else if (arg == "--denoise-iterations" && hasValue) denoiserSettings.iterations = std::min(Value(), Denoiser::DENOISE_MAX_ITERATIONS);
+    else if (arg == "--microfacet-lut" && hasValue) microfacetTable = args[++i];
+    else if (arg == "--profile" && hasValue) profileOutput = args[++i];
+    else if (arg == "--runs" && hasValue) benchmarkOptions.runs = std::max(Value(), 1u);
+    else if (arg == "--benchmark-out" && hasValue) benchmarkOptions.output = args[++i];
+    else if (arg == "--baseline" && hasValue) benchmarkOptions.baseline = args[++i];
+    else if (arg == "--threshold" && hasValue) benchmarkOptions.threshold_percent = std::max(atof(args[++i].c_str()), 0.0);
+    else if (arg == "--golden" && hasValue) { goldenOptions.directory = args[++i]; golden = true; }
+    else if (arg == "--golden-update") goldenOptions.update = true;
+    else if (arg == "--diff-out" && hasValue) goldenOptions.diff_output = args[++i];
+    else if (arg == "--jobs" && hasValue) goldenOptions.jobs = Value();
+    else if (arg == "--scene-stats") sceneStats = true;
+    else if (arg == "--stats-out" && hasValue) { statsOutput = args[++i]; sceneStats = true; }
+    else if (arg == "--exr-float") imageOptions.exr_pixel_type = ImageWriter::ExrPixelType::Float;
+    else if (arg == "--exr-uncompressed") imageOptions.exr_compression = ImageWriter::ExrCompression::None;
+    else if (arg == "--benchmark") benchmark = true;
+    else if (arg == "--checks") allChecks = true;
+    else if (const Checks::Suite* suite = Checks::Find(arg)) suites.push_back(suite);
+    else if (arg == "-cpu") continue;
+    else if (arg == "--help" || arg == "-h")
+    {
+      printf("%s", GetUsage().c_str());
+      return 0;
+    }
+    else if (!arg.empty() && arg[0] == '-')
+    {
+      fprintf(stderr, "unknown option %s\n%s", arg.c_str(), GetUsage().c_str());
+      return 1;
+    }
+    else scenes.push_back(arg);
+  }
+
+  if (allChecks)
+  {
+    for (const Checks::Suite& suite : Checks::GetSuites())
+    {
+      if (!suite.measures)
+      {
+        suites.push_back(&suite);
+      }
+    }
+  }
+  if (!suites.empty())
+  {
+    Checks::Options options;
+    options.scenes = scenes;
+    options.settings = settings;
+    options.size_given = sizeGiven;
+    options.spp_given = sppGiven;
+    options.denoiser = denoiserSettings;
+    return Checks::Run(suites, options);
+  }
+
+  if (sceneStats)
+  {
+    if (scenes.empty())
+    {
+      scenes = Benchmark::ListFiles("src/scenes", ".txt");
+    }
+    return RunSceneStats(scenes, statsOutput);
+  }
+
+  if (!microfacetTable.empty())
+  {
+    return WriteMicrofacetEnergy(microfacetTable);
+  }
+
+  denoiserSettings.threads = settings.threads;
+  if (benchmark)
+  {
+    if (scenes.empty())
+    {
+      scenes = Benchmark::ListFiles("src/scenes", ".txt");
+    }
+    if (!sizeGiven)
+    {
+      settings.width = 320;
+      settings.height = 180;
+    }
+    if (!sppGiven)
+    {
+      settings.samples_per_pixel = 16;
+    }
+    benchmarkOptions.rr_disabled = rrDisabled;
+    benchmarkOptions.rr_min_depth = rrMinDepth;
+    return RunBenchmark(settings, scenes, benchmarkOptions);
+  }
+
+  if (golden || goldenOptions.update)
+  {
+    if (scenes.empty())
+    {
+      scenes = Benchmark::ListFiles("src/scenes", ".txt");
+    }
+    if (!sizeGiven)
+    {
+      settings.width = 128;
+      settings.height = 72;
+    }
+    if (!sppGiven)
+    {
+      settings.samples_per_pixel = goldenOptions.update ? 1024 : 64;
+    }
+    goldenOptions.rr_disabled = rrDisabled;
+    goldenOptions.rr_min_depth = rrMinDepth;
+    return RunGolden(settings, scenes, goldenOptions);
+  }
+  if (scenes.size() != 1)
+  {
+    fprintf(stderr, "%s", GetUsage().c_str());
+    return 1;
+  }
+  ImageWriter::Format outputFormat;
+  if (!ImageWriter::GetFormat(output, outputFormat))
+  {
+    fprintf(stderr, "unknown image format %s\n%s", output.c_str(), GetUsage().c_str());
+    return 1;
+  }
+
+  if (!profileOutput.empty())
+  {
+    Profiler::SetThreadName("main");
+    Profiler::SetEnabled(true);
+  }
+
+  int result = 0;
+  for (const auto& path : scenes)
+  {
+    SceneCore::SceneData scene;
+    if (!LoadScene(path, scene))
+    {
+      result = 1;
+      continue;
+    }
+
+    const CpuPathTracer::Settings sceneSettings = GetSceneSettings(settings, scene, rrDisabled, rrMinDepth);
+    CpuPathTracer::Renderer renderer(scene, sceneSettings);
+    renderer.Render();
+
+    const CpuPathTracer::Statistics& stats = renderer.GetStatistics();
+    const double seconds = std::max(stats.render_seconds, 1e-9);
+    printf("%s: %ux%u, %u spp %s, %zu triangles, %zu emissive, bvh %.1f ms\n", path.c_str(), sceneSettings.width, sceneSettings.height,
+           sceneSettings.samples_per_pixel, c_samplerNames[std::min(sceneSettings.sampler, c_samplerCount - 1)], renderer.GetTriangleCount(),
+           renderer.GetLightCount(), stats.build_seconds * 1000.0);
+    printf("  %.2f s, %.3f M samples/s, %.3f M segments/s, %.2f segments/path\n", stats.render_seconds,
+           stats.paths / seconds / 1e6, stats.segments / seconds / 1e6, stats.paths > 0 ? double(stats.segments) / stats.paths : 0.0);
+    if (sceneSettings.wavefront)
+    {
+      auto Percent = [](std::uint64_t part, std::uint64_t whole) { return whole > 0 ? 100.0 * part / whole : 0.0; };
+      printf("  lane utilization (%u wide): %.1f%% per class queues, %.1f%% megakernel, %.1f%% of the wave live per bounce\n", CpuPathTracer::SimdWidth,
+             Percent(stats.shaded_lanes, stats.wavefront_lanes), Percent(stats.shaded_lanes, stats.megakernel_lanes), Percent(stats.live_lanes, stats.wave_lanes));
+      printf("  queued:");
+      for (std::size_t c = 0; c < CpuPathTracer::MaterialClassCount; c++)
+      {
+        printf(" %s %.1f%%", CpuPathTracer::GetMaterialClassName(static_cast<CpuPathTracer::MaterialClass>(c)), Percent(stats.queued[c], stats.shaded_lanes));
+      }
+      printf("\n");
+    }
+    if (rayStats)
+    {
+      PrintRayStatistics(stats);
+    }
+
+    std::vector<glm::vec3> image = renderer.Resolve();
+    if (denoise)
+    {
+      const auto start = std::chrono::steady_clock::now();
+      image = Denoiser::Filter(GetDenoiserInput(renderer), denoiserSettings);
+      printf("  denoised in %.1f ms, %u iterations\n", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(),
+             denoiserSettings.iterations);
+    }
+
+    {
+      PROFILE_SCOPE("Write image");
+      ImageWriter::Image written;
+      written.width = sceneSettings.width;
+      written.height = sceneSettings.height;
+      written.rgba.reserve(image.size() * 4);
+      for (const glm::vec3& color : image)
+      {
+        written.rgba.insert(written.rgba.end(), { color.r, color.g, color.b, 1.0f });
+      }
+      if (!ImageWriter::Write(output, written, imageOptions))
+      {
+        fprintf(stderr, "cannot write %s\n", output.c_str());
+        result = 1;
+      }
+      else
+      {
+        printf("  wrote %s\n", output.c_str());
+      }
+    }
+  }
+
+  if (!profileOutput.empty())
+  {
+    std::vector<Profiler::Event> events;
+    Profiler::Collect(events);
+    if (!Profiler::WriteChromeTrace(profileOutput, events, Profiler::GetTracks()))
+    {
+      fprintf(stderr, "cannot write %s\n", profileOutput.c_str());
+      result = 1;
+    }
+    else
+    {
+      printf("wrote %zu events to %s\n", events.size(), profileOutput.c_str());
+    }
+  }
+
+  return result;
+}
+
+}
+
+#ifndef _WIN32
+int main(int argc, char** argv)
+{
+  if (argc > 1 && std::strcmp(argv[1], "-convert") == 0)
+  {
+    return SceneConvert::Run(std::vector<std::string>(argv + 2, argv + argc));
+  }
+  return CpuRender::Run(std::vector<std::string>(argv + 1, argv + argc));
+}
+#endif
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+//
+// CpuRender - command line front end of the CPU reference path tracer.
+//
+// Renders a scene file to an image without D3D or a window, or benchmarks samples per
+// second over a list of scenes. Started with -cpu on Windows, it is the whole program
+// in builds without Win32 (where this file provides main).
+//
+namespace CpuRender {
+
+// args excludes the program name. Returns the process exit code.
+int Run(const std::vector<std::string>& args);
+
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "Benchmark.h"
+#include "CpuPathTracer.h"
+#include "Denoiser.h"
+#include "ImageCompare.h"
+#include "SceneCore.h"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glm/glm/glm.hpp>
+
+//
+// The parts of the CpuRender front end that its checks (checks/) drive as well: loading
+// scenes the way the command line does, the benchmark and golden image runs and the
+// microfacet energy table.
+//
+namespace CpuRender {
+
+extern const char* const c_samplerNames[];
+extern const std::uint32_t c_samplerCount;
+
+// Prints the warnings and the error of the load.
+bool LoadScene(const std::string& path, SceneCore::SceneData& scene);
+// Russian roulette follows the scene file like on the GPU unless overridden.
+CpuPathTracer::Settings GetSceneSettings(const CpuPathTracer::Settings& settings, const SceneCore::SceneData& scene, bool rrDisabled, int rrMinDepth);
+Denoiser::Input GetDenoiserInput(const CpuPathTracer::Renderer& renderer);
+
+// Samples per entry of the microfacet energy table, the check recomputes it with as many.
+extern const std::uint32_t c_microfacetEnergySamples;
+std::vector<float> ComputeMicrofacetEnergyTable();
+
+struct BenchmarkOptions
+{
+  unsigned int runs = 5;
+  std::string output;
+  std::string baseline;
+  double threshold_percent = 10.0;
+  bool rr_disabled = false;
+  int rr_min_depth = -1;
+};
+
+// Slowdowns of a median below this are timer noise, whatever the percentage.
+extern const double c_benchmarkMinimumMilliseconds;
+
+// One run of a scene: load, build and render with the profiler on, the phases come from
+// its scopes. Warnings of the load are only printed when quiet is false.
+bool RunBenchmarkScene(const std::string& path, const CpuPathTracer::Settings& settings, const BenchmarkOptions& options, bool quiet,
+                       Benchmark::SceneResult& result, std::vector<std::pair<std::string, double>>& phases);
+
+struct GoldenOptions
+{
+  std::string directory = "src/golden";
+  std::string diff_output = "golden_diff";
+  bool update = false;
+  unsigned int jobs = 0; // scenes rendered at once, 0: one per core
+  bool rr_disabled = false;
+  int rr_min_depth = -1;
+  ImageCompare::Tolerance tolerance;
+};
+
+extern const char* const c_goldenManifest;
+
+struct GoldenImage
+{
+  std::string scene;
+  std::string image; // in the golden directory
+  unsigned int samples = 0;
+};
+
+// Written by --golden-update next to the images: the settings every golden image was
+// rendered with and the samples of each.
+struct GoldenManifest
+{
+  std::string settings;
+  std::vector<GoldenImage> images;
+
+  const GoldenImage* Find(const std::string& scene) const;
+};
+
+bool ReadGoldenManifest(const std::string& path, GoldenManifest& manifest, std::string& error);
+// src/scenes/cornell.txt -> cornell
+std::string GetSceneName(const std::string& path);
+// The averages of the accumulation, not clamped like Resolve, what the golden EXRs keep.
+std::vector<glm::vec3> GetMeans(const CpuPathTracer::Renderer& renderer);
+
+// --golden: renders every scene, options.jobs of them at once with the cores split
+// between them, and compares them with the golden images or replaces those.
+int RunGolden(const CpuPathTracer::Settings& settings, const std::vector<std::string>& scenes, const GoldenOptions& options, bool quiet = false);
+
+}
@@ -0,0 +1,256 @@
+#include "CpuPathTracer.h"
+
+#include <algorithm>
+
+namespace CpuPathTracer {
+
+namespace {
+
+// Paths in flight per wave: a tile worth of pixels times as many samples as fit, enough
+// to keep every queue busy while the state of the wave stays in the caches.
+const std::uint32_t c_wavePaths = 4096;
+
+std::uint32_t CountBits(std::uint32_t bits)
+{
+  std::uint32_t count = 0;
+  for (; bits != 0; bits &= bits - 1)
+  {
+    count++;
+  }
+  return count;
+}
+
+}
+
+void Renderer::Wavefront::Resize(std::size_t lanes)
+{
+  if (origin.size() >= lanes)
+  {
+    return;
+  }
+
+  origin.resize(lanes);
+  direction.resize(lanes);
+  color.resize(lanes);
+  bounce_pdf.resize(lanes);
+  rng.resize(lanes);
+  slot.resize(lanes);
+  pixel.resize(lanes);
+  sample.resize(lanes);
+
+  hit.resize(lanes);
+  material_class.resize(lanes);
+  next_origin.resize(lanes);
+  next_direction.resize(lanes);
+  hit_normal.resize(lanes);
+  light_pdf.resize(lanes);
+
+  queue.resize(lanes);
+
+  shadow_origin.resize(lanes);
+  shadow_target.resize(lanes);
+  shadow_contribution.resize(lanes);
+  shadow_slot.resize(lanes);
+
+  radiance.resize(lanes);
+  features.resize(lanes);
+  group_classes.resize((lanes + SimdWidth - 1) / SimdWidth);
+}
+
+// TracePath for a whole wave at once, one stage at a time:
+//   camera rays -> intersect -> sort by material class -> shade each queue -> advance
+//   and compact the live paths -> trace the shadow rays -> next bounce
+// Slots number the paths of the wave pixel by pixel, sample by sample, so adding their
+// radiance in slot order sums in the same order as RenderTile.
+void Renderer::RenderTileWavefront(unsigned int tile, Wavefront& w)
+{
+  const unsigned int x0 = (tile % m_tilesX) * m_settings.tile_size;
+  const unsigned int y0 = (tile / m_tilesX) * m_settings.tile_size;
+  const unsigned int tileWidth = std::min(m_settings.tile_size, m_settings.width - x0);
+  const unsigned int tileHeight = std::min(m_settings.tile_size, m_settings.height - y0);
+  const std::uint32_t pixelCount = tileWidth * tileHeight;
+  const unsigned int spp = m_settings.samples_per_pixel;
+  const int depth = static_cast<int>(m_settings.depth);
+
+  const unsigned int samplesPerWave = std::max(1u, std::min(spp, c_wavePaths / pixelCount));
+  w.Resize(static_cast<std::size_t>(pixelCount) * samplesPerWave);
+  Statistics& stats = w.statistics;
+
+  for (unsigned int s0 = 0; s0 < spp; s0 += samplesPerWave)
+  {
+    const unsigned int waveSamples = std::min(samplesPerWave, spp - s0);
+    const std::uint32_t pathCount = pixelCount * waveSamples;
+    stats.rays[RayStats::RayStatPaths] += pathCount;
+
+    // camera rays
+    for (std::uint32_t slot = 0; slot < pathCount; slot++)
+    {
+      const std::uint32_t p = slot / waveSamples;
+      const glm::uvec2 pixel(x0 + p % tileWidth, y0 + p / tileWidth);
+      const std::uint32_t id = pixel.x + m_settings.width * pixel.y;
+      const std::uint32_t sampleIndex = static_cast<std::uint32_t>(m_accumulation[id].w) + slot % waveSamples + 1;
+
+      w.rng[slot] = Rng(m_settings.sampler, m_settings.width);
+      w.rng[slot].Seed(id, sampleIndex, depth);
+      GenerateCameraRay(pixel, w.origin[slot], w.direction[slot], w.rng[slot]);
+      w.color[slot] = glm::vec4(1.0f, 1.0f, 1.0f, -1.0f);
+      w.bounce_pdf[slot] = 0.0f;
+      w.slot[slot] = slot;
+      w.pixel[slot] = id;
+      w.sample[slot] = sampleIndex;
+      w.radiance[slot] = glm::vec3(0.0f);
+    }
+
+    std::uint32_t live = pathCount;
+    for (int i = 0; i < depth && live > 0; i++)
+    {
+      stats.live_lanes += live;
+      stats.wave_lanes += pathCount;
+
+      // intersection, the camera rays also fill in the guides of the denoiser
+      for (std::uint32_t lane = 0; lane < live; lane++)
+      {
+        const CpuBvh::Ray ray{ w.origin[lane], w.direction[lane], 0.001f, 10000.0f };
+        w.material_class[lane] = m_bvh.Intersect(ray, w.hit[lane], &stats.traversal) ? Classify(m_instances[w.hit[lane].object]) : MaterialClass::Miss;
+        if (i == 0)
+        {
+          w.features[w.slot[lane]] = w.material_class[lane] != MaterialClass::Miss ? GetFeatures(ray, w.hit[lane]) : Features{ glm::vec3(0.0f), glm::vec3(0.0f), 0.0f };
+        }
+      }
+
+      // counting sort into one queue per class, lanes stay in order within a queue
+      std::uint32_t counts[MaterialClassCount] = {};
+      std::fill(w.group_classes.begin(), w.group_classes.begin() + (pathCount + SimdWidth - 1) / SimdWidth, std::uint8_t(0));
+      for (std::uint32_t lane = 0; lane < live; lane++)
+      {
+        const std::uint32_t c = static_cast<std::uint32_t>(w.material_class[lane]);
+        counts[c]++;
+        w.group_classes[w.slot[lane] / SimdWidth] |= std::uint8_t(1u << c);
+      }
+      w.queue_begin[0] = 0;
+      for (std::size_t c = 0; c < MaterialClassCount; c++)
+      {
+        w.queue_begin[c + 1] = w.queue_begin[c] + counts[c];
+        stats.queued[c] += counts[c];
+        stats.shaded_lanes += counts[c];
+        stats.wavefront_lanes += (counts[c] + SimdWidth - 1) / SimdWidth * SimdWidth;
+      }
+      for (std::uint32_t group = 0; group < (pathCount + SimdWidth - 1) / SimdWidth; group++)
+      {
+        stats.megakernel_lanes += CountBits(w.group_classes[group]) * SimdWidth;
+      }
+      std::uint32_t cursor[MaterialClassCount];
+      std::copy(w.queue_begin, w.queue_begin + MaterialClassCount, cursor);
+      for (std::uint32_t lane = 0; lane < live; lane++)
+      {
+        w.queue[cursor[static_cast<std::uint32_t>(w.material_class[lane])]++] = lane;
+      }
+
+      // one shading kernel per class, each runs the same code on every lane of its queue
+      auto Shade = [&](MaterialClass materialClass, auto kernel)
+      {
+        const std::size_t c = static_cast<std::size_t>(materialClass);
+        for (std::uint32_t q = w.queue_begin[c]; q < w.queue_begin[c + 1]; q++)
+        {
+          const std::uint32_t lane = w.queue[q];
+          const CpuBvh::Ray ray{ w.origin[lane], w.direction[lane], 0.001f, 10000.0f };
+          Payload payload{ w.color[lane], glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f), 0.0f };
+          kernel(ray, w.hit[lane], payload, w.rng[lane]);
+          w.color[lane] = payload.color;
+          w.next_origin[lane] = payload.rayOrigin;
+          w.next_direction[lane] = payload.rayDir;
+          w.hit_normal[lane] = payload.hitNormal;
+          w.light_pdf[lane] = payload.lightPdf;
+        }
+      };
+      Shade(MaterialClass::Glass, [&](const CpuBvh::Ray& ray, const CpuBvh::Hit& hit, Payload& payload, Rng& rng) {
+        ShadeGlass(ray, GetSurface(ray, hit), payload, rng);
+      });
+      Shade(MaterialClass::Reflective, [&](const CpuBvh::Ray& ray, const CpuBvh::Hit& hit, Payload& payload, Rng&) {
+        ShadeReflective(ray, GetSurface(ray, hit), payload);
+      });
+      Shade(MaterialClass::Refractive, [&](const CpuBvh::Ray& ray, const CpuBvh::Hit& hit, Payload& payload, Rng& rng) {
+        ShadeRefractive(ray, GetSurface(ray, hit), payload, rng);
+      });
+      Shade(MaterialClass::Emissive, [&](const CpuBvh::Ray& ray, const CpuBvh::Hit& hit, Payload& payload, Rng&) {
+        ShadeEmissive(ray, hit, GetSurface(ray, hit), payload);
+      });
+      Shade(MaterialClass::Microfacet, [&](const CpuBvh::Ray& ray, const CpuBvh::Hit& hit, Payload& payload, Rng& rng) {
+        ShadeMicrofacet(ray, GetSurface(ray, hit), payload, rng);
+      });
+      Shade(MaterialClass::Diffuse, [&](const CpuBvh::Ray& ray, const CpuBvh::Hit& hit, Payload& payload, Rng& rng) {
+        ShadeDiffuse(GetSurface(ray, hit), payload, rng);
+      });
+      Shade(MaterialClass::Miss, [&](const CpuBvh::Ray&, const CpuBvh::Hit&, Payload& payload, Rng&) {
+        Miss(payload);
+      });
+
+      // advance every path, queue its shadow ray and compact the survivors to the front
+      std::uint32_t shadowCount = 0;
+      std::uint32_t next = 0;
+      for (std::uint32_t lane = 0; lane < live; lane++)
+      {
+        Rng rng = w.rng[lane];
+        rng.Seed(w.pixel[lane], w.sample[lane], i);
+
+        Payload payload{ w.color[lane], w.next_origin[lane], w.next_direction[lane], w.hit_normal[lane], w.light_pdf[lane] };
+        CpuBvh::Ray ray{ w.origin[lane], w.direction[lane], 0.001f, 10000.0f };
+        float bouncePdf = w.bounce_pdf[lane];
+        ShadowRay shadow;
+        const float hitType = payload.color.w;
+        const bool alive = AdvancePath(i, depth, payload, ray, w.radiance[w.slot[lane]], bouncePdf, shadow, rng);
+        CountSegment(i, hitType, alive, stats);
+
+        if (shadow.contribution != glm::vec3(0.0f))
+        {
+          w.shadow_origin[shadowCount] = shadow.origin;
+          w.shadow_target[shadowCount] = shadow.target;
+          w.shadow_contribution[shadowCount] = shadow.contribution;
+          w.shadow_slot[shadowCount] = w.slot[lane];
+          shadowCount++;
+        }
+
+        if (alive)
+        {
+          w.origin[next] = ray.origin;
+          w.direction[next] = ray.direction;
+          w.color[next] = payload.color;
+          w.bounce_pdf[next] = bouncePdf;
+          w.rng[next] = rng;
+          w.slot[next] = w.slot[lane];
+          w.pixel[next] = w.pixel[lane];
+          w.sample[next] = w.sample[lane];
+          next++;
+        }
+      }
+      live = next;
+
+      // shadow rays
+      for (std::uint32_t s = 0; s < shadowCount; s++)
+      {
+        if (IsVisible(w.shadow_origin[s], w.shadow_target[s], stats))
+        {
+          w.radiance[w.shadow_slot[s]] += w.shadow_contribution[s];
+        }
+      }
+    }
+
+    for (std::uint32_t p = 0; p < pixelCount; p++)
+    {
+      const std::uint32_t id = (x0 + p % tileWidth) + m_settings.width * (y0 + p / tileWidth);
+      glm::vec4& accumulated = m_accumulation[id];
+      for (unsigned int s = 0; s < waveSamples; s++)
+      {
+        const glm::vec3& color = w.radiance[p * waveSamples + s];
+        const Features& features = w.features[p * waveSamples + s];
+        accumulated += glm::vec4(color, 0.0f);
+        m_moments[id] += color * color;
+        m_albedoDepth[id] += glm::vec4(features.albedo, features.distance);
+        m_normals[id] += features.normal;
+      }
+      accumulated.w += static_cast<float>(waveSamples);
+    }
+  }
+}
+
+}
@@ -13,9 +13,12 @@
 #include "D3D12RaytracingSimpleLighting.h"
 #include "DirectXRaytracingHelper.h"
 #include "CompiledShaders\Raytracing.hlsl.h"
+#include "CompiledShaders\Denoise.hlsl.h"
 #include "TextureLoader.h"
+#include "SceneFormat.h"
 #include <iostream>
 #include <algorithm>
+#include <chrono>
 #include "stb_image_write.h"
 
 using namespace std;
@@ -28,6 +31,14 @@ const wchar_t* D3D12RaytracingSimpleLighting::c_missShaderName = L"MyMissShader"
 const float D3D12RaytracingSimpleLighting::c_rotateDegrees = 5.f;
 const float D3D12RaytracingSimpleLighting::c_movementAmountFactor = 0.1f;
 const unsigned int D3D12RaytracingSimpleLighting::c_maxIteration = 6000;
+const unsigned int D3D12RaytracingSimpleLighting::c_rrBenchmarkFrames = 240;
+
+//runtime compilation of the shader permutations, with the options of the FxCompile of the project
+static const char* c_raytracingShaderPath = "src/shaders/Raytracing.hlsl";
+static const char* c_raytracingShaderTarget = "lib_6_3";
+static const std::vector<std::string> c_raytracingShaderArguments = { "-Zpr", "-O3" };
+static const char* c_shaderCacheDirectory = "shader_cache";
+static const UINT64 c_pathStatsSize = RayStats::RayStatCount * sizeof(UINT);
 
 D3D12RaytracingSimpleLighting::D3D12RaytracingSimpleLighting(UINT width, UINT height, std::wstring name) :
     DXSample(width, height, name),
@@ -81,6 +92,10 @@ void D3D12RaytracingSimpleLighting::OnInit()
     m_deviceResources->InitializeDXGIAdapter();
     EnableDirectXRaytracing(m_deviceResources->GetAdapter());
 
+    //on from the start, so the load is in the trace
+    Profiler::SetThreadName("main");
+    Profiler::SetEnabled(true);
+
     m_deviceResources->CreateDeviceResources();
     m_deviceResources->CreateWindowSizeDependentResources();
 
@@ -101,6 +116,13 @@ void D3D12RaytracingSimpleLighting::UpdateCameraMatrices()
     XMMATRIX proj;
     XMMATRIX viewProj;
 
+    //a tiled render frames the target image, not the window
+    float aspectRatio = m_aspectRatio;
+    if (tiled_render_job.IsActive())
+    {
+      aspectRatio = static_cast<float>(tiled_render_job.GetSettings().width) / static_cast<float>(tiled_render_job.GetSettings().height);
+    }
+
     if(m_sceneLoaded != nullptr)
     {
       m_sceneCB[frameIndex].cameraPosition = m_sceneLoaded->camera.eye;
@@ -108,7 +130,7 @@ void D3D12RaytracingSimpleLighting::UpdateCameraMatrices()
       float fovAngleY = m_sceneLoaded->camera.fov;
 
       view = XMMatrixLookAtLH(m_sceneLoaded->camera.eye, m_sceneLoaded->camera.lookat, m_sceneLoaded->camera.up);
-      proj = XMMatrixPerspectiveFovLH(XMConvertToRadians(fovAngleY), m_aspectRatio, 1.0f, 125.0f);
+      proj = XMMatrixPerspectiveFovLH(XMConvertToRadians(fovAngleY), aspectRatio, 1.0f, 125.0f);
       viewProj = view * proj;
     }
     else
@@ -117,7 +139,7 @@ void D3D12RaytracingSimpleLighting::UpdateCameraMatrices()
       fovAngleY = 45.0f;
 
       view = XMMatrixLookAtLH(m_eye, m_at, m_up);
-      proj = XMMatrixPerspectiveFovLH(XMConvertToRadians(fovAngleY), m_aspectRatio, 1.0f, 125.0f);
+      proj = XMMatrixPerspectiveFovLH(XMConvertToRadians(fovAngleY), aspectRatio, 1.0f, 125.0f);
       viewProj = view * proj;
     }
 
@@ -171,7 +193,12 @@ void D3D12RaytracingSimpleLighting::InitializeScene()
     {
 	    m_sceneCB[frameIndex].iteration = 1;
 	    m_sceneCB[frameIndex].depth = 5;
-	    m_sceneCB[frameIndex].features = AntiAliasing;
+	    m_sceneCB[frameIndex].features = AntiAliasing | NextEventEstimation;
+	    m_sceneCB[frameIndex].samples_per_launch = feature_samples_per_launch;
+	    m_sceneCB[frameIndex].sampler_type = feature_sampler;
+	    m_sceneCB[frameIndex].adaptive_min_samples = adaptive_min_samples;
+	    m_sceneCB[frameIndex].output_width = m_width;
+	    m_sceneCB[frameIndex].output_height = m_height;
     }
 
     // Apply the initial values to all frames' buffer instances.
@@ -211,12 +238,16 @@ void D3D12RaytracingSimpleLighting::CreateConstantBuffers()
 // Create resources that depend on the device.
 void D3D12RaytracingSimpleLighting::CreateDeviceDependentResources()
 {
+    PROFILE_SCOPE("Create device resources");
+    gpu_profiler.RestoreDevice(m_deviceResources->GetD3DDevice(), m_deviceResources->GetCommandQueue(), FrameCount);
+
     // Initialize raytracing pipeline.
 
     // Create raytracing interfaces: raytracing device and commandlist.
     CreateRaytracingInterfaces();
 
     m_sceneLoaded = new Scene(p_sceneFileName, this); // this will load everything in the argument text file
+    ApplySceneRenderSettings();
 
     // Create root signatures for the shaders.
     CreateRootSignatures();
@@ -229,12 +260,15 @@ void D3D12RaytracingSimpleLighting::CreateDeviceDependentResources()
 
     // Build geometry to be used in the sample.
     m_sceneLoaded->AllocateResourcesInDescriptorHeap();
+    UpdateLightList();
 
     // Build raytracing acceleration structures from the generated geometry.
     BuildAccelerationStructures();
 
     // Create constant buffers for the geometry and the scene.
     CreateConstantBuffers();
+    CreatePathStatisticsResources();
+    CreateDenoiserPipeline();
 
     // Build shader tables, which define shaders and their local root arguments.
     BuildShaderTables();
@@ -242,6 +276,12 @@ void D3D12RaytracingSimpleLighting::CreateDeviceDependentResources()
     // Create an output 2D texture to store the raytracing result to.
     CreateRaytracingOutputResource();
 
+    if (m_descriptorHeapGrown)
+    {
+        RebuildScene();
+    }
+
+    WatchSceneFiles();
     InitImGUI();
 }
 
@@ -283,25 +323,33 @@ void D3D12RaytracingSimpleLighting::CreateRootSignatures()
         assert(num_normal_textures != 0);
         assert(num_materials != 0);
 
-        CD3DX12_DESCRIPTOR_RANGE ranges[7]; // Perfomance TIP: Order from most frequent to least frequent.
-        ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 2, 0);  // 1 output texture
-        ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, num_models, 0, 1);  // array of vertices
-        ranges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, num_models, 0, 2);  // array of indices
-        ranges[3].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, num_objects, 0, 3);  // array of infos for each object
-	ranges[4].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, num_materials, 0, 4);  // array of materials
-	ranges[5].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, num_diffuse_textures, 0, 5);  // array of textures
-	ranges[6].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, num_normal_textures, 0, 6);  // array of normal textures
+        CD3DX12_DESCRIPTOR_RANGE ranges[10]; // Perfomance TIP: Order from most frequent to least frequent.
+        ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 3, 0);  // output texture, accumulation and second moment
+        ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 2, 5);  // denoiser guides, u3 and u4 are root views
+        ranges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 7, 0, 8);  // compensation, after the denoiser buffers
+        ranges[3].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, num_models, 0, 1);  // array of vertex positions
+        ranges[4].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, num_models, 0, 2);  // array of indices
+        ranges[5].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, num_objects, 0, 3);  // array of infos for each object
+	ranges[6].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, num_materials, 0, 4);  // array of materials
+	ranges[7].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, num_diffuse_textures, 0, 5);  // array of textures
+	ranges[8].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, num_normal_textures, 0, 6);  // array of normal textures
+        ranges[9].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, num_models, 0, 7);  // array of vertex attributes
 
         CD3DX12_ROOT_PARAMETER rootParameters[GlobalRootSignatureParams::Count];
         rootParameters[GlobalRootSignatureParams::AccelerationStructureSlot].InitAsShaderResourceView(0);
         rootParameters[GlobalRootSignatureParams::SceneConstantSlot].InitAsConstantBufferView(0);
-        rootParameters[GlobalRootSignatureParams::OutputViewSlot].InitAsDescriptorTable(1, &ranges[0]);
-        rootParameters[GlobalRootSignatureParams::VertexBuffersSlot].InitAsDescriptorTable(1, &ranges[1]);
-        rootParameters[GlobalRootSignatureParams::IndexBuffersSlot].InitAsDescriptorTable(1, &ranges[2]);
-        rootParameters[GlobalRootSignatureParams::InfoBuffersSlot].InitAsDescriptorTable(1, &ranges[3]);
-	rootParameters[GlobalRootSignatureParams::MaterialBuffersSlot].InitAsDescriptorTable(1, &ranges[4]);
-        rootParameters[GlobalRootSignatureParams::TextureSlot].InitAsDescriptorTable(1, &ranges[5]);
-	rootParameters[GlobalRootSignatureParams::NormalTextureSlot].InitAsDescriptorTable(1, &ranges[6]);
+        rootParameters[GlobalRootSignatureParams::OutputViewSlot].InitAsDescriptorTable(3, &ranges[0]);
+        rootParameters[GlobalRootSignatureParams::VertexBuffersSlot].InitAsDescriptorTable(1, &ranges[3]);
+        rootParameters[GlobalRootSignatureParams::IndexBuffersSlot].InitAsDescriptorTable(1, &ranges[4]);
+        rootParameters[GlobalRootSignatureParams::InfoBuffersSlot].InitAsDescriptorTable(1, &ranges[5]);
+	rootParameters[GlobalRootSignatureParams::MaterialBuffersSlot].InitAsDescriptorTable(1, &ranges[6]);
+        rootParameters[GlobalRootSignatureParams::TextureSlot].InitAsDescriptorTable(1, &ranges[7]);
+	rootParameters[GlobalRootSignatureParams::NormalTextureSlot].InitAsDescriptorTable(1, &ranges[8]);
+        rootParameters[GlobalRootSignatureParams::VertexAttributesSlot].InitAsDescriptorTable(1, &ranges[9]);
+        rootParameters[GlobalRootSignatureParams::ActiveTilesSlot].InitAsShaderResourceView(1);
+        rootParameters[GlobalRootSignatureParams::TileErrorsSlot].InitAsUnorderedAccessView(3);
+        rootParameters[GlobalRootSignatureParams::LightsSlot].InitAsShaderResourceView(2);
+        rootParameters[GlobalRootSignatureParams::PathStatsSlot].InitAsUnorderedAccessView(4);
 
 	// LOOKAT
 	// create a static sampler
@@ -409,8 +457,31 @@ void D3D12RaytracingSimpleLighting::CreateRaytracingPipelineStateObject()
     // DXIL library
     // This contains the shaders and their entrypoints for the state object.
     // Since shaders are not considered a subobject, they need to be passed in via DXIL library subobjects.
+    // The permutation the scene needs if it can be built, the library compiled in otherwise.
+    shader_permutation = ShaderPermutation::PermutationAll;
+    shader_permutation_library.clear();
+    shader_permutation_enabled = enable_shader_permutations;
+    if (enable_shader_permutations)
+    {
+        const std::uint32_t permutation = GetRequiredShaderPermutation();
+        if (permutation == ShaderPermutation::PermutationAll)
+        {
+            shader_permutation_status = "the scene uses every path, built in library";
+        }
+        else if (LoadShaderPermutation(permutation))
+        {
+            shader_permutation = permutation;
+        }
+    }
+    else
+    {
+        shader_permutation_status = "built in library";
+    }
+
     auto lib = raytracingPipeline.CreateSubobject<CD3D12_DXIL_LIBRARY_SUBOBJECT>();
-    D3D12_SHADER_BYTECODE libdxil = CD3DX12_SHADER_BYTECODE((void *)g_pRaytracing, ARRAYSIZE(g_pRaytracing));
+    D3D12_SHADER_BYTECODE libdxil = shader_permutation_library.empty()
+        ? CD3DX12_SHADER_BYTECODE((void *)g_pRaytracing, ARRAYSIZE(g_pRaytracing))
+        : CD3DX12_SHADER_BYTECODE(shader_permutation_library.data(), shader_permutation_library.size());
     lib->SetDXILLibrary(&libdxil);
     // Define which shader exports to surface from the library.
     // If no shader exports are defined for a DXIL library subobject, all shaders will be surfaced.
@@ -432,7 +503,7 @@ void D3D12RaytracingSimpleLighting::CreateRaytracingPipelineStateObject()
     // Shader config
     // Defines the maximum sizes in bytes for the ray payload and attribute structure.
     auto shaderConfig = raytracingPipeline.CreateSubobject<CD3D12_RAYTRACING_SHADER_CONFIG_SUBOBJECT>();
-	UINT payloadSize = sizeof(XMFLOAT4) + sizeof(XMFLOAT3) * 2;    // float4 pixelColor
+	UINT payloadSize = sizeof(UINT) * 2 + sizeof(XMFLOAT3) + sizeof(UINT) * 2 + sizeof(float) + sizeof(UINT) * 3;    // half pixelColor, origin, octahedral direction and hit normal, light pdf, half denoiser albedo and depth, octahedral normal
     UINT attributeSize = sizeof(XMFLOAT2);  // float2 barycentrics
     shaderConfig->Config(payloadSize, attributeSize);
 
@@ -468,6 +539,88 @@ void D3D12RaytracingSimpleLighting::CreateRaytracingPipelineStateObject()
     }
 }
 
+// The paths of the shaders the objects and features of the scene take right now.
+std::uint32_t D3D12RaytracingSimpleLighting::GetRequiredShaderPermutation() const
+{
+  std::vector<ShaderPermutation::ObjectShading> objects;
+  objects.reserve(m_sceneLoaded->objects.size());
+  for (const auto& object : m_sceneLoaded->objects)
+  {
+    ShaderPermutation::ObjectShading shading;
+    //the offset is only set once the descriptors are allocated, the texture before
+    shading.normal_map = object.textures.normalTex != nullptr || object.info_resource.info.texture_normal_offset != static_cast<UINT>(-1);
+    if (object.material != nullptr)
+    {
+      shading.reflectiveness = object.material->material.reflectiveness;
+      shading.refractiveness = object.material->material.refractiveness;
+      shading.emittance = object.material->material.emittance;
+      shading.roughness = object.material->material.roughness;
+    }
+    objects.push_back(shading);
+  }
+  return ShaderPermutation::Analyze(objects, m_sceneCB[m_deviceResources->GetCurrentFrameIndex()].features);
+}
+
+// Fills shader_permutation_library from the cache, or compiles and caches it. Returns
+// false if it can be neither, the reason is in shader_permutation_status.
+bool D3D12RaytracingSimpleLighting::LoadShaderPermutation(std::uint32_t permutation)
+{
+  shader_permutation_library.clear();
+  const std::string& compiler = shader_compiler.GetVersion();
+  if (compiler.empty())
+  {
+    shader_permutation_status = "dxcompiler.dll not found, built in library";
+    return false;
+  }
+
+  std::vector<ShaderPermutation::Source> sources;
+  std::string error;
+  if (!ShaderPermutation::ReadSources(c_raytracingShaderPath, sources, error))
+  {
+    shader_permutation_status = error + ", built in library";
+    return false;
+  }
+
+  const auto defines = ShaderPermutation::GetDefines(permutation);
+  const std::uint64_t key = ShaderPermutation::ComputeCacheKey(sources, defines, c_raytracingShaderTarget, c_raytracingShaderArguments, compiler);
+  const std::string path = ShaderPermutation::GetCachePath(c_shaderCacheDirectory, "Raytracing", key);
+  if (ShaderPermutation::LoadCached(path, key, shader_permutation_library))
+  {
+    shader_permutation_status = "loaded " + path;
+    return true;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  if (!shader_compiler.Compile(c_raytracingShaderPath, c_raytracingShaderTarget, c_raytracingShaderArguments, defines, shader_permutation_library, error))
+  {
+    shader_permutation_library.clear();
+    shader_permutation_status = "compile failed, built in library\n" + error;
+    OutputDebugStringA(("Shader permutation: " + error + "\n").c_str());
+    return false;
+  }
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::ostringstream status;
+  status << "compiled in " << std::fixed << std::setprecision(1) << seconds << " s";
+  status << (ShaderPermutation::StoreCached(path, key, shader_permutation_library) ? ", cached as " + path : ", could not write the cache");
+  shader_permutation_status = status.str();
+  return true;
+}
+
+// Builds the pipeline again when the scene takes a path the active permutation compiled
+// out, after an edit to a material or a feature, or when permutations are switched on or
+// off. Paths that fall out of use stay in until the scene is rebuilt.
+void D3D12RaytracingSimpleLighting::UpdateShaderPermutation()
+{
+  const bool missingPath = (GetRequiredShaderPermutation() & ~shader_permutation) != 0;
+  if (missingPath || enable_shader_permutations != shader_permutation_enabled)
+  {
+    m_deviceResources->WaitForGpu();
+    CreateRaytracingPipelineStateObject();
+    BuildShaderTables();
+  }
+}
+
 // Create 2D output texture for raytracing.
 void D3D12RaytracingSimpleLighting::CreateRaytracingOutputResource()
 {
@@ -482,198 +635,1033 @@ void D3D12RaytracingSimpleLighting::CreateRaytracingOutputResource()
           &defaultHeapProperties, D3D12_HEAP_FLAG_NONE, &uavDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr, IID_PPV_ARGS(&m_raytracingOutput)));
       NAME_D3D12_OBJECT(m_raytracingOutput);
 
+      //the output table is 9 contiguous descriptors, freed again when the window size changes
       D3D12_CPU_DESCRIPTOR_HANDLE uavDescriptorHandle;
-      m_raytracingOutputResourceUAVDescriptorHeapIndex = AllocateDescriptor(&uavDescriptorHandle, m_raytracingOutputResourceUAVDescriptorHeapIndex);
+      if (m_raytracingOutputResourceUAVDescriptorHeapIndex == UINT_MAX)
+      {
+        m_raytracingOutputResourceUAVDescriptorHeapIndex = AllocateDescriptor(&uavDescriptorHandle, DescriptorAllocator::RangeOutput, 9);
+      }
+      uavDescriptorHandle = GetDescriptorForWriting(m_raytracingOutputResourceUAVDescriptorHeapIndex);
       D3D12_UNORDERED_ACCESS_VIEW_DESC UAVDesc = {};
       UAVDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
       device->CreateUnorderedAccessView(m_raytracingOutput.Get(), nullptr, &UAVDesc, uavDescriptorHandle);
 	  m_raytracingOutputResourceUAVGpuDescriptor = CD3DX12_GPU_DESCRIPTOR_HANDLE(m_descriptorHeap->GetGPUDescriptorHandleForHeapStart(), m_raytracingOutputResourceUAVDescriptorHeapIndex, m_descriptorSize);
     }
 
+    //formats that need typed UAV loads the device does not have fall back to Float32
+    accumulation_format_fallback = !IsAccumulationFormatSupported(accumulation_format_requested);
+    accumulation_format = accumulation_format_fallback ? Accumulation::AccumulationFloat32 : accumulation_format_requested;
+    accumulation_format_requested = accumulation_format;
+    accumulation_dispatches = 0;
+
     {
-      // Create the output resource. The dimensions and format should match the swap-chain.
-      auto uavDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R32G32B32A32_FLOAT, m_width, m_height, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+      // Accumulation, sums or running means of the samples depending on the format.
+      const DXGI_FORMAT accumulationFormats[] = { DXGI_FORMAT_R32G32B32A32_FLOAT, DXGI_FORMAT_R16G16B16A16_FLOAT, DXGI_FORMAT_R11G11B10_FLOAT };
+      auto uavDesc = CD3DX12_RESOURCE_DESC::Tex2D(accumulationFormats[accumulation_format], m_width, m_height, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
 
       auto defaultHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
       ThrowIfFailed(device->CreateCommittedResource(
           &defaultHeapProperties, D3D12_HEAP_FLAG_NONE, &uavDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr, IID_PPV_ARGS(&pathtracing_accumulation_resource)));
       NAME_D3D12_OBJECT(pathtracing_accumulation_resource);
 
-      D3D12_CPU_DESCRIPTOR_HANDLE uavDescriptorHandle;
-      AllocateDescriptor(&uavDescriptorHandle, m_raytracingOutputResourceUAVDescriptorHeapIndex + 1);
+      D3D12_CPU_DESCRIPTOR_HANDLE uavDescriptorHandle = GetDescriptorForWriting(m_raytracingOutputResourceUAVDescriptorHeapIndex + 1);
       D3D12_UNORDERED_ACCESS_VIEW_DESC UAVDesc = {};
       UAVDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
       device->CreateUnorderedAccessView(pathtracing_accumulation_resource.Get(), nullptr, &UAVDesc, uavDescriptorHandle);
     }
-}
 
-void D3D12RaytracingSimpleLighting::CreateDescriptorHeap()
-{
-    auto device = m_deviceResources->GetD3DDevice();
+    {
+      // Sum of squared samples per pixel, used to estimate the variance for adaptive sampling.
+      auto uavDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R32G32B32A32_FLOAT, m_width, m_height, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
 
-    D3D12_DESCRIPTOR_HEAP_DESC descriptorHeapDesc = {};
-    // Allocate a heap for 5 descriptors:
-    // 2 - vertex and index buffer SRVs
-	// 1 - tex
-	// 1 - norm tex
-    // 1 - raytracing output texture SRV
-    // 2 - bottom and top level acceleration structure fallback wrapped pointer UAVs
-    descriptorHeapDesc.NumDescriptors = HEAP_DESCRIPTOR_SIZE; 
-    descriptorHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-    descriptorHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-    descriptorHeapDesc.NodeMask = 0;
-    device->CreateDescriptorHeap(&descriptorHeapDesc, IID_PPV_ARGS(&m_descriptorHeap));
-    NAME_D3D12_OBJECT(m_descriptorHeap);
+      auto defaultHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+      ThrowIfFailed(device->CreateCommittedResource(
+          &defaultHeapProperties, D3D12_HEAP_FLAG_NONE, &uavDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr, IID_PPV_ARGS(&pathtracing_second_moment_resource)));
+      NAME_D3D12_OBJECT(pathtracing_second_moment_resource);
 
-    m_descriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+      D3D12_CPU_DESCRIPTOR_HANDLE uavDescriptorHandle = GetDescriptorForWriting(m_raytracingOutputResourceUAVDescriptorHeapIndex + 2);
+      D3D12_UNORDERED_ACCESS_VIEW_DESC UAVDesc = {};
+      UAVDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
+      device->CreateUnorderedAccessView(pathtracing_second_moment_resource.Get(), nullptr, &UAVDesc, uavDescriptorHandle);
+    }
+
+    {
+      // Denoiser guides and buffers, right after the output table so Denoise.hlsl binds all of it as one table.
+      ComPtr<ID3D12Resource>* denoiserResources[] = { &denoiser_albedo_depth, &denoiser_normal, &denoiser_features, &denoiser_filter_buffers[0], &denoiser_filter_buffers[1] };
+      auto uavDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R32G32B32A32_FLOAT, m_width, m_height, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+      auto defaultHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+      for (UINT i = 0; i < ARRAYSIZE(denoiserResources); i++)
+      {
+        ThrowIfFailed(device->CreateCommittedResource(
+            &defaultHeapProperties, D3D12_HEAP_FLAG_NONE, &uavDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr, IID_PPV_ARGS(&(*denoiserResources[i]))));
+
+        D3D12_CPU_DESCRIPTOR_HANDLE uavDescriptorHandle = GetDescriptorForWriting(m_raytracingOutputResourceUAVDescriptorHeapIndex + 3 + i);
+        D3D12_UNORDERED_ACCESS_VIEW_DESC UAVDesc = {};
+        UAVDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
+        device->CreateUnorderedAccessView(denoiserResources[i]->Get(), nullptr, &UAVDesc, uavDescriptorHandle);
+      }
+      NAME_D3D12_OBJECT(denoiser_albedo_depth);
+      NAME_D3D12_OBJECT(denoiser_normal);
+      NAME_D3D12_OBJECT(denoiser_features);
+      NAME_D3D12_OBJECT_INDEXED(denoiser_filter_buffers, 0);
+      NAME_D3D12_OBJECT_INDEXED(denoiser_filter_buffers, 1);
+    }
+
+    {
+      // Rounding error of the Half accumulation, a null view in the other formats.
+      D3D12_CPU_DESCRIPTOR_HANDLE uavDescriptorHandle = GetDescriptorForWriting(m_raytracingOutputResourceUAVDescriptorHeapIndex + 8);
+      D3D12_UNORDERED_ACCESS_VIEW_DESC UAVDesc = {};
+      UAVDesc.Format = DXGI_FORMAT_R10G10B10A2_UNORM;
+      UAVDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
+      pathtracing_compensation_resource.Reset();
+      if (accumulation_format == Accumulation::AccumulationHalf)
+      {
+        auto uavDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R10G10B10A2_UNORM, m_width, m_height, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+        auto defaultHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+        ThrowIfFailed(device->CreateCommittedResource(
+            &defaultHeapProperties, D3D12_HEAP_FLAG_NONE, &uavDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr, IID_PPV_ARGS(&pathtracing_compensation_resource)));
+        NAME_D3D12_OBJECT(pathtracing_compensation_resource);
+      }
+      device->CreateUnorderedAccessView(pathtracing_compensation_resource.Get(), nullptr, &UAVDesc, uavDescriptorHandle);
+    }
+
+    for (auto& sceneCB : m_sceneCB)
+    {
+      sceneCB.output_width = m_width;
+      sceneCB.output_height = m_height;
+    }
+
+    CreateAdaptiveSamplingResources();
 }
 
-// Build geometry used in the sample.
-void D3D12RaytracingSimpleLighting::BuildGeometry()
+// Half and Packed are read and written in the raygen shader, which takes typed UAV
+// loads of the optional formats.
+bool D3D12RaytracingSimpleLighting::IsAccumulationFormatSupported(UINT format)
 {
+    if (format == Accumulation::AccumulationFloat32)
+    {
+      return true;
+    }
+
     auto device = m_deviceResources->GetD3DDevice();
+    D3D12_FEATURE_DATA_D3D12_OPTIONS options = {};
+    if (FAILED(device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options))) || !options.TypedUAVLoadAdditionalFormats)
+    {
+      return false;
+    }
 
-    // Cube indices.
-    Index indices[] =
+    const DXGI_FORMAT formats[] = { format == Accumulation::AccumulationHalf ? DXGI_FORMAT_R16G16B16A16_FLOAT : DXGI_FORMAT_R11G11B10_FLOAT, DXGI_FORMAT_R10G10B10A2_UNORM };
+    for (UINT i = 0; i < (format == Accumulation::AccumulationHalf ? 2u : 1u); i++)
     {
-        3,1,0,
-        2,1,3,
+      D3D12_FEATURE_DATA_FORMAT_SUPPORT support = { formats[i] };
+      const UINT required = D3D12_FORMAT_SUPPORT2_UAV_TYPED_LOAD | D3D12_FORMAT_SUPPORT2_UAV_TYPED_STORE;
+      if (FAILED(device->CheckFeatureSupport(D3D12_FEATURE_FORMAT_SUPPORT, &support, sizeof(support))) || (support.Support2 & required) != required)
+      {
+        return false;
+      }
+    }
+    return true;
+}
 
-        6,4,5,
-        7,4,6,
+// Create the tile list and tile error buffers used by adaptive sampling.
+void D3D12RaytracingSimpleLighting::CreateAdaptiveSamplingResources()
+{
+    auto device = m_deviceResources->GetD3DDevice();
 
-        11,9,8,
-        10,9,11,
+    adaptive_sampler.Resize(m_width, m_height, ADAPTIVE_TILE_SIZE);
+    adaptive_sampler.SetThreshold(adaptive_threshold);
+    adaptive_sampler.SetMinSamples(adaptive_min_samples);
 
-        14,12,13,
-        15,12,14,
+    //anything in flight was measured on the old grid
+    adaptive_epoch++;
+    for (auto& pending : adaptive_readback_pending)
+    {
+      pending = false;
+    }
 
-        19,17,16,
-        18,17,19,
+    for (auto& sceneCB : m_sceneCB)
+    {
+      sceneCB.adaptive_tiles_x = adaptive_sampler.GetTilesX();
+    }
 
-        22,20,21,
-        23,20,22
-    };
+    const UINT64 tileBufferSize = std::max(adaptive_sampler.GetTileCount(), 1u) * sizeof(UINT);
 
-    // Cube vertices positions and corresponding triangle normals.
-    Vertex vertices[] =
+    // One float (as uint) per tile, written with InterlockedMax by the raygen shader.
     {
-        { XMFLOAT3(-1.0f, 1.0f, -1.0f), XMFLOAT3(0.0f, 1.0f, 0.0f) },
-        { XMFLOAT3(1.0f, 1.0f, -1.0f), XMFLOAT3(0.0f, 1.0f, 0.0f) },
-        { XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(0.0f, 1.0f, 0.0f) },
-        { XMFLOAT3(-1.0f, 1.0f, 1.0f), XMFLOAT3(0.0f, 1.0f, 0.0f) },
+      auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(tileBufferSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+      ThrowIfFailed(device->CreateCommittedResource(
+          &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT), D3D12_HEAP_FLAG_NONE, &bufferDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr, IID_PPV_ARGS(&adaptive_tile_errors)));
+      NAME_D3D12_OBJECT(adaptive_tile_errors);
+    }
 
-        { XMFLOAT3(-1.0f, -1.0f, -1.0f), XMFLOAT3(0.0f, -1.0f, 0.0f) },
-        { XMFLOAT3(1.0f, -1.0f, -1.0f), XMFLOAT3(0.0f, -1.0f, 0.0f) },
-        { XMFLOAT3(1.0f, -1.0f, 1.0f), XMFLOAT3(0.0f, -1.0f, 0.0f) },
-        { XMFLOAT3(-1.0f, -1.0f, 1.0f), XMFLOAT3(0.0f, -1.0f, 0.0f) },
+    // Zeroes copied over the tile errors before every dispatch.
+    {
+      auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(tileBufferSize);
+      ThrowIfFailed(device->CreateCommittedResource(
+          &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD), D3D12_HEAP_FLAG_NONE, &bufferDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&adaptive_tile_errors_zero)));
+      NAME_D3D12_OBJECT(adaptive_tile_errors_zero);
 
-        { XMFLOAT3(-1.0f, -1.0f, 1.0f), XMFLOAT3(-1.0f, 0.0f, 0.0f) },
-        { XMFLOAT3(-1.0f, -1.0f, -1.0f), XMFLOAT3(-1.0f, 0.0f, 0.0f) },
-        { XMFLOAT3(-1.0f, 1.0f, -1.0f), XMFLOAT3(-1.0f, 0.0f, 0.0f) },
-        { XMFLOAT3(-1.0f, 1.0f, 1.0f), XMFLOAT3(-1.0f, 0.0f, 0.0f) },
+      void* mapped_data;
+      ThrowIfFailed(adaptive_tile_errors_zero->Map(0, nullptr, &mapped_data));
+      memset(mapped_data, 0, static_cast<size_t>(tileBufferSize));
+      adaptive_tile_errors_zero->Unmap(0, nullptr);
+    }
 
-        { XMFLOAT3(1.0f, -1.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) },
-        { XMFLOAT3(1.0f, -1.0f, -1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) },
-        { XMFLOAT3(1.0f, 1.0f, -1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) },
-        { XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) },
+    // One slice per frame in flight, the slice of a frame is safe to read once we get back to that frame index.
+    {
+      auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(tileBufferSize * FrameCount);
+      ThrowIfFailed(device->CreateCommittedResource(
+          &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK), D3D12_HEAP_FLAG_NONE, &bufferDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&adaptive_tile_errors_readback)));
+      NAME_D3D12_OBJECT(adaptive_tile_errors_readback);
+    }
 
-        { XMFLOAT3(-1.0f, -1.0f, -1.0f), XMFLOAT3(0.0f, 0.0f, -1.0f) },
-        { XMFLOAT3(1.0f, -1.0f, -1.0f), XMFLOAT3(0.0f, 0.0f, -1.0f) },
-        { XMFLOAT3(1.0f, 1.0f, -1.0f), XMFLOAT3(0.0f, 0.0f, -1.0f) },
-        { XMFLOAT3(-1.0f, 1.0f, -1.0f), XMFLOAT3(0.0f, 0.0f, -1.0f) },
+    // Active tile list, one slice per frame in flight, kept mapped like the constant buffers.
+    {
+      auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(tileBufferSize * FrameCount);
+      ThrowIfFailed(device->CreateCommittedResource(
+          &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD), D3D12_HEAP_FLAG_NONE, &bufferDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&adaptive_active_tiles)));
+      NAME_D3D12_OBJECT(adaptive_active_tiles);
 
-        { XMFLOAT3(-1.0f, -1.0f, 1.0f), XMFLOAT3(0.0f, 0.0f, 1.0f) },
-        { XMFLOAT3(1.0f, -1.0f, 1.0f), XMFLOAT3(0.0f, 0.0f, 1.0f) },
-        { XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(0.0f, 0.0f, 1.0f) },
-        { XMFLOAT3(-1.0f, 1.0f, 1.0f), XMFLOAT3(0.0f, 0.0f, 1.0f) },
-    };
+      ThrowIfFailed(adaptive_active_tiles->Map(0, nullptr, reinterpret_cast<void**>(&adaptive_mapped_active_tiles)));
+    }
+}
 
-   // AllocateUploadBuffer(device, indices, sizeof(indices), &m_indexBufferCube.resource);
-   // AllocateUploadBuffer(device, vertices, sizeof(vertices), &m_vertexBufferCube.resource);
+// Pick up the tile errors of the last frame that used this frame index and retire converged tiles.
+void D3D12RaytracingSimpleLighting::UpdateAdaptiveSampling()
+{
+    auto frameIndex = m_deviceResources->GetCurrentFrameIndex();
 
-    // Vertex buffer is passed to the shader along with index buffer as a descriptor table.
-    // Vertex buffer descriptor must follow index buffer descriptor in the descriptor heap.
+    // MoveToNextFrame already waited for the previous use of this frame index,
+    // so its readback slice is complete and no extra fence wait is needed.
+    if (adaptive_readback_pending[frameIndex] && adaptive_readback_epoch[frameIndex] == adaptive_epoch)
+    {
+      const UINT tileCount = adaptive_sampler.GetTileCount();
+      const SIZE_T sliceSize = tileCount * sizeof(float);
+      D3D12_RANGE sliceRange = { frameIndex * sliceSize, (frameIndex + 1) * sliceSize };
+      D3D12_RANGE noWriteRange = { 0, 0 };
 
-	//UINT descriptorIndexIB = CreateBufferSRV(&m_indexBufferCube, 36 * sizeof(Index) / 4, 0);
-	//UINT descriptorIndexVB = CreateBufferSRV(&m_vertexBufferCube, 6 , sizeof(vertices[0]));
-    //ThrowIfFalse(descriptorIndexVB == descriptorIndexIB + 1, L"Vertex Buffer descriptor index must follow that of Index Buffer descriptor index!");
-    //ThrowIfFalse(descriptorIndexVB == descriptorIndexIB + 1, L"Vertex Buffer descriptor index must follow that of Index Buffer descriptor index!");
+      void* mapped_data;
+      ThrowIfFailed(adaptive_tile_errors_readback->Map(0, &sliceRange, &mapped_data));
+      adaptive_sampler.ApplyTileErrors(reinterpret_cast<const float*>(static_cast<BYTE*>(mapped_data) + sliceRange.Begin), tileCount);
+      adaptive_tile_errors_readback->Unmap(0, &noWriteRange);
+    }
+    adaptive_readback_pending[frameIndex] = false;
+
+    const auto& active_tiles = adaptive_sampler.GetActiveTiles();
+    if (!active_tiles.empty())
+    {
+      memcpy(adaptive_mapped_active_tiles + frameIndex * adaptive_sampler.GetTileCount(), active_tiles.data(), active_tiles.size() * sizeof(UINT));
+    }
 }
 
-// Build acceleration structures needed for raytracing.
-void D3D12RaytracingSimpleLighting::BuildAccelerationStructures()
+// Rebuild the emissive triangle list and upload it for next event estimation.
+void D3D12RaytracingSimpleLighting::UpdateLightList()
 {
     auto device = m_deviceResources->GetD3DDevice();
-    auto commandList = m_deviceResources->GetCommandList();
-    auto commandQueue = m_deviceResources->GetCommandQueue();
-    auto commandAllocator = m_deviceResources->GetCommandAllocator();
 
-    // Reset the command list for the acceleration structure construction.
-    commandList->Reset(commandAllocator, nullptr);
+    m_sceneLoaded->BuildLightList();
+    const auto& lights = m_sceneLoaded->lights.GetTriangles();
+    std::vector<EmissiveTriangle> triangles(lights.size());
+    for (size_t i = 0; i < lights.size(); i++)
+    {
+      const LightList::Triangle& light = lights[i];
+      EmissiveTriangle& triangle = triangles[i];
+      triangle.v0 = XMFLOAT3(light.v0.x, light.v0.y, light.v0.z);
+      triangle.area = light.area;
+      triangle.v1 = XMFLOAT3(light.v1.x, light.v1.y, light.v1.z);
+      triangle.pdf = light.pdf;
+      triangle.v2 = XMFLOAT3(light.v2.x, light.v2.y, light.v2.z);
+      triangle.alias = light.alias;
+      triangle.radiance = XMFLOAT3(light.radiance.x, light.radiance.y, light.radiance.z);
+      triangle.alias_probability = light.alias_probability;
+    }
 
-    // What API is used
-    bool is_fallback = m_raytracingAPI == RaytracingAPI::FallbackLayer;
+    // Keep at least one entry so the root SRV always points at a valid buffer.
+    const UINT64 bufferSize = std::max<UINT64>(triangles.size(), 1) * sizeof(EmissiveTriangle);
+    light_list_resource.Reset();
+    auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize);
+    ThrowIfFailed(device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD), D3D12_HEAP_FLAG_NONE, &bufferDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&light_list_resource)));
+    NAME_D3D12_OBJECT(light_list_resource);
 
-    // Build bottom levels
-    for (auto& model_pair : m_sceneLoaded->modelMap)
+    void* mapped_data;
+    ThrowIfFailed(light_list_resource->Map(0, nullptr, &mapped_data));
+    memset(mapped_data, 0, static_cast<size_t>(bufferSize));
+    if (!triangles.empty())
     {
-       //int id = model_pair.first;
-       ModelLoading::Model& model = model_pair.second;
-       model.GetGeomDesc();
-       model.GetBottomLevelBuildDesc();
-       model.GetPreBuild(is_fallback, m_fallbackDevice, m_dxrDevice);
-       model.GetBottomLevelScratchAS(is_fallback, device, m_fallbackDevice,m_dxrDevice);
-       model.GetBottomAS(is_fallback, device, m_fallbackDevice,m_dxrDevice);
-
-       //m_sceneLoaded->modelMap[id] = model;
+      memcpy(mapped_data, triangles.data(), triangles.size() * sizeof(EmissiveTriangle));
     }
+    light_list_resource->Unmap(0, nullptr);
 
-    // Build top level
-    m_sceneLoaded->GetTopLevelDesc();
-    m_sceneLoaded->GetTopLevelPrebuildInfo(is_fallback, m_fallbackDevice, m_dxrDevice);
-    m_sceneLoaded->GetTopLevelScratchAS(is_fallback, device, m_fallbackDevice, m_dxrDevice);
-    m_sceneLoaded->GetTopAS(is_fallback, device, m_fallbackDevice, m_dxrDevice);
-    m_sceneLoaded->GetInstanceDescriptors(is_fallback, m_fallbackDevice, m_dxrDevice);
+    for (auto& sceneCB : m_sceneCB)
+    {
+      sceneCB.light_count = m_sceneLoaded->lights.GetSampleableCount();
+    }
+}
 
-    // Finalize the allocation
-    m_fallbackTopLevelAccelerationStructurePointer = m_sceneLoaded->GetWrappedGPUPointer(is_fallback, m_fallbackDevice, m_dxrDevice);
-    m_sceneLoaded->FinalizeAS();
+// Copy the render settings a scene file may carry over to the features and the constant buffers.
+void D3D12RaytracingSimpleLighting::ApplySceneRenderSettings()
+{
+    const auto& camera = m_sceneLoaded->camera;
+    enable_russian_roulette = camera.russian_roulette;
+    feature_rr_min_depth = static_cast<UINT>(std::max(camera.rr_min_depth, 0));
 
-    // Actually build the AS (executing command lists)
-    m_sceneLoaded->BuildAllAS(is_fallback, m_fallbackDevice, m_dxrDevice, m_fallbackCommandList, m_dxrCommandList);
+    for (auto& sceneCB : m_sceneCB)
+    {
+      sceneCB.features = enable_russian_roulette ? (sceneCB.features | RussianRoulette) : (sceneCB.features & ~RussianRoulette);
+      sceneCB.rr_min_depth = feature_rr_min_depth;
+    }
 }
 
-// Build shader tables.
-// This encapsulates all shader records - shaders and the arguments for their local root signatures.
-void D3D12RaytracingSimpleLighting::BuildShaderTables()
+// Create the counters the raygen shader adds its paths, path segments and ray statistics to.
+void D3D12RaytracingSimpleLighting::CreatePathStatisticsResources()
 {
     auto device = m_deviceResources->GetD3DDevice();
+    const UINT64 counterSize = c_pathStatsSize;
 
-    void* rayGenShaderIdentifier;
-    void* missShaderIdentifier;
-    void* hitGroupShaderIdentifier;
-
-    auto GetShaderIdentifiers = [&](auto* stateObjectProperties)
+    for (auto& pending : path_stats_pending)
     {
-        rayGenShaderIdentifier = stateObjectProperties->GetShaderIdentifier(c_raygenShaderName);
-        missShaderIdentifier = stateObjectProperties->GetShaderIdentifier(c_missShaderName);
-        hitGroupShaderIdentifier = stateObjectProperties->GetShaderIdentifier(c_hitGroupName);
-    };
+      pending = false;
+    }
 
-    // Get shader identifiers.
-    UINT shaderIdentifierSize;
-    if (m_raytracingAPI == RaytracingAPI::FallbackLayer)
     {
-        GetShaderIdentifiers(m_fallbackStateObject.Get());
-        shaderIdentifierSize = m_fallbackDevice->GetShaderIdentifierSize();
+      auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(counterSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+      ThrowIfFailed(device->CreateCommittedResource(
+          &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT), D3D12_HEAP_FLAG_NONE, &bufferDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr, IID_PPV_ARGS(&path_stats)));
+      NAME_D3D12_OBJECT(path_stats);
     }
-    else // DirectX Raytracing
+
+    // Zeroes copied over the counters before every dispatch.
     {
-        ComPtr<ID3D12StateObjectPropertiesPrototype> stateObjectProperties;
-        ThrowIfFailed(m_dxrStateObject.As(&stateObjectProperties));
-        GetShaderIdentifiers(stateObjectProperties.Get());
-        shaderIdentifierSize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES;
+      auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(counterSize);
+      ThrowIfFailed(device->CreateCommittedResource(
+          &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD), D3D12_HEAP_FLAG_NONE, &bufferDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&path_stats_zero)));
+      NAME_D3D12_OBJECT(path_stats_zero);
+
+      void* mapped_data;
+      ThrowIfFailed(path_stats_zero->Map(0, nullptr, &mapped_data));
+      memset(mapped_data, 0, static_cast<size_t>(counterSize));
+      path_stats_zero->Unmap(0, nullptr);
+    }
+
+    // One slice per frame in flight, same as the adaptive tile errors.
+    {
+      auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(counterSize * FrameCount);
+      ThrowIfFailed(device->CreateCommittedResource(
+          &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK), D3D12_HEAP_FLAG_NONE, &bufferDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&path_stats_readback)));
+      NAME_D3D12_OBJECT(path_stats_readback);
+    }
+}
+
+// Pick up the counters of the last frame that used this frame index.
+void D3D12RaytracingSimpleLighting::UpdatePathStatistics()
+{
+    auto frameIndex = m_deviceResources->GetCurrentFrameIndex();
+    if (!path_stats_pending[frameIndex])
+    {
+      return;
+    }
+    path_stats_pending[frameIndex] = false;
+
+    const SIZE_T sliceSize = static_cast<SIZE_T>(c_pathStatsSize);
+    D3D12_RANGE sliceRange = { frameIndex * sliceSize, (frameIndex + 1) * sliceSize };
+    D3D12_RANGE noWriteRange = { 0, 0 };
+
+    void* mapped_data;
+    ThrowIfFailed(path_stats_readback->Map(0, &sliceRange, &mapped_data));
+    const UINT* counters = reinterpret_cast<const UINT*>(static_cast<BYTE*>(mapped_data) + sliceRange.Begin);
+    for (UINT i = 0; i < RayStats::RayStatCount; i++)
+    {
+      path_stats_counters[i] += counters[i];
+    }
+    const UINT paths = counters[RayStats::RayStatPaths];
+    const UINT segments = counters[RayStats::RayStatSegments];
+    path_stats_readback->Unmap(0, &noWriteRange);
+
+    const int phase = path_stats_benchmark_phase[frameIndex];
+    if (phase == rr_benchmark_phase && phase >= 0)
+    {
+      rr_benchmark_paths[phase] += paths;
+      rr_benchmark_segments[phase] += segments;
+    }
+}
+
+// Render c_rrBenchmarkFrames frames without and then with russian roulette, same scene and view.
+void D3D12RaytracingSimpleLighting::StartRussianRouletteBenchmark()
+{
+    rr_benchmark_saved_features = m_sceneCB[m_deviceResources->GetCurrentFrameIndex()].features;
+    rr_benchmark_phase = 0;
+    rr_benchmark_frames = 0;
+    rr_benchmark_report.clear();
+    for (int phase = 0; phase < 2; phase++)
+    {
+      rr_benchmark_seconds[phase] = 0.0;
+      rr_benchmark_paths[phase] = 0;
+      rr_benchmark_segments[phase] = 0;
+    }
+
+    for (auto& sceneCB : m_sceneCB)
+    {
+      sceneCB.features &= ~RussianRoulette;
+    }
+    m_camChanged = true;
+}
+
+void D3D12RaytracingSimpleLighting::UpdateRussianRouletteBenchmark(double elapsedSeconds)
+{
+    if (rr_benchmark_phase < 0)
+    {
+      return;
+    }
+
+    // The first frame of a phase still carries the time of the switch.
+    if (rr_benchmark_frames > 0)
+    {
+      rr_benchmark_seconds[rr_benchmark_phase] += elapsedSeconds;
+    }
+    if (++rr_benchmark_frames <= c_rrBenchmarkFrames)
+    {
+      return;
+    }
+
+    rr_benchmark_frames = 0;
+    if (rr_benchmark_phase == 0)
+    {
+      rr_benchmark_phase = 1;
+      for (auto& sceneCB : m_sceneCB)
+      {
+        sceneCB.features |= RussianRoulette;
+      }
+      m_camChanged = true;
+      return;
+    }
+
+    rr_benchmark_phase = -1;
+    for (auto& sceneCB : m_sceneCB)
+    {
+      sceneCB.features = rr_benchmark_saved_features;
+    }
+    m_camChanged = true;
+
+    double ms[2];
+    double length[2];
+    for (int phase = 0; phase < 2; phase++)
+    {
+      ms[phase] = 1000.0 * rr_benchmark_seconds[phase] / c_rrBenchmarkFrames;
+      length[phase] = rr_benchmark_paths[phase] > 0 ? static_cast<double>(rr_benchmark_segments[phase]) / rr_benchmark_paths[phase] : 0.0;
+    }
+
+    char report[256];
+    snprintf(report, sizeof(report),
+      "Without RR: %.2f ms/frame, %.2f segments/path\n"
+      "With RR:    %.2f ms/frame, %.2f segments/path\n"
+      "Speedup:    %.2fx",
+      ms[0], length[0], ms[1], length[1], ms[1] > 0.0 ? ms[0] / ms[1] : 0.0);
+    rr_benchmark_report = report;
+    OutputDebugStringA((rr_benchmark_report + "\n").c_str());
+}
+
+// Start (or resume) a tiled render of tiled_render_settings. Tiles are bounded by the window.
+void D3D12RaytracingSimpleLighting::StartTiledRender()
+{
+    auto device = m_deviceResources->GetD3DDevice();
+
+    StopTiledRender();
+    StopSequenceCapture();
+
+    if (!tiled_render_job.Start(tiled_render_settings, m_width, m_height))
+    {
+      tiled_render_status = "Could not open " + tiled_render_settings.output_path + ".rgba32f";
+      return;
+    }
+
+    // Sized for the largest tile, edge tiles use part of it.
+    const auto& settings = tiled_render_job.GetSettings();
+    tiled_render_readback_row_pitch = Align(static_cast<UINT>(settings.tile_width * 4 * sizeof(float)), D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
+    auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(UINT64(tiled_render_readback_row_pitch) * settings.tile_height);
+    ThrowIfFailed(device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK), D3D12_HEAP_FLAG_NONE, &bufferDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&tiled_render_readback)));
+    NAME_D3D12_OBJECT(tiled_render_readback);
+
+    tiled_render_status = "Rendering";
+
+    //the camera now renders at the aspect ratio of the target image
+    UpdateCameraMatrices();
+    m_camChanged = true;
+}
+
+// Cancel a running job (it can be resumed later) and go back to interactive rendering.
+void D3D12RaytracingSimpleLighting::StopTiledRender()
+{
+    if (tiled_render_readback_pending)
+    {
+      m_deviceResources->WaitForGpu();
+      tiled_render_readback_pending = false;
+    }
+
+    if (tiled_render_job.IsActive())
+    {
+      tiled_render_job.Cancel();
+      tiled_render_status = "Cancelled, start again with the same settings to resume";
+    }
+
+    tiled_render_tile_active = false;
+    tiled_render_tile_samples = 0;
+    tiled_render_readback.Reset();
+
+    for (auto& sceneCB : m_sceneCB)
+    {
+      sceneCB.output_width = m_width;
+      sceneCB.output_height = m_height;
+      sceneCB.tile_offset_x = 0;
+      sceneCB.tile_offset_y = 0;
+    }
+
+    UpdateCameraMatrices();
+    m_camChanged = true;
+}
+
+// Resolve finished readbacks, hand out the next tile and point this frame's constants at it.
+void D3D12RaytracingSimpleLighting::UpdateTiledRender()
+{
+    auto frameIndex = m_deviceResources->GetCurrentFrameIndex();
+
+    ResolveTiledRenderTile(false);
+
+    if (tiled_render_job.IsFinished())
+    {
+      const std::string output_path = tiled_render_job.GetSettings().output_path;
+      tiled_render_status = tiled_render_job.Finish() ? "Saved " + output_path : "Could not write " + output_path;
+      StopTiledRender();
+      return;
+    }
+
+    if (!tiled_render_tile_active && tiled_render_job.HasNextTile())
+    {
+      tiled_render_tile = tiled_render_job.TakeNextTile();
+      tiled_render_tile_samples = 0;
+      tiled_render_tile_active = true;
+    }
+
+    auto& sceneCB = m_sceneCB[frameIndex];
+    sceneCB.output_width = tiled_render_job.GetSettings().width;
+    sceneCB.output_height = tiled_render_job.GetSettings().height;
+    sceneCB.tile_offset_x = tiled_render_tile.x;
+    sceneCB.tile_offset_y = tiled_render_tile.y;
+}
+
+// Copy the finished tile out of the accumulator, the clear at the end of the frame starts the next one.
+void D3D12RaytracingSimpleLighting::ReadBackTiledRenderTile()
+{
+    auto commandList = m_deviceResources->GetCommandList();
+
+    //only one tile in flight, the previous one was recorded at least a frame ago
+    ResolveTiledRenderTile(true);
+
+    ID3D12Resource* accumulation = ResolveAccumulation();
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT bufferFootprint = {};
+    bufferFootprint.Footprint.Width = tiled_render_tile.width;
+    bufferFootprint.Footprint.Height = tiled_render_tile.height;
+    bufferFootprint.Footprint.Depth = 1;
+    bufferFootprint.Footprint.RowPitch = tiled_render_readback_row_pitch;
+    bufferFootprint.Footprint.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+
+    CD3DX12_TEXTURE_COPY_LOCATION copyDest(tiled_render_readback.Get(), bufferFootprint);
+    CD3DX12_TEXTURE_COPY_LOCATION copySrc(accumulation, 0);
+    D3D12_BOX tileBox = { 0, 0, 0, tiled_render_tile.width, tiled_render_tile.height, 1 };
+
+    D3D12_RESOURCE_BARRIER preCopyBarrier = CD3DX12_RESOURCE_BARRIER::Transition(accumulation, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    commandList->ResourceBarrier(1, &preCopyBarrier);
+    commandList->CopyTextureRegion(&copyDest, 0, 0, 0, &copySrc, &tileBox);
+    D3D12_RESOURCE_BARRIER postCopyBarrier = CD3DX12_RESOURCE_BARRIER::Transition(accumulation, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    commandList->ResourceBarrier(1, &postCopyBarrier);
+
+    tiled_render_readback_tile = tiled_render_tile;
+    tiled_render_readback_pending = true;
+    tiled_render_readback_fence_value = 0;
+    tiled_render_tile_active = false;
+    m_camChanged = true;
+}
+
+// Hand a read back tile to the job once the GPU is done with it, optionally blocking.
+void D3D12RaytracingSimpleLighting::ResolveTiledRenderTile(bool wait)
+{
+    if (!tiled_render_readback_pending || tiled_render_readback_fence_value == 0)
+    {
+      return;
+    }
+
+    if (!m_deviceResources->IsFenceComplete(tiled_render_readback_fence_value))
+    {
+      if (!wait)
+      {
+        return;
+      }
+      m_deviceResources->WaitForGpu();
+    }
+
+    const SIZE_T tileSize = SIZE_T(tiled_render_readback_row_pitch) * tiled_render_readback_tile.height;
+    D3D12_RANGE tileRange = { 0, tileSize };
+    D3D12_RANGE noWriteRange = { 0, 0 };
+
+    void* mapped_data;
+    ThrowIfFailed(tiled_render_readback->Map(0, &tileRange, &mapped_data));
+    tiled_render_job.CompleteTile(tiled_render_readback_tile, static_cast<const float*>(mapped_data), tiled_render_readback_row_pitch / sizeof(float));
+    tiled_render_readback->Unmap(0, &noWriteRange);
+
+    tiled_render_readback_pending = false;
+}
+
+// Render the keyframed camera path of the scene into numbered images at the window size.
+void D3D12RaytracingSimpleLighting::StartSequenceCapture()
+{
+    auto device = m_deviceResources->GetD3DDevice();
+
+    //both accumulate into the same buffer
+    StopSequenceCapture();
+    StopTiledRender();
+
+    if (m_sceneLoaded == nullptr || m_sceneLoaded->camera.path.IsEmpty())
+    {
+      capture_status = "The scene has no camera keyframes";
+      return;
+    }
+    if (!sequence_capture.Start(m_sceneLoaded->camera.path, capture_settings, m_width, m_height))
+    {
+      capture_status = "Cannot write " + SequenceCapture::GetFramePath(capture_settings.output_pattern, 0);
+      return;
+    }
+
+    capture_readback_row_pitch = Align(static_cast<UINT>(m_width * 4 * sizeof(float)), D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
+    auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(UINT64(capture_readback_row_pitch) * m_height);
+    for (UINT i = 0; i < sequence_capture.GetSettings().readback_slots; i++)
+    {
+      ThrowIfFailed(device->CreateCommittedResource(
+          &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK), D3D12_HEAP_FLAG_NONE, &bufferDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&capture_readbacks[i])));
+      NAME_D3D12_OBJECT_INDEXED(capture_readbacks, i);
+    }
+
+    capture_saved_camera = m_sceneLoaded->camera;
+    capture_camera_frame = -1;
+    capture_frame_samples = 0;
+    capture_status = "Capturing";
+}
+
+// Cancel (frames already read back are still written) and put the scene camera back.
+void D3D12RaytracingSimpleLighting::StopSequenceCapture()
+{
+    if (!sequence_capture.IsActive())
+    {
+      return;
+    }
+
+    if (!sequence_capture.IsFinished())
+    {
+      capture_status = "Cancelled after " + std::to_string(sequence_capture.GetNextFrame()) + " of " + std::to_string(sequence_capture.GetFrameCount()) + " frames";
+    }
+
+    //copies into the readback slots may still be in flight
+    m_deviceResources->WaitForGpu();
+    sequence_capture.Stop();
+    for (auto& readback : capture_readbacks)
+    {
+      readback.Reset();
+    }
+
+    if (m_sceneLoaded != nullptr)
+    {
+      m_sceneLoaded->camera.eye = capture_saved_camera.eye;
+      m_sceneLoaded->camera.lookat = capture_saved_camera.lookat;
+      m_sceneLoaded->camera.fov = capture_saved_camera.fov;
+    }
+    capture_camera_frame = -1;
+    capture_frame_samples = 0;
+
+    UpdateCameraMatrices();
+    m_camChanged = true;
+}
+
+// Hand completed readbacks to the encoders and point the camera at the frame being accumulated.
+void D3D12RaytracingSimpleLighting::UpdateSequenceCapture()
+{
+    if (m_width != sequence_capture.GetWidth() || m_height != sequence_capture.GetHeight())
+    {
+      StopSequenceCapture();
+      capture_status = "Cancelled, the window was resized";
+      return;
+    }
+
+    sequence_capture.Update();
+
+    //the encoders only take a readback when they have room, otherwise it stays in its slot
+    const UINT height = sequence_capture.GetHeight();
+    const size_t rowFloats = size_t(sequence_capture.GetWidth()) * 4;
+    unsigned int slot = 0;
+    unsigned int frame = 0;
+    while (sequence_capture.PopReadback(m_deviceResources->GetCompletedFenceValue(), slot, frame))
+    {
+      D3D12_RANGE frameRange = { 0, SIZE_T(capture_readback_row_pitch) * height };
+      D3D12_RANGE noWriteRange = { 0, 0 };
+
+      void* mapped_data;
+      ThrowIfFailed(capture_readbacks[slot]->Map(0, &frameRange, &mapped_data));
+      std::vector<float> accumulation(rowFloats * height);
+      for (UINT y = 0; y < height; y++)
+      {
+        memcpy(accumulation.data() + y * rowFloats, static_cast<const BYTE*>(mapped_data) + size_t(y) * capture_readback_row_pitch, rowFloats * sizeof(float));
+      }
+      capture_readbacks[slot]->Unmap(0, &noWriteRange);
+
+      sequence_capture.Submit(slot, frame, std::move(accumulation));
+    }
+
+    if (sequence_capture.IsFinished())
+    {
+      const auto& stats = sequence_capture.GetStatistics();
+      capture_status = "Wrote " + std::to_string(stats.frames_written) + " frames";
+      if (stats.frames_failed > 0)
+      {
+        capture_status += ", " + std::to_string(stats.frames_failed) + " failed";
+      }
+      StopSequenceCapture();
+      return;
+    }
+
+    //a new frame starts from a cleared accumulation at its point of the path
+    if (sequence_capture.IsRendering() && capture_camera_frame != static_cast<int>(sequence_capture.GetNextFrame()))
+    {
+      capture_camera_frame = static_cast<int>(sequence_capture.GetNextFrame());
+      const CameraPath::Keyframe camera = sequence_capture.GetCamera(capture_camera_frame);
+      m_sceneLoaded->camera.eye = XMVectorSet(camera.eye.x, camera.eye.y, camera.eye.z, 1.0f);
+      m_sceneLoaded->camera.lookat = XMVectorSet(camera.lookat.x, camera.lookat.y, camera.lookat.z, 1.0f);
+      m_sceneLoaded->camera.fov = camera.fov;
+      UpdateCameraMatrices();
+      m_camChanged = true;
+    }
+}
+
+// Copy the converged frame into a free readback slot. With every slot busy the frame
+// keeps accumulating and the copy is tried again next frame.
+void D3D12RaytracingSimpleLighting::ReadBackSequenceFrame()
+{
+    auto commandList = m_deviceResources->GetCommandList();
+
+    const int slot = sequence_capture.AcquireSlot();
+    if (slot < 0)
+    {
+      return;
+    }
+
+    ID3D12Resource* accumulation = ResolveAccumulation();
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT bufferFootprint = {};
+    bufferFootprint.Footprint.Width = sequence_capture.GetWidth();
+    bufferFootprint.Footprint.Height = sequence_capture.GetHeight();
+    bufferFootprint.Footprint.Depth = 1;
+    bufferFootprint.Footprint.RowPitch = capture_readback_row_pitch;
+    bufferFootprint.Footprint.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+
+    CD3DX12_TEXTURE_COPY_LOCATION copyDest(capture_readbacks[slot].Get(), bufferFootprint);
+    CD3DX12_TEXTURE_COPY_LOCATION copySrc(accumulation, 0);
+
+    D3D12_RESOURCE_BARRIER preCopyBarrier = CD3DX12_RESOURCE_BARRIER::Transition(accumulation, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    commandList->ResourceBarrier(1, &preCopyBarrier);
+    commandList->CopyTextureRegion(&copyDest, 0, 0, 0, &copySrc, nullptr);
+    D3D12_RESOURCE_BARRIER postCopyBarrier = CD3DX12_RESOURCE_BARRIER::Transition(accumulation, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    commandList->ResourceBarrier(1, &postCopyBarrier);
+
+    capture_frame_samples = 0;
+}
+
+void D3D12RaytracingSimpleLighting::CreateDescriptorHeap()
+{
+    auto device = m_deviceResources->GetD3DDevice();
+    m_descriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+    // Every descriptor of the last scene goes back to the allocator, the heaps are kept.
+    // Reserving the ranges for this scene up front means the heaps grow at most once
+    // here and not in the middle of handing out GPU handles.
+    m_descriptorAllocator.Reset();
+    m_raytracingOutputResourceUAVDescriptorHeapIndex = UINT_MAX;
+    m_dirtyDescriptorsBegin = UINT_MAX;
+    m_dirtyDescriptorsEnd = 0;
+    m_descriptorHeapGrown = false;
+
+    UINT models = static_cast<UINT>(m_sceneLoaded->modelMap.size());
+    bool wrappedPointers = m_raytracingAPI == RaytracingAPI::FallbackLayer && !m_fallbackDevice->UsingRaytracingDriver();
+    m_descriptorAllocator.Reserve(DescriptorAllocator::RangeOutput, 9);
+    // positions, indices and attributes
+    m_descriptorAllocator.Reserve(DescriptorAllocator::RangeGeometry, 3 * models);
+    m_descriptorAllocator.Reserve(DescriptorAllocator::RangeObjects, static_cast<UINT>(m_sceneLoaded->objects.size()));
+    m_descriptorAllocator.Reserve(DescriptorAllocator::RangeMaterials, static_cast<UINT>(m_sceneLoaded->materialMap.size()));
+    m_descriptorAllocator.Reserve(DescriptorAllocator::RangeTextures,
+        static_cast<UINT>(m_sceneLoaded->diffuseTextureMap.size() + m_sceneLoaded->normalTextureMap.size()));
+    // bottom levels and the top level
+    m_descriptorAllocator.Reserve(DescriptorAllocator::RangeAccelerationStructures, wrappedPointers ? models + 1 : 0);
+
+    EnsureDescriptorHeapCapacity();
+    m_descriptorHeapGrown = false;
+}
+
+// Makes the heaps as large as the allocator. Growing copies the views of the staging heap
+// to the same indices of a larger one and refills the new shader visible heap from it,
+// shader visible heaps can't be a copy source. GPU handles of the old heap are stale after.
+void D3D12RaytracingSimpleLighting::EnsureDescriptorHeapCapacity()
+{
+    UINT capacity = m_descriptorAllocator.GetCapacity();
+    if (m_descriptorStagingHeap && m_descriptorStagingHeap->GetDesc().NumDescriptors >= capacity)
+    {
+        return;
+    }
+    auto device = m_deviceResources->GetD3DDevice();
+
+    D3D12_DESCRIPTOR_HEAP_DESC descriptorHeapDesc = {};
+    descriptorHeapDesc.NumDescriptors = capacity;
+    descriptorHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+    descriptorHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+    descriptorHeapDesc.NodeMask = 0;
+    ComPtr<ID3D12DescriptorHeap> stagingHeap;
+    ThrowIfFailed(device->CreateDescriptorHeap(&descriptorHeapDesc, IID_PPV_ARGS(&stagingHeap)));
+    NAME_D3D12_OBJECT(stagingHeap);
+
+    if (m_descriptorStagingHeap)
+    {
+        UINT written = std::min(m_descriptorStagingHeap->GetDesc().NumDescriptors, m_descriptorAllocator.GetHighWaterMark());
+        if (written > 0)
+        {
+            device->CopyDescriptorsSimple(written, stagingHeap->GetCPUDescriptorHandleForHeapStart(),
+                m_descriptorStagingHeap->GetCPUDescriptorHandleForHeapStart(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+            m_dirtyDescriptorsBegin = 0;
+            m_dirtyDescriptorsEnd = std::max(m_dirtyDescriptorsEnd, written);
+        }
+        m_descriptorHeapGrown = true;
+    }
+    m_descriptorStagingHeap = stagingHeap;
+
+    descriptorHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+    ThrowIfFailed(device->CreateDescriptorHeap(&descriptorHeapDesc, IID_PPV_ARGS(&m_descriptorHeap)));
+    NAME_D3D12_OBJECT(m_descriptorHeap);
+}
+
+// Copies the views written since the last call to the shader visible heap.
+void D3D12RaytracingSimpleLighting::CommitDescriptors()
+{
+    if (m_dirtyDescriptorsBegin >= m_dirtyDescriptorsEnd)
+    {
+        return;
+    }
+    auto device = m_deviceResources->GetD3DDevice();
+    device->CopyDescriptorsSimple(m_dirtyDescriptorsEnd - m_dirtyDescriptorsBegin,
+        CD3DX12_CPU_DESCRIPTOR_HANDLE(m_descriptorHeap->GetCPUDescriptorHandleForHeapStart(), m_dirtyDescriptorsBegin, m_descriptorSize),
+        CD3DX12_CPU_DESCRIPTOR_HANDLE(m_descriptorStagingHeap->GetCPUDescriptorHandleForHeapStart(), m_dirtyDescriptorsBegin, m_descriptorSize),
+        D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    m_dirtyDescriptorsBegin = UINT_MAX;
+    m_dirtyDescriptorsEnd = 0;
+}
+
+// The output table is the only thing that depends on the window size.
+void D3D12RaytracingSimpleLighting::ReleaseOutputDescriptors()
+{
+    if (m_raytracingOutputResourceUAVDescriptorHeapIndex != UINT_MAX)
+    {
+        m_descriptorAllocator.Free(m_raytracingOutputResourceUAVDescriptorHeapIndex);
+        m_raytracingOutputResourceUAVDescriptorHeapIndex = UINT_MAX;
+    }
+}
+
+// Build geometry used in the sample.
+void D3D12RaytracingSimpleLighting::BuildGeometry()
+{
+    auto device = m_deviceResources->GetD3DDevice();
+
+    // Cube indices.
+    Index indices[] =
+    {
+        3,1,0,
+        2,1,3,
+
+        6,4,5,
+        7,4,6,
+
+        11,9,8,
+        10,9,11,
+
+        14,12,13,
+        15,12,14,
+
+        19,17,16,
+        18,17,19,
+
+        22,20,21,
+        23,20,22
+    };
+
+    // Cube vertices positions and corresponding triangle normals.
+    Vertex vertices[] =
+    {
+        { XMFLOAT3(-1.0f, 1.0f, -1.0f), XMFLOAT3(0.0f, 1.0f, 0.0f) },
+        { XMFLOAT3(1.0f, 1.0f, -1.0f), XMFLOAT3(0.0f, 1.0f, 0.0f) },
+        { XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(0.0f, 1.0f, 0.0f) },
+        { XMFLOAT3(-1.0f, 1.0f, 1.0f), XMFLOAT3(0.0f, 1.0f, 0.0f) },
+
+        { XMFLOAT3(-1.0f, -1.0f, -1.0f), XMFLOAT3(0.0f, -1.0f, 0.0f) },
+        { XMFLOAT3(1.0f, -1.0f, -1.0f), XMFLOAT3(0.0f, -1.0f, 0.0f) },
+        { XMFLOAT3(1.0f, -1.0f, 1.0f), XMFLOAT3(0.0f, -1.0f, 0.0f) },
+        { XMFLOAT3(-1.0f, -1.0f, 1.0f), XMFLOAT3(0.0f, -1.0f, 0.0f) },
+
+        { XMFLOAT3(-1.0f, -1.0f, 1.0f), XMFLOAT3(-1.0f, 0.0f, 0.0f) },
+        { XMFLOAT3(-1.0f, -1.0f, -1.0f), XMFLOAT3(-1.0f, 0.0f, 0.0f) },
+        { XMFLOAT3(-1.0f, 1.0f, -1.0f), XMFLOAT3(-1.0f, 0.0f, 0.0f) },
+        { XMFLOAT3(-1.0f, 1.0f, 1.0f), XMFLOAT3(-1.0f, 0.0f, 0.0f) },
+
+        { XMFLOAT3(1.0f, -1.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) },
+        { XMFLOAT3(1.0f, -1.0f, -1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) },
+        { XMFLOAT3(1.0f, 1.0f, -1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) },
+        { XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) },
+
+        { XMFLOAT3(-1.0f, -1.0f, -1.0f), XMFLOAT3(0.0f, 0.0f, -1.0f) },
+        { XMFLOAT3(1.0f, -1.0f, -1.0f), XMFLOAT3(0.0f, 0.0f, -1.0f) },
+        { XMFLOAT3(1.0f, 1.0f, -1.0f), XMFLOAT3(0.0f, 0.0f, -1.0f) },
+        { XMFLOAT3(-1.0f, 1.0f, -1.0f), XMFLOAT3(0.0f, 0.0f, -1.0f) },
+
+        { XMFLOAT3(-1.0f, -1.0f, 1.0f), XMFLOAT3(0.0f, 0.0f, 1.0f) },
+        { XMFLOAT3(1.0f, -1.0f, 1.0f), XMFLOAT3(0.0f, 0.0f, 1.0f) },
+        { XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(0.0f, 0.0f, 1.0f) },
+        { XMFLOAT3(-1.0f, 1.0f, 1.0f), XMFLOAT3(0.0f, 0.0f, 1.0f) },
+    };
+
+   // AllocateUploadBuffer(device, indices, sizeof(indices), &m_indexBufferCube.resource);
+   // AllocateUploadBuffer(device, vertices, sizeof(vertices), &m_vertexBufferCube.resource);
+
+    // Vertex buffer is passed to the shader along with index buffer as a descriptor table.
+    // Vertex buffer descriptor must follow index buffer descriptor in the descriptor heap.
+
+	//UINT descriptorIndexIB = CreateBufferSRV(&m_indexBufferCube, 36 * sizeof(Index) / 4, 0);
+	//UINT descriptorIndexVB = CreateBufferSRV(&m_vertexBufferCube, 6 , sizeof(vertices[0]));
+    //ThrowIfFalse(descriptorIndexVB == descriptorIndexIB + 1, L"Vertex Buffer descriptor index must follow that of Index Buffer descriptor index!");
+    //ThrowIfFalse(descriptorIndexVB == descriptorIndexIB + 1, L"Vertex Buffer descriptor index must follow that of Index Buffer descriptor index!");
+}
+
+// Build acceleration structures needed for raytracing.
+void D3D12RaytracingSimpleLighting::BuildAccelerationStructures()
+{
+    PROFILE_SCOPE("Build acceleration structures");
+    auto device = m_deviceResources->GetD3DDevice();
+    auto commandList = m_deviceResources->GetCommandList();
+    auto commandQueue = m_deviceResources->GetCommandQueue();
+    auto commandAllocator = m_deviceResources->GetCommandAllocator();
+
+    // Reset the command list for the acceleration structure construction.
+    commandList->Reset(commandAllocator, nullptr);
+
+    // What API is used
+    bool is_fallback = m_raytracingAPI == RaytracingAPI::FallbackLayer;
+
+    // Build bottom levels
+    for (auto& model_pair : m_sceneLoaded->modelMap)
+    {
+       //int id = model_pair.first;
+       ModelLoading::Model& model = model_pair.second;
+       model.GetGeomDesc();
+       model.GetBottomLevelBuildDesc();
+       model.GetPreBuild(is_fallback, m_fallbackDevice, m_dxrDevice);
+       model.GetBottomLevelScratchAS(is_fallback, device, m_fallbackDevice,m_dxrDevice);
+       model.GetBottomAS(is_fallback, device, m_fallbackDevice,m_dxrDevice);
+
+       //m_sceneLoaded->modelMap[id] = model;
+    }
+
+    // Build top level
+    m_sceneLoaded->GetTopLevelDesc();
+    m_sceneLoaded->GetTopLevelPrebuildInfo(is_fallback, m_fallbackDevice, m_dxrDevice);
+    m_sceneLoaded->GetTopLevelScratchAS(is_fallback, device, m_fallbackDevice, m_dxrDevice);
+    m_sceneLoaded->GetTopAS(is_fallback, device, m_fallbackDevice, m_dxrDevice);
+    m_sceneLoaded->GetInstanceDescriptors(is_fallback, m_fallbackDevice, m_dxrDevice);
+
+    // Finalize the allocation
+    m_fallbackTopLevelAccelerationStructurePointer = m_sceneLoaded->GetWrappedGPUPointer(is_fallback, m_fallbackDevice, m_dxrDevice);
+    m_sceneLoaded->FinalizeAS();
+
+    // Actually build the AS (executing command lists)
+    m_sceneLoaded->BuildAllAS(is_fallback, m_fallbackDevice, m_dxrDevice, m_fallbackCommandList, m_dxrCommandList);
+    scene_stats_valid = false;
+}
+
+// Builds the bottom levels of the models again after their buffers were replaced, and the
+// top level over them. The top level keeps its size, buffers and wrapped pointer, only
+// its instances point at the new bottom levels.
+void D3D12RaytracingSimpleLighting::RebuildBottomLevels(const std::vector<int>& modelIds)
+{
+    PROFILE_SCOPE("Rebuild bottom levels");
+    auto device = m_deviceResources->GetD3DDevice();
+    auto commandList = m_deviceResources->GetCommandList();
+    auto commandAllocator = m_deviceResources->GetCommandAllocator();
+
+    commandList->Reset(commandAllocator, nullptr);
+
+    bool is_fallback = m_raytracingAPI == RaytracingAPI::FallbackLayer;
+    bool wrappedPointers = is_fallback && !m_fallbackDevice->UsingRaytracingDriver();
+
+    for (int id : modelIds)
+    {
+       ModelLoading::Model& model = m_sceneLoaded->modelMap[id];
+       //the new bottom level gets a wrapped pointer of its own, the reservation only covers one per model
+       if (wrappedPointers && model.is_gpu_ptr_allocated)
+       {
+         m_descriptorAllocator.Free(model.gpuPtr.EmulatedGpuPtr.DescriptorHeapIndex);
+       }
+       //sized for the new geometry
+       model.is_gpu_ptr_allocated = false;
+       model.is_m_bottomLevelAccelerationStructure_allocated = false;
+       model.is_scratchResource_allocated = false;
+       model.bottom_level_build_desc_allocated = false;
+       model.bottom_level_prebuild_info_allocated = false;
+       model.m_bottomLevelAccelerationStructure.Reset();
+       model.scratchResource.Reset();
+
+       model.GetGeomDesc();
+       model.GetBottomLevelBuildDesc();
+       model.GetPreBuild(is_fallback, m_fallbackDevice, m_dxrDevice);
+       model.GetBottomLevelScratchAS(is_fallback, device, m_fallbackDevice, m_dxrDevice);
+       model.GetBottomAS(is_fallback, device, m_fallbackDevice, m_dxrDevice);
+    }
+
+    m_sceneLoaded->GetInstanceDescriptors(is_fallback, m_fallbackDevice, m_dxrDevice);
+    m_sceneLoaded->FinalizeAS();
+
+    m_sceneLoaded->BuildAllAS(is_fallback, m_fallbackDevice, m_dxrDevice, m_fallbackCommandList, m_dxrCommandList, &modelIds);
+    scene_stats_valid = false;
+}
+
+// Build shader tables.
+// This encapsulates all shader records - shaders and the arguments for their local root signatures.
+void D3D12RaytracingSimpleLighting::BuildShaderTables()
+{
+    auto device = m_deviceResources->GetD3DDevice();
+
+    void* rayGenShaderIdentifier;
+    void* missShaderIdentifier;
+    void* hitGroupShaderIdentifier;
+
+    auto GetShaderIdentifiers = [&](auto* stateObjectProperties)
+    {
+        rayGenShaderIdentifier = stateObjectProperties->GetShaderIdentifier(c_raygenShaderName);
+        missShaderIdentifier = stateObjectProperties->GetShaderIdentifier(c_missShaderName);
+        hitGroupShaderIdentifier = stateObjectProperties->GetShaderIdentifier(c_hitGroupName);
+    };
+
+    // Get shader identifiers.
+    UINT shaderIdentifierSize;
+    if (m_raytracingAPI == RaytracingAPI::FallbackLayer)
+    {
+        GetShaderIdentifiers(m_fallbackStateObject.Get());
+        shaderIdentifierSize = m_fallbackDevice->GetShaderIdentifierSize();
+    }
+    else // DirectX Raytracing
+    {
+        ComPtr<ID3D12StateObjectPropertiesPrototype> stateObjectProperties;
+        ThrowIfFailed(m_dxrStateObject.As(&stateObjectProperties));
+        GetShaderIdentifiers(stateObjectProperties.Get());
+        shaderIdentifierSize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES;
     }
 
     // Ray gen shader table
@@ -734,6 +1722,7 @@ void D3D12RaytracingSimpleLighting::OnUpdate()
   m_timer.Tick();
   CalculateFrameStats();
   float elapsedTime = static_cast<float>(m_timer.GetElapsedSeconds());
+  UpdateRussianRouletteBenchmark(m_timer.GetElapsedSeconds());
   auto frameIndex = m_deviceResources->GetCurrentFrameIndex();
   auto prevFrameIndex = m_deviceResources->GetPreviousFrameIndex();
 
@@ -747,10 +1736,6 @@ void D3D12RaytracingSimpleLighting::OnUpdate()
     const XMVECTOR& prevLightPosition = m_sceneCB[prevFrameIndex].lightPosition;
     m_sceneCB[frameIndex].lightPosition = XMVector3Transform(prevLightPosition, rotate);
   }
-
-  {
-    m_sceneCB[frameIndex].iteration += 1;
-  }
 }
 
 
@@ -775,10 +1760,63 @@ void D3D12RaytracingSimpleLighting::ParseCommandLineArgs(WCHAR* argv[], int argc
 
 void D3D12RaytracingSimpleLighting::DoRaytracing()
 {
+    PROFILE_SCOPE("Record rays");
     auto commandList = m_deviceResources->GetCommandList();
     auto frameIndex = m_deviceResources->GetCurrentFrameIndex();
+
+    if (tiled_render_job.IsActive())
+    {
+      UpdateTiledRender();
+    }
+    const bool tiled = tiled_render_job.IsActive();
+    if (sequence_capture.IsActive())
+    {
+      UpdateSequenceCapture();
+    }
     
-    auto DispatchRays = [&](auto* commandList, auto* stateObject, auto* dispatchDesc)
+    // Full screen, or one ADAPTIVE_TILE_SIZE block of rows per active tile.
+    // Once every tile converged there is nothing left to dispatch.
+    // The adaptive tile list is laid out for the window, not for a tile of the target.
+    const bool adaptive = !tiled && (m_sceneCB[frameIndex].features & AdaptiveSampling) != 0;
+    const UINT tileBufferSize = adaptive_sampler.GetTileCount() * sizeof(UINT);
+    const auto activeTilesGpuAddress = adaptive_active_tiles->GetGPUVirtualAddress() + frameIndex * tileBufferSize;
+    UINT dispatchWidth = m_width;
+    UINT dispatchHeight = m_height;
+    if (adaptive)
+    {
+      UpdateAdaptiveSampling();
+      const UINT activeTileCount = static_cast<UINT>(adaptive_sampler.GetActiveTiles().size());
+      dispatchWidth = ADAPTIVE_TILE_SIZE;
+      dispatchHeight = ADAPTIVE_TILE_SIZE * activeTileCount;
+    }
+    else if (tiled)
+    {
+      // Nothing to dispatch while the last tile is still being read back.
+      dispatchWidth = tiled_render_tile_active ? tiled_render_tile.width : 0;
+      dispatchHeight = tiled_render_tile_active ? tiled_render_tile.height : 0;
+    }
+    const bool dispatch = enable_rendering && dispatchHeight > 0;
+
+    UpdatePathStatistics();
+    if (dispatch)
+    {
+      D3D12_RESOURCE_BARRIER preClearBarrier = CD3DX12_RESOURCE_BARRIER::Transition(path_stats.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_DEST);
+      commandList->ResourceBarrier(1, &preClearBarrier);
+      commandList->CopyBufferRegion(path_stats.Get(), 0, path_stats_zero.Get(), 0, c_pathStatsSize);
+      D3D12_RESOURCE_BARRIER postClearBarrier = CD3DX12_RESOURCE_BARRIER::Transition(path_stats.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+      commandList->ResourceBarrier(1, &postClearBarrier);
+    }
+
+    if (adaptive && dispatch)
+    {
+      D3D12_RESOURCE_BARRIER preClearBarrier = CD3DX12_RESOURCE_BARRIER::Transition(adaptive_tile_errors.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_DEST);
+      commandList->ResourceBarrier(1, &preClearBarrier);
+      commandList->CopyBufferRegion(adaptive_tile_errors.Get(), 0, adaptive_tile_errors_zero.Get(), 0, tileBufferSize);
+      D3D12_RESOURCE_BARRIER postClearBarrier = CD3DX12_RESOURCE_BARRIER::Transition(adaptive_tile_errors.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+      commandList->ResourceBarrier(1, &postClearBarrier);
+    }
+
+    auto DispatchRays = [&](auto* commandList, auto* stateObject, auto* dispatchDesc, UINT width, UINT height)
     {
         // Since each shader table has only one shader record, the stride is same as the size.
         dispatchDesc->HitGroupTable.StartAddress = m_hitGroupShaderTable->GetGPUVirtualAddress();
@@ -789,8 +1827,8 @@ void D3D12RaytracingSimpleLighting::DoRaytracing()
         dispatchDesc->MissShaderTable.StrideInBytes = dispatchDesc->MissShaderTable.SizeInBytes;
         dispatchDesc->RayGenerationShaderRecord.StartAddress = m_rayGenShaderTable->GetGPUVirtualAddress();
         dispatchDesc->RayGenerationShaderRecord.SizeInBytes = m_rayGenShaderTable->GetDesc().Width;
-        dispatchDesc->Width = m_width;
-        dispatchDesc->Height = m_height;
+        dispatchDesc->Width = width;
+        dispatchDesc->Height = height;
         dispatchDesc->Depth = 1;
         commandList->SetPipelineState1(stateObject);
         commandList->DispatchRays(dispatchDesc);
@@ -804,44 +1842,225 @@ void D3D12RaytracingSimpleLighting::DoRaytracing()
       ModelLoading::Texture& normal_texture = m_sceneLoaded->normalTextureMap[0];
       ModelLoading::MaterialResource& material = m_sceneLoaded->materialMap[0];
       ModelLoading::Model& model = m_sceneLoaded->modelMap[0];
+      CommitDescriptors();
       descriptorSetCommandList->SetDescriptorHeaps(1, m_descriptorHeap.GetAddressOf());
       // Set index and successive vertex buffer decriptor tables
-      commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParams::VertexBuffersSlot, model.vertices.gpuDescriptorHandle);
+      commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParams::VertexBuffersSlot, model.positions.gpuDescriptorHandle);
+      commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParams::VertexAttributesSlot, model.attributes.gpuDescriptorHandle);
       commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParams::IndexBuffersSlot, model.indices.gpuDescriptorHandle);
       commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParams::InfoBuffersSlot, objectInScene.info_resource.d3d12_resource.gpuDescriptorHandle);
       commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParams::OutputViewSlot, m_raytracingOutputResourceUAVGpuDescriptor);
       commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParams::TextureSlot, diffuse_texture.texBuffer.gpuDescriptorHandle);
       commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParams::NormalTextureSlot, normal_texture.texBuffer.gpuDescriptorHandle);
       commandList->SetComputeRootDescriptorTable(GlobalRootSignatureParams::MaterialBuffersSlot, material.d3d12_material_resource.gpuDescriptorHandle);
+      commandList->SetComputeRootShaderResourceView(GlobalRootSignatureParams::ActiveTilesSlot, activeTilesGpuAddress);
+      commandList->SetComputeRootUnorderedAccessView(GlobalRootSignatureParams::TileErrorsSlot, adaptive_tile_errors->GetGPUVirtualAddress());
+      commandList->SetComputeRootShaderResourceView(GlobalRootSignatureParams::LightsSlot, light_list_resource->GetGPUVirtualAddress());
+      commandList->SetComputeRootUnorderedAccessView(GlobalRootSignatureParams::PathStatsSlot, path_stats->GetGPUVirtualAddress());
     };
 
     commandList->SetComputeRootSignature(m_raytracingGlobalRootSignature.Get());
 
     // Copy the updated scene constant buffer to GPU.
+    m_sceneCB[frameIndex].iteration = accumulation_dispatches + 1;
+    m_sceneCB[frameIndex].accumulation_format = accumulation_format;
     memcpy(&m_mappedConstantData[frameIndex].constants, &m_sceneCB[frameIndex], sizeof(m_sceneCB[frameIndex]));
+    if (!adaptive)
+    {
+      m_mappedConstantData[frameIndex].constants.features &= ~AdaptiveSampling;
+    }
     auto cbGpuAddress = m_perFrameConstants->GetGPUVirtualAddress() + frameIndex * sizeof(m_mappedConstantData[0]);
     commandList->SetComputeRootConstantBufferView(GlobalRootSignatureParams::SceneConstantSlot, cbGpuAddress);
    
     // Bind the heaps, acceleration structure and dispatch rays.
     D3D12_DISPATCH_RAYS_DESC dispatchDesc = {};
+    GpuProfiler::Scope dispatchScope(gpu_profiler, commandList, "Dispatch rays");
     if (m_raytracingAPI == RaytracingAPI::FallbackLayer)
     {
         SetCommonPipelineState(m_fallbackCommandList.Get());
         m_fallbackCommandList->SetTopLevelAccelerationStructure(GlobalRootSignatureParams::AccelerationStructureSlot, m_fallbackTopLevelAccelerationStructurePointer);
-        if(enable_rendering)
+        if(dispatch)
         {
-          DispatchRays(m_fallbackCommandList.Get(), m_fallbackStateObject.Get(), &dispatchDesc);
+          DispatchRays(m_fallbackCommandList.Get(), m_fallbackStateObject.Get(), &dispatchDesc, dispatchWidth, dispatchHeight);
         }
     }
     else // DirectX Raytracing
     {
         SetCommonPipelineState(commandList);
         commandList->SetComputeRootShaderResourceView(GlobalRootSignatureParams::AccelerationStructureSlot, m_topLevelAccelerationStructure->GetGPUVirtualAddress());
-        if (enable_rendering)
+        if (dispatch)
         {
-          DispatchRays(m_dxrCommandList.Get(), m_dxrStateObject.Get(), &dispatchDesc);
+          DispatchRays(m_dxrCommandList.Get(), m_dxrStateObject.Get(), &dispatchDesc, dispatchWidth, dispatchHeight);
         }
     }
+
+    if (dispatch)
+    {
+      accumulation_dispatches++;
+    }
+
+    // Read the tile errors back, picked up once this frame index comes around again.
+    if (adaptive && dispatch)
+    {
+      D3D12_RESOURCE_BARRIER preCopyBarrier = CD3DX12_RESOURCE_BARRIER::Transition(adaptive_tile_errors.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
+      commandList->ResourceBarrier(1, &preCopyBarrier);
+      commandList->CopyBufferRegion(adaptive_tile_errors_readback.Get(), frameIndex * tileBufferSize, adaptive_tile_errors.Get(), 0, tileBufferSize);
+      D3D12_RESOURCE_BARRIER postCopyBarrier = CD3DX12_RESOURCE_BARRIER::Transition(adaptive_tile_errors.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+      commandList->ResourceBarrier(1, &postCopyBarrier);
+
+      adaptive_readback_pending[frameIndex] = true;
+      adaptive_readback_epoch[frameIndex] = adaptive_epoch;
+    }
+
+    if (dispatch)
+    {
+      D3D12_RESOURCE_BARRIER preCopyBarrier = CD3DX12_RESOURCE_BARRIER::Transition(path_stats.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
+      commandList->ResourceBarrier(1, &preCopyBarrier);
+      commandList->CopyBufferRegion(path_stats_readback.Get(), frameIndex * c_pathStatsSize, path_stats.Get(), 0, c_pathStatsSize);
+      D3D12_RESOURCE_BARRIER postCopyBarrier = CD3DX12_RESOURCE_BARRIER::Transition(path_stats.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+      commandList->ResourceBarrier(1, &postCopyBarrier);
+
+      path_stats_pending[frameIndex] = true;
+      path_stats_benchmark_phase[frameIndex] = rr_benchmark_phase;
+    }
+
+    // Tiles are read back raw, the denoiser only runs on the window.
+    if (dispatch && enable_denoiser && !tiled)
+    {
+      Denoise();
+    }
+
+    if (tiled && dispatch)
+    {
+      tiled_render_tile_samples += m_sceneCB[frameIndex].samples_per_launch;
+      if (tiled_render_tile_samples >= tiled_render_job.GetSettings().samples_per_pixel)
+      {
+        ReadBackTiledRenderTile();
+      }
+    }
+
+    // A frame that just moved the camera accumulated into the old image, it is cleared
+    // at the end of this frame. Adaptive sampling stops dispatching once every tile
+    // converged, that counts as done too. A tiled render dispatches nothing while its
+    // last tile is read back, which is not.
+    const bool adaptiveConverged = adaptive && enable_rendering && dispatchHeight == 0;
+    if (sequence_capture.IsRendering() && !m_camChanged && (dispatch || adaptiveConverged))
+    {
+      capture_frame_samples += dispatch ? m_sceneCB[frameIndex].samples_per_launch : 0;
+      if (adaptiveConverged || capture_frame_samples >= sequence_capture.GetSettings().samples_per_frame)
+      {
+        ReadBackSequenceFrame();
+      }
+    }
+}
+
+// Compute pipeline of Denoise.hlsl: its constants plus the output table, which also
+// holds the guides and the filter buffers.
+void D3D12RaytracingSimpleLighting::CreateDenoiserPipeline()
+{
+    auto device = m_deviceResources->GetD3DDevice();
+
+    CD3DX12_DESCRIPTOR_RANGE range;
+    range.Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 9, 0);  // output, accumulation, second moment, albedo and depth, normal, features, 2 filter buffers, compensation
+
+    CD3DX12_ROOT_PARAMETER rootParameters[DenoiseRootSignatureParams::Count];
+    rootParameters[DenoiseRootSignatureParams::ConstantsSlot].InitAsConstants(SizeOfInUint32(Denoiser::DenoiseConstantBuffer), 0);
+    rootParameters[DenoiseRootSignatureParams::ViewsSlot].InitAsDescriptorTable(1, &range);
+
+    CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc(ARRAYSIZE(rootParameters), rootParameters);
+    ComPtr<ID3DBlob> blob;
+    ComPtr<ID3DBlob> error;
+    ThrowIfFailed(D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &blob, &error), error ? static_cast<wchar_t*>(error->GetBufferPointer()) : nullptr);
+    ThrowIfFailed(device->CreateRootSignature(1, blob->GetBufferPointer(), blob->GetBufferSize(), IID_PPV_ARGS(&denoiser_root_signature)));
+    NAME_D3D12_OBJECT(denoiser_root_signature);
+
+    D3D12_COMPUTE_PIPELINE_STATE_DESC pipelineDesc = {};
+    pipelineDesc.pRootSignature = denoiser_root_signature.Get();
+    pipelineDesc.CS = CD3DX12_SHADER_BYTECODE(g_pDenoise, ARRAYSIZE(g_pDenoise));
+    ThrowIfFailed(device->CreateComputePipelineState(&pipelineDesc, IID_PPV_ARGS(&denoiser_pipeline)));
+    NAME_D3D12_OBJECT(denoiser_pipeline);
+}
+
+// Filters the accumulated image into the output, after the rays of this frame.
+void D3D12RaytracingSimpleLighting::Denoise()
+{
+    auto commandList = m_deviceResources->GetCommandList();
+    GpuProfiler::Scope gpuScope(gpu_profiler, commandList, "Denoise");
+
+    commandList->SetComputeRootSignature(denoiser_root_signature.Get());
+    commandList->SetPipelineState(denoiser_pipeline.Get());
+    CommitDescriptors();
+    commandList->SetDescriptorHeaps(1, m_descriptorHeap.GetAddressOf());
+    commandList->SetComputeRootDescriptorTable(DenoiseRootSignatureParams::ViewsSlot, m_raytracingOutputResourceUAVGpuDescriptor);
+
+    Denoiser::DenoiseConstantBuffer constants = {};
+    constants.width = m_width;
+    constants.height = m_height;
+    constants.sigma_luminance = denoiser_sigma_luminance;
+    constants.sigma_normal = Denoiser::DENOISE_DEFAULT_SIGMA_NORMAL;
+    constants.sigma_depth = Denoiser::DENOISE_DEFAULT_SIGMA_DEPTH;
+    constants.accumulation_format = accumulation_format;
+    const UINT groupsX = (m_width + Denoiser::DENOISE_THREAD_GROUP_SIZE - 1) / Denoiser::DENOISE_THREAD_GROUP_SIZE;
+    const UINT groupsY = (m_height + Denoiser::DENOISE_THREAD_GROUP_SIZE - 1) / Denoiser::DENOISE_THREAD_GROUP_SIZE;
+
+    // every pass reads what the one before wrote
+    auto DispatchPass = [&]()
+    {
+      D3D12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::UAV(nullptr);
+      commandList->ResourceBarrier(1, &barrier);
+      commandList->SetComputeRoot32BitConstants(DenoiseRootSignatureParams::ConstantsSlot, SizeOfInUint32(constants), &constants, 0);
+      commandList->Dispatch(groupsX, groupsY, 1);
+    };
+
+    constants.pass = Denoiser::DenoisePassPrepare;
+    DispatchPass();
+    constants.pass = Denoiser::DenoisePassVariance;
+    DispatchPass();
+
+    const UINT iterations = std::max(1u, std::min(denoiser_iterations, Denoiser::DENOISE_MAX_ITERATIONS));
+    constants.pass = Denoiser::DenoisePassAtrous;
+    for (UINT i = 0; i < iterations; i++)
+    {
+      constants.step = 1u << i;
+      constants.source = (i & 1) ^ 1;
+      constants.last = i + 1 == iterations;
+      DispatchPass();
+    }
+
+    D3D12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::UAV(nullptr);
+    commandList->ResourceBarrier(1, &barrier);
+}
+
+// The accumulation as Float32 sums with the sample count in w, what the readbacks copy.
+// Half and Packed are converted into the first filter buffer of the denoiser, which is
+// free again once the denoiser wrote the output.
+ID3D12Resource* D3D12RaytracingSimpleLighting::ResolveAccumulation()
+{
+    if (accumulation_format == Accumulation::AccumulationFloat32)
+    {
+      return pathtracing_accumulation_resource.Get();
+    }
+
+    auto commandList = m_deviceResources->GetCommandList();
+    commandList->SetComputeRootSignature(denoiser_root_signature.Get());
+    commandList->SetPipelineState(denoiser_pipeline.Get());
+    CommitDescriptors();
+    commandList->SetDescriptorHeaps(1, m_descriptorHeap.GetAddressOf());
+    commandList->SetComputeRootDescriptorTable(DenoiseRootSignatureParams::ViewsSlot, m_raytracingOutputResourceUAVGpuDescriptor);
+
+    Denoiser::DenoiseConstantBuffer constants = {};
+    constants.width = m_width;
+    constants.height = m_height;
+    constants.pass = Denoiser::DenoisePassResolve;
+    constants.accumulation_format = accumulation_format;
+    commandList->SetComputeRoot32BitConstants(DenoiseRootSignatureParams::ConstantsSlot, SizeOfInUint32(constants), &constants, 0);
+
+    D3D12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::UAV(nullptr);
+    commandList->ResourceBarrier(1, &barrier);
+    commandList->Dispatch((m_width + Denoiser::DENOISE_THREAD_GROUP_SIZE - 1) / Denoiser::DENOISE_THREAD_GROUP_SIZE,
+                          (m_height + Denoiser::DENOISE_THREAD_GROUP_SIZE - 1) / Denoiser::DENOISE_THREAD_GROUP_SIZE, 1);
+    commandList->ResourceBarrier(1, &barrier);
+    return denoiser_filter_buffers[0].Get();
 }
 
 // Update the application state with the new resolution.
@@ -856,6 +2075,7 @@ void D3D12RaytracingSimpleLighting::CopyRaytracingOutputToBackbuffer()
     auto commandList = m_deviceResources->GetCommandList();
     auto renderTarget = m_deviceResources->GetRenderTarget();
     
+    GpuProfiler::Scope copyScope(gpu_profiler, commandList, "Copy to back buffer");
     D3D12_RESOURCE_BARRIER preCopyBarriers[2];
     preCopyBarriers[0] = CD3DX12_RESOURCE_BARRIER::Transition(renderTarget, D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_COPY_DEST);
     preCopyBarriers[1] = CD3DX12_RESOURCE_BARRIER::Transition(m_raytracingOutput.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
@@ -872,19 +2092,9 @@ void D3D12RaytracingSimpleLighting::CopyRaytracingOutputToBackbuffer()
     LoadSplitImage();
     PreSaveImage();
 
-    //Render IMGUI to screen
+    //Render IMGUI to screen, recorded into the same command list as the frame
+    //so the back buffer is only transitioned to present once in Present()
     RenderImGUI();
-
-    m_deviceResources->ExecuteCommandList();
-
-    m_deviceResources->WaitForGpu();
-
-    commandList->Reset(m_deviceResources->GetCommandAllocator(), nullptr);
-
-    D3D12_RESOURCE_BARRIER ImGUIBarriers[1];
-    ImGUIBarriers[0] = CD3DX12_RESOURCE_BARRIER::Transition(renderTarget, D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
-
-    commandList->ResourceBarrier(ARRAYSIZE(ImGUIBarriers), ImGUIBarriers);
 }
 
 // Create resources that are dependent on the size of the main window.
@@ -898,23 +2108,44 @@ void D3D12RaytracingSimpleLighting::CreateWindowSizeDependentResources()
 void D3D12RaytracingSimpleLighting::ReleaseWindowSizeDependentResources()
 {
     m_raytracingOutput.Reset();
+    pathtracing_accumulation_resource.Reset();
+    pathtracing_second_moment_resource.Reset();
+    pathtracing_compensation_resource.Reset();
+    denoiser_albedo_depth.Reset();
+    denoiser_normal.Reset();
+    denoiser_features.Reset();
+    denoiser_filter_buffers[0].Reset();
+    denoiser_filter_buffers[1].Reset();
+    adaptive_tile_errors.Reset();
+    adaptive_tile_errors_zero.Reset();
+    adaptive_tile_errors_readback.Reset();
+    adaptive_active_tiles.Reset();
+    adaptive_mapped_active_tiles = nullptr;
+    ReleaseOutputDescriptors();
+
+    //tiles are sized for the old window, the job can be resumed at the new size
+    StopTiledRender();
 }
 
 // Release all resources that depend on the device.
 void D3D12RaytracingSimpleLighting::ReleaseDeviceDependentResources()
 {
+    gpu_profiler.ReleaseDevice();
     m_fallbackDevice.Reset();
     m_fallbackCommandList.Reset();
     m_fallbackStateObject.Reset();
     m_raytracingGlobalRootSignature.Reset();
     m_raytracingLocalRootSignature.Reset();
+    denoiser_root_signature.Reset();
+    denoiser_pipeline.Reset();
 
     m_dxrDevice.Reset();
     m_dxrCommandList.Reset();
     m_dxrStateObject.Reset();
 
     m_descriptorHeap.Reset();
-    m_descriptorsAllocated = 0;
+    m_descriptorStagingHeap.Reset();
+    m_descriptorAllocator.Reset();
     m_raytracingOutputResourceUAVDescriptorHeapIndex = UINT_MAX;
     m_indexBuffer.resource.Reset();
     m_vertexBuffer.resource.Reset();
@@ -924,6 +2155,10 @@ void D3D12RaytracingSimpleLighting::ReleaseDeviceDependentResources()
     m_rayGenShaderTable.Reset();
     m_missShaderTable.Reset();
     m_hitGroupShaderTable.Reset();
+    light_list_resource.Reset();
+    path_stats.Reset();
+    path_stats_zero.Reset();
+    path_stats_readback.Reset();
 
     m_bottomLevelAccelerationStructure.Reset();
     m_topLevelAccelerationStructure.Reset();
@@ -953,21 +2188,59 @@ void D3D12RaytracingSimpleLighting::OnRender()
         return;
     }
 
-    auto device = m_deviceResources->GetD3DDevice();
+    PROFILE_SCOPE("Frame");
+    CollectProfilerEvents();
     auto commandList = m_deviceResources->GetCommandList();
 
     //Draw ImGUI
-    StartFrameImGUI();
+    {
+        PROFILE_SCOPE("ImGui");
+        StartFrameImGUI();
+    }
+
+    PollHotReload();
 
     //if rebuild scene
     if (rebuild_scene)
     {
       m_deviceResources->WaitForGpu();
-      RebuildScene();
-      rebuild_scene = false;
+      RebuildScene();
+      rebuild_scene = false;
+    }
+    else if (light_list_dirty)
+    {
+      //an object or material was edited, the GPU may still be reading the old list
+      m_deviceResources->WaitForGpu();
+      UpdateLightList();
+    }
+    light_list_dirty = false;
+    UpdateShaderPermutation();
+
+    //the trees of the fallback layer's acceleration structures for the scene statistics
+    if (bvh_analysis_requested)
+    {
+      m_deviceResources->WaitForGpu();
+      if (!scene_stats_valid)
+      {
+        scene_stats = m_sceneLoaded->BuildStats(true);
+        scene_stats_valid = true;
+      }
+      const std::vector<std::string> errors = m_sceneLoaded->AnalyzeFallbackBvh(scene_stats);
+      scene_stats_status = errors.empty() ? std::string("Read back the acceleration structures") : errors.front();
+      bvh_analysis_requested = false;
+    }
+
+    //another accumulation format needs new buffers, and starts over
+    if (accumulation_format_requested != accumulation_format)
+    {
+      m_deviceResources->WaitForGpu();
+      ReleaseWindowSizeDependentResources();
+      CreateWindowSizeDependentResources();
+      m_camChanged = true;
     }
 
     m_deviceResources->Prepare();
+    gpu_profiler.BeginFrame(m_deviceResources->GetCurrentFrameIndex());
 
     commandList->RSSetViewports(1, &m_deviceResources->GetScreenViewport());
     commandList->RSSetScissorRects(1, &m_deviceResources->GetScissorRect());
@@ -979,42 +2252,38 @@ void D3D12RaytracingSimpleLighting::OnRender()
 
     if (m_camChanged)
     {
-      //reset iterations
-      for (int i = 0; i < FrameCount; i++)
-      {
-        m_sceneCB[i].iteration = 1;
-      }
-
-      static bool give_epilepsy = true;
-      if (give_epilepsy)
-      {
-        auto uavDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R32G32B32A32_FLOAT, m_width, m_height, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
-        
-        auto defaultHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-        ThrowIfFailed(device->CreateCommittedResource(
-            &defaultHeapProperties, D3D12_HEAP_FLAG_NONE, &uavDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr, IID_PPV_ARGS(&cure_epilepsy)));
-        NAME_D3D12_OBJECT(cure_epilepsy);
-        give_epilepsy = false;
-      }
-
-      D3D12_RESOURCE_BARRIER preCopyBarriers[2];
-      preCopyBarriers[0] = CD3DX12_RESOURCE_BARRIER::Transition(pathtracing_accumulation_resource.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_DEST);
-      preCopyBarriers[1] = CD3DX12_RESOURCE_BARRIER::Transition(cure_epilepsy.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
-      commandList->ResourceBarrier(ARRAYSIZE(preCopyBarriers), preCopyBarriers);
-
-      commandList->CopyResource(pathtracing_accumulation_resource.Get(), cure_epilepsy.Get());
+      //the next dispatch starts the accumulation, the guides and the moments over
+      accumulation_dispatches = 0;
+      m_camChanged = false;
 
-      D3D12_RESOURCE_BARRIER postCopyBarriers[2];
-      postCopyBarriers[0] = CD3DX12_RESOURCE_BARRIER::Transition(pathtracing_accumulation_resource.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-      postCopyBarriers[1] = CD3DX12_RESOURCE_BARRIER::Transition(cure_epilepsy.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+      //every tile needs samples again, readbacks still in flight measured the old image
+      adaptive_sampler.Reset();
+      adaptive_epoch++;
+      tiled_render_tile_samples = 0;
+      capture_frame_samples = 0;
+    }
 
-      commandList->ResourceBarrier(ARRAYSIZE(postCopyBarriers), postCopyBarriers);
-      m_camChanged = false;
+    gpu_profiler.EndFrame(commandList);
+    {
+        PROFILE_SCOPE("Present");
+        m_deviceResources->Present(D3D12_RESOURCE_STATE_RENDER_TARGET);
+    }
 
-      m_deviceResources->WaitForGpu();
+    //copies recorded this frame complete with its fence
+    if (sequence_capture.IsActive())
+    {
+      sequence_capture.TagRecorded(m_deviceResources->GetLastSignaledFenceValue());
     }
 
-    m_deviceResources->Present(D3D12_RESOURCE_STATE_PRESENT);
+    //tag the readback with the fence of the frame that recorded it
+    if (save_image_pending && save_image_fence_value == 0)
+    {
+      save_image_fence_value = m_deviceResources->GetLastSignaledFenceValue();
+    }
+    if (tiled_render_readback_pending && tiled_render_readback_fence_value == 0)
+    {
+      tiled_render_readback_fence_value = m_deviceResources->GetLastSignaledFenceValue();
+    }
 }
 
 void D3D12RaytracingSimpleLighting::OnDestroy()
@@ -1055,7 +2324,16 @@ void D3D12RaytracingSimpleLighting::CalculateFrameStats()
         frameCnt = 0;
         elapsedTime = totalTime;
 
-        float MRaysPerSecond = (m_width * m_height * fps) / static_cast<float>(1e6);
+        // every ray the counters saw, shadow rays only while RayStatistics counts them
+        std::copy(std::begin(path_stats_counters), std::end(path_stats_counters), std::begin(ray_stats));
+        std::fill(std::begin(path_stats_counters), std::end(path_stats_counters), 0);
+        ray_stats_seconds = diff;
+        const UINT64 paths = ray_stats[RayStats::RayStatPaths];
+        const UINT64 segments = ray_stats[RayStats::RayStatSegments];
+        float MRaysPerSecond = static_cast<float>((segments + ray_stats[RayStats::RayStatShadowRays]) / (diff * 1e6));
+
+        frame_time_ms = 1000.0f / fps;
+        average_path_length = paths > 0 ? static_cast<float>(static_cast<double>(segments) / paths) : 0.0f;
 
         wstringstream windowText;
 
@@ -1075,7 +2353,8 @@ void D3D12RaytracingSimpleLighting::CalculateFrameStats()
             windowText << L"(DXR)";
         }
         windowText << setprecision(2) << fixed
-            << L"    fps: " << fps << L"     ~Million Primary Rays/s: " << MRaysPerSecond
+            << L"    fps: " << fps << L"     Million Rays/s: " << MRaysPerSecond
+            << L"    avg path length: " << average_path_length
             << L"    GPU[" << m_deviceResources->GetAdapterID() << L"]: " << m_deviceResources->GetAdapterDescription();
         SetCustomWindowText(windowText.str().c_str());
     }
@@ -1112,27 +2391,40 @@ WRAPPED_GPU_POINTER D3D12RaytracingSimpleLighting::CreateFallbackWrappedPointer(
     UINT descriptorHeapIndex = 0;
     if (!m_fallbackDevice->UsingRaytracingDriver())
     {
-        descriptorHeapIndex = AllocateDescriptor(&bottomLevelDescriptor);
+        descriptorHeapIndex = AllocateDescriptor(&bottomLevelDescriptor, DescriptorAllocator::RangeAccelerationStructures);
         device->CreateUnorderedAccessView(resource, nullptr, &rawBufferUavDesc, bottomLevelDescriptor);
     }
     return m_fallbackDevice->GetWrappedPointerSimple(descriptorHeapIndex, resource->GetGPUVirtualAddress());
 }
 
-// Allocate a descriptor and return its index. 
-// If the passed descriptorIndexToUse is valid, it will be used instead of allocating a new one.
-UINT D3D12RaytracingSimpleLighting::AllocateDescriptor(D3D12_CPU_DESCRIPTOR_HANDLE* cpuDescriptor, UINT descriptorIndexToUse)
+// Allocate count contiguous descriptors of range and return the index of the first one.
+// cpuDescriptor is where to write the first view, the others go through GetDescriptorForWriting.
+// The heaps grow if the allocator had to.
+UINT D3D12RaytracingSimpleLighting::AllocateDescriptor(D3D12_CPU_DESCRIPTOR_HANDLE* cpuDescriptor, DescriptorAllocator::Range range, UINT count)
 {
-    auto descriptorHeapCpuBase = m_descriptorHeap->GetCPUDescriptorHandleForHeapStart();
-    if (descriptorIndexToUse >= m_descriptorHeap->GetDesc().NumDescriptors)
-    {
-        descriptorIndexToUse = m_descriptorsAllocated++;
-    }
-    *cpuDescriptor = CD3DX12_CPU_DESCRIPTOR_HANDLE(descriptorHeapCpuBase, descriptorIndexToUse, m_descriptorSize);
-    return descriptorIndexToUse;
+    UINT descriptorIndex = m_descriptorAllocator.Allocate(range, count);
+    ThrowIfFalse(descriptorIndex != DescriptorAllocator::Allocator::Invalid, L"Out of descriptors.");
+    EnsureDescriptorHeapCapacity();
+    *cpuDescriptor = GetDescriptorForWriting(descriptorIndex);
+    return descriptorIndex;
+}
+
+// The staging heap handle of an allocated descriptor, copied to the shader visible heap by the next CommitDescriptors.
+D3D12_CPU_DESCRIPTOR_HANDLE D3D12RaytracingSimpleLighting::GetDescriptorForWriting(UINT descriptorIndex)
+{
+    m_dirtyDescriptorsBegin = std::min(m_dirtyDescriptorsBegin, descriptorIndex);
+    m_dirtyDescriptorsEnd = std::max(m_dirtyDescriptorsEnd, descriptorIndex + 1);
+    return CD3DX12_CPU_DESCRIPTOR_HANDLE(m_descriptorStagingHeap->GetCPUDescriptorHandleForHeapStart(), descriptorIndex, m_descriptorSize);
 }
 
-// Create SRV for a buffer.
-UINT D3D12RaytracingSimpleLighting::CreateBufferSRV(D3DBuffer* buffer, UINT numElements, UINT elementSize)
+// The index of a descriptor from its handle in the shader visible heap.
+UINT D3D12RaytracingSimpleLighting::GetDescriptorIndex(D3D12_GPU_DESCRIPTOR_HANDLE gpuDescriptor) const
+{
+    return static_cast<UINT>((gpuDescriptor.ptr - m_descriptorHeap->GetGPUDescriptorHandleForHeapStart().ptr) / m_descriptorSize);
+}
+
+// Create SRV for a buffer, into descriptorIndex if it has one already.
+UINT D3D12RaytracingSimpleLighting::CreateBufferSRV(D3DBuffer* buffer, UINT numElements, UINT elementSize, UINT descriptorIndex)
 {
     auto device = m_deviceResources->GetD3DDevice();
 
@@ -1153,7 +2445,14 @@ UINT D3D12RaytracingSimpleLighting::CreateBufferSRV(D3DBuffer* buffer, UINT numE
         srvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_NONE;
         srvDesc.Buffer.StructureByteStride = elementSize;
     }
-    UINT descriptorIndex = AllocateDescriptor(&buffer->cpuDescriptorHandle);
+    if (descriptorIndex == UINT_MAX)
+    {
+        descriptorIndex = AllocateDescriptor(&buffer->cpuDescriptorHandle, DescriptorAllocator::RangeGeometry);
+    }
+    else
+    {
+        buffer->cpuDescriptorHandle = GetDescriptorForWriting(descriptorIndex);
+    }
     device->CreateShaderResourceView(buffer->resource.Get(), &srvDesc, buffer->cpuDescriptorHandle);
     buffer->gpuDescriptorHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(m_descriptorHeap->GetGPUDescriptorHandleForHeapStart(), descriptorIndex, m_descriptorSize);
     return descriptorIndex;
@@ -1356,6 +2655,7 @@ void D3D12RaytracingSimpleLighting::StartFrameImGUI()
   auto ResetPathTracing = [&]()
   {
     m_camChanged = true;
+    light_list_dirty = true;
   };
 
   auto GetNewCPUGPUHandles = [&]
@@ -1386,6 +2686,10 @@ void D3D12RaytracingSimpleLighting::StartFrameImGUI()
     if (ImGui::TreeNode(FormatIdAndName("Model", model).c_str()))
     {
       ImGui::Text("Model name", model.name, NAME_LIMIT);
+      const bool quantized = model.attribute_format == Packing::VertexAttributesQuantized;
+      const UINT streamStride = Packing::VERTEX_POSITION_STRIDE + (quantized ? Packing::VERTEX_QUANTIZED_ATTRIBUTES_STRIDE : Packing::VERTEX_ATTRIBUTES_STRIDE);
+      ImGui::Text("%d vertices, %u bytes each (%u interleaved), %s attributes", model.verticesCount, streamStride, Packing::VERTEX_INTERLEAVED_STRIDE,
+                  quantized ? "quantized" : "float");
 
       if (ImGui::TreeNode("Vertices"))
       {
@@ -1519,6 +2823,9 @@ void D3D12RaytracingSimpleLighting::StartFrameImGUI()
       ImGui::SliderFloat("Refractiveness", &material_resource.material.refractiveness, 0.0f, 10.0f);
       ImGui::SliderFloat("Index of Refraction", &material_resource.material.eta, 0.0f, 10.0f);
       ImGui::SliderFloat("Emittance", &material_resource.material.emittance, 0.0f, 10.0f);
+      ImGui::SliderFloat("Metallic", &material_resource.material.metallic, 0.0f, 1.0f);
+      ImGui::SliderFloat("Roughness", &material_resource.material.roughness, 0.0f, 1.0f);
+      ImGui::SameLine(); ShowHelpMarker("Above 0 the material is a GGX metal/roughness one with Diffuse as the base color,\nunless it is reflective, refractive or emissive.\n");
       if(ImGui::TreeNode("Resource"))
       {
         ImGui::Text("Resource Pointer: %p", material_resource.d3d12_material_resource.resource.GetAddressOf());
@@ -2008,8 +3315,30 @@ void D3D12RaytracingSimpleLighting::StartFrameImGUI()
     {  
       ImGui::Checkbox("Anti-Aliasing", &enable_anti_aliasing);
       ImGui::Checkbox("Depth Of Field", &enable_depth_of_field);
+      ImGui::Checkbox("Next Event Estimation", &enable_next_event_estimation);
+      ShowHelpMarker("Sample the emissive triangles directly at diffuse hits, combined with the bounces through multiple importance sampling.");
+      ImGui::Text("Emissive triangles: %u", m_sceneLoaded->lights.GetSampleableCount());
+      ImGui::Checkbox("Russian Roulette", &enable_russian_roulette);
+      ImGui::DragInt("Russian roulette min depth", reinterpret_cast<int*>(&feature_rr_min_depth), 1.0f, 0, 64);
+      ShowHelpMarker("Past this many bounces a path survives with a probability that follows its throughput.");
 
       ImGui::DragInt("Iteration depth", reinterpret_cast<int*>(&feature_depth));
+      ImGui::SliderInt("Samples per launch", reinterpret_cast<int*>(&feature_samples_per_launch), 1, 64);
+      ImGui::Combo("Sampler", reinterpret_cast<int*>(&feature_sampler), "Random (xorshift)\0Sobol (Owen scrambled)\0Blue noise (Morton ordered Sobol)\0");
+      ShowHelpMarker("Where the random numbers of a path come from. The Sobol samplers stratify every dimension, blue noise also spreads the remaining error evenly over the screen.");
+
+      ImGui::Checkbox("Specialized shaders", &enable_shader_permutations);
+      ShowHelpMarker("Compile the shaders without the material paths and features the scene does not use, rebuilt when an edit needs one of them. Compiled versions are kept in shader_cache.");
+      ImGui::Text("Shader paths: %s", ShaderPermutation::Describe(shader_permutation).c_str());
+      ImGui::TextWrapped("%s", shader_permutation_status.c_str());
+
+      ImGui::Checkbox("Adaptive Sampling", &enable_adaptive_sampling);
+      ImGui::SliderFloat("Relative error threshold", &adaptive_threshold, 0.001f, 0.5f, "%.3f", 2.0f);
+      ImGui::DragInt("Min samples per pixel", reinterpret_cast<int*>(&adaptive_min_samples), 1.0f, 1, 4096);
+      if (enable_adaptive_sampling)
+      {
+        ImGui::Text("Converged tiles: %u / %u", adaptive_sampler.GetConvergedTileCount(), adaptive_sampler.GetTileCount());
+      }
 
       if (ImGui::Button("Update"))
       {
@@ -2018,7 +3347,18 @@ void D3D12RaytracingSimpleLighting::StartFrameImGUI()
         current_scene.features = 0;
         current_scene.features |= enable_anti_aliasing ? AntiAliasing : 0;
         current_scene.features |= enable_depth_of_field ? DepthOfField : 0;
+        current_scene.features |= enable_next_event_estimation ? NextEventEstimation : 0;
+        current_scene.features |= enable_russian_roulette ? RussianRoulette : 0;
+        current_scene.features |= enable_ray_statistics ? RayStatistics : 0;
+        current_scene.rr_min_depth = feature_rr_min_depth;
+        current_scene.features |= enable_adaptive_sampling ? AdaptiveSampling : 0;
         current_scene.depth = feature_depth;
+        current_scene.samples_per_launch = std::max(feature_samples_per_launch, 1u);
+        current_scene.sampler_type = feature_sampler;
+        current_scene.adaptive_min_samples = adaptive_min_samples;
+
+        adaptive_sampler.SetThreshold(adaptive_threshold);
+        adaptive_sampler.SetMinSamples(adaptive_min_samples);
 
         for (std::size_t  i = 0; i < FrameCount; i++)
         {
@@ -2027,6 +3367,81 @@ void D3D12RaytracingSimpleLighting::StartFrameImGUI()
 
         ResetPathTracing();
       }
+
+      ImGui::Separator();
+      ImGui::Checkbox("Denoiser (SVGF a-trous)", &enable_denoiser);
+      ShowHelpMarker("Filters the accumulated image every frame, guided by the albedo, normal and depth of the first hit and the variance of every pixel. Not applied to tiled renders.");
+      ImGui::SliderInt("Denoiser iterations", reinterpret_cast<int*>(&denoiser_iterations), 1, Denoiser::DENOISE_MAX_ITERATIONS);
+      ImGui::SliderFloat("Denoiser luminance sigma", &denoiser_sigma_luminance, 0.5f, 16.0f, "%.1f");
+
+      ImGui::Separator();
+      const char* accumulationFormats = "Float32\0Half, compensated\0Packed R11G11B10\0";
+      int accumulationFormat = static_cast<int>(accumulation_format_requested);
+      if (tiled_render_job.IsActive() || sequence_capture.IsActive())
+      {
+        //the readbacks of both are sized and timed for the current buffers
+        ImGui::TextDisabled("Accumulation format is fixed while rendering tiles or a sequence");
+      }
+      else if (ImGui::Combo("Accumulation", &accumulationFormat, accumulationFormats))
+      {
+        accumulation_format_requested = static_cast<UINT>(accumulationFormat);
+      }
+      ShowHelpMarker("How the samples of every pixel are summed up. Float32 keeps the sums, Half a running mean with its rounding error in a second texture, Packed a stochastically rounded mean that gets noisier the longer it accumulates, for previews. Switching starts the image over.");
+      ImGui::Text("Accumulation: %.1f MB", Accumulation::AccumulationBytesPerPixel(accumulation_format) * double(m_width) * m_height / (1024.0 * 1024.0));
+      if (accumulation_format_fallback)
+      {
+        ImGui::SameLine();
+        ImGui::TextColored(ImVec4(1.0f, 0.6f, 0.2f, 1.0f), "(no typed UAV loads of that format, using Float32)");
+      }
+
+      ImGui::Separator();
+      ImGui::Text("Average path length: %.2f segments, %.2f ms/frame", average_path_length, frame_time_ms);
+      if (ImGui::Checkbox("Ray statistics", &enable_ray_statistics))
+      {
+        for (auto& sceneCB : m_sceneCB)
+        {
+          sceneCB.features = enable_ray_statistics ? (sceneCB.features | RayStatistics) : (sceneCB.features & ~RayStatistics);
+        }
+      }
+      ShowHelpMarker("Count the rays of every frame by bounce and by what they hit, summed over each wave in the raygen shader. Costs a few wave operations per sample. DXR does not tell how many BVH nodes and triangles a ray visited, cpurender --ray-stats counts those on the CPU BVH.");
+      if (enable_ray_statistics && ray_stats_seconds > 0.0)
+      {
+        using namespace RayStats;
+        auto Percent = [](UINT64 part, UINT64 whole) { return whole > 0 ? 100.0 * part / whole : 0.0; };
+        const UINT64 segments = ray_stats[RayStatSegments];
+        const UINT64 shadowRays = ray_stats[RayStatShadowRays];
+        ImGui::Text("Rays: %.1f M/s, %.1f M/s path segments, %.1f M/s shadow rays", (segments + shadowRays) / ray_stats_seconds / 1e6,
+                    segments / ray_stats_seconds / 1e6, shadowRays / ray_stats_seconds / 1e6);
+        ImGui::Text("Segments: %.1f%% closest hit, %.1f%% light, %.1f%% miss", Percent(ray_stats[RayStatClosestHits], segments),
+                    Percent(ray_stats[RayStatLightHits], segments), Percent(ray_stats[RayStatMisses], segments));
+        ImGui::Text("Shadow rays occluded: %.1f%%, paths ended by russian roulette: %.1f%%", Percent(ray_stats[RayStatShadowOccluded], shadowRays),
+                    Percent(ray_stats[RayStatTerminated], ray_stats[RayStatPaths]));
+
+        float bounces[RAY_STATS_MAX_DEPTH];
+        int bounceCount = 0;
+        for (int d = 0; d < RAY_STATS_MAX_DEPTH; d++)
+        {
+          bounces[d] = static_cast<float>(Percent(ray_stats[RayStatDepth + d], ray_stats[RayStatPaths]));
+          bounceCount = bounces[d] > 0.0f ? d + 1 : bounceCount;
+        }
+        ImGui::PlotHistogram("Paths reaching bounce (%)", bounces, std::max(bounceCount, 1), 0, nullptr, 0.0f, 100.0f, ImVec2(0, 60));
+      }
+      if (rr_benchmark_phase < 0)
+      {
+        if (ImGui::Button("Benchmark Russian roulette"))
+        {
+          StartRussianRouletteBenchmark();
+        }
+        ShowHelpMarker("Renders a fixed number of frames without and then with russian roulette and compares them.");
+      }
+      else
+      {
+        ImGui::Text("Benchmarking %s russian roulette: %u / %u frames", rr_benchmark_phase == 0 ? "without" : "with", rr_benchmark_frames, c_rrBenchmarkFrames);
+      }
+      if (!rr_benchmark_report.empty())
+      {
+        ImGui::TextUnformatted(rr_benchmark_report.c_str());
+      }
     }
   };
 
@@ -2213,6 +3628,18 @@ void D3D12RaytracingSimpleLighting::StartFrameImGUI()
                     object.info_resource.info.texture_offset--;
                   }
                 }
+                if (object.textures.metallicRoughnessTex != nullptr)
+                {
+                  if (object.textures.metallicRoughnessTex->id == i)
+                  {
+                    object.textures.metallicRoughnessTex = nullptr;
+                    object.info_resource.info.texture_metallic_roughness_offset = -1;
+                  }
+                  else if (object.textures.metallicRoughnessTex->id > i)
+                  {
+                    object.info_resource.info.texture_metallic_roughness_offset--;
+                  }
+                }
               }
 
               //find and erase i
@@ -2241,6 +3668,10 @@ void D3D12RaytracingSimpleLighting::StartFrameImGUI()
                 {
                   object.textures.albedoTex = &diffuse_texture_map[object.info_resource.info.texture_offset];
                 }
+                if (object.textures.metallicRoughnessTex != nullptr)
+                {
+                  object.textures.metallicRoughnessTex = &diffuse_texture_map[object.info_resource.info.texture_metallic_roughness_offset];
+                }
               }
             }
 
@@ -2388,6 +3819,8 @@ void D3D12RaytracingSimpleLighting::StartFrameImGUI()
         new_object.info_resource.info.texture_normal_offset = -1;
         new_object.info_resource.info.diffuse_sampler_offset = 0;
         new_object.info_resource.info.normal_sampler_offset = 0;
+        new_object.info_resource.info.texture_metallic_roughness_offset = -1;
+        new_object.info_resource.info.metallic_roughness_sampler_offset = 0;
         
 
         rebuild_scene = true;
@@ -2426,10 +3859,11 @@ void D3D12RaytracingSimpleLighting::StartFrameImGUI()
       {
         bool save_button_pressed = ImGui::Button("Save scene");
         static ImGuiFs::Dialog dlg; // one per dialog (and must be static)
+        ImGui::SameLine(); ShowHelpMarker("The extension picks the format: .txt, .json or .rtxscene (binary, the fastest to load).\n");
         const char* save_path = dlg.saveFileDialog(save_button_pressed, nullptr, "scene.txt");
         if (strlen(save_path) > 0)
         {
-          SerializeToTxt(save_path);
+          SerializeScene(save_path);
         }
         else if (save_button_pressed)
         {
@@ -2440,7 +3874,7 @@ void D3D12RaytracingSimpleLighting::StartFrameImGUI()
       {
         bool load_button_pressed = ImGui::Button("Load scene");
         static ImGuiFs::Dialog dlg; // one per dialog (and must be static)
-        const char* load_path = dlg.chooseFileDialog(load_button_pressed, nullptr, ".txt");
+        const char* load_path = dlg.chooseFileDialog(load_button_pressed, nullptr, ".txt;.json;.rtxscene");
         if (strlen(load_path) > 0)
         {
           p_sceneFileName = load_path;
@@ -2453,6 +3887,14 @@ void D3D12RaytracingSimpleLighting::StartFrameImGUI()
           ImGui::Text("Invalid path");
         }
       }
+
+      ImGui::Checkbox("Hot reload", &enable_hot_reload);
+      ImGui::SameLine(); ShowHelpMarker("Watches the scene file and the models and textures it uses. A changed model or texture is imported again on its own, a changed scene or GLTF file loads the scene again.\n");
+      ImGui::Text("Watching %zu files (%s)", hot_reload_watcher.GetFileCount(), hot_reload_watcher.IsUsingNotifier() ? "notified" : "polling");
+      if (!hot_reload_status.empty())
+      {
+        ImGui::TextWrapped("%s", hot_reload_status.c_str());
+      }
     }
   };
 
@@ -2463,8 +3905,9 @@ void D3D12RaytracingSimpleLighting::StartFrameImGUI()
       {
         bool save_button_pressed = ImGui::Button("Save image");
         static ImGuiFs::Dialog dlg1; // one per dialog (and must be static)
-        const char* save_path = dlg1.saveFileDialog(save_button_pressed, nullptr, "scene.bmp", ".bmp");
-        if (strlen(save_path) > 0)
+        const char* save_path = dlg1.saveFileDialog(save_button_pressed, nullptr, "scene.exr", ".exr;.hdr;.png;.jpg;.bmp");
+        ImageWriter::Format save_format;
+        if (strlen(save_path) > 0 && ImageWriter::GetFormat(save_path, save_format))
         {
           save_image = true;
           save_image_path = save_path;
@@ -2473,12 +3916,38 @@ void D3D12RaytracingSimpleLighting::StartFrameImGUI()
         {
           ImGui::Text("Invalid path");
         }
+        ShowHelpMarker("Saves the accumulated image before the denoiser. exr and hdr keep values above one, png, jpg and bmp are clamped. Written in the background.");
+
+        bool exr_float = save_image_options.exr_pixel_type == ImageWriter::ExrPixelType::Float;
+        bool exr_zip = save_image_options.exr_compression == ImageWriter::ExrCompression::Zip;
+        ImGui::Checkbox("EXR 32 bit float", &exr_float);
+        ImGui::SameLine();
+        ImGui::Checkbox("EXR ZIP compression", &exr_zip);
+        save_image_options.exr_pixel_type = exr_float ? ImageWriter::ExrPixelType::Float : ImageWriter::ExrPixelType::Half;
+        save_image_options.exr_compression = exr_zip ? ImageWriter::ExrCompression::Zip : ImageWriter::ExrCompression::None;
+
+        const size_t pending = image_writer.GetPendingCount();
+        if (pending > 0)
+        {
+          ImGui::Text("Writing %zu image(s)...", pending);
+        }
+        else if (image_writer_has_result)
+        {
+          if (image_writer_last_result.success)
+          {
+            ImGui::Text("Wrote %s, %zu KB in %.0f ms", image_writer_last_result.path.c_str(), image_writer_last_result.bytes / 1024, image_writer_last_result.seconds * 1000.0);
+          }
+          else
+          {
+            ImGui::Text("Cannot write %s", image_writer_last_result.path.c_str());
+          }
+        }
       }
 
       {
         const bool load_button_pressed = ImGui::Button("Load image for comparison");
         static ImGuiFs::Dialog dlg; // one per dialog (and must be static)
-        const char* load_path = dlg.chooseFileDialog(load_button_pressed, nullptr, ".bmp");
+        const char* load_path = dlg.chooseFileDialog(load_button_pressed, nullptr, ".bmp;.png;.jpg");
         if (strlen(load_path) > 0)
         {
           load_split_image = true;
@@ -2487,46 +3956,388 @@ void D3D12RaytracingSimpleLighting::StartFrameImGUI()
         }
         else if (load_button_pressed)
         {
-          ImGui::Text("Invalid path");
+          ImGui::Text("Invalid path");
+        }
+
+        if (load_split_image)
+        {
+          ImGui::Checkbox("Auto Move Split Image Slider", &image_splitter_auto_move);
+
+          if(image_splitter_auto_move)
+          {
+            ImGui::DragInt("Auto Move Split Image Slider Speed", &image_splitter_auto_move_speed, 1, 0, 10);
+          }
+          else
+          {
+            ImGui::SliderFloat("Split Image bar position", &image_position_split_percentage, 0.0f, 100.0f);
+            image_position_split_percentage /= 100.0f;
+            image_splitter_x = static_cast<int>(image_position_split_percentage * static_cast<float>(m_width));
+            image_position_split_percentage *= 100.0f;
+          }
+
+          if(ImGui::Button("Set slider to be the middle"))
+          {
+            image_position_split_percentage = 50.0f;
+            image_splitter_x = m_width / 2;
+          }
+
+          //clamp, cuz copytextureregion will be mad :(
+          if(image_splitter_x <= 0)
+          {
+            image_splitter_x = 1;
+          }
+          else if(image_splitter_x >= m_width)
+          {
+            image_splitter_x = m_width;
+          }
+
+          if (ImGui::Button("Stop image comparison"))
+          {
+            load_split_image = false;
+          }
+        }
+      }
+    }
+  };
+
+  auto DragSetting = [](const char* label, unsigned int* value, int max)
+  {
+    int v = static_cast<int>(*value);
+    ImGui::DragInt(label, &v, 1.0f, 1, max);
+    *value = static_cast<unsigned int>(std::max(1, std::min(v, max)));
+  };
+
+  auto TiledRenderHeader = [&]()
+  {
+    if (ImGui::CollapsingHeader("Tiled Render"))
+    {
+      if (!tiled_render_job.IsActive())
+      {
+        DragSetting("Image width", &tiled_render_settings.width, 32768);
+        DragSetting("Image height", &tiled_render_settings.height, 32768);
+        DragSetting("Tile width", &tiled_render_settings.tile_width, 4096);
+        DragSetting("Tile height", &tiled_render_settings.tile_height, 4096);
+        DragSetting("Samples per pixel", &tiled_render_settings.samples_per_pixel, 1 << 20);
+        ShowHelpMarker("Tiles are clamped to the window size. Starting again with the same output path and settings resumes an interrupted render.");
+
+        bool start_button_pressed = ImGui::Button("Start / Resume tiled render");
+        static ImGuiFs::Dialog dlg2; // one per dialog (and must be static)
+        const char* output_path = dlg2.saveFileDialog(start_button_pressed, nullptr, "render.png", ".png");
+        if (strlen(output_path) > 0)
+        {
+          tiled_render_settings.output_path = output_path;
+          StartTiledRender();
+        }
+        else if (start_button_pressed)
+        {
+          ImGui::Text("Invalid path");
+        }
+      }
+      else
+      {
+        const auto& settings = tiled_render_job.GetSettings();
+        ImGui::Text("%ux%u, %ux%u tiles, %u spp", settings.width, settings.height, settings.tile_width, settings.tile_height, settings.samples_per_pixel);
+        ImGui::Text("Tiles done: %u / %u", tiled_render_job.GetDoneCount(), tiled_render_job.GetTileCount());
+        if (tiled_render_tile_active)
+        {
+          ImGui::Text("Tile %u: %u / %u samples", tiled_render_tile.index, tiled_render_tile_samples, settings.samples_per_pixel);
+        }
+        ImGui::ProgressBar(static_cast<float>(tiled_render_job.GetDoneCount()) / static_cast<float>(std::max(tiled_render_job.GetTileCount(), 1u)));
+
+        if (ImGui::Button("Cancel tiled render"))
+        {
+          StopTiledRender();
+        }
+      }
+
+      if (!tiled_render_status.empty())
+      {
+        ImGui::Text("%s", tiled_render_status.c_str());
+      }
+    }
+  };
+
+  auto SequenceCaptureHeader = [&]()
+  {
+    if (ImGui::CollapsingHeader("Sequence Capture"))
+    {
+      const CameraPath::Path* path = m_sceneLoaded != nullptr ? &m_sceneLoaded->camera.path : nullptr;
+      if (!sequence_capture.IsActive())
+      {
+        if (path == nullptr || path->IsEmpty())
+        {
+          ImGui::Text("The scene has no camera keyframes");
+          ImGui::SameLine(); ShowHelpMarker("Add lines like\n  keyframe 0.0  0 0 -20  0 0 1  45\nto the CAMERA block of the scene file: time in seconds, eye, look-at and an optional fov.");
+        }
+        else
+        {
+          ImGui::Text("%zu keyframes, %.2f s", path->GetKeyframes().size(), path->GetDuration());
+          ImGui::DragFloat("Frames per second", &capture_settings.frames_per_second, 0.1f, 1.0f, 240.0f, "%.1f");
+          capture_settings.frames_per_second = std::max(capture_settings.frames_per_second, 1.0f);
+          DragSetting("Samples per frame", &capture_settings.samples_per_frame, 1 << 20);
+          DragSetting("Readback buffers", &capture_settings.readback_slots, SequenceCapture::MAX_READBACK_SLOTS);
+          unsigned int encoder_queue = static_cast<unsigned int>(capture_settings.encoder_queue);
+          DragSetting("Encoder queue", &encoder_queue, 64);
+          capture_settings.encoder_queue = encoder_queue;
+          ShowHelpMarker("Frames wait for an encoder thread in the queue, then in the readback buffers, then the renderer waits. Nothing blocks a frame.");
+          ImGui::Text("%u frames at %ux%u", path->GetFrameCount(capture_settings.frames_per_second), m_width, m_height);
+
+          bool start_button_pressed = ImGui::Button("Start sequence capture");
+          static ImGuiFs::Dialog dlg3; // one per dialog (and must be static)
+          const char* output_path = dlg3.saveFileDialog(start_button_pressed, nullptr, "frame_####.exr", ".exr;.hdr;.png;.jpg;.bmp");
+          ShowHelpMarker("The #s are replaced by the frame number. The EXR options of Save image apply.");
+          if (strlen(output_path) > 0)
+          {
+            capture_settings.output_pattern = output_path;
+            capture_settings.image_options = save_image_options;
+            StartSequenceCapture();
+          }
+          else if (start_button_pressed)
+          {
+            ImGui::Text("Invalid path");
+          }
+        }
+      }
+      else
+      {
+        const auto& settings = sequence_capture.GetSettings();
+        const auto& stats = sequence_capture.GetStatistics();
+        ImGui::Text("Frame %u / %u: %u / %u samples", sequence_capture.GetNextFrame(), sequence_capture.GetFrameCount(), capture_frame_samples, settings.samples_per_frame);
+        ImGui::ProgressBar(static_cast<float>(stats.frames_written) / static_cast<float>(std::max(sequence_capture.GetFrameCount(), 1u)));
+        ImGui::Text("Written %u, encoding %zu on %u threads", stats.frames_written, sequence_capture.GetEncoderPendingCount(), settings.encoder_threads);
+        ImGui::Text("Waits: %u for a readback buffer, %u for the encoders", stats.slot_stalls, stats.encoder_stalls);
+
+        if (ImGui::Button("Cancel sequence capture"))
+        {
+          StopSequenceCapture();
+        }
+      }
+
+      if (!capture_status.empty())
+      {
+        ImGui::Text("%s", capture_status.c_str());
+      }
+    }
+  };
+
+  auto ProfilerHeader = [&]()
+  {
+    if (ImGui::CollapsingHeader("Profiler"))
+    {
+      bool record = Profiler::IsEnabled();
+      if (ImGui::Checkbox("Record", &record))
+      {
+        Profiler::SetEnabled(record);
+      }
+      ImGui::SameLine(); ImGui::Checkbox("Pause view", &profiler_paused);
+      ImGui::SameLine(); ShowHelpMarker("Timed scopes of the threads and passes of the GPU. Hover a scope for its time. The GPU band is a few frames behind, its timestamps are read once the frame completed.\n");
+      ImGui::SliderFloat("View (ms)", &profiler_view_milliseconds, 5.0f, 2000.0f, "%.0f", 2.0f);
+      ImGui::SliderFloat("History (s)", &profiler_history_seconds, 1.0f, 60.0f, "%.0f");
+      ImGui::Text("GPU frame: %.3f ms, %llu events dropped", gpu_profiler.GetFrameMilliseconds(), static_cast<unsigned long long>(Profiler::GetDroppedCount()));
+      ShowProfilerFlameView();
+
+      bool export_button_pressed = ImGui::Button("Export trace");
+      ImGui::SameLine(); ShowHelpMarker("Chrome trace of the startup and the history, open it in chrome://tracing or ui.perfetto.dev.\n");
+      static ImGuiFs::Dialog dlg4; // one per dialog (and must be static)
+      const char* trace_path = dlg4.saveFileDialog(export_button_pressed, nullptr, "profile.json", ".json");
+      if (strlen(trace_path) > 0)
+      {
+        profiler_status = ExportProfilerTrace(trace_path) ? std::string("Wrote ") + trace_path : std::string("Cannot write ") + trace_path;
+      }
+      if (!profiler_status.empty())
+      {
+        ImGui::Text("%s", profiler_status.c_str());
+      }
+    }
+  };
+
+  auto SceneStatsHeader = [&]()
+  {
+    if (ImGui::CollapsingHeader("Scene statistics"))
+    {
+      bool refresh = ImGui::Button("Refresh");
+      ImGui::SameLine(); ShowHelpMarker("What the scene costs, from its models, textures, materials and objects and the acceleration structures built last. Compacted sizes come from the DXR builds only. The area ratio is the summed surface area of the objects' bounds over the scene's, about how many instances a ray through the scene enters.\n");
+      if (refresh || !scene_stats_valid)
+      {
+        scene_stats = m_sceneLoaded->BuildStats(m_raytracingAPI == RaytracingAPI::FallbackLayer);
+        scene_stats_valid = true;
+      }
+      const SceneStats::Report& report = scene_stats;
+      const float KiB = 1.0f / 1024.0f;
+      const float MiB = KiB / 1024.0f;
+
+      ImGui::Text("%zu models, %zu objects, %llu triangles (%llu instanced)", report.models.size(), report.objects.size(),
+          static_cast<unsigned long long>(report.triangles), static_cast<unsigned long long>(report.instanced_triangles));
+      ImGui::Text("Vertices: %llu, %llu unique", static_cast<unsigned long long>(report.vertices), static_cast<unsigned long long>(report.unique_vertices));
+      ImGui::Text("Geometry: %.2f MiB, bottom levels %.2f MiB (compacted %.2f MiB)", report.geometry_bytes * MiB, report.blas_bytes * MiB,
+          report.blas_compacted_bytes * MiB);
+      ImGui::Text("Top level: %.1f KiB, build scratch %.2f MiB, instance descs %.1f KiB", report.tlas.result_bytes * KiB, report.scratch_bytes * MiB,
+          report.instance_desc_bytes * KiB);
+      ImGui::Text("Textures: %.2f MiB, constant buffers %.1f KiB of which %.1f KiB padding", report.texture_bytes * MiB, report.constant_bytes * KiB,
+          report.constant_wasted_bytes * KiB);
+      ImGui::Text("Object bounds: %llu overlapping pairs, area ratio %.2f", static_cast<unsigned long long>(report.overlapping_pairs), report.area_ratio);
+
+      if (ImGui::TreeNode("Models##stats"))
+      {
+        ImGui::Columns(8);
+        for (const char* title : { "Model", "Triangles", "Vertices", "Unique", "BLAS KiB", "Compacted KiB", "Scratch KiB", "Instances" })
+        {
+          ImGui::Text("%s", title);
+          ImGui::NextColumn();
+        }
+        ImGui::Separator();
+        for (const SceneStats::Model& model : report.models)
+        {
+          ImGui::Text("%d %s", model.id, model.name.c_str()); ImGui::NextColumn();
+          ImGui::Text("%llu", static_cast<unsigned long long>(model.triangles)); ImGui::NextColumn();
+          ImGui::Text("%llu", static_cast<unsigned long long>(model.vertices)); ImGui::NextColumn();
+          ImGui::Text("%llu", static_cast<unsigned long long>(model.unique_vertices)); ImGui::NextColumn();
+          ImGui::Text("%.1f", model.blas.result_bytes * KiB); ImGui::NextColumn();
+          ImGui::Text("%.1f", model.blas.compacted_bytes * KiB); ImGui::NextColumn();
+          ImGui::Text("%.1f", model.blas.scratch_bytes * KiB); ImGui::NextColumn();
+          ImGui::Text("%u", model.instances); ImGui::NextColumn();
+        }
+        ImGui::Columns(1);
+        ImGui::TreePop();
+      }
+
+      if (ImGui::TreeNode("Textures by format##stats"))
+      {
+        ImGui::Columns(4);
+        for (const char* title : { "Format", "Mip", "Textures", "KiB" })
+        {
+          ImGui::Text("%s", title);
+          ImGui::NextColumn();
+        }
+        ImGui::Separator();
+        for (const SceneStats::FormatUsage& usage : report.formats)
+        {
+          ImGui::Text("%s", usage.format.c_str()); ImGui::NextColumn();
+          ImGui::Text("%u", usage.mip); ImGui::NextColumn();
+          ImGui::Text("%u", usage.textures); ImGui::NextColumn();
+          ImGui::Text("%.1f", usage.bytes * KiB); ImGui::NextColumn();
+        }
+        ImGui::Columns(1);
+        ImGui::TreePop();
+      }
+
+      if (ImGui::TreeNode("Constant buffers##stats"))
+      {
+        ImGui::Columns(5);
+        for (const char* title : { "Buffer", "Count", "Size", "Padded", "Wasted KiB" })
+        {
+          ImGui::Text("%s", title);
+          ImGui::NextColumn();
+        }
+        ImGui::Separator();
+        for (const SceneStats::ConstantBuffers& buffers : report.constant_buffers)
+        {
+          ImGui::Text("%s", buffers.name.c_str()); ImGui::NextColumn();
+          ImGui::Text("%u", buffers.count); ImGui::NextColumn();
+          ImGui::Text("%llu", static_cast<unsigned long long>(buffers.size)); ImGui::NextColumn();
+          ImGui::Text("%llu", static_cast<unsigned long long>(buffers.padded_size)); ImGui::NextColumn();
+          ImGui::Text("%.1f", buffers.wasted_bytes * KiB); ImGui::NextColumn();
+        }
+        ImGui::Columns(1);
+        ImGui::TreePop();
+      }
+
+      if (ImGui::TreeNode("Descriptors##stats"))
+      {
+        ImGui::Text("%u of %u in the heap used", report.descriptor_high_water_mark, report.descriptor_capacity);
+        ImGui::Columns(4);
+        for (const char* title : { "Range", "Allocated", "Free", "Chunks" })
+        {
+          ImGui::Text("%s", title);
+          ImGui::NextColumn();
+        }
+        ImGui::Separator();
+        for (const SceneStats::Descriptors& range : report.descriptors)
+        {
+          ImGui::Text("%s", range.range.c_str()); ImGui::NextColumn();
+          ImGui::Text("%u", range.allocated); ImGui::NextColumn();
+          ImGui::Text("%u", range.free); ImGui::NextColumn();
+          ImGui::Text("%u", range.chunks); ImGui::NextColumn();
+        }
+        ImGui::Columns(1);
+        ImGui::TreePop();
+      }
+
+      if (ImGui::TreeNode("Object bounds##stats"))
+      {
+        ImGui::Columns(5);
+        for (const char* title : { "Object", "Model", "Surface area", "Overlaps", "Overlap ratio" })
+        {
+          ImGui::Text("%s", title);
+          ImGui::NextColumn();
+        }
+        ImGui::Separator();
+        for (const SceneStats::Object& object : report.objects)
+        {
+          ImGui::Text("%d %s", object.id, object.name.c_str()); ImGui::NextColumn();
+          ImGui::Text("%d", object.model); ImGui::NextColumn();
+          ImGui::Text("%.2f", object.bounds.SurfaceArea()); ImGui::NextColumn();
+          ImGui::Text("%u", object.overlaps); ImGui::NextColumn();
+          ImGui::Text("%.2f", object.overlap_ratio); ImGui::NextColumn();
+        }
+        ImGui::Columns(1);
+        ImGui::TreePop();
+      }
+
+      if (ImGui::TreeNode("BVH quality##stats"))
+      {
+        if (m_raytracingAPI == RaytracingAPI::FallbackLayer)
+        {
+          bvh_analysis_requested |= ImGui::Button("Read back");
+          ImGui::SameLine(); ShowHelpMarker("Copies the fallback layer's bottom and top levels to the CPU and measures their trees. SAH is the expected cost of a ray through the scene's box, EPO how much of the surface lies in boxes of nodes that do not hold it, both in traversal steps of 1.2 and triangle tests of 1. The DXR ones are opaque.\n");
         }
-
-        if (load_split_image)
+        auto ShowQuality = [&](const std::string& name, const SceneStats::AccelerationStructure& structure)
         {
-          ImGui::Checkbox("Auto Move Split Image Slider", &image_splitter_auto_move);
-
-          if(image_splitter_auto_move)
-          {
-            ImGui::DragInt("Auto Move Split Image Slider Speed", &image_splitter_auto_move_speed, 1, 0, 10);
-          }
-          else
-          {
-            ImGui::SliderFloat("Split Image bar position", &image_position_split_percentage, 0.0f, 100.0f);
-            image_position_split_percentage /= 100.0f;
-            image_splitter_x = static_cast<int>(image_position_split_percentage * static_cast<float>(m_width));
-            image_position_split_percentage *= 100.0f;
-          }
-
-          if(ImGui::Button("Set slider to be the middle"))
-          {
-            image_position_split_percentage = 50.0f;
-            image_splitter_x = m_width / 2;
-          }
-
-          //clamp, cuz copytextureregion will be mad :(
-          if(image_splitter_x <= 0)
-          {
-            image_splitter_x = 1;
-          }
-          else if(image_splitter_x >= m_width)
+          if (!structure.analyzed)
           {
-            image_splitter_x = m_width;
+            return;
           }
-
-          if (ImGui::Button("Stop image comparison"))
+          const BvhQuality::Metrics& quality = structure.quality;
+          std::string leaf_sizes;
+          for (std::size_t size = 1; size < quality.leaf_sizes.size(); size++)
           {
-            load_split_image = false;
+            leaf_sizes += (leaf_sizes.empty() ? "" : " ") + std::to_string(size) + ":" + std::to_string(quality.leaf_sizes[size]);
           }
+          ImGui::Text("%s", name.c_str()); ImGui::NextColumn();
+          ImGui::Text("%llu", static_cast<unsigned long long>(quality.nodes)); ImGui::NextColumn();
+          ImGui::Text("%u / %.1f", quality.max_depth, quality.mean_leaf_depth); ImGui::NextColumn();
+          ImGui::Text("%.2f", quality.sah); ImGui::NextColumn();
+          ImGui::Text("%.3f", quality.epo); ImGui::NextColumn();
+          ImGui::Text("%s", leaf_sizes.c_str()); ImGui::NextColumn();
+        };
+        ImGui::Columns(6);
+        for (const char* title : { "Structure", "Nodes", "Depth max / mean", "SAH", "EPO", "Leaves by size" })
+        {
+          ImGui::Text("%s", title);
+          ImGui::NextColumn();
+        }
+        ImGui::Separator();
+        for (const SceneStats::Model& model : report.models)
+        {
+          ShowQuality(std::to_string(model.id) + " " + model.name, model.blas);
         }
+        ShowQuality("Top level", report.tlas);
+        ImGui::Columns(1);
+        ImGui::TreePop();
+      }
+
+      bool save_button_pressed = ImGui::Button("Save JSON");
+      static ImGuiFs::Dialog dlg5; // one per dialog (and must be static)
+      const char* stats_path = dlg5.saveFileDialog(save_button_pressed, nullptr, "scene_stats.json", ".json");
+      if (strlen(stats_path) > 0)
+      {
+        std::ofstream file(stats_path, std::ios::binary);
+        file << SceneStats::ToJson(report);
+        scene_stats_status = file ? std::string("Wrote ") + stats_path : std::string("Cannot write ") + stats_path;
+      }
+      if (!scene_stats_status.empty())
+      {
+        ImGui::Text("%s", scene_stats_status.c_str());
       }
     }
   };
@@ -2549,6 +4360,10 @@ void D3D12RaytracingSimpleLighting::StartFrameImGUI()
     ShowGLTFHeader();
     SaveSceneToDiskHeader();
     ImageFunctionsHeader();
+    TiledRenderHeader();
+    SequenceCaptureHeader();
+    ProfilerHeader();
+    SceneStatsHeader();
     EnableRenderingHeader();
   };
 
@@ -2600,7 +4415,9 @@ void D3D12RaytracingSimpleLighting::InitImGUI()
 
 void D3D12RaytracingSimpleLighting::RenderImGUI()
 {
+  PROFILE_SCOPE("Render ImGui");
   auto commandList = m_deviceResources->GetCommandList();
+  GpuProfiler::Scope gpuScope(gpu_profiler, commandList, "ImGui");
 
   std::vector<ID3D12DescriptorHeap*> heaps = { g_pd3dSrvDescHeap.Get() };
   commandList->SetDescriptorHeaps(static_cast<UINT>(heaps.size()), heaps.data());
@@ -2608,6 +4425,122 @@ void D3D12RaytracingSimpleLighting::RenderImGUI()
   ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData());
 }
 
+// Events of the threads and the GPU come in ring by ring, not in time order, so the
+// history is trimmed by age rather than from the front.
+void D3D12RaytracingSimpleLighting::CollectProfilerEvents()
+{
+  profiler_frame_begin = Profiler::Now();
+  if (!profiler_startup_collected)
+  {
+    Profiler::Collect(profiler_startup_events);
+    profiler_startup_collected = true;
+  }
+  else
+  {
+    Profiler::Collect(profiler_events);
+  }
+  if (!profiler_paused)
+  {
+    profiler_view_end = profiler_frame_begin;
+  }
+
+  const std::int64_t history = static_cast<std::int64_t>(profiler_history_seconds * 1e9);
+  const std::int64_t view = static_cast<std::int64_t>(profiler_view_milliseconds * 1e6);
+  const std::int64_t oldest = std::min(profiler_frame_begin - history, profiler_view_end - view);
+  profiler_events.erase(std::remove_if(profiler_events.begin(), profiler_events.end(), [&](const Profiler::Event& event) { return event.end < oldest; }),
+                        profiler_events.end());
+}
+
+bool D3D12RaytracingSimpleLighting::ExportProfilerTrace(const std::string& path)
+{
+  std::vector<Profiler::Event> events = profiler_startup_events;
+  events.insert(events.end(), profiler_events.begin(), profiler_events.end());
+  return Profiler::WriteChromeTrace(path, events, Profiler::GetTracks());
+}
+
+// One band per thread or GPU queue with events in the view, nested scopes below their
+// parents, and the scopes of the view by their total time.
+void D3D12RaytracingSimpleLighting::ShowProfilerFlameView()
+{
+  const std::vector<Profiler::Track> tracks = Profiler::GetTracks();
+  const std::int64_t viewEnd = profiler_view_end;
+  const std::int64_t viewBegin = viewEnd - static_cast<std::int64_t>(profiler_view_milliseconds * 1e6);
+  const double span = static_cast<double>(viewEnd - viewBegin);
+
+  std::map<std::uint32_t, std::uint32_t> trackDepths;
+  std::map<std::string, std::pair<std::uint32_t, std::int64_t>> totals;
+  for (const Profiler::Event& event : profiler_events)
+  {
+    if (event.end < viewBegin || event.begin > viewEnd || event.track >= tracks.size())
+    {
+      continue;
+    }
+    std::uint32_t& depth = trackDepths[event.track];
+    depth = std::max(depth, event.depth + 1);
+    auto& total = totals[event.name];
+    total.first++;
+    total.second += std::min(event.end, viewEnd) - std::max(event.begin, viewBegin);
+  }
+
+  const float width = 640.0f;
+  const float rowHeight = ImGui::GetTextLineHeight() + 2.0f;
+  float height = 0.0f;
+  for (const auto& pair : trackDepths)
+  {
+    height += rowHeight * (pair.second + 1);
+  }
+
+  ImDrawList* drawList = ImGui::GetWindowDrawList();
+  const ImVec2 origin = ImGui::GetCursorScreenPos();
+  ImGui::InvisibleButton("flame view", ImVec2(width, std::max(height, rowHeight)));
+  const bool hovered = ImGui::IsItemHovered();
+  const ImVec2 mouse = ImGui::GetIO().MousePos;
+  const Profiler::Event* hoveredEvent = nullptr;
+  drawList->AddRectFilled(origin, ImVec2(origin.x + width, origin.y + std::max(height, rowHeight)), IM_COL32(30, 30, 30, 255));
+
+  float y = origin.y;
+  for (const auto& pair : trackDepths)
+  {
+    drawList->AddText(ImVec2(origin.x + 2.0f, y), IM_COL32(200, 200, 200, 255), tracks[pair.first].name.c_str());
+    y += rowHeight;
+    for (const Profiler::Event& event : profiler_events)
+    {
+      if (event.track != pair.first || event.end < viewBegin || event.begin > viewEnd)
+      {
+        continue;
+      }
+      const float x0 = origin.x + static_cast<float>((std::max(event.begin, viewBegin) - viewBegin) / span) * width;
+      const float x1 = std::max(origin.x + static_cast<float>((std::min(event.end, viewEnd) - viewBegin) / span) * width, x0 + 1.0f);
+      const float y0 = y + event.depth * rowHeight;
+      const float hue = static_cast<float>(std::hash<std::string>()(event.name) % 360) / 360.0f;
+      drawList->AddRectFilled(ImVec2(x0, y0), ImVec2(x1, y0 + rowHeight - 1.0f), ImColor::HSV(hue, tracks[pair.first].gpu ? 0.6f : 0.4f, 0.7f));
+      if (x1 - x0 > 24.0f)
+      {
+        drawList->PushClipRect(ImVec2(x0, y0), ImVec2(x1 - 2.0f, y0 + rowHeight), true);
+        drawList->AddText(ImVec2(x0 + 2.0f, y0), IM_COL32(0, 0, 0, 255), event.name);
+        drawList->PopClipRect();
+      }
+      if (hovered && mouse.x >= x0 && mouse.x < x1 && mouse.y >= y0 && mouse.y < y0 + rowHeight)
+      {
+        hoveredEvent = &event;
+      }
+    }
+    y += pair.second * rowHeight;
+  }
+  if (hoveredEvent != nullptr)
+  {
+    ImGui::SetTooltip("%s\n%.3f ms on %s", hoveredEvent->name, (hoveredEvent->end - hoveredEvent->begin) / 1e6, tracks[hoveredEvent->track].name.c_str());
+  }
+
+  std::vector<std::pair<std::string, std::pair<std::uint32_t, std::int64_t>>> sorted(totals.begin(), totals.end());
+  std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.second.second > b.second.second; });
+  ImGui::Text("%10s %7s  %s", "ms in view", "count", "scope");
+  for (std::size_t i = 0; i < std::min<std::size_t>(sorted.size(), 12); i++)
+  {
+    ImGui::Text("%10.3f %7u  %s", sorted[i].second.second / 1e6, sorted[i].second.first, sorted[i].first.c_str());
+  }
+}
+
 void D3D12RaytracingSimpleLighting::ShutdownImGUI()
 {
   g_pd3dSrvDescHeap.Reset();
@@ -2617,12 +4550,11 @@ void D3D12RaytracingSimpleLighting::ShutdownImGUI()
 
 void D3D12RaytracingSimpleLighting::RebuildScene()
 {
+  PROFILE_SCOPE("Rebuild scene");
   // Create raytracing interfaces: raytracing device and commandlist.
   m_raytracingGlobalRootSignature.Reset();
   m_raytracingLocalRootSignature.Reset();
 
-  m_descriptorsAllocated = 0;
-  m_raytracingOutputResourceUAVDescriptorHeapIndex = UINT_MAX;
   m_indexBuffer.resource.Reset();
   m_vertexBuffer.resource.Reset();
   m_textureBuffer.resource.Reset();
@@ -2639,8 +4571,10 @@ void D3D12RaytracingSimpleLighting::RebuildScene()
 
   if (rebuild_all_resources)
   {
+    StopSequenceCapture();
     free(m_sceneLoaded);
     m_sceneLoaded = new Scene(p_sceneFileName, this); // this will load everything in the argument text file
+    ApplySceneRenderSettings();
     rebuild_all_resources = false;
   }
 
@@ -2650,6 +4584,7 @@ void D3D12RaytracingSimpleLighting::RebuildScene()
     model.second.is_m_bottomLevelAccelerationStructure_allocated = false;
     model.second.is_scratchResource_allocated = false;
     model.second.bottom_level_build_desc_allocated = false;
+    model.second.bottom_level_prebuild_info_allocated = false;
     model.second.m_bottomLevelAccelerationStructure.Reset();
     model.second.scratchResource.Reset();
   }
@@ -2676,6 +4611,7 @@ void D3D12RaytracingSimpleLighting::RebuildScene()
 
   // Build geometry to be used in the sample.
   m_sceneLoaded->AllocateResourcesInDescriptorHeap();
+  UpdateLightList();
 
   // Build raytracing acceleration structures from the generated geometry.
   BuildAccelerationStructures();
@@ -2688,6 +4624,78 @@ void D3D12RaytracingSimpleLighting::RebuildScene()
 
   // Create an output 2D texture to store the raytracing result to.
   CreateRaytracingOutputResource();
+
+  //the reservation was short and the heaps grew, handles given out before point into the old heap
+  if (m_descriptorHeapGrown)
+  {
+    RebuildScene();
+  }
+
+  WatchSceneFiles();
+}
+
+// Watches the files of the scene as it is now, what changed before counts as loaded.
+void D3D12RaytracingSimpleLighting::WatchSceneFiles()
+{
+  m_sceneLoaded->BuildDependencyGraph(p_sceneFileName, hot_reload_graph);
+  hot_reload_watcher.SetFiles(hot_reload_graph.GetFiles(), std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Imports the models and textures whose files changed again, writes their views into the
+// descriptors they had and builds the bottom levels of the models and the top level again.
+// A changed scene or GLTF file loads everything again, like Load scene.
+void D3D12RaytracingSimpleLighting::PollHotReload()
+{
+  const double now = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  //without notifications every watched file is looked at, a few times a second is plenty
+  if (!enable_hot_reload || now - hot_reload_last_poll < 0.25)
+  {
+    return;
+  }
+  hot_reload_last_poll = now;
+
+  const std::vector<std::string> changed = hot_reload_watcher.Poll(now);
+  if (changed.empty())
+  {
+    return;
+  }
+  const HotReload::ReloadPlan plan = hot_reload_graph.Resolve(changed);
+  std::stringstream status;
+  if (plan.full)
+  {
+    status << "Loading " << p_sceneFileName << " again, " << changed.size() << " files changed";
+    rebuild_all_resources = true;
+    rebuild_scene = true;
+  }
+  else if (!plan.reload.empty())
+  {
+    m_deviceResources->WaitForGpu();
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<int> reloadedModels;
+    const std::vector<std::string> errors = m_sceneLoaded->ReloadAssets(plan.reload, reloadedModels);
+    if (!reloadedModels.empty())
+    {
+      RebuildBottomLevels(reloadedModels);
+      //emissive meshes move their lights, and every info goes up with the light offsets
+      UpdateLightList();
+      //the heaps grew for the wrapped pointers, handles given out before point into the old heap
+      rebuild_scene = m_descriptorHeapGrown;
+    }
+    m_camChanged = true;
+    const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    status << "Reloaded " << plan.reload.size() - errors.size() << " of " << plan.reload.size() << " models and textures, used by "
+           << plan.affected.size() << " objects, in " << std::fixed << std::setprecision(1) << milliseconds << " ms";
+    for (const std::string& error : errors)
+    {
+      status << "\n" << error;
+    }
+  }
+  else
+  {
+    return;
+  }
+  hot_reload_status = status.str();
+  OutputDebugStringA((hot_reload_status + "\n").c_str());
 }
 
 bool D3D12RaytracingSimpleLighting::LoadModel(std::string model_path) {
@@ -2755,7 +4763,7 @@ bool D3D12RaytracingSimpleLighting::MakeEmptyObject()
   return true;
 }
 
-void D3D12RaytracingSimpleLighting::SerializeToTxt(std::string path)
+void D3D12RaytracingSimpleLighting::SerializeScene(std::string path)
 {
   std::string ma_boi_pat =
 "################################################################+++++++++++++###+#################################################\r\n"
@@ -3040,189 +5048,23 @@ void D3D12RaytracingSimpleLighting::SerializeToTxt(std::string path)
 "+#+';''++';''';;'+''+#+++++'''''';;;;;;;;;;;;;;;;;;''';;;;'''''''''''''''''++++++''''+++'++''''++++++''''''''''';;;'++++##########++++';:;;:,++++''';;;;;:\r\n"
 "'+#+''''''';''''';+++++++++'';'''';;;;;;;;;;;;;;;;';;;;''''''''''''''''''''++++'+'''++'''++++'''+'+'''''''''''''';''++++############+++';:;:,+++'';;;;:::;\r\n";
   
-  std::fstream file(path, std::ios::out | std::ios::trunc);
-  if(file)
+  SceneParser::SceneFile scene = m_sceneLoaded->BuildSceneFile();
+  // the Features panel has the last word on the path settings
+  scene.camera.max_depth = feature_depth;
+  scene.camera.russian_roulette = enable_russian_roulette;
+  scene.camera.rr_min_depth = feature_rr_min_depth;
+
+  std::string error;
+  if (!SceneFormat::WriteFile(path, scene, error))
   {
-#define LINE_ENDINGS "\n"
-    auto LINE_END = [](const std::string& string)
-    {
-      return string + LINE_ENDINGS;
-    };
-
-    std::map<int, int> model_id_map;
-    std::map<int, int> diffuse_texture_id_map;
-    std::map<int, int> normal_texture_id_map;
-    std::map<int, int> material_id_map;
-
-    file << LINE_END("+++++ MODELS +++++");
-
-    //models
-    int model_id = 0;
-    for(const auto& pair : m_sceneLoaded->modelMap)
-    {
-      int original_model_id = pair.first;
-      auto& model = pair.second;
-
-      model_id_map.insert({ original_model_id, model_id });
-
-      if(model.name.find(".gltf") == std::string::npos)
-      {
-        file << "MODEL " << model_id++ << LINE_ENDINGS;
-        file << "path " << model.name << LINE_ENDINGS;
-        file << LINE_ENDINGS;
-      }
-    }
-
-    file << LINE_END("+++++ DIFFUSE TEXTURES +++++");
-
-    //diffuse textures
-    int diffuse_texture_id = 0;
-    for (const auto& pair : m_sceneLoaded->diffuseTextureMap)
-    {
-      int original_diffuse_texture_id = pair.first;
-      auto& diffuse_texture = pair.second;
-
-      diffuse_texture_id_map.insert({ original_diffuse_texture_id, diffuse_texture_id });
-
-      if(!diffuse_texture.was_loaded_from_gltf)
-      {
-        file << "DIFFUSE_TEXTURE " << diffuse_texture_id++ << LINE_ENDINGS;
-        file << "path " << diffuse_texture.name << LINE_ENDINGS;
-        file << LINE_ENDINGS;
-      }
-    }
-
-    file << LINE_END("+++++ NORMAL TEXTURES +++++");
-
-    //normal textures
-    int normal_texture_id = 0;
-    for (const auto& pair : m_sceneLoaded->diffuseTextureMap)
-    {
-      int original_normal_texture_id = pair.first;
-      auto& normal_texture = pair.second;
-
-      normal_texture_id_map.insert({ original_normal_texture_id, normal_texture_id });
-
-      if (!normal_texture.was_loaded_from_gltf)
-      {
-        file << "NORMAL_TEXTURE " << normal_texture_id++ << LINE_ENDINGS;
-        file << "path " << normal_texture.name << LINE_ENDINGS;
-        file << LINE_ENDINGS;
-      }
-    }
-
-    file << LINE_END("+++++ MATERIALS +++++");
-
-#define STREAM_WIDTH (16)
-#define FORMAT_LEFT std::left << std::setfill(' ') << std::setw(STREAM_WIDTH)
-
-    //material
-    int material_id = 0;
-    for (const auto& pair : m_sceneLoaded->materialMap)
-    {
-      int original_material_id = pair.first;
-      auto& material = pair.second;
-
-      material_id_map.insert({ original_material_id, material_id });
-
-      if (!material.was_loaded_from_gltf)
-      {
-        file << "MATERIAL " << material_id++ << " " << material.name << LINE_ENDINGS;
-        file << FORMAT_LEFT << "RGB" << material.material.diffuse.x << " " << material.material.diffuse.y << " " << material.material.diffuse.z << LINE_ENDINGS;
-        file << FORMAT_LEFT << "SPECRGB" << material.material.specular.x << " " << material.material.specular.y << " " << material.material.specular.z << LINE_ENDINGS;
-        file << FORMAT_LEFT << "SPECEX" << material.material.specularExp << LINE_ENDINGS;
-        file << FORMAT_LEFT << "REFL" << material.material.reflectiveness << LINE_ENDINGS;
-        file << FORMAT_LEFT << "REFR" << material.material.refractiveness << LINE_ENDINGS;
-        file << FORMAT_LEFT << "ETA" << material.material.eta << LINE_ENDINGS;
-        file << FORMAT_LEFT << "EMITTANCE" << material.material.emittance << LINE_ENDINGS;
-        file << LINE_ENDINGS;
-      }
-    }
-
-    file << LINE_END("+++++ OBJECTS +++++");
-
-    int object_id = 0;
-    for (const auto& object : m_sceneLoaded->objects)
-    {
-      if (object.name.find(".gltf") == std::string::npos)
-      {
-        file << FORMAT_LEFT << "OBJECT" << object_id++ << " " << object.name << LINE_ENDINGS;
-
-        if (object.model == nullptr)
-        {
-          file << FORMAT_LEFT << "MODEL" << " -1" << LINE_ENDINGS;
-        }
-        else
-        {
-          file << FORMAT_LEFT << "MODEL" << model_id_map[object.model->id] << LINE_ENDINGS;
-        }
-
-        if (object.textures.albedoTex == nullptr)
-        {
-          file << FORMAT_LEFT << "DIFFUSE_TEX" << " -1" << LINE_ENDINGS;
-        }
-        else
-        {
-          file << FORMAT_LEFT << "DIFFUSE_TEX" << model_id_map[object.textures.albedoTex->id] << LINE_ENDINGS;
-        }
-
-        if (object.textures.normalTex == nullptr)
-        {
-          file << FORMAT_LEFT << "NORMAL_TEX" << " -1" << LINE_ENDINGS;
-        }
-        else
-        {
-          file << FORMAT_LEFT << "NORMAL_TEX" << model_id_map[object.textures.normalTex->id] << LINE_ENDINGS;
-        }
-
-        if (object.material == nullptr)
-        {
-          file << FORMAT_LEFT << "MATERIAL" << " -1" << LINE_ENDINGS;
-        }
-        else
-        {
-          file << FORMAT_LEFT << "MATERIAL" << model_id_map[object.material->id] << LINE_ENDINGS;
-        }
-
-        //transformations
-        file << FORMAT_LEFT << "trans" << object.translation.x << " " << object.translation.y << " " << object.translation.z << LINE_ENDINGS;
-        file << FORMAT_LEFT << "rotat" << object.rotation.x << " " << object.rotation.y << " " << object.rotation.z << LINE_ENDINGS;
-        file << FORMAT_LEFT << "scale" << object.scale.x << " " << object.scale.y << " " << object.scale.z << LINE_ENDINGS;
-
-        file << LINE_ENDINGS;
-      }
-    }
-
-    file << LINE_END("+++++ GLTFS +++++");
-
-    for (const auto& pair : m_sceneLoaded->modelMap)
-    {
-      auto& model = pair.second;
-
-      if (model.name.find(".gltf") != std::string::npos)
-      {
-        file << "GLTF " << model.name << LINE_ENDINGS;
-        file << LINE_ENDINGS;
-      }
-    }
-
-    XMFLOAT3 xm_eye;
-    XMFLOAT3 xm_look_at;
-    XMFLOAT3 xm_up;
-
-    XMStoreFloat3(&xm_eye, m_sceneLoaded->camera.eye);
-    XMStoreFloat3(&xm_look_at, m_sceneLoaded->camera.lookat);
-    XMStoreFloat3(&xm_up, m_sceneLoaded->camera.up);
-
-    file << LINE_END("+++++ CAMERA +++++");
-    file << LINE_END("CAMERA");
-    file << FORMAT_LEFT << "fov" << m_sceneLoaded->camera.fov << LINE_ENDINGS;
-    file << FORMAT_LEFT << "eye " << xm_eye.x << " " << xm_eye.y << " " << xm_eye.z << LINE_ENDINGS;
-    file << FORMAT_LEFT << "lookat " << xm_look_at.x << " " << xm_look_at.y << " " << xm_look_at.z << LINE_ENDINGS;
-    file << FORMAT_LEFT << "up " << xm_up.x << " " << xm_up.y << " " << xm_up.z << LINE_ENDINGS;
-    file << FORMAT_LEFT << "depth " << feature_depth << LINE_ENDINGS;
+    OutputDebugStringA(("Save scene: " + error + "\n").c_str());
+    return;
+  }
 
-    file << LINE_END("+++++ IT'S MA BOIS +++++");
+  if (SceneFormat::GetEncoding(path) == SceneFormat::Encoding::Text)
+  {
+    std::ofstream file(path, std::ios::binary | std::ios::app);
+    file << "\n+++++ IT'S MA BOIS +++++\n";
     file << ma_boi_pat;
     file << ma_boi_shehzan;
   }
@@ -3230,7 +5072,9 @@ void D3D12RaytracingSimpleLighting::SerializeToTxt(std::string path)
 
 void D3D12RaytracingSimpleLighting::PreSaveImage()
 {
-  if(save_image)
+  //only one readback in flight, PostSaveImage picks it up once its frame retires.
+  //the accumulation holds a single tile while a tiled render runs, that one writes its own image
+  if(save_image && !save_image_pending && !tiled_render_job.IsActive())
   {
     if (save_image_resource != nullptr)
     {
@@ -3239,10 +5083,10 @@ void D3D12RaytracingSimpleLighting::PreSaveImage()
 
     auto device = m_deviceResources->GetD3DDevice();
     auto commandList = m_deviceResources->GetCommandList();
-    auto commandAllocator = m_deviceResources->GetCommandAllocator();
-    auto renderTarget = m_deviceResources->GetRenderTarget();
 
-    D3D12_RESOURCE_DESC desc = renderTarget->GetDesc();
+    //the float sums and sample counts, not the clamped output, so exr and hdr keep the full range
+    ID3D12Resource* accumulation = ResolveAccumulation();
+    D3D12_RESOURCE_DESC desc = accumulation->GetDesc();
 
     UINT64 totalResourceSize = 0;
     UINT64 fpRowPitch = 0;
@@ -3261,7 +5105,9 @@ void D3D12RaytracingSimpleLighting::PreSaveImage()
 
     // Round up the srcPitch to multiples of 256
     UINT64 dstRowPitch = (fpRowPitch + 255) & ~0xFF;
-    save_image_row_pitch = dstRowPitch;
+    save_image_row_pitch = static_cast<UINT>(dstRowPitch);
+    save_image_width = static_cast<UINT>(desc.Width);
+    save_image_height = desc.Height;
 
     D3D12_RESOURCE_DESC bufferDesc = {};
     bufferDesc.Alignment = desc.Alignment;
@@ -3283,6 +5129,7 @@ void D3D12RaytracingSimpleLighting::PreSaveImage()
       D3D12_RESOURCE_STATE_COPY_DEST,
       nullptr,
       IID_PPV_ARGS(&save_image_resource)));
+    NAME_D3D12_OBJECT(save_image_resource);
 
     // Get the copy target location
     D3D12_PLACED_SUBRESOURCE_FOOTPRINT bufferFootprint = {};
@@ -3293,96 +5140,65 @@ void D3D12RaytracingSimpleLighting::PreSaveImage()
     bufferFootprint.Footprint.Format = desc.Format;
 
     CD3DX12_TEXTURE_COPY_LOCATION copyDest(save_image_resource.Get(), bufferFootprint);
-    CD3DX12_TEXTURE_COPY_LOCATION copySrc(renderTarget, 0);
+    CD3DX12_TEXTURE_COPY_LOCATION copySrc(accumulation, 0);
 
-    D3D12_RESOURCE_BARRIER preCopyBarriers[1];
-    preCopyBarriers[0] = CD3DX12_RESOURCE_BARRIER::Transition(renderTarget, D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_COPY_SOURCE);
-    commandList->ResourceBarrier(ARRAYSIZE(preCopyBarriers), preCopyBarriers);
+    D3D12_RESOURCE_BARRIER preCopyBarrier = CD3DX12_RESOURCE_BARRIER::Transition(accumulation, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    commandList->ResourceBarrier(1, &preCopyBarrier);
 
     commandList->CopyTextureRegion(&copyDest, 0, 0, 0, &copySrc, nullptr);
 
-    D3D12_RESOURCE_BARRIER postCopyBarriers[1];
-    postCopyBarriers[0] = CD3DX12_RESOURCE_BARRIER::Transition(renderTarget, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_RENDER_TARGET);
-    commandList->ResourceBarrier(ARRAYSIZE(postCopyBarriers), postCopyBarriers);
+    D3D12_RESOURCE_BARRIER postCopyBarrier = CD3DX12_RESOURCE_BARRIER::Transition(accumulation, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    commandList->ResourceBarrier(1, &postCopyBarrier);
 
     UINT64 imageSize = dstRowPitch * UINT64(desc.Height);
     readRange = { 0, static_cast<SIZE_T>(imageSize) };
     writeRange = { 0, 0 };
+
+    save_image_pending = true;
+    save_image_fence_value = 0;
   }
 }
 
 void D3D12RaytracingSimpleLighting::PostSaveImage()
 {
-  if (save_image)
+  //the copy was recorded in an earlier frame, don't block on it, just check the fence
+  if (save_image && save_image_pending && save_image_fence_value != 0)
   {
-    if(!save_image_path.empty())
+    if (!m_deviceResources->IsFenceComplete(save_image_fence_value))
     {
-      auto device = m_deviceResources->GetD3DDevice();
-      auto commandList = m_deviceResources->GetCommandList();
-      auto commandAllocator = m_deviceResources->GetCommandAllocator();
-      auto renderTarget = m_deviceResources->GetRenderTarget();
-
-      D3D12_RESOURCE_DESC desc = renderTarget->GetDesc();
+      return;
+    }
 
+    if(!save_image_path.empty())
+    {
       void* mapped_data;
-      save_image_resource->Map(0, &readRange, &mapped_data);
-
-      //https://stackoverflow.com/questions/30021274/capture-screen-using-directx/30125325
-#define WIDEN2(x) L ## x
-#define WIDEN(x) WIDEN2(x)
-#define __WFILE__ WIDEN(__FILE__)
-#define HRCHECK(__expr) {hr=(__expr);if(FAILED(hr)){wprintf(L"FAILURE 0x%08X (%i)\n\tline: %u file: '%s'\n\texpr: '" WIDEN(#__expr) L"'\n",hr, hr, __LINE__,__WFILE__);goto cleanup;}}
-#define RELEASE(__p) {if(__p!=nullptr){__p->Release();__p=nullptr;}}
-      auto SavePixelsToFile32bppPBGRA = [](UINT width, UINT height, UINT stride, LPBYTE pixels, LPWSTR filePath, const GUID &format)
-      {
-        if (!filePath || !pixels)
-          return E_INVALIDARG;
-
-        HRESULT hr = S_OK;
-        IWICImagingFactory *factory = nullptr;
-        IWICBitmapEncoder *encoder = nullptr;
-        IWICBitmapFrameEncode *frame = nullptr;
-        IWICStream *stream = nullptr;
-        GUID pf = GUID_WICPixelFormat32bppPBGRA;
-        BOOL coInit = CoInitialize(nullptr);
-
-        HRCHECK(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory)));
-        HRCHECK(factory->CreateStream(&stream));
-        HRCHECK(stream->InitializeFromFilename(filePath, GENERIC_WRITE));
-        HRCHECK(factory->CreateEncoder(format, nullptr, &encoder));
-        HRCHECK(encoder->Initialize(stream, WICBitmapEncoderNoCache));
-        HRCHECK(encoder->CreateNewFrame(&frame, nullptr)); // we don't use options here
-        HRCHECK(frame->Initialize(nullptr)); // we dont' use any options here
-        HRCHECK(frame->SetSize(width, height));
-        HRCHECK(frame->SetPixelFormat(&pf));
-        HRCHECK(frame->WritePixels(height, stride, stride * height, pixels));
-        HRCHECK(stream->Commit(STGC_OVERWRITE));
-        HRCHECK(frame->Commit());
-        HRCHECK(encoder->Commit());
-
-      cleanup:
-        RELEASE(stream);
-        RELEASE(frame);
-        RELEASE(encoder);
-        RELEASE(factory);
-        if (coInit) CoUninitialize();
-        return hr;
-      };
-
-      //flip r and b? (dunno why they are flipped)
-      for (int i = 0; i < desc.Width * desc.Height; i++)
-      {
-        char* data = (char*)mapped_data;
-        std::swap(data[i * sizeof(float)], data[i * sizeof(float) + 2]);
-      }
-
-      SavePixelsToFile32bppPBGRA((UINT)desc.Width, (UINT)desc.Height, (UINT)save_image_row_pitch, (LPBYTE)mapped_data, (LPWSTR)utilityCore::string2wstring(save_image_path).c_str(), GUID_ContainerFormatBmp);
+      ThrowIfFailed(save_image_resource->Map(0, &readRange, &mapped_data));
+
+      //only the copy out of the upload heap happens on this thread, the worker resolves,
+      //converts, encodes and writes
+      const size_t rowFloats = size_t(save_image_width) * 4;
+      std::vector<float> accumulation(rowFloats * save_image_height);
+      for (UINT y = 0; y < save_image_height; y++)
+      {
+        memcpy(accumulation.data() + y * rowFloats, static_cast<const BYTE*>(mapped_data) + size_t(y) * save_image_row_pitch, rowFloats * sizeof(float));
+      }
 
       save_image_resource->Unmap(0, &writeRange);
 
+      image_writer.Submit(save_image_path, std::move(accumulation), save_image_width, save_image_height, save_image_options);
+
       save_image = false;
       save_image_path = std::string{};
     }
+
+    save_image_pending = false;
+    save_image_fence_value = 0;
+  }
+
+  //the UI shows the last image the worker finished
+  while (image_writer.PopResult(image_writer_last_result))
+  {
+    image_writer_has_result = true;
   }
 }
 
@@ -3421,6 +5237,8 @@ void D3D12RaytracingSimpleLighting::LoadSplitImage()
     {
       if(split_image_resource != nullptr)
       {
+        //earlier frames still in flight may be copying from it, only happens on reload
+        m_deviceResources->WaitForGpu();
         split_image_resource.Reset();
       }
 
@@ -3537,79 +5355,3 @@ void D3D12RaytracingSimpleLighting::LoadSplitImage()
   }
 }
 
-int D3D12RaytracingSimpleLighting::GetHeapOffsetForVertices()
-{
-  return vertex_offset++;
-}
-
-int D3D12RaytracingSimpleLighting::GetHeapOffsetForIndices()
-{
-  return indices_offset++;
-}
-
-int D3D12RaytracingSimpleLighting::GetHeapOffsetForObjects()
-{
-  return objects_offset++;
-}
-
-int D3D12RaytracingSimpleLighting::GetHeapOffsetForMaterials()
-{
-  return materials_offset++;
-}
-
-int D3D12RaytracingSimpleLighting::GetHeapOffsetForDiffuseTextures()
-{
-  return diffuse_textures_offset++;
-}
-
-int D3D12RaytracingSimpleLighting::GetHeapOffsetForNormalTextures()
-{
-  return normal_textures_offset++;
-}
-
-void D3D12RaytracingSimpleLighting::ResetHeapOffsets()
-{
-  vertex_offset = VERTEX_HEAP_OFFSET;
-  indices_offset = INDICIES_HEAP_OFFSET;
-  objects_offset = OBJECTS_HEAP_OFFSET;
-  materials_offset = MATERIALS_HEAP_OFFSET;
-  diffuse_textures_offset = DIFFUSE_TEXTURES_HEAP_OFFSET;
-  normal_textures_offset = NORMAL_TEXTURES_HEAP_OFFSET;
-}
-
-int D3D12RaytracingSimpleLighting::AllocateHeapDescriptorType(D3D12_CPU_DESCRIPTOR_HANDLE* cpuDescriptor, UINT descriptorIndexToUse, HeapDescriptorOffsetType offset_type)
-{
-  switch (offset_type)
-  {
-  case HeapDescriptorOffsetType::NONE:
-    {
-      return AllocateDescriptor(cpuDescriptor, descriptorIndexToUse);
-    }
-  case HeapDescriptorOffsetType::VERTEX:
-    {
-      return AllocateDescriptor(cpuDescriptor, GetHeapOffsetForVertices());
-    }
-  case HeapDescriptorOffsetType::INDICES:
-    {
-      return AllocateDescriptor(cpuDescriptor, GetHeapOffsetForIndices());
-    }
-  case HeapDescriptorOffsetType::OBJECTS:
-    {
-      return AllocateDescriptor(cpuDescriptor, GetHeapOffsetForObjects());
-    }
-  case HeapDescriptorOffsetType::MATERIALS:
-    {
-      return AllocateDescriptor(cpuDescriptor, GetHeapOffsetForMaterials());
-    }
-  case HeapDescriptorOffsetType::DIFFUSE_TEXTURES:
-    {
-      return AllocateDescriptor(cpuDescriptor, GetHeapOffsetForDiffuseTextures());
-    }
-  case HeapDescriptorOffsetType::NORMAL_TEXTURES:
-    {
-      return AllocateDescriptor(cpuDescriptor, GetHeapOffsetForNormalTextures());
-    }
-  default: return AllocateDescriptor(cpuDescriptor, descriptorIndexToUse);
-  }
-}
-
@@ -14,7 +14,19 @@
 #include "DXSample.h"
 #include "StepTimer.h"
 #include "shaders/RaytracingHlslCompat.h"
+#include "shaders/SamplingHlslCompat.h"
+#include "shaders/DenoiseHlslCompat.h"
+#include "shaders/AccumulationHlslCompat.h"
+#include "shaders/RayStatsHlslCompat.h"
 #include "Scene.h"
+#include "AdaptiveSampler.h"
+#include "TiledRender.h"
+#include "ImageWriter.h"
+#include "SequenceCapture.h"
+#include "ShaderPermutation.h"
+#include "ShaderCompiler.h"
+#include "DescriptorAllocator.h"
+#include "GpuProfiler.h"
 
 
 namespace GlobalRootSignatureParams {
@@ -28,6 +40,11 @@ namespace GlobalRootSignatureParams {
         IndexBuffersSlot,
         MaterialBuffersSlot,
         InfoBuffersSlot,
+        ActiveTilesSlot,
+        TileErrorsSlot,
+        LightsSlot,
+        PathStatsSlot,
+        VertexAttributesSlot,
         Count 
     };
 }
@@ -39,6 +56,14 @@ namespace LocalRootSignatureParams {
     };
 }
 
+namespace DenoiseRootSignatureParams {
+    enum Value {
+        ConstantsSlot = 0,
+        ViewsSlot,
+        Count
+    };
+}
+
 // The sample supports both Raytracing Fallback Layer and DirectX Raytracing APIs. 
 // This is purely for demonstration purposes to show where the API differences are. 
 // Real-world applications will implement only one or the other. 
@@ -71,9 +96,12 @@ public:
 	// Public variables
 	std::string p_sceneFileName;
 
-	UINT CreateBufferSRV(D3DBuffer* buffer, UINT numElements, UINT elementSize);
+	UINT CreateBufferSRV(D3DBuffer* buffer, UINT numElements, UINT elementSize, UINT descriptorIndex = UINT_MAX);
 
-	UINT AllocateDescriptor(D3D12_CPU_DESCRIPTOR_HANDLE* cpuDescriptor, UINT descriptorIndexToUse = UINT_MAX);
+	UINT AllocateDescriptor(D3D12_CPU_DESCRIPTOR_HANDLE* cpuDescriptor, DescriptorAllocator::Range range, UINT count = 1);
+	D3D12_CPU_DESCRIPTOR_HANDLE GetDescriptorForWriting(UINT descriptorIndex);
+	UINT GetDescriptorIndex(D3D12_GPU_DESCRIPTOR_HANDLE gpuDescriptor) const;
+	void CommitDescriptors();
 
 	ID3D12Resource* GetTextureBufferUploadHeap() {
 		return textureBufferUploadHeap;
@@ -87,6 +115,10 @@ public:
 		return &m_descriptorSize;
 	}
 
+	const DescriptorAllocator::Allocator& GetDescriptorAllocator() const {
+		return m_descriptorAllocator;
+	}
+
       WRAPPED_GPU_POINTER CreateFallbackWrappedPointer(ID3D12Resource* resource, UINT bufferNumElements);
       void UpdateCameraMatrices();
 
@@ -120,10 +152,17 @@ private:
     ComPtr<ID3D12RootSignature> m_raytracingGlobalRootSignature;
     ComPtr<ID3D12RootSignature> m_raytracingLocalRootSignature;
 
-    // Descriptors
+    // Descriptors, views are written to the CPU only staging heap and copied to the
+    // shader visible heap by CommitDescriptors before it is bound
     ComPtr<ID3D12DescriptorHeap> m_descriptorHeap;
-    UINT m_descriptorsAllocated;
+    ComPtr<ID3D12DescriptorHeap> m_descriptorStagingHeap;
+    DescriptorAllocator::Allocator m_descriptorAllocator;
     UINT m_descriptorSize;
+    UINT m_dirtyDescriptorsBegin = UINT_MAX;
+    UINT m_dirtyDescriptorsEnd = 0;
+    bool m_descriptorHeapGrown = false;
+    void EnsureDescriptorHeapCapacity();
+    void ReleaseOutputDescriptors();
     
     // Raytracing scene
 	Scene* m_sceneLoaded;
@@ -147,9 +186,96 @@ private:
     D3D12_GPU_DESCRIPTOR_HANDLE m_raytracingOutputResourceUAVGpuDescriptor;
     UINT m_raytracingOutputResourceUAVDescriptorHeapIndex;
 
-    //pathtracing accumulator
+    //pathtracing accumulator in one of the formats of AccumulationHlslCompat.h, the
+    //compensation only exists for Half. The raygen shader starts the sums over on the
+    //first dispatch after a reset, counted by accumulation_dispatches.
     ComPtr<ID3D12Resource> pathtracing_accumulation_resource;
-    ComPtr<ID3D12Resource> cure_epilepsy;
+    ComPtr<ID3D12Resource> pathtracing_second_moment_resource;
+    ComPtr<ID3D12Resource> pathtracing_compensation_resource;
+    UINT accumulation_format = Accumulation::AccumulationFloat32;
+    UINT accumulation_format_requested = Accumulation::AccumulationFloat32;
+    bool accumulation_format_fallback = false;
+    UINT accumulation_dispatches = 0;
+
+    //denoiser, the guides are accumulated by the raygen shader next to the color and
+    //follow it in the output descriptor table: albedo and depth, normal, then the
+    //features and the two filter buffers of Denoise.hlsl
+    ComPtr<ID3D12Resource> denoiser_albedo_depth;
+    ComPtr<ID3D12Resource> denoiser_normal;
+    ComPtr<ID3D12Resource> denoiser_features;
+    ComPtr<ID3D12Resource> denoiser_filter_buffers[2];
+    ComPtr<ID3D12RootSignature> denoiser_root_signature;
+    ComPtr<ID3D12PipelineState> denoiser_pipeline;
+
+    //adaptive sampling, the tile list is uploaded and the tile errors read back per frame
+    AdaptiveSampler adaptive_sampler;
+    ComPtr<ID3D12Resource> adaptive_tile_errors;
+    ComPtr<ID3D12Resource> adaptive_tile_errors_zero;
+    ComPtr<ID3D12Resource> adaptive_tile_errors_readback;
+    ComPtr<ID3D12Resource> adaptive_active_tiles;
+    UINT* adaptive_mapped_active_tiles = nullptr;
+    UINT adaptive_epoch = 0;
+    UINT adaptive_readback_epoch[FrameCount] = {};
+    bool adaptive_readback_pending[FrameCount] = {};
+
+    //emissive triangles for next event estimation, rebuilt when objects or materials change
+    ComPtr<ID3D12Resource> light_list_resource;
+    bool light_list_dirty = false;
+
+    //path statistics (paths, segments and with RayStatistics the rest of RayStatsHlslCompat.h),
+    //read back per frame like the tile errors
+    ComPtr<ID3D12Resource> path_stats;
+    ComPtr<ID3D12Resource> path_stats_zero;
+    ComPtr<ID3D12Resource> path_stats_readback;
+    bool path_stats_pending[FrameCount] = {};
+    int path_stats_benchmark_phase[FrameCount] = {};
+    UINT64 path_stats_counters[RayStats::RayStatCount] = {}; //summed until CalculateFrameStats takes them
+    UINT64 ray_stats[RayStats::RayStatCount] = {};           //what the last second counted
+    double ray_stats_seconds = 0.0;
+    float average_path_length = 0.0f;
+    float frame_time_ms = 0.0f;
+
+    //russian roulette on/off benchmark, -1 when idle, 0 while measuring without and 1 with
+    int rr_benchmark_phase = -1;
+    UINT rr_benchmark_frames = 0;
+    UINT rr_benchmark_saved_features = 0;
+    double rr_benchmark_seconds[2] = {};
+    UINT64 rr_benchmark_paths[2] = {};
+    UINT64 rr_benchmark_segments[2] = {};
+    std::string rr_benchmark_report{};
+
+    //tiled offline rendering, one tile of the target image is accumulated at a time in the
+    //top left of the output and read back into the job once it has all of its samples
+    TiledRender::Settings tiled_render_settings;
+    TiledRender::Job tiled_render_job;
+    TiledRender::Tile tiled_render_tile;
+    bool tiled_render_tile_active = false;
+    UINT tiled_render_tile_samples = 0;
+    ComPtr<ID3D12Resource> tiled_render_readback;
+    UINT tiled_render_readback_row_pitch = 0;
+    TiledRender::Tile tiled_render_readback_tile;
+    bool tiled_render_readback_pending = false;
+    UINT64 tiled_render_readback_fence_value = 0;
+    std::string tiled_render_status{};
+
+    //sequence capture of the camera path, see SequenceCapture.h
+    SequenceCapture::Settings capture_settings;
+    SequenceCapture::Capture sequence_capture;
+    ComPtr<ID3D12Resource> capture_readbacks[SequenceCapture::MAX_READBACK_SLOTS];
+    UINT capture_readback_row_pitch = 0;
+    UINT capture_frame_samples = 0;
+    int capture_camera_frame = -1;
+    ModelLoading::Camera capture_saved_camera;
+    std::string capture_status{};
+
+    //shader permutations, see ShaderPermutation.h. The library of the active permutation
+    //is empty while the one the build compiled in is used.
+    bool enable_shader_permutations = true;
+    bool shader_permutation_enabled = false; // enable_shader_permutations when the pipeline was built
+    std::uint32_t shader_permutation = ShaderPermutation::PermutationAll;
+    std::vector<std::uint8_t> shader_permutation_library;
+    ShaderCompiler shader_compiler;
+    std::string shader_permutation_status{};
 
     // Shader tables
     static const wchar_t* c_hitGroupName;
@@ -176,6 +302,7 @@ private:
 	static const float c_movementAmountFactor;
 
 	static const unsigned int c_maxIteration;
+	static const unsigned int c_rrBenchmarkFrames;
 
     void EnableDirectXRaytracing(IDXGIAdapter1* adapter);
     void ParseCommandLineArgs(WCHAR* argv[], int argc);
@@ -192,15 +319,40 @@ private:
     void CreateRootSignatures();
     void CreateLocalRootSignatureSubobjects(CD3D12_STATE_OBJECT_DESC* raytracingPipeline);
     void CreateRaytracingPipelineStateObject();
+    std::uint32_t GetRequiredShaderPermutation() const;
+    bool LoadShaderPermutation(std::uint32_t permutation);
+    void UpdateShaderPermutation();
     void CreateDescriptorHeap();
     void CreateRaytracingOutputResource();
+    bool IsAccumulationFormatSupported(UINT format);
+    ID3D12Resource* ResolveAccumulation();
     void BuildGeometry();
     void BuildAccelerationStructures();
+    void RebuildBottomLevels(const std::vector<int>& modelIds);
     void BuildShaderTables();
     void SelectRaytracingAPI(RaytracingAPI type);
     void UpdateForSizeChange(UINT clientWidth, UINT clientHeight);
     void CopyRaytracingOutputToBackbuffer();
     void CalculateFrameStats();
+    void CreateAdaptiveSamplingResources();
+    void UpdateAdaptiveSampling();
+    void UpdateLightList();
+    void ApplySceneRenderSettings();
+    void CreatePathStatisticsResources();
+    void UpdatePathStatistics();
+    void StartRussianRouletteBenchmark();
+    void UpdateRussianRouletteBenchmark(double elapsedSeconds);
+    void StartTiledRender();
+    void StopTiledRender();
+    void UpdateTiledRender();
+    void ReadBackTiledRenderTile();
+    void ResolveTiledRenderTile(bool wait);
+    void StartSequenceCapture();
+    void StopSequenceCapture();
+    void UpdateSequenceCapture();
+    void ReadBackSequenceFrame();
+    void CreateDenoiserPipeline();
+    void Denoise();
 
     //IMGUI stuff
 #define HEAP_DESCRIPTOR_SIZE (10000)
@@ -219,17 +371,65 @@ private:
     bool rebuild_scene = false;
 
     void RebuildScene();
+
+    // Hot reload of the scene files, see HotReload.h
+    HotReload::RealFileSystem hot_reload_file_system;
+    HotReload::Watcher hot_reload_watcher{ hot_reload_file_system };
+    HotReload::DependencyGraph hot_reload_graph;
+    bool enable_hot_reload = true;
+    double hot_reload_last_poll = 0.0;
+    std::string hot_reload_status;
+    void WatchSceneFiles();
+    void PollHotReload();
+
+    // Profiler, see Profiler.h. The flame view shows the last profiler_view_milliseconds
+    // before the current frame, Export trace writes what was loaded at startup and the
+    // last profiler_history_seconds.
+    GpuProfiler gpu_profiler;
+    std::vector<Profiler::Event> profiler_events;
+    std::vector<Profiler::Event> profiler_startup_events;
+    bool profiler_startup_collected = false;
+    bool profiler_paused = false;
+    float profiler_view_milliseconds = 100.0f;
+    float profiler_history_seconds = 10.0f;
+    std::int64_t profiler_frame_begin = 0;
+    std::int64_t profiler_view_end = 0;
+    std::string profiler_status;
+    void CollectProfilerEvents();
+    void ShowProfilerFlameView();
+    bool ExportProfilerTrace(const std::string& path);
+
+    // Scene statistics, see SceneStats.h. Built again when the panel is open after the
+    // acceleration structures were.
+    SceneStats::Report scene_stats;
+    bool scene_stats_valid = false;
+    std::string scene_stats_status;
+    // fallback layer only, OnRender reads the acceleration structures back before the frame
+    bool bvh_analysis_requested = false;
+
     bool LoadModel(std::string model_path);
     bool LoadDiffuseTexture(std::string diffuse_texture_path);
     bool LoadNormalTexture(std::string normal_texture_path);
     bool MakeEmptyMaterial();
     bool MakeEmptyObject();
-    void SerializeToTxt(std::string path);
+    void SerializeScene(std::string path);
 
     //features
     bool enable_anti_aliasing = true;
     bool enable_depth_of_field = false;
+    bool enable_next_event_estimation = true;
+    bool enable_russian_roulette = true;
+    bool enable_ray_statistics = false;
+    UINT feature_rr_min_depth = 3;
     UINT feature_depth = 5;
+    UINT feature_samples_per_launch = 1;
+    UINT feature_sampler = Sampling::SobolSampler;
+    bool enable_adaptive_sampling = false;
+    float adaptive_threshold = 0.05f;
+    UINT adaptive_min_samples = 32;
+    bool enable_denoiser = false;
+    UINT denoiser_iterations = Denoiser::DENOISE_MAX_ITERATIONS;
+    float denoiser_sigma_luminance = Denoiser::DENOISE_DEFAULT_SIGMA_LUMINANCE;
 
     //image loading/saving
     bool save_image = false;
@@ -237,8 +437,16 @@ private:
 
     ComPtr<ID3D12Resource> save_image_resource;
     UINT save_image_row_pitch = 0;
+    UINT save_image_width = 0;
+    UINT save_image_height = 0;
+    bool save_image_pending = false;
+    UINT64 save_image_fence_value = 0;
     D3D12_RANGE readRange = { 0, 0 };
     D3D12_RANGE writeRange = { 0, 0 };
+    ImageWriter::Options save_image_options;
+    ImageWriter::AsyncWriter image_writer;
+    ImageWriter::AsyncWriter::Result image_writer_last_result;
+    bool image_writer_has_result = false;
 
     bool load_split_image = false;
     std::string split_image_path{};
@@ -255,40 +463,4 @@ private:
 
     //stop/resume rendering
     bool enable_rendering = true;
-
-#define VERTEX_HEAP_OFFSET (1000)
-#define INDICIES_HEAP_OFFSET (2000)
-#define OBJECTS_HEAP_OFFSET (3000)
-#define MATERIALS_HEAP_OFFSET (4000)
-#define DIFFUSE_TEXTURES_HEAP_OFFSET (5000)
-#define NORMAL_TEXTURES_HEAP_OFFSET (6000)
-
-    int vertex_offset = VERTEX_HEAP_OFFSET;
-    int indices_offset = INDICIES_HEAP_OFFSET;
-    int objects_offset = OBJECTS_HEAP_OFFSET;
-    int materials_offset = MATERIALS_HEAP_OFFSET;
-    int diffuse_textures_offset = DIFFUSE_TEXTURES_HEAP_OFFSET;
-    int normal_textures_offset = NORMAL_TEXTURES_HEAP_OFFSET;
-
-public:
-    int GetHeapOffsetForVertices();
-    int GetHeapOffsetForIndices();
-    int GetHeapOffsetForObjects();
-    int GetHeapOffsetForMaterials();
-    int GetHeapOffsetForDiffuseTextures();
-    int GetHeapOffsetForNormalTextures();
-    void ResetHeapOffsets();
-
-    enum class HeapDescriptorOffsetType
-    {
-      NONE,
-      VERTEX,
-      INDICES,
-      OBJECTS,
-      MATERIALS,
-      DIFFUSE_TEXTURES,
-      NORMAL_TEXTURES
-    };
-
-    int AllocateHeapDescriptorType(D3D12_CPU_DESCRIPTOR_HANDLE* cpuDescriptor, UINT descriptorIndexToUse, HeapDescriptorOffsetType offset_type);
 };
@@ -0,0 +1,395 @@
+#include "Denoiser.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+namespace Denoiser {
+
+namespace {
+
+// Pixels the a-trous pass filters at once, its accumulators fit in the L1 cache.
+const unsigned int c_blockWidth = 64;
+
+// The guides and the two filter buffers, one plane per channel.
+struct Planes
+{
+  std::vector<float> normal_x, normal_y, normal_z;
+  std::vector<float> depth;
+  std::vector<float> depth_gradient;
+  std::vector<float> albedo_r, albedo_g, albedo_b; // what the illumination is divided by
+  std::vector<float> red[2], green[2], blue[2], variance[2];
+  std::vector<float> luminance; // of the buffer the current pass reads
+  std::vector<float> deviation; // prefiltered standard deviation of the same buffer
+};
+
+inline float FromBits(std::int32_t bits)
+{
+  float x;
+  std::memcpy(&x, &bits, sizeof(x));
+  return x;
+}
+
+inline std::int32_t ToBits(float x)
+{
+  std::int32_t bits;
+  std::memcpy(&bits, &x, sizeof(bits));
+  return bits;
+}
+
+// exp2 and log2 without calls into the math library, branches or float to int
+// conversions, so the tap loops vectorize. The shader uses the hardware versions.
+// Relative error below 3e-7 for x in [-125, 0]: adding 1.5 * 2^23 rounds x to an
+// integer that ends up in the low mantissa bits, a polynomial covers the rest.
+inline float FastExp2(float x)
+{
+  x = std::max(x, -125.0f);
+  const float shifted = x + 12582912.0f;
+  const float whole = shifted - 12582912.0f;
+  const float f = x - whole;
+  const float fraction = 1.0f + f * (0.693147182f + f * (0.240226507f + f * (0.0555041087f + f * (0.00961812911f + f * (0.00133335581f + f * 0.000154035304f)))));
+  return fraction * FromBits((ToBits(shifted) - 0x4b400000 + 127) << 23);
+}
+
+// Absolute error below 3e-6 for positive normal floats.
+inline float FastLog2(float x)
+{
+  const std::int32_t bits = ToBits(x);
+  const float exponent = FromBits((bits >> 23) | 0x4b000000) - 8388735.0f; // 2^23 + 127
+  const float mantissa = FromBits((bits & 0x007fffff) | 0x3f800000);
+
+  // log2(m) = 2 / ln(2) * atanh(u) with u = (m - 1) / (m + 1) in [0, 1/3)
+  const float u = (mantissa - 1.0f) / (mantissa + 1.0f);
+  const float u2 = u * u;
+  const float series = u * (1.0f + u2 * (1.0f / 3.0f + u2 * (1.0f / 5.0f + u2 * (1.0f / 7.0f + u2 * (1.0f / 9.0f)))));
+  return exponent + 2.88539008f * series;
+}
+
+// Kernel weight times the edge stopping functions, see DenoiseHlslCompat.h.
+inline float TapWeight(float kernel, float cosine, float edgeDistance, float sigmaNormal)
+{
+  return kernel * FastExp2(sigmaNormal * FastLog2(std::max(cosine, DENOISE_MIN_COSINE)) - DENOISE_LOG2_E * edgeDistance);
+}
+
+// Calls function(y) for every row, rows are handed out to the threads one at a time.
+template <typename Function>
+void ForEachRow(unsigned int height, unsigned int threads, Function function)
+{
+  std::atomic<unsigned int> nextRow{ 0 };
+  auto Worker = [&]()
+  {
+    for (unsigned int y = nextRow++; y < height; y = nextRow++)
+    {
+      function(y);
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (unsigned int i = 1; i < threads; i++)
+  {
+    workers.emplace_back(Worker);
+  }
+  Worker();
+  for (auto& worker : workers)
+  {
+    worker.join();
+  }
+}
+
+// Depth change per pixel along one axis, the smaller side so silhouettes do not count.
+float AxisGradient(const std::vector<float>& depth, std::size_t i, bool hasBefore, bool hasAfter, std::size_t stride)
+{
+  const float before = hasBefore ? std::abs(depth[i] - depth[i - stride]) : INFINITY;
+  const float after = hasAfter ? std::abs(depth[i + stride] - depth[i]) : INFINITY;
+  const float gradient = std::min(before, after);
+  return std::isinf(gradient) ? 0.0f : gradient;
+}
+
+}
+
+std::vector<glm::vec3> Filter(const Input& input, const Settings& settings)
+{
+  PROFILE_SCOPE("Denoise");
+  const unsigned int width = input.width;
+  const unsigned int height = input.height;
+  const std::size_t pixelCount = static_cast<std::size_t>(width) * height;
+  unsigned int threads = settings.threads > 0 ? settings.threads : std::thread::hardware_concurrency();
+  threads = std::max(1u, std::min(threads, height));
+
+  Planes p;
+  for (auto* plane : { &p.normal_x, &p.normal_y, &p.normal_z, &p.depth, &p.depth_gradient, &p.albedo_r, &p.albedo_g, &p.albedo_b,
+    &p.red[0], &p.green[0], &p.blue[0], &p.variance[0], &p.red[1], &p.green[1], &p.blue[1], &p.variance[1], &p.luminance, &p.deviation })
+  {
+    plane->assign(pixelCount, 0.0f);
+  }
+
+  // DenoisePassPrepare: averages, demodulated illumination and the temporal variance,
+  // negative where there are too few samples to trust it
+  ForEachRow(height, threads, [&](unsigned int y)
+  {
+    for (unsigned int x = 0; x < width; x++)
+    {
+      const std::size_t i = static_cast<std::size_t>(y) * width + x;
+      const float samples = input.color[i].w;
+      if (samples <= 0.0f)
+      {
+        continue;
+      }
+
+      const float inverse = 1.0f / samples;
+      const glm::vec3 mean = glm::vec3(input.color[i]) * inverse;
+      const glm::vec4 albedoDepth = input.albedo_depth[i] * inverse;
+      const glm::vec3 albedo(DenoiseAlbedo(albedoDepth.r), DenoiseAlbedo(albedoDepth.g), DenoiseAlbedo(albedoDepth.b));
+      const glm::vec3 normal = input.normals[i] * inverse;
+      const float normalLength = glm::length(normal);
+
+      p.albedo_r[i] = albedo.r;
+      p.albedo_g[i] = albedo.g;
+      p.albedo_b[i] = albedo.b;
+      p.red[0][i] = mean.r / albedo.r;
+      p.green[0][i] = mean.g / albedo.g;
+      p.blue[0][i] = mean.b / albedo.b;
+      p.depth[i] = albedoDepth.w;
+      if (normalLength > 0.0f)
+      {
+        p.normal_x[i] = normal.x / normalLength;
+        p.normal_y[i] = normal.y / normalLength;
+        p.normal_z[i] = normal.z / normalLength;
+      }
+
+      if (samples >= DENOISE_TEMPORAL_MIN_SAMPLES)
+      {
+        // variance of the mean, the channels taken as fully correlated
+        const glm::vec3 variance = glm::max(input.moments[i] * inverse - mean * mean, glm::vec3(0.0f)) * inverse;
+        const glm::vec3 deviation = glm::sqrt(variance) / albedo;
+        const float luminanceDeviation = DenoiseLuminance(deviation.r, deviation.g, deviation.b);
+        p.variance[0][i] = luminanceDeviation * luminanceDeviation;
+      }
+      else
+      {
+        p.variance[0][i] = -1.0f;
+      }
+    }
+  });
+
+  ForEachRow(height, threads, [&](unsigned int y)
+  {
+    for (unsigned int x = 0; x < width; x++)
+    {
+      const std::size_t i = static_cast<std::size_t>(y) * width + x;
+      p.depth_gradient[i] = std::max(AxisGradient(p.depth, i, x > 0, x + 1 < width, 1),
+        AxisGradient(p.depth, i, y > 0, y + 1 < height, width));
+    }
+  });
+
+  // DenoisePassVariance: luminance variance of the neighbourhood on the same surface
+  ForEachRow(height, threads, [&](unsigned int y)
+  {
+    const int radius = static_cast<int>(DENOISE_VARIANCE_RADIUS);
+    for (unsigned int x = 0; x < width; x++)
+    {
+      const std::size_t i = static_cast<std::size_t>(y) * width + x;
+      p.red[1][i] = p.red[0][i];
+      p.green[1][i] = p.green[0][i];
+      p.blue[1][i] = p.blue[0][i];
+      p.variance[1][i] = p.variance[0][i];
+      if (p.variance[0][i] >= 0.0f)
+      {
+        continue;
+      }
+
+      float sumWeight = 0.0f;
+      float sumLuminance = 0.0f;
+      float sumSquares = 0.0f;
+      for (int dy = -radius; dy <= radius; dy++)
+      {
+        const int yy = static_cast<int>(y) + dy;
+        if (yy < 0 || yy >= static_cast<int>(height))
+        {
+          continue;
+        }
+        for (int dx = -radius; dx <= radius; dx++)
+        {
+          const int xx = static_cast<int>(x) + dx;
+          if (xx < 0 || xx >= static_cast<int>(width))
+          {
+            continue;
+          }
+          const std::size_t q = static_cast<std::size_t>(yy) * width + xx;
+          const float cosine = p.normal_x[i] * p.normal_x[q] + p.normal_y[i] * p.normal_y[q] + p.normal_z[i] * p.normal_z[q];
+          const float distance = std::sqrt(static_cast<float>(dx * dx + dy * dy));
+          const float edgeDistance = DenoiseEdgeDistance(p.depth[i], p.depth[q], p.depth_gradient[i], distance, 0.0f, 0.0f, 1.0f, settings.sigma_depth, 1.0f);
+          const float weight = q == i ? 1.0f : TapWeight(1.0f, cosine, edgeDistance, settings.sigma_normal);
+          const float luminance = DenoiseLuminance(p.red[0][q], p.green[0][q], p.blue[0][q]);
+          sumWeight += weight;
+          sumLuminance += weight * luminance;
+          sumSquares += weight * luminance * luminance;
+        }
+      }
+      const float mean = sumLuminance / sumWeight;
+      p.variance[1][i] = std::max(sumSquares / sumWeight - mean * mean, 0.0f);
+    }
+  });
+
+  // DenoisePassAtrous, ping-ponging between the two buffers
+  unsigned int source = 1;
+  const unsigned int iterations = std::min(settings.iterations, DENOISE_MAX_ITERATIONS);
+  for (unsigned int iteration = 0; iteration < iterations; iteration++)
+  {
+    const unsigned int target = source ^ 1;
+    const int step = 1 << iteration;
+    const std::vector<float>& red = p.red[source];
+    const std::vector<float>& green = p.green[source];
+    const std::vector<float>& blue = p.blue[source];
+    const std::vector<float>& variance = p.variance[source];
+
+    ForEachRow(height, threads, [&](unsigned int y)
+    {
+      for (unsigned int x = 0; x < width; x++)
+      {
+        const std::size_t i = static_cast<std::size_t>(y) * width + x;
+        float sum = 0.0f;
+        float sumWeight = 0.0f;
+        for (int dy = -1; dy <= 1; dy++)
+        {
+          for (int dx = -1; dx <= 1; dx++)
+          {
+            const int xx = static_cast<int>(x) + dx;
+            const int yy = static_cast<int>(y) + dy;
+            if (xx >= 0 && xx < static_cast<int>(width) && yy >= 0 && yy < static_cast<int>(height))
+            {
+              const float weight = c_varianceKernel[std::abs(dx)] * c_varianceKernel[std::abs(dy)];
+              sum += weight * variance[static_cast<std::size_t>(yy) * width + xx];
+              sumWeight += weight;
+            }
+          }
+        }
+        p.luminance[i] = DenoiseLuminance(red[i], green[i], blue[i]);
+        p.deviation[i] = std::sqrt(sum / sumWeight);
+      }
+    });
+
+    ForEachRow(height, threads, [&](unsigned int y)
+    {
+      // the row in blocks with the accumulators on the stack, they can't alias the
+      // planes so the tap loops vectorize without runtime alias checks
+      const std::size_t row = static_cast<std::size_t>(y) * width;
+      const float centerKernel = c_atrousKernel[0] * c_atrousKernel[0];
+      for (unsigned int blockBegin = 0; blockBegin < width; blockBegin += c_blockWidth)
+      {
+        const unsigned int blockEnd = std::min(blockBegin + c_blockWidth, width);
+        const std::size_t center = row + blockBegin;
+        const float* normalX = p.normal_x.data() + center;
+        const float* normalY = p.normal_y.data() + center;
+        const float* normalZ = p.normal_z.data() + center;
+        const float* depth = p.depth.data() + center;
+        const float* depthGradient = p.depth_gradient.data() + center;
+        const float* luminance = p.luminance.data() + center;
+        const float* deviation = p.deviation.data() + center;
+
+        // the center tap always has an edge weight of one
+        float sumWeight[c_blockWidth], sumRed[c_blockWidth], sumGreen[c_blockWidth], sumBlue[c_blockWidth], sumVariance[c_blockWidth];
+        for (unsigned int k = 0; k < blockEnd - blockBegin; k++)
+        {
+          sumWeight[k] = centerKernel;
+          sumRed[k] = centerKernel * red[center + k];
+          sumGreen[k] = centerKernel * green[center + k];
+          sumBlue[k] = centerKernel * blue[center + k];
+          sumVariance[k] = centerKernel * centerKernel * variance[center + k];
+        }
+
+        for (int dy = -2; dy <= 2; dy++)
+        {
+          const int yy = static_cast<int>(y) + dy * step;
+          if (yy < 0 || yy >= static_cast<int>(height))
+          {
+            continue;
+          }
+          for (int dx = -2; dx <= 2; dx++)
+          {
+            if (dx == 0 && dy == 0)
+            {
+              continue;
+            }
+
+            // the pixels of the block whose tap lands inside the image
+            const int offset = dx * step;
+            const int begin = std::max(static_cast<int>(blockBegin), -offset);
+            const int end = std::min(static_cast<int>(blockEnd), static_cast<int>(width) - offset);
+            if (begin >= end)
+            {
+              continue;
+            }
+            const float kernel = c_atrousKernel[std::abs(dx)] * c_atrousKernel[std::abs(dy)];
+            const float distance = static_cast<float>(step) * std::sqrt(static_cast<float>(dx * dx + dy * dy));
+            const std::size_t tap = static_cast<std::size_t>(yy) * width + begin + offset;
+            const float* tapRed = red.data() + tap;
+            const float* tapGreen = green.data() + tap;
+            const float* tapBlue = blue.data() + tap;
+            const float* tapVariance = variance.data() + tap;
+            const float* tapNormalX = p.normal_x.data() + tap;
+            const float* tapNormalY = p.normal_y.data() + tap;
+            const float* tapNormalZ = p.normal_z.data() + tap;
+            const float* tapDepth = p.depth.data() + tap;
+            const float* tapLuminance = p.luminance.data() + tap;
+
+            // center pointers shifted the same way, one index walks both
+            const std::size_t first = begin - blockBegin;
+            const float* centerNormalX = normalX + first;
+            const float* centerNormalY = normalY + first;
+            const float* centerNormalZ = normalZ + first;
+            const float* centerDepth = depth + first;
+            const float* centerDepthGradient = depthGradient + first;
+            const float* centerLuminance = luminance + first;
+            const float* centerDeviation = deviation + first;
+            float* weights = sumWeight + first;
+            float* reds = sumRed + first;
+            float* greens = sumGreen + first;
+            float* blues = sumBlue + first;
+            float* variances = sumVariance + first;
+            const int count = end - begin;
+            for (int j = 0; j < count; j++)
+            {
+              const float cosine = centerNormalX[j] * tapNormalX[j] + centerNormalY[j] * tapNormalY[j] + centerNormalZ[j] * tapNormalZ[j];
+              const float edgeDistance = DenoiseEdgeDistance(centerDepth[j], tapDepth[j], centerDepthGradient[j], distance,
+                centerLuminance[j], tapLuminance[j], centerDeviation[j], settings.sigma_depth, settings.sigma_luminance);
+              const float weight = TapWeight(kernel, cosine, edgeDistance, settings.sigma_normal);
+              weights[j] += weight;
+              reds[j] += weight * tapRed[j];
+              greens[j] += weight * tapGreen[j];
+              blues[j] += weight * tapBlue[j];
+              variances[j] += weight * weight * tapVariance[j];
+            }
+          }
+        }
+
+        for (unsigned int k = 0; k < blockEnd - blockBegin; k++)
+        {
+          p.red[target][center + k] = sumRed[k] / sumWeight[k];
+          p.green[target][center + k] = sumGreen[k] / sumWeight[k];
+          p.blue[target][center + k] = sumBlue[k] / sumWeight[k];
+          p.variance[target][center + k] = sumVariance[k] / (sumWeight[k] * sumWeight[k]);
+        }
+      }
+    });
+
+    source = target;
+  }
+
+  // multiply the albedo back in
+  std::vector<glm::vec3> image(pixelCount, glm::vec3(0.0f));
+  for (std::size_t i = 0; i < pixelCount; i++)
+  {
+    if (input.color[i].w > 0.0f)
+    {
+      image[i] = glm::vec3(p.red[source][i] * p.albedo_r[i], p.green[source][i] * p.albedo_g[i], p.blue[source][i] * p.albedo_b[i]);
+    }
+  }
+  return image;
+}
+
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm/glm.hpp>
+
+#include "shaders/DenoiseHlslCompat.h"
+
+//
+// Denoiser - CPU version of the a-trous filter in Denoise.hlsl, for the headless renderer.
+//
+// Same passes and the same weights as the compute shader (DenoiseHlslCompat.h). The
+// image is kept as one plane per channel and every pass walks rows on all threads:
+// for each tap of the kernel a straight loop over the row the compiler vectorizes,
+// the borders cut off by the loop bounds instead of branches. Every pixel sums its
+// taps in the same order whatever the thread count, so the result is deterministic.
+//
+namespace Denoiser {
+
+struct Settings
+{
+  unsigned int iterations = DENOISE_MAX_ITERATIONS;
+  float sigma_luminance = DENOISE_DEFAULT_SIGMA_LUMINANCE;
+  float sigma_normal = DENOISE_DEFAULT_SIGMA_NORMAL;
+  float sigma_depth = DENOISE_DEFAULT_SIGMA_DEPTH;
+  unsigned int threads = 0; // 0 uses every core
+};
+
+// What the path tracer accumulates per pixel, sums over all samples so far like
+// RenderTarget2 and the auxiliary buffers of the shader.
+struct Input
+{
+  unsigned int width = 0;
+  unsigned int height = 0;
+  const glm::vec4* color = nullptr; // rgb sums, sample count in w
+  const glm::vec3* moments = nullptr; // sums of the squared samples
+  const glm::vec4* albedo_depth = nullptr; // first hit albedo sums, distance sums in w
+  const glm::vec3* normals = nullptr; // first hit normal sums
+};
+
+// The filtered averages, not clamped.
+std::vector<glm::vec3> Filter(const Input& input, const Settings& settings);
+
+}
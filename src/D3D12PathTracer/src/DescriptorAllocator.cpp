@@ -0,0 +1,188 @@
+#include "DescriptorAllocator.h"
+
+#include <algorithm>
+
+namespace DescriptorAllocator {
+
+const char* GetRangeName(Range range)
+{
+  switch (range)
+  {
+  case RangeOutput: return "output";
+  case RangeGeometry: return "geometry";
+  case RangeObjects: return "objects";
+  case RangeMaterials: return "materials";
+  case RangeTextures: return "textures";
+  case RangeAccelerationStructures: return "acceleration structures";
+  default: return "unknown";
+  }
+}
+
+Allocator::Allocator(std::uint32_t initialCapacity, std::uint32_t maxCapacity)
+{
+  m_maxCapacity = std::max(maxCapacity / ChunkSize, 1u) * ChunkSize;
+  m_capacity = std::min((std::max(initialCapacity, 1u) + ChunkSize - 1) / ChunkSize * ChunkSize, m_maxCapacity);
+  m_sizes.assign(m_capacity, 0);
+  m_chunkRanges.assign(m_capacity / ChunkSize, static_cast<std::uint8_t>(RangeCount));
+}
+
+std::uint32_t Allocator::Allocate(Range range, std::uint32_t count)
+{
+  if (count == 0 || range >= RangeCount)
+  {
+    return Invalid;
+  }
+
+  //first fit in address order, the lowest free descriptors go first and single
+  //descriptors take the first block; the newest chunk is the last block
+  RangeState& state = m_ranges[range];
+  std::size_t found = 0;
+  while (found < state.freeBlocks.size() && state.freeBlocks[found].count < count)
+  {
+    found++;
+  }
+  if (found == state.freeBlocks.size())
+  {
+    if (!TakeChunks(range, count))
+    {
+      return Invalid;
+    }
+    found = state.freeBlocks.size() - 1;
+  }
+
+  Block& block = state.freeBlocks[found];
+  const std::uint32_t index = block.begin;
+  block.begin += count;
+  block.count -= count;
+  if (block.count == 0)
+  {
+    state.freeBlocks.erase(state.freeBlocks.begin() + found);
+  }
+
+  m_sizes[index] = count;
+  state.allocated += count;
+  state.free -= count;
+  return index;
+}
+
+bool Allocator::Free(std::uint32_t index)
+{
+  if (index >= m_capacity || m_sizes[index] == 0)
+  {
+    return false;
+  }
+
+  RangeState& state = m_ranges[GetRange(index)];
+  const std::uint32_t count = m_sizes[index];
+  m_sizes[index] = 0;
+
+  //keep the list in address order and merge the block with free neighbours, so freed
+  //descriptors can be handed out as one block again
+  auto next = std::lower_bound(state.freeBlocks.begin(), state.freeBlocks.end(), index,
+    [](const Block& block, std::uint32_t begin) { return block.begin < begin; });
+  const bool mergePrevious = next != state.freeBlocks.begin() && (next - 1)->begin + (next - 1)->count == index;
+  const bool mergeNext = next != state.freeBlocks.end() && index + count == next->begin;
+  if (mergePrevious && mergeNext)
+  {
+    (next - 1)->count += count + next->count;
+    state.freeBlocks.erase(next);
+  }
+  else if (mergePrevious)
+  {
+    (next - 1)->count += count;
+  }
+  else if (mergeNext)
+  {
+    next->begin = index;
+    next->count += count;
+  }
+  else
+  {
+    state.freeBlocks.insert(next, { index, count });
+  }
+
+  state.allocated -= count;
+  state.free += count;
+  return true;
+}
+
+bool Allocator::Reserve(Range range, std::uint32_t count)
+{
+  if (range >= RangeCount)
+  {
+    return false;
+  }
+  const RangeState& state = m_ranges[range];
+  return state.free >= count || TakeChunks(range, count - state.free);
+}
+
+void Allocator::Reset()
+{
+  for (RangeState& state : m_ranges)
+  {
+    state = RangeState();
+  }
+  std::fill(m_sizes.begin(), m_sizes.end(), 0u);
+  std::fill(m_chunkRanges.begin(), m_chunkRanges.end(), static_cast<std::uint8_t>(RangeCount));
+  m_chunkCount = 0;
+}
+
+std::uint32_t Allocator::GetAllocatedCount() const
+{
+  std::uint32_t count = 0;
+  for (const RangeState& state : m_ranges)
+  {
+    count += state.allocated;
+  }
+  return count;
+}
+
+std::uint32_t Allocator::GetLargestFreeBlock(Range range) const
+{
+  std::uint32_t largest = 0;
+  for (const Block& block : m_ranges[range].freeBlocks)
+  {
+    largest = std::max(largest, block.count);
+  }
+  return largest;
+}
+
+bool Allocator::TakeChunks(Range range, std::uint32_t count)
+{
+  const std::uint64_t chunks = (static_cast<std::uint64_t>(count) + ChunkSize - 1) / ChunkSize;
+  const std::uint64_t needed = (m_chunkCount + chunks) * ChunkSize;
+  if (needed > m_maxCapacity)
+  {
+    return false;
+  }
+  if (needed > m_capacity)
+  {
+    //doubling keeps the number of heap copies logarithmic in the descriptor count
+    const std::uint64_t doubled = std::min<std::uint64_t>(static_cast<std::uint64_t>(m_capacity) * 2, m_maxCapacity);
+    m_capacity = static_cast<std::uint32_t>(std::max(needed, doubled));
+    m_sizes.resize(m_capacity, 0);
+    m_chunkRanges.resize(m_capacity / ChunkSize, static_cast<std::uint8_t>(RangeCount));
+    m_growthCount++;
+  }
+
+  RangeState& state = m_ranges[range];
+  const std::uint32_t begin = m_chunkCount * ChunkSize;
+  const std::uint32_t size = static_cast<std::uint32_t>(chunks) * ChunkSize;
+  std::fill(m_chunkRanges.begin() + m_chunkCount, m_chunkRanges.begin() + m_chunkCount + chunks, static_cast<std::uint8_t>(range));
+  m_chunkCount += static_cast<std::uint32_t>(chunks);
+  state.chunks += static_cast<std::uint32_t>(chunks);
+  state.free += size;
+
+  //the unused end of the previous chunk of this range runs straight into the new one
+  if (!state.freeBlocks.empty() && state.freeBlocks.back().begin + state.freeBlocks.back().count == begin)
+  {
+    state.freeBlocks.back().count += size;
+  }
+  else
+  {
+    state.freeBlocks.push_back({ begin, size });
+  }
+  return true;
+}
+
+}
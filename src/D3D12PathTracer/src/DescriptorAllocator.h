@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+//
+// DescriptorAllocator - places descriptors in the CBV/SRV/UAV heap of the path tracer.
+//
+// The heap is cut into chunks of ChunkSize descriptors and every range (the kind of
+// view) takes whole chunks, so the views of a kind stay packed together however many
+// the scene has. A range that runs out takes the next chunk, a heap that runs out
+// doubles its capacity. Growing never moves a descriptor, the owner of the heap only
+// has to create bigger heaps and copy the old ones over at the same indices.
+//
+// Freed descriptors go to the free list of their range, which is kept in address order
+// with neighbouring free blocks merged, and are handed out again lowest first before new
+// chunks are taken.
+//
+// Pure bookkeeping without D3D12, so cpurender --descriptor-report can check it.
+//
+namespace DescriptorAllocator {
+
+enum Range : std::uint32_t
+{
+  RangeOutput,                 // the output, accumulation and denoiser UAV table
+  RangeGeometry,               // position, index and attribute SRVs of the models
+  RangeObjects,                // info CBVs
+  RangeMaterials,              // material CBVs
+  RangeTextures,               // diffuse and normal texture SRVs
+  RangeAccelerationStructures, // fallback layer wrapped pointer UAVs
+  RangeCount
+};
+
+const char* GetRangeName(Range range);
+
+class Allocator
+{
+public:
+  static const std::uint32_t ChunkSize = 64;
+  static const std::uint32_t Invalid = 0xffffffffu;
+  // The descriptor heap limit of resource binding tier 1 and 2.
+  static const std::uint32_t DefaultMaxCapacity = 1000000;
+
+  explicit Allocator(std::uint32_t initialCapacity = 1024, std::uint32_t maxCapacity = DefaultMaxCapacity);
+
+  // count contiguous descriptors of range, the index of the first one. Invalid if count
+  // is 0 or the heap would have to grow past the max capacity.
+  std::uint32_t Allocate(Range range, std::uint32_t count = 1);
+
+  // Gives back what Allocate returned at index. False, changing nothing, for an index
+  // that does not start an allocation, so freeing twice is harmless.
+  bool Free(std::uint32_t index);
+
+  // Takes chunks up front so the next count allocations of range don't grow the heap.
+  bool Reserve(Range range, std::uint32_t count);
+
+  // Frees everything, the capacity stays.
+  void Reset();
+
+  std::uint32_t GetCapacity() const { return m_capacity; }
+  // Descriptors below this index have been handed to a range since the last Reset,
+  // the rest of the heap was never written.
+  std::uint32_t GetHighWaterMark() const { return m_chunkCount * ChunkSize; }
+  std::uint32_t GetGrowthCount() const { return m_growthCount; }
+
+  std::uint32_t GetAllocatedCount() const;
+  std::uint32_t GetAllocatedCount(Range range) const { return m_ranges[range].allocated; }
+  std::uint32_t GetFreeCount(Range range) const { return m_ranges[range].free; }
+  std::uint32_t GetChunkCount(Range range) const { return m_ranges[range].chunks; }
+  // The free blocks of range, one per run of free descriptors.
+  std::uint32_t GetFreeBlockCount(Range range) const { return static_cast<std::uint32_t>(m_ranges[range].freeBlocks.size()); }
+  // The most descriptors of range one allocation can take without new chunks.
+  std::uint32_t GetLargestFreeBlock(Range range) const;
+
+  // The range index belongs to and how many descriptors were allocated there, 0 if none.
+  Range GetRange(std::uint32_t index) const { return static_cast<Range>(m_chunkRanges[index / ChunkSize]); }
+  std::uint32_t GetAllocationSize(std::uint32_t index) const { return index < m_capacity ? m_sizes[index] : 0; }
+
+private:
+  struct Block
+  {
+    std::uint32_t begin;
+    std::uint32_t count;
+  };
+
+  struct RangeState
+  {
+    std::vector<Block> freeBlocks; // by begin, no two adjacent
+    std::uint32_t allocated = 0;
+    std::uint32_t free = 0;
+    std::uint32_t chunks = 0;
+  };
+
+  // Hands count fresh descriptors of new chunks to range as one free block.
+  bool TakeChunks(Range range, std::uint32_t count);
+
+  RangeState m_ranges[RangeCount];
+  std::vector<std::uint32_t> m_sizes;       // per descriptor, the count of the allocation starting there
+  std::vector<std::uint8_t> m_chunkRanges;  // per chunk, the range that owns it
+  std::uint32_t m_chunkCount = 0;
+  std::uint32_t m_capacity = 0;
+  std::uint32_t m_maxCapacity = 0;
+  std::uint32_t m_growthCount = 0;
+};
+
+}
@@ -35,7 +35,6 @@ namespace
 // Constructor for DeviceResources.
 DeviceResources::DeviceResources(DXGI_FORMAT backBufferFormat, DXGI_FORMAT depthBufferFormat, UINT backBufferCount, D3D_FEATURE_LEVEL minFeatureLevel, UINT flags, UINT adapterIDoverride) :
     m_backBufferIndex(0),
-    m_fenceValues{},
     m_rtvDescriptorSize(0),
     m_screenViewport{},
     m_scissorRect{},
@@ -224,8 +223,8 @@ void DeviceResources::CreateDeviceResources()
     ThrowIfFailed(m_commandList->Close());
 
     // Create a fence for tracking GPU execution progress.
-    ThrowIfFailed(m_d3dDevice->CreateFence(m_fenceValues[m_backBufferIndex], D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)));
-    m_fenceValues[m_backBufferIndex]++;
+    m_frameFences.Reset(m_backBufferCount, m_backBufferIndex);
+    ThrowIfFailed(m_d3dDevice->CreateFence(m_frameFences.GetLastSignaledValue(), D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)));
 
     m_fenceEvent.Attach(CreateEvent(nullptr, FALSE, FALSE, nullptr));
     if (!m_fenceEvent.IsValid())
@@ -249,7 +248,6 @@ void DeviceResources::CreateWindowSizeDependentResources()
     for (UINT n = 0; n < m_backBufferCount; n++)
     {
         m_renderTargets[n].Reset();
-        m_fenceValues[n] = m_fenceValues[m_backBufferIndex];
     }
 
     // Determine the render target size in pixels.
@@ -355,6 +353,7 @@ void DeviceResources::CreateWindowSizeDependentResources()
 
     // Reset the index to the current back buffer.
     m_backBufferIndex = m_swapChain->GetCurrentBackBufferIndex();
+    m_frameFences.Synchronize(m_backBufferIndex);
 
     if (m_depthBufferFormat != DXGI_FORMAT_UNKNOWN)
     {
@@ -561,7 +560,7 @@ void DeviceResources::WaitForGpu() noexcept
     if (m_commandQueue && m_fence && m_fenceEvent.IsValid())
     {
         // Schedule a Signal command in the GPU queue.
-        UINT64 fenceValue = m_fenceValues[m_backBufferIndex];
+        UINT64 fenceValue = m_frameFences.GetCurrentValue();
         if (SUCCEEDED(m_commandQueue->Signal(m_fence.Get(), fenceValue)))
         {
             // Wait until the Signal has been processed.
@@ -570,7 +569,7 @@ void DeviceResources::WaitForGpu() noexcept
                 WaitForSingleObjectEx(m_fenceEvent.Get(), INFINITE, FALSE);
 
                 // Increment the fence value for the current frame.
-                m_fenceValues[m_backBufferIndex]++;
+                m_frameFences.Flush();
             }
         }
     }
@@ -580,21 +579,26 @@ void DeviceResources::WaitForGpu() noexcept
 void DeviceResources::MoveToNextFrame()
 {
     // Schedule a Signal command in the queue.
-    const UINT64 currentFenceValue = m_fenceValues[m_backBufferIndex];
+    const UINT64 currentFenceValue = m_frameFences.GetCurrentValue();
     ThrowIfFailed(m_commandQueue->Signal(m_fence.Get(), currentFenceValue));
 
     // Update the back buffer index.
     m_backBufferIndex = m_swapChain->GetCurrentBackBufferIndex();
 
     // If the next frame is not ready to be rendered yet, wait until it is ready.
-    if (m_fence->GetCompletedValue() < m_fenceValues[m_backBufferIndex])
+    // With more than one back buffer this only blocks once the GPU falls a full ring behind.
+    const UINT64 waitFenceValue = m_frameFences.Advance(m_backBufferIndex);
+    if (!IsFenceComplete(waitFenceValue))
     {
-        ThrowIfFailed(m_fence->SetEventOnCompletion(m_fenceValues[m_backBufferIndex], m_fenceEvent.Get()));
+        ThrowIfFailed(m_fence->SetEventOnCompletion(waitFenceValue, m_fenceEvent.Get()));
         WaitForSingleObjectEx(m_fenceEvent.Get(), INFINITE, FALSE);
     }
+}
 
-    // Set the fence value for the next frame.
-    m_fenceValues[m_backBufferIndex] = currentFenceValue + 1;
+// Check whether the GPU has passed the given fence value without blocking.
+bool DeviceResources::IsFenceComplete(UINT64 fenceValue) const
+{
+    return m_fence && FrameFenceRing::IsComplete(fenceValue, m_fence->GetCompletedValue());
 }
 
 // This method acquires the first available hardware adapter that supports Direct3D 12.
@@ -69,6 +69,7 @@ namespace DX
         void Present(D3D12_RESOURCE_STATES beforeState = D3D12_RESOURCE_STATE_RENDER_TARGET);
         void ExecuteCommandList();
         void WaitForGpu() noexcept;
+        bool IsFenceComplete(UINT64 fenceValue) const;
 
         // Device Accessors.
         RECT GetOutputSize() const { return m_outputSize; }
@@ -93,6 +94,9 @@ namespace DX
         UINT                        GetCurrentFrameIndex() const { return m_backBufferIndex; }
         UINT                        GetPreviousFrameIndex() const { return m_backBufferIndex == 0 ? m_backBufferCount - 1 : m_backBufferIndex - 1; }
         UINT                        GetBackBufferCount() const { return m_backBufferCount; }
+        UINT64                      GetCurrentFenceValue() const { return m_frameFences.GetCurrentValue(); }
+        UINT64                      GetLastSignaledFenceValue() const { return m_frameFences.GetLastSignaledValue(); }
+        UINT64                      GetCompletedFenceValue() const { return m_fence ? m_fence->GetCompletedValue() : 0; }
         unsigned int                GetDeviceOptions() const { return m_options; }
         LPCWSTR                     GetAdapterDescription() const { return m_adapterDescription.c_str(); }
         UINT                        GetAdapterID() const { return m_adapterID; }
@@ -132,7 +136,7 @@ namespace DX
 
         // Presentation fence objects.
         Microsoft::WRL::ComPtr<ID3D12Fence>                 m_fence;
-        UINT64                                              m_fenceValues[MAX_BACK_BUFFER_COUNT];
+        FrameFenceRing                                      m_frameFences;
         Microsoft::WRL::Wrappers::Event                     m_fenceEvent;
 
         // Direct3D rendering objects.
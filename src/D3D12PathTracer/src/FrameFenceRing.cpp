@@ -0,0 +1,62 @@
+#include "FrameFenceRing.h"
+
+#include <stdexcept>
+
+void FrameFenceRing::Reset(unsigned int frameCount, unsigned int frameIndex, std::uint64_t initialValue)
+{
+  if (frameCount == 0 || frameIndex >= frameCount)
+  {
+    throw std::out_of_range("FrameFenceRing: invalid frame index");
+  }
+
+  m_fenceValues.assign(frameCount, initialValue);
+  m_frameIndex = frameIndex;
+  m_lastSignaledValue = initialValue;
+
+  //the first frame signals one past the value the fence was created with
+  m_fenceValues[m_frameIndex] = initialValue + 1;
+}
+
+std::uint64_t FrameFenceRing::Advance(unsigned int nextFrameIndex)
+{
+  if (nextFrameIndex >= m_fenceValues.size())
+  {
+    throw std::out_of_range("FrameFenceRing: invalid frame index");
+  }
+
+  const std::uint64_t signaledValue = m_fenceValues[m_frameIndex];
+  m_lastSignaledValue = signaledValue;
+
+  m_frameIndex = nextFrameIndex;
+
+  //whatever was last submitted from this slot has to be done before we reuse it
+  const std::uint64_t waitValue = m_fenceValues[m_frameIndex];
+
+  //values keep growing monotonically across slots
+  m_fenceValues[m_frameIndex] = signaledValue + 1;
+
+  return waitValue;
+}
+
+std::uint64_t FrameFenceRing::Flush()
+{
+  const std::uint64_t signaledValue = m_fenceValues[m_frameIndex];
+  m_lastSignaledValue = signaledValue;
+  m_fenceValues[m_frameIndex] = signaledValue + 1;
+  return signaledValue;
+}
+
+void FrameFenceRing::Synchronize(unsigned int frameIndex)
+{
+  if (frameIndex >= m_fenceValues.size())
+  {
+    throw std::out_of_range("FrameFenceRing: invalid frame index");
+  }
+
+  const std::uint64_t value = m_fenceValues[m_frameIndex];
+  for (auto& fenceValue : m_fenceValues)
+  {
+    fenceValue = value;
+  }
+  m_frameIndex = frameIndex;
+}
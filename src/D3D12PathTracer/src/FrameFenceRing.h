@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+//
+// FrameFenceRing - CPU side bookkeeping for N frames in flight.
+//
+// Every back buffer slot owns a command allocator and a slice of the per frame
+// constant buffer. Before a slot is recorded into again, the GPU must have
+// passed the fence value that was signaled the last time the slot was submitted.
+// This class only does the arithmetic, the caller owns the ID3D12Fence and does
+// the actual Signal / SetEventOnCompletion calls, so it can be driven without a device.
+// cpurender --fence-report does, against a fake queue.
+//
+class FrameFenceRing
+{
+public:
+  FrameFenceRing() = default;
+
+  // Start over with frameCount slots. The fence is expected to be created with
+  // initialValue, the slot at frameIndex is the one being recorded.
+  void Reset(unsigned int frameCount, unsigned int frameIndex, std::uint64_t initialValue = 0);
+
+  // Value to signal once the commands of the current frame have been submitted.
+  std::uint64_t GetCurrentValue() const { return m_fenceValues[m_frameIndex]; }
+
+  // Last value handed out for signaling, used to tag work recorded in an earlier frame.
+  std::uint64_t GetLastSignaledValue() const { return m_lastSignaledValue; }
+
+  unsigned int GetFrameIndex() const { return m_frameIndex; }
+  unsigned int GetFrameCount() const { return static_cast<unsigned int>(m_fenceValues.size()); }
+
+  // Call after GetCurrentValue() has been signaled on the queue.
+  // Moves on to nextFrameIndex and returns the value the GPU has to reach
+  // before that slot can be reused.
+  std::uint64_t Advance(unsigned int nextFrameIndex);
+
+  // Full flush: returns the value to signal and wait on. The current slot
+  // is bumped so the next submission gets a fresh value.
+  std::uint64_t Flush();
+
+  // After a flush every slot is idle, make them all agree on the current value
+  // and switch to frameIndex (swap chain resize can change the back buffer index).
+  void Synchronize(unsigned int frameIndex);
+
+  // True when the work tagged with value has completed on the GPU.
+  static bool IsComplete(std::uint64_t value, std::uint64_t completedValue) { return completedValue >= value; }
+
+private:
+  std::vector<std::uint64_t> m_fenceValues = std::vector<std::uint64_t>(1, 0);
+  unsigned int m_frameIndex = 0;
+  std::uint64_t m_lastSignaledValue = 0;
+};
@@ -0,0 +1,147 @@
+#include "stdafx.h"
+#include "GpuProfiler.h"
+
+void GpuProfiler::RestoreDevice(ID3D12Device* device, ID3D12CommandQueue* commandQueue, UINT frameCount)
+{
+  m_commandQueue = commandQueue;
+  m_frames.assign(frameCount, std::vector<FrameScope>());
+  m_depth = 0;
+  m_recording = false;
+
+  UINT64 frequency = 0;
+  ThrowIfFailed(commandQueue->GetTimestampFrequency(&frequency));
+  m_nanosecondsPerTick = 1e9 / static_cast<double>(frequency);
+
+  D3D12_QUERY_HEAP_DESC heapDesc = {};
+  heapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+  heapDesc.Count = frameCount * MaxScopes * 2;
+  ThrowIfFailed(device->CreateQueryHeap(&heapDesc, IID_PPV_ARGS(&m_heap)));
+  m_heap->SetName(L"GpuProfilerHeap");
+
+  auto readbackHeap = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK);
+  auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(heapDesc.Count * sizeof(UINT64));
+  ThrowIfFailed(device->CreateCommittedResource(&readbackHeap, D3D12_HEAP_FLAG_NONE, &bufferDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&m_readback)));
+  m_readback->SetName(L"GpuProfilerReadback");
+
+  //the track outlives devices, a lost device keeps adding to the same one
+  if (m_track == nullptr)
+  {
+    m_track = Profiler::AddTrack("GPU", true);
+  }
+}
+
+void GpuProfiler::ReleaseDevice()
+{
+  m_heap.Reset();
+  m_readback.Reset();
+  m_commandQueue.Reset();
+  m_frames.clear();
+  m_recording = false;
+}
+
+void GpuProfiler::BeginFrame(UINT frameIndex)
+{
+  if (!m_heap || frameIndex >= m_frames.size())
+  {
+    return;
+  }
+  m_frameIndex = frameIndex;
+  m_depth = 0;
+  m_recording = Profiler::IsEnabled();
+
+  std::vector<FrameScope>& scopes = m_frames[frameIndex];
+  if (scopes.empty())
+  {
+    return;
+  }
+
+  // Timestamps to Profiler time through a GPU and QPC pair taken at the same moment.
+  UINT64 gpuCalibration = 0;
+  UINT64 cpuCalibration = 0;
+  LARGE_INTEGER now;
+  LARGE_INTEGER frequency;
+  if (FAILED(m_commandQueue->GetClockCalibration(&gpuCalibration, &cpuCalibration)) || !QueryPerformanceCounter(&now) || !QueryPerformanceFrequency(&frequency))
+  {
+    scopes.clear();
+    return;
+  }
+  const double calibration = static_cast<double>(Profiler::Now()) - static_cast<double>(now.QuadPart - static_cast<LONGLONG>(cpuCalibration)) * 1e9 / static_cast<double>(frequency.QuadPart);
+  auto ToProfilerTime = [&](UINT64 tick)
+  {
+    return static_cast<std::int64_t>(calibration + static_cast<double>(static_cast<INT64>(tick - gpuCalibration)) * m_nanosecondsPerTick);
+  };
+
+  const SIZE_T begin = frameIndex * MaxScopes * 2 * sizeof(UINT64);
+  D3D12_RANGE range = { begin, begin + scopes.size() * 2 * sizeof(UINT64) };
+  UINT64* mapped = nullptr;
+  ThrowIfFailed(m_readback->Map(0, &range, reinterpret_cast<void**>(&mapped)));
+  const UINT64* ticks = reinterpret_cast<const UINT64*>(reinterpret_cast<const BYTE*>(mapped) + begin);
+
+  std::int64_t first = INT64_MAX;
+  std::int64_t last = INT64_MIN;
+  for (std::size_t i = 0; i < scopes.size(); i++)
+  {
+    if (!scopes[i].ended || ticks[i * 2 + 1] < ticks[i * 2])
+    {
+      continue;
+    }
+    const std::int64_t start = ToProfilerTime(ticks[i * 2]);
+    const std::int64_t end = ToProfilerTime(ticks[i * 2 + 1]);
+    Profiler::Record(m_track, scopes[i].name, start, end, scopes[i].depth);
+    first = std::min(first, start);
+    last = std::max(last, end);
+  }
+  D3D12_RANGE written = {};
+  m_readback->Unmap(0, &written);
+
+  m_frameMilliseconds = last > first ? (last - first) / 1e6 : 0.0;
+  scopes.clear();
+}
+
+void GpuProfiler::EndFrame(ID3D12GraphicsCommandList* commandList)
+{
+  if (!m_recording)
+  {
+    return;
+  }
+  m_recording = false;
+
+  //a scope left open still needs its query written before the resolve
+  std::vector<FrameScope>& scopes = m_frames[m_frameIndex];
+  const UINT base = m_frameIndex * MaxScopes * 2;
+  for (UINT i = 0; i < scopes.size(); i++)
+  {
+    if (!scopes[i].ended)
+    {
+      commandList->EndQuery(m_heap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, base + i * 2 + 1);
+    }
+  }
+  if (!scopes.empty())
+  {
+    commandList->ResolveQueryData(m_heap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, base, static_cast<UINT>(scopes.size()) * 2, m_readback.Get(), base * sizeof(UINT64));
+  }
+}
+
+UINT GpuProfiler::Begin(ID3D12GraphicsCommandList* commandList, const char* name)
+{
+  std::vector<FrameScope>* scopes = m_recording ? &m_frames[m_frameIndex] : nullptr;
+  if (scopes == nullptr || scopes->size() >= MaxScopes)
+  {
+    return InvalidScope;
+  }
+  const UINT scope = static_cast<UINT>(scopes->size());
+  scopes->push_back({ name, m_depth++, false });
+  commandList->EndQuery(m_heap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, (m_frameIndex * MaxScopes + scope) * 2);
+  return scope;
+}
+
+void GpuProfiler::End(ID3D12GraphicsCommandList* commandList, UINT scope)
+{
+  if (!m_recording || scope == InvalidScope || scope >= m_frames[m_frameIndex].size())
+  {
+    return;
+  }
+  m_frames[m_frameIndex][scope].ended = true;
+  m_depth--;
+  commandList->EndQuery(m_heap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, (m_frameIndex * MaxScopes + scope) * 2 + 1);
+}
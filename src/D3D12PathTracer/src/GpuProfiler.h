@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+#include <wrl.h>
+
+#include "Profiler.h"
+
+//
+// GpuProfiler - timestamp queries around the passes of a frame, added to the "GPU" track
+// of the Profiler in the same time as the CPU scopes, so the flame view and the trace
+// show what the queue did next to what the threads did.
+//
+// Every frame index owns MaxScopes pairs of queries and a slice of the readback buffer.
+// A slice is read when its frame index comes around again, DeviceResources waited for
+// the fence of that frame before the command list could be reset, so the results are
+// there without waiting. Scopes past MaxScopes and scopes while the Profiler is disabled
+// are not recorded.
+//
+class GpuProfiler
+{
+public:
+  static const UINT MaxScopes = 32;
+  static const UINT InvalidScope = 0xffffffffu;
+
+  void RestoreDevice(ID3D12Device* device, ID3D12CommandQueue* commandQueue, UINT frameCount);
+  void ReleaseDevice();
+
+  // After the command list of frameIndex was reset: records what the frame measured the
+  // last time and starts it over.
+  void BeginFrame(UINT frameIndex);
+  // Before the command list is executed: resolves the queries into the readback slice.
+  void EndFrame(ID3D12GraphicsCommandList* commandList);
+
+  UINT Begin(ID3D12GraphicsCommandList* commandList, const char* name);
+  void End(ID3D12GraphicsCommandList* commandList, UINT scope);
+
+  // From the start of the first to the end of the last scope of the frame read last.
+  double GetFrameMilliseconds() const { return m_frameMilliseconds; }
+
+  class Scope
+  {
+  public:
+    Scope(GpuProfiler& profiler, ID3D12GraphicsCommandList* commandList, const char* name)
+      : m_profiler(profiler), m_commandList(commandList), m_scope(profiler.Begin(commandList, name)) {}
+    ~Scope() { m_profiler.End(m_commandList, m_scope); }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+  private:
+    GpuProfiler& m_profiler;
+    ID3D12GraphicsCommandList* m_commandList;
+    UINT m_scope;
+  };
+
+private:
+  struct FrameScope
+  {
+    const char* name;
+    UINT depth;
+    bool ended;
+  };
+
+  Microsoft::WRL::ComPtr<ID3D12QueryHeap> m_heap;
+  Microsoft::WRL::ComPtr<ID3D12Resource> m_readback;
+  Microsoft::WRL::ComPtr<ID3D12CommandQueue> m_commandQueue;
+  Profiler::Ring* m_track = nullptr;
+  std::vector<std::vector<FrameScope>> m_frames;  // per frame index, the scopes it recorded
+  UINT m_frameIndex = 0;
+  UINT m_depth = 0;
+  bool m_recording = false;
+  double m_nanosecondsPerTick = 0.0;
+  double m_frameMilliseconds = 0.0;
+};
@@ -0,0 +1,487 @@
+#include "HotReload.h"
+
+#include <algorithm>
+#include <cctype>
+#include <set>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+namespace HotReload {
+
+namespace {
+
+std::string GetDirectory(const std::string& path)
+{
+  const std::size_t slash = path.find_last_of('/');
+  return slash == std::string::npos ? std::string(".") : slash == 0 ? std::string("/") : path.substr(0, slash);
+}
+
+}
+
+#ifdef __linux__
+
+// Watches the directories of the files, a file is only looked at once an event named it.
+class Notifier
+{
+public:
+  static std::unique_ptr<Notifier> Create()
+  {
+    const int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    return fd < 0 ? nullptr : std::unique_ptr<Notifier>(new Notifier(fd));
+  }
+
+  ~Notifier() { close(m_fd); }
+
+  // The paths whose directory can't be watched, those have to be looked at every time.
+  std::vector<std::string> Watch(const std::vector<std::string>& paths)
+  {
+    for (const auto& pair : m_directories)
+    {
+      inotify_rm_watch(m_fd, pair.first);
+    }
+    m_directories.clear();
+
+    std::vector<std::string> unwatched;
+    std::map<std::string, bool> directories;
+    for (const std::string& path : paths)
+    {
+      const std::string directory = GetDirectory(path);
+      auto it = directories.find(directory);
+      if (it == directories.end())
+      {
+        const int watch = inotify_add_watch(m_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_TO | IN_MOVED_FROM);
+        if (watch >= 0)
+        {
+          m_directories[watch] = directory;
+        }
+        it = directories.insert({ directory, watch >= 0 }).first;
+      }
+      if (!it->second)
+      {
+        unwatched.push_back(path);
+      }
+    }
+    return unwatched;
+  }
+
+  // Adds the paths events named since the last call. False if the queue overflowed and
+  // events were lost, then every file has to be looked at.
+  bool Read(std::vector<std::string>& touched)
+  {
+    alignas(inotify_event) char buffer[16384];
+    bool complete = true;
+    for (;;)
+    {
+      const ssize_t bytes = read(m_fd, buffer, sizeof(buffer));
+      if (bytes <= 0)
+      {
+        return complete;
+      }
+      for (ssize_t offset = 0; offset < bytes;)
+      {
+        const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+        offset += sizeof(inotify_event) + event->len;
+        if (event->mask & IN_Q_OVERFLOW)
+        {
+          complete = false;
+          continue;
+        }
+        auto it = m_directories.find(event->wd);
+        if (it != m_directories.end() && event->len > 0)
+        {
+          touched.push_back(NormalizePath(it->second + "/" + event->name));
+        }
+      }
+    }
+  }
+
+private:
+  explicit Notifier(int fd) : m_fd(fd) {}
+
+  int m_fd;
+  std::map<int, std::string> m_directories;
+};
+
+#elif defined(_WIN32)
+
+// Watches the directories of the files with ReadDirectoryChangesW, like inotify a file
+// is only looked at once a notification named it. Every directory has a read pending
+// all the time, Read collects the ones that completed and starts them again.
+class Notifier
+{
+public:
+  static std::unique_ptr<Notifier> Create() { return std::unique_ptr<Notifier>(new Notifier()); }
+
+  ~Notifier() { Clear(); }
+
+  // The paths whose directory can't be watched, those have to be looked at every time.
+  std::vector<std::string> Watch(const std::vector<std::string>& paths)
+  {
+    Clear();
+
+    std::vector<std::string> unwatched;
+    std::map<std::string, bool> directories;
+    for (const std::string& path : paths)
+    {
+      const std::string directory = GetDirectory(path);
+      auto it = directories.find(directory);
+      if (it == directories.end())
+      {
+        std::unique_ptr<Directory> watch(new Directory());
+        watch->path = directory;
+        watch->handle = CreateFileA(directory.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                                    OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+        watch->overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        watch->watched = watch->handle != INVALID_HANDLE_VALUE && watch->overlapped.hEvent != nullptr && Start(*watch);
+        it = directories.insert({ directory, watch->watched }).first;
+        m_directories.push_back(std::move(watch));
+      }
+      if (!it->second)
+      {
+        unwatched.push_back(path);
+      }
+    }
+    return unwatched;
+  }
+
+  // Adds the paths notifications named since the last call. False if the buffer of a
+  // directory overflowed or its read failed, then every file has to be looked at.
+  bool Read(std::vector<std::string>& touched)
+  {
+    bool complete = true;
+    for (const auto& directory : m_directories)
+    {
+      if (!directory->watched)
+      {
+        continue;
+      }
+      DWORD bytes = 0;
+      if (directory->pending)
+      {
+        if (!GetOverlappedResult(directory->handle, &directory->overlapped, &bytes, FALSE))
+        {
+          if (GetLastError() == ERROR_IO_INCOMPLETE)
+          {
+            continue;
+          }
+          bytes = 0;
+        }
+        directory->pending = false;
+      }
+      for (DWORD offset = 0; bytes > 0;)
+      {
+        const FILE_NOTIFY_INFORMATION* event = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(reinterpret_cast<const char*>(directory->buffer) + offset);
+        const int characters = static_cast<int>(event->FileNameLength / sizeof(WCHAR));
+        const int length = WideCharToMultiByte(CP_ACP, 0, event->FileName, characters, nullptr, 0, nullptr, nullptr);
+        std::string name(static_cast<std::size_t>(length), '\0');
+        WideCharToMultiByte(CP_ACP, 0, event->FileName, characters, &name[0], length, nullptr, nullptr);
+        touched.push_back(NormalizePath(directory->path + "/" + name));
+        if (event->NextEntryOffset == 0)
+        {
+          break;
+        }
+        offset += event->NextEntryOffset;
+      }
+      //no bytes: more changes than the buffer holds, or the read failed or could not be started again last time
+      complete = complete && bytes > 0;
+      complete = Start(*directory) && complete;
+    }
+    return complete;
+  }
+
+private:
+  struct Directory
+  {
+    std::string path;
+    HANDLE handle = INVALID_HANDLE_VALUE;
+    OVERLAPPED overlapped{};
+    bool watched = false; // its files are unwatched otherwise, looked at every poll
+    bool pending = false;
+    DWORD buffer[16384 / sizeof(DWORD)]; // FILE_NOTIFY_INFORMATION is DWORD aligned
+  };
+
+  Notifier() = default;
+
+  static bool Start(Directory& directory)
+  {
+    ResetEvent(directory.overlapped.hEvent);
+    directory.pending = ReadDirectoryChangesW(directory.handle, directory.buffer, sizeof(directory.buffer), FALSE,
+                                              FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE,
+                                              nullptr, &directory.overlapped, nullptr) != FALSE;
+    return directory.pending;
+  }
+
+  // The reads write into the buffers until they are cancelled, so wait for that.
+  void Clear()
+  {
+    for (const auto& directory : m_directories)
+    {
+      if (directory->pending)
+      {
+        DWORD bytes = 0;
+        CancelIoEx(directory->handle, &directory->overlapped);
+        GetOverlappedResult(directory->handle, &directory->overlapped, &bytes, TRUE);
+      }
+      if (directory->handle != INVALID_HANDLE_VALUE)
+      {
+        CloseHandle(directory->handle);
+      }
+      if (directory->overlapped.hEvent != nullptr)
+      {
+        CloseHandle(directory->overlapped.hEvent);
+      }
+    }
+    m_directories.clear();
+  }
+
+  // Held by pointer, a pending read keeps the address of the OVERLAPPED and the buffer.
+  std::vector<std::unique_ptr<Directory>> m_directories;
+};
+
+#else
+
+class Notifier
+{
+public:
+  static std::unique_ptr<Notifier> Create() { return nullptr; }
+  std::vector<std::string> Watch(const std::vector<std::string>& paths) { return paths; }
+  bool Read(std::vector<std::string>&) { return false; }
+};
+
+#endif
+
+FileState RealFileSystem::Stat(const std::string& path)
+{
+  FileState state;
+#ifdef _WIN32
+  //st_mtime only has seconds, two saves within one of the same size would look unchanged
+  WIN32_FILE_ATTRIBUTE_DATA info;
+  if (GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &info) && !(info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+  {
+    state.exists = true;
+    const std::uint64_t written = (static_cast<std::uint64_t>(info.ftLastWriteTime.dwHighDateTime) << 32) | info.ftLastWriteTime.dwLowDateTime;
+    //100 ns ticks since 1601, nanoseconds since 1970 like elsewhere
+    state.modified = (static_cast<std::int64_t>(written) - 116444736000000000) * 100;
+    state.size = (static_cast<std::uint64_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+  }
+#else
+  struct stat info;
+  if (stat(path.c_str(), &info) == 0)
+  {
+    state.exists = true;
+#ifdef __linux__
+    state.modified = static_cast<std::int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+#else
+    state.modified = static_cast<std::int64_t>(info.st_mtime) * 1000000000;
+#endif
+    state.size = static_cast<std::uint64_t>(info.st_size);
+  }
+#endif
+  return state;
+}
+
+std::string NormalizePath(const std::string& path)
+{
+  std::string slashes = path;
+  std::replace(slashes.begin(), slashes.end(), '\\', '/');
+#ifdef _WIN32
+  std::transform(slashes.begin(), slashes.end(), slashes.begin(), [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+#endif
+
+  std::string normalized;
+  if (!slashes.empty() && slashes[0] == '/')
+  {
+    normalized = "/";
+  }
+  std::size_t begin = 0;
+  while (begin <= slashes.size())
+  {
+    std::size_t end = slashes.find('/', begin);
+    end = end == std::string::npos ? slashes.size() : end;
+    const std::string component = slashes.substr(begin, end - begin);
+    if (!component.empty() && component != ".")
+    {
+      if (!normalized.empty() && normalized.back() != '/')
+      {
+        normalized += '/';
+      }
+      normalized += component;
+    }
+    begin = end + 1;
+  }
+  return normalized.empty() ? std::string(".") : normalized;
+}
+
+const char* GetKindName(Kind kind)
+{
+  switch (kind)
+  {
+  case Kind::Scene: return "scene";
+  case Kind::Gltf: return "gltf";
+  case Kind::Model: return "model";
+  case Kind::DiffuseTexture: return "diffuse texture";
+  case Kind::NormalTexture: return "normal texture";
+  case Kind::Object: return "object";
+  default: return "unknown";
+  }
+}
+
+void DependencyGraph::AddFile(const std::string& path, Node node)
+{
+  std::vector<Node>& nodes = m_files[NormalizePath(path)];
+  if (std::find(nodes.begin(), nodes.end(), node) == nodes.end())
+  {
+    nodes.push_back(node);
+  }
+}
+
+void DependencyGraph::AddDependent(Node asset, Node dependent)
+{
+  std::vector<Node>& dependents = m_dependents[asset];
+  dependents.push_back(dependent);
+}
+
+void DependencyGraph::Clear()
+{
+  m_files.clear();
+  m_dependents.clear();
+}
+
+std::vector<std::string> DependencyGraph::GetFiles() const
+{
+  std::vector<std::string> files;
+  files.reserve(m_files.size());
+  for (const auto& pair : m_files)
+  {
+    files.push_back(pair.first);
+  }
+  return files;
+}
+
+ReloadPlan DependencyGraph::Resolve(const std::vector<std::string>& changed) const
+{
+  ReloadPlan plan;
+  std::set<Node> reload, affected;
+  for (const std::string& path : changed)
+  {
+    auto file = m_files.find(NormalizePath(path));
+    if (file == m_files.end())
+    {
+      plan.unknown.push_back(path);
+      continue;
+    }
+    for (const Node& node : file->second)
+    {
+      if (node.kind == Kind::Scene || node.kind == Kind::Gltf)
+      {
+        plan.full = true;
+        continue;
+      }
+      reload.insert(node);
+      auto dependents = m_dependents.find(node);
+      if (dependents != m_dependents.end())
+      {
+        affected.insert(dependents->second.begin(), dependents->second.end());
+      }
+    }
+  }
+  if (!plan.full)
+  {
+    plan.reload.assign(reload.begin(), reload.end());
+    plan.affected.assign(affected.begin(), affected.end());
+  }
+  return plan;
+}
+
+Watcher::Watcher(FileSystem& fileSystem, double debounceSeconds, bool useNotifier)
+  : m_fileSystem(fileSystem), m_debounce(debounceSeconds), m_notifier(useNotifier ? Notifier::Create() : nullptr)
+{
+}
+
+Watcher::~Watcher() = default;
+
+void Watcher::SetFiles(const std::vector<std::string>& paths, double now)
+{
+  m_files.clear();
+  std::vector<std::string> normalized;
+  for (const std::string& path : paths)
+  {
+    const std::string key = NormalizePath(path);
+    Entry& entry = m_files[key];
+    entry.state = m_fileSystem.Stat(key);
+    entry.changed = now;
+    m_statCount++;
+    normalized.push_back(key);
+  }
+  m_unwatched.clear();
+  if (m_notifier)
+  {
+    m_unwatched = m_notifier->Watch(normalized);
+  }
+}
+
+std::vector<std::string> Watcher::Poll(double now)
+{
+  std::vector<std::string> touched;
+  if (m_notifier && m_notifier->Read(touched))
+  {
+    touched.insert(touched.end(), m_unwatched.begin(), m_unwatched.end());
+    //a write is usually a modify and a close event
+    std::sort(touched.begin(), touched.end());
+    touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+    for (const std::string& path : touched)
+    {
+      auto it = m_files.find(path);
+      if (it != m_files.end())
+      {
+        Check(it->first, it->second, now);
+      }
+    }
+  }
+  else
+  {
+    for (auto& pair : m_files)
+    {
+      Check(pair.first, pair.second, now);
+    }
+  }
+
+  std::vector<std::string> settled;
+  for (auto& pair : m_files)
+  {
+    Entry& entry = pair.second;
+    if (entry.pending && entry.state.exists && now - entry.changed >= m_debounce)
+    {
+      entry.pending = false;
+      settled.push_back(pair.first);
+    }
+  }
+  return settled;
+}
+
+std::size_t Watcher::GetPendingCount() const
+{
+  return static_cast<std::size_t>(std::count_if(m_files.begin(), m_files.end(), [](const std::pair<const std::string, Entry>& pair) { return pair.second.pending; }));
+}
+
+void Watcher::Check(const std::string& path, Entry& entry, double now)
+{
+  const FileState state = m_fileSystem.Stat(path);
+  m_statCount++;
+  if (state != entry.state)
+  {
+    entry.state = state;
+    entry.pending = true;
+    entry.changed = now;
+  }
+}
+
+}
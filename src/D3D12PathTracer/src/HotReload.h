@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+//
+// HotReload - notices scene, model and texture files changing on disk and works out
+// what has to be imported again.
+//
+// The Watcher compares what a FileSystem says about every watched path with what it
+// said before. A changed file is reported once it stopped changing for the debounce
+// time, so an editor writing a file in several steps causes one reload, and a file
+// that is gone is held back until it is back. inotify on Linux and
+// ReadDirectoryChangesW on Windows tell which files to look at, elsewhere (and where a
+// directory can't be watched or notifications were lost) every file is looked at.
+//
+// The DependencyGraph maps the files to what was imported from them and what uses
+// that, Resolve turns a set of changed files into a ReloadPlan.
+//
+// Only depends on the standard library, cpurender --hot-reload-report runs both
+// against a fake FileSystem.
+//
+namespace HotReload {
+
+struct FileState
+{
+  bool exists = false;
+  std::int64_t modified = 0; // nanoseconds where the platform has them
+  std::uint64_t size = 0;
+
+  bool operator==(const FileState& other) const { return exists == other.exists && modified == other.modified && size == other.size; }
+  bool operator!=(const FileState& other) const { return !(*this == other); }
+};
+
+class FileSystem
+{
+public:
+  virtual ~FileSystem() = default;
+  virtual FileState Stat(const std::string& path) = 0;
+};
+
+class RealFileSystem : public FileSystem
+{
+public:
+  FileState Stat(const std::string& path) override;
+};
+
+// Forward slashes, no "." components or doubled separators, and lower case on Windows,
+// so one file always ends up as one key.
+std::string NormalizePath(const std::string& path);
+
+enum class Kind
+{
+  Scene,          // the scene file, everything is loaded again
+  Gltf,           // a GLTF file, merged into the scene so everything is loaded again too
+  Model,
+  DiffuseTexture,
+  NormalTexture,
+  Object          // uses models and textures, never read from a file of its own
+};
+
+const char* GetKindName(Kind kind);
+
+struct Node
+{
+  Kind kind;
+  int id;
+
+  bool operator==(const Node& other) const { return kind == other.kind && id == other.id; }
+  bool operator<(const Node& other) const { return kind != other.kind ? kind < other.kind : id < other.id; }
+};
+
+struct ReloadPlan
+{
+  bool full = false;              // a scene or GLTF file changed, reload and other fields are empty
+  std::vector<Node> reload;       // models and textures to import again, each once
+  std::vector<Node> affected;     // objects using them
+  std::vector<std::string> unknown; // changed paths nothing depends on
+
+  bool IsEmpty() const { return !full && reload.empty(); }
+};
+
+class DependencyGraph
+{
+public:
+  void AddFile(const std::string& path, Node node);
+  void AddDependent(Node asset, Node dependent);
+  void Clear();
+
+  std::vector<std::string> GetFiles() const;
+  std::size_t GetFileCount() const { return m_files.size(); }
+
+  ReloadPlan Resolve(const std::vector<std::string>& changed) const;
+
+private:
+  std::map<std::string, std::vector<Node>> m_files;
+  std::map<Node, std::vector<Node>> m_dependents;
+};
+
+class Notifier;
+
+class Watcher
+{
+public:
+  // useNotifier false always looks at every file, what a fake FileSystem needs.
+  explicit Watcher(FileSystem& fileSystem, double debounceSeconds = 0.3, bool useNotifier = true);
+  ~Watcher();
+
+  // Starts over with these files, taking their current state as unchanged.
+  void SetFiles(const std::vector<std::string>& paths, double now);
+
+  // The files whose change settled, now in seconds on any steady clock.
+  std::vector<std::string> Poll(double now);
+
+  bool IsUsingNotifier() const { return m_notifier != nullptr; }
+  std::size_t GetFileCount() const { return m_files.size(); }
+  std::size_t GetPendingCount() const;
+  std::uint64_t GetStatCount() const { return m_statCount; }
+
+private:
+  struct Entry
+  {
+    FileState state;
+    bool pending = false;
+    double changed = 0.0;
+  };
+
+  void Check(const std::string& path, Entry& entry, double now);
+
+  FileSystem& m_fileSystem;
+  double m_debounce;
+  std::map<std::string, Entry> m_files;
+  std::unique_ptr<Notifier> m_notifier;
+  std::vector<std::string> m_unwatched; // directory could not be watched, looked at every poll
+  std::uint64_t m_statCount = 0;
+};
+
+}
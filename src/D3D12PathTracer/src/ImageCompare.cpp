@@ -0,0 +1,469 @@
+#include "ImageCompare.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace ImageCompare {
+
+namespace {
+
+const double c_pi = 3.14159265358979323846;
+
+// FLIP's constants, from the paper.
+const float c_qc = 0.7f;
+const float c_qf = 0.5f;
+const float c_pc = 0.4f;
+const float c_pt = 0.95f;
+const double c_featureWidth = 0.082; // degrees
+const glm::vec3 c_whiteD65(0.950428545f, 1.0f, 1.088900371f);
+
+struct Plane
+{
+  unsigned int width = 0;
+  unsigned int height = 0;
+  std::vector<float> values;
+
+  float& At(unsigned int x, unsigned int y) { return values[y * width + x]; }
+};
+
+// Separable convolution with clamped edges, horizontal kernel then vertical one, both
+// of odd size.
+Plane Convolve(const Plane& plane, const std::vector<float>& horizontal, const std::vector<float>& vertical)
+{
+  const int w = static_cast<int>(plane.width);
+  const int h = static_cast<int>(plane.height);
+  const int rx = static_cast<int>(horizontal.size() / 2);
+  const int ry = static_cast<int>(vertical.size() / 2);
+
+  std::vector<float> rows(plane.values.size());
+  for (int y = 0; y < h; y++)
+  {
+    const float* row = &plane.values[y * w];
+    for (int x = 0; x < w; x++)
+    {
+      float sum = 0.0f;
+      for (int k = -rx; k <= rx; k++)
+      {
+        sum += horizontal[k + rx] * row[std::min(std::max(x + k, 0), w - 1)];
+      }
+      rows[y * w + x] = sum;
+    }
+  }
+
+  Plane result{ plane.width, plane.height, std::vector<float>(plane.values.size()) };
+  for (int y = 0; y < h; y++)
+  {
+    for (int x = 0; x < w; x++)
+    {
+      float sum = 0.0f;
+      for (int k = -ry; k <= ry; k++)
+      {
+        sum += vertical[k + ry] * rows[std::min(std::max(y + k, 0), h - 1) * w + x];
+      }
+      result.values[y * w + x] = sum;
+    }
+  }
+  return result;
+}
+
+// exp(-x^2 / (2 sigma^2)) over [-radius, radius], normalized to a sum of one.
+std::vector<float> Gaussian(int radius, double sigma)
+{
+  std::vector<float> kernel(2 * radius + 1);
+  double sum = 0.0;
+  for (int x = -radius; x <= radius; x++)
+  {
+    sum += kernel[x + radius] = static_cast<float>(std::exp(-x * x / (2.0 * sigma * sigma)));
+  }
+  for (float& k : kernel)
+  {
+    k = static_cast<float>(k / sum);
+  }
+  return kernel;
+}
+
+Plane Luma(const std::vector<glm::vec3>& image, unsigned int width, unsigned int height)
+{
+  Plane plane{ width, height, std::vector<float>(image.size()) };
+  for (std::size_t i = 0; i < image.size(); i++)
+  {
+    plane.values[i] = glm::dot(glm::clamp(image[i], 0.0f, 1.0f), glm::vec3(0.2126f, 0.7152f, 0.0722f));
+  }
+  return plane;
+}
+
+float SrgbToLinear(float c)
+{
+  return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+glm::vec3 LinearToXyz(const glm::vec3& c)
+{
+  return glm::vec3(0.4124564f * c.r + 0.3575761f * c.g + 0.1804375f * c.b,
+                   0.2126729f * c.r + 0.7151522f * c.g + 0.0721750f * c.b,
+                   0.0193339f * c.r + 0.1191920f * c.g + 0.9503041f * c.b);
+}
+
+glm::vec3 XyzToLinear(const glm::vec3& c)
+{
+  return glm::vec3(3.2404542f * c.x - 1.5371385f * c.y - 0.4985314f * c.z,
+                   -0.9692660f * c.x + 1.8760108f * c.y + 0.0415560f * c.z,
+                   0.0556434f * c.x - 0.2040259f * c.y + 1.0572252f * c.z);
+}
+
+glm::vec3 XyzToYCxCz(const glm::vec3& xyz)
+{
+  const glm::vec3 n = xyz / c_whiteD65;
+  return glm::vec3(116.0f * n.y - 16.0f, 500.0f * (n.x - n.y), 200.0f * (n.y - n.z));
+}
+
+glm::vec3 YCxCzToXyz(const glm::vec3& c)
+{
+  const float y = (c.x + 16.0f) / 116.0f;
+  return glm::vec3(c.y / 500.0f + y, y, y - c.z / 200.0f) * c_whiteD65;
+}
+
+// CIE L*a*b* with the Hunt adjustment of FLIP, chroma scaled by lightness.
+glm::vec3 XyzToHuntLab(const glm::vec3& xyz)
+{
+  const float delta = 6.0f / 29.0f;
+  auto F = [&](float t) { return t > delta * delta * delta ? std::cbrt(t) : t / (3.0f * delta * delta) + 4.0f / 29.0f; };
+  const glm::vec3 n = xyz / c_whiteD65;
+  const float l = 116.0f * F(n.y) - 16.0f;
+  const float a = 500.0f * (F(n.x) - F(n.y));
+  const float b = 200.0f * (F(n.y) - F(n.z));
+  return glm::vec3(l, 0.01f * l * a, 0.01f * l * b);
+}
+
+float HyAb(const glm::vec3& a, const glm::vec3& b)
+{
+  return std::abs(a.x - b.x) + std::sqrt((a.y - b.y) * (a.y - b.y) + (a.z - b.z) * (a.z - b.z));
+}
+
+// The contrast sensitivity of one opponent channel as a sum of two gaussians in
+// degrees, written as two separable passes with their weights.
+struct Csf
+{
+  std::vector<float> kernels[2];
+  float weights[2];
+};
+
+Csf MakeCsf(float a1, float b1, float a2, float b2, int radius, double pixelsPerDegree)
+{
+  Csf csf;
+  const float a[2] = { a1, a2 };
+  const float b[2] = { b1, b2 };
+  double total = 0.0;
+  for (int i = 0; i < 2; i++)
+  {
+    csf.kernels[i].resize(2 * radius + 1);
+    double sum = 0.0;
+    for (int x = -radius; x <= radius; x++)
+    {
+      const double degrees = x / pixelsPerDegree;
+      sum += csf.kernels[i][x + radius] = static_cast<float>(std::exp(-c_pi * c_pi * degrees * degrees / b[i]));
+    }
+    // The 2D term is a * sqrt(pi / b) * g(x) * g(y), its sum over the window sum^2.
+    csf.weights[i] = static_cast<float>(a[i] * std::sqrt(c_pi / b[i]));
+    total += csf.weights[i] * sum * sum;
+  }
+  for (float& weight : csf.weights)
+  {
+    weight = static_cast<float>(weight / total);
+  }
+  return csf;
+}
+
+Plane Filter(const Plane& plane, const Csf& csf)
+{
+  Plane result = Convolve(plane, csf.kernels[0], csf.kernels[0]);
+  for (float& value : result.values)
+  {
+    value *= csf.weights[0];
+  }
+  if (csf.weights[1] != 0.0f)
+  {
+    const Plane second = Convolve(plane, csf.kernels[1], csf.kernels[1]);
+    for (std::size_t i = 0; i < result.values.size(); i++)
+    {
+      result.values[i] += csf.weights[1] * second.values[i];
+    }
+  }
+  return result;
+}
+
+// The first and second derivative of a gaussian across x, with the positive and the
+// negative weights each normalized to a sum of one, and the gaussian along y.
+struct FeatureKernels
+{
+  std::vector<float> edge;
+  std::vector<float> point;
+  std::vector<float> smooth;
+};
+
+FeatureKernels MakeFeatureKernels(double pixelsPerDegree)
+{
+  const double sigma = 0.5 * c_featureWidth * pixelsPerDegree;
+  const int radius = static_cast<int>(std::ceil(3.0 * sigma));
+  FeatureKernels kernels;
+  kernels.smooth = Gaussian(radius, sigma);
+  kernels.edge.resize(2 * radius + 1);
+  kernels.point.resize(2 * radius + 1);
+
+  double edgePositive = 0.0, pointPositive = 0.0, pointNegative = 0.0;
+  for (int x = -radius; x <= radius; x++)
+  {
+    const double g = std::exp(-x * x / (2.0 * sigma * sigma));
+    const double edge = -x * g;
+    const double point = (x * x / (sigma * sigma) - 1.0) * g;
+    kernels.edge[x + radius] = static_cast<float>(edge);
+    kernels.point[x + radius] = static_cast<float>(point);
+    edgePositive += std::max(edge, 0.0);
+    (point > 0.0 ? pointPositive : pointNegative) += std::abs(point);
+  }
+  for (std::size_t i = 0; i < kernels.edge.size(); i++)
+  {
+    kernels.edge[i] = static_cast<float>(kernels.edge[i] / edgePositive); // antisymmetric, the negative half sums to the same
+    kernels.point[i] = static_cast<float>(kernels.point[i] / (kernels.point[i] > 0.0f ? pointPositive : pointNegative));
+  }
+  return kernels;
+}
+
+// Lengths of the edge and point responses of the luminance in [0, 1].
+void Features(const Plane& luminance, const FeatureKernels& kernels, Plane& edges, Plane& points)
+{
+  const Plane edgeX = Convolve(luminance, kernels.edge, kernels.smooth);
+  const Plane edgeY = Convolve(luminance, kernels.smooth, kernels.edge);
+  const Plane pointX = Convolve(luminance, kernels.point, kernels.smooth);
+  const Plane pointY = Convolve(luminance, kernels.smooth, kernels.point);
+  edges = edgeX;
+  points = pointX;
+  for (std::size_t i = 0; i < edges.values.size(); i++)
+  {
+    edges.values[i] = std::sqrt(edgeX.values[i] * edgeX.values[i] + edgeY.values[i] * edgeY.values[i]);
+    points.values[i] = std::sqrt(pointX.values[i] * pointX.values[i] + pointY.values[i] * pointY.values[i]);
+  }
+}
+
+struct Prepared
+{
+  Plane channels[3]; // YCxCz after the contrast sensitivity filters
+  Plane edges;
+  Plane points;
+};
+
+Prepared Prepare(const std::vector<glm::vec3>& image, unsigned int width, unsigned int height, const Csf csfs[3], const FeatureKernels& kernels)
+{
+  Prepared prepared;
+  Plane luminance{ width, height, std::vector<float>(image.size()) };
+  for (Plane& channel : prepared.channels)
+  {
+    channel = luminance;
+  }
+  for (std::size_t i = 0; i < image.size(); i++)
+  {
+    const glm::vec3 display = glm::clamp(image[i], 0.0f, 1.0f);
+    const glm::vec3 linear(SrgbToLinear(display.r), SrgbToLinear(display.g), SrgbToLinear(display.b));
+    const glm::vec3 opponent = XyzToYCxCz(LinearToXyz(linear));
+    for (int c = 0; c < 3; c++)
+    {
+      prepared.channels[c].values[i] = opponent[c];
+    }
+    luminance.values[i] = (opponent.x + 16.0f) / 116.0f;
+  }
+  for (int c = 0; c < 3; c++)
+  {
+    prepared.channels[c] = Filter(prepared.channels[c], csfs[c]);
+  }
+  Features(luminance, kernels, prepared.edges, prepared.points);
+  return prepared;
+}
+
+glm::vec3 HuntLabAt(const Prepared& prepared, std::size_t i)
+{
+  const glm::vec3 opponent(prepared.channels[0].values[i], prepared.channels[1].values[i], prepared.channels[2].values[i]);
+  const glm::vec3 linear = glm::clamp(XyzToLinear(YCxCzToXyz(opponent)), 0.0f, 1.0f);
+  return XyzToHuntLab(LinearToXyz(linear));
+}
+
+}
+
+double Rmse(const std::vector<glm::vec3>& reference, const std::vector<glm::vec3>& test)
+{
+  double sum = 0.0;
+  for (std::size_t i = 0; i < reference.size(); i++)
+  {
+    const glm::vec3 d = glm::clamp(test[i], 0.0f, 1.0f) - glm::clamp(reference[i], 0.0f, 1.0f);
+    sum += glm::dot(d, d) / 3.0;
+  }
+  return std::sqrt(sum / std::max<std::size_t>(reference.size(), 1));
+}
+
+double Ssim(const std::vector<glm::vec3>& reference, const std::vector<glm::vec3>& test, unsigned int width, unsigned int height)
+{
+  if (reference.empty())
+  {
+    return 1.0;
+  }
+  const float c1 = 0.01f * 0.01f;
+  const float c2 = 0.03f * 0.03f;
+  const std::vector<float> window = Gaussian(5, 1.5);
+
+  const Plane x = Luma(reference, width, height);
+  const Plane y = Luma(test, width, height);
+  Plane xx = x, yy = y, xy = x;
+  for (std::size_t i = 0; i < x.values.size(); i++)
+  {
+    xx.values[i] = x.values[i] * x.values[i];
+    yy.values[i] = y.values[i] * y.values[i];
+    xy.values[i] = x.values[i] * y.values[i];
+  }
+  const Plane meanX = Convolve(x, window, window);
+  const Plane meanY = Convolve(y, window, window);
+  const Plane meanXx = Convolve(xx, window, window);
+  const Plane meanYy = Convolve(yy, window, window);
+  const Plane meanXy = Convolve(xy, window, window);
+
+  double sum = 0.0;
+  for (std::size_t i = 0; i < x.values.size(); i++)
+  {
+    const float mx = meanX.values[i];
+    const float my = meanY.values[i];
+    const float vx = std::max(meanXx.values[i] - mx * mx, 0.0f);
+    const float vy = std::max(meanYy.values[i] - my * my, 0.0f);
+    const float cov = meanXy.values[i] - mx * my;
+    sum += (2.0f * mx * my + c1) * (2.0f * cov + c2) / ((mx * mx + my * my + c1) * (vx + vy + c2));
+  }
+  return sum / x.values.size();
+}
+
+double Flip(const std::vector<glm::vec3>& reference, const std::vector<glm::vec3>& test, unsigned int width, unsigned int height,
+            double pixelsPerDegree, std::vector<float>* errors)
+{
+  if (errors != nullptr)
+  {
+    errors->assign(reference.size(), 0.0f);
+  }
+  if (reference.empty())
+  {
+    return 0.0;
+  }
+
+  // The widest gaussian, of b = 0.04, sets the radius of all three filters.
+  const int radius = static_cast<int>(std::ceil(3.0 * std::sqrt(0.04 / (2.0 * c_pi * c_pi)) * pixelsPerDegree));
+  const Csf csfs[3] = {
+    MakeCsf(1.0f, 0.0047f, 0.0f, 1e-5f, radius, pixelsPerDegree),
+    MakeCsf(1.0f, 0.0053f, 0.0f, 1e-5f, radius, pixelsPerDegree),
+    MakeCsf(34.1f, 0.04f, 13.5f, 0.025f, radius, pixelsPerDegree),
+  };
+  const FeatureKernels kernels = MakeFeatureKernels(pixelsPerDegree);
+  const Prepared a = Prepare(reference, width, height, csfs, kernels);
+  const Prepared b = Prepare(test, width, height, csfs, kernels);
+
+  // The largest color difference, between green and blue, maps to one.
+  const float maxColor = std::pow(HyAb(XyzToHuntLab(LinearToXyz(glm::vec3(0.0f, 1.0f, 0.0f))), XyzToHuntLab(LinearToXyz(glm::vec3(0.0f, 0.0f, 1.0f)))), c_qc);
+  const float knee = c_pc * maxColor;
+
+  double sum = 0.0;
+  for (std::size_t i = 0; i < reference.size(); i++)
+  {
+    const float distance = std::pow(HyAb(HuntLabAt(a, i), HuntLabAt(b, i)), c_qc);
+    const float color = std::min(distance < knee ? distance * c_pt / knee : c_pt + (distance - knee) / (maxColor - knee) * (1.0f - c_pt), 1.0f);
+    const float edge = std::abs(a.edges.values[i] - b.edges.values[i]);
+    const float point = std::abs(a.points.values[i] - b.points.values[i]);
+    const float feature = std::pow(std::max(edge, point) / std::sqrt(2.0f), c_qf);
+    const float error = std::pow(color, 1.0f - std::min(feature, 1.0f));
+    sum += error;
+    if (errors != nullptr)
+    {
+      (*errors)[i] = error;
+    }
+  }
+  return sum / reference.size();
+}
+
+Metrics Compare(const std::vector<glm::vec3>& reference, const std::vector<glm::vec3>& test, unsigned int width, unsigned int height,
+                std::vector<float>* flipErrors)
+{
+  Metrics metrics;
+  metrics.rmse = Rmse(reference, test);
+  metrics.ssim = Ssim(reference, test, width, height);
+  metrics.flip = Flip(reference, test, width, height, c_defaultPixelsPerDegree, flipErrors);
+  return metrics;
+}
+
+Metrics NoiseFloor(const std::vector<glm::vec3>& reference, const std::vector<glm::vec3>& sigma, unsigned int width, unsigned int height,
+                   std::uint32_t seed)
+{
+  std::mt19937 random(seed);
+  std::normal_distribution<float> normal;
+  std::vector<glm::vec3> noisy(reference.size());
+  for (std::size_t i = 0; i < reference.size(); i++)
+  {
+    for (int c = 0; c < 3; c++)
+    {
+      noisy[i][c] = reference[i][c] + sigma[i][c] * normal(random);
+    }
+  }
+  return Compare(reference, noisy, width, height);
+}
+
+std::vector<glm::vec3> StandardError(const std::vector<glm::vec4>& accumulation, const std::vector<glm::vec3>& moments, double referenceSamples)
+{
+  std::vector<glm::vec3> sigma(accumulation.size(), glm::vec3(0.0f));
+  for (std::size_t i = 0; i < accumulation.size(); i++)
+  {
+    const double n = accumulation[i].w;
+    if (n < 2.0)
+    {
+      continue;
+    }
+    for (int c = 0; c < 3; c++)
+    {
+      const double mean = accumulation[i][c] / n;
+      const double variance = std::max(moments[i][c] / n - mean * mean, 0.0) * n / (n - 1.0);
+      sigma[i][c] = static_cast<float>(std::sqrt(variance * (1.0 / n + (referenceSamples > 0.0 ? 1.0 / referenceSamples : 0.0))));
+    }
+  }
+  return sigma;
+}
+
+bool Within(const Metrics& metrics, const Metrics& floor, const Tolerance& tolerance, std::vector<const char*>* failed)
+{
+  bool within = true;
+  auto Check = [&](bool passed, const char* name)
+  {
+    if (!passed && failed != nullptr)
+    {
+      failed->push_back(name);
+    }
+    within = within && passed;
+  };
+  Check(metrics.rmse <= tolerance.noise_factor * floor.rmse + tolerance.rmse, "rmse");
+  Check(1.0 - metrics.ssim <= tolerance.noise_factor * (1.0 - floor.ssim) + tolerance.ssim, "ssim");
+  Check(metrics.flip <= tolerance.noise_factor * floor.flip + tolerance.flip, "flip");
+  return within;
+}
+
+glm::vec3 Magma(float value)
+{
+  static const glm::vec3 c_stops[] = {
+    { 0.001462f, 0.000466f, 0.013866f }, { 0.078815f, 0.054184f, 0.211667f }, { 0.232077f, 0.059889f, 0.437695f },
+    { 0.390384f, 0.100379f, 0.501864f }, { 0.550287f, 0.161158f, 0.505719f }, { 0.716387f, 0.214982f, 0.475290f },
+    { 0.868793f, 0.287728f, 0.409303f }, { 0.967671f, 0.439703f, 0.359810f }, { 0.994738f, 0.624350f, 0.427397f },
+    { 0.995131f, 0.827052f, 0.585701f }, { 0.987053f, 0.991438f, 0.749504f },
+  };
+  const float position = std::min(std::max(value, 0.0f), 1.0f) * 10.0f;
+  const int stop = std::min(static_cast<int>(position), 9);
+  return glm::mix(c_stops[stop], c_stops[stop + 1], position - stop);
+}
+
+std::vector<glm::vec3> Heatmap(const std::vector<float>& errors)
+{
+  std::vector<glm::vec3> heatmap(errors.size());
+  std::transform(errors.begin(), errors.end(), heatmap.begin(), Magma);
+  return heatmap;
+}
+
+}
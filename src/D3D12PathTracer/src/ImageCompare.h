@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm/glm.hpp>
+
+//
+// ImageCompare - how far a render is from a reference, for the golden images of
+// cpurender --golden.
+//
+// Everything compares what the viewer sees: both images clamped to [0, 1] and taken as
+// display values, like RenderTarget and the PNGs. Three measures:
+//
+//   RMSE  - over the three channels, what the noise of a path tracer shows up in
+//   SSIM  - structural similarity of the luma, 11 x 11 gaussian windows (sigma 1.5),
+//           1 for equal images
+//   FLIP  - the LDR variant of FLIP (Andersson et al. 2020): color differences after the
+//           contrast sensitivity filters, HyAB in Hunt adjusted L*a*b*, raised where
+//           edges or points differ; 0 for equal images, 1 for black against white. The
+//           per pixel values are the heat map.
+//
+// Monte Carlo noise moves all three, by an amount that depends on the scene and the
+// sample count. NoiseFloor measures it: the reference with gaussian noise of the
+// standard error of every pixel added, compared like a render. A render is within
+// tolerance when it is not much further from the reference than that, so the same
+// limits hold for any sample count and scene and a bias of a few percent still fails.
+//
+// Only depends on the standard library and glm, cpurender --golden-report checks it.
+//
+namespace ImageCompare {
+
+// A wide display (0.7 m wide, 3840 pixels) seen from 0.7 m, the default of FLIP.
+const double c_defaultPixelsPerDegree = 67.0;
+
+struct Metrics
+{
+  double rmse = 0.0;
+  double ssim = 1.0;
+  double flip = 0.0; // mean over the pixels
+};
+
+// Images are width * height pixels, top row first, of the same size.
+double Rmse(const std::vector<glm::vec3>& reference, const std::vector<glm::vec3>& test);
+double Ssim(const std::vector<glm::vec3>& reference, const std::vector<glm::vec3>& test, unsigned int width, unsigned int height);
+// errors, if given, receives the FLIP value of every pixel.
+double Flip(const std::vector<glm::vec3>& reference, const std::vector<glm::vec3>& test, unsigned int width, unsigned int height,
+            double pixelsPerDegree = c_defaultPixelsPerDegree, std::vector<float>* errors = nullptr);
+
+Metrics Compare(const std::vector<glm::vec3>& reference, const std::vector<glm::vec3>& test, unsigned int width, unsigned int height,
+                std::vector<float>* flipErrors = nullptr);
+
+// The metrics of reference against itself with gaussian noise of standard deviation
+// sigma per pixel and channel, the same noise for the same seed.
+Metrics NoiseFloor(const std::vector<glm::vec3>& reference, const std::vector<glm::vec3>& sigma, unsigned int width, unsigned int height,
+                   std::uint32_t seed = 1);
+
+// Standard error of the difference of two independent estimates of every pixel, one of
+// samples and one of referenceSamples samples per pixel, from the sums and the sums of
+// squares of the first (referenceSamples 0: an exact reference).
+std::vector<glm::vec3> StandardError(const std::vector<glm::vec4>& accumulation, const std::vector<glm::vec3>& moments, double referenceSamples);
+
+struct Tolerance
+{
+  double noise_factor = 1.5; // how far past the noise floor a metric may go
+  double rmse = 0.002;       // and by this much more, so noiseless images do not fail
+  double flip = 0.005;       // on the last bit
+  double ssim = 0.005;       // of 1 - SSIM
+};
+
+// Whether metrics is within tolerance of the floor, what is not goes into failed, one
+// name per metric.
+bool Within(const Metrics& metrics, const Metrics& floor, const Tolerance& tolerance, std::vector<const char*>* failed = nullptr);
+
+// The magma color map of FLIP over values in [0, 1], display values.
+glm::vec3 Magma(float value);
+std::vector<glm::vec3> Heatmap(const std::vector<float>& errors);
+
+}
@@ -0,0 +1,848 @@
+#include "ImageWriter.h"
+#include "Profiler.h"
+#include "include/stb_image.h"
+#include "include/stb_image_write.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+// Part of the stb_image_write implementation, not declared in its header.
+unsigned char* stbi_zlib_compress(unsigned char* data, int data_len, int* out_len, int quality);
+
+namespace ImageWriter {
+
+namespace {
+
+// EXR constants, see "Reading and Writing OpenEXR Image Files" and the file layout document.
+const std::uint32_t c_exrMagic = 20000630;
+const std::uint32_t c_exrVersion = 2; // single part scanline file
+const int c_exrPixelHalf = 1;
+const int c_exrPixelFloat = 2;
+const std::uint8_t c_exrCompressionNone = 0;
+const std::uint8_t c_exrCompressionZips = 2;
+const std::uint8_t c_exrCompressionZip = 3;
+const unsigned int c_exrZipLines = 16;
+
+// Deflate effort of stb, the same default it uses for png.
+const int c_zlibQuality = 8;
+
+inline std::uint32_t ToBits(float x)
+{
+  std::uint32_t bits;
+  std::memcpy(&bits, &x, sizeof(bits));
+  return bits;
+}
+
+inline float FromBits(std::uint32_t bits)
+{
+  float x;
+  std::memcpy(&x, &bits, sizeof(x));
+  return x;
+}
+
+// Little endian writers and readers for the EXR header, the data itself is copied as is.
+template <typename T>
+void Append(std::vector<std::uint8_t>& out, T value)
+{
+  const std::size_t size = out.size();
+  out.resize(size + sizeof(T));
+  std::memcpy(out.data() + size, &value, sizeof(T));
+}
+
+void AppendString(std::vector<std::uint8_t>& out, const char* text)
+{
+  out.insert(out.end(), text, text + std::strlen(text) + 1);
+}
+
+void AppendAttribute(std::vector<std::uint8_t>& out, const char* name, const char* type, const std::vector<std::uint8_t>& value)
+{
+  AppendString(out, name);
+  AppendString(out, type);
+  Append<std::int32_t>(out, static_cast<std::int32_t>(value.size()));
+  out.insert(out.end(), value.begin(), value.end());
+}
+
+class Reader
+{
+public:
+  Reader(const std::vector<std::uint8_t>& data, std::size_t offset = 0) : m_data(data), m_offset(offset) {}
+
+  template <typename T>
+  bool Read(T& value)
+  {
+    if (m_offset + sizeof(T) > m_data.size())
+    {
+      return false;
+    }
+    std::memcpy(&value, m_data.data() + m_offset, sizeof(T));
+    m_offset += sizeof(T);
+    return true;
+  }
+
+  bool ReadString(std::string& text)
+  {
+    const auto begin = m_data.begin() + m_offset;
+    const auto end = std::find(begin, m_data.end(), std::uint8_t(0));
+    if (end == m_data.end())
+    {
+      return false;
+    }
+    text.assign(begin, end);
+    m_offset += text.size() + 1;
+    return true;
+  }
+
+  bool Skip(std::size_t bytes)
+  {
+    if (m_offset + bytes > m_data.size())
+    {
+      return false;
+    }
+    m_offset += bytes;
+    return true;
+  }
+
+  void Seek(std::size_t offset) { m_offset = offset; }
+
+  const std::uint8_t* Here() const { return m_data.data() + m_offset; }
+  std::size_t GetOffset() const { return m_offset; }
+
+private:
+  const std::vector<std::uint8_t>& m_data;
+  std::size_t m_offset;
+};
+
+// The ZIP compressor of OpenEXR deflates the bytes of a block after splitting them into
+// even and odd halves and taking differences, which brings the high and low bytes of
+// smooth values next to each other.
+void ZipPredict(const std::vector<std::uint8_t>& raw, std::vector<std::uint8_t>& out)
+{
+  const std::size_t size = raw.size();
+  const std::size_t half = (size + 1) / 2;
+  out.resize(size);
+  for (std::size_t i = 0; i < half; i++)
+  {
+    out[i] = raw[2 * i];
+  }
+  for (std::size_t i = 0; i + half < size; i++)
+  {
+    out[half + i] = raw[2 * i + 1];
+  }
+  for (std::size_t i = size; i-- > 1;)
+  {
+    out[i] = static_cast<std::uint8_t>(out[i] - out[i - 1] + 128);
+  }
+}
+
+void ZipUnpredict(std::vector<std::uint8_t>& data, std::vector<std::uint8_t>& raw)
+{
+  const std::size_t size = data.size();
+  const std::size_t half = (size + 1) / 2;
+  for (std::size_t i = 1; i < size; i++)
+  {
+    data[i] = static_cast<std::uint8_t>(data[i - 1] + data[i] - 128);
+  }
+  raw.resize(size);
+  for (std::size_t i = 0; i < half; i++)
+  {
+    raw[2 * i] = data[i];
+  }
+  for (std::size_t i = 0; i + half < size; i++)
+  {
+    raw[2 * i + 1] = data[half + i];
+  }
+}
+
+void WriteToVector(void* context, void* data, int size)
+{
+  auto* out = static_cast<std::vector<std::uint8_t>*>(context);
+  const auto* bytes = static_cast<const std::uint8_t*>(data);
+  out->insert(out->end(), bytes, bytes + size);
+}
+
+std::string Lowercase(std::string text)
+{
+  std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+  return text;
+}
+
+}
+
+bool GetFormat(const std::string& path, Format& format)
+{
+  const std::size_t dot = path.find_last_of('.');
+  if (dot == std::string::npos)
+  {
+    return false;
+  }
+
+  const std::string extension = Lowercase(path.substr(dot + 1));
+  if (extension == "png") format = Format::Png;
+  else if (extension == "jpg" || extension == "jpeg") format = Format::Jpeg;
+  else if (extension == "bmp") format = Format::Bmp;
+  else if (extension == "hdr") format = Format::Hdr;
+  else if (extension == "exr") format = Format::Exr;
+  else return false;
+  return true;
+}
+
+Image ResolveAccumulation(const float* accumulation, unsigned int width, unsigned int height, std::size_t rowPitch)
+{
+  Image image;
+  image.width = width;
+  image.height = height;
+  image.rgba.resize(std::size_t(width) * height * 4);
+
+  for (unsigned int y = 0; y < height; y++)
+  {
+    const float* in = accumulation + y * rowPitch;
+    float* out = image.rgba.data() + std::size_t(y) * width * 4;
+    for (unsigned int x = 0; x < width; x++)
+    {
+      const float samples = in[x * 4 + 3];
+      const float inverse = samples > 0.0f ? 1.0f / samples : 0.0f;
+      out[x * 4 + 0] = in[x * 4 + 0] * inverse;
+      out[x * 4 + 1] = in[x * 4 + 1] * inverse;
+      out[x * 4 + 2] = in[x * 4 + 2] * inverse;
+      out[x * 4 + 3] = 1.0f;
+    }
+  }
+  return image;
+}
+
+void ToRgb8(const float* rgba, std::uint8_t* rgb, std::size_t count)
+{
+  for (std::size_t i = 0; i < count; i++)
+  {
+    for (std::size_t c = 0; c < 3; c++)
+    {
+      const float value = std::min(std::max(rgba[i * 4 + c], 0.0f), 1.0f) * 255.0f + 0.5f;
+      rgb[i * 3 + c] = static_cast<std::uint8_t>(static_cast<int>(value));
+    }
+  }
+}
+
+// Round to nearest even, overflow to infinity, NaN stays NaN. All three cases are
+// computed and selected so the loop has no branches.
+void ToHalf(const float* values, std::uint16_t* halves, std::size_t count)
+{
+  const std::uint32_t halfMax = (127 + 16) << 23; // 65536, the first value that overflows
+  const std::uint32_t normalMin = (127 - 14) << 23; // 2^-14, the smallest normal half
+  const std::uint32_t denormalMagic = ((127 - 15) + (23 - 10) + 1) << 23;
+
+  for (std::size_t i = 0; i < count; i++)
+  {
+    std::uint32_t bits = ToBits(values[i]);
+    const std::uint32_t sign = bits & 0x80000000u;
+    bits ^= sign;
+
+    const std::uint32_t overflow = bits > 0x7f800000u ? 0x7e00u : 0x7c00u;
+    // denormals: adding 0.5 lines the half mantissa up with the low bits of the float
+    const std::uint32_t denormal = ToBits(FromBits(bits) + FromBits(denormalMagic)) - denormalMagic;
+    const std::uint32_t odd = (bits >> 13) & 1;
+    const std::uint32_t normal = (bits + ((15u - 127u) << 23) + 0xfffu + odd) >> 13;
+
+    const std::uint32_t half = bits >= halfMax ? overflow : (bits < normalMin ? denormal : normal);
+    halves[i] = static_cast<std::uint16_t>(half | (sign >> 16));
+  }
+}
+
+void FromHalf(const std::uint16_t* halves, float* values, std::size_t count)
+{
+  const std::uint32_t exponentMask = 0x7c00u << 13;
+  const std::uint32_t denormalMagic = 113u << 23;
+
+  for (std::size_t i = 0; i < count; i++)
+  {
+    const std::uint32_t half = halves[i];
+    std::uint32_t bits = (half & 0x7fffu) << 13;
+    const std::uint32_t exponent = bits & exponentMask;
+    bits += (127u - 15u) << 23;
+
+    const std::uint32_t special = bits + ((128u - 16u) << 23); // infinity and NaN
+    const std::uint32_t denormal = ToBits(FromBits(bits + (1u << 23)) - FromBits(denormalMagic));
+    bits = exponent == exponentMask ? special : (exponent == 0 ? denormal : bits);
+    values[i] = FromBits(bits | ((half & 0x8000u) << 16));
+  }
+}
+
+std::vector<std::uint8_t> EncodeExr(const Image& image, const Options& options)
+{
+  const unsigned int width = image.width;
+  const unsigned int height = image.height;
+  if (width == 0 || height == 0 || image.rgba.size() < std::size_t(width) * height * 4)
+  {
+    return {};
+  }
+
+  // channels are stored in alphabetical order
+  const bool half = options.exr_pixel_type == ExrPixelType::Half;
+  const std::size_t channelSize = half ? 2 : 4;
+  const char* channelNames[] = { "A", "B", "G", "R" };
+  const int channelSources[] = { 3, 2, 1, 0 };
+  const unsigned int firstChannel = options.exr_alpha ? 0 : 1;
+  const unsigned int channelCount = 4 - firstChannel;
+  const bool zip = options.exr_compression == ExrCompression::Zip;
+  const unsigned int linesPerBlock = zip ? c_exrZipLines : 1;
+  const unsigned int blockCount = (height + linesPerBlock - 1) / linesPerBlock;
+
+  std::vector<std::uint8_t> out;
+  Append<std::uint32_t>(out, c_exrMagic);
+  Append<std::uint32_t>(out, c_exrVersion);
+
+  std::vector<std::uint8_t> value;
+  for (unsigned int c = firstChannel; c < 4; c++)
+  {
+    AppendString(value, channelNames[c]);
+    Append<std::int32_t>(value, half ? c_exrPixelHalf : c_exrPixelFloat);
+    Append<std::uint32_t>(value, 0); // pLinear and reserved
+    Append<std::int32_t>(value, 1); // x and y sampling
+    Append<std::int32_t>(value, 1);
+  }
+  value.push_back(0);
+  AppendAttribute(out, "channels", "chlist", value);
+
+  value = { zip ? c_exrCompressionZip : c_exrCompressionNone };
+  AppendAttribute(out, "compression", "compression", value);
+
+  value.clear();
+  Append<std::int32_t>(value, 0);
+  Append<std::int32_t>(value, 0);
+  Append<std::int32_t>(value, static_cast<std::int32_t>(width) - 1);
+  Append<std::int32_t>(value, static_cast<std::int32_t>(height) - 1);
+  AppendAttribute(out, "dataWindow", "box2i", value);
+  AppendAttribute(out, "displayWindow", "box2i", value);
+
+  value = { 0 }; // increasing y
+  AppendAttribute(out, "lineOrder", "lineOrder", value);
+
+  value.clear();
+  Append<float>(value, 1.0f);
+  AppendAttribute(out, "pixelAspectRatio", "float", value);
+
+  value.clear();
+  Append<float>(value, 0.0f);
+  Append<float>(value, 0.0f);
+  AppendAttribute(out, "screenWindowCenter", "v2f", value);
+
+  value.clear();
+  Append<float>(value, 1.0f);
+  AppendAttribute(out, "screenWindowWidth", "float", value);
+  out.push_back(0); // end of header
+
+  // offsets are filled in once the blocks are written
+  const std::size_t offsetTable = out.size();
+  out.resize(out.size() + blockCount * sizeof(std::uint64_t));
+
+  const std::size_t lineSize = std::size_t(width) * channelCount * channelSize;
+  std::vector<float> plane(width);
+  std::vector<std::uint16_t> halves(width);
+  std::vector<std::uint8_t> raw;
+  std::vector<std::uint8_t> predicted;
+  for (unsigned int block = 0; block < blockCount; block++)
+  {
+    const unsigned int y0 = block * linesPerBlock;
+    const unsigned int lines = std::min(linesPerBlock, height - y0);
+
+    // every line holds one row per channel
+    raw.resize(lineSize * lines);
+    std::uint8_t* cursor = raw.data();
+    for (unsigned int y = y0; y < y0 + lines; y++)
+    {
+      const float* row = image.rgba.data() + std::size_t(y) * width * 4;
+      for (unsigned int c = firstChannel; c < 4; c++)
+      {
+        for (unsigned int x = 0; x < width; x++)
+        {
+          plane[x] = row[x * 4 + channelSources[c]];
+        }
+        if (half)
+        {
+          ToHalf(plane.data(), halves.data(), width);
+          std::memcpy(cursor, halves.data(), width * channelSize);
+        }
+        else
+        {
+          std::memcpy(cursor, plane.data(), width * channelSize);
+        }
+        cursor += width * channelSize;
+      }
+    }
+
+    // blocks that do not shrink are stored as they are, readers go by the size
+    const std::uint8_t* data = raw.data();
+    int dataSize = static_cast<int>(raw.size());
+    unsigned char* compressed = nullptr;
+    if (zip)
+    {
+      ZipPredict(raw, predicted);
+      int compressedSize = 0;
+      compressed = stbi_zlib_compress(predicted.data(), static_cast<int>(predicted.size()), &compressedSize, c_zlibQuality);
+      if (compressed != nullptr && compressedSize < dataSize)
+      {
+        data = compressed;
+        dataSize = compressedSize;
+      }
+    }
+
+    const std::uint64_t offset = out.size();
+    std::memcpy(out.data() + offsetTable + block * sizeof(std::uint64_t), &offset, sizeof(offset));
+    Append<std::int32_t>(out, static_cast<std::int32_t>(y0));
+    Append<std::int32_t>(out, dataSize);
+    out.insert(out.end(), data, data + dataSize);
+    free(compressed);
+  }
+
+  return out;
+}
+
+bool DecodeExr(const std::vector<std::uint8_t>& data, Image& image)
+{
+  Reader reader(data);
+  std::uint32_t magic = 0;
+  std::uint32_t version = 0;
+  if (!reader.Read(magic) || !reader.Read(version) || magic != c_exrMagic || (version & 0xff) != 2 || (version & 0x1e00) != 0)
+  {
+    return false; // tiled, deep and multi part files are not supported
+  }
+
+  struct Channel
+  {
+    std::string name;
+    int type = 0;
+  };
+  std::vector<Channel> channels;
+  std::uint8_t compression = 0xff;
+  std::int32_t window[4] = { 0, 0, -1, -1 };
+
+  for (;;)
+  {
+    std::string name, type;
+    std::int32_t size = 0;
+    if (!reader.ReadString(name))
+    {
+      return false;
+    }
+    if (name.empty())
+    {
+      break;
+    }
+    if (!reader.ReadString(type) || !reader.Read(size) || size < 0)
+    {
+      return false;
+    }
+
+    const std::size_t end = reader.GetOffset() + size;
+    if (name == "channels")
+    {
+      std::string channelName;
+      while (reader.ReadString(channelName) && !channelName.empty())
+      {
+        Channel channel;
+        channel.name = channelName;
+        std::int32_t sampling[2];
+        std::uint32_t flags;
+        if (!reader.Read(channel.type) || !reader.Read(flags) || !reader.Read(sampling[0]) || !reader.Read(sampling[1]) || sampling[0] != 1 || sampling[1] != 1)
+        {
+          return false;
+        }
+        channels.push_back(channel);
+      }
+    }
+    else if (name == "compression")
+    {
+      reader.Read(compression);
+    }
+    else if (name == "dataWindow")
+    {
+      for (auto& v : window)
+      {
+        reader.Read(v);
+      }
+    }
+    if (end > data.size())
+    {
+      return false;
+    }
+    reader.Seek(end);
+  }
+
+  const bool zip = compression == c_exrCompressionZip || compression == c_exrCompressionZips;
+  if (channels.empty() || (!zip && compression != c_exrCompressionNone) || window[2] < window[0] || window[3] < window[1])
+  {
+    return false;
+  }
+
+  image.width = static_cast<unsigned int>(window[2] - window[0] + 1);
+  image.height = static_cast<unsigned int>(window[3] - window[1] + 1);
+  image.rgba.assign(std::size_t(image.width) * image.height * 4, 0.0f);
+  for (std::size_t i = 0; i < std::size_t(image.width) * image.height; i++)
+  {
+    image.rgba[i * 4 + 3] = 1.0f;
+  }
+
+  std::size_t lineSize = 0;
+  for (const Channel& channel : channels)
+  {
+    if (channel.type != c_exrPixelHalf && channel.type != c_exrPixelFloat)
+    {
+      return false;
+    }
+    lineSize += std::size_t(image.width) * (channel.type == c_exrPixelHalf ? 2 : 4);
+  }
+
+  const unsigned int linesPerBlock = compression == c_exrCompressionZip ? c_exrZipLines : 1;
+  const unsigned int blockCount = (image.height + linesPerBlock - 1) / linesPerBlock;
+  std::vector<std::uint8_t> raw;
+  std::vector<std::uint8_t> inflated;
+  std::vector<float> plane(image.width);
+  std::vector<std::uint16_t> halves(image.width);
+  for (unsigned int block = 0; block < blockCount; block++)
+  {
+    std::uint64_t offset = 0;
+    if (!reader.Read(offset) || offset > data.size())
+    {
+      return false;
+    }
+
+    Reader chunk(data, static_cast<std::size_t>(offset));
+    std::int32_t y0 = 0;
+    std::int32_t size = 0;
+    if (!chunk.Read(y0) || !chunk.Read(size) || size < 0 || chunk.GetOffset() + size > data.size())
+    {
+      return false;
+    }
+    const unsigned int firstLine = static_cast<unsigned int>(y0 - window[1]);
+    if (firstLine >= image.height)
+    {
+      return false;
+    }
+    const unsigned int lines = std::min(linesPerBlock, image.height - firstLine);
+    const std::size_t rawSize = lineSize * lines;
+
+    if (zip && std::size_t(size) < rawSize)
+    {
+      inflated.resize(rawSize);
+      const int inflatedSize = stbi_zlib_decode_buffer(reinterpret_cast<char*>(inflated.data()), static_cast<int>(rawSize),
+        reinterpret_cast<const char*>(chunk.Here()), size);
+      if (inflatedSize != static_cast<int>(rawSize))
+      {
+        return false;
+      }
+      ZipUnpredict(inflated, raw);
+    }
+    else if (std::size_t(size) == rawSize)
+    {
+      raw.assign(chunk.Here(), chunk.Here() + size);
+    }
+    else
+    {
+      return false;
+    }
+
+    const std::uint8_t* cursor = raw.data();
+    for (unsigned int y = firstLine; y < firstLine + lines; y++)
+    {
+      float* row = image.rgba.data() + std::size_t(y) * image.width * 4;
+      for (const Channel& channel : channels)
+      {
+        if (channel.type == c_exrPixelHalf)
+        {
+          std::memcpy(halves.data(), cursor, image.width * 2);
+          FromHalf(halves.data(), plane.data(), image.width);
+          cursor += image.width * 2;
+        }
+        else
+        {
+          std::memcpy(plane.data(), cursor, image.width * 4);
+          cursor += image.width * 4;
+        }
+
+        const int target = channel.name == "R" ? 0 : channel.name == "G" ? 1 : channel.name == "B" ? 2 : channel.name == "A" ? 3 : -1;
+        if (target >= 0)
+        {
+          for (unsigned int x = 0; x < image.width; x++)
+          {
+            row[x * 4 + target] = plane[x];
+          }
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+// Radiance RGBE with flat scanlines. Not stbi_write_hdr: the one in include/ steps
+// through the rows by width squared and reads past the end of non-square images.
+std::vector<std::uint8_t> EncodeHdr(const Image& image)
+{
+  const std::size_t count = std::size_t(image.width) * image.height;
+  if (count == 0 || image.rgba.size() < count * 4)
+  {
+    return {};
+  }
+
+  const std::string header = "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y " + std::to_string(image.height) + " +X " + std::to_string(image.width) + "\n";
+  std::vector<std::uint8_t> out(header.begin(), header.end());
+  const std::size_t begin = out.size();
+  out.resize(begin + count * 4);
+
+  std::uint8_t* rgbe = out.data() + begin;
+  for (std::size_t i = 0; i < count; i++)
+  {
+    const float r = std::max(image.rgba[i * 4 + 0], 0.0f);
+    const float g = std::max(image.rgba[i * 4 + 1], 0.0f);
+    const float b = std::max(image.rgba[i * 4 + 2], 0.0f);
+    const float largest = std::max(std::max(r, g), b);
+    int exponent = 0;
+    const float mantissa = std::frexp(largest, &exponent);
+    const float scale = largest > 1e-32f ? mantissa * 256.0f / largest : 0.0f;
+    rgbe[i * 4 + 0] = static_cast<std::uint8_t>(r * scale);
+    rgbe[i * 4 + 1] = static_cast<std::uint8_t>(g * scale);
+    rgbe[i * 4 + 2] = static_cast<std::uint8_t>(b * scale);
+    rgbe[i * 4 + 3] = static_cast<std::uint8_t>(largest > 1e-32f ? exponent + 128 : 0);
+  }
+  return out;
+}
+
+std::vector<std::uint8_t> Encode(Format format, const Image& image, const Options& options)
+{
+  if (format == Format::Exr)
+  {
+    return EncodeExr(image, options);
+  }
+
+  const int width = static_cast<int>(image.width);
+  const int height = static_cast<int>(image.height);
+  const std::size_t count = std::size_t(image.width) * image.height;
+  if (count == 0 || image.rgba.size() < count * 4)
+  {
+    return {};
+  }
+
+  std::vector<std::uint8_t> out;
+  int written = 0;
+  if (format == Format::Hdr)
+  {
+    out = EncodeHdr(image);
+    written = !out.empty();
+  }
+  else
+  {
+    std::vector<std::uint8_t> rgb(count * 3);
+    ToRgb8(image.rgba.data(), rgb.data(), count);
+    if (format == Format::Png)
+    {
+      written = stbi_write_png_to_func(WriteToVector, &out, width, height, 3, rgb.data(), width * 3);
+    }
+    else if (format == Format::Jpeg)
+    {
+      written = stbi_write_jpg_to_func(WriteToVector, &out, width, height, 3, rgb.data(), options.jpeg_quality);
+    }
+    else
+    {
+      written = stbi_write_bmp_to_func(WriteToVector, &out, width, height, 3, rgb.data());
+    }
+  }
+
+  if (written == 0)
+  {
+    out.clear();
+  }
+  return out;
+}
+
+bool Decode(Format format, const std::vector<std::uint8_t>& data, Image& image)
+{
+  if (format == Format::Exr)
+  {
+    return DecodeExr(data, image);
+  }
+
+  int width = 0;
+  int height = 0;
+  int components = 0;
+  const int size = static_cast<int>(data.size());
+  if (format == Format::Hdr)
+  {
+    float* pixels = stbi_loadf_from_memory(data.data(), size, &width, &height, &components, 4);
+    if (pixels == nullptr)
+    {
+      return false;
+    }
+    image.rgba.assign(pixels, pixels + std::size_t(width) * height * 4);
+    stbi_image_free(pixels);
+  }
+  else
+  {
+    unsigned char* pixels = stbi_load_from_memory(data.data(), size, &width, &height, &components, 4);
+    if (pixels == nullptr)
+    {
+      return false;
+    }
+    image.rgba.resize(std::size_t(width) * height * 4);
+    for (std::size_t i = 0; i < image.rgba.size(); i++)
+    {
+      image.rgba[i] = pixels[i] / 255.0f;
+    }
+    stbi_image_free(pixels);
+  }
+  image.width = static_cast<unsigned int>(width);
+  image.height = static_cast<unsigned int>(height);
+  return true;
+}
+
+bool Write(const std::string& path, const Image& image, const Options& options)
+{
+  Format format;
+  if (!GetFormat(path, format))
+  {
+    return false;
+  }
+
+  const std::vector<std::uint8_t> data = Encode(format, image, options);
+  if (data.empty())
+  {
+    return false;
+  }
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char*>(data.data()), std::streamsize(data.size()));
+  return static_cast<bool>(file);
+}
+
+AsyncWriter::AsyncWriter(unsigned int threads, std::size_t capacity) :
+  m_threadCount(std::max(threads, 1u)),
+  m_capacity(capacity)
+{
+}
+
+AsyncWriter::~AsyncWriter()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_wake.notify_all();
+  for (auto& thread : m_threads)
+  {
+    thread.join();
+  }
+}
+
+bool AsyncWriter::Submit(const std::string& path, std::vector<float>&& accumulation, unsigned int width, unsigned int height, const Options& options)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_capacity > 0 && m_jobs.size() >= m_capacity)
+    {
+      return false;
+    }
+
+    Job job;
+    job.path = path;
+    job.accumulation = std::move(accumulation);
+    job.width = width;
+    job.height = height;
+    job.options = options;
+    m_jobs.push_back(std::move(job));
+
+    // started with the first job, most sessions never save an image
+    while (m_threads.size() < m_threadCount)
+    {
+      m_threads.emplace_back(&AsyncWriter::Work, this);
+    }
+  }
+  m_wake.notify_one();
+  return true;
+}
+
+std::size_t AsyncWriter::GetPendingCount() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_jobs.size() + m_busy;
+}
+
+std::size_t AsyncWriter::GetQueuedCount() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_jobs.size();
+}
+
+bool AsyncWriter::IsFull() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_capacity > 0 && m_jobs.size() >= m_capacity;
+}
+
+bool AsyncWriter::PopResult(Result& result)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_results.empty())
+  {
+    return false;
+  }
+  result = std::move(m_results.front());
+  m_results.pop_front();
+  return true;
+}
+
+void AsyncWriter::Flush()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_idle.wait(lock, [&]() { return m_jobs.empty() && m_busy == 0; });
+}
+
+void AsyncWriter::Work()
+{
+  Profiler::SetThreadName("image writer");
+  std::unique_lock<std::mutex> lock(m_mutex);
+  for (;;)
+  {
+    m_wake.wait(lock, [&]() { return m_stop || !m_jobs.empty(); });
+    if (m_jobs.empty())
+    {
+      return; // stopping, everything is written
+    }
+
+    Job job = std::move(m_jobs.front());
+    m_jobs.pop_front();
+    m_busy++;
+    lock.unlock();
+
+    PROFILE_SCOPE("Write image");
+    const auto start = std::chrono::steady_clock::now();
+    Result result;
+    result.path = job.path;
+    Format format;
+    if (GetFormat(job.path, format))
+    {
+      const Image image = ResolveAccumulation(job.accumulation.data(), job.width, job.height, std::size_t(job.width) * 4);
+      const std::vector<std::uint8_t> data = Encode(format, image, job.options);
+      if (!data.empty())
+      {
+        std::ofstream file(job.path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(data.data()), std::streamsize(data.size()));
+        result.success = static_cast<bool>(file);
+        result.bytes = data.size();
+      }
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    lock.lock();
+    m_results.push_back(std::move(result));
+    m_busy--;
+    if (m_jobs.empty() && m_busy == 0)
+    {
+      m_idle.notify_all();
+    }
+  }
+}
+
+}
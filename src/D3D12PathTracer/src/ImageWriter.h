@@ -0,0 +1,152 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//
+// ImageWriter - saves rendered images, float or 8 bit, without stalling the frame loop.
+//
+// Images are linear RGBA floats, usually the averages of the accumulation buffer.
+// OpenEXR (half or float, uncompressed or ZIP) and Radiance HDR keep the full range,
+// PNG, JPEG and BMP are clamped to [0, 1] and quantized. EXR, HDR and the conversions
+// are done here, the 8 bit formats go through stb_image_write. The conversion loops work
+// on whole rows without branches so the compiler vectorizes them.
+//
+// AsyncWriter runs the conversion and encoding on worker threads: the renderer hands
+// over the pixels it read back and carries on.
+//
+namespace ImageWriter {
+
+enum class Format
+{
+  Png,
+  Jpeg,
+  Bmp,
+  Hdr,
+  Exr,
+};
+
+enum class ExrPixelType
+{
+  Half,
+  Float,
+};
+
+enum class ExrCompression
+{
+  None,
+  Zip, // deflate over blocks of 16 scanlines, lossless
+};
+
+struct Options
+{
+  ExrPixelType exr_pixel_type = ExrPixelType::Half;
+  ExrCompression exr_compression = ExrCompression::Zip;
+  bool exr_alpha = false; // write the A channel too
+  int jpeg_quality = 95;
+};
+
+struct Image
+{
+  unsigned int width = 0;
+  unsigned int height = 0;
+  std::vector<float> rgba; // width * height pixels, top row first
+};
+
+// From the extension of path, case insensitive. Returns false if it is none of the above.
+bool GetFormat(const std::string& path, Format& format);
+
+// Averages of an accumulation buffer: rgb sums with the sample count in w, rowPitch in
+// floats. Pixels without samples come out black, alpha is one.
+Image ResolveAccumulation(const float* accumulation, unsigned int width, unsigned int height, std::size_t rowPitch);
+
+// Conversion kernels, count pixels each.
+void ToRgb8(const float* rgba, std::uint8_t* rgb, std::size_t count);
+void ToHalf(const float* values, std::uint16_t* halves, std::size_t count);
+void FromHalf(const std::uint16_t* halves, float* values, std::size_t count);
+
+// Encode into memory, an empty result means failure.
+std::vector<std::uint8_t> Encode(Format format, const Image& image, const Options& options = Options());
+std::vector<std::uint8_t> EncodeExr(const Image& image, const Options& options = Options());
+std::vector<std::uint8_t> EncodeHdr(const Image& image);
+
+// Reads what Encode writes: scanline EXR with any of the options above, HDR through
+// stb_image. Only meant for checking round trips, not as a general loader.
+bool Decode(Format format, const std::vector<std::uint8_t>& data, Image& image);
+bool DecodeExr(const std::vector<std::uint8_t>& data, Image& image);
+
+// Encodes by the extension of path and writes the file.
+bool Write(const std::string& path, const Image& image, const Options& options = Options());
+
+// Worker threads that resolve and write accumulation buffers. With one thread they are
+// written in the order they were submitted. A capacity bounds the jobs waiting for a
+// thread, producers check IsFull and hold on to their pixels meanwhile instead of
+// piling up frames in memory. The destructor finishes the queue before it returns.
+class AsyncWriter
+{
+public:
+  struct Result
+  {
+    std::string path;
+    bool success = false;
+    double seconds = 0.0; // resolve, encode and write
+    std::size_t bytes = 0;
+  };
+
+  // capacity 0 queues without bound. Threads are started with the first job.
+  explicit AsyncWriter(unsigned int threads = 1, std::size_t capacity = 0);
+  ~AsyncWriter();
+
+  AsyncWriter(const AsyncWriter&) = delete;
+  AsyncWriter& operator=(const AsyncWriter&) = delete;
+
+  // accumulation as for ResolveAccumulation, tightly packed. The writer takes it over
+  // unless the queue is full, then it returns false and leaves accumulation alone.
+  bool Submit(const std::string& path, std::vector<float>&& accumulation, unsigned int width, unsigned int height, const Options& options);
+
+  // Jobs submitted and not written yet.
+  std::size_t GetPendingCount() const;
+
+  // Jobs waiting for a thread, and whether Submit would turn the next one away.
+  std::size_t GetQueuedCount() const;
+  bool IsFull() const;
+
+  unsigned int GetThreadCount() const { return m_threadCount; }
+
+  // Takes the oldest result that was not picked up yet.
+  bool PopResult(Result& result);
+
+  // Blocks until every submitted job is written.
+  void Flush();
+
+private:
+  struct Job
+  {
+    std::string path;
+    std::vector<float> accumulation;
+    unsigned int width = 0;
+    unsigned int height = 0;
+    Options options;
+  };
+
+  void Work();
+
+  const unsigned int m_threadCount;
+  const std::size_t m_capacity;
+  mutable std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::condition_variable m_idle;
+  std::deque<Job> m_jobs;
+  std::deque<Result> m_results;
+  std::size_t m_busy = 0;
+  bool m_stop = false;
+  std::vector<std::thread> m_threads;
+};
+
+}
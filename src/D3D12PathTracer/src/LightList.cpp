@@ -0,0 +1,62 @@
+#include "LightList.h"
+#include "AliasTable.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+float Luminance(const glm::vec3& c)
+{
+  return 0.2126f * c.x + 0.7152f * c.y + 0.0722f * c.z;
+}
+
+}
+
+void LightList::Clear()
+{
+  m_triangles.clear();
+  m_aliasProbabilities.clear();
+  m_aliases.clear();
+  m_totalPower = 0.0f;
+}
+
+void LightList::AddTriangle(glm::vec3 positions[3], const glm::vec3& shadingNormal, const glm::vec3& radiance)
+{
+  //the shader takes the emitting side from the winding, make it agree with the vertex
+  //normals (the side the front face culling lets through)
+  glm::vec3 faceNormal = glm::cross(positions[1] - positions[0], positions[2] - positions[0]);
+  if (glm::dot(faceNormal, shadingNormal) < 0.0f)
+  {
+    std::swap(positions[1], positions[2]);
+    faceNormal = -faceNormal;
+  }
+
+  Triangle triangle{};
+  triangle.v0 = positions[0];
+  triangle.v1 = positions[1];
+  triangle.v2 = positions[2];
+  triangle.area = 0.5f * glm::length(faceNormal);
+  triangle.radiance = radiance;
+  m_triangles.push_back(triangle);
+}
+
+void LightList::Build()
+{
+  std::vector<float> weights(m_triangles.size());
+  m_totalPower = 0.0f;
+  for (std::size_t i = 0; i < m_triangles.size(); i++)
+  {
+    weights[i] = std::max(Luminance(m_triangles[i].radiance), 0.0f) * m_triangles[i].area;
+    m_totalPower += weights[i];
+  }
+
+  AliasTable::Build(weights, m_aliasProbabilities, m_aliases);
+
+  for (std::size_t i = 0; i < m_triangles.size(); i++)
+  {
+    m_triangles[i].pdf = m_totalPower > 0.0f ? weights[i] / m_totalPower : 0.0f;
+    m_triangles[i].alias_probability = m_aliasProbabilities[i];
+    m_triangles[i].alias = m_aliases[i];
+  }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm/glm.hpp>
+
+//
+// LightList - emissive triangles for next event estimation.
+//
+// Every triangle of an emissive object is stored in world space in mesh order, so the
+// closest hit shader finds the entry of the triangle it hit at light_offset + PrimitiveIndex().
+// The entries double as a power weighted alias table: picking a light is one uniform
+// number, one fetch and one compare, whatever the number of lights.
+//
+// Only depends on the standard library and glm, the GPU scene uploads the triangles as
+// the EmissiveTriangle of RayTracingHlslCompat.h and the CPU path tracer samples them
+// with AliasTable::Sample. cpurender --light-report checks the sampling.
+//
+class LightList
+{
+public:
+  // EmissiveTriangle of RayTracingHlslCompat.h in glm types, in the same order.
+  struct Triangle
+  {
+    glm::vec3 v0;
+    float area;
+    glm::vec3 v1;
+    float pdf; // probability of picking this triangle
+    glm::vec3 v2;
+    std::uint32_t alias;
+    glm::vec3 radiance;
+    float alias_probability; // probability of keeping this entry rather than its alias
+  };
+
+  void Clear();
+
+  // Append every triangle of a mesh with transform applied, all emitting radiance.
+  // VertexType is any vertex with a position and a normal that have x, y and z, the
+  // Vertex of the GPU scene and of SceneCore alike.
+  // Returns the index of the first triangle of the mesh in the list.
+  template <typename VertexType>
+  std::uint32_t AddMesh(const std::vector<VertexType>& vertices, const std::vector<std::uint32_t>& indices,
+    const glm::mat4& transform, const glm::vec3& radiance)
+  {
+    const std::uint32_t first = GetCount();
+    const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(transform)));
+
+    for (std::size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+      glm::vec3 positions[3];
+      glm::vec3 shadingNormal(0.0f);
+      for (int k = 0; k < 3; k++)
+      {
+        const VertexType& vertex = vertices[indices[i + k]];
+        positions[k] = glm::vec3(transform * glm::vec4(vertex.position.x, vertex.position.y, vertex.position.z, 1.0f));
+        shadingNormal += normalMatrix * glm::vec3(vertex.normal.x, vertex.normal.y, vertex.normal.z);
+      }
+      AddTriangle(positions, shadingNormal, radiance);
+    }
+
+    return first;
+  }
+
+  // Build the alias table over everything added so far. Triangles are weighted by
+  // the luminance of their radiance times their area.
+  void Build();
+
+  const std::vector<Triangle>& GetTriangles() const { return m_triangles; }
+  std::uint32_t GetCount() const { return static_cast<std::uint32_t>(m_triangles.size()); }
+  float GetTotalPower() const { return m_totalPower; }
+
+  // Number of triangles the shader may sample, zero if nothing emits any power.
+  std::uint32_t GetSampleableCount() const { return m_totalPower > 0.0f ? GetCount() : 0; }
+
+  // The alias table of Build on its own, for AliasTable::Sample.
+  const std::vector<float>& GetAliasProbabilities() const { return m_aliasProbabilities; }
+  const std::vector<std::uint32_t>& GetAliases() const { return m_aliases; }
+
+private:
+  // positions in world space, shadingNormal the sum of the vertex normals.
+  void AddTriangle(glm::vec3 positions[3], const glm::vec3& shadingNormal, const glm::vec3& radiance);
+
+  std::vector<Triangle> m_triangles;
+  std::vector<float> m_aliasProbabilities;
+  std::vector<std::uint32_t> m_aliases;
+  float m_totalPower = 0.0f;
+};
@@ -11,10 +11,52 @@
 
 #include "stdafx.h"
 #include "D3D12RaytracingSimpleLighting.h"
+#include "CpuRender.h"
+#include "SceneConvert.h"
+
+// "program.exe -cpu [options] [scene ...]" renders on the CPU reference path tracer and
+// "program.exe -convert [--verify] input output" converts a scene file, both writing to
+// the console they were started from instead of opening a window.
+static bool RunConsoleTool(int& exitCode)
+{
+    int argc;
+    LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+    const bool cpu = argv != nullptr && argc >= 2 && _wcsicmp(argv[1], L"-cpu") == 0;
+    const bool convert = argv != nullptr && argc >= 2 && _wcsicmp(argv[1], L"-convert") == 0;
+    if (!cpu && !convert)
+    {
+        LocalFree(argv);
+        return false;
+    }
+
+    std::vector<std::string> args;
+    for (int i = 2; i < argc; i++)
+    {
+        args.push_back(std::string(argv[i], argv[i] + wcslen(argv[i])));
+    }
+    LocalFree(argv);
+
+    if (!AttachConsole(ATTACH_PARENT_PROCESS))
+    {
+        AllocConsole();
+    }
+    FILE* stream;
+    freopen_s(&stream, "CONOUT$", "w", stdout);
+    freopen_s(&stream, "CONOUT$", "w", stderr);
+
+    exitCode = cpu ? CpuRender::Run(args) : SceneConvert::Run(args);
+    return true;
+}
 
 _Use_decl_annotations_
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow)
 {
+    int exitCode;
+    if (RunConsoleTool(exitCode))
+    {
+        return exitCode;
+    }
+
     D3D12RaytracingSimpleLighting sample(1280, 720, L"DXR Path Tracer");
     return Win32Application::Run(&sample, hInstance, nCmdShow);
 }
@@ -20,10 +20,10 @@ D3D12_RAYTRACING_GEOMETRY_DESC& Model::GetGeomDesc()
     geometryDesc.Triangles.Transform3x4 = 0;
     geometryDesc.Triangles.VertexFormat = DXGI_FORMAT_R32G32B32_FLOAT;
     geometryDesc.Triangles.VertexCount =
-        static_cast<UINT>(vertices.resource->GetDesc().Width) / sizeof(Vertex);
+        static_cast<UINT>(positions.resource->GetDesc().Width) / Packing::VERTEX_POSITION_STRIDE;
     geometryDesc.Triangles.VertexBuffer.StartAddress =
-        vertices.resource->GetGPUVirtualAddress();
-    geometryDesc.Triangles.VertexBuffer.StrideInBytes = sizeof(Vertex);
+        positions.resource->GetGPUVirtualAddress();
+    geometryDesc.Triangles.VertexBuffer.StrideInBytes = Packing::VERTEX_POSITION_STRIDE;
     geometryDesc.Flags = D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE;
 
     return geometryDesc;
@@ -61,6 +61,8 @@ D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO& Model::GetPreBuild(bool i
       } 
       else // DirectX Raytracing
       {
+        // lets BuildAllAS ask for the compacted size
+        bottomLevelBuildDesc.Inputs.Flags |= D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_COMPACTION;
         m_dxrDevice->GetRaytracingAccelerationStructurePrebuildInfo(
             &bottomLevelBuildDesc.Inputs, &bottom_level_prebuild_info);
       }
@@ -135,10 +137,16 @@ void Model::FinalizeAS()
     bottomLevelBuildDesc.DestAccelerationStructureData = m_bottomLevelAccelerationStructure->GetGPUVirtualAddress();
 }
 
+void Model::UpdateBounds() {
+	bounds = SceneStats::ComputeBounds(vertices_vec.data(), vertices_vec.size(), sizeof(Vertex));
+}
+
 FLOAT* SceneObject::getTransform3x4() {
 	if (!transformBuilt) {
 		transformBuilt = true;
-		const float *matrix = (const float*)glm::value_ptr(utilityCore::buildTransformationMatrix(translation, rotation, scale));
+		const glm::mat4 built = utilityCore::buildTransformationMatrix(translation, rotation, scale);
+		const float *matrix = (const float*)glm::value_ptr(built);
+		bounds = model != nullptr ? SceneStats::Transform(model->bounds, built) : SceneStats::Bounds();
 
 		transform[0][0] = matrix[0];
 		transform[0][1] = matrix[4];
@@ -3,7 +3,10 @@
 #include "DirectXRaytracingHelper.h"
 #include "Utilities.h"
 #include "shaders/RayTracingHlslCompat.h"
+#include "shaders/PackingHlslCompat.h"
 #include <glm/glm/glm.hpp>
+#include "CameraPath.h"
+#include "SceneStats.h"
 
 class D3D12RaytracingSimpleLighting;
 
@@ -26,6 +29,7 @@ struct Texture {
 struct TextureBundle {
   Texture *albedoTex;
   Texture *normalTex;
+  Texture *metallicRoughnessTex; // one of the diffuse textures
 };
 
 struct MaterialResource
@@ -51,7 +55,13 @@ struct Model {
   std::string name{};
 
   D3DBuffer indices;
-  D3DBuffer vertices;
+
+  // vertices_vec split into streams by Scene::AllocateVertexStreams
+  D3DBuffer positions;
+  D3DBuffer attributes;
+  UINT attribute_format = Packing::VertexAttributesFloat;
+  XMFLOAT2 uv_offset{ 0.0f, 0.0f };
+  XMFLOAT2 uv_scale{ 1.0f, 1.0f };
 
   //ImGUI stuff
   std::vector<Vertex> vertices_vec;
@@ -60,6 +70,10 @@ struct Model {
   int vertex_line = 0;
   int indices_line = 0;
 
+  // object space, of vertices_vec by UpdateBounds whenever they are set
+  SceneStats::Bounds bounds;
+  void UpdateBounds();
+
   D3D12_RAYTRACING_GEOMETRY_DESC& GetGeomDesc();
   D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC &GetBottomLevelBuildDesc();
 
@@ -98,6 +112,9 @@ struct Model {
   D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC bottom_level_build_desc{};
   bool bottom_level_prebuild_info_allocated = false;
   D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO bottom_level_prebuild_info;
+  // What the bottom level would take compacted, from the post build info of the last
+  // DXR build, 0 with the fallback layer. For the scene statistics.
+  UINT64 compacted_size = 0;
 
   int verticesCount = 0;
   int indicesCount = 0;
@@ -121,17 +138,29 @@ public:
   glm::vec3 scale;
 
   bool transformBuilt = false;
+  // world space, model->bounds moved by the transform and built with it by getTransform3x4
+  SceneStats::Bounds bounds;
 
 private:
   FLOAT transform[3][4]; // instance desc transform
 };
 
 struct Camera {
-  float fov;
+  float fov = 45.0f;
 
   XMVECTOR eye;
   XMVECTOR lookat;
   XMVECTOR up;
-  int maxDepth;
+  int maxDepth = 5;
+
+  // russian roulette, optional in the scene file
+  bool russian_roulette = true;
+  int rr_min_depth = 3;
+
+  // keyframes for sequence captures, optional in the scene file
+  CameraPath::Path path;
+
+  // octahedral normals and unorm16 texture coordinates on the GPU, optional in the scene file
+  bool quantize_vertices = false;
 };
 } // namespace ModelLoading
\ No newline at end of file
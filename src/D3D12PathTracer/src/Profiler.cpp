@@ -0,0 +1,281 @@
+#include "Profiler.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+
+namespace Profiler {
+
+// Single producer, single consumer: the owning thread moves head, Collect moves tail.
+struct Ring
+{
+  static const std::uint64_t Size = 1 << 14;
+
+  std::vector<Event> events = std::vector<Event>(Size);
+  std::atomic<std::uint64_t> head{ 0 };
+  std::atomic<std::uint64_t> tail{ 0 };
+  std::atomic<bool> retired{ false }; // the thread ended, reused once drained
+  std::uint32_t track = 0;
+  std::uint32_t depth = 0;            // only touched by the owning thread
+};
+
+namespace {
+
+struct State
+{
+  std::atomic<bool> enabled{ false };
+  std::atomic<std::uint64_t> dropped{ 0 };
+  std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+  // taken to add tracks and rings, to intern and to collect, never to record
+  std::mutex mutex;
+  std::vector<Track> tracks;
+  std::vector<std::unique_ptr<Ring>> rings;
+  std::vector<std::unique_ptr<Ring>> spare;
+  std::unordered_set<std::string> names;
+};
+
+State& GetState()
+{
+  static State state;
+  return state;
+}
+
+// Takes a drained ring of an ended thread before making a new one, threads of the
+// parallel loops come and go with every load.
+Ring* AddRing(const std::string& name, bool gpu)
+{
+  State& state = GetState();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  std::unique_ptr<Ring> ring;
+  if (!state.spare.empty())
+  {
+    ring = std::move(state.spare.back());
+    state.spare.pop_back();
+  }
+  else
+  {
+    ring.reset(new Ring());
+  }
+  ring->track = static_cast<std::uint32_t>(state.tracks.size());
+  state.tracks.push_back({ ring->track, name.empty() ? "thread " + std::to_string(ring->track) : name, gpu });
+  state.rings.push_back(std::move(ring));
+  return state.rings.back().get();
+}
+
+struct ThreadRing
+{
+  Ring* ring = nullptr;
+  std::string name; // until the first event, threads that record nothing get no ring
+
+  ~ThreadRing()
+  {
+    if (ring != nullptr)
+    {
+      ring->retired.store(true, std::memory_order_release);
+    }
+  }
+
+  Ring& Get()
+  {
+    if (ring == nullptr)
+    {
+      ring = AddRing(name, false);
+    }
+    return *ring;
+  }
+};
+
+thread_local ThreadRing t_ring;
+
+void Push(Ring& ring, const Event& event)
+{
+  const std::uint64_t head = ring.head.load(std::memory_order_relaxed);
+  if (head - ring.tail.load(std::memory_order_acquire) >= Ring::Size)
+  {
+    GetState().dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  ring.events[head & (Ring::Size - 1)] = event;
+  ring.head.store(head + 1, std::memory_order_release);
+}
+
+void AppendEscaped(std::string& out, const char* text)
+{
+  for (const char* c = text; *c != '\0'; c++)
+  {
+    switch (*c)
+    {
+    case '"': out += "\\\""; break;
+    case '\\': out += "\\\\"; break;
+    case '\n': out += "\\n"; break;
+    case '\t': out += "\\t"; break;
+    default:
+      if (static_cast<unsigned char>(*c) < 0x20)
+      {
+        char escaped[8];
+        std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned int>(static_cast<unsigned char>(*c)));
+        out += escaped;
+      }
+      else
+      {
+        out += *c;
+      }
+    }
+  }
+}
+
+}
+
+void SetEnabled(bool enabled)
+{
+  GetState().enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool IsEnabled()
+{
+  return GetState().enabled.load(std::memory_order_relaxed);
+}
+
+std::int64_t Now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - GetState().epoch).count();
+}
+
+const char* Intern(const std::string& name)
+{
+  State& state = GetState();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  //nodes of an unordered_set stay where they are when it rehashes
+  return state.names.insert(name).first->c_str();
+}
+
+void SetThreadName(const char* name)
+{
+  t_ring.name = name;
+  if (t_ring.ring != nullptr)
+  {
+    State& state = GetState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.tracks[t_ring.ring->track].name = name;
+  }
+}
+
+Ring* AddTrack(const char* name, bool gpu)
+{
+  return AddRing(name, gpu);
+}
+
+void Record(Ring* ring, const char* name, std::int64_t begin, std::int64_t end, std::uint32_t depth)
+{
+  if (ring != nullptr && IsEnabled())
+  {
+    Push(*ring, { name, begin, end, ring->track, depth });
+  }
+}
+
+void Collect(std::vector<Event>& events)
+{
+  State& state = GetState();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  for (std::size_t i = 0; i < state.rings.size();)
+  {
+    Ring& ring = *state.rings[i];
+    //read before head, so a retired ring is known to be complete once drained
+    const bool retired = ring.retired.load(std::memory_order_acquire);
+    const std::uint64_t head = ring.head.load(std::memory_order_acquire);
+    const std::uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+    for (std::uint64_t j = tail; j < head; j++)
+    {
+      events.push_back(ring.events[j & (Ring::Size - 1)]);
+    }
+    ring.tail.store(head, std::memory_order_release);
+
+    if (retired)
+    {
+      ring.head.store(0, std::memory_order_relaxed);
+      ring.tail.store(0, std::memory_order_relaxed);
+      ring.retired.store(false, std::memory_order_relaxed);
+      ring.depth = 0;
+      state.spare.push_back(std::move(state.rings[i]));
+      state.rings.erase(state.rings.begin() + i);
+      continue;
+    }
+    i++;
+  }
+}
+
+std::vector<Track> GetTracks()
+{
+  State& state = GetState();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  return state.tracks;
+}
+
+std::uint64_t GetDroppedCount()
+{
+  return GetState().dropped.load(std::memory_order_relaxed);
+}
+
+std::string ToChromeTrace(const std::vector<Event>& events, const std::vector<Track>& tracks)
+{
+  std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  out += "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"D3D12PathTracer\"}}";
+  for (const Track& track : tracks)
+  {
+    out += ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" + std::to_string(track.index) + ",\"args\":{\"name\":\"";
+    AppendEscaped(out, track.name.c_str());
+    out += "\"}}";
+  }
+
+  char times[96];
+  for (const Event& event : events)
+  {
+    const bool gpu = event.track < tracks.size() && tracks[event.track].gpu;
+    out += ",\n{\"ph\":\"X\",\"name\":\"";
+    AppendEscaped(out, event.name);
+    std::snprintf(times, sizeof(times), "\",\"cat\":\"%s\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", gpu ? "gpu" : "cpu", event.track,
+                  event.begin / 1000.0, (event.end - event.begin) / 1000.0);
+    out += times;
+  }
+  out += "\n]}\n";
+  return out;
+}
+
+bool WriteChromeTrace(const std::string& path, const std::vector<Event>& events, const std::vector<Track>& tracks)
+{
+  FILE* file = std::fopen(path.c_str(), "wb");
+  if (file == nullptr)
+  {
+    return false;
+  }
+  const std::string trace = ToChromeTrace(events, tracks);
+  const bool written = std::fwrite(trace.data(), 1, trace.size(), file) == trace.size();
+  return std::fclose(file) == 0 && written;
+}
+
+Scope::Scope(const char* name)
+  : m_name(IsEnabled() ? name : nullptr), m_begin(0)
+{
+  if (m_name != nullptr)
+  {
+    t_ring.Get().depth++;
+    m_begin = Now();
+  }
+}
+
+Scope::~Scope()
+{
+  if (m_name != nullptr)
+  {
+    const std::int64_t end = Now();
+    Ring& ring = t_ring.Get();
+    ring.depth--;
+    Push(ring, { m_name, m_begin, end, ring.track, ring.depth });
+  }
+}
+
+}
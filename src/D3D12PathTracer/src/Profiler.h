@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//
+// Profiler - named timing scopes for the renderers, collected into a timeline that the
+// ImGui flame view draws and that can be saved as a Chrome trace (chrome://tracing or
+// ui.perfetto.dev).
+//
+// PROFILE_SCOPE("name") times the rest of the block on the calling thread. Every thread
+// writes its finished scopes into a ring of its own, only the thread and Collect touch
+// it, so recording takes no lock. A full ring drops events and counts them rather than
+// waiting for Collect. Nothing is recorded while the profiler is disabled, a scope then
+// costs one relaxed load.
+//
+// Tracks that are not threads, like the GPU queue, are added with AddTrack and fed from
+// one thread at a time with Record.
+//
+// Only depends on the standard library, cpurender --profile writes a trace of a headless
+// run and cpurender --profile-report checks the rings.
+//
+namespace Profiler {
+
+struct Event
+{
+  const char* name;     // a literal or Intern'ed, lives as long as the program
+  std::int64_t begin;   // nanoseconds of Now()
+  std::int64_t end;
+  std::uint32_t track;
+  std::uint32_t depth;  // scopes open around this one on the same track
+};
+
+struct Track
+{
+  std::uint32_t index;
+  std::string name;
+  bool gpu;
+};
+
+void SetEnabled(bool enabled);
+bool IsEnabled();
+
+// Nanoseconds on the steady clock since the first call.
+std::int64_t Now();
+
+// Copies name into storage that is never freed, the same name gives the same pointer.
+// For names built at run time like asset paths, literals need no interning.
+const char* Intern(const std::string& name);
+
+// Names the track of the calling thread, it is "thread N" otherwise.
+void SetThreadName(const char* name);
+
+// The ring of a track, owned by the profiler.
+struct Ring;
+
+// A track of its own for timelines that are not a thread, like the GPU queue.
+Ring* AddTrack(const char* name, bool gpu);
+void Record(Ring* ring, const char* name, std::int64_t begin, std::int64_t end, std::uint32_t depth);
+
+// Moves the events recorded since the last call out of every ring, appending them to
+// events. Any thread, one at a time.
+void Collect(std::vector<Event>& events);
+
+std::vector<Track> GetTracks();
+
+// Events lost to full rings since the start.
+std::uint64_t GetDroppedCount();
+
+// Chrome trace event format, complete events with microsecond times.
+std::string ToChromeTrace(const std::vector<Event>& events, const std::vector<Track>& tracks);
+bool WriteChromeTrace(const std::string& path, const std::vector<Event>& events, const std::vector<Track>& tracks);
+
+class Scope
+{
+public:
+  explicit Scope(const char* name);
+  ~Scope();
+
+  Scope(const Scope&) = delete;
+  Scope& operator=(const Scope&) = delete;
+
+private:
+  const char* m_name;
+  std::int64_t m_begin;
+};
+
+}
+
+#define PROFILE_SCOPE_CONCAT_(a, b) a##b
+#define PROFILE_SCOPE_CONCAT(a, b) PROFILE_SCOPE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) Profiler::Scope PROFILE_SCOPE_CONCAT(profile_scope_, __LINE__)(name)
@@ -1,6 +1,8 @@
 #include "stdafx.h"
 #include "Scene.h"
+#include "Profiler.h"
 #include "Utilities.h"
+#include <chrono>
 #include <cstring>
 #include <glm/glm/gtc/matrix_inverse.hpp>
 #include <glm/glm/gtx/string_cast.hpp>
@@ -8,6 +10,8 @@
 #include "DirectXRaytracingHelper.h"
 #include "D3D12RaytracingSimpleLighting.h"
 #include "TextureLoader.h"
+#include "SceneFormat.h"
+#include "shaders/MicrofacetHlslCompat.h"
 
 #define TINYGLTF_IMPLEMENTATION
 #define STB_IMAGE_IMPLEMENTATION
@@ -110,8 +114,89 @@ Scene::Scene(string filename, D3D12RaytracingSimpleLighting* programState) : pro
         {
           ParseScene(filename);
         }
+
+        //the camera block may come after the models and decides how their vertices are stored
+        for (auto& model_pair : modelMap)
+        {
+          AllocateVertexStreams(model_pair.second, camera.quantize_vertices);
+        }
+}
+
+static_assert(sizeof(Vertex) == Packing::VERTEX_INTERLEAVED_STRIDE, "Vertex no longer matches its stride");
+static_assert(sizeof(XMFLOAT3) == Packing::VERTEX_POSITION_STRIDE, "positions no longer match their stride");
+static_assert(sizeof(VertexAttributes) == Packing::VERTEX_ATTRIBUTES_STRIDE, "VertexAttributes no longer match their stride");
+static_assert(sizeof(QuantizedVertexAttributes) == Packing::VERTEX_QUANTIZED_ATTRIBUTES_STRIDE, "QuantizedVertexAttributes no longer match their stride");
+
+// The positions alone, for the acceleration structure and normal mapping, and the
+// attributes every hit reads, as floats or quantized to 8 bytes.
+void Scene::AllocateVertexStreams(ModelLoading::Model& model, bool quantize)
+{
+  const std::vector<Vertex>& vertices = model.vertices_vec;
+  if (vertices.empty())
+  {
+    return;
+  }
+
+  std::vector<XMFLOAT3> positions;
+  positions.reserve(vertices.size());
+  XMFLOAT2 uvMin = vertices[0].texCoord;
+  XMFLOAT2 uvMax = vertices[0].texCoord;
+  for (const Vertex& v : vertices)
+  {
+    positions.push_back(v.position);
+    uvMin = XMFLOAT2(std::min(uvMin.x, v.texCoord.x), std::min(uvMin.y, v.texCoord.y));
+    uvMax = XMFLOAT2(std::max(uvMax.x, v.texCoord.x), std::max(uvMax.y, v.texCoord.y));
+  }
+  AllocateBufferOnGpu(positions.data(), positions.size() * Packing::VERTEX_POSITION_STRIDE, &model.positions.resource,
+                      utilityCore::stringAndId(L"Positions", model.id));
+
+  model.uv_offset = uvMin;
+  model.uv_scale = XMFLOAT2(std::max(uvMax.x - uvMin.x, 1e-6f), std::max(uvMax.y - uvMin.y, 1e-6f));
+
+  if (quantize)
+  {
+    std::vector<QuantizedVertexAttributes> attributes;
+    attributes.reserve(vertices.size());
+    for (const Vertex& v : vertices)
+    {
+      QuantizedVertexAttributes packed;
+      packed.normal = Packing::PackOctahedralOrNone(Packing::float3(v.normal.x, v.normal.y, v.normal.z));
+      packed.texCoord = Packing::PackTexCoord(Packing::float2(v.texCoord.x, v.texCoord.y), Packing::float2(model.uv_offset.x, model.uv_offset.y),
+                                              Packing::float2(model.uv_scale.x, model.uv_scale.y));
+      attributes.push_back(packed);
+    }
+    AllocateBufferOnGpu(attributes.data(), attributes.size() * Packing::VERTEX_QUANTIZED_ATTRIBUTES_STRIDE, &model.attributes.resource,
+                        utilityCore::stringAndId(L"VertexAttributes", model.id));
+    model.attribute_format = Packing::VertexAttributesQuantized;
+  }
+  else
+  {
+    std::vector<VertexAttributes> attributes;
+    attributes.reserve(vertices.size());
+    for (const Vertex& v : vertices)
+    {
+      attributes.push_back({ v.normal, v.texCoord });
+    }
+    AllocateBufferOnGpu(attributes.data(), attributes.size() * Packing::VERTEX_ATTRIBUTES_STRIDE, &model.attributes.resource,
+                        utilityCore::stringAndId(L"VertexAttributes", model.id));
+    model.attribute_format = Packing::VertexAttributesFloat;
+  }
 }
 
+// COM for the loader threads, WIC decodes the images. The main thread keeps the
+// apartment it has, initializing it again only fails.
+struct LoaderComScope
+{
+  HRESULT result = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+  ~LoaderComScope()
+  {
+    if (SUCCEEDED(result))
+    {
+      CoUninitialize();
+    }
+  }
+};
+
 void Scene::ParseScene(std::string filename)
 {
   std::wstringstream wstr;
@@ -121,56 +206,118 @@ void Scene::ParseScene(std::string filename)
   wstr << L"------------------------------------------------------------------------------\n";
   OuputAndReset(wstr);
 
-  char* fname = (char*)filename.c_str();
-  fp_in.open(fname);
-  if (!fp_in.is_open()) {
+  PROFILE_SCOPE("Load scene");
+  const auto start = std::chrono::steady_clock::now();
+  SceneParser::SceneFile file;
+  std::string error;
+  if (!SceneFormat::ReadFile(filename, file, error)) {
     wstr << L"Error reading from file - aborting!\n";
     wstr << L"------------------------------------------------------------------------------\n";
     OuputAndReset(wstr);
-    throw;
-  }
-  while (fp_in.good()) {
-    string line;
-    utilityCore::safeGetline(fp_in, line);
-    if (!line.empty()) {
-      vector<string> tokens = utilityCore::tokenizeString(line);
-      std::string name{};
-      if (tokens.size() == 3)
-      {
-        name = tokens[2];
-      }
-      if (strcmp(tokens[0].c_str(), "MATERIAL") == 0) {
+    throw std::runtime_error(error);
+  }
+  for (const auto& warning : file.warnings) {
+    wstr << warning.c_str() << L"\n";
+  }
+  const auto parsed = std::chrono::steady_clock::now();
 
-        loadMaterial(tokens[1], name);
-        std::cout << " " << endl;
-      }
-      else if (strcmp(tokens[0].c_str(), "MODEL") == 0) {
-        loadModel(tokens[1]);
-        std::cout << " " << endl;
-      }
-      else if (strcmp(tokens[0].c_str(), "DIFFUSE_TEXTURE") == 0) {
-        loadDiffuseTexture(tokens[1]);
-        std::cout << " " << endl;
-      }
-      else if (strcmp(tokens[0].c_str(), "NORMAL_TEXTURE") == 0) {
-        loadNormalTexture(tokens[1]);
-        std::cout << " " << endl;
-      }
-      else if (strcmp(tokens[0].c_str(), "OBJECT") == 0) {
-        loadObject(tokens[1], name);
-        std::cout << " " << endl;
-      }
-      else if (strcmp(tokens[0].c_str(), "GLTF") == 0) {
-        ParseGLTF(tokens[1], false);
-        std::cout << " " << endl;
+  // models and images are read and decoded in parallel, the uploads go through the
+  // one command list in file order
+  struct LoadedAsset
+  {
+    ModelData model;
+    ImageData image;
+    std::string error;
+  };
+  std::vector<LoadedAsset> loaded(file.assets.size());
+  SceneParser::ForEachParallel(file.assets.size(), 0, [&](std::size_t i) {
+    const SceneParser::Asset& asset = file.assets[i];
+    Profiler::Scope scope(Profiler::IsEnabled() ? Profiler::Intern(asset.path) : nullptr);
+    try {
+      if (asset.kind == SceneParser::AssetKind::Model) {
+        ReadModel(asset.path, loaded[i].model);
       }
-      else if (strcmp(tokens[0].c_str(), "CAMERA") == 0) {
-        loadCamera();
-        programState->UpdateCameraMatrices();
+      else {
+        LoaderComScope com;
+        ReadImage(asset.path, loaded[i].image);
       }
     }
+    catch (const std::exception& e) {
+      loaded[i].error = asset.path + ": " + e.what();
+    }
+  });
+  const auto read = std::chrono::steady_clock::now();
+
+  PROFILE_SCOPE("Upload assets");
+  for (std::size_t i = 0; i < file.assets.size(); i++) {
+    const SceneParser::Asset& asset = file.assets[i];
+    if (!loaded[i].error.empty()) {
+      throw std::runtime_error(loaded[i].error);
+    }
+    if (asset.kind == SceneParser::AssetKind::Model) {
+      ModelLoading::Model newModel;
+      newModel.name = asset.path;
+      UploadModel(loaded[i].model, asset.id, newModel);
+    }
+    else {
+      ModelLoading::Texture newTexture;
+      newTexture.name = asset.path;
+      UploadTexture(loaded[i].image, asset.id, newTexture, asset.kind == SceneParser::AssetKind::NormalTexture);
+    }
+  }
+
+  for (const auto& material : file.materials) {
+    ModelLoading::MaterialResource newMat;
+    newMat.id = material.id;
+    newMat.name = material.name;
+    newMat.material.diffuse = XMFLOAT3(material.diffuse.x, material.diffuse.y, material.diffuse.z);
+    newMat.material.specular = XMFLOAT3(material.specular.x, material.specular.y, material.specular.z);
+    newMat.material.specularExp = material.specular_exponent;
+    newMat.material.reflectiveness = material.reflectiveness;
+    newMat.material.refractiveness = material.refractiveness;
+    newMat.material.eta = material.eta;
+    newMat.material.emittance = material.emittance;
+    newMat.material.metallic = material.metallic;
+    newMat.material.roughness = material.roughness;
+    materialMap.insert({ material.id, newMat });
+  }
+
+  // gltf files add their objects where their line was
+  std::size_t gltf = 0;
+  for (std::size_t i = 0; i <= file.objects.size(); i++) {
+    for (; gltf < file.gltf.size() && file.gltf[gltf].object_index == i; gltf++) {
+      ParseGLTF(file.gltf[gltf].path, false);
+    }
+    if (i < file.objects.size()) {
+      LinkObject(file.objects[i]);
+    }
+  }
+
+  if (file.has_camera) {
+    const SceneCore::Camera& sceneCamera = file.camera;
+    ModelLoading::Camera newCam;
+    newCam.fov = sceneCamera.fov;
+    newCam.eye = XMVectorSet(sceneCamera.eye.x, sceneCamera.eye.y, sceneCamera.eye.z, 1.0f);
+    newCam.lookat = XMVectorSet(sceneCamera.lookat.x, sceneCamera.lookat.y, sceneCamera.lookat.z, 1.0f);
+    newCam.up = XMVectorSet(sceneCamera.up.x, sceneCamera.up.y, sceneCamera.up.z, 0.0f);
+    newCam.maxDepth = sceneCamera.max_depth;
+    newCam.russian_roulette = sceneCamera.russian_roulette;
+    newCam.rr_min_depth = sceneCamera.rr_min_depth;
+    newCam.quantize_vertices = sceneCamera.quantize_vertices;
+    newCam.path = sceneCamera.path;
+    camera = std::move(newCam);
+    programState->UpdateCameraMatrices();
+  }
+  else {
+    FrameCamera(GetObjectBounds());
   }
 
+  const auto done = std::chrono::steady_clock::now();
+  auto Milliseconds = [](std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+  };
+  wstr << L"Parsed in " << Milliseconds(start, parsed) << L" ms, read " << file.assets.size() << L" models and textures in "
+       << Milliseconds(parsed, read) << L" ms, uploaded and linked " << objects.size() << L" objects in " << Milliseconds(read, done) << L" ms\n";
   wstr << L"Done loading the scene file!\n";
   wstr << L"------------------------------------------------------------------------------\n";
   OuputAndReset(wstr);
@@ -241,6 +388,7 @@ void Scene::ParseGLTF(std::string filename, bool make_light)
   {
     object_id = objects.size();
   }
+  const std::size_t first_object = objects.size();
 
   const tinygltf::Scene &scene = model.scenes[model.defaultScene];
   for (size_t i = 0; i < scene.nodes.size(); ++i) 
@@ -339,7 +487,9 @@ void Scene::ParseGLTF(std::string filename, bool make_light)
         new_model.verticesCount = vertices.size();
 
         AllocateBufferOnGpu(indices.data(), indices.size() * sizeof(Index), &new_model.indices.resource, utilityCore::stringAndId(L"Vertices", model_id));
-        AllocateBufferOnGpu(vertices.data(), vertices.size() * sizeof(Vertex), &new_model.vertices.resource, utilityCore::stringAndId(L"Indices", model_id));
+        new_model.vertices_vec = std::move(vertices);
+        new_model.indices_vec = std::move(indices);
+        new_model.UpdateBounds();
         modelMap.insert({model_id++, std::move(new_model)});
 
         //allocate object as well
@@ -375,16 +525,54 @@ void Scene::ParseGLTF(std::string filename, bool make_light)
           //memcpy(new_object.getTransform3x4(), matrix_data.data(), 12 * sizeof(float));
         }
 
-        //parse material TODO parse rest, for now, only get emittance
+        //parse material, pbrMetallicRoughness and emittance
         tinygltf::Accessor& material_accessor = model.accessors[primitive.material];
         ModelLoading::MaterialResource material_resource{};
         material_resource.was_loaded_from_gltf = true;
         material_resource.id = material_id;
         material_resource.name = material_accessor.name;
+
+        //the defaults of glTF, a rough white metal; never smoother than the microfacet lobe goes
+        material_resource.material.diffuse = XMFLOAT3(1.0f, 1.0f, 1.0f);
+        material_resource.material.metallic = 1.0f;
+        material_resource.material.roughness = 1.0f;
         
         const tinygltf::Material material = model.materials[primitive.material];
         for (const auto& value : material.values)
         {
+          if (value.first == "baseColorFactor" && value.second.number_array.size() >= 3)
+          {
+            const tinygltf::ColorValue color = value.second.ColorFactor();
+            material_resource.material.diffuse = XMFLOAT3(static_cast<float>(color[0]), static_cast<float>(color[1]), static_cast<float>(color[2]));
+          }
+          else if (value.first == "metallicFactor")
+          {
+            material_resource.material.metallic = static_cast<float>(value.second.Factor());
+          }
+          else if (value.first == "roughnessFactor")
+          {
+            material_resource.material.roughness = static_cast<float>(value.second.Factor());
+          }
+          //metallic in blue, roughness in green, goes with the diffuse textures
+          else if (value.first == "metallicRoughnessTexture")
+          {
+            const tinygltf::Texture& texture = model.textures[value.second.TextureIndex()];
+            const tinygltf::Image& image = model.images[texture.source];
+
+            std::experimental::filesystem::path file_path(filename);
+            std::experimental::filesystem::path parent_path = file_path.parent_path();
+            auto image_path = parent_path.append(image.uri).string();
+
+            ModelLoading::Texture new_texture;
+            new_texture.id = diffuse_texture_id;
+            new_texture.name = image_path;
+            new_texture.was_loaded_from_gltf = true;
+
+            LoadDiffuseTextureHelper(image_path, diffuse_texture_id++, new_texture);
+
+            new_object.textures.metallicRoughnessTex = &diffuseTextureMap[diffuse_texture_id - 1];
+          }
+
           //diffuse texture
           if (value.first == "baseColorTexture")
           {
@@ -451,6 +639,8 @@ void Scene::ParseGLTF(std::string filename, bool make_light)
           }
         }
 
+        material_resource.material.roughness = std::max(material_resource.material.roughness, Microfacet::MICROFACET_MIN_ROUGHNESS);
+
         //add material to map
         materialMap.insert({material_id++, std::move(material_resource)});
 
@@ -509,6 +699,10 @@ void Scene::ParseGLTF(std::string filename, bool make_light)
 
   if (make_light)
   {
+    //a glTF loaded on its own has neither a light nor a camera, both go by the bounds of its objects
+    const SceneStats::Bounds bounds = GetObjectBounds(first_object);
+    FrameCamera(bounds);
+
     // Cube indices.
     std::vector<Index> indices =
     {
@@ -573,8 +767,9 @@ void Scene::ParseGLTF(std::string filename, bool make_light)
 
     AllocateBufferOnGpu(indices.data(), indices.size() * sizeof(Index), &new_model.indices.resource,
                         utilityCore::stringAndId(L"Vertices", model_id));
-    AllocateBufferOnGpu(vertices.data(), vertices.size() * sizeof(Vertex), &new_model.vertices.resource,
-                        utilityCore::stringAndId(L"Indices", model_id));
+    new_model.vertices_vec = std::move(vertices);
+    new_model.indices_vec = std::move(indices);
+    new_model.UpdateBounds();
     modelMap.insert({model_id++, std::move(new_model)});
 
     //allocate object as well
@@ -586,9 +781,12 @@ void Scene::ParseGLTF(std::string filename, bool make_light)
     new_object.info_resource.info.material_offset = -1;
     new_object.model = &modelMap[new_object.info_resource.info.model_offset];
 
-    //default scale to 1.0...
-    new_object.translation = glm::vec3(0.0f, -5.0f, 2.0f) + objects[0].translation;
-    new_object.scale = glm::vec3(7.5f, 0.25f, 7.5f);
+    //a thin panel above the objects as wide as they are, the cube spans -1 to 1
+    const glm::vec3 center = bounds.Empty() ? glm::vec3(0.0f) : 0.5f * (bounds.min + bounds.max);
+    const glm::vec3 half_extent = bounds.Empty() ? glm::vec3(1.0f) : glm::max(0.5f * (bounds.max - bounds.min), glm::vec3(1e-3f));
+    const float size = glm::length(half_extent);
+    new_object.translation = glm::vec3(center.x, center.y + half_extent.y + 0.25f * size, center.z);
+    new_object.scale = glm::vec3(half_extent.x, size / 30.0f, half_extent.z);
 
     ModelLoading::MaterialResource material_resource{};
     material_resource.id = material_id;
@@ -607,119 +805,78 @@ void Scene::ParseGLTF(std::string filename, bool make_light)
   }
 }
 
-int Scene::loadObject(string objectid, std::string name) {
-	int id = atoi(objectid.c_str());
-
-	std::wstringstream wstr;
-	wstr << L"Loading OBJECT " << id << L"\n";
-	OuputAndReset(wstr);
-
-	ModelLoading::SceneObject newObject;
-        newObject.name = name;
-
-	string line;
-
-	// LOAD MODEL (MUST EXIST)
-	{
-		utilityCore::safeGetline(fp_in, line);
-		if (!line.empty() && fp_in.good()) {
-			wstr << L"----------------------------------------\n";
-			wstr << L"Linking model...\n";
-			OuputAndReset(wstr);
-
-			vector<string> tokens = utilityCore::tokenizeString(line);
-			int modelId = atoi(tokens[1].c_str());
-			newObject.model = &(modelMap.find(modelId)->second);
-		}
-	}
-
-	// LOAD TEXTURES IF EXIST
-	{
-		ModelLoading::TextureBundle texUsed;
-		texUsed.albedoTex = nullptr;
-		texUsed.normalTex = nullptr;
-		newObject.textures = texUsed;
-
-		// albedo tex
-		utilityCore::safeGetline(fp_in, line);
-		if (!line.empty() && fp_in.good()) {
-			vector<string> tokens = utilityCore::tokenizeString(line);
-			int texId = atoi(tokens[1].c_str());
-			if (texId != -1) {
-				wstr << L"----------------------------------------\n";
-				wstr << L"Linking albedo texture...\n";
-				OuputAndReset(wstr);
-				newObject.textures.albedoTex = &(diffuseTextureMap.find(texId)->second);
-			}
-		}
-
-		// normal tex
-		utilityCore::safeGetline(fp_in, line);
-		if (!line.empty() && fp_in.good()) {
-			vector<string> tokens = utilityCore::tokenizeString(line);
-			int texId = atoi(tokens[1].c_str());
-			if (texId != -1) {
-				wstr << L"----------------------------------------\n";
-				wstr << L"Linking normal texture...\n";
-				OuputAndReset(wstr);
-				newObject.textures.normalTex = &(normalTextureMap.find(texId)->second);
-			}
-		}
-	}
-	
-	// LOAD MATERIAL IF EXISTS
-	{
-		utilityCore::safeGetline(fp_in, line);
-		if (!line.empty() && fp_in.good()) {
-			vector<string> tokens = utilityCore::tokenizeString(line);
-			int matId = atoi(tokens[1].c_str());
-			if (matId != -1) {
-				wstr << L"----------------------------------------\n";
-				wstr << L"Linking material...\n";
-				OuputAndReset(wstr);
-				newObject.material = &(materialMap.find(matId)->second);
-			}
-		}
-	}
-
-	// LOAD TRANSFORM (MUST EXIST)
-	{
-		wstr << L"----------------------------------------\n";
-		wstr << L"Loading transform...\n";
-		OuputAndReset(wstr);
-		utilityCore::safeGetline(fp_in, line);
-		while (!line.empty() && fp_in.good()) {
-			vector<string> tokens = utilityCore::tokenizeString(line);
-
-			if (strcmp(tokens[0].c_str(), "trans") == 0) {
-				glm::vec3 t(atof(tokens[1].c_str()), atof(tokens[2].c_str()), atof(tokens[3].c_str()));
-				newObject.translation = t;
-			}
-			else if (strcmp(tokens[0].c_str(), "rotat") == 0) {
-				glm::vec3 r(atof(tokens[1].c_str()), atof(tokens[2].c_str()), atof(tokens[3].c_str()));
-				newObject.rotation = r;
-			}
-			else if (strcmp(tokens[0].c_str(), "scale") == 0) {
-				glm::vec3 s(atof(tokens[1].c_str()), atof(tokens[2].c_str()), atof(tokens[3].c_str()));
-				newObject.scale = s;
-			}
-
-			utilityCore::safeGetline(fp_in, line);
-		}
-	}
-
-	newObject.id = id;
-	objects.push_back(newObject);
-
-	wstr << L"----------------------------------------\n";
-	wstr << L"Done loading OBJECT " << id << L" !\n";
-	wstr << L"------------------------------------------------------------------------------\n";
-	OuputAndReset(wstr);
-
-	return 1;
+SceneStats::Bounds Scene::GetObjectBounds(std::size_t first)
+{
+  SceneStats::Bounds bounds;
+  for (std::size_t i = first; i < objects.size(); i++)
+  {
+    objects[i].getTransform3x4();
+    bounds.Add(objects[i].bounds);
+  }
+  return bounds;
 }
 
-void Scene::LoadModelHelper(std::string path, int id, ModelLoading::Model& model)
+void Scene::FrameCamera(const SceneStats::Bounds& bounds)
+{
+  glm::vec3 center(0.0f);
+  float radius = 10.0f;
+  if (!bounds.Empty())
+  {
+    center = 0.5f * (bounds.min + bounds.max);
+    radius = std::max(0.5f * glm::length(bounds.max - bounds.min), 1e-3f);
+  }
+
+  //from the front like the cameras of the scene files, where the bounding sphere fills the view
+  ModelLoading::Camera newCam;
+  const float distance = radius / std::sin(glm::radians(newCam.fov) * 0.5f);
+  newCam.eye = XMVectorSet(center.x, center.y, center.z - distance, 1.0f);
+  newCam.lookat = XMVectorSet(center.x, center.y, center.z, 1.0f);
+  newCam.up = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+  camera = std::move(newCam);
+}
+
+void Scene::LinkObject(const SceneCore::Object& object)
+{
+  ModelLoading::SceneObject newObject;
+  newObject.id = object.id;
+  newObject.name = object.name;
+
+  auto model = modelMap.find(object.mesh);
+  if (model == modelMap.end()) {
+    throw std::runtime_error("OBJECT " + std::to_string(object.id) + ": model " + std::to_string(object.mesh) + " does not exist");
+  }
+  newObject.model = &model->second;
+
+  ModelLoading::TextureBundle texUsed;
+  texUsed.albedoTex = nullptr;
+  texUsed.normalTex = nullptr;
+  texUsed.metallicRoughnessTex = nullptr;
+  auto albedo = diffuseTextureMap.find(object.albedo_texture);
+  if (albedo != diffuseTextureMap.end()) {
+    texUsed.albedoTex = &albedo->second;
+  }
+  auto normal = normalTextureMap.find(object.normal_texture);
+  if (normal != normalTextureMap.end()) {
+    texUsed.normalTex = &normal->second;
+  }
+  auto metallicRoughness = diffuseTextureMap.find(object.metallic_roughness_texture);
+  if (metallicRoughness != diffuseTextureMap.end()) {
+    texUsed.metallicRoughnessTex = &metallicRoughness->second;
+  }
+  newObject.textures = texUsed;
+
+  auto material = materialMap.find(object.material);
+  if (material != materialMap.end()) {
+    newObject.material = &material->second;
+  }
+
+  newObject.translation = object.translation;
+  newObject.rotation = object.rotation;
+  newObject.scale = object.scale;
+  objects.push_back(newObject);
+}
+
+void Scene::ReadModel(const std::string& path, ModelData& data)
 {
   // load mesh here
   std::vector<tinyobj::shape_t> shapes;
@@ -729,8 +886,8 @@ void Scene::LoadModelHelper(std::string path, int id, ModelLoading::Model& model
   std::string err;
   bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &err, path.c_str());
 
-  std::vector<Index> indices;
-  std::vector<Vertex> vertices;
+  std::vector<Index>& indices = data.indices;
+  std::vector<Vertex>& vertices = data.vertices;
 
   if (!ret)
   {
@@ -777,298 +934,222 @@ void Scene::LoadModelHelper(std::string path, int id, ModelLoading::Model& model
       }
       finalIdx += index_offset;
     }
+  }
+}
 
-    Vertex* vPtr = vertices.data();
-    Index* iPtr = indices.data();
-    auto device = programState->GetDeviceResources()->GetD3DDevice();
+void Scene::UploadModel(ModelData& data, int id, ModelLoading::Model& model)
+{
+  UploadModelBuffers(data, id, model);
+  std::pair<int, ModelLoading::Model> pair(id, model);
+  modelMap.insert(pair);
+}
 
-    //now on gpu
-    AllocateBufferOnGpu(iPtr, indices.size() * sizeof(Index), &model.indices.resource,
-                        utilityCore::stringAndId(L"Vertices", id));
-    AllocateBufferOnGpu(vPtr, vertices.size() * sizeof(Vertex), &model.vertices.resource,
-                        utilityCore::stringAndId(L"Indices", id));
+void Scene::UploadModelBuffers(ModelData& data, int id, ModelLoading::Model& model)
+{
+  //now on gpu, the vertices follow once the whole scene is parsed
+  AllocateBufferOnGpu(data.indices.data(), data.indices.size() * sizeof(Index), &model.indices.resource,
+                      utilityCore::stringAndId(L"Vertices", id));
 
-    model.verticesCount = vertices.size();
-    model.indicesCount = indices.size();
+  model.verticesCount = data.vertices.size();
+  model.indicesCount = data.indices.size();
 
-    model.vertices_vec = std::move(vertices);
-    model.indices_vec = std::move(indices);
+  model.vertices_vec = std::move(data.vertices);
+  model.indices_vec = std::move(data.indices);
+  model.UpdateBounds();
 
-    model.id = id;
-    std::pair<int, ModelLoading::Model> pair(id, model);
-    modelMap.insert(pair);
-  }
+  model.id = id;
 }
 
-void Scene::LoadDiffuseTextureHelper(std::string path, int id, ModelLoading::Texture& newTexture)
+void Scene::ReadImage(const std::string& path, ImageData& image)
 {
   // Load the image from file
-  D3D12_RESOURCE_DESC& textureDesc = newTexture.textureDesc;
-  int imageBytesPerRow;
-  BYTE* imageData;
-
   wstring wpath = utilityCore::string2wstring(path);
-  int imageSize = TextureLoader::LoadImageDataFromFile(&imageData, textureDesc, wpath.c_str(), imageBytesPerRow);
+  int imageSize = TextureLoader::LoadImageDataFromFile(&image.pixels, image.desc, wpath.c_str(), image.bytes_per_row);
 
   // make sure we have data
   if (imageSize <= 0)
   {
     return throw std::exception("Image size < 0");
   }
+}
 
-  AllocateBufferOnGpu(imageData, imageBytesPerRow, &(newTexture.texBuffer.resource), utilityCore::stringAndId(L"Diffuse Texture", id), &CD3DX12_RESOURCE_DESC(textureDesc));
-  ::free(imageData);
-
-  newTexture.id = id;
+void Scene::UploadTexture(ImageData& image, int id, ModelLoading::Texture& newTexture, bool normal)
+{
+  UploadTextureBuffer(image, id, newTexture, normal);
   std::pair<int, ModelLoading::Texture> pair(id, newTexture);
-  diffuseTextureMap.insert(pair);
+  (normal ? normalTextureMap : diffuseTextureMap).insert(pair);
 }
 
-void Scene::LoadNormalTextureHelper(std::string path, int id, ModelLoading::Texture& newTexture)
+void Scene::UploadTextureBuffer(ImageData& image, int id, ModelLoading::Texture& newTexture, bool normal)
 {
-  // Load the image from file
   D3D12_RESOURCE_DESC& textureDesc = newTexture.textureDesc;
-  int imageBytesPerRow;
-  BYTE* imageData;
-
-  wstring wpath = utilityCore::string2wstring(path);
-  int imageSize = TextureLoader::LoadImageDataFromFile(&imageData, textureDesc, wpath.c_str(), imageBytesPerRow);
-
-  // make sure we have data
-  if (imageSize <= 0)
-  {
-    return throw std::exception("Image size < 0");
-  }
-
-  AllocateBufferOnGpu(imageData, imageBytesPerRow, &(newTexture.texBuffer.resource), utilityCore::stringAndId(L"Normal Texture", id), &CD3DX12_RESOURCE_DESC(textureDesc));
-  ::free(imageData);
+  textureDesc = image.desc;
+  AllocateBufferOnGpu(image.pixels, image.bytes_per_row, &(newTexture.texBuffer.resource),
+                      utilityCore::stringAndId(normal ? L"Normal Texture" : L"Diffuse Texture", id), &CD3DX12_RESOURCE_DESC(textureDesc));
+  ::free(image.pixels);
+  image.pixels = nullptr;
 
   newTexture.id = id;
-  std::pair<int, ModelLoading::Texture> pair(id, newTexture);
-  normalTextureMap.insert(pair);
 }
 
-int Scene::loadModel(string modelid) {
-	int id = atoi(modelid.c_str());
-
-	std::wstringstream wstr;
-	wstr << L"Loading MODEL " << id << L"\n";
-	wstr << L"----------------------------------------\n";
-	OuputAndReset(wstr);
-
-	ModelLoading::Model newModel;
-
-	string line;
-
-	//load model type
-	utilityCore::safeGetline(fp_in, line);
-	if (!line.empty() && fp_in.good()) {
-		vector<string> tokens = utilityCore::tokenizeString(line);
-                newModel.name = tokens[1];
-                LoadModelHelper(tokens[1], id, newModel);
-        }
-
-	wstr << L"Done loading MODEL " << id << L" !\n";
-	wstr << L"------------------------------------------------------------------------------\n";
-	OuputAndReset(wstr);
-
-	return 1;
+void Scene::LoadModelHelper(std::string path, int id, ModelLoading::Model& model)
+{
+  ModelData data;
+  ReadModel(path, data);
+  UploadModel(data, id, model);
 }
 
-int Scene::loadDiffuseTexture(string texid) {
-	int id = atoi(texid.c_str());
-
-	std::wstringstream wstr;
-	wstr << L"Loading TEXTURE " << id << L"\n";
-	wstr << L"----------------------------------------\n";
-	OuputAndReset(wstr);
-
-	ModelLoading::Texture newTexture;
-
-	string line;
-
-	//load texture
-	utilityCore::safeGetline(fp_in, line);
-	if (!line.empty() && fp_in.good()) {
-		vector<string> tokens = utilityCore::tokenizeString(line);
-                newTexture.name = tokens[1];
-
-                LoadDiffuseTextureHelper(tokens[1], id, newTexture);
-	}
-
-	wstr << L"Done loading TEXTURE " << id << L" !\n";
-	wstr << L"------------------------------------------------------------------------------\n";
-	OuputAndReset(wstr);
-	return 1;
+void Scene::LoadDiffuseTextureHelper(std::string path, int id, ModelLoading::Texture& newTexture)
+{
+  ImageData image;
+  ReadImage(path, image);
+  UploadTexture(image, id, newTexture, false);
 }
 
-int Scene::loadNormalTexture(string texid) {
-	int id = atoi(texid.c_str());
-
-	std::wstringstream wstr;
-	wstr << L"Loading NORMAL TEXTURE " << id << L"\n";
-	wstr << L"----------------------------------------\n";
-	OuputAndReset(wstr);
-
-	ModelLoading::Texture newTexture;
-
-	string line;
+void Scene::LoadNormalTextureHelper(std::string path, int id, ModelLoading::Texture& newTexture)
+{
+  ImageData image;
+  ReadImage(path, image);
+  UploadTexture(image, id, newTexture, true);
+}
 
-	//load texture
-	utilityCore::safeGetline(fp_in, line);
-	if (!line.empty() && fp_in.good()) {
-		vector<string> tokens = utilityCore::tokenizeString(line);
-                newTexture.name = tokens[1];
+void Scene::BuildDependencyGraph(const std::string& sceneFile, HotReload::DependencyGraph& graph) const
+{
+  using HotReload::Kind;
+  auto FromGltf = [](const std::string& name) { return name.find(".gltf") != std::string::npos; };
 
-                LoadNormalTextureHelper(tokens[1], id, newTexture);
-	}
+  graph.Clear();
+  if (!sceneFile.empty())
+  {
+    graph.AddFile(sceneFile, { FromGltf(sceneFile) ? Kind::Gltf : Kind::Scene, 0 });
+  }
+  // every mesh of a GLTF file is a model named after the file, its textures come along
+  for (const auto& pair : modelMap)
+  {
+    graph.AddFile(pair.second.name, { FromGltf(pair.second.name) ? Kind::Gltf : Kind::Model, pair.first });
+  }
+  for (const auto& pair : diffuseTextureMap)
+  {
+    if (!pair.second.was_loaded_from_gltf)
+    {
+      graph.AddFile(pair.second.name, { Kind::DiffuseTexture, pair.first });
+    }
+  }
+  for (const auto& pair : normalTextureMap)
+  {
+    if (!pair.second.was_loaded_from_gltf)
+    {
+      graph.AddFile(pair.second.name, { Kind::NormalTexture, pair.first });
+    }
+  }
 
-	wstr << L"Done loading NORMAL TEXTURE " << id << L" !\n";
-	wstr << L"------------------------------------------------------------------------------\n";
-	OuputAndReset(wstr);
-	return 1;
+  for (const auto& object : objects)
+  {
+    const HotReload::Node node = { Kind::Object, object.id };
+    if (object.model != nullptr)
+    {
+      graph.AddDependent({ Kind::Model, object.model->id }, node);
+    }
+    if (object.textures.albedoTex != nullptr)
+    {
+      graph.AddDependent({ Kind::DiffuseTexture, object.textures.albedoTex->id }, node);
+    }
+    if (object.textures.metallicRoughnessTex != nullptr)
+    {
+      graph.AddDependent({ Kind::DiffuseTexture, object.textures.metallicRoughnessTex->id }, node);
+    }
+    if (object.textures.normalTex != nullptr)
+    {
+      graph.AddDependent({ Kind::NormalTexture, object.textures.normalTex->id }, node);
+    }
+  }
 }
 
-int Scene::loadMaterial(string matid, std::string name) {
-	int id = atoi(matid.c_str());
-
-	std::wstringstream wstr;
-	wstr << L"Loading MATERIAL " << id << L"\n";
-	wstr << L"----------------------------------------\n";
-	OuputAndReset(wstr);
-
-	ModelLoading::MaterialResource newMat;
-        newMat.name = name;
-	string line;
-
-	// LOAD RGB
-	{
-		utilityCore::safeGetline(fp_in, line);
-		if (!line.empty() && fp_in.good()) {
-			vector<string> tokens = utilityCore::tokenizeString(line);
-
-			newMat.material.diffuse = XMFLOAT3(atof(tokens[1].c_str()), atof(tokens[2].c_str()), atof(tokens[3].c_str()));
-		}
-	}
-
-	// LOAD SPEC
-	{
-		utilityCore::safeGetline(fp_in, line);
-		if (!line.empty() && fp_in.good()) {
-			vector<string> tokens = utilityCore::tokenizeString(line);
-
-			newMat.material.specular = XMFLOAT3(atof(tokens[1].c_str()), atof(tokens[2].c_str()), atof(tokens[3].c_str()));
-		}
-	}
-
-	// LOAD SPECEX
-	{
-		utilityCore::safeGetline(fp_in, line);
-		if (!line.empty() && fp_in.good()) {
-			vector<string> tokens = utilityCore::tokenizeString(line);
-
-			float exp(atof(tokens[1].c_str()));
-			newMat.material.specularExp = exp;
-		}
-	}
-
-	// LOAD REFL
-	{
-		utilityCore::safeGetline(fp_in, line);
-		if (!line.empty() && fp_in.good()) {
-			vector<string> tokens = utilityCore::tokenizeString(line);
-
-			float refl(atof(tokens[1].c_str()));
-			newMat.material.reflectiveness = refl;
-		}
-	}
-
-	// LOAD REFR
-	{
-		utilityCore::safeGetline(fp_in, line);
-		if (!line.empty() && fp_in.good()) {
-			vector<string> tokens = utilityCore::tokenizeString(line);
-
-			float refr(atof(tokens[1].c_str()));
-			newMat.material.refractiveness = refr;
-		}
-	}
-
-        // LOAD ETA
-	{
-		utilityCore::safeGetline(fp_in, line);
-		if (!line.empty() && fp_in.good()) {
-			vector<string> tokens = utilityCore::tokenizeString(line);
-
-			float eta(atof(tokens[1].c_str()));
-			newMat.material.eta = eta;
-		}
-	}
-
-
-	// LOAD EMITTANCE
-	{
-		utilityCore::safeGetline(fp_in, line);
-		if (!line.empty() && fp_in.good()) {
-			vector<string> tokens = utilityCore::tokenizeString(line);
-
-			float emit(atof(tokens[1].c_str()));
-			newMat.material.emittance = emit;
-		}
-	}
-
-	newMat.id = id;
-        std::pair<int, ModelLoading::MaterialResource> pair(id, newMat);
-	materialMap.insert(pair);
-
-	wstr << L"Done loading MATERIAL " << id << L" !\n";
-	wstr << L"------------------------------------------------------------------------------\n";
-	OuputAndReset(wstr);
-	return 1;
-}
+std::vector<std::string> Scene::ReloadAssets(const std::vector<HotReload::Node>& assets, std::vector<int>& reloadedModels)
+{
+  PROFILE_SCOPE("Reload assets");
+  struct ReloadedAsset
+  {
+    std::string path;
+    ModelData model;
+    ImageData image;
+    std::string error;
+  };
+  std::vector<ReloadedAsset> reloaded(assets.size());
+  for (std::size_t i = 0; i < assets.size(); i++) {
+    const HotReload::Node& asset = assets[i];
+    if (asset.kind == HotReload::Kind::Model) {
+      auto it = modelMap.find(asset.id);
+      reloaded[i].path = it == modelMap.end() ? std::string() : it->second.name;
+    }
+    else if (asset.kind == HotReload::Kind::DiffuseTexture || asset.kind == HotReload::Kind::NormalTexture) {
+      auto& textures = asset.kind == HotReload::Kind::NormalTexture ? normalTextureMap : diffuseTextureMap;
+      auto it = textures.find(asset.id);
+      reloaded[i].path = it == textures.end() ? std::string() : it->second.name;
+    }
+    if (reloaded[i].path.empty()) {
+      reloaded[i].error = std::string(HotReload::GetKindName(asset.kind)) + " " + std::to_string(asset.id) + " is no longer in the scene";
+    }
+  }
+
+  // read in parallel like ParseScene, a file still being written fails here and keeps the old data
+  SceneParser::ForEachParallel(assets.size(), 0, [&](std::size_t i) {
+    if (!reloaded[i].error.empty()) {
+      return;
+    }
+    try {
+      if (assets[i].kind == HotReload::Kind::Model) {
+        ReadModel(reloaded[i].path, reloaded[i].model);
+      }
+      else {
+        LoaderComScope com;
+        ReadImage(reloaded[i].path, reloaded[i].image);
+      }
+    }
+    catch (const std::exception& e) {
+      reloaded[i].error = reloaded[i].path + ": " + e.what();
+    }
+  });
+
+  // in place, the objects keep pointing at the same map entries and the shaders at the
+  // same descriptors, only the views in them are written again
+  std::vector<std::string> errors;
+  for (std::size_t i = 0; i < assets.size(); i++) {
+    const HotReload::Node& asset = assets[i];
+    if (!reloaded[i].error.empty()) {
+      errors.push_back(reloaded[i].error);
+    }
+    else if (asset.kind == HotReload::Kind::Model) {
+      ModelLoading::Model& model = modelMap[asset.id];
+      UploadModelBuffers(reloaded[i].model, asset.id, model);
+      AllocateVertexStreams(model, camera.quantize_vertices);
+      programState->CreateBufferSRV(&model.positions, model.verticesCount, Packing::VERTEX_POSITION_STRIDE,
+                                    programState->GetDescriptorIndex(model.positions.gpuDescriptorHandle));
+      programState->CreateBufferSRV(&model.indices, model.indicesCount * sizeof(Index) / 4, 0,
+                                    programState->GetDescriptorIndex(model.indices.gpuDescriptorHandle));
+      programState->CreateBufferSRV(&model.attributes, static_cast<UINT>(model.attributes.resource->GetDesc().Width / 4), 0,
+                                    programState->GetDescriptorIndex(model.attributes.gpuDescriptorHandle));
+      reloadedModels.push_back(asset.id);
+    }
+    else {
+      const bool normal = asset.kind == HotReload::Kind::NormalTexture;
+      ModelLoading::Texture& texture = (normal ? normalTextureMap : diffuseTextureMap)[asset.id];
+      UploadTextureBuffer(reloaded[i].image, asset.id, texture, normal);
+      CreateTextureSRV(texture, programState->GetDescriptorIndex(texture.texBuffer.gpuDescriptorHandle));
+    }
+  }
 
-int Scene::loadCamera() {
-	std::wstringstream wstr;
-	wstr << L"Loading CAMERA\n";
-	wstr << L"----------------------------------------\n";
-	OuputAndReset(wstr);
-
-	ModelLoading::Camera newCam;
-
-	// load static properties
-	for (int i = 0; i < 5; i++) {
-		string line;
-		utilityCore::safeGetline(fp_in, line);
-		vector<string> tokens = utilityCore::tokenizeString(line);
-                if (strcmp(tokens[0].c_str(), "fov") == 0) {
-                        newCam.fov = atof(tokens[1].c_str());
-		}
-		else if (strcmp(tokens[0].c_str(), "depth") == 0) {
-			newCam.maxDepth = atoi(tokens[1].c_str());
-		}
-                else if (strcmp(tokens[0].c_str(), "eye") == 0) {
-                        glm::vec3 eye(atof(tokens[1].c_str()), atof(tokens[2].c_str()), atof(tokens[3].c_str()));
-                        XMFLOAT3 xm_eye(eye.x, eye.y, eye.z);
-                        newCam.eye = XMLoadFloat3(&xm_eye);
-                }
-                else if (strcmp(tokens[0].c_str(), "lookat") == 0) {
-                        glm::vec3 look_at(atof(tokens[1].c_str()), atof(tokens[2].c_str()), atof(tokens[3].c_str()));
-                        XMFLOAT3 xm_look_at(look_at.x, look_at.y, look_at.z);
-                        newCam.lookat = XMLoadFloat3(&xm_look_at);
-                }
-                else if (strcmp(tokens[0].c_str(), "up") == 0) {
-                        glm::vec3 up(atof(tokens[1].c_str()), atof(tokens[2].c_str()), atof(tokens[3].c_str()));
-                        XMFLOAT3 xm_up(up.x, up.y, up.z);
-                        newCam.up = XMLoadFloat3(&xm_up);
-                }
-	}
-
-        camera = std::move(newCam);
-
-	wstr << L"Done loading CAMERA !n";
-	wstr << L"----------------------------------------\n";
-	OuputAndReset(wstr);
-	return 1;
+  //the attribute streams of a model were packed again, and its bounds changed
+  for (auto& object : objects) {
+    if (object.model != nullptr && std::find(reloadedModels.begin(), reloadedModels.end(), object.model->id) != reloadedModels.end()) {
+      Info& info = object.info_resource.info;
+      info.uv_offset = object.model->uv_offset;
+      info.uv_scale = object.model->uv_scale;
+      info.attribute_format = object.model->attribute_format;
+      object.transformBuilt = false;
+    }
+  }
+  return errors;
 }
 
 D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC& Scene::GetTopLevelDesc()
@@ -1223,6 +1304,237 @@ WRAPPED_GPU_POINTER Scene::GetWrappedGPUPointer(bool is_fallback, ComPtr<ID3D12R
         return programState->CreateFallbackWrappedPointer(m_topLevelAccelerationStructure.Get(), numBufferElements); 
 }
 
+void Scene::BuildLightList()
+{
+  lights.Clear();
+
+  for (auto& object : objects)
+  {
+    Info& info = object.info_resource.info;
+    info.light_offset = -1;
+
+    if (object.model != nullptr && object.material != nullptr && object.textures.albedoTex == nullptr)
+    {
+      const Material& material = object.material->material;
+      if (material.emittance > 0.0f && material.reflectiveness <= 0.0f && material.refractiveness <= 0.0f)
+      {
+        glm::mat4 transform = utilityCore::buildTransformationMatrix(object.translation, object.rotation, object.scale);
+        const glm::vec3 radiance(material.diffuse.x, material.diffuse.y, material.diffuse.z);
+        info.light_offset = lights.AddMesh(object.model->vertices_vec, object.model->indices_vec, transform, radiance);
+      }
+    }
+
+    if (object.info_resource.d3d12_resource.resource != nullptr)
+    {
+      void* mapped_data;
+      object.info_resource.d3d12_resource.resource->Map(0, nullptr, &mapped_data);
+      memcpy(mapped_data, &info, sizeof(Info));
+      object.info_resource.d3d12_resource.resource->Unmap(0, nullptr);
+    }
+  }
+
+  lights.Build();
+}
+
+SceneCore::SceneData Scene::BuildSceneCore() const
+{
+  SceneCore::SceneData scene;
+
+  for (const auto& pair : modelMap)
+  {
+    const ModelLoading::Model& model = pair.second;
+    SceneCore::Mesh& mesh = scene.meshes[pair.first];
+    mesh.id = model.id;
+    mesh.name = model.name;
+    mesh.vertices.reserve(model.vertices_vec.size());
+    for (const Vertex& v : model.vertices_vec)
+    {
+      SceneCore::Vertex vertex;
+      vertex.position = glm::vec3(v.position.x, v.position.y, v.position.z);
+      vertex.normal = glm::vec3(v.normal.x, v.normal.y, v.normal.z);
+      vertex.uv = glm::vec2(v.texCoord.x, v.texCoord.y);
+      mesh.vertices.push_back(vertex);
+    }
+    mesh.indices.assign(model.indices_vec.begin(), model.indices_vec.end());
+  }
+
+  // the GPU copies are not readable, so textures come from their files again
+  auto CopyTextures = [](const std::map<int, ModelLoading::Texture>& source, std::map<int, SceneCore::Texture>& destination)
+  {
+    for (const auto& pair : source)
+    {
+      SceneCore::Texture texture;
+      std::string error;
+      if (SceneCore::LoadTexture(pair.second.name, texture, error))
+      {
+        texture.id = pair.first;
+        texture.mirror = pair.second.sampler_offset == 1;
+        destination[pair.first] = std::move(texture);
+      }
+    }
+  };
+  CopyTextures(diffuseTextureMap, scene.diffuse_textures);
+  CopyTextures(normalTextureMap, scene.normal_textures);
+
+  for (const auto& pair : materialMap)
+  {
+    const Material& source = pair.second.material;
+    SceneCore::Material& material = scene.materials[pair.first];
+    material.id = pair.second.id;
+    material.name = pair.second.name;
+    material.diffuse = glm::vec3(source.diffuse.x, source.diffuse.y, source.diffuse.z);
+    material.specular = glm::vec3(source.specular.x, source.specular.y, source.specular.z);
+    material.specular_exponent = source.specularExp;
+    material.reflectiveness = source.reflectiveness;
+    material.refractiveness = source.refractiveness;
+    material.eta = source.eta;
+    material.emittance = source.emittance;
+    material.metallic = source.metallic;
+    material.roughness = source.roughness;
+  }
+
+  for (const auto& source : objects)
+  {
+    SceneCore::Object object;
+    object.id = source.id;
+    object.name = source.name;
+    object.mesh = source.model != nullptr ? source.model->id : -1;
+    object.albedo_texture = source.textures.albedoTex != nullptr ? source.textures.albedoTex->id : -1;
+    object.normal_texture = source.textures.normalTex != nullptr ? source.textures.normalTex->id : -1;
+    object.metallic_roughness_texture = source.textures.metallicRoughnessTex != nullptr ? source.textures.metallicRoughnessTex->id : -1;
+    object.material = source.material != nullptr ? source.material->id : -1;
+    object.translation = source.translation;
+    object.rotation = source.rotation;
+    object.scale = source.scale;
+    object.UpdateTransforms();
+    scene.objects.push_back(object);
+  }
+
+  XMFLOAT3 eye, lookat, up;
+  XMStoreFloat3(&eye, camera.eye);
+  XMStoreFloat3(&lookat, camera.lookat);
+  XMStoreFloat3(&up, camera.up);
+  scene.camera.fov = camera.fov;
+  scene.camera.eye = glm::vec3(eye.x, eye.y, eye.z);
+  scene.camera.lookat = glm::vec3(lookat.x, lookat.y, lookat.z);
+  scene.camera.up = glm::vec3(up.x, up.y, up.z);
+  scene.camera.max_depth = camera.maxDepth;
+  scene.camera.russian_roulette = camera.russian_roulette;
+  scene.camera.rr_min_depth = camera.rr_min_depth;
+  scene.camera.path = camera.path;
+
+  return scene;
+}
+
+SceneParser::SceneFile Scene::BuildSceneFile() const
+{
+  SceneParser::SceneFile file;
+  std::map<int, int> modelIds, diffuseTextureIds, normalTextureIds, materialIds;
+  std::vector<std::string> gltfPaths;
+  auto FromGltf = [](const std::string& name) { return name.find(".gltf") != std::string::npos; };
+  auto NewId = [](const std::map<int, int>& ids, int id) {
+    auto it = ids.find(id);
+    return it == ids.end() ? -1 : it->second;
+  };
+
+  for (const auto& pair : modelMap)
+  {
+    if (FromGltf(pair.second.name))
+    {
+      // every mesh of a GLTF file is a model named after the file
+      if (std::find(gltfPaths.begin(), gltfPaths.end(), pair.second.name) == gltfPaths.end())
+      {
+        gltfPaths.push_back(pair.second.name);
+      }
+      continue;
+    }
+    const int id = static_cast<int>(modelIds.size());
+    modelIds[pair.first] = id;
+    file.assets.push_back({ SceneParser::AssetKind::Model, id, pair.second.name });
+  }
+
+  auto AddTextures = [&](const std::map<int, ModelLoading::Texture>& textures, SceneParser::AssetKind kind, std::map<int, int>& ids)
+  {
+    for (const auto& pair : textures)
+    {
+      if (!pair.second.was_loaded_from_gltf)
+      {
+        const int id = static_cast<int>(ids.size());
+        ids[pair.first] = id;
+        file.assets.push_back({ kind, id, pair.second.name });
+      }
+    }
+  };
+  AddTextures(diffuseTextureMap, SceneParser::AssetKind::DiffuseTexture, diffuseTextureIds);
+  AddTextures(normalTextureMap, SceneParser::AssetKind::NormalTexture, normalTextureIds);
+
+  for (const auto& pair : materialMap)
+  {
+    if (pair.second.was_loaded_from_gltf)
+    {
+      continue;
+    }
+    const Material& source = pair.second.material;
+    SceneCore::Material material;
+    material.id = static_cast<int>(materialIds.size());
+    materialIds[pair.first] = material.id;
+    material.name = pair.second.name;
+    material.diffuse = glm::vec3(source.diffuse.x, source.diffuse.y, source.diffuse.z);
+    material.specular = glm::vec3(source.specular.x, source.specular.y, source.specular.z);
+    material.specular_exponent = source.specularExp;
+    material.reflectiveness = source.reflectiveness;
+    material.refractiveness = source.refractiveness;
+    material.eta = source.eta;
+    material.emittance = source.emittance;
+    material.metallic = source.metallic;
+    material.roughness = source.roughness;
+    file.materials.push_back(material);
+  }
+
+  for (const auto& source : objects)
+  {
+    if (FromGltf(source.name))
+    {
+      continue;
+    }
+    SceneCore::Object object;
+    object.id = static_cast<int>(file.objects.size());
+    object.name = source.name;
+    object.mesh = source.model != nullptr ? NewId(modelIds, source.model->id) : -1;
+    object.albedo_texture = source.textures.albedoTex != nullptr ? NewId(diffuseTextureIds, source.textures.albedoTex->id) : -1;
+    object.normal_texture = source.textures.normalTex != nullptr ? NewId(normalTextureIds, source.textures.normalTex->id) : -1;
+    object.metallic_roughness_texture =
+      source.textures.metallicRoughnessTex != nullptr ? NewId(diffuseTextureIds, source.textures.metallicRoughnessTex->id) : -1;
+    object.material = source.material != nullptr ? NewId(materialIds, source.material->id) : -1;
+    object.translation = source.translation;
+    object.rotation = source.rotation;
+    object.scale = source.scale;
+    file.objects.push_back(object);
+  }
+
+  for (const std::string& path : gltfPaths)
+  {
+    file.gltf.push_back({ path, file.objects.size() });
+  }
+
+  XMFLOAT3 eye, lookat, up;
+  XMStoreFloat3(&eye, camera.eye);
+  XMStoreFloat3(&lookat, camera.lookat);
+  XMStoreFloat3(&up, camera.up);
+  file.camera.fov = camera.fov;
+  file.camera.eye = glm::vec3(eye.x, eye.y, eye.z);
+  file.camera.lookat = glm::vec3(lookat.x, lookat.y, lookat.z);
+  file.camera.up = glm::vec3(up.x, up.y, up.z);
+  file.camera.max_depth = camera.maxDepth;
+  file.camera.russian_roulette = camera.russian_roulette;
+  file.camera.rr_min_depth = camera.rr_min_depth;
+  file.camera.quantize_vertices = camera.quantize_vertices;
+  file.camera.path = camera.path;
+  file.has_camera = true;
+
+  return file;
+}
+
 void Scene::FinalizeAS()
 {
   
@@ -1240,37 +1552,80 @@ void Scene::FinalizeAS()
   }
 
   void Scene::BuildAllAS(bool is_fallback, ComPtr<ID3D12RaytracingFallbackDevice> m_fallbackDevice,
-      ComPtr<ID3D12Device5> m_dxrDevice, ComPtr<ID3D12RaytracingFallbackCommandList> fbCmdLst, ComPtr<ID3D12GraphicsCommandList5> rtxCmdList) {
+      ComPtr<ID3D12Device5> m_dxrDevice, ComPtr<ID3D12RaytracingFallbackCommandList> fbCmdLst, ComPtr<ID3D12GraphicsCommandList5> rtxCmdList,
+      const std::vector<int>* models) {
     auto commandList =
         programState->GetDeviceResources()->GetCommandList();
     auto device = programState->GetDeviceResources()->GetD3DDevice();
+    std::vector<ModelLoading::Model*> bottomLevels;
+    for (auto& model_pair : modelMap)
+    {
+      if (models == nullptr || std::find(models->begin(), models->end(), model_pair.first) != models->end())
+      {
+        bottomLevels.push_back(&model_pair.second);
+      }
+    }
+    ComPtr<ID3D12Resource> compactedSizes;
+    ComPtr<ID3D12Resource> compactedSizesReadback;
     if (is_fallback) {
       // Set the descriptor heaps to be used during acceleration structure build
       // for the Fallback Layer.
+        programState->CommitDescriptors();
         ID3D12DescriptorHeap *pDescriptorHeaps[] = { programState->GetDescriptorHeap().Get() };
         fbCmdLst->SetDescriptorHeaps(ARRAYSIZE(pDescriptorHeaps), pDescriptorHeaps);
 
-        for (auto& model_pair : modelMap)
+        for (ModelLoading::Model* bottomLevel : bottomLevels)
         {
-          ModelLoading::Model &model = model_pair.second;
+          ModelLoading::Model &model = *bottomLevel;
           fbCmdLst.Get()->BuildRaytracingAccelerationStructure(&model.GetBottomLevelBuildDesc(), 0, nullptr);
           commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(model.GetBottomAS(is_fallback, device, m_fallbackDevice, m_dxrDevice).Get()));
         }
         fbCmdLst->BuildRaytracingAccelerationStructure(&GetTopLevelDesc(), 0, nullptr);
     } else {
-        for (auto& model_pair : modelMap)
+        // The builds write the compacted size of every bottom level for the scene statistics,
+        // the bottom levels themselves are not compacted.
+        const UINT64 compactedSizeBytes = sizeof(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE_DESC);
+        const UINT64 compactedSizesBytes = std::max<UINT64>(bottomLevels.size(), 1) * compactedSizeBytes;
+        AllocateUAVBuffer(device, compactedSizesBytes, &compactedSizes, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, L"CompactedSizes");
+        auto readbackDesc = CD3DX12_RESOURCE_DESC::Buffer(compactedSizesBytes);
+        ThrowIfFailed(device->CreateCommittedResource(
+            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK), D3D12_HEAP_FLAG_NONE, &readbackDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&compactedSizesReadback)));
+
+        UINT64 offset = 0;
+        for (ModelLoading::Model* bottomLevel : bottomLevels)
         {
-           ModelLoading::Model &model = model_pair.second;
-          rtxCmdList.Get()->BuildRaytracingAccelerationStructure(&model.GetBottomLevelBuildDesc(), 0, nullptr);
+          ModelLoading::Model &model = *bottomLevel;
+          D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_DESC compactedSizeDesc = {};
+          compactedSizeDesc.InfoType = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE;
+          compactedSizeDesc.DestBuffer = compactedSizes->GetGPUVirtualAddress() + offset;
+          offset += compactedSizeBytes;
+          rtxCmdList.Get()->BuildRaytracingAccelerationStructure(&model.GetBottomLevelBuildDesc(), 1, &compactedSizeDesc);
           commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(model.GetBottomAS(is_fallback, device, m_fallbackDevice, m_dxrDevice).Get()));
         }
        rtxCmdList->BuildRaytracingAccelerationStructure(&GetTopLevelDesc(), 0, nullptr);
+
+        commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(compactedSizes.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE));
+        commandList->CopyResource(compactedSizesReadback.Get(), compactedSizes.Get());
     }
     // Kick off acceleration structure construction.
     programState->GetDeviceResources()->ExecuteCommandList();
 
     // Wait for GPU to finish as the locally created temporary GPU resources will get released once we go out of scope.
     programState->GetDeviceResources()->WaitForGpu();
+
+    if (compactedSizesReadback)
+    {
+      void* mapped_data;
+      ThrowIfFailed(compactedSizesReadback->Map(0, nullptr, &mapped_data));
+      const D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE_DESC* compacted =
+        static_cast<const D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE_DESC*>(mapped_data);
+      for (ModelLoading::Model* bottomLevel : bottomLevels)
+      {
+        bottomLevel->compacted_size = (compacted++)->CompactedSizeInBytes;
+      }
+      D3D12_RANGE noWriteRange = { 0, 0 };
+      compactedSizesReadback->Unmap(0, &noWriteRange);
+    }
 }
 
 void Scene::AllocateResourcesInDescriptorHeap()
@@ -1280,7 +1635,7 @@ void Scene::AllocateResourcesInDescriptorHeap()
   for (auto& model_pair : modelMap)
   {
     auto& newModel = model_pair.second;
-    programState->CreateBufferSRV(&newModel.vertices, newModel.verticesCount, sizeof(Vertex));
+    programState->CreateBufferSRV(&newModel.positions, newModel.verticesCount, Packing::VERTEX_POSITION_STRIDE);
   }
 
   for (auto& model_pair : modelMap)
@@ -1289,6 +1644,13 @@ void Scene::AllocateResourcesInDescriptorHeap()
     programState->CreateBufferSRV(&newModel.indices, newModel.indicesCount * sizeof(Index) / 4, 0);
   }
 
+  //raw, the shader picks the layout from the attribute format of the info
+  for (auto& model_pair : modelMap)
+  {
+    auto& newModel = model_pair.second;
+    programState->CreateBufferSRV(&newModel.attributes, static_cast<UINT>(newModel.attributes.resource->GetDesc().Width / 4), 0);
+  }
+
   for (auto& object : objects)
   {
     ModelLoading::InfoResource& info_resource = object.info_resource;
@@ -1298,9 +1660,15 @@ void Scene::AllocateResourcesInDescriptorHeap()
     info_resource.info.diffuse_sampler_offset = 0;
     info_resource.info.normal_sampler_offset = 0;
 
+    info_resource.info.uv_offset = XMFLOAT2(0.0f, 0.0f);
+    info_resource.info.uv_scale = XMFLOAT2(1.0f, 1.0f);
+    info_resource.info.attribute_format = Packing::VertexAttributesFloat;
     if(object.model != nullptr)
     {
       info_resource.info.model_offset = object.model->id;
+      info_resource.info.uv_offset = object.model->uv_offset;
+      info_resource.info.uv_scale = object.model->uv_scale;
+      info_resource.info.attribute_format = object.model->attribute_format;
     }
 
     if (object.textures.albedoTex != nullptr)
@@ -1315,6 +1683,13 @@ void Scene::AllocateResourcesInDescriptorHeap()
       info_resource.info.normal_sampler_offset = object.textures.normalTex->sampler_offset;
     }
 
+    info_resource.info.metallic_roughness_sampler_offset = 0;
+    if (object.textures.metallicRoughnessTex != nullptr)
+    {
+      info_resource.info.texture_metallic_roughness_offset = object.textures.metallicRoughnessTex->id;
+      info_resource.info.metallic_roughness_sampler_offset = object.textures.metallicRoughnessTex->sampler_offset;
+    }
+
     if (object.material != nullptr)
     {
       info_resource.info.material_offset = object.material->id;
@@ -1349,7 +1724,7 @@ void Scene::AllocateResourcesInDescriptorHeap()
     info_resource.d3d12_resource.resource->SetName(
         utilityCore::stringAndId(L"InfoResourceObject ", object.id).c_str());
 
-    UINT descriptorIndex = programState->AllocateDescriptor(&info_resource.d3d12_resource.cpuDescriptorHandle);
+    UINT descriptorIndex = programState->AllocateDescriptor(&info_resource.d3d12_resource.cpuDescriptorHandle, DescriptorAllocator::RangeObjects);
     info_resource.d3d12_resource.gpuDescriptorHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(programState->GetDescriptorHeap()->GetGPUDescriptorHandleForHeapStart(), descriptorIndex, *programState->GetDescriptorSize());
 
     // create SRV descriptor
@@ -1390,7 +1765,7 @@ void Scene::AllocateResourcesInDescriptorHeap()
     material.d3d12_material_resource.resource->SetName(
         utilityCore::stringAndId(L"Material ", material_id).c_str());
 
-    UINT descriptorIndex = programState->AllocateDescriptor(&material.d3d12_material_resource.cpuDescriptorHandle);
+    UINT descriptorIndex = programState->AllocateDescriptor(&material.d3d12_material_resource.cpuDescriptorHandle, DescriptorAllocator::RangeMaterials);
     material.d3d12_material_resource.gpuDescriptorHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(programState->GetDescriptorHeap()->GetGPUDescriptorHandleForHeapStart(), descriptorIndex, *programState->GetDescriptorSize());
 
     // create SRV descriptor
@@ -1413,36 +1788,250 @@ void Scene::AllocateResourcesInDescriptorHeap()
   //allocate GPU memory for textures into diffuse/normals
   for (auto& texture_pair : diffuseTextureMap)
   {
-    auto &newTexture = texture_pair.second;
-    UINT descriptorIndex = programState->AllocateDescriptor(&newTexture.texBuffer.cpuDescriptorHandle);
+    CreateTextureSRV(texture_pair.second);
+  }
 
-    // create SRV descriptor
-    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-    srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-    srvDesc.Format = newTexture.textureDesc.Format;
-    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-    srvDesc.Texture2D.MipLevels = 1;
-    device->CreateShaderResourceView(newTexture.texBuffer.resource.Get(), &srvDesc, newTexture.texBuffer.cpuDescriptorHandle);
+  for (auto& texture_pair : normalTextureMap)
+  {
+    CreateTextureSRV(texture_pair.second);
+  }
+}
+
+void Scene::CreateTextureSRV(ModelLoading::Texture& texture, UINT descriptorIndex)
+{
+  auto device = programState->GetDeviceResources()->GetD3DDevice();
 
-    // used to bind to the root signature
-    newTexture.texBuffer.gpuDescriptorHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(programState->GetDescriptorHeap()->GetGPUDescriptorHandleForHeapStart(), descriptorIndex, *programState->GetDescriptorSize());
+  if (descriptorIndex == UINT_MAX)
+  {
+    descriptorIndex = programState->AllocateDescriptor(&texture.texBuffer.cpuDescriptorHandle, DescriptorAllocator::RangeTextures);
+  }
+  else
+  {
+    texture.texBuffer.cpuDescriptorHandle = programState->GetDescriptorForWriting(descriptorIndex);
   }
 
-  for (auto& texture_pair : normalTextureMap)
+  // create SRV descriptor
+  D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+  srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+  srvDesc.Format = texture.textureDesc.Format;
+  srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+  srvDesc.Texture2D.MipLevels = 1;
+  device->CreateShaderResourceView(texture.texBuffer.resource.Get(), &srvDesc, texture.texBuffer.cpuDescriptorHandle);
+
+  // used to bind to the root signature
+  texture.texBuffer.gpuDescriptorHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(programState->GetDescriptorHeap()->GetGPUDescriptorHandleForHeapStart(), descriptorIndex, *programState->GetDescriptorSize());
+}
+
+namespace {
+
+// The formats the texture loaders produce, others go by their number.
+std::string GetFormatName(DXGI_FORMAT format)
+{
+  switch (format)
   {
-    auto &newTexture = texture_pair.second;
-    UINT descriptorIndex = programState->AllocateDescriptor(&newTexture.texBuffer.cpuDescriptorHandle);
+  case DXGI_FORMAT_R32G32B32A32_FLOAT: return "R32G32B32A32_FLOAT";
+  case DXGI_FORMAT_R16G16B16A16_FLOAT: return "R16G16B16A16_FLOAT";
+  case DXGI_FORMAT_R16G16B16A16_UNORM: return "R16G16B16A16_UNORM";
+  case DXGI_FORMAT_R10G10B10A2_UNORM: return "R10G10B10A2_UNORM";
+  case DXGI_FORMAT_R8G8B8A8_UNORM: return "R8G8B8A8_UNORM";
+  case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB: return "R8G8B8A8_UNORM_SRGB";
+  case DXGI_FORMAT_B8G8R8A8_UNORM: return "B8G8R8A8_UNORM";
+  case DXGI_FORMAT_B8G8R8X8_UNORM: return "B8G8R8X8_UNORM";
+  case DXGI_FORMAT_B5G5R5A1_UNORM: return "B5G5R5A1_UNORM";
+  case DXGI_FORMAT_B5G6R5_UNORM: return "B5G6R5_UNORM";
+  case DXGI_FORMAT_R32_FLOAT: return "R32_FLOAT";
+  case DXGI_FORMAT_R16_FLOAT: return "R16_FLOAT";
+  case DXGI_FORMAT_R16_UNORM: return "R16_UNORM";
+  case DXGI_FORMAT_R8_UNORM: return "R8_UNORM";
+  case DXGI_FORMAT_A8_UNORM: return "A8_UNORM";
+  default: return "DXGI_FORMAT " + std::to_string(static_cast<int>(format));
+  }
+}
 
-    // create SRV descriptor
-    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-    srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-    srvDesc.Format = newTexture.textureDesc.Format;
-    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-    srvDesc.Texture2D.MipLevels = 1;
-    device->CreateShaderResourceView(newTexture.texBuffer.resource.Get(), &srvDesc, newTexture.texBuffer.cpuDescriptorHandle);
+UINT64 GetBufferBytes(const D3DBuffer& buffer)
+{
+  return buffer.resource ? buffer.resource->GetDesc().Width : 0;
+}
 
-    // used to bind to the root signature
-    newTexture.texBuffer.gpuDescriptorHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(programState->GetDescriptorHeap()->GetGPUDescriptorHandleForHeapStart(), descriptorIndex, *programState->GetDescriptorSize());
+}
+
+static_assert(sizeof(Info) == SceneStats::c_infoBytes, "SceneStats::c_infoBytes is sizeof(Info)");
+static_assert(sizeof(Material) == SceneStats::c_materialBytes, "SceneStats::c_materialBytes is sizeof(Material)");
+
+SceneStats::Report Scene::BuildStats(bool is_fallback) const
+{
+  auto device = programState->GetDeviceResources()->GetD3DDevice();
+
+  SceneStats::Report report;
+  report.scene = programState->p_sceneFileName;
+  report.source = is_fallback ? "fallback" : "dxr";
+  const std::string prebuild = is_fallback ? "fallback prebuild info" : "dxr prebuild info";
+
+  for (const auto& model_pair : modelMap)
+  {
+    const ModelLoading::Model& model = model_pair.second;
+    SceneStats::Model stats;
+    stats.id = model.id;
+    stats.name = model.name;
+    stats.triangles = model.indices_vec.size() / 3;
+    SceneStats::CountVertices(model.vertices_vec.data(), model.vertices_vec.size(), sizeof(Vertex), stats);
+    stats.vertex_bytes = GetBufferBytes(model.positions) + GetBufferBytes(model.attributes);
+    stats.index_bytes = GetBufferBytes(model.indices);
+    if (model.bottom_level_prebuild_info_allocated)
+    {
+      stats.blas.source = prebuild;
+      stats.blas.result_bytes = model.bottom_level_prebuild_info.ResultDataMaxSizeInBytes;
+      stats.blas.scratch_bytes = model.bottom_level_prebuild_info.ScratchDataSizeInBytes;
+      stats.blas.compacted_bytes = model.compacted_size;
+    }
+    report.models.push_back(std::move(stats));
+  }
+  if (top_level_prebuild_info_allocated)
+  {
+    report.tlas.source = prebuild;
+    report.tlas.result_bytes = top_level_prebuild_info.ResultDataMaxSizeInBytes;
+    report.tlas.scratch_bytes = top_level_prebuild_info.ScratchDataSizeInBytes;
   }
 
+  // What the device allocates for every texture and what each mip holds without the row padding of the copies.
+  auto AddTextures = [&](const std::map<int, ModelLoading::Texture>& textures, const char* kind) {
+    for (const auto& texture_pair : textures)
+    {
+      const ModelLoading::Texture& texture = texture_pair.second;
+      const D3D12_RESOURCE_DESC& desc = texture.textureDesc;
+      SceneStats::Texture stats;
+      stats.id = texture.id;
+      stats.name = texture.name;
+      stats.kind = kind;
+      stats.format = GetFormatName(desc.Format);
+      stats.width = static_cast<std::uint32_t>(desc.Width);
+      stats.height = desc.Height;
+      for (UINT mip = 0; mip < std::max<UINT>(desc.MipLevels, 1); mip++)
+      {
+        UINT rows = 0;
+        UINT64 rowBytes = 0;
+        device->GetCopyableFootprints(&desc, mip, 1, 0, nullptr, &rows, &rowBytes, nullptr);
+        stats.mip_bytes.push_back(rowBytes * rows * desc.DepthOrArraySize);
+      }
+      stats.bytes = device->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes;
+      report.textures.push_back(std::move(stats));
+    }
+  };
+  AddTextures(diffuseTextureMap, "diffuse");
+  AddTextures(normalTextureMap, "normal");
+
+  report.constant_buffers.push_back(SceneStats::GetConstantBuffers("Info", static_cast<unsigned int>(objects.size()), sizeof(Info)));
+  report.constant_buffers.push_back(SceneStats::GetConstantBuffers("Material", static_cast<unsigned int>(materialMap.size()), sizeof(Material)));
+  SceneStats::AddDescriptors(report, programState->GetDescriptorAllocator());
+
+  for (const auto& object : objects)
+  {
+    SceneStats::Object stats;
+    stats.id = object.id;
+    stats.name = object.name;
+    if (object.textures.albedoTex != nullptr)
+    {
+      stats.diffuse_texture = object.textures.albedoTex->id;
+    }
+    if (object.textures.metallicRoughnessTex != nullptr)
+    {
+      stats.metallic_roughness_texture = object.textures.metallicRoughnessTex->id;
+    }
+    if (object.textures.normalTex != nullptr)
+    {
+      stats.normal_texture = object.textures.normalTex->id;
+    }
+    if (object.model != nullptr)
+    {
+      stats.model = object.model->id;
+      stats.bounds = object.bounds;
+    }
+    report.objects.push_back(std::move(stats));
+  }
+
+  SceneStats::Finish(report);
+  return report;
+}
+
+std::vector<std::string> Scene::AnalyzeFallbackBvh(SceneStats::Report& report)
+{
+  auto device = programState->GetDeviceResources()->GetD3DDevice();
+  auto commandList = programState->GetDeviceResources()->GetCommandList();
+  auto commandAllocator = programState->GetDeviceResources()->GetCommandAllocator();
+
+  // model -1 is the top level
+  struct Readback
+  {
+    int model;
+    ID3D12Resource* source;
+    ComPtr<ID3D12Resource> buffer;
+    UINT64 size;
+  };
+  std::vector<Readback> readbacks;
+  for (auto& model_pair : modelMap)
+  {
+    if (model_pair.second.is_m_bottomLevelAccelerationStructure_allocated)
+    {
+      readbacks.push_back({ model_pair.first, model_pair.second.m_bottomLevelAccelerationStructure.Get(), nullptr, 0 });
+    }
+  }
+  if (m_topLevelAccelerationStructure)
+  {
+    readbacks.push_back({ -1, m_topLevelAccelerationStructure.Get(), nullptr, 0 });
+  }
+  if (readbacks.empty())
+  {
+    return { "no acceleration structures are built" };
+  }
+
+  // the fallback layer keeps them as unordered access buffers
+  commandList->Reset(commandAllocator, nullptr);
+  for (Readback& readback : readbacks)
+  {
+    readback.size = readback.source->GetDesc().Width;
+    ThrowIfFailed(device->CreateCommittedResource(
+      &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK), D3D12_HEAP_FLAG_NONE, &CD3DX12_RESOURCE_DESC::Buffer(readback.size),
+      D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&readback.buffer)));
+    commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(readback.source, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE));
+    commandList->CopyBufferRegion(readback.buffer.Get(), 0, readback.source, 0, readback.size);
+    commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(readback.source, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
+  }
+  programState->GetDeviceResources()->ExecuteCommandList();
+  programState->GetDeviceResources()->WaitForGpu();
+
+  std::vector<std::string> errors;
+  for (Readback& readback : readbacks)
+  {
+    SceneStats::AccelerationStructure* structure = readback.model < 0 ? &report.tlas : nullptr;
+    for (SceneStats::Model& model : report.models)
+    {
+      if (readback.model >= 0 && model.id == readback.model)
+      {
+        structure = &model.blas;
+      }
+    }
+    const std::string name = readback.model < 0 ? std::string("top level") : "model " + std::to_string(readback.model);
+    if (structure == nullptr)
+    {
+      errors.push_back(name + ": not in the statistics");
+      continue;
+    }
+
+    void* mapped_data;
+    ThrowIfFailed(readback.buffer->Map(0, nullptr, &mapped_data));
+    BvhQuality::Tree tree;
+    std::string error;
+    if (BvhQuality::FromFallback(mapped_data, static_cast<std::size_t>(readback.size), readback.model < 0, tree, error))
+    {
+      structure->quality = BvhQuality::Analyze(tree);
+      structure->analyzed = true;
+    }
+    else
+    {
+      errors.push_back(name + ": " + error);
+    }
+    D3D12_RANGE noWriteRange = { 0, 0 };
+    readback.buffer->Unmap(0, &noWriteRange);
+  }
+  return errors;
 }
@@ -7,6 +7,11 @@
 #include <vector>
 
 #include "Model.h"
+#include "LightList.h"
+#include "SceneCore.h"
+#include "SceneParser.h"
+#include "HotReload.h"
+#include "SceneStats.h"
 
 using namespace std;
 
@@ -14,7 +19,24 @@ class D3D12RaytracingSimpleLighting;
 
 class Scene {
 public:
-  ifstream fp_in;
+  // A model or image read from its file. Reading is safe on any thread, the uploads
+  // that turn them into the resources of modelMap and the texture maps are not.
+  struct ModelData
+  {
+    std::vector<Vertex> vertices;
+    std::vector<Index> indices;
+  };
+  struct ImageData
+  {
+    ImageData() = default;
+    ~ImageData() { ::free(pixels); }
+    ImageData(const ImageData&) = delete;
+    ImageData& operator=(const ImageData&) = delete;
+
+    BYTE* pixels = nullptr;
+    D3D12_RESOURCE_DESC desc{};
+    int bytes_per_row = 0;
+  };
 
   void AllocateBufferOnGpu(void *pData, UINT64 width, ID3D12Resource **ppResource, std::wstring resource_name, CD3DX12_RESOURCE_DESC* resource_desc_ptr = nullptr);
 
@@ -23,14 +45,22 @@ public:
   void ParseGLTF(std::string filename, bool make_light = true);
   void ParseScene(std::string filename);
 
-  int loadMaterial(string materialid, std::string name = "");
-  int loadDiffuseTexture(string texid);
-  int loadNormalTexture(string texid);
-  int loadModel(string modelid);
-  int loadObject(string objectid, std::string name = "");
-  int loadCamera();
+  static void ReadModel(const std::string& path, ModelData& data);
+  static void ReadImage(const std::string& path, ImageData& image);
+  void UploadModel(ModelData& data, int id, ModelLoading::Model& model);
+  void UploadTexture(ImageData& image, int id, ModelLoading::Texture& newTexture, bool normal);
+  // The GPU side of UploadModel and UploadTexture without adding to the maps, replaces
+  // the buffers of an asset that is there already.
+  void UploadModelBuffers(ModelData& data, int id, ModelLoading::Model& model);
+  void UploadTextureBuffer(ImageData& image, int id, ModelLoading::Texture& newTexture, bool normal);
+  void LinkObject(const SceneCore::Object& object);
+  // The world space bounds of the objects from first on, builds their transforms.
+  SceneStats::Bounds GetObjectBounds(std::size_t first = 0);
+  // A camera in front of bounds from where they fill the view, for scenes without one.
+  void FrameCamera(const SceneStats::Bounds& bounds);
 
   void LoadModelHelper(std::string path, int id, ModelLoading::Model& model);
+  void AllocateVertexStreams(ModelLoading::Model& model, bool quantize);
   void LoadDiffuseTextureHelper(std::string path, int id, ModelLoading::Texture& newTexture);
   void LoadNormalTextureHelper(std::string path, int id, ModelLoading::Texture& newTexture);
 
@@ -62,13 +92,49 @@ public:
 
   void FinalizeAS();
 
+  // Builds the bottom levels of every model, or only of models if given, and the top level.
   void BuildAllAS(bool is_fallback,
                   ComPtr<ID3D12RaytracingFallbackDevice> m_fallbackDevice,
                   ComPtr<ID3D12Device5> m_dxrDevice,
                   ComPtr<ID3D12RaytracingFallbackCommandList> fbCmdLst,
-                  ComPtr<ID3D12GraphicsCommandList5> rtxCmdList);
+                  ComPtr<ID3D12GraphicsCommandList5> rtxCmdList,
+                  const std::vector<int>* models = nullptr);
 
   void AllocateResourcesInDescriptorHeap();
+  // Into descriptorIndex if it has one already, a new descriptor otherwise.
+  void CreateTextureSRV(ModelLoading::Texture& texture, UINT descriptorIndex = UINT_MAX);
+
+  // Collect the triangles of every emissive object into lights and point the
+  // object infos at them. Only objects whose emission the closest hit shader
+  // returns as is (diffuse color, no texture, not reflective or refractive) qualify.
+  void BuildLightList();
+
+  // Copy of the scene without D3D resources for the CPU reference path tracer.
+  // Textures are read again from their files, ones that fail to load are left out.
+  SceneCore::SceneData BuildSceneCore() const;
+
+  // The scene description to save with SceneFormat. What came from GLTF files goes back
+  // out as their GLTF entries, the rest is numbered from 0 again.
+  SceneParser::SceneFile BuildSceneFile() const;
+
+  // The files of the scene for the hot reload watcher: sceneFile, the models and textures
+  // by their ids, and which objects use them.
+  void BuildDependencyGraph(const std::string& sceneFile, HotReload::DependencyGraph& graph) const;
+
+  // Reads the models and textures again and replaces their buffers and their views, in
+  // the descriptors they had. The caller has to wait for the GPU before, and after rebuild
+  // the bottom levels of the models put in reloadedModels and upload the object infos
+  // (BuildLightList does). Returns what failed, those keep their old data.
+  std::vector<std::string> ReloadAssets(const std::vector<HotReload::Node>& assets, std::vector<int>& reloadedModels);
+
+  // Triangles, memory, descriptors and object overlaps of the loaded scene, with the
+  // sizes of the acceleration structures built last.
+  SceneStats::Report BuildStats(bool is_fallback) const;
+
+  // Reads the fallback layer's acceleration structures back and puts the BvhQuality of
+  // their trees into the models and top level of report. Returns what failed. Records,
+  // runs and waits for its own command list like BuildAllAS.
+  std::vector<std::string> AnalyzeFallbackBvh(SceneStats::Report& report);
 
   ComPtr<ID3D12Resource> m_topLevelAccelerationStructure;
   ComPtr<ID3D12Resource> scratchResource;
@@ -91,4 +157,6 @@ public:
   ModelLoading::Camera camera;
 
   vector<ModelLoading::SceneObject> objects;
+
+  LightList lights;
 };
@@ -0,0 +1,93 @@
+#include "SceneConvert.h"
+#include "SceneFormat.h"
+
+#include <chrono>
+#include <cstdio>
+
+namespace SceneConvert {
+
+namespace {
+
+const char* c_usage =
+  "usage: -convert [--verify] input output\n"
+  "  the encodings come from the extensions: .txt (text), .json or .rtxscene (binary)\n"
+  "  --verify                read the output back, exit code 1 if it differs from the input\n";
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+int Run(const std::vector<std::string>& args)
+{
+  bool verify = false;
+  std::vector<std::string> paths;
+  for (const std::string& arg : args)
+  {
+    if (arg == "--verify") verify = true;
+    else if (arg == "--help" || arg == "-h")
+    {
+      printf("%s", c_usage);
+      return 0;
+    }
+    else if (arg.size() > 1 && arg[0] == '-')
+    {
+      fprintf(stderr, "unknown option %s\n%s", arg.c_str(), c_usage);
+      return 1;
+    }
+    else paths.push_back(arg);
+  }
+  if (paths.size() != 2)
+  {
+    fprintf(stderr, "%s", c_usage);
+    return 1;
+  }
+  const std::string& input = paths[0];
+  const std::string& output = paths[1];
+
+  SceneParser::SceneFile scene;
+  std::string error;
+  auto start = std::chrono::steady_clock::now();
+  if (!SceneFormat::ReadFile(input, scene, error))
+  {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  for (const std::string& warning : scene.warnings)
+  {
+    fprintf(stderr, "%s: warning: %s\n", input.c_str(), warning.c_str());
+  }
+  printf("read %s (%s): %zu assets, %zu materials, %zu objects in %.1f ms\n", input.c_str(),
+         SceneFormat::GetEncodingName(SceneFormat::GetEncoding(input)), scene.assets.size(), scene.materials.size(), scene.objects.size(),
+         MillisecondsSince(start));
+
+  start = std::chrono::steady_clock::now();
+  if (!SceneFormat::WriteFile(output, scene, error))
+  {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  printf("wrote %s (%s) in %.1f ms\n", output.c_str(), SceneFormat::GetEncodingName(SceneFormat::GetEncoding(output)), MillisecondsSince(start));
+
+  if (verify)
+  {
+    SceneParser::SceneFile written;
+    std::string difference;
+    if (!SceneFormat::ReadFile(output, written, error))
+    {
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+    if (!SceneFormat::Compare(scene, written, difference))
+    {
+      fprintf(stderr, "%s reads back different from %s: %s\n", output.c_str(), input.c_str(), difference.c_str());
+      return 1;
+    }
+    printf("verified, %s reads back the same\n", output.c_str());
+  }
+  return 0;
+}
+
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+//
+// SceneConvert - command line converter between the scene encodings of SceneFormat.
+//
+// "program.exe -convert [--verify] input output" reads a .txt, .json or .rtxscene scene
+// and writes it in the encoding of the output extension. Only the scene description is
+// converted, the models and textures it names stay where they are.
+//
+namespace SceneConvert {
+
+// args excludes the program name and -convert. Returns the process exit code.
+int Run(const std::vector<std::string>& args);
+
+}
@@ -0,0 +1,213 @@
+#include "SceneCore.h"
+#include "Profiler.h"
+#include "SceneFormat.h"
+#include "Utilities.h"
+
+#include <cmath>
+#include "include/tiny_obj_loader.h"
+#include "include/stb_image.h"
+
+namespace SceneCore {
+
+namespace {
+
+// Texel index of a point sampler, wrap or mirror addressing.
+int AddressTexel(float coordinate, int size, bool mirror)
+{
+  int texel = static_cast<int>(std::floor(coordinate * size));
+  if (mirror)
+  {
+    const int period = 2 * size;
+    texel = ((texel % period) + period) % period;
+    return texel < size ? texel : period - 1 - texel;
+  }
+  return ((texel % size) + size) % size;
+}
+
+}
+
+glm::vec3 Texture::Sample(glm::vec2 uv) const
+{
+  if (texels.empty())
+  {
+    return glm::vec3(0.0f);
+  }
+  const int x = AddressTexel(uv.x, width, mirror);
+  const int y = AddressTexel(uv.y, height, mirror);
+  return texels[static_cast<std::size_t>(y) * width + x];
+}
+
+void Object::UpdateTransforms()
+{
+  transform = utilityCore::buildTransformationMatrix(translation, rotation, scale);
+  rotation_scale = glm::mat3(utilityCore::buildTransformationMatrix(glm::vec3(0.0f), rotation, scale));
+}
+
+bool LoadObjMesh(const std::string& path, Mesh& mesh, std::string& error)
+{
+  std::vector<tinyobj::shape_t> shapes;
+  std::vector<tinyobj::material_t> materials;
+  tinyobj::attrib_t attrib;
+  std::string err;
+  if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, path.c_str()))
+  {
+    while (!err.empty() && (err.back() == '\n' || err.back() == '\r'))
+    {
+      err.pop_back();
+    }
+    error = "failed to load " + path + (err.empty() ? "" : ": " + err);
+    return false;
+  }
+
+  mesh.vertices.clear();
+  mesh.indices.clear();
+  for (const auto& shape : shapes)
+  {
+    std::size_t index_offset = 0;
+    for (std::size_t f = 0; f < shape.mesh.num_face_vertices.size(); f++)
+    {
+      const int fv = shape.mesh.num_face_vertices[f];
+      for (int v = 0; v < fv; v++)
+      {
+        const tinyobj::index_t index = shape.mesh.indices[index_offset + v];
+
+        Vertex vertex;
+        vertex.position = glm::vec3(attrib.vertices[index.vertex_index * 3], attrib.vertices[index.vertex_index * 3 + 1],
+                                    attrib.vertices[index.vertex_index * 3 + 2]);
+        if (index.normal_index != -1)
+        {
+          vertex.normal = glm::vec3(attrib.normals[index.normal_index * 3], attrib.normals[index.normal_index * 3 + 1],
+                                    attrib.normals[index.normal_index * 3 + 2]);
+        }
+        if (index.texcoord_index != -1)
+        {
+          vertex.uv = glm::vec2(attrib.texcoords[index.texcoord_index * 2], 1.0f - attrib.texcoords[index.texcoord_index * 2 + 1]);
+        }
+
+        mesh.indices.push_back(static_cast<std::uint32_t>(mesh.vertices.size()));
+        mesh.vertices.push_back(vertex);
+      }
+      index_offset += fv;
+    }
+  }
+
+  mesh.name = path;
+  return true;
+}
+
+bool LoadTexture(const std::string& path, Texture& texture, std::string& error)
+{
+  int channels;
+  unsigned char* pixels = stbi_load(path.c_str(), &texture.width, &texture.height, &channels, 4);
+  if (pixels == nullptr)
+  {
+    error = "failed to load " + path;
+    return false;
+  }
+
+  texture.texels.resize(static_cast<std::size_t>(texture.width) * texture.height);
+  for (std::size_t i = 0; i < texture.texels.size(); i++)
+  {
+    texture.texels[i] = glm::vec3(pixels[i * 4], pixels[i * 4 + 1], pixels[i * 4 + 2]) / 255.0f;
+  }
+  stbi_image_free(pixels);
+
+  texture.name = path;
+  return true;
+}
+
+bool LoadSceneFile(const std::string& path, SceneData& scene, std::string& error, std::vector<std::string>& warnings)
+{
+  if (path.find(".gltf") != std::string::npos)
+  {
+    error = path + ": gltf scenes are not supported by the CPU backend";
+    return false;
+  }
+
+  PROFILE_SCOPE("Load scene");
+  SceneParser::SceneFile file;
+  if (!SceneFormat::ReadFile(path, file, error))
+  {
+    return false;
+  }
+  warnings.insert(warnings.end(), file.warnings.begin(), file.warnings.end());
+
+  // every model and texture on its own thread, they go into the scene in file order
+  struct LoadedAsset
+  {
+    Mesh mesh;
+    Texture texture;
+    std::string error;
+    bool loaded = false;
+  };
+  std::vector<LoadedAsset> loaded(file.assets.size());
+  SceneParser::ForEachParallel(file.assets.size(), 0, [&](std::size_t i)
+  {
+    const SceneParser::Asset& asset = file.assets[i];
+    Profiler::Scope scope(Profiler::IsEnabled() ? Profiler::Intern(asset.path) : nullptr);
+    LoadedAsset& result = loaded[i];
+    result.loaded = asset.kind == SceneParser::AssetKind::Model ? LoadObjMesh(asset.path, result.mesh, result.error)
+                                                                 : LoadTexture(asset.path, result.texture, result.error);
+  });
+
+  for (std::size_t i = 0; i < file.assets.size(); i++)
+  {
+    const SceneParser::Asset& asset = file.assets[i];
+    LoadedAsset& result = loaded[i];
+    if (asset.kind == SceneParser::AssetKind::Model)
+    {
+      if (result.loaded)
+      {
+        result.mesh.id = asset.id;
+        scene.meshes[asset.id] = std::move(result.mesh);
+      }
+      else
+      {
+        warnings.push_back("MODEL " + std::to_string(asset.id) + ": " + result.error);
+      }
+      continue;
+    }
+
+    const bool diffuse = asset.kind == SceneParser::AssetKind::DiffuseTexture;
+    if (result.loaded)
+    {
+      result.texture.id = asset.id;
+      (diffuse ? scene.diffuse_textures : scene.normal_textures)[asset.id] = std::move(result.texture);
+    }
+    else
+    {
+      warnings.push_back((diffuse ? "DIFFUSE_TEXTURE " : "NORMAL_TEXTURE ") + std::to_string(asset.id) + ": " + result.error);
+    }
+  }
+
+  for (auto& material : file.materials)
+  {
+    scene.materials[material.id] = std::move(material);
+  }
+  for (const auto& gltf : file.gltf)
+  {
+    warnings.push_back("GLTF " + gltf.path + ": skipped, gltf is not supported by the CPU backend");
+  }
+  for (auto& object : file.objects)
+  {
+    object.UpdateTransforms();
+    scene.objects.push_back(std::move(object));
+  }
+  if (file.has_camera)
+  {
+    scene.camera = std::move(file.camera);
+  }
+
+  // objects that point at something that did not load render without it, like a -1 id
+  for (const auto& object : scene.objects)
+  {
+    if (object.mesh != -1 && SceneData::Find(scene.meshes, object.mesh) == nullptr)
+    {
+      warnings.push_back("OBJECT " + std::to_string(object.id) + ": model " + std::to_string(object.mesh) + " is missing, object skipped");
+    }
+  }
+
+  return true;
+}
+
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include <glm/glm/glm.hpp>
+#include "CameraPath.h"
+
+//
+// SceneCore - the scene without any graphics API attached.
+//
+// Holds the same data as Scene (models, textures, materials, objects and the camera)
+// in plain glm types, with textures kept on the CPU. It is what the CPU reference
+// path tracer renders. It is filled either from a live Scene (Scene::BuildSceneCore)
+// or straight from a scene file by LoadSceneFile, which needs neither D3D nor a window.
+// Ids are the ones of the scene file, same as the offsets the shaders index with.
+//
+namespace SceneCore {
+
+struct Vertex
+{
+  glm::vec3 position{};
+  glm::vec3 normal{};
+  glm::vec2 uv{};
+};
+
+struct Mesh
+{
+  int id = -1;
+  std::string name{};
+  std::vector<Vertex> vertices;
+  std::vector<std::uint32_t> indices;
+};
+
+// 8 bit texture expanded to floats, sampled like the shader's point samplers.
+struct Texture
+{
+  int id = -1;
+  std::string name{};
+  int width = 0;
+  int height = 0;
+  std::vector<glm::vec3> texels;
+  bool mirror = false; // sampler 1 (mirror) instead of sampler 0 (wrap)
+
+  glm::vec3 Sample(glm::vec2 uv) const;
+};
+
+// Same fields as Material in RayTracingHlslCompat.h.
+struct Material
+{
+  int id = -1;
+  std::string name{};
+  glm::vec3 diffuse{};
+  glm::vec3 specular{};
+  float specular_exponent = 0.0f;
+  float reflectiveness = 0.0f;
+  float refractiveness = 0.0f;
+  float eta = 0.0f;
+  float emittance = 0.0f;
+  float metallic = 0.0f;
+  float roughness = 0.0f; // above zero the metal/roughness BSDF, diffuse is its base color
+};
+
+struct Object
+{
+  int id = -1;
+  std::string name{};
+  int mesh = -1;
+  int albedo_texture = -1;
+  int normal_texture = -1;
+  int metallic_roughness_texture = -1; // in diffuse_textures
+  int material = -1;
+
+  glm::vec3 translation{ 0.0f };
+  glm::vec3 rotation{ 0.0f };
+  glm::vec3 scale{ 1.0f };
+
+  // Filled by UpdateTransforms: the instance transform of the acceleration structure and
+  // the rotation/scale part the shader turns normals with (Info::rotation_scale_matrix).
+  glm::mat4 transform{ 1.0f };
+  glm::mat3 rotation_scale{ 1.0f };
+
+  void UpdateTransforms();
+};
+
+struct Camera
+{
+  float fov = 45.0f; // vertical, degrees
+  glm::vec3 eye{ 0.0f, 0.0f, -20.0f };
+  glm::vec3 lookat{ 0.0f, 0.0f, 1.0f };
+  glm::vec3 up{ 0.0f, 1.0f, 0.0f };
+  int max_depth = 5;
+  bool russian_roulette = true;
+  int rr_min_depth = 3;
+  bool quantize_vertices = false; // GPU vertex attributes only, the CPU keeps floats
+  CameraPath::Path path; // keyframes for sequence captures, usually empty
+};
+
+struct SceneData
+{
+  std::map<int, Mesh> meshes;
+  std::map<int, Texture> diffuse_textures;
+  std::map<int, Texture> normal_textures;
+  std::map<int, Material> materials;
+  std::vector<Object> objects;
+  Camera camera;
+
+  template<typename T>
+  static const T* Find(const std::map<int, T>& map, int id)
+  {
+    auto it = map.find(id);
+    return it == map.end() ? nullptr : &it->second;
+  }
+};
+
+// Loads an obj file the way Scene::LoadModelHelper does: one vertex per face corner, v flipped.
+bool LoadObjMesh(const std::string& path, Mesh& mesh, std::string& error);
+
+// Loads any image stb_image reads into texels, alpha is dropped.
+bool LoadTexture(const std::string& path, Texture& texture, std::string& error);
+
+// Reads a .txt, .json or .rtxscene scene file with SceneFormat and loads its models and
+// textures on all cores. Models have to be obj files, GLTF entries are skipped and
+// reported in warnings, as are models and textures that fail to load (objects keep
+// rendering without them). Returns false only if the file itself cannot be read.
+bool LoadSceneFile(const std::string& path, SceneData& scene, std::string& error, std::vector<std::string>& warnings);
+
+}
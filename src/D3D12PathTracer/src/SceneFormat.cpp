@@ -0,0 +1,1114 @@
+#include "SceneFormat.h"
+#include "Profiler.h"
+
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+#include "json.hpp"
+
+namespace SceneFormat {
+
+namespace {
+
+using SceneParser::Asset;
+using SceneParser::AssetKind;
+using SceneParser::Gltf;
+using SceneParser::SceneFile;
+
+// The .rtxscene layout: the header, then the records of each section back to back in
+// this order, then the strings. All fields are 4 bytes, little endian.
+const char c_binaryMagic[8] = { 'R', 'T', 'X', 'S', 'C', 'E', 'N', 'E' };
+const std::uint32_t c_binaryVersion = 1;
+const int c_jsonVersion = 1;
+
+struct StringRef
+{
+  std::uint32_t offset;
+  std::uint32_t size;
+};
+
+struct BinaryHeader
+{
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t has_camera;
+  std::uint32_t asset_count;
+  std::uint32_t material_count;
+  std::uint32_t object_count; // also the length of the translation, rotation and scale arrays
+  std::uint32_t gltf_count;
+  std::uint32_t keyframe_count;
+  std::uint32_t string_size;
+};
+
+struct AssetRecord
+{
+  std::uint32_t kind;
+  std::int32_t id;
+  StringRef path;
+};
+
+struct MaterialRecord
+{
+  std::int32_t id;
+  StringRef name;
+  float diffuse[3];
+  float specular[3];
+  float specular_exponent;
+  float reflectiveness;
+  float refractiveness;
+  float eta;
+  float emittance;
+  float metallic;
+  float roughness;
+};
+
+struct ObjectRecord
+{
+  std::int32_t id;
+  StringRef name;
+  std::int32_t mesh;
+  std::int32_t albedo_texture;
+  std::int32_t normal_texture;
+  std::int32_t metallic_roughness_texture;
+  std::int32_t material;
+};
+
+struct GltfRecord
+{
+  StringRef path;
+  std::uint32_t object_index;
+};
+
+struct CameraRecord
+{
+  float fov;
+  float eye[3];
+  float lookat[3];
+  float up[3];
+  std::int32_t max_depth;
+  std::uint32_t russian_roulette;
+  std::int32_t rr_min_depth;
+  std::uint32_t quantize_vertices;
+};
+
+struct KeyframeRecord
+{
+  float time;
+  float eye[3];
+  float lookat[3];
+  float fov;
+};
+
+static_assert(sizeof(BinaryHeader) == 40 && sizeof(AssetRecord) == 16 && sizeof(MaterialRecord) == 64 && sizeof(ObjectRecord) == 32 &&
+                sizeof(GltfRecord) == 12 && sizeof(CameraRecord) == 56 && sizeof(KeyframeRecord) == 32,
+              "the .rtxscene records must not have padding");
+
+const char* c_assetKinds[] = { "model", "diffuse_texture", "normal_texture" };
+const char* c_assetKeywords[] = { "MODEL", "DIFFUSE_TEXTURE", "NORMAL_TEXTURE" };
+
+// The fewest significant digits that read back to the same float, both through strtod
+// (SceneParser and the JSON reader) and through strtof (camera keyframes).
+void FormatFloat(float value, char (&buffer)[32])
+{
+  for (int digits = 6; digits < 9; digits++)
+  {
+    snprintf(buffer, sizeof(buffer), "%.*g", digits, value);
+    if (static_cast<float>(std::strtod(buffer, nullptr)) == value && std::strtof(buffer, nullptr) == value)
+    {
+      return;
+    }
+  }
+  snprintf(buffer, sizeof(buffer), "%.9g", value);
+}
+
+void AppendFloat(std::string& text, float value)
+{
+  char buffer[32];
+  FormatFloat(value, buffer);
+  text += buffer;
+}
+
+void AppendVec3(std::string& text, const glm::vec3& value)
+{
+  AppendFloat(text, value.x);
+  text += ' ';
+  AppendFloat(text, value.y);
+  text += ' ';
+  AppendFloat(text, value.z);
+}
+
+// Text tokens end at whitespace, so names and paths keep theirs as underscores.
+void AppendToken(std::string& text, const std::string& token)
+{
+  for (char c : token)
+  {
+    text += (c == ' ' || c == '\t' || c == '\v' || c == '\f' || c == '\r' || c == '\n') ? '_' : c;
+  }
+}
+
+void AppendJsonFloat(std::string& text, float value)
+{
+  if (!std::isfinite(value))
+  {
+    text += "null";
+    return;
+  }
+  // a bare -0 reads back as the integer 0
+  if (value == 0.0f && std::signbit(value))
+  {
+    text += "-0.0";
+    return;
+  }
+  AppendFloat(text, value);
+}
+
+void AppendJsonVec3(std::string& text, const glm::vec3& value)
+{
+  text += '[';
+  AppendJsonFloat(text, value.x);
+  text += ", ";
+  AppendJsonFloat(text, value.y);
+  text += ", ";
+  AppendJsonFloat(text, value.z);
+  text += ']';
+}
+
+void AppendJsonString(std::string& text, const std::string& value)
+{
+  text += '"';
+  for (unsigned char c : value)
+  {
+    if (c == '"' || c == '\\')
+    {
+      text += '\\';
+      text += static_cast<char>(c);
+    }
+    else if (c < 0x20)
+    {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      text += escaped;
+    }
+    else
+    {
+      text += static_cast<char>(c);
+    }
+  }
+  text += '"';
+}
+
+// "key": value pairs of one line of the JSON output.
+class JsonFields
+{
+public:
+  explicit JsonFields(std::string& text) : m_text(text) { m_text += "{ "; }
+  ~JsonFields() { m_text += " }"; }
+
+  void Int(const char* key, int value) { Key(key) += std::to_string(value); }
+  void Bool(const char* key, bool value) { Key(key) += value ? "true" : "false"; }
+  void Float(const char* key, float value) { AppendJsonFloat(Key(key), value); }
+  void Vec3(const char* key, const glm::vec3& value) { AppendJsonVec3(Key(key), value); }
+  void String(const char* key, const std::string& value) { AppendJsonString(Key(key), value); }
+
+private:
+  std::string& Key(const char* key)
+  {
+    m_text += m_first ? "\"" : ", \"";
+    m_text += key;
+    m_text += "\": ";
+    m_first = false;
+    return m_text;
+  }
+
+  std::string& m_text;
+  bool m_first = true;
+};
+
+// Field access with the JSON path of the value in the errors.
+using Json = nlohmann::json;
+
+std::runtime_error JsonError(const std::string& where, const char* expected)
+{
+  return std::runtime_error(where + ": expected " + expected);
+}
+
+const Json* FindField(const Json& object, const char* key)
+{
+  auto it = object.find(key);
+  return it == object.end() ? nullptr : &*it;
+}
+
+float ToFloat(const Json& value, const std::string& where)
+{
+  if (value.is_null())
+  {
+    return std::numeric_limits<float>::quiet_NaN();
+  }
+  if (!value.is_number())
+  {
+    throw JsonError(where, "a number");
+  }
+  return static_cast<float>(value.get<double>());
+}
+
+float GetFloat(const Json& object, const char* key, const std::string& where, float fallback)
+{
+  const Json* value = FindField(object, key);
+  return value != nullptr ? ToFloat(*value, where + "." + key) : fallback;
+}
+
+int GetInt(const Json& object, const char* key, const std::string& where, int fallback)
+{
+  const Json* value = FindField(object, key);
+  if (value == nullptr)
+  {
+    return fallback;
+  }
+  if (!value->is_number_integer())
+  {
+    throw JsonError(where + "." + key, "an integer");
+  }
+  return value->get<int>();
+}
+
+bool GetBool(const Json& object, const char* key, const std::string& where, bool fallback)
+{
+  const Json* value = FindField(object, key);
+  if (value == nullptr)
+  {
+    return fallback;
+  }
+  if (value->is_number_integer())
+  {
+    return value->get<int>() != 0;
+  }
+  if (!value->is_boolean())
+  {
+    throw JsonError(where + "." + key, "true or false");
+  }
+  return value->get<bool>();
+}
+
+glm::vec3 GetVec3(const Json& object, const char* key, const std::string& where, const glm::vec3& fallback)
+{
+  const Json* value = FindField(object, key);
+  if (value == nullptr)
+  {
+    return fallback;
+  }
+  if (!value->is_array() || value->size() != 3)
+  {
+    throw JsonError(where + "." + key, "an array of 3 numbers");
+  }
+  const std::string element = where + "." + key;
+  return glm::vec3(ToFloat((*value)[0], element + "[0]"), ToFloat((*value)[1], element + "[1]"), ToFloat((*value)[2], element + "[2]"));
+}
+
+std::string GetString(const Json& object, const char* key, const std::string& where, bool required)
+{
+  const Json* value = FindField(object, key);
+  if (value == nullptr)
+  {
+    if (required)
+    {
+      throw std::runtime_error(where + ": " + key + " is missing");
+    }
+    return std::string();
+  }
+  if (!value->is_string())
+  {
+    throw JsonError(where + "." + key, "a string");
+  }
+  return value->get<std::string>();
+}
+
+// The elements of an optional array of objects.
+template<typename Function>
+void ForEachRecord(const Json& root, const char* key, Function function)
+{
+  const Json* array = FindField(root, key);
+  if (array == nullptr)
+  {
+    return;
+  }
+  if (!array->is_array())
+  {
+    throw JsonError(key, "an array");
+  }
+  for (std::size_t i = 0; i < array->size(); i++)
+  {
+    const std::string where = std::string(key) + "[" + std::to_string(i) + "]";
+    const Json& record = (*array)[i];
+    if (!record.is_object())
+    {
+      throw JsonError(where, "an object");
+    }
+    function(record, where);
+  }
+}
+
+void ReadJsonScene(const Json& root, SceneFile& scene)
+{
+  if (!root.is_object())
+  {
+    throw JsonError("the document", "an object");
+  }
+  const Json* version = FindField(root, "version");
+  if (version == nullptr || !version->is_number_integer() || version->get<int>() != c_jsonVersion)
+  {
+    throw std::runtime_error("version: expected " + std::to_string(c_jsonVersion));
+  }
+
+  ForEachRecord(root, "assets", [&](const Json& record, const std::string& where) {
+    const std::string kind = GetString(record, "kind", where, true);
+    Asset asset;
+    if (kind == c_assetKinds[0]) asset.kind = AssetKind::Model;
+    else if (kind == c_assetKinds[1]) asset.kind = AssetKind::DiffuseTexture;
+    else if (kind == c_assetKinds[2]) asset.kind = AssetKind::NormalTexture;
+    else throw JsonError(where + ".kind", "model, diffuse_texture or normal_texture");
+    asset.id = GetInt(record, "id", where, -1);
+    asset.path = GetString(record, "path", where, true);
+    scene.assets.push_back(std::move(asset));
+  });
+
+  ForEachRecord(root, "materials", [&](const Json& record, const std::string& where) {
+    SceneCore::Material material;
+    material.id = GetInt(record, "id", where, -1);
+    material.name = GetString(record, "name", where, false);
+    material.diffuse = GetVec3(record, "diffuse", where, material.diffuse);
+    material.specular = GetVec3(record, "specular", where, material.specular);
+    material.specular_exponent = GetFloat(record, "specular_exponent", where, material.specular_exponent);
+    material.reflectiveness = GetFloat(record, "reflectiveness", where, material.reflectiveness);
+    material.refractiveness = GetFloat(record, "refractiveness", where, material.refractiveness);
+    material.eta = GetFloat(record, "eta", where, material.eta);
+    material.emittance = GetFloat(record, "emittance", where, material.emittance);
+    material.metallic = GetFloat(record, "metallic", where, material.metallic);
+    material.roughness = GetFloat(record, "roughness", where, material.roughness);
+    scene.materials.push_back(std::move(material));
+  });
+
+  ForEachRecord(root, "objects", [&](const Json& record, const std::string& where) {
+    SceneCore::Object object;
+    object.id = GetInt(record, "id", where, -1);
+    object.name = GetString(record, "name", where, false);
+    object.mesh = GetInt(record, "model", where, -1);
+    object.albedo_texture = GetInt(record, "albedo_texture", where, -1);
+    object.normal_texture = GetInt(record, "normal_texture", where, -1);
+    object.metallic_roughness_texture = GetInt(record, "metallic_roughness_texture", where, -1);
+    object.material = GetInt(record, "material", where, -1);
+    object.translation = GetVec3(record, "translation", where, object.translation);
+    object.rotation = GetVec3(record, "rotation", where, object.rotation);
+    object.scale = GetVec3(record, "scale", where, object.scale);
+    scene.objects.push_back(std::move(object));
+  });
+
+  ForEachRecord(root, "gltf", [&](const Json& record, const std::string& where) {
+    Gltf gltf;
+    gltf.path = GetString(record, "path", where, true);
+    const int index = GetInt(record, "object_index", where, static_cast<int>(scene.objects.size()));
+    if (index < 0 || static_cast<std::size_t>(index) > scene.objects.size())
+    {
+      throw JsonError(where + ".object_index", "an index of the objects or their count");
+    }
+    gltf.object_index = static_cast<std::size_t>(index);
+    scene.gltf.push_back(std::move(gltf));
+  });
+  // the loaders go through them in object order
+  for (std::size_t i = 1; i < scene.gltf.size(); i++)
+  {
+    if (scene.gltf[i].object_index < scene.gltf[i - 1].object_index)
+    {
+      throw std::runtime_error("gltf[" + std::to_string(i) + "].object_index: must not be below the one before");
+    }
+  }
+
+  if (const Json* camera = FindField(root, "camera"))
+  {
+    if (!camera->is_object())
+    {
+      throw JsonError("camera", "an object");
+    }
+    SceneCore::Camera& target = scene.camera;
+    target.fov = GetFloat(*camera, "fov", "camera", target.fov);
+    target.eye = GetVec3(*camera, "eye", "camera", target.eye);
+    target.lookat = GetVec3(*camera, "lookat", "camera", target.lookat);
+    target.up = GetVec3(*camera, "up", "camera", target.up);
+    target.max_depth = GetInt(*camera, "depth", "camera", target.max_depth);
+    target.russian_roulette = GetBool(*camera, "russian_roulette", "camera", target.russian_roulette);
+    target.rr_min_depth = GetInt(*camera, "rr_min_depth", "camera", target.rr_min_depth);
+    target.quantize_vertices = GetBool(*camera, "quantize_vertices", "camera", target.quantize_vertices);
+    ForEachRecord(*camera, "keyframes", [&](const Json& record, const std::string& where) {
+      CameraPath::Keyframe keyframe;
+      keyframe.time = GetFloat(record, "time", "camera." + where, keyframe.time);
+      keyframe.eye = GetVec3(record, "eye", "camera." + where, keyframe.eye);
+      keyframe.lookat = GetVec3(record, "lookat", "camera." + where, keyframe.lookat);
+      keyframe.fov = GetFloat(record, "fov", "camera." + where, keyframe.fov);
+      target.path.AddKeyframe(keyframe);
+    });
+    target.path.SetDefaultFov(target.fov);
+    scene.has_camera = true;
+  }
+}
+
+// Appends the records to the binary output, and the strings to its string table.
+class BinaryWriter
+{
+public:
+  explicit BinaryWriter(std::string& data) : m_data(data) {}
+
+  template<typename T>
+  void Write(const T& record)
+  {
+    m_data.append(reinterpret_cast<const char*>(&record), sizeof(T));
+  }
+
+  StringRef AddString(const std::string& value)
+  {
+    const StringRef reference{ static_cast<std::uint32_t>(m_strings.size()), static_cast<std::uint32_t>(value.size()) };
+    m_strings += value;
+    return reference;
+  }
+
+  const std::string& GetStrings() const { return m_strings; }
+
+private:
+  std::string& m_data;
+  std::string m_strings;
+};
+
+void CopyVec3(const glm::vec3& value, float (&target)[3])
+{
+  target[0] = value.x;
+  target[1] = value.y;
+  target[2] = value.z;
+}
+
+glm::vec3 ToVec3(const float (&value)[3])
+{
+  return glm::vec3(value[0], value[1], value[2]);
+}
+
+bool SameFloat(float a, float b)
+{
+  return std::isnan(a) ? std::isnan(b) : std::memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+bool SameVec3(const glm::vec3& a, const glm::vec3& b)
+{
+  return SameFloat(a.x, b.x) && SameFloat(a.y, b.y) && SameFloat(a.z, b.z);
+}
+
+bool EndsWith(const std::string& path, const char* extension)
+{
+  const std::size_t length = std::strlen(extension);
+  if (path.size() < length)
+  {
+    return false;
+  }
+  for (std::size_t i = 0; i < length; i++)
+  {
+    if (std::tolower(static_cast<unsigned char>(path[path.size() - length + i])) != extension[i])
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+}
+
+Encoding GetEncoding(const std::string& path)
+{
+  if (EndsWith(path, ".json"))
+  {
+    return Encoding::Json;
+  }
+  if (EndsWith(path, ".rtxscene"))
+  {
+    return Encoding::Binary;
+  }
+  return Encoding::Text;
+}
+
+const char* GetEncodingName(Encoding encoding)
+{
+  switch (encoding)
+  {
+  case Encoding::Json: return "json";
+  case Encoding::Binary: return "rtxscene";
+  default: return "text";
+  }
+}
+
+void WriteText(const SceneFile& scene, std::string& text)
+{
+  text.clear();
+  for (const Asset& asset : scene.assets)
+  {
+    text += c_assetKeywords[static_cast<int>(asset.kind)];
+    text += ' ' + std::to_string(asset.id) + "\npath ";
+    AppendToken(text, asset.path);
+    text += "\n\n";
+  }
+
+  for (const SceneCore::Material& material : scene.materials)
+  {
+    text += "MATERIAL " + std::to_string(material.id);
+    if (!material.name.empty())
+    {
+      text += ' ';
+      AppendToken(text, material.name);
+    }
+    text += "\nRGB        ";
+    AppendVec3(text, material.diffuse);
+    text += "\nSPECRGB    ";
+    AppendVec3(text, material.specular);
+    text += "\nSPECEX     ";
+    AppendFloat(text, material.specular_exponent);
+    text += "\nREFL       ";
+    AppendFloat(text, material.reflectiveness);
+    text += "\nREFR       ";
+    AppendFloat(text, material.refractiveness);
+    text += "\nREFRIOR    ";
+    AppendFloat(text, material.eta);
+    text += "\nEMITTANCE  ";
+    AppendFloat(text, material.emittance);
+    text += "\nMETALLIC   ";
+    AppendFloat(text, material.metallic);
+    text += "\nROUGHNESS  ";
+    AppendFloat(text, material.roughness);
+    text += "\n\n";
+  }
+
+  std::size_t gltf = 0;
+  auto WriteGltf = [&](std::size_t objectIndex) {
+    for (; gltf < scene.gltf.size() && scene.gltf[gltf].object_index <= objectIndex; gltf++)
+    {
+      text += "GLTF ";
+      AppendToken(text, scene.gltf[gltf].path);
+      text += "\n\n";
+    }
+  };
+  for (std::size_t i = 0; i < scene.objects.size(); i++)
+  {
+    WriteGltf(i);
+    const SceneCore::Object& object = scene.objects[i];
+    text += "OBJECT " + std::to_string(object.id);
+    if (!object.name.empty())
+    {
+      text += ' ';
+      AppendToken(text, object.name);
+    }
+    text += "\nmodel           " + std::to_string(object.mesh);
+    text += "\nalbedo_tex      " + std::to_string(object.albedo_texture);
+    text += "\nnormal_tex      " + std::to_string(object.normal_texture);
+    text += "\nmaterial        " + std::to_string(object.material);
+    text += "\ntrans           ";
+    AppendVec3(text, object.translation);
+    text += "\nrotat           ";
+    AppendVec3(text, object.rotation);
+    text += "\nscale           ";
+    AppendVec3(text, object.scale);
+    if (object.metallic_roughness_texture >= 0)
+    {
+      text += "\nmetal_rough_tex " + std::to_string(object.metallic_roughness_texture);
+    }
+    text += "\n\n";
+  }
+  WriteGltf(scene.objects.size());
+
+  if (scene.has_camera)
+  {
+    const SceneCore::Camera& camera = scene.camera;
+    text += "CAMERA\nfov              ";
+    AppendFloat(text, camera.fov);
+    text += "\neye              ";
+    AppendVec3(text, camera.eye);
+    text += "\nlookat           ";
+    AppendVec3(text, camera.lookat);
+    text += "\nup               ";
+    AppendVec3(text, camera.up);
+    text += "\ndepth            " + std::to_string(camera.max_depth);
+    text += "\nrussian_roulette " + std::to_string(camera.russian_roulette ? 1 : 0);
+    text += "\nrr_min_depth     " + std::to_string(camera.rr_min_depth);
+    if (camera.quantize_vertices)
+    {
+      text += "\nquantize_vertices 1";
+    }
+    for (const CameraPath::Keyframe& keyframe : camera.path.GetKeyframes())
+    {
+      text += "\nkeyframe ";
+      AppendFloat(text, keyframe.time);
+      text += "  ";
+      AppendVec3(text, keyframe.eye);
+      text += "  ";
+      AppendVec3(text, keyframe.lookat);
+      text += "  ";
+      AppendFloat(text, keyframe.fov);
+    }
+    text += "\n";
+  }
+}
+
+void WriteJson(const SceneFile& scene, std::string& text)
+{
+  text = "{\n  \"version\": " + std::to_string(c_jsonVersion);
+
+  // one record per line
+  auto WriteArray = [&](const char* key, std::size_t count, auto writeRecord) {
+    text += ",\n  \"";
+    text += key;
+    text += "\": [";
+    for (std::size_t i = 0; i < count; i++)
+    {
+      text += i == 0 ? "\n    " : ",\n    ";
+      JsonFields fields(text);
+      writeRecord(fields, i);
+    }
+    text += count == 0 ? "]" : "\n  ]";
+  };
+
+  WriteArray("assets", scene.assets.size(), [&](JsonFields& fields, std::size_t i) {
+    fields.String("kind", c_assetKinds[static_cast<int>(scene.assets[i].kind)]);
+    fields.Int("id", scene.assets[i].id);
+    fields.String("path", scene.assets[i].path);
+  });
+
+  WriteArray("materials", scene.materials.size(), [&](JsonFields& fields, std::size_t i) {
+    const SceneCore::Material& material = scene.materials[i];
+    fields.Int("id", material.id);
+    fields.String("name", material.name);
+    fields.Vec3("diffuse", material.diffuse);
+    fields.Vec3("specular", material.specular);
+    fields.Float("specular_exponent", material.specular_exponent);
+    fields.Float("reflectiveness", material.reflectiveness);
+    fields.Float("refractiveness", material.refractiveness);
+    fields.Float("eta", material.eta);
+    fields.Float("emittance", material.emittance);
+    fields.Float("metallic", material.metallic);
+    fields.Float("roughness", material.roughness);
+  });
+
+  WriteArray("objects", scene.objects.size(), [&](JsonFields& fields, std::size_t i) {
+    const SceneCore::Object& object = scene.objects[i];
+    fields.Int("id", object.id);
+    fields.String("name", object.name);
+    fields.Int("model", object.mesh);
+    fields.Int("albedo_texture", object.albedo_texture);
+    fields.Int("normal_texture", object.normal_texture);
+    fields.Int("metallic_roughness_texture", object.metallic_roughness_texture);
+    fields.Int("material", object.material);
+    fields.Vec3("translation", object.translation);
+    fields.Vec3("rotation", object.rotation);
+    fields.Vec3("scale", object.scale);
+  });
+
+  WriteArray("gltf", scene.gltf.size(), [&](JsonFields& fields, std::size_t i) {
+    fields.String("path", scene.gltf[i].path);
+    fields.Int("object_index", static_cast<int>(scene.gltf[i].object_index));
+  });
+
+  if (scene.has_camera)
+  {
+    const SceneCore::Camera& camera = scene.camera;
+    text += ",\n  \"camera\": ";
+    {
+      JsonFields fields(text);
+      fields.Float("fov", camera.fov);
+      fields.Vec3("eye", camera.eye);
+      fields.Vec3("lookat", camera.lookat);
+      fields.Vec3("up", camera.up);
+      fields.Int("depth", camera.max_depth);
+      fields.Bool("russian_roulette", camera.russian_roulette);
+      fields.Int("rr_min_depth", camera.rr_min_depth);
+      fields.Bool("quantize_vertices", camera.quantize_vertices);
+      const std::vector<CameraPath::Keyframe>& keyframes = camera.path.GetKeyframes();
+      text += ",\n    \"keyframes\": [";
+      for (std::size_t i = 0; i < keyframes.size(); i++)
+      {
+        text += i == 0 ? "\n      " : ",\n      ";
+        JsonFields keyframe(text);
+        keyframe.Float("time", keyframes[i].time);
+        keyframe.Vec3("eye", keyframes[i].eye);
+        keyframe.Vec3("lookat", keyframes[i].lookat);
+        keyframe.Float("fov", keyframes[i].fov);
+      }
+      text += keyframes.empty() ? "]" : "\n    ]";
+    }
+  }
+  text += "\n}\n";
+}
+
+void WriteBinary(const SceneFile& scene, std::string& data)
+{
+  const std::vector<CameraPath::Keyframe>& keyframes = scene.camera.path.GetKeyframes();
+
+  BinaryHeader header;
+  std::memcpy(header.magic, c_binaryMagic, sizeof(c_binaryMagic));
+  header.version = c_binaryVersion;
+  header.has_camera = scene.has_camera ? 1 : 0;
+  header.asset_count = static_cast<std::uint32_t>(scene.assets.size());
+  header.material_count = static_cast<std::uint32_t>(scene.materials.size());
+  header.object_count = static_cast<std::uint32_t>(scene.objects.size());
+  header.gltf_count = static_cast<std::uint32_t>(scene.gltf.size());
+  header.keyframe_count = static_cast<std::uint32_t>(keyframes.size());
+
+  data.clear();
+  data.reserve(sizeof(BinaryHeader) + scene.assets.size() * sizeof(AssetRecord) + scene.materials.size() * sizeof(MaterialRecord) +
+               scene.objects.size() * (sizeof(ObjectRecord) + 3 * sizeof(float[3])) + sizeof(CameraRecord));
+  BinaryWriter writer(data);
+  writer.Write(header); // string_size goes in at the end
+
+  for (const Asset& asset : scene.assets)
+  {
+    writer.Write(AssetRecord{ static_cast<std::uint32_t>(asset.kind), asset.id, writer.AddString(asset.path) });
+  }
+
+  for (const SceneCore::Material& source : scene.materials)
+  {
+    MaterialRecord material;
+    material.id = source.id;
+    material.name = writer.AddString(source.name);
+    CopyVec3(source.diffuse, material.diffuse);
+    CopyVec3(source.specular, material.specular);
+    material.specular_exponent = source.specular_exponent;
+    material.reflectiveness = source.reflectiveness;
+    material.refractiveness = source.refractiveness;
+    material.eta = source.eta;
+    material.emittance = source.emittance;
+    material.metallic = source.metallic;
+    material.roughness = source.roughness;
+    writer.Write(material);
+  }
+
+  for (const SceneCore::Object& source : scene.objects)
+  {
+    writer.Write(ObjectRecord{ source.id, writer.AddString(source.name), source.mesh, source.albedo_texture, source.normal_texture,
+                               source.metallic_roughness_texture, source.material });
+  }
+  for (const SceneCore::Object& object : scene.objects)
+  {
+    writer.Write(object.translation);
+  }
+  for (const SceneCore::Object& object : scene.objects)
+  {
+    writer.Write(object.rotation);
+  }
+  for (const SceneCore::Object& object : scene.objects)
+  {
+    writer.Write(object.scale);
+  }
+
+  for (const Gltf& gltf : scene.gltf)
+  {
+    writer.Write(GltfRecord{ writer.AddString(gltf.path), static_cast<std::uint32_t>(gltf.object_index) });
+  }
+
+  CameraRecord camera;
+  camera.fov = scene.camera.fov;
+  CopyVec3(scene.camera.eye, camera.eye);
+  CopyVec3(scene.camera.lookat, camera.lookat);
+  CopyVec3(scene.camera.up, camera.up);
+  camera.max_depth = scene.camera.max_depth;
+  camera.russian_roulette = scene.camera.russian_roulette ? 1 : 0;
+  camera.rr_min_depth = scene.camera.rr_min_depth;
+  camera.quantize_vertices = scene.camera.quantize_vertices ? 1 : 0;
+  writer.Write(camera);
+  for (const CameraPath::Keyframe& source : keyframes)
+  {
+    KeyframeRecord keyframe;
+    keyframe.time = source.time;
+    CopyVec3(source.eye, keyframe.eye);
+    CopyVec3(source.lookat, keyframe.lookat);
+    keyframe.fov = source.fov;
+    writer.Write(keyframe);
+  }
+
+  header.string_size = static_cast<std::uint32_t>(writer.GetStrings().size());
+  std::memcpy(&data[0], &header, sizeof(header));
+  data += writer.GetStrings();
+}
+
+bool ReadJson(const char* data, std::size_t size, SceneFile& scene, std::string& error)
+{
+  try
+  {
+    ReadJsonScene(Json::parse(data, data + size), scene);
+    return true;
+  }
+  catch (const std::exception& exception)
+  {
+    error = exception.what();
+    return false;
+  }
+}
+
+bool ReadBinary(const char* data, std::size_t size, SceneFile& scene, std::string& error)
+{
+  BinaryHeader header;
+  if (size < sizeof(header) || std::memcmp(data, c_binaryMagic, sizeof(c_binaryMagic)) != 0)
+  {
+    error = "not an .rtxscene file";
+    return false;
+  }
+  std::memcpy(&header, data, sizeof(header));
+  if (header.version != c_binaryVersion)
+  {
+    error = "version " + std::to_string(header.version) + " of the .rtxscene format, expected " + std::to_string(c_binaryVersion);
+    return false;
+  }
+
+  const std::uint64_t expected = sizeof(BinaryHeader) + std::uint64_t(header.asset_count) * sizeof(AssetRecord) +
+                                 std::uint64_t(header.material_count) * sizeof(MaterialRecord) +
+                                 std::uint64_t(header.object_count) * (sizeof(ObjectRecord) + 3 * sizeof(float[3])) +
+                                 std::uint64_t(header.gltf_count) * sizeof(GltfRecord) + sizeof(CameraRecord) +
+                                 std::uint64_t(header.keyframe_count) * sizeof(KeyframeRecord) + header.string_size;
+  if (expected != size)
+  {
+    error = "truncated .rtxscene file, " + std::to_string(size) + " bytes instead of " + std::to_string(expected);
+    return false;
+  }
+
+  const char* at = data + sizeof(BinaryHeader);
+  const char* strings = data + size - header.string_size;
+  auto Read = [&](auto& record) {
+    std::memcpy(&record, at, sizeof(record));
+    at += sizeof(record);
+  };
+  bool valid = true;
+  auto GetString = [&](const StringRef& reference) {
+    if (std::uint64_t(reference.offset) + reference.size > header.string_size)
+    {
+      valid = false;
+      return std::string();
+    }
+    return std::string(strings + reference.offset, reference.size);
+  };
+
+  scene.assets.reserve(scene.assets.size() + header.asset_count);
+  for (std::uint32_t i = 0; i < header.asset_count; i++)
+  {
+    AssetRecord record;
+    Read(record);
+    valid &= record.kind <= static_cast<std::uint32_t>(AssetKind::NormalTexture);
+    Asset asset;
+    asset.kind = static_cast<AssetKind>(record.kind);
+    asset.id = record.id;
+    asset.path = GetString(record.path);
+    scene.assets.push_back(std::move(asset));
+  }
+
+  scene.materials.reserve(scene.materials.size() + header.material_count);
+  for (std::uint32_t i = 0; i < header.material_count; i++)
+  {
+    MaterialRecord record;
+    Read(record);
+    SceneCore::Material material;
+    material.id = record.id;
+    material.name = GetString(record.name);
+    material.diffuse = ToVec3(record.diffuse);
+    material.specular = ToVec3(record.specular);
+    material.specular_exponent = record.specular_exponent;
+    material.reflectiveness = record.reflectiveness;
+    material.refractiveness = record.refractiveness;
+    material.eta = record.eta;
+    material.emittance = record.emittance;
+    material.metallic = record.metallic;
+    material.roughness = record.roughness;
+    scene.materials.push_back(std::move(material));
+  }
+
+  const std::size_t firstObject = scene.objects.size();
+  scene.objects.resize(firstObject + header.object_count);
+  for (std::uint32_t i = 0; i < header.object_count; i++)
+  {
+    ObjectRecord record;
+    Read(record);
+    SceneCore::Object& object = scene.objects[firstObject + i];
+    object.id = record.id;
+    object.name = GetString(record.name);
+    object.mesh = record.mesh;
+    object.albedo_texture = record.albedo_texture;
+    object.normal_texture = record.normal_texture;
+    object.metallic_roughness_texture = record.metallic_roughness_texture;
+    object.material = record.material;
+  }
+  for (glm::vec3 SceneCore::Object::*component : { &SceneCore::Object::translation, &SceneCore::Object::rotation, &SceneCore::Object::scale })
+  {
+    for (std::uint32_t i = 0; i < header.object_count; i++)
+    {
+      Read(scene.objects[firstObject + i].*component);
+    }
+  }
+
+  for (std::uint32_t i = 0; i < header.gltf_count; i++)
+  {
+    GltfRecord record;
+    Read(record);
+    valid &= record.object_index <= header.object_count && (scene.gltf.empty() || record.object_index >= scene.gltf.back().object_index);
+    Gltf gltf;
+    gltf.path = GetString(record.path);
+    gltf.object_index = firstObject + record.object_index;
+    scene.gltf.push_back(std::move(gltf));
+  }
+
+  CameraRecord camera;
+  Read(camera);
+  for (std::uint32_t i = 0; i < header.keyframe_count; i++)
+  {
+    KeyframeRecord record;
+    Read(record);
+    CameraPath::Keyframe keyframe;
+    keyframe.time = record.time;
+    keyframe.eye = ToVec3(record.eye);
+    keyframe.lookat = ToVec3(record.lookat);
+    keyframe.fov = record.fov;
+    scene.camera.path.AddKeyframe(keyframe);
+  }
+  if (header.has_camera)
+  {
+    scene.camera.fov = camera.fov;
+    scene.camera.eye = ToVec3(camera.eye);
+    scene.camera.lookat = ToVec3(camera.lookat);
+    scene.camera.up = ToVec3(camera.up);
+    scene.camera.max_depth = camera.max_depth;
+    scene.camera.russian_roulette = camera.russian_roulette != 0;
+    scene.camera.rr_min_depth = camera.rr_min_depth;
+    scene.camera.quantize_vertices = camera.quantize_vertices != 0;
+    scene.camera.path.SetDefaultFov(scene.camera.fov);
+    scene.has_camera = true;
+  }
+
+  if (!valid)
+  {
+    error = "corrupt .rtxscene file, a string, asset kind or gltf index is out of range";
+    return false;
+  }
+  return true;
+}
+
+bool ReadFile(const std::string& path, SceneFile& scene, std::string& error)
+{
+  PROFILE_SCOPE("Parse scene");
+  const Encoding encoding = GetEncoding(path);
+  if (encoding == Encoding::Text)
+  {
+    return SceneParser::ParseFile(path, scene, error);
+  }
+
+  SceneParser::MappedFile file;
+  if (!file.Open(path))
+  {
+    error = "cannot read " + path;
+    return false;
+  }
+  const bool read = encoding == Encoding::Json ? ReadJson(file.GetData(), file.GetSize(), scene, error)
+                                               : ReadBinary(file.GetData(), file.GetSize(), scene, error);
+  if (!read)
+  {
+    error = path + ": " + error;
+  }
+  return read;
+}
+
+bool WriteFile(const std::string& path, const SceneFile& scene, std::string& error)
+{
+  std::string data;
+  switch (GetEncoding(path))
+  {
+  case Encoding::Json: WriteJson(scene, data); break;
+  case Encoding::Binary: WriteBinary(scene, data); break;
+  default: WriteText(scene, data); break;
+  }
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file.write(data.data(), data.size()) || !file.flush())
+  {
+    error = "cannot write " + path;
+    return false;
+  }
+  return true;
+}
+
+bool Compare(const SceneFile& a, const SceneFile& b, std::string& difference)
+{
+  auto Differ = [&](const std::string& what) {
+    difference = what;
+    return false;
+  };
+  auto Index = [](const char* array, std::size_t i) { return std::string(array) + "[" + std::to_string(i) + "]"; };
+
+  if (a.assets.size() != b.assets.size()) return Differ("asset count");
+  for (std::size_t i = 0; i < a.assets.size(); i++)
+  {
+    const Asset& x = a.assets[i];
+    const Asset& y = b.assets[i];
+    if (x.kind != y.kind || x.id != y.id || x.path != y.path) return Differ(Index("assets", i));
+  }
+
+  if (a.materials.size() != b.materials.size()) return Differ("material count");
+  for (std::size_t i = 0; i < a.materials.size(); i++)
+  {
+    const SceneCore::Material& x = a.materials[i];
+    const SceneCore::Material& y = b.materials[i];
+    if (x.id != y.id || x.name != y.name || !SameVec3(x.diffuse, y.diffuse) || !SameVec3(x.specular, y.specular) ||
+        !SameFloat(x.specular_exponent, y.specular_exponent) || !SameFloat(x.reflectiveness, y.reflectiveness) ||
+        !SameFloat(x.refractiveness, y.refractiveness) || !SameFloat(x.eta, y.eta) || !SameFloat(x.emittance, y.emittance) ||
+        !SameFloat(x.metallic, y.metallic) || !SameFloat(x.roughness, y.roughness))
+    {
+      return Differ(Index("materials", i));
+    }
+  }
+
+  if (a.objects.size() != b.objects.size()) return Differ("object count");
+  for (std::size_t i = 0; i < a.objects.size(); i++)
+  {
+    const SceneCore::Object& x = a.objects[i];
+    const SceneCore::Object& y = b.objects[i];
+    if (x.id != y.id || x.name != y.name || x.mesh != y.mesh || x.albedo_texture != y.albedo_texture || x.normal_texture != y.normal_texture ||
+        x.metallic_roughness_texture != y.metallic_roughness_texture || x.material != y.material ||
+        !SameVec3(x.translation, y.translation) || !SameVec3(x.rotation, y.rotation) || !SameVec3(x.scale, y.scale))
+    {
+      return Differ(Index("objects", i));
+    }
+  }
+
+  if (a.gltf.size() != b.gltf.size()) return Differ("gltf count");
+  for (std::size_t i = 0; i < a.gltf.size(); i++)
+  {
+    if (a.gltf[i].path != b.gltf[i].path || a.gltf[i].object_index != b.gltf[i].object_index) return Differ(Index("gltf", i));
+  }
+
+  if (a.has_camera != b.has_camera) return Differ("camera presence");
+  if (a.has_camera)
+  {
+    const SceneCore::Camera& x = a.camera;
+    const SceneCore::Camera& y = b.camera;
+    if (!SameFloat(x.fov, y.fov) || !SameVec3(x.eye, y.eye) || !SameVec3(x.lookat, y.lookat) || !SameVec3(x.up, y.up) ||
+        x.max_depth != y.max_depth || x.russian_roulette != y.russian_roulette || x.rr_min_depth != y.rr_min_depth ||
+        x.quantize_vertices != y.quantize_vertices)
+    {
+      return Differ("camera");
+    }
+    const std::vector<CameraPath::Keyframe>& p = x.path.GetKeyframes();
+    const std::vector<CameraPath::Keyframe>& q = y.path.GetKeyframes();
+    if (p.size() != q.size()) return Differ("keyframe count");
+    for (std::size_t i = 0; i < p.size(); i++)
+    {
+      if (!SameFloat(p[i].time, q[i].time) || !SameVec3(p[i].eye, q[i].eye) || !SameVec3(p[i].lookat, q[i].lookat) || !SameFloat(p[i].fov, q[i].fov))
+      {
+        return Differ(Index("camera.keyframes", i));
+      }
+    }
+  }
+  return true;
+}
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "SceneParser.h"
+
+//
+// SceneFormat - the scene description in its three encodings.
+//
+// The same SceneParser::SceneFile goes to and comes from
+//   .txt       the text format SceneParser reads, written with the canonical keys
+//   .json      for people: named fields instead of positional lines, see
+//              src/scenes/scene.schema.json
+//   .rtxscene  for generated scenes: fixed size records and SoA transform arrays
+//              behind a header, read with a single read and no parsing
+// Floats are written with the fewest digits that read back to the same float, so
+// converting between the encodings in any order loses nothing.
+//
+// JSON layout (every field but "version" is optional and defaults like the text format):
+//   { "version": 1,
+//     "assets":    [ { "kind": "model" | "diffuse_texture" | "normal_texture", "id": 0, "path": "..." } ],
+//     "materials": [ { "id", "name", "diffuse": [r, g, b], "specular": [r, g, b], "specular_exponent",
+//                      "reflectiveness", "refractiveness", "eta", "emittance", "metallic", "roughness" } ],
+//     "objects":   [ { "id", "name", "model", "albedo_texture", "normal_texture",
+//                      "metallic_roughness_texture", "material", "translation": [x, y, z],
+//                      "rotation": [x, y, z], "scale": [x, y, z] } ],
+//     "gltf":      [ { "path", "object_index" } ],
+//     "camera":    { "fov", "eye", "lookat", "up", "depth", "russian_roulette", "rr_min_depth",
+//                    "quantize_vertices", "keyframes": [ { "time", "eye", "lookat", "fov" } ] } }
+//
+namespace SceneFormat {
+
+enum class Encoding
+{
+  Text,
+  Json,
+  Binary
+};
+
+// From the extension, text for anything that is not .json or .rtxscene.
+Encoding GetEncoding(const std::string& path);
+const char* GetEncodingName(Encoding encoding);
+
+void WriteText(const SceneParser::SceneFile& scene, std::string& text);
+void WriteJson(const SceneParser::SceneFile& scene, std::string& text);
+void WriteBinary(const SceneParser::SceneFile& scene, std::string& data);
+
+// False with the reason in error if the data is not a valid scene of the encoding.
+// Text never fails, lines it does not know are skipped.
+bool ReadJson(const char* data, std::size_t size, SceneParser::SceneFile& scene, std::string& error);
+bool ReadBinary(const char* data, std::size_t size, SceneParser::SceneFile& scene, std::string& error);
+
+// Reads or writes the file in the encoding of its extension.
+bool ReadFile(const std::string& path, SceneParser::SceneFile& scene, std::string& error);
+bool WriteFile(const std::string& path, const SceneParser::SceneFile& scene, std::string& error);
+
+// Compares everything the encodings store, floats bit for bit. False with the first
+// difference in difference.
+bool Compare(const SceneParser::SceneFile& a, const SceneParser::SceneFile& b, std::string& difference);
+
+}
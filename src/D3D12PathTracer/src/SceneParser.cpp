@@ -0,0 +1,493 @@
+#include "SceneParser.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace SceneParser {
+
+namespace {
+
+// Powers of ten a double holds exactly.
+const double c_exactPowers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+// Mantissas up to 2^53 convert to double exactly.
+const std::uint64_t c_exactMantissa = 1ull << 53;
+
+bool IsDigit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+bool IsSpace(char c)
+{
+  return c == ' ' || c == '\t' || c == '\v' || c == '\f';
+}
+
+double ParseWithStrtod(const Token& token)
+{
+  char buffer[64];
+  if (token.size < sizeof(buffer))
+  {
+    std::memcpy(buffer, token.data, token.size);
+    buffer[token.size] = '\0';
+    return std::strtod(buffer, nullptr);
+  }
+  return std::strtod(token.ToString().c_str(), nullptr);
+}
+
+glm::vec3 ParseVec3(const Tokenizer& line)
+{
+  return glm::vec3(ParseDouble(line[1]), ParseDouble(line[2]), ParseDouble(line[3]));
+}
+
+float ParseFloat(const Tokenizer& line)
+{
+  return static_cast<float>(ParseDouble(line[1]));
+}
+
+int ParseId(const Tokenizer& line)
+{
+  return line.GetCount() > 1 ? ParseInt(line[1]) : -1;
+}
+
+void ParseMaterial(Tokenizer& line, SceneCore::Material& material)
+{
+  for (std::size_t index = 0; line.NextLine() && line.GetCount() > 0; index++)
+  {
+    switch (index)
+    {
+    case 0: material.diffuse = ParseVec3(line); break;
+    case 1: material.specular = ParseVec3(line); break;
+    case 2: material.specular_exponent = ParseFloat(line); break;
+    case 3: material.reflectiveness = ParseFloat(line); break;
+    case 4: material.refractiveness = ParseFloat(line); break;
+    case 5: material.eta = ParseFloat(line); break;
+    case 6: material.emittance = ParseFloat(line); break;
+    default:
+      if (line[0] == "METALLIC") material.metallic = ParseFloat(line);
+      else if (line[0] == "ROUGHNESS") material.roughness = ParseFloat(line);
+    }
+  }
+}
+
+void ParseObject(Tokenizer& line, SceneCore::Object& object)
+{
+  for (std::size_t index = 0; line.NextLine() && line.GetCount() > 0; index++)
+  {
+    switch (index)
+    {
+    case 0: object.mesh = ParseId(line); break;
+    case 1: object.albedo_texture = ParseId(line); break;
+    case 2: object.normal_texture = ParseId(line); break;
+    case 3: object.material = ParseId(line); break;
+    default:
+      if (line[0] == "trans") object.translation = ParseVec3(line);
+      else if (line[0] == "rotat") object.rotation = ParseVec3(line);
+      else if (line[0] == "scale") object.scale = ParseVec3(line);
+      else if (line[0] == "metal_rough_tex") object.metallic_roughness_texture = ParseId(line);
+    }
+  }
+}
+
+void ParseCamera(Tokenizer& line, SceneCore::Camera& camera, std::vector<std::string>& warnings)
+{
+  while (line.NextLine() && line.GetCount() > 0)
+  {
+    if (line[0] == "fov") camera.fov = ParseFloat(line);
+    else if (line[0] == "depth") camera.max_depth = ParseInt(line[1]);
+    else if (line[0] == "eye") camera.eye = ParseVec3(line);
+    else if (line[0] == "lookat") camera.lookat = ParseVec3(line);
+    else if (line[0] == "up") camera.up = ParseVec3(line);
+    else if (line[0] == "russian_roulette") camera.russian_roulette = ParseInt(line[1]) != 0;
+    else if (line[0] == "rr_min_depth") camera.rr_min_depth = ParseInt(line[1]);
+    else if (line[0] == "quantize_vertices") camera.quantize_vertices = ParseInt(line[1]) != 0;
+    else if (line[0] == "keyframe")
+    {
+      // rare enough to go through the strings CameraPath takes
+      std::vector<std::string> tokens;
+      for (std::size_t i = 0; i < line.GetCount(); i++)
+      {
+        tokens.push_back(line[i].ToString());
+      }
+      CameraPath::Keyframe keyframe;
+      if (CameraPath::ParseKeyframe(tokens, keyframe))
+      {
+        camera.path.AddKeyframe(keyframe);
+      }
+      else
+      {
+        warnings.push_back("CAMERA: keyframe needs a time, an eye and a look-at point, line skipped");
+      }
+    }
+  }
+  camera.path.SetDefaultFov(camera.fov);
+}
+
+// The path on the first line of a MODEL or texture block, the rest of the block is skipped.
+void ParseAsset(Tokenizer& line, AssetKind kind, int id, std::vector<Asset>& assets)
+{
+  for (std::size_t index = 0; line.NextLine() && line.GetCount() > 0; index++)
+  {
+    if (index == 0 && line.GetCount() > 1)
+    {
+      Asset asset;
+      asset.kind = kind;
+      asset.id = id;
+      asset.path = line[1].ToString();
+      assets.push_back(std::move(asset));
+    }
+  }
+}
+
+}
+
+bool Token::operator==(const char* text) const
+{
+  return std::strlen(text) == size && (size == 0 || std::memcmp(data, text, size) == 0);
+}
+
+double ParseDouble(const Token& token)
+{
+  if (token.size == 0)
+  {
+    return 0.0;
+  }
+
+  const char* at = token.data;
+  const char* end = token.data + token.size;
+
+  bool negative = false;
+  if (at != end && (*at == '+' || *at == '-'))
+  {
+    negative = *at++ == '-';
+  }
+
+  // significant digits into the mantissa, the place of the last one into the exponent
+  std::uint64_t mantissa = 0;
+  int exponent = 0;
+  bool digits = false;
+  bool exact = true;
+  for (; at != end && IsDigit(*at); ++at)
+  {
+    digits = true;
+    if (mantissa < c_exactMantissa / 10)
+    {
+      mantissa = mantissa * 10 + (*at - '0');
+    }
+    else
+    {
+      exact = false;
+    }
+  }
+  if (at != end && *at == '.')
+  {
+    for (++at; at != end && IsDigit(*at); ++at)
+    {
+      digits = true;
+      if (mantissa < c_exactMantissa / 10)
+      {
+        mantissa = mantissa * 10 + (*at - '0');
+        exponent--;
+      }
+      else
+      {
+        exact = false;
+      }
+    }
+  }
+  if (digits && at != end && (*at == 'e' || *at == 'E'))
+  {
+    const char* power = at + 1;
+    bool negativePower = false;
+    if (power != end && (*power == '+' || *power == '-'))
+    {
+      negativePower = *power++ == '-';
+    }
+    if (power != end && IsDigit(*power))
+    {
+      int value = 0;
+      for (; power != end && IsDigit(*power); ++power)
+      {
+        value = std::min(value * 10 + (*power - '0'), 1000);
+      }
+      exponent += negativePower ? -value : value;
+      at = power;
+    }
+  }
+
+  // hex, inf, nan, junk after the number and what a double cannot take exactly
+  if (!digits || !exact || at != end || exponent < -22 || exponent > 22)
+  {
+    return ParseWithStrtod(token);
+  }
+  // both operands are exact, so the result is rounded once, like strtod rounds
+  const double value = exponent < 0 ? mantissa / c_exactPowers[-exponent] : mantissa * c_exactPowers[exponent];
+  return negative ? -value : value;
+}
+
+int ParseInt(const Token& token)
+{
+  const char* at = token.data;
+  const char* end = token.data + token.size;
+  bool negative = false;
+  if (at != end && (*at == '+' || *at == '-'))
+  {
+    negative = *at++ == '-';
+  }
+  long long value = 0;
+  for (; at != end && IsDigit(*at); ++at)
+  {
+    value = std::min(value * 10 + (*at - '0'), 2147483647ll);
+  }
+  return static_cast<int>(negative ? -value : value);
+}
+
+bool Tokenizer::NextLine()
+{
+  m_count = 0;
+  if (m_at == m_end)
+  {
+    return false;
+  }
+
+  const char* line = m_at;
+  while (m_at != m_end && *m_at != '\n' && *m_at != '\r')
+  {
+    ++m_at;
+  }
+  const char* lineEnd = m_at;
+  if (m_at != m_end)
+  {
+    // \r\n is one line end, \r\r\n two
+    const bool carriageReturn = *m_at++ == '\r';
+    if (carriageReturn && m_at != m_end && *m_at == '\n')
+    {
+      ++m_at;
+    }
+  }
+
+  for (const char* at = line; at != lineEnd && m_count < MaxTokens;)
+  {
+    while (at != lineEnd && IsSpace(*at))
+    {
+      ++at;
+    }
+    const char* token = at;
+    while (at != lineEnd && !IsSpace(*at))
+    {
+      ++at;
+    }
+    if (at != token)
+    {
+      m_tokens[m_count].data = token;
+      m_tokens[m_count].size = static_cast<std::size_t>(at - token);
+      m_count++;
+    }
+  }
+  return true;
+}
+
+MappedFile::~MappedFile()
+{
+  Close();
+}
+
+bool MappedFile::Open(const std::string& path)
+{
+  Close();
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  LARGE_INTEGER size;
+  if (file == INVALID_HANDLE_VALUE)
+  {
+    return false;
+  }
+  m_file = file;
+  if (!GetFileSizeEx(file, &size))
+  {
+    Close();
+    return false;
+  }
+  m_size = static_cast<std::size_t>(size.QuadPart);
+  if (m_size == 0)
+  {
+    // empty files cannot be mapped
+    m_data = "";
+    return true;
+  }
+  m_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  m_data = m_mapping != nullptr ? static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+#else
+  m_descriptor = open(path.c_str(), O_RDONLY);
+  struct stat status;
+  if (m_descriptor < 0 || fstat(m_descriptor, &status) != 0)
+  {
+    Close();
+    return false;
+  }
+  m_size = static_cast<std::size_t>(status.st_size);
+  if (m_size == 0)
+  {
+    m_data = "";
+    return true;
+  }
+  void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_descriptor, 0);
+  m_data = data != MAP_FAILED ? static_cast<const char*>(data) : nullptr;
+#endif
+  if (m_data == nullptr)
+  {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+  if (m_data != nullptr && m_size > 0)
+  {
+    UnmapViewOfFile(m_data);
+  }
+  if (m_mapping != nullptr)
+  {
+    CloseHandle(m_mapping);
+  }
+  if (m_file != nullptr)
+  {
+    CloseHandle(m_file);
+  }
+  m_mapping = nullptr;
+  m_file = nullptr;
+#else
+  if (m_data != nullptr && m_size > 0)
+  {
+    munmap(const_cast<char*>(m_data), m_size);
+  }
+  if (m_descriptor >= 0)
+  {
+    close(m_descriptor);
+  }
+  m_descriptor = -1;
+#endif
+  m_data = nullptr;
+  m_size = 0;
+}
+
+void ParseBuffer(const char* data, std::size_t size, SceneFile& scene)
+{
+  Tokenizer line(data, size);
+  while (line.NextLine())
+  {
+    if (line.GetCount() == 0)
+    {
+      continue;
+    }
+
+    const Token kind = line[0];
+    const int id = ParseId(line);
+    const std::string name = line.GetCount() > 2 ? line[2].ToString() : std::string();
+
+    if (kind == "MATERIAL")
+    {
+      SceneCore::Material material;
+      material.id = id;
+      material.name = name;
+      ParseMaterial(line, material);
+      scene.materials.push_back(std::move(material));
+    }
+    else if (kind == "MODEL")
+    {
+      ParseAsset(line, AssetKind::Model, id, scene.assets);
+    }
+    else if (kind == "DIFFUSE_TEXTURE")
+    {
+      ParseAsset(line, AssetKind::DiffuseTexture, id, scene.assets);
+    }
+    else if (kind == "NORMAL_TEXTURE")
+    {
+      ParseAsset(line, AssetKind::NormalTexture, id, scene.assets);
+    }
+    else if (kind == "OBJECT")
+    {
+      SceneCore::Object object;
+      object.id = id;
+      object.name = name;
+      ParseObject(line, object);
+      scene.objects.push_back(std::move(object));
+    }
+    else if (kind == "CAMERA")
+    {
+      ParseCamera(line, scene.camera, scene.warnings);
+      scene.has_camera = true;
+    }
+    else if (kind == "GLTF" && line.GetCount() > 1)
+    {
+      Gltf gltf;
+      gltf.path = line[1].ToString();
+      gltf.object_index = scene.objects.size();
+      scene.gltf.push_back(std::move(gltf));
+    }
+  }
+}
+
+bool ParseFile(const std::string& path, SceneFile& scene, std::string& error)
+{
+  MappedFile file;
+  if (!file.Open(path))
+  {
+    error = "cannot read " + path;
+    return false;
+  }
+  ParseBuffer(file.GetData(), file.GetSize(), scene);
+  return true;
+}
+
+void ForEachParallel(std::size_t count, unsigned int threads, const std::function<void(std::size_t)>& function)
+{
+  threads = threads > 0 ? threads : std::thread::hardware_concurrency();
+  threads = static_cast<unsigned int>(std::max<std::size_t>(1, std::min<std::size_t>(threads, count)));
+
+  std::atomic<std::size_t> next{ 0 };
+  auto Worker = [&]()
+  {
+    for (std::size_t i = next++; i < count; i = next++)
+    {
+      function(i);
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (unsigned int i = 1; i < threads; i++)
+  {
+    workers.emplace_back([&]()
+    {
+      Profiler::SetThreadName("parallel worker");
+      Worker();
+    });
+  }
+  Worker();
+  for (auto& worker : workers)
+  {
+    worker.join();
+  }
+}
+
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "SceneCore.h"
+
+//
+// SceneParser - reads a .txt scene file in one pass, without loading anything it names.
+//
+// The file is memory mapped and split into lines and tokens in place: tokens point into
+// the mapping and numbers are parsed straight from them, so nothing is allocated per
+// line. The result lists the MODEL and texture blocks as assets for the caller to load,
+// in parallel with ForEachParallel, and keeps the objects as ids to link once they are
+// all there. Scene (with the GPU uploads) and SceneCore::LoadSceneFile both read scene
+// files through it.
+//
+// Blocks run from their keyword line to the next empty line. Like the original loader,
+// the first lines of MATERIAL (RGB, SPECRGB, SPECEX, REFL, REFR, REFRIOR, EMITTANCE) and
+// OBJECT (model, albedo_tex, normal_tex, material) blocks count by position whatever
+// their key says, the lines after them and CAMERA blocks by key. Lines that start with
+// no keyword (comments, the ASCII art of some scenes) are skipped.
+//
+namespace SceneParser {
+
+// A piece of the parsed buffer, what std::string_view would be if the project built
+// as C++17.
+struct Token
+{
+  const char* data = nullptr;
+  std::size_t size = 0;
+
+  bool operator==(const char* text) const;
+  bool operator!=(const char* text) const { return !(*this == text); }
+  std::string ToString() const { return std::string(data, size); }
+};
+
+// Like atof and atoi: the longest prefix that is a number, 0 if there is none. Plain
+// decimals convert exactly (the same double as atof), anything else goes to strtod.
+double ParseDouble(const Token& token);
+int ParseInt(const Token& token);
+
+// Lines the way utilityCore::safeGetline splits them (at \n, \r\n or a lone \r) and
+// tokens the way utilityCore::tokenizeString does (at spaces, tabs, \v and \f).
+class Tokenizer
+{
+public:
+  static const std::size_t MaxTokens = 16; // further tokens of a line are dropped
+
+  Tokenizer(const char* data, std::size_t size) : m_at(data), m_end(data + size) {}
+
+  // Moves to the next line, false past the last one. Empty lines have no tokens.
+  bool NextLine();
+
+  std::size_t GetCount() const { return m_count; }
+  // An empty token past the count, so optional arguments read as 0.
+  const Token& operator[](std::size_t i) const { return i < m_count ? m_tokens[i] : m_none; }
+
+private:
+  const char* m_at;
+  const char* m_end;
+  Token m_tokens[MaxTokens];
+  std::size_t m_count = 0;
+  Token m_none;
+};
+
+// A read-only view of a whole file, mapped into memory.
+class MappedFile
+{
+public:
+  MappedFile() = default;
+  ~MappedFile();
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  bool Open(const std::string& path);
+  const char* GetData() const { return m_data; }
+  std::size_t GetSize() const { return m_size; }
+
+private:
+  void Close();
+
+  const char* m_data = nullptr;
+  std::size_t m_size = 0;
+#ifdef _WIN32
+  void* m_file = nullptr;
+  void* m_mapping = nullptr;
+#else
+  int m_descriptor = -1;
+#endif
+};
+
+enum class AssetKind
+{
+  Model,
+  DiffuseTexture,
+  NormalTexture
+};
+
+// A MODEL, DIFFUSE_TEXTURE or NORMAL_TEXTURE block.
+struct Asset
+{
+  AssetKind kind = AssetKind::Model;
+  int id = -1;
+  std::string path{};
+};
+
+// A GLTF line. Its objects go in before objects[object_index], where the line was.
+struct Gltf
+{
+  std::string path{};
+  std::size_t object_index = 0;
+};
+
+struct SceneFile
+{
+  std::vector<Asset> assets; // in file order
+  std::vector<SceneCore::Material> materials;
+  std::vector<SceneCore::Object> objects; // ids of their model, textures and material, not linked yet
+  std::vector<Gltf> gltf;
+  SceneCore::Camera camera;
+  bool has_camera = false;
+  std::vector<std::string> warnings;
+};
+
+// Parses the scene in the buffer, which does not have to be null terminated.
+void ParseBuffer(const char* data, std::size_t size, SceneFile& scene);
+
+// Maps the file and parses it. False only if the file cannot be read.
+bool ParseFile(const std::string& path, SceneFile& scene, std::string& error);
+
+// Runs function(0) to function(count - 1) on up to threads threads (0: one per core),
+// the calling one included, and returns once all of them finished. The calls for
+// different indices must not depend on each other.
+void ForEachParallel(std::size_t count, unsigned int threads, const std::function<void(std::size_t)>& function);
+
+}
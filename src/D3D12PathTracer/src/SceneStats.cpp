@@ -0,0 +1,506 @@
+#include "SceneStats.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <utility>
+
+#include "CpuBvh.h"
+#include "json.hpp"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#include <xmmintrin.h>
+#define SCENE_STATS_SSE
+#endif
+
+namespace SceneStats {
+
+namespace {
+
+using Json = nlohmann::json;
+
+Json ToJson(const Bounds& bounds)
+{
+  if (bounds.Empty())
+  {
+    return nullptr;
+  }
+  return { { "min", { bounds.min.x, bounds.min.y, bounds.min.z } }, { "max", { bounds.max.x, bounds.max.y, bounds.max.z } } };
+}
+
+Json ToJson(const AccelerationStructure& structure)
+{
+  Json json = { { "source", structure.source }, { "result_bytes", structure.result_bytes }, { "compacted_bytes", structure.compacted_bytes },
+                { "scratch_bytes", structure.scratch_bytes } };
+  if (structure.analyzed)
+  {
+    const BvhQuality::Metrics& quality = structure.quality;
+    json["quality"] = { { "nodes", quality.nodes }, { "leaves", quality.leaves }, { "primitives", quality.primitives },
+                        { "max_depth", quality.max_depth }, { "mean_leaf_depth", quality.mean_leaf_depth }, { "sah", quality.sah },
+                        { "epo", quality.epo }, { "leaf_sizes", quality.leaf_sizes } };
+  }
+  return json;
+}
+
+// How many of count elements of stride bytes, compared over their first size bytes, differ.
+std::uint64_t CountUnique(const unsigned char* data, std::size_t count, std::size_t stride, std::size_t size)
+{
+  std::vector<std::uint32_t> order(count);
+  for (std::size_t i = 0; i < count; i++)
+  {
+    order[i] = static_cast<std::uint32_t>(i);
+  }
+  auto Less = [&](std::uint32_t a, std::uint32_t b) { return std::memcmp(data + a * stride, data + b * stride, size) < 0; };
+  std::sort(order.begin(), order.end(), Less);
+
+  std::uint64_t unique = 0;
+  for (std::size_t i = 0; i < count; i++)
+  {
+    unique += i == 0 || Less(order[i - 1], order[i]);
+  }
+  return unique;
+}
+
+}
+
+void Bounds::Add(const glm::vec3& point)
+{
+  min = glm::min(min, point);
+  max = glm::max(max, point);
+}
+
+void Bounds::Add(const Bounds& bounds)
+{
+  if (!bounds.Empty())
+  {
+    Add(bounds.min);
+    Add(bounds.max);
+  }
+}
+
+double Bounds::SurfaceArea() const
+{
+  if (Empty())
+  {
+    return 0.0;
+  }
+  const glm::dvec3 extent = glm::dvec3(max) - glm::dvec3(min);
+  return 2.0 * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+double Bounds::Volume() const
+{
+  if (Empty())
+  {
+    return 0.0;
+  }
+  const glm::dvec3 extent = glm::dvec3(max) - glm::dvec3(min);
+  return extent.x * extent.y * extent.z;
+}
+
+Bounds Transform(const Bounds& bounds, const glm::mat4& transform)
+{
+  Bounds moved;
+  if (bounds.Empty())
+  {
+    return moved;
+  }
+  for (int corner = 0; corner < 8; corner++)
+  {
+    const glm::vec3 point((corner & 1) ? bounds.max.x : bounds.min.x, (corner & 2) ? bounds.max.y : bounds.min.y, (corner & 4) ? bounds.max.z : bounds.min.z);
+    moved.Add(glm::vec3(transform * glm::vec4(point, 1.0f)));
+  }
+  return moved;
+}
+
+Bounds Intersection(const Bounds& a, const Bounds& b)
+{
+  Bounds overlap;
+  overlap.min = glm::max(a.min, b.min);
+  overlap.max = glm::min(a.max, b.max);
+  return overlap;
+}
+
+void CountVertices(const void* vertices, std::size_t count, std::size_t stride, Model& model)
+{
+  const unsigned char* data = static_cast<const unsigned char*>(vertices);
+  model.vertices = count;
+  model.unique_vertices = CountUnique(data, count, stride, stride);
+  model.unique_positions = CountUnique(data, count, stride, sizeof(glm::vec3));
+  model.bounds = ComputeBounds(vertices, count, stride);
+}
+
+Bounds ComputeBounds(const void* vertices, std::size_t count, std::size_t stride)
+{
+  const unsigned char* data = static_cast<const unsigned char*>(vertices);
+  Bounds bounds;
+  std::size_t i = 0;
+#ifdef SCENE_STATS_SSE
+  // Four floats of every vertex, the fourth is whatever follows the position and drops
+  // out below. With packed positions the last one's would be past the end, it is added
+  // on its own.
+  const std::size_t wide = stride >= sizeof(glm::vec4) || count == 0 ? count : count - 1;
+  __m128 minimum = _mm_set1_ps(bounds.min.x);
+  __m128 maximum = _mm_set1_ps(bounds.max.x);
+  for (; i < wide; i++)
+  {
+    const __m128 position = _mm_loadu_ps(reinterpret_cast<const float*>(data + i * stride));
+    minimum = _mm_min_ps(minimum, position);
+    maximum = _mm_max_ps(maximum, position);
+  }
+  float lanes[4];
+  _mm_storeu_ps(lanes, minimum);
+  bounds.min = glm::vec3(lanes[0], lanes[1], lanes[2]);
+  _mm_storeu_ps(lanes, maximum);
+  bounds.max = glm::vec3(lanes[0], lanes[1], lanes[2]);
+#endif
+  for (; i < count; i++)
+  {
+    glm::vec3 position;
+    std::memcpy(&position, data + i * stride, sizeof(position));
+    bounds.Add(position);
+  }
+  return bounds;
+}
+
+std::uint64_t Rgba8Bytes(std::uint32_t width, std::uint32_t height)
+{
+  return std::uint64_t(width) * height * 4;
+}
+
+ConstantBuffers GetConstantBuffers(const std::string& name, unsigned int count, std::uint64_t size)
+{
+  ConstantBuffers buffers;
+  buffers.name = name;
+  buffers.count = count;
+  buffers.size = size;
+  buffers.padded_size = (size + c_constantBufferAlignment - 1) & ~(c_constantBufferAlignment - 1);
+  buffers.bytes = buffers.padded_size * count;
+  buffers.wasted_bytes = (buffers.padded_size - size) * count;
+  return buffers;
+}
+
+void AddDescriptors(Report& report, const DescriptorAllocator::Allocator& allocator)
+{
+  report.descriptors.clear();
+  for (std::uint32_t i = 0; i < DescriptorAllocator::RangeCount; i++)
+  {
+    const DescriptorAllocator::Range range = static_cast<DescriptorAllocator::Range>(i);
+    report.descriptors.push_back({ DescriptorAllocator::GetRangeName(range), allocator.GetAllocatedCount(range), allocator.GetFreeCount(range),
+                                   allocator.GetChunkCount(range) });
+  }
+  report.descriptor_capacity = allocator.GetCapacity();
+  report.descriptor_high_water_mark = allocator.GetHighWaterMark();
+}
+
+void Finish(Report& report)
+{
+  std::map<int, Model*> models;
+  report.triangles = report.vertices = report.unique_vertices = report.geometry_bytes = 0;
+  report.blas_bytes = report.blas_compacted_bytes = 0;
+  report.scratch_bytes = report.tlas.scratch_bytes;
+  bool compactedKnown = !report.models.empty();
+  for (Model& model : report.models)
+  {
+    models[model.id] = &model;
+    model.instances = 0;
+    report.triangles += model.triangles;
+    report.vertices += model.vertices;
+    report.unique_vertices += model.unique_vertices;
+    report.geometry_bytes += model.vertex_bytes + model.index_bytes;
+    report.blas_bytes += model.blas.result_bytes;
+    report.blas_compacted_bytes += model.blas.compacted_bytes;
+    report.scratch_bytes = std::max(report.scratch_bytes, model.blas.scratch_bytes);
+    compactedKnown &= model.blas.compacted_bytes != 0;
+  }
+  if (!compactedKnown)
+  {
+    report.blas_compacted_bytes = 0;
+  }
+
+  std::map<std::pair<std::string, int>, Texture*> textures;
+  std::map<std::pair<std::string, std::uint32_t>, FormatUsage> formats;
+  report.texture_bytes = 0;
+  for (Texture& texture : report.textures)
+  {
+    textures[{ texture.kind, texture.id }] = &texture;
+    texture.users = 0;
+    report.texture_bytes += texture.bytes;
+    for (std::uint32_t mip = 0; mip < texture.mip_bytes.size(); mip++)
+    {
+      FormatUsage& usage = formats[{ texture.format, mip }];
+      usage.format = texture.format;
+      usage.mip = mip;
+      usage.textures++;
+      usage.bytes += texture.mip_bytes[mip];
+    }
+  }
+  report.formats.clear();
+  for (const auto& usage : formats)
+  {
+    report.formats.push_back(usage.second);
+  }
+
+  report.constant_bytes = report.constant_wasted_bytes = 0;
+  for (const ConstantBuffers& buffers : report.constant_buffers)
+  {
+    report.constant_bytes += buffers.bytes;
+    report.constant_wasted_bytes += buffers.wasted_bytes;
+  }
+  report.instance_desc_bytes = c_instanceDescBytes * report.objects.size();
+
+  auto AddUser = [&](const char* kind, int id) {
+    auto it = textures.find({ kind, id });
+    if (it != textures.end())
+    {
+      it->second->users++;
+    }
+  };
+  report.instanced_triangles = 0;
+  report.bounds = Bounds();
+  double objectArea = 0.0;
+  for (Object& object : report.objects)
+  {
+    auto it = models.find(object.model);
+    if (it != models.end())
+    {
+      it->second->instances++;
+      report.instanced_triangles += it->second->triangles;
+    }
+    AddUser("diffuse", object.diffuse_texture);
+    if (object.metallic_roughness_texture != object.diffuse_texture)
+    {
+      AddUser("diffuse", object.metallic_roughness_texture);
+    }
+    AddUser("normal", object.normal_texture);
+
+    object.overlaps = 0;
+    object.overlap_ratio = 0.0;
+    report.bounds.Add(object.bounds);
+    objectArea += object.bounds.SurfaceArea();
+  }
+  const double sceneArea = report.bounds.SurfaceArea();
+  report.area_ratio = sceneArea > 0.0 ? objectArea / sceneArea : 0.0;
+
+  // Sweep along x: once a box starts past the end of the current one, so do the rest.
+  // Boxes that meet in an edge, like the walls of a room, don't count; ones that share a
+  // face do, rays along it enter both.
+  std::vector<Object*> sorted;
+  for (Object& object : report.objects)
+  {
+    if (!object.bounds.Empty())
+    {
+      sorted.push_back(&object);
+    }
+  }
+  std::sort(sorted.begin(), sorted.end(), [](const Object* a, const Object* b) { return a->bounds.min.x < b->bounds.min.x; });
+  report.overlapping_pairs = 0;
+  for (std::size_t i = 0; i < sorted.size(); i++)
+  {
+    for (std::size_t j = i + 1; j < sorted.size() && sorted[j]->bounds.min.x <= sorted[i]->bounds.max.x; j++)
+    {
+      const Bounds overlap = Intersection(sorted[i]->bounds, sorted[j]->bounds);
+      const double area = overlap.SurfaceArea();
+      if (overlap.Empty() || area <= 0.0)
+      {
+        continue;
+      }
+      report.overlapping_pairs++;
+      for (Object* object : { sorted[i], sorted[j] })
+      {
+        const double own = object->bounds.SurfaceArea();
+        object->overlaps++;
+        object->overlap_ratio += own > 0.0 ? area / own : 0.0;
+      }
+    }
+  }
+}
+
+Report FromSceneData(const std::string& scene, const SceneCore::SceneData& data)
+{
+  Report report;
+  report.scene = scene;
+  report.source = "headless";
+
+  const std::uint64_t attributeBytes = data.camera.quantize_vertices ? 8 : 20;
+  for (const auto& mesh_pair : data.meshes)
+  {
+    const SceneCore::Mesh& mesh = mesh_pair.second;
+    Model model;
+    model.id = mesh.id;
+    model.name = mesh.name;
+    model.triangles = mesh.indices.size() / 3;
+    CountVertices(mesh.vertices.data(), mesh.vertices.size(), sizeof(SceneCore::Vertex), model);
+    model.vertex_bytes = model.vertices * (sizeof(glm::vec3) + attributeBytes);
+    model.index_bytes = mesh.indices.size() * sizeof(std::uint32_t);
+
+    std::vector<glm::vec3> positions;
+    positions.reserve(mesh.vertices.size());
+    for (const SceneCore::Vertex& vertex : mesh.vertices)
+    {
+      positions.push_back(vertex.position);
+    }
+    CpuBvh bvh;
+    bvh.AddMesh(0, positions, mesh.indices, false);
+    bvh.Build();
+    model.blas.source = "cpu builder";
+    model.blas.result_bytes = bvh.GetMemoryBytes();
+    model.blas.scratch_bytes = bvh.GetBuildScratchBytes();
+    BvhQuality::Tree tree;
+    bvh.ExportTree(tree);
+    model.blas.quality = BvhQuality::Analyze(tree);
+    model.blas.analyzed = true;
+    report.models.push_back(std::move(model));
+  }
+
+  for (const auto* map : { &data.diffuse_textures, &data.normal_textures })
+  {
+    for (const auto& texture_pair : *map)
+    {
+      const SceneCore::Texture& source = texture_pair.second;
+      Texture texture;
+      texture.id = source.id;
+      texture.name = source.name;
+      texture.kind = map == &data.diffuse_textures ? "diffuse" : "normal";
+      texture.format = "R8G8B8A8_UNORM";
+      texture.width = static_cast<std::uint32_t>(source.width);
+      texture.height = static_cast<std::uint32_t>(source.height);
+      texture.bytes = Rgba8Bytes(texture.width, texture.height);
+      texture.mip_bytes = { texture.bytes };
+      report.textures.push_back(std::move(texture));
+    }
+  }
+
+  report.constant_buffers.push_back(GetConstantBuffers("Info", static_cast<unsigned int>(data.objects.size()), c_infoBytes));
+  report.constant_buffers.push_back(GetConstantBuffers("Material", static_cast<unsigned int>(data.materials.size()), c_materialBytes));
+
+  // The same reservations and allocations as the app without the fallback layer.
+  DescriptorAllocator::Allocator allocator;
+  const std::uint32_t models = static_cast<std::uint32_t>(data.meshes.size());
+  const std::uint32_t objects = static_cast<std::uint32_t>(data.objects.size());
+  const std::uint32_t materials = static_cast<std::uint32_t>(data.materials.size());
+  const std::uint32_t textures = static_cast<std::uint32_t>(data.diffuse_textures.size() + data.normal_textures.size());
+  allocator.Reserve(DescriptorAllocator::RangeOutput, 9);
+  allocator.Reserve(DescriptorAllocator::RangeGeometry, 3 * models);
+  allocator.Reserve(DescriptorAllocator::RangeObjects, objects);
+  allocator.Reserve(DescriptorAllocator::RangeMaterials, materials);
+  allocator.Reserve(DescriptorAllocator::RangeTextures, textures);
+  allocator.Allocate(DescriptorAllocator::RangeOutput, 9);
+  for (std::uint32_t i = 0; i < 3 * models; i++)
+  {
+    allocator.Allocate(DescriptorAllocator::RangeGeometry);
+  }
+  for (std::uint32_t i = 0; i < objects; i++)
+  {
+    allocator.Allocate(DescriptorAllocator::RangeObjects);
+  }
+  for (std::uint32_t i = 0; i < materials; i++)
+  {
+    allocator.Allocate(DescriptorAllocator::RangeMaterials);
+  }
+  for (std::uint32_t i = 0; i < textures; i++)
+  {
+    allocator.Allocate(DescriptorAllocator::RangeTextures);
+  }
+  AddDescriptors(report, allocator);
+
+  for (const SceneCore::Object& source : data.objects)
+  {
+    SceneCore::Object placed = source;
+    placed.UpdateTransforms();
+
+    Object object;
+    object.id = source.id;
+    object.name = source.name;
+    object.model = source.mesh;
+    object.diffuse_texture = source.albedo_texture;
+    object.metallic_roughness_texture = source.metallic_roughness_texture;
+    object.normal_texture = source.normal_texture;
+    for (const Model& model : report.models)
+    {
+      if (model.id == source.mesh)
+      {
+        object.bounds = Transform(model.bounds, placed.transform);
+      }
+    }
+    report.objects.push_back(std::move(object));
+  }
+
+  // The CPU renderer has no top level, only its input is known.
+  report.tlas.source = "none";
+
+  Finish(report);
+  return report;
+}
+
+std::string ToJson(const Report& report)
+{
+  Json models = Json::array();
+  for (const Model& model : report.models)
+  {
+    models.push_back({ { "id", model.id }, { "name", model.name }, { "triangles", model.triangles }, { "vertices", model.vertices },
+                       { "unique_vertices", model.unique_vertices }, { "duplicated_vertices", model.DuplicatedVertices() },
+                       { "unique_positions", model.unique_positions }, { "vertex_bytes", model.vertex_bytes }, { "index_bytes", model.index_bytes },
+                       { "instances", model.instances }, { "bounds", ToJson(model.bounds) }, { "blas", ToJson(model.blas) } });
+  }
+  Json textures = Json::array();
+  for (const Texture& texture : report.textures)
+  {
+    textures.push_back({ { "id", texture.id }, { "name", texture.name }, { "kind", texture.kind }, { "format", texture.format },
+                         { "width", texture.width }, { "height", texture.height }, { "mip_bytes", texture.mip_bytes }, { "bytes", texture.bytes },
+                         { "users", texture.users } });
+  }
+  Json formats = Json::array();
+  for (const FormatUsage& usage : report.formats)
+  {
+    formats.push_back({ { "format", usage.format }, { "mip", usage.mip }, { "textures", usage.textures }, { "bytes", usage.bytes } });
+  }
+  Json constantBuffers = Json::array();
+  for (const ConstantBuffers& buffers : report.constant_buffers)
+  {
+    constantBuffers.push_back({ { "name", buffers.name }, { "count", buffers.count }, { "size", buffers.size }, { "padded_size", buffers.padded_size },
+                                { "bytes", buffers.bytes }, { "wasted_bytes", buffers.wasted_bytes } });
+  }
+  Json ranges = Json::array();
+  for (const Descriptors& descriptors : report.descriptors)
+  {
+    ranges.push_back({ { "range", descriptors.range }, { "allocated", descriptors.allocated }, { "free", descriptors.free }, { "chunks", descriptors.chunks } });
+  }
+  Json objects = Json::array();
+  for (const Object& object : report.objects)
+  {
+    objects.push_back({ { "id", object.id }, { "name", object.name }, { "model", object.model }, { "bounds", ToJson(object.bounds) },
+                        { "surface_area", object.bounds.SurfaceArea() }, { "volume", object.bounds.Volume() }, { "overlaps", object.overlaps },
+                        { "overlap_ratio", object.overlap_ratio } });
+  }
+
+  const Json totals = { { "triangles", report.triangles }, { "instanced_triangles", report.instanced_triangles }, { "vertices", report.vertices },
+                        { "unique_vertices", report.unique_vertices }, { "geometry_bytes", report.geometry_bytes }, { "blas_bytes", report.blas_bytes },
+                        { "blas_compacted_bytes", report.blas_compacted_bytes }, { "scratch_bytes", report.scratch_bytes },
+                        { "instance_desc_bytes", report.instance_desc_bytes }, { "texture_bytes", report.texture_bytes },
+                        { "constant_bytes", report.constant_bytes }, { "constant_wasted_bytes", report.constant_wasted_bytes } };
+  const Json json = { { "scene", report.scene },
+                      { "source", report.source },
+                      { "totals", totals },
+                      { "models", models },
+                      { "tlas", ToJson(report.tlas) },
+                      { "textures", textures },
+                      { "texture_formats", formats },
+                      { "constant_buffers", constantBuffers },
+                      { "descriptors", { { "capacity", report.descriptor_capacity }, { "high_water_mark", report.descriptor_high_water_mark }, { "ranges", ranges } } },
+                      { "objects", objects },
+                      { "overlap", { { "bounds", ToJson(report.bounds) }, { "pairs", report.overlapping_pairs }, { "area_ratio", report.area_ratio } } } };
+  return json.dump(2) + "\n";
+}
+
+std::string ToJson(const std::vector<Report>& reports)
+{
+  Json json = Json::array();
+  for (const Report& report : reports)
+  {
+    json.push_back(Json::parse(ToJson(report)));
+  }
+  return json.dump(2) + "\n";
+}
+
+}
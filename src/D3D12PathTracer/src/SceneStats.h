@@ -0,0 +1,200 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <glm/glm/glm.hpp>
+
+#include "BvhQuality.h"
+#include "DescriptorAllocator.h"
+#include "SceneCore.h"
+
+//
+// SceneStats - what a scene costs: its triangles and vertices, the memory of its
+// geometry, acceleration structures, textures and constant buffers, the descriptors it
+// takes, and how much the bounds of its objects overlap, which is what makes rays test
+// several instances of the top level.
+//
+// The app fills a Report from the resources of a loaded Scene (Scene::BuildStats), with
+// the prebuild sizes the device reports, the compacted sizes of the bottom levels where
+// DXR gives them, and the texture footprints of the device. FromSceneData fills one from
+// a scene file alone for cpurender --scene-stats, where the bottom levels are the CPU
+// builder's and textures are counted as the RGBA8 the app loads them as.
+//
+// Where the tree of an acceleration structure can be read, from the CPU builder or read
+// back from the fallback layer (Scene::AnalyzeFallbackBvh), it carries its BvhQuality.
+//
+// Only depends on the standard library, glm and the bookkeeping of DescriptorAllocator,
+// cpurender --scene-stats-report checks it.
+//
+namespace SceneStats {
+
+// sizeof(Info) and sizeof(Material) of RayTracingHlslCompat.h, Scene.cpp asserts them.
+const std::uint64_t c_infoBytes = 128;
+const std::uint64_t c_materialBytes = 52;
+// D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT, what every CBV is rounded up to.
+const std::uint64_t c_constantBufferAlignment = 256;
+// sizeof(D3D12_RAYTRACING_INSTANCE_DESC), one per object in the top level's input.
+const std::uint64_t c_instanceDescBytes = 64;
+
+struct Bounds
+{
+  glm::vec3 min{ std::numeric_limits<float>::max() };
+  glm::vec3 max{ -std::numeric_limits<float>::max() };
+
+  bool Empty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+  void Add(const glm::vec3& point);
+  void Add(const Bounds& bounds);
+  double SurfaceArea() const; // 0 when empty
+  double Volume() const;
+};
+
+// The bounds of count vertices of stride bytes each, starting with the three floats of
+// the position. Four wide min and max with SSE, what Model::UpdateBounds takes at load.
+Bounds ComputeBounds(const void* vertices, std::size_t count, std::size_t stride);
+
+// The bounds of the eight corners of bounds moved by transform.
+Bounds Transform(const Bounds& bounds, const glm::mat4& transform);
+// Empty if they don't intersect, a flat box where they only touch.
+Bounds Intersection(const Bounds& a, const Bounds& b);
+
+struct AccelerationStructure
+{
+  std::string source;               // what the sizes come from
+  std::uint64_t result_bytes = 0;   // the size it is built into
+  std::uint64_t compacted_bytes = 0; // 0 where not known
+  std::uint64_t scratch_bytes = 0;
+  bool analyzed = false;            // whether quality is known
+  BvhQuality::Metrics quality;
+};
+
+struct Model
+{
+  int id = -1;
+  std::string name;
+  std::uint64_t triangles = 0;
+  std::uint64_t vertices = 0;
+  std::uint64_t unique_vertices = 0;  // with equal position, normal and uv
+  std::uint64_t unique_positions = 0;
+  std::uint64_t vertex_bytes = 0;     // positions and attributes
+  std::uint64_t index_bytes = 0;
+  unsigned int instances = 0;         // objects that use it, filled by Finish
+  Bounds bounds;                      // object space
+  AccelerationStructure blas;
+
+  // vertices - unique_vertices, what an index buffer over unique vertices would save
+  std::uint64_t DuplicatedVertices() const { return vertices - unique_vertices; }
+};
+
+// Counts the unique vertices and positions and takes the bounds of count vertices of
+// stride bytes each, starting with the three floats of the position.
+void CountVertices(const void* vertices, std::size_t count, std::size_t stride, Model& model);
+
+struct Texture
+{
+  int id = -1;
+  std::string name;
+  std::string kind; // "diffuse" or "normal"
+  std::string format;
+  std::uint32_t width = 0;
+  std::uint32_t height = 0;
+  std::vector<std::uint64_t> mip_bytes; // one per mip level
+  std::uint64_t bytes = 0;              // the allocation, at least the sum of mip_bytes
+  unsigned int users = 0;               // objects sampling it, filled by Finish
+};
+
+// The bytes of one RGBA8 texture without mips, the estimate of FromSceneData.
+std::uint64_t Rgba8Bytes(std::uint32_t width, std::uint32_t height);
+
+struct FormatUsage
+{
+  std::string format;
+  std::uint32_t mip = 0;
+  unsigned int textures = 0;
+  std::uint64_t bytes = 0;
+};
+
+struct ConstantBuffers
+{
+  std::string name;
+  unsigned int count = 0;
+  std::uint64_t size = 0;        // of the struct
+  std::uint64_t padded_size = 0; // of one buffer
+  std::uint64_t bytes = 0;       // of all of them
+  std::uint64_t wasted_bytes = 0;
+};
+
+ConstantBuffers GetConstantBuffers(const std::string& name, unsigned int count, std::uint64_t size);
+
+struct Descriptors
+{
+  std::string range;
+  std::uint32_t allocated = 0;
+  std::uint32_t free = 0;
+  std::uint32_t chunks = 0;
+};
+
+struct Object
+{
+  int id = -1;
+  std::string name;
+  int model = -1;
+  int diffuse_texture = -1;   // the albedo and the metallic/roughness texture
+  int metallic_roughness_texture = -1;
+  int normal_texture = -1;
+  Bounds bounds;              // world space
+  unsigned int overlaps = 0;  // other objects whose bounds intersect these, filled by Finish
+  double overlap_ratio = 0.0; // surface area of those intersections over the own, filled by Finish
+};
+
+struct Report
+{
+  std::string scene;
+  std::string source; // "dxr", "fallback" or "headless"
+
+  std::vector<Model> models;
+  std::vector<Texture> textures;
+  std::vector<ConstantBuffers> constant_buffers;
+  std::vector<Descriptors> descriptors;
+  std::uint32_t descriptor_capacity = 0;
+  std::uint32_t descriptor_high_water_mark = 0;
+  std::vector<Object> objects;
+  AccelerationStructure tlas;
+
+  // Filled by Finish.
+  std::vector<FormatUsage> formats; // by format and mip
+  Bounds bounds;
+  std::uint64_t triangles = 0;
+  std::uint64_t instanced_triangles = 0; // every object's model counted
+  std::uint64_t vertices = 0;
+  std::uint64_t unique_vertices = 0;
+  std::uint64_t geometry_bytes = 0;
+  std::uint64_t blas_bytes = 0;
+  std::uint64_t blas_compacted_bytes = 0; // 0 unless known for every model
+  std::uint64_t scratch_bytes = 0;        // the largest scratch of one build
+  std::uint64_t texture_bytes = 0;
+  std::uint64_t constant_bytes = 0;
+  std::uint64_t constant_wasted_bytes = 0;
+  std::uint64_t instance_desc_bytes = 0; // the input of the top level build
+  std::uint64_t overlapping_pairs = 0;
+  // The summed surface area of the objects' bounds over that of the scene's. By the
+  // surface area heuristic about how many instances a ray through the scene enters.
+  double area_ratio = 0.0;
+};
+
+// Takes the allocated, free and chunk counts of every range.
+void AddDescriptors(Report& report, const DescriptorAllocator::Allocator& allocator);
+
+// The totals, the format table, instance and user counts and the overlaps of the objects.
+void Finish(Report& report);
+
+// The report of a scene file loaded by SceneCore::LoadSceneFile. The descriptors are
+// those CreateDescriptorHeap and AllocateResourcesInDescriptorHeap would take with DXR.
+Report FromSceneData(const std::string& scene, const SceneCore::SceneData& data);
+
+std::string ToJson(const Report& report);
+std::string ToJson(const std::vector<Report>& reports);
+
+}
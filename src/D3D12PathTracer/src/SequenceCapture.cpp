@@ -0,0 +1,210 @@
+#include "SequenceCapture.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace SequenceCapture {
+
+void ReadbackRing::Reset(unsigned int slotCount)
+{
+  m_slots.assign(std::max(1u, std::min(slotCount, MAX_READBACK_SLOTS)), Slot());
+}
+
+int ReadbackRing::Acquire(unsigned int frame)
+{
+  for (std::size_t i = 0; i < m_slots.size(); i++)
+  {
+    if (m_slots[i].state == SlotState::Free)
+    {
+      m_slots[i].state = SlotState::Recorded;
+      m_slots[i].frame = frame;
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+void ReadbackRing::Tag(std::uint64_t fenceValue)
+{
+  for (auto& slot : m_slots)
+  {
+    if (slot.state == SlotState::Recorded)
+    {
+      slot.state = SlotState::InFlight;
+      slot.fence_value = fenceValue;
+    }
+  }
+}
+
+bool ReadbackRing::PeekCompleted(std::uint64_t completedValue, unsigned int& slot, unsigned int& frame) const
+{
+  bool found = false;
+  for (std::size_t i = 0; i < m_slots.size(); i++)
+  {
+    const Slot& candidate = m_slots[i];
+    if (candidate.state == SlotState::InFlight && completedValue >= candidate.fence_value && (!found || candidate.frame < frame))
+    {
+      slot = static_cast<unsigned int>(i);
+      frame = candidate.frame;
+      found = true;
+    }
+  }
+  return found;
+}
+
+void ReadbackRing::Release(unsigned int slot)
+{
+  if (slot < m_slots.size())
+  {
+    m_slots[slot] = Slot();
+  }
+}
+
+unsigned int ReadbackRing::GetBusyCount() const
+{
+  return static_cast<unsigned int>(std::count_if(m_slots.begin(), m_slots.end(), [](const Slot& slot) { return slot.state != SlotState::Free; }));
+}
+
+std::string GetFramePath(const std::string& pattern, unsigned int frame)
+{
+  std::string number = std::to_string(frame);
+  std::size_t first = pattern.find('#');
+  if (first == std::string::npos)
+  {
+    const std::size_t dot = pattern.find_last_of('.');
+    const std::size_t slash = pattern.find_last_of("/\\");
+    const std::size_t at = (dot != std::string::npos && (slash == std::string::npos || dot > slash)) ? dot : pattern.size();
+    number.insert(0, number.size() < 4 ? 4 - number.size() : 0, '0');
+    return pattern.substr(0, at) + "_" + number + pattern.substr(at);
+  }
+
+  const std::size_t last = pattern.find_first_not_of('#', first);
+  const std::size_t width = (last == std::string::npos ? pattern.size() : last) - first;
+  number.insert(0, number.size() < width ? width - number.size() : 0, '0');
+  return pattern.substr(0, first) + number + pattern.substr(first + width);
+}
+
+bool Capture::Start(const CameraPath::Path& path, const Settings& settings, unsigned int width, unsigned int height)
+{
+  Stop();
+
+  ImageWriter::Format format;
+  if (path.IsEmpty() || width == 0 || height == 0 || !ImageWriter::GetFormat(SequenceCapture::GetFramePath(settings.output_pattern, 0), format))
+  {
+    return false;
+  }
+
+  m_settings = settings;
+  m_settings.samples_per_frame = std::max(m_settings.samples_per_frame, 1u);
+  if (m_settings.encoder_threads == 0)
+  {
+    m_settings.encoder_threads = std::max(std::thread::hardware_concurrency() / 2, 1u);
+  }
+  m_settings.encoder_queue = std::max<std::size_t>(m_settings.encoder_queue, 1);
+
+  m_path = path;
+  m_ring.Reset(m_settings.readback_slots);
+  m_settings.readback_slots = m_ring.GetSlotCount();
+
+  // waits for the frames of a previous capture that are still being written
+  m_writer.reset(new ImageWriter::AsyncWriter(m_settings.encoder_threads, m_settings.encoder_queue));
+
+  m_statistics = Statistics();
+  m_frameCount = path.GetFrameCount(m_settings.frames_per_second);
+  m_nextFrame = 0;
+  m_width = width;
+  m_height = height;
+  m_active = true;
+  return true;
+}
+
+void Capture::Stop()
+{
+  m_ring.Reset(m_ring.GetSlotCount());
+  m_active = false;
+}
+
+bool Capture::IsFinished() const
+{
+  return m_active && m_nextFrame >= m_frameCount && m_ring.GetBusyCount() == 0 && GetEncoderPendingCount() == 0;
+}
+
+CameraPath::Keyframe Capture::GetCamera(unsigned int frame) const
+{
+  return m_path.Evaluate(m_path.GetStartTime() + frame / m_settings.frames_per_second);
+}
+
+int Capture::AcquireSlot()
+{
+  if (!IsRendering())
+  {
+    return -1;
+  }
+
+  const int slot = m_ring.Acquire(m_nextFrame);
+  if (slot < 0)
+  {
+    m_statistics.slot_stalls++;
+    return -1;
+  }
+
+  m_nextFrame++;
+  m_statistics.frames_recorded++;
+  m_statistics.max_slots_in_flight = std::max(m_statistics.max_slots_in_flight, m_ring.GetBusyCount());
+  return slot;
+}
+
+void Capture::TagRecorded(std::uint64_t fenceValue)
+{
+  m_ring.Tag(fenceValue);
+}
+
+bool Capture::PopReadback(std::uint64_t completedValue, unsigned int& slot, unsigned int& frame)
+{
+  if (!m_active || !m_ring.PeekCompleted(completedValue, slot, frame))
+  {
+    return false;
+  }
+
+  // the render thread is the only producer, room seen here is still there in Submit
+  if (m_writer->IsFull())
+  {
+    m_statistics.encoder_stalls++;
+    return false;
+  }
+  return true;
+}
+
+void Capture::Submit(unsigned int slot, unsigned int frame, std::vector<float>&& accumulation)
+{
+  if (!m_writer->Submit(GetFramePath(frame), std::move(accumulation), m_width, m_height, m_settings.image_options))
+  {
+    m_statistics.frames_failed++;
+  }
+  m_ring.Release(slot);
+  m_statistics.max_queued = std::max(m_statistics.max_queued, m_writer->GetQueuedCount());
+}
+
+void Capture::Update()
+{
+  if (!m_writer)
+  {
+    return;
+  }
+
+  ImageWriter::AsyncWriter::Result result;
+  while (m_writer->PopResult(result))
+  {
+    if (result.success)
+    {
+      m_statistics.frames_written++;
+    }
+    else
+    {
+      m_statistics.frames_failed++;
+    }
+    m_statistics.encode_seconds += result.seconds;
+  }
+}
+
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include "CameraPath.h"
+#include "ImageWriter.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+//
+// SequenceCapture - renders the keyframed camera path of a scene into numbered images.
+//
+// Every frame of the sequence is accumulated to its sample count, copied into one of a
+// ring of readback buffers and handed to a pool of encoder threads. Nothing waits:
+//  - a converged frame takes a free readback slot, with every slot still in flight
+//    the renderer keeps accumulating and asks again next frame
+//  - a slot whose copy completed is only mapped once the encoder queue has room, so a
+//    slow disk holds slots, which holds the renderer, instead of queueing frames in memory
+// Like FrameFenceRing this only keeps the books, the caller records the copies, owns
+// the buffers and reports fence values, so it runs without a device.
+//
+namespace SequenceCapture {
+
+static const unsigned int MAX_READBACK_SLOTS = 8;
+
+struct Settings
+{
+  float frames_per_second = 30.0f;
+  unsigned int samples_per_frame = 256;
+
+  // The first run of # is replaced by the zero padded frame number, the extension
+  // picks the format. Without a # the number goes in front of the extension.
+  std::string output_pattern = "frame_####.exr";
+
+  unsigned int readback_slots = 3;
+  unsigned int encoder_threads = 0; // 0 for half of the cores
+  std::size_t encoder_queue = 4; // frames waiting for an encoder thread
+  ImageWriter::Options image_options;
+};
+
+struct Statistics
+{
+  unsigned int frames_recorded = 0; // copied into a readback slot
+  unsigned int frames_written = 0;
+  unsigned int frames_failed = 0;
+  unsigned int slot_stalls = 0; // frames that converged while every slot was busy
+  unsigned int encoder_stalls = 0; // polls that found a readback ready and the encoder queue full
+  unsigned int max_slots_in_flight = 0;
+  std::size_t max_queued = 0;
+  double encode_seconds = 0.0; // summed over the encoder threads
+};
+
+// The readback buffers as slots: free, recorded into this frame's command list, or in
+// flight until the fence of that frame passes.
+class ReadbackRing
+{
+public:
+  void Reset(unsigned int slotCount);
+
+  // Takes a free slot for frame, -1 if there is none.
+  int Acquire(unsigned int frame);
+
+  // The slots acquired since the last call go to the GPU with this fence value.
+  void Tag(std::uint64_t fenceValue);
+
+  // The completed slot with the lowest frame, false if none has completed.
+  bool PeekCompleted(std::uint64_t completedValue, unsigned int& slot, unsigned int& frame) const;
+
+  void Release(unsigned int slot);
+
+  unsigned int GetSlotCount() const { return static_cast<unsigned int>(m_slots.size()); }
+  unsigned int GetBusyCount() const;
+
+private:
+  enum class SlotState
+  {
+    Free,
+    Recorded,
+    InFlight,
+  };
+
+  struct Slot
+  {
+    SlotState state = SlotState::Free;
+    unsigned int frame = 0;
+    std::uint64_t fence_value = 0;
+  };
+
+  std::vector<Slot> m_slots;
+};
+
+// The file name of frame for a pattern as in Settings.
+std::string GetFramePath(const std::string& pattern, unsigned int frame);
+
+class Capture
+{
+public:
+  // width and height of the frames, which is what Submit expects. Returns false if
+  // the path has no keyframes or the pattern no known extension.
+  bool Start(const CameraPath::Path& path, const Settings& settings, unsigned int width, unsigned int height);
+
+  // Drops the frames not handed to the encoders, those finish in the background.
+  void Stop();
+
+  bool IsActive() const { return m_active; }
+
+  // Frames left to render, GetNextFrame is the one the renderer should accumulate.
+  bool IsRendering() const { return m_active && m_nextFrame < m_frameCount; }
+
+  // Every frame was rendered, read back and written.
+  bool IsFinished() const;
+
+  unsigned int GetFrameCount() const { return m_frameCount; }
+  unsigned int GetNextFrame() const { return m_nextFrame; }
+  unsigned int GetWidth() const { return m_width; }
+  unsigned int GetHeight() const { return m_height; }
+  const Settings& GetSettings() const { return m_settings; }
+  const Statistics& GetStatistics() const { return m_statistics; }
+
+  CameraPath::Keyframe GetCamera(unsigned int frame) const;
+  std::string GetFramePath(unsigned int frame) const { return SequenceCapture::GetFramePath(m_settings.output_pattern, frame); }
+
+  // The next frame converged: the slot to copy it into, which moves on to the next
+  // frame, or -1 while every slot is busy.
+  int AcquireSlot();
+
+  // Call once the frame that recorded the copies has been signaled with fenceValue.
+  void TagRecorded(std::uint64_t fenceValue);
+
+  // A slot whose copy completed, only while the encoders have room for it. Map it,
+  // copy it out and Submit the pixels.
+  bool PopReadback(std::uint64_t completedValue, unsigned int& slot, unsigned int& frame);
+
+  // Tightly packed accumulation of the slot PopReadback returned, rgb sums with the
+  // sample count in w. Frees the slot.
+  void Submit(unsigned int slot, unsigned int frame, std::vector<float>&& accumulation);
+
+  // Picks up what the encoders finished, once a frame.
+  void Update();
+
+  std::size_t GetEncoderPendingCount() const { return m_writer ? m_writer->GetPendingCount() : 0; }
+
+private:
+  Settings m_settings;
+  CameraPath::Path m_path;
+  ReadbackRing m_ring;
+  std::unique_ptr<ImageWriter::AsyncWriter> m_writer;
+  Statistics m_statistics;
+  unsigned int m_frameCount = 0;
+  unsigned int m_nextFrame = 0;
+  unsigned int m_width = 0;
+  unsigned int m_height = 0;
+  bool m_active = false;
+};
+
+}
@@ -0,0 +1,133 @@
+#include "stdafx.h"
+#include "ShaderCompiler.h"
+#include "Utilities.h"
+
+using Microsoft::WRL::ComPtr;
+
+ShaderCompiler::~ShaderCompiler()
+{
+  //the interfaces live in the DLL, release them before it goes
+  m_compiler.Reset();
+  m_library.Reset();
+  if (m_dll != nullptr)
+  {
+    FreeLibrary(m_dll);
+  }
+}
+
+bool ShaderCompiler::Load()
+{
+  if (m_compiler != nullptr)
+  {
+    return true;
+  }
+  if (m_loadFailed)
+  {
+    return false;
+  }
+
+  m_loadFailed = true;
+  m_dll = LoadLibraryW(L"dxcompiler.dll");
+  if (m_dll == nullptr)
+  {
+    return false;
+  }
+  auto createInstance = reinterpret_cast<DxcCreateInstanceProc>(GetProcAddress(m_dll, "DxcCreateInstance"));
+  if (createInstance == nullptr ||
+      FAILED(createInstance(CLSID_DxcLibrary, __uuidof(IDxcLibrary), reinterpret_cast<void**>(m_library.GetAddressOf()))) ||
+      FAILED(createInstance(CLSID_DxcCompiler, __uuidof(IDxcCompiler), reinterpret_cast<void**>(m_compiler.GetAddressOf()))))
+  {
+    m_library.Reset();
+    m_compiler.Reset();
+    return false;
+  }
+
+  //older compilers do not report a version, the DLL name has to do then
+  m_version = "dxcompiler";
+  ComPtr<IDxcVersionInfo> versionInfo;
+  UINT32 major = 0, minor = 0;
+  if (SUCCEEDED(m_compiler.As(&versionInfo)) && SUCCEEDED(versionInfo->GetVersion(&major, &minor)))
+  {
+    m_version += " " + std::to_string(major) + "." + std::to_string(minor);
+  }
+  m_loadFailed = false;
+  return true;
+}
+
+const std::string& ShaderCompiler::GetVersion()
+{
+  static const std::string none;
+  return Load() ? m_version : none;
+}
+
+bool ShaderCompiler::Compile(const std::string& path, const std::string& target, const std::vector<std::string>& arguments,
+                             const std::vector<ShaderPermutation::Define>& defines, std::vector<std::uint8_t>& library, std::string& error)
+{
+  if (!Load())
+  {
+    error = "dxcompiler.dll could not be loaded";
+    return false;
+  }
+
+  const std::wstring widePath = utilityCore::string2wstring(path);
+  const std::wstring wideTarget = utilityCore::string2wstring(target);
+  ComPtr<IDxcBlobEncoding> source;
+  if (FAILED(m_library->CreateBlobFromFile(widePath.c_str(), nullptr, &source)))
+  {
+    error = "cannot read " + path;
+    return false;
+  }
+
+  //DxcDefine and the arguments point into these
+  std::vector<std::wstring> wideArguments;
+  std::vector<std::wstring> wideDefines;
+  for (const std::string& argument : arguments)
+  {
+    wideArguments.push_back(utilityCore::string2wstring(argument));
+  }
+  for (const ShaderPermutation::Define& define : defines)
+  {
+    wideDefines.push_back(utilityCore::string2wstring(define.name));
+    wideDefines.push_back(utilityCore::string2wstring(define.value));
+  }
+  std::vector<LPCWSTR> argumentPointers;
+  for (const std::wstring& argument : wideArguments)
+  {
+    argumentPointers.push_back(argument.c_str());
+  }
+  std::vector<DxcDefine> dxcDefines;
+  for (std::size_t i = 0; i < defines.size(); i++)
+  {
+    dxcDefines.push_back({ wideDefines[2 * i].c_str(), wideDefines[2 * i + 1].c_str() });
+  }
+
+  ComPtr<IDxcIncludeHandler> includeHandler;
+  ComPtr<IDxcOperationResult> result;
+  HRESULT status = E_FAIL;
+  if (FAILED(m_library->CreateIncludeHandler(&includeHandler)) ||
+      FAILED(m_compiler->Compile(source.Get(), widePath.c_str(), L"", wideTarget.c_str(), argumentPointers.data(), static_cast<UINT32>(argumentPointers.size()),
+                                 dxcDefines.data(), static_cast<UINT32>(dxcDefines.size()), includeHandler.Get(), &result)) ||
+      FAILED(result->GetStatus(&status)) || FAILED(status))
+  {
+    ComPtr<IDxcBlobEncoding> errors;
+    if (result != nullptr && SUCCEEDED(result->GetErrorBuffer(&errors)) && errors != nullptr && errors->GetBufferSize() > 0)
+    {
+      error.assign(static_cast<const char*>(errors->GetBufferPointer()), errors->GetBufferSize());
+    }
+    else
+    {
+      error = "compiling " + path + " failed";
+    }
+    return false;
+  }
+
+  ComPtr<IDxcBlob> blob;
+  if (FAILED(result->GetResult(&blob)) || blob == nullptr || blob->GetBufferSize() == 0)
+  {
+    error = "the compiler returned no library for " + path;
+    return false;
+  }
+  const std::uint8_t* bytes = static_cast<const std::uint8_t*>(blob->GetBufferPointer());
+  library.assign(bytes, bytes + blob->GetBufferSize());
+  return true;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <wrl.h>
+#include "dxcapi.h"
+
+#include "ShaderPermutation.h"
+
+//
+// ShaderCompiler - compiles the shader permutations at runtime with dxcompiler.dll.
+//
+// The DLL ships with the Windows SDK and is loaded on first use. Without it nothing
+// compiles and the app keeps the libraries the build compiled in.
+//
+class ShaderCompiler
+{
+public:
+  ShaderCompiler() = default;
+  ~ShaderCompiler();
+  ShaderCompiler(const ShaderCompiler&) = delete;
+  ShaderCompiler& operator=(const ShaderCompiler&) = delete;
+
+  // "dxcompiler 1.4", part of the cache key. Empty if the compiler cannot be loaded.
+  const std::string& GetVersion();
+
+  // Compiles the file at path with the defines, includes resolve relative to it.
+  // Returns false with the compiler's messages in error.
+  bool Compile(const std::string& path, const std::string& target, const std::vector<std::string>& arguments,
+               const std::vector<ShaderPermutation::Define>& defines, std::vector<std::uint8_t>& library, std::string& error);
+
+private:
+  bool Load();
+
+  HMODULE m_dll = nullptr;
+  bool m_loadFailed = false;
+  Microsoft::WRL::ComPtr<IDxcLibrary> m_library;
+  Microsoft::WRL::ComPtr<IDxcCompiler> m_compiler;
+  std::string m_version;
+};
@@ -0,0 +1,351 @@
+#include "ShaderPermutation.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace ShaderPermutation {
+
+namespace {
+
+// Feature bits of RayTracingHlslCompat.h, which needs DirectXMath.
+const std::uint32_t c_featureAntiAliasing = 1;
+const std::uint32_t c_featureDepthOfField = 2;
+
+struct PathInfo
+{
+  std::uint32_t path;
+  const char* name;
+  const char* define;
+};
+
+const PathInfo c_paths[PathCount] = {
+  { PermutationNormalMapping, "normal mapping", "PERMUTATION_NORMAL_MAPPING" },
+  { PermutationGlass, "glass", "PERMUTATION_GLASS" },
+  { PermutationReflective, "reflective", "PERMUTATION_REFLECTIVE" },
+  { PermutationRefractive, "refractive", "PERMUTATION_REFRACTIVE" },
+  { PermutationEmissive, "emissive", "PERMUTATION_EMISSIVE" },
+  { PermutationDiffuse, "diffuse", "PERMUTATION_DIFFUSE" },
+  { PermutationAntiAliasing, "anti-aliasing", "PERMUTATION_ANTI_ALIASING" },
+  { PermutationDepthOfField, "depth of field", "PERMUTATION_DEPTH_OF_FIELD" },
+  { PermutationMicrofacet, "microfacet", "PERMUTATION_MICROFACET" },
+};
+
+// Cache entries start with this, the key and the size of the library.
+const char c_cacheMagic[8] = { 'R', 'T', 'X', 'P', 'E', 'R', 'M', '1' };
+
+std::string GetDirectory(const std::string& path)
+{
+  const std::size_t slash = path.find_last_of("/\\");
+  return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+bool ReadFile(const std::string& path, std::string& text)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+  {
+    return false;
+  }
+  std::ostringstream stream;
+  stream << file.rdbuf();
+  text = stream.str();
+  return true;
+}
+
+// The file names of the #include "..." lines, includes in comments count too: reading
+// a header too many only makes the key stricter.
+std::vector<std::string> FindIncludes(const std::string& text)
+{
+  std::vector<std::string> includes;
+  std::istringstream lines(text);
+  std::string line;
+  while (std::getline(lines, line))
+  {
+    std::size_t at = line.find_first_not_of(" \t");
+    if (at == std::string::npos || line[at] != '#')
+    {
+      continue;
+    }
+    at = line.find_first_not_of(" \t", at + 1);
+    if (at == std::string::npos || line.compare(at, 7, "include") != 0)
+    {
+      continue;
+    }
+    const std::size_t open = line.find('"', at + 7);
+    const std::size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+    if (close != std::string::npos)
+    {
+      includes.push_back(line.substr(open + 1, close - open - 1));
+    }
+  }
+  return includes;
+}
+
+bool ReadSourcesRecursive(const std::string& path, std::vector<Source>& sources, std::string& error)
+{
+  for (const Source& source : sources)
+  {
+    if (source.path == path)
+    {
+      return true;
+    }
+  }
+
+  Source source;
+  source.path = path;
+  if (!ReadFile(path, source.text))
+  {
+    error = "cannot read " + path;
+    return false;
+  }
+  const std::vector<std::string> includes = FindIncludes(source.text);
+  sources.push_back(std::move(source));
+
+  const std::string directory = GetDirectory(path);
+  for (const std::string& include : includes)
+  {
+    if (!ReadSourcesRecursive(directory + include, sources, error))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Strings go in with their length so "ab" + "c" and "a" + "bc" hash differently.
+std::uint64_t HashString(const std::string& value, std::uint64_t hash)
+{
+  const std::uint64_t size = value.size();
+  hash = Hash(&size, sizeof(size), hash);
+  return Hash(value.data(), value.size(), hash);
+}
+
+void MakeDirectory(const std::string& directory)
+{
+#ifdef _WIN32
+  _mkdir(directory.c_str());
+#else
+  mkdir(directory.c_str(), 0755);
+#endif
+}
+
+}
+
+std::uint32_t ClassifyObject(const ObjectShading& object)
+{
+  std::uint32_t paths = 0;
+  if (object.normal_map)
+  {
+    paths |= PermutationNormalMapping;
+  }
+  if (object.reflectiveness > 0.0f && object.refractiveness > 0.0f)
+  {
+    return paths | PermutationGlass;
+  }
+  if (object.reflectiveness > 0.0f)
+  {
+    return paths | PermutationReflective;
+  }
+  if (object.refractiveness > 0.0f)
+  {
+    return paths | PermutationRefractive;
+  }
+  if (object.emittance > 0.0f)
+  {
+    return paths | PermutationEmissive;
+  }
+  return paths | (object.roughness > 0.0f ? PermutationMicrofacet : PermutationDiffuse);
+}
+
+std::uint32_t Analyze(const std::vector<ObjectShading>& objects, std::uint32_t features)
+{
+  std::uint32_t permutation = 0;
+  for (const ObjectShading& object : objects)
+  {
+    permutation |= ClassifyObject(object);
+  }
+  if (features & c_featureAntiAliasing)
+  {
+    permutation |= PermutationAntiAliasing;
+  }
+  if (features & c_featureDepthOfField)
+  {
+    permutation |= PermutationDepthOfField;
+  }
+  return permutation;
+}
+
+std::uint32_t AnalyzeScene(const SceneCore::SceneData& scene, std::uint32_t features)
+{
+  std::vector<ObjectShading> objects;
+  objects.reserve(scene.objects.size());
+  for (const SceneCore::Object& object : scene.objects)
+  {
+    // the shader looks the normal texture up by offset, even if it failed to load
+    ObjectShading shading;
+    shading.normal_map = object.normal_texture >= 0;
+    if (const SceneCore::Material* material = SceneCore::SceneData::Find(scene.materials, object.material))
+    {
+      shading.reflectiveness = material->reflectiveness;
+      shading.refractiveness = material->refractiveness;
+      shading.emittance = material->emittance;
+      shading.roughness = material->roughness;
+    }
+    objects.push_back(shading);
+  }
+  return Analyze(objects, features);
+}
+
+const char* GetPathName(std::uint32_t path)
+{
+  for (const PathInfo& info : c_paths)
+  {
+    if (info.path == path)
+    {
+      return info.name;
+    }
+  }
+  return "unknown";
+}
+
+const char* GetDefineName(std::uint32_t path)
+{
+  for (const PathInfo& info : c_paths)
+  {
+    if (info.path == path)
+    {
+      return info.define;
+    }
+  }
+  return "";
+}
+
+std::string Describe(std::uint32_t permutation)
+{
+  std::string description;
+  for (const PathInfo& info : c_paths)
+  {
+    if (permutation & info.path)
+    {
+      description += description.empty() ? info.name : std::string(", ") + info.name;
+    }
+  }
+  return description.empty() ? "none" : description;
+}
+
+std::vector<Define> GetDefines(std::uint32_t permutation)
+{
+  std::vector<Define> defines;
+  for (const PathInfo& info : c_paths)
+  {
+    defines.push_back({ info.define, (permutation & info.path) ? "1" : "0" });
+  }
+  std::sort(defines.begin(), defines.end(), [](const Define& a, const Define& b) { return a.name < b.name; });
+  return defines;
+}
+
+bool ReadSources(const std::string& path, std::vector<Source>& sources, std::string& error)
+{
+  sources.clear();
+  return ReadSourcesRecursive(path, sources, error);
+}
+
+std::uint64_t Hash(const void* data, std::size_t size, std::uint64_t hash)
+{
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for (std::size_t i = 0; i < size; i++)
+  {
+    hash = (hash ^ bytes[i]) * 1099511628211ull;
+  }
+  return hash;
+}
+
+std::uint64_t ComputeCacheKey(const std::vector<Source>& sources, const std::vector<Define>& defines, const std::string& target,
+                              const std::vector<std::string>& arguments, const std::string& compiler)
+{
+  std::uint64_t hash = Hash(c_cacheMagic, sizeof(c_cacheMagic));
+  for (const Source& source : sources)
+  {
+    hash = HashString(source.path, hash);
+    hash = HashString(source.text, hash);
+  }
+  for (const Define& define : defines)
+  {
+    hash = HashString(define.name, hash);
+    hash = HashString(define.value, hash);
+  }
+  hash = HashString(target, hash);
+  for (const std::string& argument : arguments)
+  {
+    hash = HashString(argument, hash);
+  }
+  return HashString(compiler, hash);
+}
+
+std::string GetCachePath(const std::string& directory, const std::string& name, std::uint64_t key)
+{
+  char hex[17];
+  snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(key));
+  std::string path = directory;
+  if (!path.empty() && path.back() != '/' && path.back() != '\\')
+  {
+    path += '/';
+  }
+  return path + name + "_" + hex + ".dxil";
+}
+
+bool LoadCached(const std::string& path, std::uint64_t key, std::vector<std::uint8_t>& library)
+{
+  std::string contents;
+  const std::size_t header = sizeof(c_cacheMagic) + 2 * sizeof(std::uint64_t);
+  if (!ReadFile(path, contents) || contents.size() < header || std::memcmp(contents.data(), c_cacheMagic, sizeof(c_cacheMagic)) != 0)
+  {
+    return false;
+  }
+
+  std::uint64_t storedKey, size;
+  std::memcpy(&storedKey, contents.data() + sizeof(c_cacheMagic), sizeof(storedKey));
+  std::memcpy(&size, contents.data() + sizeof(c_cacheMagic) + sizeof(storedKey), sizeof(size));
+  if (storedKey != key || size == 0 || size != contents.size() - header)
+  {
+    return false;
+  }
+  library.assign(contents.begin() + header, contents.end());
+  return true;
+}
+
+bool StoreCached(const std::string& path, std::uint64_t key, const std::vector<std::uint8_t>& library)
+{
+  MakeDirectory(GetDirectory(path));
+
+  const std::string temporary = path + ".tmp";
+  {
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    const std::uint64_t size = library.size();
+    file.write(c_cacheMagic, sizeof(c_cacheMagic));
+    file.write(reinterpret_cast<const char*>(&key), sizeof(key));
+    file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    file.write(reinterpret_cast<const char*>(library.data()), library.size());
+    if (!file.flush())
+    {
+      file.close();
+      std::remove(temporary.c_str());
+      return false;
+    }
+  }
+
+  // rename does not replace an existing file on Windows
+  std::remove(path.c_str());
+  return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "SceneCore.h"
+
+//
+// ShaderPermutation - versions of Raytracing.hlsl with the paths a scene does not use
+// compiled out.
+//
+// The closest hit shader branches per hit on normal mapping and on the class of the
+// material (glass, reflective, refractive, emissive, microfacet, diffuse), the raygen
+// shader on the AntiAliasing and DepthOfField bits of the features. A permutation is
+// the set of those paths a scene needs; each one is a PERMUTATION_* define the shader
+// tests next to the runtime condition, so DXC drops the branches whose define is 0. The build
+// compiles every path in (all defines default to 1), that library stays the fallback.
+//
+// Compiled libraries are cached on disk, keyed by a hash of the shader sources with
+// every header they include, the defines, the target and the compiler.
+//
+// Nothing in here needs D3D, the CPU renderer's --permutation-report checks it.
+//
+namespace ShaderPermutation {
+
+enum Path : std::uint32_t
+{
+  PermutationNormalMapping = 1 << 0,
+  PermutationGlass = 1 << 1, // reflective and refractive, picked by the Fresnel term
+  PermutationReflective = 1 << 2,
+  PermutationRefractive = 1 << 3,
+  PermutationEmissive = 1 << 4,
+  PermutationDiffuse = 1 << 5,
+  PermutationAntiAliasing = 1 << 6,
+  PermutationDepthOfField = 1 << 7,
+  PermutationMicrofacet = 1 << 8,
+  PermutationAll = (1 << 9) - 1,
+};
+
+const std::size_t PathCount = 9;
+
+// What the closest hit shader reads of an object to pick its branch: the material
+// (none reads as zeros) and whether it has a normal texture.
+struct ObjectShading
+{
+  float reflectiveness = 0.0f;
+  float refractiveness = 0.0f;
+  float emittance = 0.0f;
+  float roughness = 0.0f;
+  bool normal_map = false;
+};
+
+struct Define
+{
+  std::string name;
+  std::string value;
+};
+
+struct Source
+{
+  std::string path;
+  std::string text;
+};
+
+// The branch of MyClosestHitShader the object takes, plus PermutationNormalMapping.
+std::uint32_t ClassifyObject(const ObjectShading& object);
+
+// The paths a scene needs: the branches of its objects and the features that are on,
+// features as in RayTracingHlslCompat.h.
+std::uint32_t Analyze(const std::vector<ObjectShading>& objects, std::uint32_t features);
+std::uint32_t AnalyzeScene(const SceneCore::SceneData& scene, std::uint32_t features);
+
+const char* GetPathName(std::uint32_t path);
+const char* GetDefineName(std::uint32_t path);
+
+// "glass, diffuse, anti-aliasing", "none" for 0.
+std::string Describe(std::uint32_t permutation);
+
+// One PERMUTATION_* define per path, sorted by name, 0 or 1.
+std::vector<Define> GetDefines(std::uint32_t permutation);
+
+// Reads path and, recursively, the headers it includes with quotes, relative to the
+// including file. Each file is read once, in the order the includes appear.
+bool ReadSources(const std::string& path, std::vector<Source>& sources, std::string& error);
+
+// 64 bit FNV-1a.
+std::uint64_t Hash(const void* data, std::size_t size, std::uint64_t hash = 14695981039346656037ull);
+
+// Changes with any byte of the sources, their paths, a define, the target, the compiler
+// arguments or the compiler version.
+std::uint64_t ComputeCacheKey(const std::vector<Source>& sources, const std::vector<Define>& defines, const std::string& target,
+                              const std::vector<std::string>& arguments, const std::string& compiler);
+
+// directory/name_<key as 16 hex digits>.dxil
+std::string GetCachePath(const std::string& directory, const std::string& name, std::uint64_t key);
+
+// A cached library, false if there is none. Entries carry their key and size, a
+// truncated or foreign file is a miss.
+bool LoadCached(const std::string& path, std::uint64_t key, std::vector<std::uint8_t>& library);
+
+// Written to a temporary file that replaces path, so a crash never leaves half an
+// entry. Creates the directory.
+bool StoreCached(const std::string& path, std::uint64_t key, const std::vector<std::uint8_t>& library);
+
+}
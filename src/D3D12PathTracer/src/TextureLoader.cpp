@@ -98,30 +98,31 @@ int TextureLoader::LoadImageDataFromFile(BYTE** imageData, D3D12_RESOURCE_DESC&
 {
 	HRESULT hr;
 
-	// we only need one instance of the imaging factory to create decoders and frames
-	static IWICImagingFactory *wicFactory;
-
-	// reset decoder, frame and converter since these will be different for each image we load
-	IWICBitmapDecoder *wicDecoder = NULL;
-	IWICBitmapFrameDecode *wicFrame = NULL;
-	IWICFormatConverter *wicConverter = NULL;
-
-	bool imageConverted = false;
-
-	if (wicFactory == NULL)
-	{
+	// we only need one instance of the imaging factory to create decoders and frames,
+	// created once even when the scene loader threads get here together
+	static IWICImagingFactory *wicFactory = []() -> IWICImagingFactory* {
 		// Initialize the COM library
 		CoInitialize(NULL);
 
 		// create the WIC factory
-		hr = CoCreateInstance(
+		IWICImagingFactory *factory = NULL;
+		HRESULT result = CoCreateInstance(
 			CLSID_WICImagingFactory,
 			NULL,
 			CLSCTX_INPROC_SERVER,
-			IID_PPV_ARGS(&wicFactory)
+			IID_PPV_ARGS(&factory)
 		);
-		if (FAILED(hr)) return 0;
-	}
+		return SUCCEEDED(result) ? factory : NULL;
+	}();
+
+	// reset decoder, frame and converter since these will be different for each image we load
+	IWICBitmapDecoder *wicDecoder = NULL;
+	IWICBitmapFrameDecode *wicFrame = NULL;
+	IWICFormatConverter *wicConverter = NULL;
+
+	bool imageConverted = false;
+
+	if (wicFactory == NULL) return 0;
 
 	// load a decoder for the image
 	hr = wicFactory->CreateDecoderFromFilename(
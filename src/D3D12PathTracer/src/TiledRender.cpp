@@ -0,0 +1,296 @@
+#include "TiledRender.h"
+#include "Utilities.h"
+#include "include/stb_image_write.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+namespace TiledRender {
+
+Tiler::Tiler(unsigned int imageWidth, unsigned int imageHeight, unsigned int tileWidth, unsigned int tileHeight) :
+  m_imageWidth(imageWidth),
+  m_imageHeight(imageHeight),
+  m_tileWidth(std::max(tileWidth, 1u)),
+  m_tileHeight(std::max(tileHeight, 1u))
+{
+  m_tilesX = (m_imageWidth + m_tileWidth - 1) / m_tileWidth;
+  m_tilesY = (m_imageHeight + m_tileHeight - 1) / m_tileHeight;
+}
+
+Tile Tiler::GetTile(unsigned int index) const
+{
+  Tile tile;
+  tile.index = index;
+  tile.x = (index % m_tilesX) * m_tileWidth;
+  tile.y = (index / m_tilesX) * m_tileHeight;
+  tile.width = std::min(m_tileWidth, m_imageWidth - tile.x);
+  tile.height = std::min(m_tileHeight, m_imageHeight - tile.y);
+  return tile;
+}
+
+std::string Scheduler::WriteHeader(const Settings& settings)
+{
+  std::stringstream header;
+  header << "TILED_RENDER" << std::endl;
+  header << "WIDTH " << settings.width << std::endl;
+  header << "HEIGHT " << settings.height << std::endl;
+  header << "TILE " << settings.tile_width << " " << settings.tile_height << std::endl;
+  header << "SAMPLES " << settings.samples_per_pixel << std::endl;
+  return header.str();
+}
+
+unsigned int Scheduler::Open(const Settings& settings, const Tiler& tiler, const std::string& manifestPath)
+{
+  m_done.assign(tiler.GetTileCount(), false);
+  m_next = 0;
+  m_doneCount = 0;
+  Close();
+
+  const std::string header = WriteHeader(settings);
+  bool resume = false;
+
+  //only trust the manifest if it was written for exactly these settings
+  std::ifstream existing(manifestPath);
+  if (existing.is_open())
+  {
+    std::string line;
+    std::string existing_header;
+    for (int i = 0; i < 5 && utilityCore::safeGetline(existing, line); i++)
+    {
+      existing_header += line + "\n";
+    }
+
+    if (existing_header == header)
+    {
+      resume = true;
+      while (utilityCore::safeGetline(existing, line))
+      {
+        std::vector<std::string> tokens = utilityCore::tokenizeString(line);
+        if (tokens.size() == 2 && tokens[0] == "DONE")
+        {
+          const unsigned int index = static_cast<unsigned int>(atoi(tokens[1].c_str()));
+          if (index < m_done.size() && !m_done[index])
+          {
+            m_done[index] = true;
+            m_doneCount++;
+          }
+        }
+      }
+    }
+  }
+  existing.close();
+
+  if (resume)
+  {
+    m_manifest.open(manifestPath, std::ios::out | std::ios::app);
+  }
+  else
+  {
+    m_manifest.open(manifestPath, std::ios::out | std::ios::trunc);
+    m_manifest << header;
+    m_manifest.flush();
+  }
+
+  SkipDone();
+  return m_doneCount;
+}
+
+void Scheduler::SkipDone()
+{
+  while (m_next < m_done.size() && m_done[m_next])
+  {
+    m_next++;
+  }
+}
+
+unsigned int Scheduler::TakeNext()
+{
+  const unsigned int index = m_next;
+  m_next++;
+  SkipDone();
+  return index;
+}
+
+void Scheduler::MarkDone(unsigned int index)
+{
+  if (index >= m_done.size() || m_done[index])
+  {
+    return;
+  }
+
+  m_done[index] = true;
+  m_doneCount++;
+
+  //flush every tile, a crash loses at most the tile in flight
+  m_manifest << "DONE " << index << std::endl;
+}
+
+void Scheduler::Close()
+{
+  if (m_manifest.is_open())
+  {
+    m_manifest.close();
+  }
+}
+
+bool DiskFramebuffer::Open(const std::string& path, unsigned int width, unsigned int height, bool keepExisting)
+{
+  Close();
+
+  m_width = width;
+  m_height = height;
+  const std::streamoff size = std::streamoff(width) * height * 4 * sizeof(float);
+
+  if (keepExisting)
+  {
+    m_file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+    if (m_file.is_open())
+    {
+      m_file.seekg(0, std::ios::end);
+      if (m_file.tellg() == size)
+      {
+        return true;
+      }
+      m_file.close();
+    }
+  }
+
+  //size the file up front, untouched pixels stay zero
+  {
+    std::ofstream create(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!create.is_open())
+    {
+      return false;
+    }
+    if (size > 0)
+    {
+      create.seekp(size - 1);
+      create.put(0);
+    }
+  }
+
+  m_file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+  return m_file.is_open();
+}
+
+void DiskFramebuffer::Close()
+{
+  if (m_file.is_open())
+  {
+    m_file.close();
+  }
+}
+
+void DiskFramebuffer::WriteTile(const Tile& tile, const float* rgba, std::size_t rowPitch)
+{
+  for (unsigned int row = 0; row < tile.height; row++)
+  {
+    const std::streamoff offset = (std::streamoff(tile.y + row) * m_width + tile.x) * 4 * sizeof(float);
+    m_file.seekp(offset);
+    m_file.write(reinterpret_cast<const char*>(rgba + row * rowPitch), std::streamsize(tile.width) * 4 * sizeof(float));
+  }
+  m_file.flush();
+}
+
+void DiskFramebuffer::ReadRow(unsigned int y, float* rgba)
+{
+  m_file.seekg(std::streamoff(y) * m_width * 4 * sizeof(float));
+  m_file.read(reinterpret_cast<char*>(rgba), std::streamsize(m_width) * 4 * sizeof(float));
+}
+
+bool DiskFramebuffer::SavePng(const std::string& path)
+{
+  std::vector<float> row(std::size_t(m_width) * 4);
+  std::vector<unsigned char> pixels(std::size_t(m_width) * m_height * 3);
+
+  for (unsigned int y = 0; y < m_height; y++)
+  {
+    ReadRow(y, row.data());
+    unsigned char* out = &pixels[std::size_t(y) * m_width * 3];
+    for (unsigned int x = 0; x < m_width; x++)
+    {
+      for (int c = 0; c < 3; c++)
+      {
+        out[x * 3 + c] = static_cast<unsigned char>(utilityCore::clamp(row[x * 4 + c], 0.0f, 1.0f) * 255.0f + 0.5f);
+      }
+    }
+  }
+
+  return stbi_write_png(path.c_str(), m_width, m_height, 3, pixels.data(), m_width * 3) != 0;
+}
+
+bool Job::Start(const Settings& settings, unsigned int maxTileWidth, unsigned int maxTileHeight)
+{
+  m_settings = settings;
+
+  //tiles have to fit in the raytracing output, that also bounds the dispatch size
+  m_settings.tile_width = std::max(1u, std::min(settings.tile_width, maxTileWidth));
+  m_settings.tile_height = std::max(1u, std::min(settings.tile_height, maxTileHeight));
+  m_settings.samples_per_pixel = std::max(1u, settings.samples_per_pixel);
+
+  m_tiler = Tiler(m_settings.width, m_settings.height, m_settings.tile_width, m_settings.tile_height);
+  const unsigned int already_done = m_scheduler.Open(m_settings, m_tiler, m_settings.output_path + ".manifest");
+
+  if (!m_framebuffer.Open(m_settings.output_path + ".rgba32f", m_settings.width, m_settings.height, already_done > 0))
+  {
+    m_active = false;
+    return false;
+  }
+
+  m_active = true;
+  return true;
+}
+
+void Job::Cancel()
+{
+  //the manifest and framebuffer stay on disk so the render can be resumed
+  m_framebuffer.Close();
+  m_scheduler.Close();
+  m_active = false;
+}
+
+Tile Job::TakeNextTile()
+{
+  return m_tiler.GetTile(m_scheduler.TakeNext());
+}
+
+void Job::CompleteTile(const Tile& tile, const float* accumulation, std::size_t rowPitch)
+{
+  m_resolved.resize(std::size_t(tile.width) * tile.height * 4);
+
+  for (unsigned int y = 0; y < tile.height; y++)
+  {
+    const float* in = accumulation + y * rowPitch;
+    float* out = &m_resolved[std::size_t(y) * tile.width * 4];
+    for (unsigned int x = 0; x < tile.width; x++)
+    {
+      const float samples = std::max(in[x * 4 + 3], 1.0f);
+      out[x * 4 + 0] = in[x * 4 + 0] / samples;
+      out[x * 4 + 1] = in[x * 4 + 1] / samples;
+      out[x * 4 + 2] = in[x * 4 + 2] / samples;
+      out[x * 4 + 3] = 1.0f;
+    }
+  }
+
+  m_framebuffer.WriteTile(tile, m_resolved.data(), std::size_t(tile.width) * 4);
+  m_scheduler.MarkDone(tile.index);
+}
+
+bool Job::Finish()
+{
+  const bool saved = m_framebuffer.SavePng(m_settings.output_path);
+  m_framebuffer.Close();
+  m_scheduler.Close();
+  m_active = false;
+
+  if (saved)
+  {
+    std::remove((m_settings.output_path + ".rgba32f").c_str());
+    std::remove((m_settings.output_path + ".manifest").c_str());
+  }
+  return saved;
+}
+
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+//
+// TiledRender - offline rendering of images larger than the window.
+//
+// The target image is split into tiles no larger than the raytracing output,
+// each tile is rendered to its sample count on the GPU and then stitched into a
+// full size RGBA32F framebuffer that lives in a file on disk, so the image never
+// has to fit in memory. Finished tiles are appended to a manifest, restarting a
+// job with the same settings picks up where the previous one stopped.
+//
+// Only depends on the standard library, cpurender --tiled-report checks it.
+//
+namespace TiledRender {
+
+struct Settings
+{
+  unsigned int width = 7680;
+  unsigned int height = 4320;
+  unsigned int tile_width = 512;
+  unsigned int tile_height = 512;
+  unsigned int samples_per_pixel = 1024;
+
+  // the framebuffer goes to output_path + ".rgba32f", the manifest to output_path + ".manifest"
+  std::string output_path{};
+};
+
+struct Tile
+{
+  unsigned int index = 0;
+  unsigned int x = 0;
+  unsigned int y = 0;
+  unsigned int width = 0;
+  unsigned int height = 0;
+};
+
+// Splits the image into a row major grid of tiles, edge tiles are clipped to the image.
+class Tiler
+{
+public:
+  Tiler() = default;
+  Tiler(unsigned int imageWidth, unsigned int imageHeight, unsigned int tileWidth, unsigned int tileHeight);
+
+  unsigned int GetTilesX() const { return m_tilesX; }
+  unsigned int GetTilesY() const { return m_tilesY; }
+  unsigned int GetTileCount() const { return m_tilesX * m_tilesY; }
+  Tile GetTile(unsigned int index) const;
+
+private:
+  unsigned int m_imageWidth = 0;
+  unsigned int m_imageHeight = 0;
+  unsigned int m_tileWidth = 1;
+  unsigned int m_tileHeight = 1;
+  unsigned int m_tilesX = 0;
+  unsigned int m_tilesY = 0;
+};
+
+// Hands out the tiles that are not finished yet and records finished ones in the manifest.
+class Scheduler
+{
+public:
+  // Opens the manifest at manifestPath. If it was written for the same settings the
+  // tiles listed in it are skipped, otherwise a new manifest is started.
+  // Returns the number of tiles that were already done.
+  unsigned int Open(const Settings& settings, const Tiler& tiler, const std::string& manifestPath);
+
+  bool HasNext() const { return m_next < m_done.size(); }
+  unsigned int PeekNext() const { return m_next; }
+
+  // Moves the cursor past the next unfinished tile and returns it, the tile is
+  // only marked done by MarkDone once its pixels are safely on disk.
+  unsigned int TakeNext();
+
+  void MarkDone(unsigned int index);
+  void Close();
+
+  unsigned int GetDoneCount() const { return m_doneCount; }
+  unsigned int GetTileCount() const { return static_cast<unsigned int>(m_done.size()); }
+
+  static std::string WriteHeader(const Settings& settings);
+
+private:
+  void SkipDone();
+
+  std::vector<bool> m_done;
+  unsigned int m_next = 0;
+  unsigned int m_doneCount = 0;
+  std::ofstream m_manifest;
+};
+
+// Full size RGBA32F image in a file, tiles are written in place one row at a time.
+class DiskFramebuffer
+{
+public:
+  // keepExisting reuses the pixels of an interrupted render if the file has the right size.
+  bool Open(const std::string& path, unsigned int width, unsigned int height, bool keepExisting);
+  void Close();
+
+  // Stitch a tile in. rgba points at the first pixel of the tile, rowPitch is in floats.
+  void WriteTile(const Tile& tile, const float* rgba, std::size_t rowPitch);
+  void ReadRow(unsigned int y, float* rgba);
+
+  // Tonemap (clamp) the whole image into an 8 bit png, rows are streamed from disk.
+  bool SavePng(const std::string& path);
+
+  unsigned int GetWidth() const { return m_width; }
+  unsigned int GetHeight() const { return m_height; }
+
+private:
+  std::fstream m_file;
+  unsigned int m_width = 0;
+  unsigned int m_height = 0;
+};
+
+// Ties the three together for one render, this is what the renderer drives.
+class Job
+{
+public:
+  // Returns false if the framebuffer file could not be opened.
+  bool Start(const Settings& settings, unsigned int maxTileWidth, unsigned int maxTileHeight);
+  void Cancel();
+
+  bool IsActive() const { return m_active; }
+  bool IsFinished() const { return m_active && !m_scheduler.HasNext() && m_scheduler.GetDoneCount() == m_scheduler.GetTileCount(); }
+
+  const Settings& GetSettings() const { return m_settings; }
+  const Tiler& GetTiler() const { return m_tiler; }
+  unsigned int GetDoneCount() const { return m_scheduler.GetDoneCount(); }
+  unsigned int GetTileCount() const { return m_scheduler.GetTileCount(); }
+
+  bool HasNextTile() const { return m_scheduler.HasNext(); }
+  Tile TakeNextTile();
+
+  // accumulation is the tile of the GPU accumulator: rgb sums and the sample count in w,
+  // rowPitch in floats. Resolves the average, stitches it in and marks the tile done.
+  void CompleteTile(const Tile& tile, const float* accumulation, std::size_t rowPitch);
+
+  // Writes output_path as png and drops the manifest and the framebuffer file.
+  bool Finish();
+
+private:
+  Settings m_settings;
+  Tiler m_tiler;
+  Scheduler m_scheduler;
+  DiskFramebuffer m_framebuffer;
+  std::vector<float> m_resolved;
+  bool m_active = false;
+};
+
+}
@@ -1,11 +1,15 @@
-#include "stdafx.h"
-
 #include <glm/glm/gtc/matrix_transform.hpp>
 #include <glm/glm/gtc/matrix_inverse.hpp>
 #include <iostream>
 #include <cstdio>
 
-#include "utilities.h"
+#include "Utilities.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
 
 float utilityCore::clamp(float f, float min, float max) {
 	if (f < min) {
@@ -19,8 +23,9 @@ float utilityCore::clamp(float f, float min, float max) {
 	}
 }
 
-wstring utilityCore::string2wstring(const std::string& s)
+std::wstring utilityCore::string2wstring(const std::string& s)
 {
+#ifdef _WIN32
 	int len;
 	int slength = (int)s.length() + 1;
 	len = MultiByteToWideChar(CP_ACP, 0, s.c_str(), slength, 0, 0);
@@ -29,6 +34,9 @@ wstring utilityCore::string2wstring(const std::string& s)
 	std::wstring r(buf);
 	delete[] buf;
 	return r;
+#else
+	return std::wstring(s.begin(), s.end());
+#endif
 }
 
 bool utilityCore::replaceString(std::string& str, const std::string& from, const std::string& to) {
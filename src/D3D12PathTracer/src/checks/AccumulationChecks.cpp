@@ -0,0 +1,189 @@
+#include "checks/Checks.h"
+#include "shaders/AccumulationHlslCompat.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace Checks {
+
+namespace {
+
+// One pixel of the accumulation the way the raygen shader keeps it.
+struct AccumulatedPixel
+{
+  float stored[3] = {};
+  float compensation[3] = {};
+  unsigned int samples = 0;
+};
+
+// Not a format of the renderer: Half without its compensation, to show what it is for.
+const unsigned int c_uncompensatedHalf = Accumulation::AccumulationFormatCount;
+
+// The load, add and store of StoreAccumulation and LoadAccumulation in Raytracing.hlsl,
+// one sample per dispatch.
+void Accumulate(unsigned int format, AccumulatedPixel& pixel, const float color[3], unsigned int id)
+{
+  using namespace Accumulation;
+  const float previous = static_cast<float>(pixel.samples);
+  const float count = static_cast<float>(++pixel.samples);
+  const float offset = Sampling::SamplerToFloat(Sampling::SamplerHash(Sampling::SamplerHashCombine(Sampling::SamplerHash(id), pixel.samples)));
+  for (unsigned int c = 0; c < 3; c++)
+  {
+    if (format == AccumulationFloat32)
+    {
+      pixel.stored[c] += color[c];
+      continue;
+    }
+
+    const float previousMean = format == AccumulationHalf ? AccumulationDecodeHalf(pixel.stored[c], pixel.compensation[c]) : pixel.stored[c];
+    const float mean = (previousMean * previous + color[c]) / count;
+    if (format == AccumulationHalf)
+    {
+      pixel.stored[c] = AccumulationEncodeHalf(mean);
+      pixel.compensation[c] = AccumulationEncodeCompensation(mean, pixel.stored[c]);
+    }
+    else if (format == AccumulationPacked)
+    {
+      pixel.stored[c] = AccumulationEncodePacked(mean, c, offset);
+    }
+    else
+    {
+      pixel.stored[c] = AccumulationEncodeHalf(mean);
+    }
+  }
+}
+
+float AccumulatedMean(unsigned int format, const AccumulatedPixel& pixel, unsigned int c)
+{
+  using namespace Accumulation;
+  if (format == AccumulationFloat32)
+  {
+    return pixel.stored[c] / std::max(static_cast<float>(pixel.samples), 1.0f);
+  }
+  return format == AccumulationHalf ? AccumulationDecodeHalf(pixel.stored[c], pixel.compensation[c]) : pixel.stored[c];
+}
+
+}
+
+int AccumulationChecks(const Options&)
+{
+  using namespace Accumulation;
+  Log check;
+
+  // Pixels whose means span six orders of magnitude, exponentially distributed samples
+  // with the odd firefly, accumulated in every format next to a double precision sum.
+  // The error of the storage is measured in standard errors of the Monte Carlo
+  // estimate, below a small fraction of one it cannot be told apart from noise.
+  const unsigned int pixelCount = 512;
+  const unsigned int checkpoints[] = { 16, 256, 4096, 65536 };
+  const unsigned int checkpointCount = static_cast<unsigned int>(sizeof(checkpoints) / sizeof(checkpoints[0]));
+  const unsigned int formatCount = AccumulationFormatCount + 1;
+  const char* names[formatCount] = { "float32", "half, compensated", "packed r11g11b10", "half, uncompensated" };
+
+  std::vector<double> relativeError(formatCount * checkpointCount, 0.0);
+  std::vector<double> maxRelativeError(formatCount * checkpointCount, 0.0);
+  std::vector<double> standardErrors(formatCount * checkpointCount, 0.0);
+  std::vector<double> bias(formatCount * checkpointCount, 0.0);
+  std::vector<double> squaredError(formatCount * checkpointCount, 0.0);
+
+  const auto start = std::chrono::steady_clock::now();
+  for (unsigned int id = 0; id < pixelCount; id++)
+  {
+    const double scale = std::pow(10.0, -3.0 + 6.0 * (id + 0.5) / pixelCount);
+    const float tint[3] = { 1.0f, 0.7f, 0.35f };
+    AccumulatedPixel pixels[formatCount];
+    double sum[3] = {};
+    double sumSquares[3] = {};
+    unsigned int checkpoint = 0;
+    for (unsigned int s = 1; s <= checkpoints[checkpointCount - 1]; s++)
+    {
+      const std::uint32_t hash = Sampling::SamplerHash(Sampling::SamplerHashCombine(Sampling::SamplerHash(id + 0x51ed27u), s));
+      const double u = Sampling::SamplerToFloat(hash);
+      const double firefly = (Sampling::SamplerHash(hash) & 255u) == 0 ? 50.0 : 1.0;
+      float color[3];
+      for (unsigned int c = 0; c < 3; c++)
+      {
+        color[c] = static_cast<float>(-std::log(1.0 - u) * scale * tint[c] * firefly);
+        sum[c] += color[c];
+        sumSquares[c] += double(color[c]) * color[c];
+      }
+      for (unsigned int f = 0; f < formatCount; f++)
+      {
+        Accumulate(f, pixels[f], color, id);
+      }
+
+      if (s == checkpoints[checkpoint])
+      {
+        for (unsigned int f = 0; f < formatCount; f++)
+        {
+          const std::size_t at = f * checkpointCount + checkpoint;
+          for (unsigned int c = 0; c < 3; c++)
+          {
+            const double reference = sum[c] / s;
+            const double standardError = std::sqrt(std::max(sumSquares[c] / s - reference * reference, 0.0) / s);
+            const double error = AccumulatedMean(f, pixels[f], c) - reference;
+            relativeError[at] += std::abs(error) / reference;
+            maxRelativeError[at] = std::max(maxRelativeError[at], std::abs(error) / reference);
+            standardErrors[at] += std::abs(error) / std::max(standardError, 1e-30);
+            bias[at] += error / reference;
+            squaredError[at] += (error / reference) * (error / reference);
+          }
+        }
+        checkpoint++;
+      }
+    }
+  }
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  printf("accumulation formats, %u pixels with means from 0.001 to 1000, %.1f s\n", pixelCount, seconds);
+  printf("  %-20s %5s %9s  %-40s  %s\n", "", "bytes", "4k MB", "mean relative error at 16/256/4k/64k spp", "error in standard errors");
+  const double channels = 3.0 * pixelCount;
+  bool passed = true;
+  for (unsigned int f = 0; f < formatCount; f++)
+  {
+    const unsigned int bytes = f < AccumulationFormatCount ? AccumulationBytesPerPixel(f) : 8;
+    printf("  %-20s %5u %9.1f ", names[f], bytes, bytes * 3840.0 * 2160.0 / (1024.0 * 1024.0));
+    for (unsigned int k = 0; k < checkpointCount; k++)
+    {
+      printf(" %9.2e", relativeError[f * checkpointCount + k] / channels);
+    }
+    printf("  ");
+    for (unsigned int k = 0; k < checkpointCount; k++)
+    {
+      printf(" %6.3f", standardErrors[f * checkpointCount + k] / channels);
+    }
+    printf("\n");
+  }
+
+  // Float32 and Half have to be lost in the noise everywhere. Packed has to stay
+  // unbiased, within four standard deviations of its average over the pixels, and
+  // below one standard error for as long as a preview accumulates.
+  for (unsigned int k = 0; k < checkpointCount; k++)
+  {
+    for (unsigned int f : { unsigned(AccumulationFloat32), unsigned(AccumulationHalf) })
+    {
+      passed &= standardErrors[f * checkpointCount + k] / channels < 0.01 && maxRelativeError[f * checkpointCount + k] < 1e-3;
+    }
+    const std::size_t packed = AccumulationPacked * checkpointCount + k;
+    passed &= std::abs(bias[packed] / channels) < 4.0 * std::sqrt(squaredError[packed] / channels / pixelCount);
+    passed &= checkpoints[k] > 256 || standardErrors[packed] / channels < 1.0;
+  }
+  printf("  packed bias at 16/256/4k/64k spp:");
+  for (unsigned int k = 0; k < checkpointCount; k++)
+  {
+    printf(" %+.1e", bias[AccumulationPacked * checkpointCount + k] / channels);
+  }
+  printf("\n  %s\n", Verdict(passed));
+  check.Record(passed);
+
+  // A reset used to copy a cleared RGBA32F texture over the accumulation, the second
+  // moment and both guides, the raygen shader now starts them over itself.
+  printf("\ncamera reset at 3840 x 2160: %.0f MB copied before, nothing now\n", 2.0 * 4 * 16 * 3840.0 * 2160.0 / (1024.0 * 1024.0));
+  return check.Result();
+}
+
+}
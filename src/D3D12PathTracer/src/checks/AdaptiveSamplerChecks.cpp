@@ -0,0 +1,218 @@
+#include "checks/Checks.h"
+#include "AdaptiveSampler.h"
+#include "shaders/AdaptiveHlslCompat.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace Checks {
+
+namespace {
+
+std::uint32_t FloatBits(float value)
+{
+  std::uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+float BitsFloat(std::uint32_t bits)
+{
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// The raygen shader on the CPU: the active tiles dispatched ADAPTIVE_TILE_SIZE wide with a
+// block of rows each, every pixel of the image reporting into the slot of its tile by
+// InterlockedMax on the bits of its error, into a buffer cleared to zero like TileErrors.
+std::vector<float> DispatchTileErrors(const AdaptiveSampler& sampler, const std::vector<float>& accumulation, const std::vector<float>& moments)
+{
+  const unsigned int tileSize = ADAPTIVE_TILE_SIZE;
+  const std::vector<std::uint32_t>& activeTiles = sampler.GetActiveTiles();
+  std::vector<std::uint32_t> slots(sampler.GetTileCount(), 0);
+
+  const std::size_t dispatchHeight = tileSize * activeTiles.size();
+  for (std::size_t y = 0; y < dispatchHeight; y++)
+  {
+    for (unsigned int x = 0; x < tileSize; x++)
+    {
+      const std::uint32_t tileIndex = activeTiles[y / tileSize];
+      const unsigned int pixelX = tileIndex % sampler.GetTilesX() * tileSize + x;
+      const unsigned int pixelY = tileIndex / sampler.GetTilesX() * tileSize + static_cast<unsigned int>(y % tileSize);
+      if (pixelX >= sampler.GetWidth() || pixelY >= sampler.GetHeight())
+      {
+        continue;
+      }
+
+      const std::size_t pixel = (static_cast<std::size_t>(pixelY) * sampler.GetWidth() + pixelX) * 4;
+      const std::uint32_t sampleCount = static_cast<std::uint32_t>(accumulation[pixel + 3]);
+      float error = ADAPTIVE_UNCONVERGED_ERROR;
+      if (sampleCount >= sampler.GetMinSamples())
+      {
+        const float count = static_cast<float>(sampleCount);
+        error = std::max(Adaptive::ComputeRelativeError(accumulation[pixel], moments[pixel], count),
+                         std::max(Adaptive::ComputeRelativeError(accumulation[pixel + 1], moments[pixel + 1], count),
+                                  Adaptive::ComputeRelativeError(accumulation[pixel + 2], moments[pixel + 2], count)));
+      }
+      slots[tileIndex] = std::max(slots[tileIndex], FloatBits(error));
+    }
+  }
+
+  std::vector<float> tileErrors(slots.size());
+  std::transform(slots.begin(), slots.end(), tileErrors.begin(), BitsFloat);
+  return tileErrors;
+}
+
+// A tile keeps its errors if it is dispatched, retired slots stay at the cleared zero.
+bool MatchesOnActiveTiles(const AdaptiveSampler& sampler, const std::vector<float>& reference, const std::vector<float>& dispatched)
+{
+  std::vector<bool> active(sampler.GetTileCount(), false);
+  for (std::uint32_t tile : sampler.GetActiveTiles())
+  {
+    active[tile] = true;
+  }
+  bool matches = reference.size() == dispatched.size();
+  for (std::size_t tile = 0; matches && tile < reference.size(); tile++)
+  {
+    matches = active[tile] ? reference[tile] == dispatched[tile] : dispatched[tile] == 0.0f;
+  }
+  return matches;
+}
+
+}
+
+int AdaptiveSamplerChecks(const Options&)
+{
+  Log check;
+
+  {
+    const float values[] = { 0.0f, 1e-6f, 0.049f, 0.05f, 1.0f, 3.5f, 1e20f, ADAPTIVE_UNCONVERGED_ERROR };
+    bool ordered = true;
+    for (float a : values)
+    {
+      for (float b : values)
+      {
+        ordered &= (FloatBits(a) < FloatBits(b)) == (a < b);
+      }
+    }
+    check(ordered, "positive errors keep their order as uints for InterlockedMax");
+  }
+
+  // 100 x 70 leaves edge tiles 4 pixels wide and 6 high. The noise grows from tile to tile
+  // so the threshold splits them, and the top right tile is short of samples.
+  const unsigned int width = 100;
+  const unsigned int height = 70;
+  const unsigned int minSamples = 16;
+  AdaptiveSampler sampler;
+  sampler.Resize(width, height, ADAPTIVE_TILE_SIZE);
+  sampler.SetMinSamples(minSamples);
+  sampler.SetThreshold(0.05f);
+  check(sampler.GetTilesX() == 7 && sampler.GetTilesY() == 5 && sampler.GetActiveTiles().size() == 35,
+        "edge tiles round the grid up, every tile starts active");
+
+  std::vector<float> accumulation(static_cast<std::size_t>(width) * height * 4, 0.0f);
+  std::vector<float> moments(accumulation.size(), 0.0f);
+  std::mt19937 random(27);
+  std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+  for (unsigned int y = 0; y < height; y++)
+  {
+    for (unsigned int x = 0; x < width; x++)
+    {
+      const std::size_t pixel = (static_cast<std::size_t>(y) * width + x) * 4;
+      const unsigned int tile = x / ADAPTIVE_TILE_SIZE + y / ADAPTIVE_TILE_SIZE * sampler.GetTilesX();
+      const float noise = 0.05f * static_cast<float>(tile);
+      const unsigned int samples = x >= 96 && y < 16 ? minSamples - 1 : 64;
+      for (unsigned int s = 0; s < samples; s++)
+      {
+        for (int c = 0; c < 3; c++)
+        {
+          const float sample = (0.2f + 0.2f * static_cast<float>(c)) * (1.0f + noise * uniform(random));
+          accumulation[pixel + c] += sample;
+          moments[pixel + c] += sample * sample;
+        }
+      }
+      accumulation[pixel + 3] = static_cast<float>(samples);
+    }
+  }
+
+  std::vector<float> reference;
+  sampler.ComputeTileErrors(accumulation.data(), moments.data(), reference);
+  std::vector<float> dispatched = DispatchTileErrors(sampler, accumulation, moments);
+  check(MatchesOnActiveTiles(sampler, reference, dispatched), "the reference matches the tiles the shader dispatches");
+
+  {
+    //the corner tile from its 4 x 6 pixels alone
+    float corner = 0.0f;
+    for (unsigned int y = 64; y < height; y++)
+    {
+      for (unsigned int x = 96; x < width; x++)
+      {
+        const std::size_t pixel = (static_cast<std::size_t>(y) * width + x) * 4;
+        corner = std::max(corner, AdaptiveSampler::ComputePixelError(&accumulation[pixel], &moments[pixel], accumulation[pixel + 3], minSamples));
+      }
+    }
+    check(reference.back() == corner && corner > 0.0f, "an edge tile only sees the pixels inside the image");
+  }
+  check(reference[6] == ADAPTIVE_UNCONVERGED_ERROR && reference[5] < ADAPTIVE_UNCONVERGED_ERROR,
+        "a tile short of samples reports unconverged");
+
+  {
+    unsigned int expected = 0;
+    for (float error : dispatched)
+    {
+      expected += error <= sampler.GetThreshold();
+    }
+    const unsigned int retired = sampler.ApplyTileErrors(dispatched.data(), dispatched.size());
+    const std::vector<std::uint32_t>& active = sampler.GetActiveTiles();
+    bool kept = std::is_sorted(active.begin(), active.end());
+    for (std::uint32_t tile : active)
+    {
+      kept &= dispatched[tile] > sampler.GetThreshold();
+    }
+    printf("%u of %u tiles retired at a threshold of %.2f\n", retired, sampler.GetTileCount(), sampler.GetThreshold());
+    check(retired == expected && retired > 0 && !active.empty() && kept && sampler.GetConvergedTileCount() == retired,
+          "the readback retires the tiles under the threshold, no others");
+    check(std::find(active.begin(), active.end(), 6u) != active.end(), "tiles short of samples stay active");
+  }
+
+  {
+    //the next frame only dispatches what is left, retired slots stay cleared and are not
+    //read, a retired tile is not brought back by the zero in its slot
+    dispatched = DispatchTileErrors(sampler, accumulation, moments);
+    check(MatchesOnActiveTiles(sampler, reference, dispatched), "the reference matches the shrunk dispatch");
+    const unsigned int converged = sampler.GetConvergedTileCount();
+    check(sampler.ApplyTileErrors(dispatched.data(), dispatched.size()) == 0 && sampler.GetConvergedTileCount() == converged,
+          "a second readback of the same errors retires nothing");
+  }
+
+  {
+    const std::vector<float> stale(sampler.GetTileCount() + 1, 0.0f);
+    const unsigned int converged = sampler.GetConvergedTileCount();
+    check(sampler.ApplyTileErrors(stale.data(), stale.size()) == 0 && sampler.GetConvergedTileCount() == converged,
+          "a readback from before a resize is ignored");
+  }
+
+  sampler.Reset();
+  check(sampler.GetActiveTiles().size() == sampler.GetTileCount() && sampler.GetConvergedTileCount() == 0, "reset makes every tile active again");
+
+  bool threw = false;
+  try
+  {
+    sampler.Resize(width, height, 0);
+  }
+  catch (const std::invalid_argument&)
+  {
+    threw = true;
+  }
+  check(threw, "a tile size of zero is refused");
+
+  return check.Result();
+}
+
+}
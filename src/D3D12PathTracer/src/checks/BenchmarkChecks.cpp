@@ -0,0 +1,108 @@
+#include "checks/Checks.h"
+#include "Benchmark.h"
+#include "CpuPathTracer.h"
+#include "CpuRenderCommon.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Checks {
+
+int BenchmarkChecks(const Options&)
+{
+  Log check;
+
+  const Benchmark::Summary odd = Benchmark::Summarize({ 5.0, 1.0, 3.0 });
+  const Benchmark::Summary even = Benchmark::Summarize({ 4.0, 1.0, 3.0, 2.0 });
+  check(Near(odd.median, 3.0, 1e-12) && Near(odd.mean, 3.0, 1e-12) && Near(odd.variance, 4.0, 1e-12) && Near(odd.minimum, 1.0, 1e-12) && Near(odd.maximum, 5.0, 1e-12) &&
+          Near(even.median, 2.5, 1e-12) && Near(Benchmark::Summarize({ 7.0 }).variance, 0.0, 1e-12),
+        "medians, means and sample variances are exact");
+
+  Benchmark::Report report;
+  report.settings = "320x180, 16 spp";
+  report.runs = 3;
+  Benchmark::SceneResult scene;
+  scene.scene = "src/scenes/a,b.txt";
+  scene.triangles = 12;
+  scene.image_hash = 0xfedcba9876543210ull;
+  for (double ms : { 10.0, 11.0, 12.0 })
+  {
+    scene.Add("parse", 0.1);
+    scene.Add("render", ms);
+  }
+  report.scenes.push_back(scene);
+
+  const char* path = "benchmark_report.json";
+  std::string error;
+  Benchmark::Report read;
+  const bool roundTrip = Benchmark::Write(path, report, error) && Benchmark::ReadJson(path, read, error);
+  std::remove(path);
+  check(roundTrip && read.settings == report.settings && read.runs == 3 && read.scenes.size() == 1 && read.scenes[0].scene == scene.scene &&
+          read.scenes[0].image_hash == scene.image_hash && read.scenes[0].phases.size() == 2 && read.scenes[0].Find("render") != nullptr &&
+          read.scenes[0].Find("render")->milliseconds == scene.Find("render")->milliseconds,
+        "JSON keeps the settings, hashes and every run");
+
+  const std::string csv = Benchmark::ToCsv(report);
+  check(csv.find("scene,phase,runs,median_ms") == 0 && std::count(csv.begin(), csv.end(), '\n') == 3 &&
+          csv.find("\"src/scenes/a,b.txt\",render,3,11.0000") != std::string::npos,
+        "CSV has a row per phase and quotes commas");
+
+  // 11 ms -> 12.65 ms is 15% slower, parse 0.1 ms -> 0.2 ms is 100% but below the noise floor
+  Benchmark::Report slower = report;
+  slower.scenes[0].phases[0].milliseconds = { 0.2, 0.2, 0.2 };
+  slower.scenes[0].phases[1].milliseconds = { 12.65, 12.65, 12.65 };
+  Benchmark::Comparison comparison = Benchmark::Compare(slower, report, 10.0, CpuRender::c_benchmarkMinimumMilliseconds);
+  check(comparison.regressions.size() == 1 && comparison.regressions[0].phase == "render" && std::abs(comparison.regressions[0].change_percent - 15.0) < 1e-6 &&
+          comparison.changed_images.empty() && comparison.missing.empty() && !comparison.settings_differ,
+        "a slower median above the threshold and the noise floor regresses");
+  check(Benchmark::Compare(slower, report, 20.0, CpuRender::c_benchmarkMinimumMilliseconds).regressions.empty() &&
+          Benchmark::Compare(report, slower, 10.0, CpuRender::c_benchmarkMinimumMilliseconds).regressions.empty(),
+        "below the threshold or faster is no regression");
+
+  Benchmark::Report different = report;
+  different.settings = "640x360, 16 spp";
+  different.scenes[0].image_hash = 1;
+  different.scenes[0].phases.pop_back();
+  comparison = Benchmark::Compare(different, report, 10.0, CpuRender::c_benchmarkMinimumMilliseconds);
+  check(comparison.settings_differ && comparison.changed_images.size() == 1 && comparison.missing.size() == 1 &&
+          Benchmark::Compare(Benchmark::Report(), report, 10.0, CpuRender::c_benchmarkMinimumMilliseconds).missing.size() == 1,
+        "other settings, images and missing phases or scenes are reported");
+
+  const std::vector<std::string> scenes = Benchmark::ListFiles("src/scenes", ".txt");
+  check(std::find(scenes.begin(), scenes.end(), "src/scenes/cornell.txt") != scenes.end() && std::is_sorted(scenes.begin(), scenes.end()) &&
+          Benchmark::ListFiles("src/no_such_directory", ".txt").empty(),
+        "the bundled scenes are found in order");
+
+  // the same settings render the same image, on one thread or many
+  CpuPathTracer::Settings settings;
+  settings.width = 64;
+  settings.height = 36;
+  settings.samples_per_pixel = 2;
+  settings.tile_size = 16;
+  CpuRender::BenchmarkOptions benchmarkOptions;
+  std::vector<std::pair<std::string, double>> phases;
+  Benchmark::SceneResult first, second, threaded;
+  const bool wasEnabled = Profiler::IsEnabled();
+  Profiler::SetEnabled(true);
+  settings.threads = 1;
+  bool ran = CpuRender::RunBenchmarkScene("src/scenes/cornell.txt", settings, benchmarkOptions, true, first, phases) &&
+             CpuRender::RunBenchmarkScene("src/scenes/cornell.txt", settings, benchmarkOptions, true, second, phases);
+  settings.threads = 4;
+  ran = ran && CpuRender::RunBenchmarkScene("src/scenes/cornell.txt", settings, benchmarkOptions, true, threaded, phases);
+  Profiler::SetEnabled(wasEnabled);
+  bool timed = phases.size() == 6;
+  for (const auto& phase : phases)
+  {
+    timed = timed && (phase.second > 0.0 || phase.first == "lights");
+  }
+  check(ran && first.image_hash == second.image_hash && first.image_hash == threaded.image_hash, "cornell renders the same image every run and on 4 threads");
+  check(timed, "every phase of a cornell run is timed");
+  return check.Result();
+}
+
+}
@@ -0,0 +1,156 @@
+#include "checks/Checks.h"
+#include "BvhQuality.h"
+#include "CpuBvh.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace Checks {
+
+int BvhQualityChecks(const Options&)
+{
+  Log check;
+
+  {
+    BvhQuality::Tree tree;
+    tree.AddTriangle(glm::vec3(0.0f), glm::vec3(2.0f, 0.0f, 0.0f), glm::vec3(0.0f, 2.0f, 0.0f));
+    const BvhQuality::Face& face = tree.faces[0];
+    check(Near(BvhQuality::ClippedArea(face, glm::vec3(-1.0f), glm::vec3(3.0f)), 2.0) &&
+          Near(BvhQuality::ClippedArea(face, glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(1.0f)), 1.0) &&
+          BvhQuality::ClippedArea(face, glm::vec3(5.0f), glm::vec3(6.0f)) == 0.0, "triangles clipped to boxes keep the area inside");
+    tree.AddBox(glm::vec3(-1.0f), glm::vec3(1.0f));
+    double boxArea = 0.0;
+    for (std::size_t i = tree.primitive_faces[1]; i < tree.primitive_faces[2]; i++)
+    {
+      boxArea += BvhQuality::ClippedArea(tree.faces[i], glm::vec3(-2.0f), glm::vec3(2.0f));
+    }
+    check(tree.GetPrimitiveCount() == 2 && Near(boxArea, 24.0), "a box primitive has the surface of the box");
+  }
+
+  // Two unit right triangles at x 0 and x 3 under a root, each in a leaf of its own
+  BvhQuality::Tree pair;
+  pair.AddTriangle(glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+  pair.AddTriangle(glm::vec3(3.0f, 0.0f, 0.0f), glm::vec3(4.0f, 0.0f, 0.0f), glm::vec3(3.0f, 1.0f, 0.0f));
+  pair.references = { 0, 1 };
+  pair.nodes.resize(3);
+  pair.nodes[0].min = glm::vec3(0.0f);
+  pair.nodes[0].max = glm::vec3(4.0f, 1.0f, 0.0f);
+  pair.nodes[0].left = 1;
+  pair.nodes[0].right = 2;
+  for (int i = 1; i < 3; i++)
+  {
+    pair.nodes[i].min = glm::vec3(3.0f * (i - 1), 0.0f, 0.0f);
+    pair.nodes[i].max = glm::vec3(3.0f * (i - 1) + 1.0f, 1.0f, 0.0f);
+    pair.nodes[i].first = i - 1;
+    pair.nodes[i].count = 1;
+  }
+  {
+    const BvhQuality::Metrics metrics = BvhQuality::Analyze(pair);
+    check(metrics.nodes == 3 && metrics.leaves == 2 && metrics.primitives == 2 && metrics.max_depth == 1 && Near(metrics.mean_leaf_depth, 1.0) &&
+          metrics.leaf_sizes == std::vector<std::uint64_t>{ 0, 2 }, "nodes, leaves, depth and the leaf sizes of a pair");
+    // flat boxes: 2 * 4 for the root, 2 * 1 for either leaf
+    check(Near(metrics.sah, 1.2 + 2.0 * 1.0 * 2.0 / 8.0) && metrics.epo == 0.0, "SAH of a pair, leaves apart overlap nothing");
+
+    BvhQuality::Tree grown = pair;
+    grown.nodes[2].min.x = 0.0f;
+    const BvhQuality::Metrics overlapping = BvhQuality::Analyze(grown);
+    check(Near(overlapping.epo, 0.5 * 1.0 / 1.0), "EPO of a leaf grown over the other triangle");
+    BvhQuality::Costs costs;
+    costs.primitive = 2.0;
+    check(Near(BvhQuality::Analyze(grown, costs).epo, 1.0) && Near(BvhQuality::Analyze(grown, costs).sah, 1.2 + 2.0 * (2.0 + 8.0) / 8.0),
+          "SAH and EPO scale with the cost of a primitive");
+  }
+
+  // The CPU builder on a grid of triangles
+  {
+    std::vector<glm::vec3> positions;
+    std::vector<std::uint32_t> indices;
+    for (int y = 0; y < 16; y++)
+    {
+      for (int x = 0; x < 16; x++)
+      {
+        const std::uint32_t first = static_cast<std::uint32_t>(positions.size());
+        positions.push_back(glm::vec3(float(x), float(y), 0.1f * float(x % 3)));
+        positions.push_back(glm::vec3(float(x + 1), float(y), 0.0f));
+        positions.push_back(glm::vec3(float(x), float(y + 1), 0.0f));
+        indices.insert(indices.end(), { first, first + 1, first + 2 });
+      }
+    }
+    CpuBvh bvh;
+    bvh.AddMesh(0, positions, indices, false);
+    bvh.Build();
+    BvhQuality::Tree tree;
+    bvh.ExportTree(tree);
+    const BvhQuality::Metrics metrics = BvhQuality::Analyze(tree);
+    std::uint64_t leaves = 0;
+    for (std::uint64_t count : metrics.leaf_sizes)
+    {
+      leaves += count;
+    }
+    check(metrics.nodes == bvh.GetNodeCount() && metrics.primitives == 256 && leaves == metrics.leaves && metrics.leaf_sizes.size() <= 5 &&
+          metrics.leaf_sizes[0] == 0, "the CPU builder's tree holds every triangle once, four a leaf");
+    check(metrics.sah > 1.2 && metrics.sah < 1.2 * metrics.nodes && metrics.epo >= 0.0 && metrics.max_depth >= 6,
+          "the CPU builder's tree has a plausible SAH and depth");
+  }
+
+  // The pair as the fallback layer lays it out, a bottom and a top level
+  auto Fallback = [&](bool topLevel) {
+    const std::size_t nodes = 16;
+    const std::size_t primitives = nodes + 3 * 32;
+    const std::size_t metadata = primitives + (topLevel ? 2 * 116 : 2 * 40);
+    std::vector<unsigned char> bytes(metadata + 2 * 12, 0);
+    auto Write = [&](std::size_t offset, const void* data, std::size_t size) { std::memcpy(bytes.data() + offset, data, size); };
+    const std::uint32_t header[4] = { static_cast<std::uint32_t>(nodes), static_cast<std::uint32_t>(primitives), static_cast<std::uint32_t>(metadata),
+                                      static_cast<std::uint32_t>(bytes.size()) };
+    Write(0, header, sizeof(header));
+    for (std::size_t i = 0; i < 3; i++)
+    {
+      const glm::vec3 center = 0.5f * (pair.nodes[i].min + pair.nodes[i].max);
+      const glm::vec3 halfDim = 0.5f * (pair.nodes[i].max - pair.nodes[i].min);
+      const std::uint32_t flags = i == 0 ? 1u : (0x80000000u | static_cast<std::uint32_t>(i - 1));
+      const std::uint32_t second = i == 0 ? 2u : 1u;
+      Write(nodes + i * 32, &center, 12);
+      Write(nodes + i * 32 + 12, &flags, 4);
+      Write(nodes + i * 32 + 16, &halfDim, 12);
+      Write(nodes + i * 32 + 28, &second, 4);
+    }
+    for (std::size_t i = 0; i < 2 && !topLevel; i++)
+    {
+      const std::uint32_t type = 1;
+      Write(primitives + i * 40, &type, 4);
+      Write(primitives + i * 40 + 4, pair.faces[i].corners, 36);
+    }
+    return bytes;
+  };
+  {
+    const std::vector<unsigned char> bottom = Fallback(false);
+    BvhQuality::Tree tree;
+    std::string error;
+    const bool parsed = BvhQuality::FromFallback(bottom.data(), bottom.size(), false, tree, error);
+    const BvhQuality::Metrics metrics = BvhQuality::Analyze(tree);
+    const BvhQuality::Metrics expected = BvhQuality::Analyze(pair);
+    check(parsed && tree.GetPrimitiveCount() == 2 && tree.faces[1].corners[0] == glm::vec3(3.0f, 0.0f, 0.0f) && Near(metrics.sah, expected.sah) &&
+          metrics.leaf_sizes == expected.leaf_sizes && metrics.epo == 0.0, "a bottom level of the fallback layer reads back as the pair");
+
+    const std::vector<unsigned char> top = Fallback(true);
+    const bool topParsed = BvhQuality::FromFallback(top.data(), top.size(), true, tree, error);
+    check(topParsed && tree.GetPrimitiveCount() == 2 && Near(BvhQuality::Analyze(tree).sah, expected.sah),
+          "a fallback top level takes its leaves' boxes as the instances");
+
+    std::vector<unsigned char> pastPrimitives = bottom;
+    const std::uint32_t leaf = 0x80000000u | 5u;
+    std::memcpy(pastPrimitives.data() + 16 + 32 + 12, &leaf, 4);
+    std::vector<unsigned char> shared = bottom;
+    const std::uint32_t left = 1;
+    std::memcpy(shared.data() + 16 + 28, &left, 4);
+    check(!BvhQuality::FromFallback(pastPrimitives.data(), pastPrimitives.size(), false, tree, error) &&
+          !BvhQuality::FromFallback(shared.data(), shared.size(), false, tree, error) &&
+          !BvhQuality::FromFallback(bottom.data(), 12, false, tree, error) && !BvhQuality::FromFallback(bottom.data(), 100, false, tree, error),
+          "bad leaves, truncated buffers and shared children fail");
+  }
+  return check.Result();
+}
+
+}
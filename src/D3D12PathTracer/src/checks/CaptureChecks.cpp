@@ -0,0 +1,209 @@
+#include "checks/Checks.h"
+#include "CameraPath.h"
+#include "ImageWriter.h"
+#include "SequenceCapture.h"
+#include "Utilities.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Checks {
+
+namespace {
+
+// Greatest distance between two cameras, eye, look-at and fov together.
+float CameraDistance(const CameraPath::Keyframe& a, const CameraPath::Keyframe& b)
+{
+  return std::max(std::max(glm::length(a.eye - b.eye), glm::length(a.lookat - b.lookat)), std::abs(a.fov - b.fov));
+}
+
+}
+
+int CaptureChecks(const Options&)
+{
+  Log check;
+
+  // The camera path has to pass through every key, without kinks, and the scene lines
+  // have to survive a round trip through the scene writer
+  {
+    const char* lines[] = {
+      "keyframe 0    0 2 -10    0 0 1",
+      "keyframe 2   -4 2 -9     0 0 1   60",
+      "keyframe 1   -2 3 -9.5   0 0 1",
+      "keyframe 4    4 2 -9     0 0 1",
+    };
+    CameraPath::Path path;
+    bool parsed = true;
+    for (const char* line : lines)
+    {
+      CameraPath::Keyframe key;
+      parsed &= CameraPath::ParseKeyframe(utilityCore::tokenizeString(line), key);
+      path.AddKeyframe(key);
+    }
+    path.SetDefaultFov(45.0f);
+    CameraPath::Keyframe rejected;
+    parsed &= !CameraPath::ParseKeyframe(utilityCore::tokenizeString("keyframe 1  0 0 0"), rejected);
+
+    float keyError = 0.0f;
+    float roundTripError = 0.0f;
+    for (const auto& key : path.GetKeyframes())
+    {
+      keyError = std::max(keyError, CameraDistance(path.Evaluate(key.time), key));
+      CameraPath::Keyframe written;
+      parsed &= CameraPath::ParseKeyframe(utilityCore::tokenizeString(CameraPath::FormatKeyframe(key)), written);
+      roundTripError = std::max(roundTripError, CameraDistance(written, key) + std::abs(written.time - key.time));
+    }
+
+    // slopes on either side of the inner keys
+    float kink = 0.0f;
+    const float h = 1e-3f;
+    for (std::size_t i = 1; i + 1 < path.GetKeyframes().size(); i++)
+    {
+      const float t = path.GetKeyframes()[i].time;
+      const glm::vec3 before = (path.Evaluate(t).eye - path.Evaluate(t - h).eye) / h;
+      const glm::vec3 after = (path.Evaluate(t + h).eye - path.Evaluate(t).eye) / h;
+      kink = std::max(kink, glm::length(after - before));
+    }
+
+    const bool clamped = CameraDistance(path.Evaluate(-1.0f), path.GetKeyframes().front()) == 0.0f &&
+                         CameraDistance(path.Evaluate(9.0f), path.GetKeyframes().back()) == 0.0f;
+    const unsigned int frames = path.GetFrameCount(30.0f);
+    const bool passed = parsed && clamped && keyError < 1e-4f && roundTripError < 1e-4f && kink < 0.05f && frames == 121;
+    printf("camera path: 4 keys, %u frames at 30 fps, key error %.2g, slope jump at keys %.3f  %s\n", frames, keyError, kink, Verdict(passed));
+    check.Record(passed);
+  }
+
+  // A fake renderer drives the capture the way the GPU renderer does: a frame converges
+  // after a number of frames, its copy completes a fixed number of frames after it was
+  // recorded. The encoders are the real ones. Every frame is filled with its number, so
+  // reading the files back shows whether each frame went where it belongs.
+  struct Scenario
+  {
+    const char* name;
+    unsigned int width;
+    unsigned int height;
+    ImageWriter::ExrPixelType pixel_type;
+    unsigned int slots;
+    std::size_t queue;
+    unsigned int threads;
+    unsigned int gpu_latency; // frames until a copy completes
+    unsigned int converge_frames;
+    bool expect_waits; // the encoders cannot keep up
+  };
+  const Scenario scenarios[] = {
+    { "balanced", 96, 54, ImageWriter::ExrPixelType::Half, 3, 4, 2, 2, 2, false },
+    { "one slot", 96, 54, ImageWriter::ExrPixelType::Half, 1, 1, 1, 3, 1, false },
+    { "slow encoder", 320, 180, ImageWriter::ExrPixelType::Float, 2, 1, 1, 2, 1, true },
+    { "encoder pool", 320, 180, ImageWriter::ExrPixelType::Float, 3, 2, 4, 2, 1, true },
+  };
+
+  printf("\nfake renderer, 24 frames each\n");
+  printf("  %-13s %5s %5s %7s %9s %9s %9s %9s %9s  %s\n", "", "slots", "queue", "threads", "seconds", "slot wait", "enc wait", "in flight", "queued", "max frame ms");
+  for (const Scenario& scenario : scenarios)
+  {
+    CameraPath::Path path;
+    CameraPath::Keyframe key;
+    key.fov = 45.0f;
+    path.AddKeyframe(key);
+    key.time = 23.0f / 30.0f;
+    key.eye.x += 1.0f;
+    path.AddKeyframe(key);
+
+    SequenceCapture::Settings settings;
+    settings.output_pattern = "capture_report_####.exr";
+    settings.readback_slots = scenario.slots;
+    settings.encoder_queue = scenario.queue;
+    settings.encoder_threads = scenario.threads;
+    settings.image_options.exr_pixel_type = scenario.pixel_type;
+
+    SequenceCapture::Capture capture;
+    const bool started = capture.Start(path, settings, scenario.width, scenario.height);
+    const std::size_t floats = std::size_t(scenario.width) * scenario.height * 4;
+    std::vector<std::vector<float>> readbacks(scenario.slots, std::vector<float>(floats));
+
+    std::uint64_t signaled = 0;
+    unsigned int accumulated = 0;
+    double longestFrame = 0.0;
+    const auto start = std::chrono::steady_clock::now();
+    while (started && !capture.IsFinished() && std::chrono::steady_clock::now() - start < std::chrono::seconds(30))
+    {
+      const auto frameStart = std::chrono::steady_clock::now();
+      capture.Update();
+
+      unsigned int slot = 0;
+      unsigned int frame = 0;
+      const std::uint64_t completed = signaled > scenario.gpu_latency ? signaled - scenario.gpu_latency : 0;
+      while (capture.PopReadback(completed, slot, frame))
+      {
+        capture.Submit(slot, frame, std::vector<float>(readbacks[slot]));
+      }
+
+      if (capture.IsRendering() && ++accumulated >= scenario.converge_frames)
+      {
+        const unsigned int next = capture.GetNextFrame();
+        const int acquired = capture.AcquireSlot();
+        if (acquired >= 0)
+        {
+          // what the copy of the GPU renderer would bring back: 4 samples of frame + 1
+          std::vector<float>& pixels = readbacks[acquired];
+          for (std::size_t i = 0; i < floats; i += 4)
+          {
+            pixels[i] = pixels[i + 1] = pixels[i + 2] = 4.0f * (next + 1);
+            pixels[i + 3] = 4.0f;
+          }
+          accumulated = 0;
+        }
+      }
+
+      capture.TagRecorded(++signaled);
+      longestFrame = std::max(longestFrame, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+      std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    capture.Update();
+
+    // every file holds its own frame
+    unsigned int misplaced = 0;
+    for (unsigned int frame = 0; frame < capture.GetFrameCount(); frame++)
+    {
+      const std::string path = capture.GetFramePath(frame);
+      std::vector<std::uint8_t> data;
+      if (FILE* file = fopen(path.c_str(), "rb"))
+      {
+        int c;
+        while ((c = fgetc(file)) != EOF)
+        {
+          data.push_back(static_cast<std::uint8_t>(c));
+        }
+        fclose(file);
+      }
+      ImageWriter::Image image;
+      const bool read = ImageWriter::DecodeExr(data, image) && image.width == scenario.width && image.height == scenario.height;
+      misplaced += !read || std::any_of(image.rgba.begin(), image.rgba.end(), [&](float v) { return v != frame + 1.0f && v != 1.0f; }) ||
+                   image.rgba[0] != frame + 1.0f;
+      remove(path.c_str());
+    }
+
+    const SequenceCapture::Statistics& stats = capture.GetStatistics();
+    const bool passed = started && capture.IsFinished() && capture.GetFrameCount() == 24 && stats.frames_written == 24 && stats.frames_failed == 0 &&
+                        misplaced == 0 && stats.max_slots_in_flight <= scenario.slots && stats.max_queued <= scenario.queue &&
+                        (!scenario.expect_waits || stats.slot_stalls + stats.encoder_stalls > 0);
+    printf("  %-13s %5u %5zu %7u %9.2f %9u %9u %9u %9zu  %.2f  %s\n", scenario.name, scenario.slots, scenario.queue, scenario.threads, seconds,
+           stats.slot_stalls, stats.encoder_stalls, stats.max_slots_in_flight, stats.max_queued, longestFrame, Verdict(passed));
+    if (misplaced > 0)
+    {
+      printf("    %u frames missing or written to the wrong file\n", misplaced);
+    }
+    check.Record(passed);
+  }
+
+  return check.Result();
+}
+
+}
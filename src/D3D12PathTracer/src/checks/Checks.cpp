@@ -0,0 +1,168 @@
+#include "checks/Checks.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace Checks {
+
+bool Log::operator()(bool passed, const char* what)
+{
+  printf("%-64s %s\n", what, Verdict(passed));
+  return Record(passed);
+}
+
+bool Log::Record(bool passed)
+{
+  m_failed |= !passed;
+  return passed;
+}
+
+bool Near(double a, double b, double tolerance)
+{
+  return std::abs(a - b) <= tolerance * std::max(1.0, std::abs(b));
+}
+
+const std::vector<Suite>& GetSuites()
+{
+  static const std::vector<Suite> suites = {
+    { "--sampler-report",
+      "  --sampler-report        measure the discrepancy of the samplers and how fast each\n"
+      "                          converges on a scene (src/scenes/cornell.txt) against a\n"
+      "                          sobol reference of --spp samples (1024), 128 x 72 by default\n",
+      true, SamplerChecks },
+    { "--denoise-report",
+      "  --denoise-report        check the denoiser against synthetic noisy images with known\n"
+      "                          references (exit code 1 if a PSNR target is missed) and\n"
+      "                          measure it on a scene (src/scenes/cornell.txt) at 1, 4 and\n"
+      "                          16 spp against --spp samples (1024), 320 x 180 by default\n",
+      true, DenoiseChecks },
+    { "--adaptive-report",
+      "  --adaptive-report       check the tile errors of adaptive sampling against the\n"
+      "                          dispatch and readback layout of the raygen shader, exit\n"
+      "                          code 1 if a tile is misplaced or retired too early\n",
+      false, AdaptiveSamplerChecks },
+    { "--fence-report",
+      "  --fence-report          run the frame fence ring around a fake queue that keeps up,\n"
+      "                          lags or stalls, exit code 1 if a slot is reused in flight\n"
+      "                          or a readback is tagged with the wrong frame\n",
+      false, FrameFenceChecks },
+    { "--tiled-report",
+      "  --tiled-report          check the tiles, the stitching and the resume of tiled\n"
+      "                          rendering on files in the working directory, exit code 1\n"
+      "                          if a pixel is missed, doubled or misplaced\n",
+      false, TiledRenderChecks },
+    { "--light-report",
+      "  --light-report          check the emissive triangle list and a chi-square test of\n"
+      "                          its alias table against the emitted power, exit code 1 if\n"
+      "                          a light is sampled with the wrong odds\n",
+      false, LightChecks },
+    { "--image-report",
+      "  --image-report          round trip every output format and the half conversion,\n"
+      "                          exit code 1 if anything does not come back as expected\n",
+      false, ImageChecks },
+    { "--capture-report",
+      "  --capture-report        check the camera path and run the sequence capture queue\n"
+      "                          against a fake renderer, exit code 1 on a lost, misplaced\n"
+      "                          or unbounded frame\n",
+      false, CaptureChecks },
+    { "--accumulation-report",
+      "  --accumulation-report   measure the error of the accumulation formats against a\n"
+      "                          double precision sum, exit code 1 if float32 or half\n"
+      "                          stand out of the noise or packed drifts\n",
+      false, AccumulationChecks },
+    { "--packing-report",
+      "  --packing-report        round trip the payload and vertex encodings of the GPU\n"
+      "                          and report the vertex memory of the scenes (cornell and\n"
+      "                          room by default), exit code 1 if one is off\n",
+      false, PackingChecks },
+    { "--permutation-report",
+      "  --permutation-report    check the scene analysis and the cache keys of the shader\n"
+      "                          permutations and print the permutation of each scene\n"
+      "                          (cornell and room by default), exit code 1 on a mismatch\n",
+      false, PermutationChecks },
+    { "--microfacet-report",
+      "  --microfacet-report     check the energy table, the energy conservation and the\n"
+      "                          sampling pdf of the metal/roughness BSDF, exit code 1 if\n"
+      "                          one is off\n",
+      false, MicrofacetChecks },
+    { "--parser-report",
+      "  --parser-report         check the scene parser against the old tokenizer and atof\n"
+      "                          and time both, and the asset loads on one and on all cores\n"
+      "                          (dragon and subsurfacetest by default), exit code 1 on a\n"
+      "                          mismatch\n",
+      false, ParserChecks },
+    { "--format-report",
+      "  --format-report         round trip scenes (all of src/scenes by default) through the\n"
+      "                          text, json and rtxscene encodings and time all three on a\n"
+      "                          synthetic scene of 100k objects, exit code 1 on a difference\n",
+      false, FormatChecks },
+    { "--descriptor-report",
+      "  --descriptor-report     check the descriptor allocator of the GPU renderer and run\n"
+      "                          it through 100k descriptors with removals, exit code 1 if\n"
+      "                          two views share a descriptor or a freed one is lost\n",
+      false, DescriptorChecks },
+    { "--hot-reload-report",
+      "  --hot-reload-report     check the dependency graph and the debouncing of the file\n"
+      "                          watcher against a fake file system, and inotify or polling\n"
+      "                          on real files, exit code 1 if a change is missed or doubled\n",
+      false, HotReloadChecks },
+    { "--profile-report",
+      "  --profile-report        check the scopes, rings and chrome trace of the profiler,\n"
+      "                          also from many threads at once, and time a scope, exit\n"
+      "                          code 1 if an event is lost or misplaced\n",
+      false, ProfileChecks },
+    { "--benchmark-report",
+      "  --benchmark-report      check the statistics, output and baseline comparison of\n"
+      "                          --benchmark and that a run reproduces its image\n",
+      false, BenchmarkChecks },
+    { "--golden-report",
+      "  --golden-report         check the image metrics, the noise floor and the tolerance,\n"
+      "                          and that biased renders of cornell fail where noisy ones pass\n",
+      false, GoldenChecks },
+    { "--scene-stats-report",
+      "  --scene-stats-report    check the bounds, vertex counts, padding and overlaps of the\n"
+      "                          scene statistics and the report of cornell\n",
+      false, SceneStatsChecks },
+    { "--bvh-quality-report",
+      "  --bvh-quality-report    check SAH, EPO and the leaf sizes of small trees, the export\n"
+      "                          of the CPU builder and the parsing of fallback layer BVHs\n",
+      false, BvhQualityChecks },
+  };
+  return suites;
+}
+
+const Suite* Find(const std::string& option)
+{
+  for (const Suite& suite : GetSuites())
+  {
+    if (option == suite.option)
+    {
+      return &suite;
+    }
+  }
+  return nullptr;
+}
+
+int Run(const std::vector<const Suite*>& suites, const Options& options)
+{
+  int result = 0;
+  std::size_t failed = 0;
+  for (const Suite* suite : suites)
+  {
+    if (suites.size() > 1)
+    {
+      printf("%s== %s\n", suite == suites.front() ? "" : "\n", suite->option + 2);
+    }
+    const int suiteResult = suite->run(options);
+    failed += suiteResult != 0;
+    result |= suiteResult;
+  }
+  if (suites.size() > 1)
+  {
+    printf("\n%zu of %zu suites passed\n", suites.size() - failed, suites.size());
+  }
+  return result;
+}
+
+}
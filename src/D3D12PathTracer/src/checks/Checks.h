@@ -0,0 +1,95 @@
+#pragma once
+
+#include "CpuPathTracer.h"
+#include "Denoiser.h"
+
+#include <string>
+#include <vector>
+
+#include <glm/glm/glm.hpp>
+
+//
+// Checks - the self checks of the portable parts of the path tracer, run by cpurender.
+//
+// Every suite is a function of its own in checks/, behind a --...-report option of
+// cpurender and listed in GetSuites. --checks runs all of them but the measurements
+// against rendered references, which take minutes. A suite prints one line per check
+// and returns 1 if any failed, so the exit code of cpurender tells a script whether
+// everything passed.
+//
+// Only depends on the portable sources, nothing here needs D3D12 or a window.
+//
+namespace Checks {
+
+// What cpurender was given besides the suite. Suites that load scenes use scenes if
+// any were given, render settings are only taken where size_given and spp_given say
+// they were set, the suites pick their own sizes otherwise.
+struct Options
+{
+  std::vector<std::string> scenes;
+  CpuPathTracer::Settings settings;
+  bool size_given = false;
+  bool spp_given = false;
+  Denoiser::Settings denoiser;
+
+  std::vector<std::string> GetScenes(const std::vector<std::string>& defaults) const { return scenes.empty() ? defaults : scenes; }
+};
+
+// The outcome of the checks of a suite.
+class Log
+{
+public:
+  // Prints what was checked and whether it passed on a line of its own.
+  bool operator()(bool passed, const char* what);
+  // Counts a check that printed its own line with its numbers.
+  bool Record(bool passed);
+
+  int Result() const { return m_failed ? 1 : 0; }
+
+private:
+  bool m_failed = false;
+};
+
+// "ok" or "FAILED", for checks that print their own line.
+inline const char* Verdict(bool passed) { return passed ? "ok" : "FAILED"; }
+
+// a and b agree to a relative tolerance, absolute below one.
+bool Near(double a, double b, double tolerance = 1e-4);
+
+struct Suite
+{
+  const char* option;
+  const char* usage;  // its lines of the cpurender usage
+  bool measures;      // renders references, left out of --checks
+  int (*run)(const Options& options);
+};
+
+const std::vector<Suite>& GetSuites();
+// The suite of a --...-report option, null for other arguments.
+const Suite* Find(const std::string& option);
+// Runs the suites one after another, the exit code is 1 if any of them failed.
+int Run(const std::vector<const Suite*>& suites, const Options& options);
+
+int SamplerChecks(const Options& options);
+int DenoiseChecks(const Options& options);
+int AdaptiveSamplerChecks(const Options& options);
+int FrameFenceChecks(const Options& options);
+int TiledRenderChecks(const Options& options);
+int LightChecks(const Options& options);
+int ImageChecks(const Options& options);
+int CaptureChecks(const Options& options);
+int AccumulationChecks(const Options& options);
+int PackingChecks(const Options& options);
+int PermutationChecks(const Options& options);
+int MicrofacetChecks(const Options& options);
+int ParserChecks(const Options& options);
+int FormatChecks(const Options& options);
+int DescriptorChecks(const Options& options);
+int HotReloadChecks(const Options& options);
+int ProfileChecks(const Options& options);
+int BenchmarkChecks(const Options& options);
+int GoldenChecks(const Options& options);
+int SceneStatsChecks(const Options& options);
+int BvhQualityChecks(const Options& options);
+
+}
@@ -0,0 +1,123 @@
+#include "checks/Checks.h"
+#include "CpuPathTracer.h"
+#include "CpuRenderCommon.h"
+#include "Denoiser.h"
+#include "SceneCore.h"
+#include "checks/SyntheticImage.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace Checks {
+
+namespace {
+
+// Peak signal to noise ratio in dB of the images clamped to [0, 1].
+double Psnr(const std::vector<glm::vec3>& image, const std::vector<glm::vec3>& reference)
+{
+  double sum = 0.0;
+  for (std::size_t i = 0; i < image.size(); i++)
+  {
+    const glm::vec3 d = glm::clamp(image[i], 0.0f, 1.0f) - glm::clamp(reference[i], 0.0f, 1.0f);
+    sum += glm::dot(d, d) / 3.0;
+  }
+  const double mse = sum / std::max<std::size_t>(image.size(), 1);
+  return mse > 0.0 ? 10.0 * std::log10(1.0 / mse) : 100.0;
+}
+
+}
+
+int DenoiseChecks(const Options& options)
+{
+  CpuPathTracer::Settings settings = options.settings;
+  if (!options.size_given)
+  {
+    settings.width = 320;
+    settings.height = 180;
+  }
+  if (!options.spp_given)
+  {
+    settings.samples_per_pixel = 1024;
+  }
+  Denoiser::Settings denoiserSettings = options.denoiser;
+  denoiserSettings.threads = settings.threads;
+  const std::string path = options.GetScenes({ "src/scenes/cornell.txt" })[0];
+
+  // Synthetic images: the denoised image has to beat the noisy one by the target
+  struct Case
+  {
+    unsigned int samples;
+    double target; // dB over the noisy image
+  };
+  const Case cases[] = { { 1, 12.0 }, { 4, 12.0 }, { 16, 12.0 }, { 64, 10.0 } };
+  const unsigned int width = 320;
+  const unsigned int height = 180;
+
+  Log check;
+  printf("synthetic %ux%u, %u iterations\n", width, height, denoiserSettings.iterations);
+  printf("  %-5s %10s %10s %10s %10s  %s\n", "spp", "noisy dB", "denoised", "gain", "target", "ms");
+  for (const Case& c : cases)
+  {
+    const SyntheticImage synthetic(width, height, c.samples);
+    const std::vector<glm::vec3> noisy = synthetic.Resolve();
+
+    const auto start = std::chrono::steady_clock::now();
+    const std::vector<glm::vec3> denoised = Denoiser::Filter(synthetic.GetInput(), denoiserSettings);
+    const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    const double noisyPsnr = Psnr(noisy, synthetic.reference);
+    const double denoisedPsnr = Psnr(denoised, synthetic.reference);
+    const bool passed = denoisedPsnr - noisyPsnr >= c.target;
+    printf("  %-5u %10.2f %10.2f %+10.2f %+10.1f  %.1f  %s\n", c.samples, noisyPsnr, denoisedPsnr, denoisedPsnr - noisyPsnr, c.target,
+           milliseconds, Verdict(passed));
+    check.Record(passed);
+  }
+
+  // the same input has to give the same bits on one thread and on many
+  {
+    const SyntheticImage synthetic(width, height, 4);
+    Denoiser::Settings single = denoiserSettings;
+    single.threads = 1;
+    Denoiser::Settings many = denoiserSettings;
+    many.threads = 7;
+    const std::vector<glm::vec3> a = Denoiser::Filter(synthetic.GetInput(), single);
+    const std::vector<glm::vec3> b = Denoiser::Filter(synthetic.GetInput(), many);
+    const bool deterministic = std::memcmp(a.data(), b.data(), a.size() * sizeof(glm::vec3)) == 0;
+    printf("  1 and 7 threads give identical images: %s\n", Verdict(deterministic));
+    check.Record(deterministic);
+  }
+
+  // A path traced scene against a high sample count render, no target
+  SceneCore::SceneData scene;
+  if (!CpuRender::LoadScene(path, scene))
+  {
+    return 1;
+  }
+
+  CpuPathTracer::Renderer reference(scene, settings);
+  reference.Render();
+  const std::vector<glm::vec3> referenceImage = reference.Resolve();
+  printf("\n%s: %ux%u, reference %u spp\n", path.c_str(), settings.width, settings.height, settings.samples_per_pixel);
+  printf("  %-5s %10s %10s %10s\n", "spp", "noisy dB", "denoised", "gain");
+
+  const unsigned int sampleCounts[] = { 1, 4, 16 };
+  for (unsigned int spp : sampleCounts)
+  {
+    CpuPathTracer::Settings noisySettings = settings;
+    noisySettings.samples_per_pixel = spp;
+    CpuPathTracer::Renderer renderer(scene, noisySettings);
+    renderer.Render();
+
+    const double noisyPsnr = Psnr(renderer.Resolve(), referenceImage);
+    const double denoisedPsnr = Psnr(Denoiser::Filter(CpuRender::GetDenoiserInput(renderer), denoiserSettings), referenceImage);
+    printf("  %-5u %10.2f %10.2f %+10.2f\n", spp, noisyPsnr, denoisedPsnr, denoisedPsnr - noisyPsnr);
+  }
+  return check.Result();
+}
+
+}
@@ -0,0 +1,277 @@
+#include "checks/Checks.h"
+#include "DescriptorAllocator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace Checks {
+
+int DescriptorChecks(const Options&)
+{
+  using namespace DescriptorAllocator;
+  Log check;
+  const std::uint32_t chunk = Allocator::ChunkSize;
+
+  {
+    Allocator allocator(100);
+    check(allocator.GetCapacity() == 2 * chunk, "capacity rounds up to whole chunks");
+    check(allocator.Allocate(RangeObjects, 0) == Allocator::Invalid, "an empty allocation is refused");
+
+    //interleaved like AllocateResourcesInDescriptorHeap, every range stays packed
+    bool packed = true;
+    for (std::uint32_t i = 0; i < 10; i++)
+    {
+      packed &= allocator.Allocate(RangeGeometry) == i;
+      packed &= allocator.Allocate(RangeObjects) == chunk + i;
+    }
+    check(packed, "interleaved ranges get consecutive descriptors in own chunks");
+    check(allocator.GetRange(5) == RangeGeometry && allocator.GetRange(chunk + 5) == RangeObjects, "descriptors know their range");
+
+    const std::uint32_t table = allocator.Allocate(RangeOutput, 9);
+    check(table == 2 * chunk && allocator.GetAllocationSize(table) == 9 && allocator.GetCapacity() == 4 * chunk,
+          "the output table is one block, the heap doubled for it");
+    check(allocator.GetGrowthCount() == 1 && allocator.GetAllocationSize(3) == 1 && allocator.GetAllocationSize(chunk + 3) == 1,
+          "growing kept the descriptors where they were");
+
+    check(allocator.Free(table) && allocator.Allocate(RangeOutput, 9) == table, "a freed table is handed out again on resize");
+    check(allocator.Free(4) && !allocator.Free(4), "freeing twice is refused");
+    check(!allocator.Free(table + 1) && !allocator.Free(100000), "freeing inside a block or past the heap is refused");
+    check(allocator.Allocate(RangeGeometry) == 4, "a freed descriptor is reused before new ones");
+    check(allocator.GetAllocatedCount(RangeGeometry) == 10 && allocator.GetAllocatedCount(RangeObjects) == 10 &&
+          allocator.GetAllocatedCount() == 29, "the counts add up");
+
+    const std::uint32_t large = allocator.Allocate(RangeTextures, 3 * chunk + 1);
+    check(large == 3 * chunk && allocator.GetChunkCount(RangeTextures) == 4 && allocator.GetFreeCount(RangeTextures) == chunk - 1,
+          "a block larger than a chunk takes several");
+
+    allocator.Reset();
+    check(allocator.GetCapacity() == 8 * chunk && allocator.GetAllocatedCount() == 0 && allocator.GetHighWaterMark() == 0 &&
+          allocator.Allocate(RangeMaterials) == 0, "reset frees everything and keeps the capacity");
+  }
+
+  {
+    Allocator allocator(chunk, 2 * chunk);
+    bool allocated = true;
+    for (std::uint32_t i = 0; i < 2 * chunk; i++)
+    {
+      allocated &= allocator.Allocate(RangeMaterials) != Allocator::Invalid;
+    }
+    check(allocated && allocator.Allocate(RangeMaterials) == Allocator::Invalid && allocator.GetCapacity() == 2 * chunk,
+          "the heap stops at the max capacity");
+  }
+
+  {
+    //the old fixed bands were 1000 apart, a scene of 1500 models ran the vertex SRVs into
+    //the index SRVs
+    Allocator allocator;
+    const std::uint32_t models = 1500;
+    std::vector<std::uint32_t> positions, indices;
+    for (std::uint32_t i = 0; i < models; i++) positions.push_back(allocator.Allocate(RangeGeometry));
+    for (std::uint32_t i = 0; i < models; i++) indices.push_back(allocator.Allocate(RangeGeometry));
+    std::vector<std::uint32_t> all(positions);
+    all.insert(all.end(), indices.begin(), indices.end());
+    std::sort(all.begin(), all.end());
+    check(std::adjacent_find(all.begin(), all.end()) == all.end() && all.back() < allocator.GetCapacity(),
+          "1500 models no longer overlap the vertex and index SRVs");
+  }
+
+  // Stress: a scene of 100k descriptors in the mix of AllocateResourcesInDescriptorHeap,
+  // then rounds of ImGui removals and additions. A shadow copy of the heap catches two
+  // views on one descriptor, the high water mark catches removals that leak.
+  {
+    const std::uint32_t total = 100000;
+    const Range mix[] = { RangeObjects, RangeObjects, RangeObjects, RangeObjects, RangeGeometry, RangeGeometry, RangeGeometry,
+                          RangeMaterials, RangeTextures, RangeAccelerationStructures };
+    std::mt19937 random(43);
+    Allocator allocator;
+    std::vector<std::uint8_t> shadow;
+    struct Allocation { std::uint32_t index, count; Range range; };
+    std::vector<Allocation> live;
+    bool disjoint = true;
+    auto Add = [&](Range range, std::uint32_t count) {
+      const std::uint32_t index = allocator.Allocate(range, count);
+      if (index == Allocator::Invalid || index + count > allocator.GetCapacity())
+      {
+        disjoint = false;
+        return;
+      }
+      shadow.resize(allocator.GetCapacity(), 0);
+      for (std::uint32_t i = index; i < index + count; i++)
+      {
+        disjoint &= shadow[i] == 0 && allocator.GetRange(i) == range;
+        shadow[i] = 1;
+      }
+      live.push_back({ index, count, range });
+    };
+    auto Remove = [&](std::size_t which) {
+      const Allocation allocation = live[which];
+      live[which] = live.back();
+      live.pop_back();
+      disjoint &= allocator.Free(allocation.index);
+      for (std::uint32_t i = allocation.index; i < allocation.index + allocation.count; i++)
+      {
+        shadow[i] = 0;
+      }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    Add(RangeOutput, 9);
+    while (allocator.GetAllocatedCount() < total)
+    {
+      Add(mix[random() % (sizeof(mix) / sizeof(mix[0]))], 1);
+    }
+    const double build = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    const std::uint32_t highWater = allocator.GetHighWaterMark();
+    const std::uint32_t growths = allocator.GetGrowthCount();
+    printf("%u descriptors in %.2f ms, capacity %u, high water %u, %u heap copies\n", allocator.GetAllocatedCount(), build,
+           allocator.GetCapacity(), highWater, growths);
+    for (std::uint32_t range = 0; range < RangeCount; range++)
+    {
+      printf("  %-24s %6u descriptors in %4u chunks\n", GetRangeName(static_cast<Range>(range)), allocator.GetAllocatedCount(static_cast<Range>(range)),
+             allocator.GetChunkCount(static_cast<Range>(range)));
+    }
+    check(disjoint, "no two allocations share a descriptor");
+    check(growths <= 7 && allocator.GetCapacity() < 2 * total, "the heap grew by doubling");
+
+    start = std::chrono::steady_clock::now();
+    std::uint32_t churned = 0;
+    for (int round = 0; round < 20; round++)
+    {
+      std::vector<Range> removed;
+      for (int i = 0; i < 5000; i++)
+      {
+        const std::size_t which = 1 + random() % (live.size() - 1);
+        removed.push_back(live[which].range);
+        Remove(which);
+      }
+      //the window resize frees and takes back the output table in between, it stays first
+      Remove(0);
+      Add(RangeOutput, 9);
+      std::swap(live[0], live.back());
+      for (Range range : removed)
+      {
+        Add(range, 1);
+      }
+      churned += static_cast<std::uint32_t>(removed.size());
+    }
+    const double churn = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    printf("%u removals and additions in %.2f ms, high water %u\n", churned, churn, allocator.GetHighWaterMark());
+    check(disjoint, "still disjoint after the removals");
+    check(allocator.GetHighWaterMark() == highWater && allocator.GetGrowthCount() == growths, "removed descriptors are reused, nothing leaks");
+
+    //what RebuildScene does: reset, reserve every range for the scene, no copies after
+    std::uint32_t counts[RangeCount] = {};
+    for (const Allocation& allocation : live)
+    {
+      counts[allocation.range] += allocation.count;
+    }
+    allocator.Reset();
+    for (std::uint32_t range = 0; range < RangeCount; range++)
+    {
+      allocator.Reserve(static_cast<Range>(range), counts[range]);
+    }
+    const std::uint32_t reserved = allocator.GetCapacity();
+    live.clear();
+    shadow.assign(allocator.GetCapacity(), 0);
+    Add(RangeOutput, 9);
+    for (std::uint32_t range = 1; range < RangeCount; range++)
+    {
+      for (std::uint32_t i = 0; i < counts[range]; i++)
+      {
+        Add(static_cast<Range>(range), 1);
+      }
+    }
+    check(disjoint && allocator.GetCapacity() == reserved && allocator.GetGrowthCount() == growths,
+          "a reserved rebuild allocates without growing the heap");
+  }
+
+  // Stress with sizes: allocations of 1 to 150 descriptors interleaved over the ranges,
+  // freed in random order. Freed neighbours merge, so the large ones fit in the space
+  // small ones left, and once everything is freed every range is back to one block per
+  // run of its chunks.
+  {
+    std::mt19937 random(45);
+    Allocator allocator;
+    std::vector<std::uint8_t> shadow;
+    struct Allocation { std::uint32_t index, count; };
+    std::vector<Allocation> live;
+    bool disjoint = true;
+    std::uint32_t liveCount = 0;
+    std::uint32_t peak = 0;
+    auto Size = [&]() -> std::uint32_t {
+      const std::uint32_t kind = random() % 10;
+      return kind < 6 ? 1 : kind < 9 ? 2 + random() % 15 : 17 + random() % 134;
+    };
+    for (int round = 0; round < 400; round++)
+    {
+      for (int i = 0; i < 40; i++)
+      {
+        const Range range = static_cast<Range>(random() % RangeCount);
+        const std::uint32_t count = Size();
+        const std::uint32_t index = allocator.Allocate(range, count);
+        if (index == Allocator::Invalid)
+        {
+          disjoint = false;
+          continue;
+        }
+        shadow.resize(allocator.GetCapacity(), 0);
+        for (std::uint32_t d = index; d < index + count; d++)
+        {
+          disjoint &= shadow[d] == 0 && allocator.GetRange(d) == range;
+          shadow[d] = 1;
+        }
+        live.push_back({ index, count });
+        liveCount += count;
+      }
+      peak = std::max(peak, liveCount);
+      for (std::size_t i = live.size() / 2; i > 0; i--)
+      {
+        const std::size_t which = random() % live.size();
+        disjoint &= allocator.Free(live[which].index);
+        std::fill(shadow.begin() + live[which].index, shadow.begin() + live[which].index + live[which].count, 0);
+        liveCount -= live[which].count;
+        live[which] = live.back();
+        live.pop_back();
+      }
+    }
+    const std::uint32_t highWater = allocator.GetHighWaterMark();
+    printf("%u descriptors live at most, high water %u, %u heap copies\n", peak, highWater, allocator.GetGrowthCount());
+    check(disjoint, "interleaved sizes never share a descriptor");
+    check(highWater <= 4 * peak, "fragments do not grow the heap past four times the live ones");
+
+    std::shuffle(live.begin(), live.end(), random);
+    for (const Allocation& allocation : live)
+    {
+      allocator.Free(allocation.index);
+    }
+    bool merged = allocator.GetAllocatedCount() == 0;
+    for (std::uint32_t range = 0; range < RangeCount; range++)
+    {
+      //the runs of consecutive chunks of the range
+      std::uint32_t runs = 0;
+      for (std::uint32_t first = 0; first < allocator.GetHighWaterMark(); first += chunk)
+      {
+        runs += allocator.GetRange(first) == range && (first == 0 || allocator.GetRange(first - chunk) != range);
+      }
+      merged &= allocator.GetFreeBlockCount(static_cast<Range>(range)) == runs &&
+                allocator.GetFreeCount(static_cast<Range>(range)) == allocator.GetChunkCount(static_cast<Range>(range)) * chunk;
+    }
+    check(merged, "freeing everything leaves one free block per run of chunks");
+
+    bool fits = true;
+    for (std::uint32_t range = 0; range < RangeCount; range++)
+    {
+      const std::uint32_t largest = allocator.GetLargestFreeBlock(static_cast<Range>(range));
+      fits &= largest > chunk && allocator.Allocate(static_cast<Range>(range), largest) != Allocator::Invalid;
+    }
+    check(fits && allocator.GetHighWaterMark() == highWater, "the merged blocks are handed out whole, the heap does not grow");
+  }
+  return check.Result();
+}
+
+}
@@ -0,0 +1,227 @@
+#include "checks/Checks.h"
+#include "CameraPath.h"
+#include "SceneCore.h"
+#include "SceneFormat.h"
+#include "SceneParser.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace Checks {
+
+namespace {
+
+// A scene the size generated ones get to: every float random, so the shortest float
+// formatting is tried on all kinds of values, and a camera path.
+SceneParser::SceneFile MakeSyntheticScene(std::size_t objectCount)
+{
+  std::mt19937 random(42);
+  std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+  std::uniform_real_distribution<float> angle(-180.0f, 180.0f);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  auto Vec3 = [&](std::uniform_real_distribution<float>& distribution) {
+    return glm::vec3(distribution(random), distribution(random), distribution(random));
+  };
+
+  SceneParser::SceneFile scene;
+  const int modelCount = 64, textureCount = 32, materialCount = 1000;
+  for (int i = 0; i < modelCount + 2 * textureCount; i++)
+  {
+    SceneParser::Asset asset;
+    asset.kind = i < modelCount ? SceneParser::AssetKind::Model
+                                : (i < modelCount + textureCount ? SceneParser::AssetKind::DiffuseTexture : SceneParser::AssetKind::NormalTexture);
+    asset.id = i < modelCount ? i : (i - modelCount) % textureCount;
+    asset.path = (i < modelCount ? "src/models/generated_" : "src/textures/generated_") + std::to_string(i) + (i < modelCount ? ".obj" : ".png");
+    scene.assets.push_back(asset);
+  }
+  for (int i = 0; i < materialCount; i++)
+  {
+    SceneCore::Material material;
+    material.id = i;
+    material.name = "material_" + std::to_string(i);
+    material.diffuse = Vec3(unit);
+    material.specular = Vec3(unit);
+    material.specular_exponent = 100.0f * unit(random);
+    material.reflectiveness = i % 4 == 0 ? unit(random) : 0.0f;
+    material.refractiveness = i % 8 == 0 ? unit(random) : 0.0f;
+    material.eta = 1.0f + unit(random);
+    material.emittance = i % 50 == 0 ? 10.0f * unit(random) : 0.0f;
+    material.metallic = unit(random);
+    material.roughness = i % 2 == 0 ? unit(random) : 0.0f;
+    scene.materials.push_back(material);
+  }
+  scene.objects.reserve(objectCount);
+  for (std::size_t i = 0; i < objectCount; i++)
+  {
+    SceneCore::Object object;
+    object.id = static_cast<int>(i);
+    object.name = "object_" + std::to_string(i);
+    object.mesh = static_cast<int>(random() % modelCount);
+    object.albedo_texture = i % 3 == 0 ? static_cast<int>(random() % textureCount) : -1;
+    object.normal_texture = i % 5 == 0 ? static_cast<int>(random() % textureCount) : -1;
+    object.metallic_roughness_texture = i % 7 == 0 ? static_cast<int>(random() % textureCount) : -1;
+    object.material = static_cast<int>(random() % materialCount);
+    object.translation = Vec3(position);
+    object.rotation = Vec3(angle);
+    object.scale = glm::vec3(0.1f) + 2.0f * Vec3(unit);
+    scene.objects.push_back(object);
+  }
+  scene.gltf.push_back({ "src/models/generated.gltf", objectCount / 2 });
+  scene.gltf.push_back({ "src/models/generated_last.gltf", objectCount });
+
+  scene.has_camera = true;
+  scene.camera.fov = 40.0f + unit(random);
+  scene.camera.eye = Vec3(position);
+  scene.camera.lookat = Vec3(position);
+  scene.camera.max_depth = 8;
+  scene.camera.russian_roulette = false;
+  scene.camera.quantize_vertices = true;
+  for (int i = 0; i < 16; i++)
+  {
+    CameraPath::Keyframe keyframe;
+    keyframe.time = i * 0.75f + 0.1f * unit(random);
+    keyframe.eye = Vec3(position);
+    keyframe.lookat = Vec3(position);
+    keyframe.fov = i % 2 == 0 ? scene.camera.fov : 30.0f + 20.0f * unit(random);
+    scene.camera.path.AddKeyframe(keyframe);
+  }
+  return scene;
+}
+
+}
+
+int FormatChecks(const Options& options)
+{
+  Log check;
+  std::vector<std::string> scenes = options.scenes;
+  if (scenes.empty())
+  {
+    for (const char* name : { "chromie", "cornell", "dispersion", "dragon", "gltf_test", "microfacet", "room", "room_demo", "room_open",
+                              "room_samemat", "scene", "standoff", "subsurfacetest" })
+    {
+      scenes.push_back(std::string("src/scenes/") + name + ".txt");
+    }
+  }
+
+  const SceneFormat::Encoding encodings[] = { SceneFormat::Encoding::Text, SceneFormat::Encoding::Json, SceneFormat::Encoding::Binary };
+  const char* extensions[] = { ".txt", ".json", ".rtxscene" };
+
+  // The same scene back from every encoding, and from text through json and rtxscene
+  // back to text
+  auto RoundTrip = [&](const SceneParser::SceneFile& scene, std::string& difference) {
+    std::string data, error;
+    for (SceneFormat::Encoding encoding : encodings)
+    {
+      SceneParser::SceneFile read;
+      bool valid = true;
+      switch (encoding)
+      {
+      case SceneFormat::Encoding::Text:
+        SceneFormat::WriteText(scene, data);
+        SceneParser::ParseBuffer(data.data(), data.size(), read);
+        break;
+      case SceneFormat::Encoding::Json:
+        SceneFormat::WriteJson(scene, data);
+        valid = SceneFormat::ReadJson(data.data(), data.size(), read, error);
+        break;
+      case SceneFormat::Encoding::Binary:
+        SceneFormat::WriteBinary(scene, data);
+        valid = SceneFormat::ReadBinary(data.data(), data.size(), read, error);
+        break;
+      }
+      if (!valid || !SceneFormat::Compare(scene, read, difference))
+      {
+        difference = std::string(SceneFormat::GetEncodingName(encoding)) + ": " + (valid ? difference : error);
+        return false;
+      }
+    }
+
+    SceneParser::SceneFile json, binary, text;
+    SceneFormat::WriteJson(scene, data);
+    SceneFormat::ReadJson(data.data(), data.size(), json, error);
+    SceneFormat::WriteBinary(json, data);
+    SceneFormat::ReadBinary(data.data(), data.size(), binary, error);
+    SceneFormat::WriteText(binary, data);
+    SceneParser::ParseBuffer(data.data(), data.size(), text);
+    if (!SceneFormat::Compare(scene, text, difference))
+    {
+      difference = "text to json to rtxscene to text: " + difference;
+      return false;
+    }
+    return true;
+  };
+
+  for (const auto& path : scenes)
+  {
+    SceneParser::SceneFile scene;
+    std::string error, difference;
+    if (!SceneParser::ParseFile(path, scene, error))
+    {
+      fprintf(stderr, "%s\n", error.c_str());
+      check.Record(false);
+      continue;
+    }
+    const bool same = RoundTrip(scene, difference);
+    printf("%s: %zu objects, %zu materials\n", path.c_str(), scene.objects.size(), scene.materials.size());
+    check(same, "  text, json and rtxscene read back the same");
+    if (!same)
+    {
+      printf("    first difference: %s\n", difference.c_str());
+    }
+  }
+
+  // Writing and loading the files of a large generated scene in each encoding, the best
+  // of three runs
+  const std::size_t objectCount = 100000;
+  const SceneParser::SceneFile synthetic = MakeSyntheticScene(objectCount);
+  std::string difference;
+  printf("\nsynthetic scene: %zu objects, %zu materials, %zu assets, %zu keyframes\n", synthetic.objects.size(), synthetic.materials.size(),
+         synthetic.assets.size(), synthetic.camera.path.GetKeyframes().size());
+  const bool same = RoundTrip(synthetic, difference);
+  check(same, "  text, json and rtxscene read back the same");
+  if (!same)
+  {
+    printf("    first difference: %s\n", difference.c_str());
+  }
+
+  double textLoad = 0.0;
+  for (std::size_t e = 0; e < 3; e++)
+  {
+    const std::string path = std::string("format_report") + extensions[e];
+    double write = 1e30, load = 1e30;
+    bool valid = true;
+    for (int run = 0; run < 3; run++)
+    {
+      std::string error;
+      auto start = std::chrono::steady_clock::now();
+      valid &= SceneFormat::WriteFile(path, synthetic, error);
+      write = std::min(write, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+      SceneParser::SceneFile scene;
+      start = std::chrono::steady_clock::now();
+      valid &= SceneFormat::ReadFile(path, scene, error);
+      load = std::min(load, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+      valid &= run > 0 || SceneFormat::Compare(synthetic, scene, difference);
+    }
+    std::size_t bytes = 0;
+    if (FILE* file = fopen(path.c_str(), "rb"))
+    {
+      fseek(file, 0, SEEK_END);
+      bytes = static_cast<std::size_t>(ftell(file));
+      fclose(file);
+    }
+    std::remove(path.c_str());
+
+    textLoad = e == 0 ? load : textLoad;
+    printf("  %-9s %7.2f MB, write %7.1f ms, load %7.1f ms (%5.0f MB/s), load %5.1fx text\n", extensions[e], bytes / 1e6, write, load,
+           bytes / std::max(load, 1e-9) / 1e3, textLoad / std::max(load, 1e-9));
+    check(valid, "    written, loaded and the same as generated");
+  }
+  return check.Result();
+}
+
+}
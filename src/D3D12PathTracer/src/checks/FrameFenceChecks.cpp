@@ -0,0 +1,181 @@
+#include "checks/Checks.h"
+#include "FrameFenceRing.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <stdexcept>
+#include <vector>
+
+namespace Checks {
+
+namespace {
+
+// A command queue and its fence: signals complete in submission order, only when the
+// test lets the GPU run or the CPU waits for one. Drives the ring the way DeviceResources
+// does, and remembers what every back buffer slot submitted last.
+class FakeDevice
+{
+public:
+  FakeDevice(unsigned int frameCount, std::uint64_t initialValue) :
+    m_lastSubmitted(frameCount, initialValue)
+  {
+    m_ring.Reset(frameCount, 0, initialValue);
+    m_completed = m_ring.GetLastSignaledValue(); // CreateFence with it
+  }
+
+  FrameFenceRing& GetRing() { return m_ring; }
+  std::uint64_t GetCompletedValue() const { return m_completed; }
+  std::uint64_t GetWaitCount() const { return m_waits; }
+
+  // Whether a slot was reused while the GPU could still be working on what it submitted.
+  bool IsOverlapped() const { return m_overlapped; }
+  // Whether the signaled values did not go up by one from frame to frame.
+  bool IsOutOfOrder() const { return m_outOfOrder; }
+
+  // Lets the GPU finish the oldest submissions.
+  void Run(std::size_t signals)
+  {
+    for (; signals > 0 && !m_queue.empty(); signals--)
+    {
+      m_completed = m_queue.front();
+      m_queue.pop_front();
+    }
+  }
+
+  // MoveToNextFrame
+  std::uint64_t MoveToNextFrame(unsigned int nextFrameIndex)
+  {
+    const std::uint64_t value = m_ring.GetCurrentValue();
+    m_outOfOrder |= !m_queue.empty() && value != m_queue.back() + 1;
+    m_queue.push_back(value);
+    m_lastSubmitted[m_ring.GetFrameIndex()] = value;
+
+    const std::uint64_t waitValue = m_ring.Advance(nextFrameIndex);
+    if (!FrameFenceRing::IsComplete(waitValue, m_completed))
+    {
+      m_waits++;
+      while (m_completed < waitValue && !m_queue.empty())
+      {
+        Run(1);
+      }
+    }
+    m_overlapped |= m_completed < m_lastSubmitted[nextFrameIndex];
+    return waitValue;
+  }
+
+  // WaitForGpu
+  void WaitForGpu()
+  {
+    const std::uint64_t value = m_ring.GetCurrentValue();
+    m_queue.push_back(value);
+    Run(m_queue.size());
+    m_ring.Flush();
+  }
+
+private:
+  FrameFenceRing m_ring;
+  std::deque<std::uint64_t> m_queue;
+  std::vector<std::uint64_t> m_lastSubmitted;
+  std::uint64_t m_completed = 0;
+  std::uint64_t m_waits = 0;
+  bool m_overlapped = false;
+  bool m_outOfOrder = false;
+};
+
+}
+
+int FrameFenceChecks(const Options&)
+{
+  Log check;
+
+  // Many times around the ring with a GPU that keeps up, lags or stalls
+  for (unsigned int frameCount = 1; frameCount <= 3; frameCount++)
+  {
+    FakeDevice device(frameCount, 0);
+    const unsigned int frames = 1000;
+    bool waitedFor = true;
+    for (unsigned int frame = 0; frame < frames; frame++)
+    {
+      const std::uint64_t signaled = device.GetRing().GetCurrentValue();
+      const std::uint64_t waitValue = device.MoveToNextFrame((frame + 1) % frameCount);
+      //the slot comes back around after frameCount frames, it waits for its own last signal
+      waitedFor &= waitValue == (signaled + 1 > frameCount ? signaled + 1 - frameCount : 0);
+      device.Run(frame % 7 == 0 ? 0 : 1);
+    }
+    char what[80];
+    snprintf(what, sizeof(what), "%u slot%s: values go up by one, slots wait for their last use", frameCount, frameCount > 1 ? "s" : "");
+    check(waitedFor && !device.IsOutOfOrder() && device.GetRing().GetCurrentValue() == frames + 1, what);
+    snprintf(what, sizeof(what), "%u slot%s: a slot is never reused while its work is in flight", frameCount, frameCount > 1 ? "s" : "");
+    check(!device.IsOverlapped(), what);
+  }
+
+  // The GPU never catches up on its own: every frame past the first ring has to wait on a
+  // slot still in flight, and only that long
+  {
+    FakeDevice device(3, 0);
+    std::uint64_t lag = 0;
+    for (unsigned int frame = 0; frame < 30; frame++)
+    {
+      device.MoveToNextFrame((frame + 1) % 3);
+      lag = device.GetRing().GetLastSignaledValue() - device.GetCompletedValue();
+    }
+    check(device.GetWaitCount() == 30 - 2 && lag == 2 && !device.IsOverlapped(), "a stalled GPU blocks only when the ring is full");
+  }
+
+  // Readbacks tagged after the frame that recorded them, like the saved images, complete
+  // with that frame and not before
+  {
+    FakeDevice device(3, 0);
+    device.MoveToNextFrame(1);
+    //recorded into the frame of slot 1, tagged after its Present
+    const std::uint64_t recorded = device.GetRing().GetCurrentValue();
+    device.MoveToNextFrame(2);
+    const std::uint64_t tag = device.GetRing().GetLastSignaledValue();
+    check(tag == recorded && device.GetRing().GetCurrentValue() == tag + 1, "the tag is the fence of the frame that recorded the copy");
+    device.Run(1);
+    const bool early = FrameFenceRing::IsComplete(tag, device.GetCompletedValue());
+    device.Run(1);
+    check(!early && FrameFenceRing::IsComplete(tag, device.GetCompletedValue()), "a tagged copy is done exactly when its frame is");
+  }
+
+  // WaitForGpu and a resize that lands on another back buffer
+  {
+    FakeDevice device(3, 5);
+    for (unsigned int frame = 0; frame < 4; frame++)
+    {
+      device.MoveToNextFrame((frame + 1) % 3);
+    }
+    const std::uint64_t before = device.GetRing().GetCurrentValue();
+    device.WaitForGpu();
+    check(device.GetCompletedValue() == before && device.GetRing().GetCurrentValue() == before + 1 &&
+          device.GetRing().GetLastSignaledValue() == before, "a flush waits for everything and moves past it");
+    //the slots take the value of the next signal, the first frame after the resize waits
+    //for itself like the swap chain sample does, and nothing is reused in flight
+    device.GetRing().Synchronize(0);
+    check(device.GetRing().GetFrameIndex() == 0 && device.GetRing().GetCurrentValue() == before + 1, "a resize switches slots and keeps the value");
+    for (unsigned int frame = 0; frame < 6; frame++)
+    {
+      device.MoveToNextFrame((frame + 1) % 3);
+      device.Run(frame % 2);
+    }
+    check(!device.IsOverlapped() && !device.IsOutOfOrder() && device.GetRing().GetLastSignaledValue() == before + 6,
+          "the frames after a resize go on in order");
+  }
+
+  {
+    FrameFenceRing ring;
+    int refused = 0;
+    try { ring.Reset(0, 0); } catch (const std::out_of_range&) { refused++; }
+    try { ring.Reset(2, 2); } catch (const std::out_of_range&) { refused++; }
+    ring.Reset(2, 1, 10);
+    try { ring.Advance(2); } catch (const std::out_of_range&) { refused++; }
+    try { ring.Synchronize(3); } catch (const std::out_of_range&) { refused++; }
+    check(refused == 4 && ring.GetCurrentValue() == 11 && ring.GetLastSignaledValue() == 10 && ring.GetFrameIndex() == 1,
+          "invalid frame indices are refused, values start past the fence");
+  }
+
+  return check.Result();
+}
+
+}
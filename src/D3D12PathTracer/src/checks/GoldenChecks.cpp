@@ -0,0 +1,166 @@
+#include "checks/Checks.h"
+#include "CpuPathTracer.h"
+#include "CpuRenderCommon.h"
+#include "ImageCompare.h"
+#include "SceneCore.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace Checks {
+
+int GoldenChecks(const Options&)
+{
+  Log check;
+
+  // A smooth gradient with a few hard edges
+  const unsigned int width = 96, height = 54;
+  std::vector<glm::vec3> gradient(width * height);
+  for (unsigned int y = 0; y < height; y++)
+  {
+    for (unsigned int x = 0; x < width; x++)
+    {
+      const float stripe = (x / 12) % 2 == 0 ? 0.2f : 0.0f;
+      gradient[y * width + x] = glm::vec3(float(x) / width, float(y) / height, 0.5f) * 0.8f + stripe;
+    }
+  }
+  std::vector<float> errors;
+  const ImageCompare::Metrics same = ImageCompare::Compare(gradient, gradient, width, height, &errors);
+  check(same.rmse == 0.0 && std::abs(same.ssim - 1.0) < 1e-6 && same.flip == 0.0 && errors.size() == gradient.size(), "equal images have no error");
+
+  const std::vector<glm::vec3> black(width * height, glm::vec3(0.0f));
+  const std::vector<glm::vec3> white(width * height, glm::vec3(1.0f));
+  const std::vector<glm::vec3> bright(width * height, glm::vec3(4.0f));
+  const ImageCompare::Metrics opposite = ImageCompare::Compare(black, white, width, height);
+  printf("  black against white: rmse %.4f, ssim %.4f, flip %.4f\n", opposite.rmse, opposite.ssim, opposite.flip);
+  check(std::abs(opposite.rmse - 1.0) < 1e-6 && opposite.ssim < 0.01 && opposite.flip > 0.95, "black against white is as far as it gets");
+  check(ImageCompare::Compare(white, bright, width, height).flip == 0.0, "values past one compare as displayed");
+
+  // More noise, more error, and the same seed the same noise
+  double previousFlip = 0.0, previousSsim = 1.0;
+  bool monotonic = true;
+  for (float level : { 0.01f, 0.03f, 0.1f })
+  {
+    const ImageCompare::Metrics noisy = ImageCompare::NoiseFloor(gradient, std::vector<glm::vec3>(gradient.size(), glm::vec3(level)), width, height);
+    printf("  noise %.2f: rmse %.4f, ssim %.4f, flip %.4f\n", level, noisy.rmse, noisy.ssim, noisy.flip);
+    monotonic = monotonic && noisy.flip > previousFlip && noisy.ssim < previousSsim && std::abs(noisy.rmse - level) < 0.2 * level;
+    previousFlip = noisy.flip;
+    previousSsim = noisy.ssim;
+  }
+  const std::vector<glm::vec3> sigma(gradient.size(), glm::vec3(0.05f));
+  check(monotonic && ImageCompare::NoiseFloor(gradient, sigma, width, height, 7).flip == ImageCompare::NoiseFloor(gradient, sigma, width, height, 7).flip,
+        "the error grows with the noise, the same seed gives the same noise");
+
+  // The standard error of a pixel of n samples with variance v is sqrt(v / n + v / m),
+  // 4 samples of mean 0.5 and mean square 1 have a variance of 1
+  std::vector<glm::vec4> accumulation = { glm::vec4(2.0f, 2.0f, 2.0f, 4.0f), glm::vec4(0.0f) };
+  std::vector<glm::vec3> moments = { glm::vec3(4.0f), glm::vec3(0.0f) };
+  const std::vector<glm::vec3> exact = ImageCompare::StandardError(accumulation, moments, 0.0);
+  const std::vector<glm::vec3> both = ImageCompare::StandardError(accumulation, moments, 4.0);
+  check(std::abs(exact[0].x - 0.5f) < 1e-6f && std::abs(both[0].x - std::sqrt(0.5f)) < 1e-6f && exact[1].x == 0.0f,
+        "standard errors add the noise of both images");
+
+  ImageCompare::Tolerance tolerance;
+  ImageCompare::Metrics floor = ImageCompare::NoiseFloor(gradient, sigma, width, height);
+  ImageCompare::Metrics within = floor, beyond = floor;
+  within.flip *= 1.2;
+  beyond.flip = floor.flip * tolerance.noise_factor + 2.0 * tolerance.flip;
+  std::vector<const char*> failed;
+  check(ImageCompare::Within(floor, floor, tolerance) && ImageCompare::Within(within, floor, tolerance) && !ImageCompare::Within(beyond, floor, tolerance, &failed) &&
+          failed.size() == 1 && std::strcmp(failed[0], "flip") == 0,
+        "tolerance is relative to the noise floor and names what failed");
+
+  const std::vector<glm::vec3> heatmap = ImageCompare::Heatmap({ -1.0f, 0.0f, 0.5f, 1.0f, 2.0f });
+  check(heatmap[0] == heatmap[1] && heatmap[3] == heatmap[4] && heatmap[1].r < 0.01f && heatmap[3].g > 0.99f && heatmap[2].r > heatmap[2].g,
+        "the heat map is magma from black to light yellow");
+  check(CpuRender::GetSceneName("src/scenes/cornell.txt") == "cornell" && CpuRender::GetSceneName("a\\b.c\\room.v2.txt") == "room.v2", "golden images are named after their scenes");
+
+  // Renders of cornell against a 512 spp reference: other samplers, integrators and no
+  // next event estimation are noise, fewer bounces and a dimmer light are not
+  SceneCore::SceneData scene;
+  if (!CpuRender::LoadScene("src/scenes/cornell.txt", scene))
+  {
+    check(false, "cornell loads");
+    return 1;
+  }
+  CpuPathTracer::Settings settings;
+  settings.width = width;
+  settings.height = height;
+  settings.samples_per_pixel = 512;
+  CpuPathTracer::Renderer referenceRenderer(scene, CpuRender::GetSceneSettings(settings, scene, false, -1));
+  referenceRenderer.Render();
+  const std::vector<glm::vec3> reference = CpuRender::GetMeans(referenceRenderer);
+
+  auto Test = [&](const SceneCore::SceneData& testScene, CpuPathTracer::Settings testSettings, const char* name)
+  {
+    testSettings.samples_per_pixel = 32;
+    CpuPathTracer::Renderer renderer(testScene, CpuRender::GetSceneSettings(testSettings, testScene, false, -1));
+    renderer.Render();
+    const ImageCompare::Metrics noise =
+      ImageCompare::NoiseFloor(reference, ImageCompare::StandardError(renderer.GetAccumulation(), renderer.GetMoments(), 512.0), width, height);
+    const ImageCompare::Metrics metrics = ImageCompare::Compare(reference, CpuRender::GetMeans(renderer), width, height);
+    const bool passed = ImageCompare::Within(metrics, noise, tolerance);
+    printf("  %-22s rmse %.4f (%.4f)  ssim %.4f (%.4f)  flip %.4f (%.4f)  %s\n", name, metrics.rmse, noise.rmse, metrics.ssim, noise.ssim, metrics.flip,
+           noise.flip, passed ? "within" : "differs");
+    return passed;
+  };
+  CpuPathTracer::Settings random = settings, wavefront = settings, noNee = settings, shallow = settings;
+  random.sampler = 0;
+  wavefront.wavefront = true;
+  noNee.features &= ~CpuPathTracer::NextEventEstimation;
+  shallow.depth = 2;
+  SceneCore::SceneData dimmer = scene;
+  for (auto& material : dimmer.materials)
+  {
+    // emittance only marks a light, the diffuse color is its radiance
+    if (material.second.emittance > 0.0f)
+    {
+      material.second.diffuse *= 0.9f;
+    }
+  }
+  const bool noise = Test(scene, random, "random sampler") & Test(scene, wavefront, "wavefront") & Test(scene, noNee, "no NEE");
+  const bool biased = Test(scene, shallow, "depth 2") | Test(dimmer, settings, "light 10% dimmer");
+  check(noise, "32 spp of other samplers and integrators are within tolerance");
+  check(!biased, "32 spp with fewer bounces or a dimmer light are not");
+
+  // The harness end to end: golden images of cornell, then comparisons with them
+  CpuRender::GoldenOptions goldenOptions;
+  goldenOptions.directory = "golden_report";
+  goldenOptions.diff_output = "golden_report_diff";
+  goldenOptions.update = true;
+  const std::vector<std::string> scenes = { "src/scenes/cornell.txt" };
+  settings.width = 64;
+  settings.height = 36;
+  settings.samples_per_pixel = 128;
+  const int updated = CpuRender::RunGolden(settings, scenes, goldenOptions, true);
+  CpuRender::GoldenManifest manifest;
+  std::string error;
+  const bool stored = updated == 0 && CpuRender::ReadGoldenManifest(goldenOptions.directory + "/" + CpuRender::c_goldenManifest, manifest, error) && manifest.images.size() == 1 &&
+                      manifest.images[0].samples == 128 && manifest.images[0].image == "cornell.exr";
+  goldenOptions.update = false;
+  settings.samples_per_pixel = 16;
+  settings.sampler = 0;
+  const int compared = CpuRender::RunGolden(settings, scenes, goldenOptions, true);
+  const bool heatmapWritten = std::ifstream(goldenOptions.diff_output + "/cornell.flip.png").good();
+  const int missing = CpuRender::RunGolden(settings, { "src/scenes/room.txt" }, goldenOptions, true);
+  settings.depth = 3;
+  const int otherSettings = CpuRender::RunGolden(settings, scenes, goldenOptions, true);
+  for (const char* file : { "/cornell.exr", "/golden.json" })
+  {
+    std::remove((goldenOptions.directory + file).c_str());
+  }
+  std::remove((goldenOptions.diff_output + "/cornell.flip.png").c_str());
+  std::remove((goldenOptions.diff_output + "/cornell.exr").c_str());
+  std::remove(goldenOptions.directory.c_str());
+  std::remove(goldenOptions.diff_output.c_str());
+  check(stored, "--golden-update writes the images and the manifest");
+  check(compared == 0 && heatmapWritten, "a render of other noise matches its golden image, with a heat map");
+  check(missing == 1 && otherSettings == 1, "missing golden images and other settings fail");
+  return check.Result();
+}
+
+}
@@ -0,0 +1,187 @@
+#include "checks/Checks.h"
+#include "HotReload.h"
+#include "SceneCore.h"
+#include "SceneFormat.h"
+#include "SceneParser.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Checks {
+
+int HotReloadChecks(const Options&)
+{
+  using namespace HotReload;
+  Log check;
+
+  class FakeFileSystem : public FileSystem
+  {
+  public:
+    FileState Stat(const std::string& path) override
+    {
+      auto it = files.find(path);
+      return it == files.end() ? FileState() : it->second;
+    }
+    void Write(const std::string& path, std::uint64_t size)
+    {
+      FileState& state = files[path];
+      state.exists = true;
+      state.modified = ++clock;
+      state.size = size;
+    }
+    std::map<std::string, FileState> files;
+    std::int64_t clock = 0;
+  };
+
+  check(NormalizePath(".\\src\\models//box.obj") == "src/models/box.obj" && NormalizePath("/tmp/./a/") == "/tmp/a" &&
+          NormalizePath("./") == ".", "paths normalize to one key per file");
+
+  // Two models, a texture used as diffuse and as normal map, three objects.
+  DependencyGraph graph;
+  graph.AddFile("scenes/test.txt", { Kind::Scene, 0 });
+  graph.AddFile("models/box.obj", { Kind::Model, 0 });
+  graph.AddFile("models/sphere.obj", { Kind::Model, 1 });
+  graph.AddFile("textures/wood.png", { Kind::DiffuseTexture, 0 });
+  graph.AddFile("textures\\wood.png", { Kind::NormalTexture, 0 });
+  graph.AddFile("models/car.gltf", { Kind::Gltf, 0 });
+  graph.AddDependent({ Kind::Model, 0 }, { Kind::Object, 0 });
+  graph.AddDependent({ Kind::DiffuseTexture, 0 }, { Kind::Object, 0 });
+  graph.AddDependent({ Kind::Model, 1 }, { Kind::Object, 1 });
+  graph.AddDependent({ Kind::NormalTexture, 0 }, { Kind::Object, 1 });
+  graph.AddDependent({ Kind::Model, 0 }, { Kind::Object, 2 });
+  check(graph.GetFileCount() == 5, "a file used twice is one file with two assets");
+  {
+    const ReloadPlan plan = graph.Resolve({ "models/box.obj", "./models/box.obj" });
+    check(!plan.full && plan.reload.size() == 1 && plan.reload[0] == Node{ Kind::Model, 0 } && plan.affected.size() == 2 &&
+            plan.affected[0] == Node{ Kind::Object, 0 } && plan.affected[1] == Node{ Kind::Object, 2 },
+          "a model reloads once and reaches the objects using it");
+  }
+  {
+    const ReloadPlan plan = graph.Resolve({ "textures/wood.png" });
+    check(plan.reload.size() == 2 && plan.affected.size() == 2, "a texture reloads as every kind it was loaded as");
+  }
+  {
+    const ReloadPlan unknown = graph.Resolve({ "textures/stone.png" });
+    const ReloadPlan scene = graph.Resolve({ "models/sphere.obj", "scenes/test.txt" });
+    const ReloadPlan gltf = graph.Resolve({ "models/car.gltf" });
+    check(unknown.IsEmpty() && unknown.unknown.size() == 1, "a file nothing uses changes nothing");
+    check(scene.full && scene.reload.empty() && gltf.full, "the scene or a GLTF file reloads everything");
+  }
+
+  // Debouncing, on fake time
+  {
+    FakeFileSystem files;
+    for (const std::string& path : graph.GetFiles())
+    {
+      files.Write(path, 100);
+    }
+    Watcher watcher(files, 0.3, false);
+    watcher.SetFiles(graph.GetFiles(), 0.0);
+    check(!watcher.IsUsingNotifier() && watcher.Poll(0.1).empty(), "nothing changed, nothing reported");
+
+    files.Write("models/box.obj", 50);
+    const bool first = watcher.Poll(1.0).empty();
+    files.Write("models/box.obj", 120);
+    const bool second = watcher.Poll(1.2).empty() && watcher.Poll(1.4).empty();
+    const std::vector<std::string> settled = watcher.Poll(1.5);
+    check(first && second && settled == std::vector<std::string>{ "models/box.obj" } && watcher.Poll(2.0).empty(),
+          "a file written in steps is reported once it settled, once");
+
+    files.files.erase("textures/wood.png");
+    const bool gone = watcher.Poll(3.0).empty() && watcher.Poll(4.0).empty() && watcher.GetPendingCount() == 1;
+    files.Write("textures/wood.png", 100);
+    const bool back = watcher.Poll(4.1).empty();
+    check(gone && back && watcher.Poll(4.5) == std::vector<std::string>{ "textures/wood.png" }, "a deleted file is held back until it is written again");
+
+    files.Write("models/box.obj", 120);
+    files.Write("models/sphere.obj", 100);
+    watcher.Poll(5.0);
+    const std::vector<std::string> both = watcher.Poll(5.4);
+    const ReloadPlan plan = graph.Resolve(both);
+    check(both.size() == 2 && plan.reload.size() == 2 && plan.affected.size() == 3, "files changed together reload together");
+  }
+
+  // The graph of a real scene, the way Scene::BuildDependencyGraph builds it for the renderer
+  {
+    SceneParser::SceneFile scene;
+    std::string error;
+    const std::string path = "src/scenes/cornell.txt";
+    if (SceneFormat::ReadFile(path, scene, error))
+    {
+      DependencyGraph sceneGraph;
+      sceneGraph.AddFile(path, { Kind::Scene, 0 });
+      const Kind kinds[] = { Kind::Model, Kind::DiffuseTexture, Kind::NormalTexture };
+      for (const SceneParser::Asset& asset : scene.assets)
+      {
+        sceneGraph.AddFile(asset.path, { kinds[static_cast<int>(asset.kind)], asset.id });
+      }
+      std::size_t users = 0;
+      for (std::size_t i = 0; i < scene.objects.size(); i++)
+      {
+        const SceneCore::Object& object = scene.objects[i];
+        sceneGraph.AddDependent({ Kind::Model, object.mesh }, { Kind::Object, static_cast<int>(i) });
+        users += object.mesh == scene.assets[0].id ? 1 : 0;
+      }
+      const ReloadPlan plan = sceneGraph.Resolve({ scene.assets[0].path });
+      printf("  %s: %zu files watched, %s reaches %zu objects\n", path.c_str(), sceneGraph.GetFileCount(), scene.assets[0].path.c_str(), plan.affected.size());
+      check(plan.reload.size() == 1 && plan.affected.size() == users, "the first model of cornell reaches every object using it");
+    }
+    else
+    {
+      printf("  %s\n", error.c_str());
+      check(false, "the first model of cornell reaches every object using it");
+    }
+  }
+
+  // Real files, with the notifier where there is one and with polling
+  for (int notifier = 1; notifier >= 0; notifier--)
+  {
+    const std::vector<std::string> paths = { "hot_reload_report_a.obj", "hot_reload_report_b.png" };
+    auto Write = [](const std::string& path, const char* text) {
+      if (FILE* file = fopen(path.c_str(), "ab"))
+      {
+        fputs(text, file);
+        fclose(file);
+      }
+    };
+    for (const std::string& path : paths)
+    {
+      std::remove(path.c_str());
+      Write(path, "v 0 0 0\n");
+    }
+    RealFileSystem files;
+    Watcher watcher(files, 0.05, notifier != 0);
+    watcher.SetFiles(paths, 0.0);
+    const bool quiet = watcher.Poll(0.1).empty();
+    const std::uint64_t stats = watcher.GetStatCount();
+    Write(paths[0], "v 1 0 0\n");
+    //ReadDirectoryChangesW completes a little after the write, inotify right away
+    std::vector<std::string> settled;
+    unsigned int polls = 0;
+    for (double now = 1.0; settled.empty() && polls < 100; now += 0.1)
+    {
+      settled = watcher.Poll(now);
+      polls++;
+      if (settled.empty())
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+    }
+    const std::uint64_t looked = watcher.GetStatCount() - stats;
+    printf("  %s: %llu stats for %u polls of 2 files\n", watcher.IsUsingNotifier() ? "notified" : "polling", static_cast<unsigned long long>(looked), polls);
+    check(quiet && settled == std::vector<std::string>{ paths[0] } && (!watcher.IsUsingNotifier() || looked <= polls),
+          watcher.IsUsingNotifier() ? "notifications name the changed file, only it is looked at" : "polling finds the changed file");
+    for (const std::string& path : paths)
+    {
+      std::remove(path.c_str());
+    }
+  }
+  return check.Result();
+}
+
+}
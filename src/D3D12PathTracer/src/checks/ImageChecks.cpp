@@ -0,0 +1,251 @@
+#include "checks/Checks.h"
+#include "ImageWriter.h"
+#include "checks/SyntheticImage.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+namespace Checks {
+
+namespace {
+
+// Largest difference of any channel, with the relative one for values far from zero.
+struct ImageError
+{
+  double absolute = 0.0;
+  double relative = 0.0;
+};
+
+ImageError CompareImages(const ImageWriter::Image& image, const ImageWriter::Image& reference, bool alpha)
+{
+  ImageError error;
+  if (image.width != reference.width || image.height != reference.height || image.rgba.size() != reference.rgba.size())
+  {
+    error.absolute = error.relative = HUGE_VAL;
+    return error;
+  }
+  for (std::size_t i = 0; i < image.rgba.size(); i++)
+  {
+    if (!alpha && i % 4 == 3)
+    {
+      continue;
+    }
+    const double d = std::abs(double(image.rgba[i]) - reference.rgba[i]);
+    error.absolute = std::max(error.absolute, d);
+    error.relative = std::max(error.relative, d / std::max(std::abs(double(reference.rgba[i])), 1e-3));
+  }
+  return error;
+}
+
+// What an image looks like after going through halves.
+ImageWriter::Image ToHalfPrecision(const ImageWriter::Image& image)
+{
+  ImageWriter::Image result = image;
+  std::vector<std::uint16_t> halves(image.rgba.size());
+  ImageWriter::ToHalf(image.rgba.data(), halves.data(), halves.size());
+  ImageWriter::FromHalf(halves.data(), result.rgba.data(), halves.size());
+  return result;
+}
+
+// Same for 8 bit formats.
+ImageWriter::Image ToUnorm8(const ImageWriter::Image& image)
+{
+  ImageWriter::Image result = image;
+  for (std::size_t i = 0; i < result.rgba.size(); i++)
+  {
+    result.rgba[i] = i % 4 == 3 ? 1.0f : std::round(std::min(std::max(result.rgba[i], 0.0f), 1.0f) * 255.0f) / 255.0f;
+  }
+  return result;
+}
+
+}
+
+int ImageChecks(const Options&)
+{
+  Log check;
+
+  // every finite half has to survive the way to float and back, and floats have to
+  // round to the nearest half
+  {
+    std::vector<std::uint16_t> halves(1 << 16);
+    for (std::size_t i = 0; i < halves.size(); i++)
+    {
+      halves[i] = static_cast<std::uint16_t>(i);
+    }
+    std::vector<float> values(halves.size());
+    std::vector<std::uint16_t> back(halves.size());
+    ImageWriter::FromHalf(halves.data(), values.data(), halves.size());
+    ImageWriter::ToHalf(values.data(), back.data(), values.size());
+
+    std::size_t mismatches = 0;
+    for (std::size_t i = 0; i < halves.size(); i++)
+    {
+      const bool nan = (halves[i] & 0x7c00) == 0x7c00 && (halves[i] & 0x03ff) != 0;
+      mismatches += nan ? !std::isnan(values[i]) || (back[i] & 0x7fff) <= 0x7c00 : back[i] != halves[i];
+    }
+
+    // midpoints between neighbouring positive halves, and the values a quarter ulp either side of them
+    std::size_t misrounded = 0;
+    for (std::uint16_t h = 0; h < 0x7bff; h++)
+    {
+      const float low = values[h];
+      const float high = values[h + 1];
+      const float probes[] = { low + 0.25f * (high - low), low + 0.75f * (high - low), low + 0.5f * (high - low) };
+      const std::uint16_t expected[] = { h, static_cast<std::uint16_t>(h + 1), static_cast<std::uint16_t>(h + (h & 1)) };
+      std::uint16_t rounded[3];
+      ImageWriter::ToHalf(probes, rounded, 3);
+      for (int p = 0; p < 3; p++)
+      {
+        misrounded += rounded[p] != expected[p];
+      }
+    }
+
+    const float extremes[] = { 65504.0f, 65520.0f, 1e10f, -1e10f, HUGE_VALF, std::nanf(""), 1e-10f, -0.0f };
+    const std::uint16_t extremeHalves[] = { 0x7bff, 0x7c00, 0x7c00, 0xfc00, 0x7c00, 0x7e00, 0x0000, 0x8000 };
+    std::uint16_t converted[8];
+    ImageWriter::ToHalf(extremes, converted, 8);
+    for (int e = 0; e < 8; e++)
+    {
+      misrounded += converted[e] != extremeHalves[e];
+    }
+
+    const bool passed = mismatches == 0 && misrounded == 0;
+    printf("half conversion: %zu of 65536 halves changed on a round trip, %zu floats misrounded  %s\n", mismatches, misrounded, Verdict(passed));
+    check.Record(passed);
+
+    // throughput of the conversion kernels, over a 4k rgba frame
+    std::vector<float> frame(3840 * 2160 * 4);
+    for (std::size_t i = 0; i < frame.size(); i++)
+    {
+      frame[i] = values[(i * 2654435761u) % 0x7c00];
+    }
+    std::vector<std::uint16_t> frameHalves(frame.size());
+    std::vector<std::uint8_t> frameRgb(frame.size() / 4 * 3);
+    auto Measure = [&](auto kernel) {
+      const auto start = std::chrono::steady_clock::now();
+      kernel();
+      return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+    const double toHalf = Measure([&]() { ImageWriter::ToHalf(frame.data(), frameHalves.data(), frame.size()); });
+    const double fromHalf = Measure([&]() { ImageWriter::FromHalf(frameHalves.data(), frame.data(), frame.size()); });
+    const double toRgb8 = Measure([&]() { ImageWriter::ToRgb8(frame.data(), frameRgb.data(), frame.size() / 4); });
+    printf("  3840x2160 rgba: to half %.1f ms, from half %.1f ms, to rgb8 %.1f ms\n", toHalf, fromHalf, toRgb8);
+  }
+
+  // The synthetic accumulation buffer of the denoise report, brightened so it goes past one
+  const unsigned int width = 320;
+  const unsigned int height = 180;
+  const SyntheticImage synthetic(width, height, 16);
+  std::vector<glm::vec4> accumulation = synthetic.color;
+  for (std::size_t i = 0; i < accumulation.size(); i++)
+  {
+    const float gain = (i % width) < width / 2 ? 1.0f : 40.0f;
+    accumulation[i] = glm::vec4(glm::vec3(accumulation[i]) * gain, accumulation[i].w);
+  }
+  const ImageWriter::Image image = ImageWriter::ResolveAccumulation(&accumulation[0].x, width, height, std::size_t(width) * 4);
+  const ImageWriter::Image halfImage = ToHalfPrecision(image);
+  const ImageWriter::Image unormImage = ToUnorm8(image);
+
+  struct Case
+  {
+    const char* name;
+    ImageWriter::Format format;
+    ImageWriter::ExrPixelType pixel_type;
+    ImageWriter::ExrCompression compression;
+    const ImageWriter::Image* expected;
+    double max_relative; // error against expected
+    double max_absolute;
+  };
+  const Case cases[] = {
+    { "exr half", ImageWriter::Format::Exr, ImageWriter::ExrPixelType::Half, ImageWriter::ExrCompression::None, &halfImage, 0.0, 0.0 },
+    { "exr half zip", ImageWriter::Format::Exr, ImageWriter::ExrPixelType::Half, ImageWriter::ExrCompression::Zip, &halfImage, 0.0, 0.0 },
+    { "exr float", ImageWriter::Format::Exr, ImageWriter::ExrPixelType::Float, ImageWriter::ExrCompression::None, &image, 0.0, 0.0 },
+    { "exr float zip", ImageWriter::Format::Exr, ImageWriter::ExrPixelType::Float, ImageWriter::ExrCompression::Zip, &image, 0.0, 0.0 },
+    { "hdr", ImageWriter::Format::Hdr, ImageWriter::ExrPixelType::Half, ImageWriter::ExrCompression::None, &image, 1.0 / 128.0, HUGE_VAL },
+    { "png", ImageWriter::Format::Png, ImageWriter::ExrPixelType::Half, ImageWriter::ExrCompression::None, &unormImage, 0.0, 0.0 },
+    { "bmp", ImageWriter::Format::Bmp, ImageWriter::ExrPixelType::Half, ImageWriter::ExrCompression::None, &unormImage, 0.0, 0.0 },
+    { "jpeg", ImageWriter::Format::Jpeg, ImageWriter::ExrPixelType::Half, ImageWriter::ExrCompression::None, &unormImage, HUGE_VAL, 0.25 },
+  };
+
+  printf("\nround trips of a %ux%u image, the right half brighter than one\n", width, height);
+  printf("  %-14s %10s %8s %12s %12s  %s\n", "format", "bytes", "ms", "max error", "relative", "");
+  for (const Case& c : cases)
+  {
+    ImageWriter::Options options;
+    options.exr_pixel_type = c.pixel_type;
+    options.exr_compression = c.compression;
+
+    const auto start = std::chrono::steady_clock::now();
+    const std::vector<std::uint8_t> data = ImageWriter::Encode(c.format, image, options);
+    const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    ImageWriter::Image decoded;
+    const bool read = !data.empty() && ImageWriter::Decode(c.format, data, decoded);
+    ImageError error = CompareImages(decoded, *c.expected, false);
+    if (c.format == ImageWriter::Format::Hdr)
+    {
+      // rgbe keeps 8 bits of the largest channel, the error is relative to it
+      error.relative = 0.0;
+      for (std::size_t i = 0; read && i < decoded.rgba.size(); i += 4)
+      {
+        const float largest = std::max(std::max(image.rgba[i], image.rgba[i + 1]), image.rgba[i + 2]);
+        for (std::size_t k = 0; k < 3; k++)
+        {
+          error.relative = std::max(error.relative, std::abs(double(decoded.rgba[i + k]) - image.rgba[i + k]) / std::max(largest, 1e-6f));
+        }
+      }
+    }
+    const bool passed = read && error.absolute <= c.max_absolute && error.relative <= c.max_relative;
+    printf("  %-14s %10zu %8.2f %12.3g %12.3g  %s\n", c.name, data.size(), milliseconds, error.absolute, error.relative, Verdict(passed));
+    check.Record(passed);
+  }
+
+  // the worker writes what it was given, in order, while the caller goes on
+  {
+    const char* paths[] = { "image_report.exr", "image_report.png" };
+    ImageWriter::AsyncWriter writer;
+    const auto start = std::chrono::steady_clock::now();
+    for (const char* path : paths)
+    {
+      std::vector<float> copy(&accumulation[0].x, &accumulation[0].x + accumulation.size() * 4);
+      writer.Submit(path, std::move(copy), width, height, ImageWriter::Options());
+    }
+    const double submitted = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    writer.Flush();
+
+    bool passed = writer.GetPendingCount() == 0;
+    ImageWriter::AsyncWriter::Result written;
+    for (const char* path : paths)
+    {
+      passed &= writer.PopResult(written) && written.success && written.path == path;
+
+      std::vector<std::uint8_t> data;
+      if (FILE* file = fopen(path, "rb"))
+      {
+        int c;
+        while ((c = fgetc(file)) != EOF)
+        {
+          data.push_back(static_cast<std::uint8_t>(c));
+        }
+        fclose(file);
+      }
+      ImageWriter::Format format;
+      ImageWriter::Image decoded;
+      passed &= ImageWriter::GetFormat(path, format) && ImageWriter::Decode(format, data, decoded) &&
+        CompareImages(decoded, format == ImageWriter::Format::Exr ? halfImage : unormImage, false).absolute == 0.0;
+      remove(path);
+    }
+    passed &= !writer.PopResult(written);
+    printf("\nasync writer: 2 images submitted in %.2f ms, written in order  %s\n", submitted, Verdict(passed));
+    check.Record(passed);
+  }
+
+  return check.Result();
+}
+
+}
@@ -0,0 +1,183 @@
+#include "checks/Checks.h"
+#include "AliasTable.h"
+#include "LightList.h"
+#include "SceneCore.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include <glm/glm/gtc/matrix_transform.hpp>
+
+namespace Checks {
+
+namespace {
+
+// A fan of triangles around the origin in the xz plane facing up, wound facing down when
+// flipped so the list has to turn them around.
+SceneCore::Mesh MakeFan(unsigned int triangles, float radius, bool flipped)
+{
+  SceneCore::Mesh mesh;
+  SceneCore::Vertex center;
+  center.normal = glm::vec3(0.0f, 1.0f, 0.0f);
+  mesh.vertices.push_back(center);
+  for (unsigned int i = 0; i <= triangles; i++)
+  {
+    const float angle = 3.0f * static_cast<float>(i) / static_cast<float>(triangles);
+    SceneCore::Vertex vertex = center;
+    vertex.position = glm::vec3(radius * std::cos(angle), 0.0f, radius * std::sin(angle));
+    mesh.vertices.push_back(vertex);
+  }
+  for (std::uint32_t i = 1; i <= triangles; i++)
+  {
+    mesh.indices.push_back(0);
+    mesh.indices.push_back(flipped ? i + 1 : i);
+    mesh.indices.push_back(flipped ? i : i + 1);
+  }
+  return mesh;
+}
+
+// The odds of every entry under the alias walk: its own bucket's keep probability and what
+// the buckets aliased to it give away, over the bucket count.
+std::vector<double> GetAliasDistribution(const LightList& lights)
+{
+  const std::vector<LightList::Triangle>& triangles = lights.GetTriangles();
+  std::vector<double> odds(triangles.size(), 0.0);
+  for (std::size_t i = 0; i < triangles.size(); i++)
+  {
+    odds[i] += triangles[i].alias_probability;
+    odds[triangles[i].alias] += 1.0 - triangles[i].alias_probability;
+  }
+  for (double& value : odds)
+  {
+    value /= static_cast<double>(triangles.size());
+  }
+  return odds;
+}
+
+}
+
+int LightChecks(const Options&)
+{
+  Log check;
+
+  // Five meshes of different power: a bright small fan, a dim large one wound the other
+  // way, one that emits nothing, one scaled by its transform and one in color.
+  struct Emitter
+  {
+    SceneCore::Mesh mesh;
+    glm::mat4 transform;
+    glm::vec3 radiance;
+  };
+  const glm::mat4 lifted = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 2.0f, 0.0f)), glm::vec3(2.0f, 1.0f, 2.0f));
+  const Emitter emitters[] = {
+    { MakeFan(16, 0.5f, false), glm::mat4(1.0f), glm::vec3(20.0f) },
+    { MakeFan(8, 3.0f, true), glm::mat4(1.0f), glm::vec3(0.5f) },
+    { MakeFan(4, 1.0f, false), glm::mat4(1.0f), glm::vec3(0.0f) },
+    { MakeFan(4, 1.0f, false), lifted, glm::vec3(3.0f) },
+    { MakeFan(32, 1.0f, false), glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 8.0f) },
+  };
+  LightList lights;
+  std::vector<std::uint32_t> first;
+  for (const Emitter& emitter : emitters)
+  {
+    first.push_back(lights.AddMesh(emitter.mesh.vertices, emitter.mesh.indices, emitter.transform, emitter.radiance));
+  }
+  lights.Build();
+  const std::vector<LightList::Triangle>& triangles = lights.GetTriangles();
+
+  check(first[0] == 0 && first[1] == 16 && first[2] == 24 && first[3] == 28 && first[4] == 32 && lights.GetCount() == 64,
+        "every mesh starts where the previous one ended");
+
+  {
+    bool facing = true;
+    for (const LightList::Triangle& triangle : triangles)
+    {
+      facing &= glm::cross(triangle.v1 - triangle.v0, triangle.v2 - triangle.v0).y > 0.0f;
+    }
+    check(facing, "the winding follows the vertex normals");
+    const float area = 0.5f * 0.5f * 0.5f * std::sin(3.0f / 16.0f);
+    check(Near(triangles[0].area, area) && Near(triangles[first[3]].area, 4.0f * 0.5f * std::sin(0.75f)) &&
+          Near(triangles[first[3]].v0.y, 2.0f), "areas and positions are in world space");
+  }
+
+  double total = 0.0;
+  std::vector<double> weights(triangles.size());
+  for (std::size_t i = 0; i < triangles.size(); i++)
+  {
+    const glm::vec3& c = triangles[i].radiance;
+    weights[i] = (0.2126 * c.x + 0.7152 * c.y + 0.0722 * c.z) * triangles[i].area;
+    total += weights[i];
+  }
+  {
+    bool pdfs = Near(lights.GetTotalPower(), total) && lights.GetSampleableCount() == lights.GetCount();
+    for (std::size_t i = 0; i < triangles.size(); i++)
+    {
+      pdfs &= Near(triangles[i].pdf, weights[i] / total, 1e-5);
+      pdfs &= triangles[i].alias_probability == lights.GetAliasProbabilities()[i] && triangles[i].alias == lights.GetAliases()[i];
+    }
+    check(pdfs, "the pdfs are luminance times area over the total power");
+  }
+
+  {
+    const std::vector<double> odds = GetAliasDistribution(lights);
+    bool exact = true;
+    for (std::size_t i = 0; i < triangles.size(); i++)
+    {
+      exact &= std::abs(odds[i] - triangles[i].pdf) <= 1e-6;
+    }
+    check(exact, "the alias table picks every triangle with its pdf");
+  }
+
+  // Pearson's chi-square of a histogram of the shader's walk against the pdfs. The
+  // triangles that emit nothing must never come up and are left out of the degrees of
+  // freedom; the bound is the 99.9th percentile (Wilson-Hilferty).
+  {
+    const std::uint32_t samples = 4000000;
+    std::mt19937 random(29);
+    std::vector<std::uint32_t> histogram(triangles.size(), 0);
+    for (std::uint32_t s = 0; s < samples; s++)
+    {
+      const float u = static_cast<float>(random() >> 8) * (1.0f / 16777216.0f);
+      histogram[AliasTable::Sample(u, lights.GetAliasProbabilities().data(), lights.GetAliases().data(), lights.GetSampleableCount())]++;
+    }
+
+    double chiSquare = 0.0;
+    unsigned int bins = 0;
+    bool dark = true;
+    for (std::size_t i = 0; i < triangles.size(); i++)
+    {
+      const double expected = samples * static_cast<double>(triangles[i].pdf);
+      if (expected <= 0.0)
+      {
+        dark &= histogram[i] == 0;
+        continue;
+      }
+      const double difference = histogram[i] - expected;
+      chiSquare += difference * difference / expected;
+      bins++;
+    }
+    const double dof = bins - 1.0;
+    const double spread = std::sqrt(2.0 / (9.0 * dof));
+    const double bound = dof * std::pow(1.0 - 2.0 / (9.0 * dof) + 3.09 * spread, 3.0);
+    printf("chi-square %.1f over %u dof, 99.9%% bound %.1f, %u samples\n", chiSquare, bins - 1, bound, samples);
+    check(dark, "triangles that emit nothing are never picked");
+    check(chiSquare < bound, "the histogram of the samples follows the emitted power");
+  }
+
+  {
+    LightList dark;
+    dark.AddMesh(emitters[2].mesh.vertices, emitters[2].mesh.indices, emitters[2].transform, emitters[2].radiance);
+    dark.Build();
+    check(dark.GetCount() == 4 && dark.GetSampleableCount() == 0 && dark.GetTriangles()[0].pdf == 0.0f,
+          "a list that emits nothing has entries but nothing to sample");
+    dark.Clear();
+    check(dark.GetCount() == 0 && dark.GetAliases().empty() && dark.GetTotalPower() == 0.0f, "clear drops the triangles and the table");
+  }
+
+  return check.Result();
+}
+
+}
@@ -0,0 +1,153 @@
+#include "checks/Checks.h"
+#include "CpuRenderCommon.h"
+#include "shaders/MicrofacetHlslCompat.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace Checks {
+
+int MicrofacetChecks(const Options&)
+{
+  using namespace Microfacet;
+  Log check;
+  auto Random = [](std::uint32_t sample, std::uint32_t dimension) {
+    return static_cast<float>(Sampling::SamplerToFloat(Sampling::SamplerHash(Sampling::SamplerHashCombine(Sampling::SamplerHash(dimension + 0x3c6ef372u), sample))));
+  };
+  auto Outgoing = [](float cosTheta) {
+    return float3(std::sqrt(std::max(1.0f - cosTheta * cosTheta, 0.0f)), 0.0f, cosTheta);
+  };
+
+  // The committed table has to be what the lobe integrates to now.
+  {
+    const auto start = std::chrono::steady_clock::now();
+    const std::vector<float> table = CpuRender::ComputeMicrofacetEnergyTable();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double maxError = 0.0;
+    for (std::size_t i = 0; i < table.size(); i++)
+    {
+      maxError = std::max(maxError, double(std::abs(table[i] - c_microfacetEnergy[i])));
+    }
+    printf("energy table: %u x %u, %u samples per entry, recomputed in %.2f s, max difference %.1e\n",
+           MICROFACET_ENERGY_SIZE, MICROFACET_ENERGY_SIZE, CpuRender::c_microfacetEnergySamples, seconds, maxError);
+    check(maxError < 2e-6, "MicrofacetEnergyHlslCompat.h matches the lobe (--microfacet-lut)");
+  }
+
+  // White furnace: a white metal and a white dielectric reflect all light at every
+  // roughness and angle, the single scattering lobe alone loses up to a third.
+  {
+    const float roughnesses[] = { 0.05f, 0.25f, 0.5f, 0.75f, 1.0f };
+    const float cosines[] = { 0.1f, 0.3f, 0.6f, 1.0f };
+    const std::uint32_t samples = 1 << 16;
+    double maxMetal = 0.0, maxDielectric = 0.0, minUncompensated = 1.0;
+    printf("\nwhite furnace, albedo of the metal / dielectric / uncompensated metal:\n");
+    printf("  %-10s", "roughness");
+    for (float cosine : cosines)
+    {
+      printf("      cos %.1f       ", cosine);
+    }
+    printf("\n");
+    for (float roughness : roughnesses)
+    {
+      printf("  %-10.2f", roughness);
+      for (float cosine : cosines)
+      {
+        const float3 wo = Outgoing(cosine);
+        double albedo[2] = {};
+        for (std::uint32_t m = 0; m < 2; m++)
+        {
+          const float3 base(1.0f, 1.0f, 1.0f);
+          const float metallic = m == 0 ? 1.0f : 0.0f;
+          for (std::uint32_t s = 0; s < samples; s++)
+          {
+            const float3 wi = MicrofacetSample(base, metallic, roughness, wo, Random(s, 0), Random(s, 1), Random(s, 2));
+            const float pdf = MicrofacetPdf(base, metallic, roughness, wo, wi);
+            if (pdf > 0.0f)
+            {
+              albedo[m] += MicrofacetEvaluate(base, metallic, roughness, wo, wi).y / pdf;
+            }
+          }
+          albedo[m] /= samples;
+        }
+        float a, b;
+        ComputeMicrofacetEnergy(cosine, roughness, 4096, a, b);
+        printf(" %.3f/%.3f/%.3f ", albedo[0], albedo[1], a + b);
+        maxMetal = std::max(maxMetal, std::abs(albedo[0] - 1.0));
+        maxDielectric = std::max(maxDielectric, std::abs(albedo[1] - 1.0));
+        minUncompensated = std::min(minUncompensated, double(a + b));
+      }
+      printf("\n");
+    }
+    printf("  largest deviation from 1: metal %.4f, dielectric %.4f; uncompensated down to %.3f\n", maxMetal, maxDielectric, minUncompensated);
+    check(maxMetal < 0.01 && maxDielectric < 0.01, "white metal and dielectric reflect within 1% of everything");
+  }
+
+  // The pdf against the sampler: integrated over the hemisphere it has to be the share
+  // of samples that stay above the surface, and an estimate with it has to agree with
+  // one that knows nothing about the lobe.
+  {
+    const float3 base(0.9f, 0.6f, 0.2f);
+    const float roughnesses[] = { 0.2f, 0.5f, 1.0f };
+    const float metallics[] = { 0.0f, 0.5f, 1.0f };
+    const std::uint32_t samples = 1 << 18;
+    const std::uint32_t uniformSamples = 1 << 21;
+    bool normalized = true, agree = true;
+    printf("\npdf checks, base (0.9, 0.6, 0.2) at cos 0.5: integral of the pdf / samples above, albedo importance / uniform\n");
+    for (float roughness : roughnesses)
+    {
+      for (float metallic : metallics)
+      {
+        const float3 wo = Outgoing(0.5f);
+        std::uint32_t above = 0;
+        double importance = 0.0, importanceSquares = 0.0;
+        for (std::uint32_t s = 0; s < samples; s++)
+        {
+          const float3 wi = MicrofacetSample(base, metallic, roughness, wo, Random(s, 3), Random(s, 4), Random(s, 5));
+          const float pdf = MicrofacetPdf(base, metallic, roughness, wo, wi);
+          if (wi.z > 0.0f && pdf > 0.0f)
+          {
+            above++;
+            const double value = MicrofacetEvaluate(base, metallic, roughness, wo, wi).x / pdf;
+            importance += value;
+            importanceSquares += value * value;
+          }
+        }
+
+        // uniform directions over the upper hemisphere, pdf 1 / 2 pi
+        double integral = 0.0, uniform = 0.0, uniformSquares = 0.0;
+        for (std::uint32_t s = 0; s < uniformSamples; s++)
+        {
+          const float z = Random(s, 6);
+          const float r = std::sqrt(std::max(1.0f - z * z, 0.0f));
+          const float phi = 2.0f * MICROFACET_PI * Random(s, 7);
+          const float3 wi(r * std::cos(phi), r * std::sin(phi), z);
+          integral += MicrofacetPdf(base, metallic, roughness, wo, wi);
+          const double value = MicrofacetEvaluate(base, metallic, roughness, wo, wi).x;
+          uniform += value;
+          uniformSquares += value * value;
+        }
+        integral *= 2.0 * MICROFACET_PI / uniformSamples;
+        const double fraction = double(above) / samples;
+        const double importanceMean = importance / samples;
+        const double uniformMean = uniform * 2.0 * MICROFACET_PI / uniformSamples;
+        const double importanceError = std::sqrt(std::max(importanceSquares / samples - importanceMean * importanceMean, 0.0) / samples);
+        const double uniformError = 2.0 * MICROFACET_PI *
+          std::sqrt(std::max(uniformSquares / uniformSamples - (uniform / uniformSamples) * (uniform / uniformSamples), 0.0) / uniformSamples);
+        const double tolerance = 4.0 * std::sqrt(importanceError * importanceError + uniformError * uniformError) + 1e-3;
+
+        printf("  roughness %.1f metallic %.1f: %.4f / %.4f, %.4f / %.4f\n", roughness, metallic, integral, fraction, importanceMean, uniformMean);
+        normalized &= std::abs(integral - fraction) < 0.01;
+        agree &= std::abs(importanceMean - uniformMean) < tolerance;
+      }
+    }
+    check(normalized, "pdf integrates to the share of samples above the surface");
+    check(agree, "importance sampled albedo matches uniform sampling");
+  }
+  return check.Result();
+}
+
+}
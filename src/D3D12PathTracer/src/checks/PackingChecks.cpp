@@ -0,0 +1,186 @@
+#include "checks/Checks.h"
+#include "CpuRenderCommon.h"
+#include "ImageWriter.h"
+#include "SceneCore.h"
+#include "shaders/PackingHlslCompat.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace Checks {
+
+namespace {
+
+// Angle between a unit vector and its decoded form, in degrees.
+double AngleDegrees(const glm::dvec3& a, const Packing::float3& b)
+{
+  const glm::dvec3 decoded(b.x, b.y, b.z);
+  return glm::degrees(std::atan2(glm::length(glm::cross(a, decoded)), glm::dot(a, decoded)));
+}
+
+// Hashed uniform direction on the sphere.
+glm::dvec3 RandomDirection(std::uint32_t index)
+{
+  const double z = 1.0 - 2.0 * Sampling::SamplerToFloat(Sampling::SamplerHash(index * 2 + 1));
+  const double phi = 6.283185307179586 * Sampling::SamplerToFloat(Sampling::SamplerHash(index * 2 + 2));
+  const double r = std::sqrt(std::max(1.0 - z * z, 0.0));
+  return glm::dvec3(r * std::cos(phi), r * std::sin(phi), z);
+}
+
+}
+
+int PackingChecks(const Options& options)
+{
+  using namespace Packing;
+  Log check;
+  const std::vector<std::string> scenes = options.GetScenes({ "src/scenes/cornell.txt", "src/scenes/room.txt" });
+
+  // The C++ side of f32tof16 and f16tof32 has to agree with the converters of the image
+  // writer, which the image report checks against every half.
+  {
+    std::size_t mismatches = 0;
+    for (std::uint32_t h = 0; h < 0x10000; h++)
+    {
+      const std::uint16_t half = static_cast<std::uint16_t>(h);
+      float expected;
+      ImageWriter::FromHalf(&half, &expected, 1);
+      const float value = f16tof32(h);
+      mismatches += std::isnan(expected) ? !std::isnan(value) : asuint(value) != asuint(expected);
+      mismatches += std::isnan(expected) ? (f32tof16(value) & 0x7fffu) <= 0x7c00u : f32tof16(value) != h;
+    }
+    for (std::uint32_t i = 0; i < (1u << 22); i++)
+    {
+      const float value = asfloat(Sampling::SamplerHash(i));
+      std::uint16_t expected;
+      ImageWriter::ToHalf(&value, &expected, 1);
+      mismatches += std::isnan(value) ? (f32tof16(value) & 0x7fffu) <= 0x7c00u : f32tof16(value) != expected;
+    }
+
+    // throughput goes through PackHalf2, relative error of at most half a half ulp
+    double maxRelative = 0.0;
+    for (std::uint32_t i = 0; i < (1u << 20); i++)
+    {
+      const float value = static_cast<float>(std::pow(10.0, -4.0 + 8.8 * Sampling::SamplerToFloat(Sampling::SamplerHash(i + 0x9e3779b9u))));
+      const float2 decoded = UnpackHalf2(PackHalf2(value, -value));
+      if (value <= PACKING_HALF_MAX)
+      {
+        maxRelative = std::max(maxRelative, std::abs(double(decoded.x) - value) / value);
+      }
+      else
+      {
+        mismatches += decoded.x != PACKING_HALF_MAX || decoded.y != -PACKING_HALF_MAX;
+      }
+    }
+    const bool passed = mismatches == 0 && maxRelative <= std::ldexp(1.0, -11);
+    printf("half: %zu conversions differ from the image writer, throughput relative error %.2e (limit %.2e)  %s\n", mismatches, maxRelative,
+           std::ldexp(1.0, -11), Verdict(passed));
+    check.Record(passed);
+  }
+
+  // Octahedral directions: random ones and the axes and diagonals, where the fold is
+  {
+    const std::uint32_t count = 1u << 22;
+    double maxAngle = 0.0;
+    double sumAngle = 0.0;
+    std::size_t sentinels = 0;
+    auto Measure = [&](const glm::dvec3& direction) {
+      const uint packed = PackOctahedral(float3(float(direction.x), float(direction.y), float(direction.z)));
+      sentinels += packed == PACKING_NO_DIRECTION;
+      const double angle = AngleDegrees(direction, UnpackOctahedral(packed));
+      maxAngle = std::max(maxAngle, angle);
+      sumAngle += angle;
+    };
+    for (std::uint32_t i = 0; i < count; i++)
+    {
+      Measure(RandomDirection(i));
+    }
+    for (int x = -1; x <= 1; x++)
+    {
+      for (int y = -1; y <= 1; y++)
+      {
+        for (int z = -1; z <= 1; z++)
+        {
+          if (x != 0 || y != 0 || z != 0)
+          {
+            Measure(glm::normalize(glm::dvec3(x, y, z)));
+          }
+        }
+      }
+    }
+    const float3 zero = UnpackOctahedralOrZero(PackOctahedralOrNone(float3(0.0f, 0.0f, 0.0f)));
+    const bool passed = maxAngle < 0.01 && sentinels == 0 && zero.x == 0.0f && zero.y == 0.0f && zero.z == 0.0f;
+    printf("octahedral snorm16: mean %.5f, max %.5f degrees over %u directions (limit 0.01)  %s\n", sumAngle / (count + 26), maxAngle, count + 26,
+           Verdict(passed));
+    check.Record(passed);
+  }
+
+  // The payload, field by field
+  const unsigned int payloadBefore = 16 + 12 + 12 + 12 + 4 + 16 + 12; // float4 color, float3 origin, direction and hit normal, light pdf, float4 feature, float3 normal
+  const unsigned int payloadAfter = 8 + 12 + 4 + 4 + 4 + 8 + 4; // half color, float3 origin, octahedral direction and hit normal, light pdf, half feature, octahedral normal
+  printf("ray payload: %u bytes before, %u now\n", payloadBefore, payloadAfter);
+
+  // Vertex streams of the scenes: the attributes quantized as Scene::AllocateVertexStreams does it
+  const unsigned int fetchedBefore = 3 * VERTEX_INTERLEAVED_STRIDE;
+  printf("\nvertex bytes, %u per vertex interleaved before, %u + %u as float streams, %u + %u quantized\n", VERTEX_INTERLEAVED_STRIDE, VERTEX_POSITION_STRIDE,
+         VERTEX_ATTRIBUTES_STRIDE, VERTEX_POSITION_STRIDE, VERTEX_QUANTIZED_ATTRIBUTES_STRIDE);
+  printf("  read per hit: %u before, %u float, %u quantized, %u more with a normal map\n", fetchedBefore, 3 * VERTEX_ATTRIBUTES_STRIDE,
+         3 * VERTEX_QUANTIZED_ATTRIBUTES_STRIDE, 3 * VERTEX_POSITION_STRIDE);
+  for (const auto& path : scenes)
+  {
+    SceneCore::SceneData scene;
+    if (!CpuRender::LoadScene(path, scene))
+    {
+      check.Record(false);
+      continue;
+    }
+
+    std::size_t vertices = 0;
+    double maxNormalAngle = 0.0;
+    double maxUvError = 0.0; // in units of the uv range of the mesh
+    for (const auto& pair : scene.meshes)
+    {
+      const SceneCore::Mesh& mesh = pair.second;
+      if (mesh.vertices.empty())
+      {
+        continue;
+      }
+      vertices += mesh.vertices.size();
+
+      glm::vec2 uvMin = mesh.vertices[0].uv;
+      glm::vec2 uvMax = mesh.vertices[0].uv;
+      for (const SceneCore::Vertex& v : mesh.vertices)
+      {
+        uvMin = glm::min(uvMin, v.uv);
+        uvMax = glm::max(uvMax, v.uv);
+      }
+      const float2 offset(uvMin.x, uvMin.y);
+      const float2 scale(std::max(uvMax.x - uvMin.x, 1e-6f), std::max(uvMax.y - uvMin.y, 1e-6f));
+
+      for (const SceneCore::Vertex& v : mesh.vertices)
+      {
+        if (glm::length(v.normal) > 0.0f)
+        {
+          const glm::dvec3 normal = glm::normalize(glm::dvec3(v.normal));
+          maxNormalAngle = std::max(maxNormalAngle, AngleDegrees(normal, UnpackOctahedralOrZero(PackOctahedralOrNone(float3(v.normal.x, v.normal.y, v.normal.z)))));
+        }
+        const float2 uv = UnpackTexCoord(PackTexCoord(float2(v.uv.x, v.uv.y), offset, scale), offset, scale);
+        maxUvError = std::max({ maxUvError, std::abs(double(uv.x) - v.uv.x) / scale.x, std::abs(double(uv.y) - v.uv.y) / scale.y });
+      }
+    }
+
+    auto Kilobytes = [&](unsigned int stride) { return vertices * stride / 1024.0; };
+    const bool passed = maxNormalAngle < 0.01 && maxUvError <= 0.5 / 65535.0 + 1e-6;
+    printf("%s: %zu vertices, %.1f KB interleaved, %.1f KB as float streams, %.1f KB quantized%s\n", path.c_str(), vertices,
+           Kilobytes(VERTEX_INTERLEAVED_STRIDE), Kilobytes(VERTEX_POSITION_STRIDE + VERTEX_ATTRIBUTES_STRIDE),
+           Kilobytes(VERTEX_POSITION_STRIDE + VERTEX_QUANTIZED_ATTRIBUTES_STRIDE), scene.camera.quantize_vertices ? " (the scene quantizes)" : "");
+    printf("  quantized normals within %.5f degrees, uvs within %.2e of their range  %s\n", maxNormalAngle, maxUvError, Verdict(passed));
+    check.Record(passed);
+  }
+  return check.Result();
+}
+
+}
@@ -0,0 +1,200 @@
+#include "checks/Checks.h"
+#include "SceneCore.h"
+#include "SceneParser.h"
+#include "Utilities.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Checks {
+
+namespace {
+
+// The lines and tokens the scene loader used to read, safeGetline and tokenizeString.
+// safeGetline hands out an empty line at the end of every stream, that one is dropped.
+std::vector<std::vector<std::string>> LegacyTokens(const std::string& text)
+{
+  std::vector<std::vector<std::string>> lines;
+  std::istringstream stream(text);
+  std::string line;
+  while (utilityCore::safeGetline(stream, line))
+  {
+    lines.push_back(utilityCore::tokenizeString(line));
+  }
+  if (!lines.empty() && lines.back().empty())
+  {
+    lines.pop_back();
+  }
+  return lines;
+}
+
+bool SameDouble(double a, double b)
+{
+  return std::isnan(a) ? std::isnan(b) : std::memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+}
+
+int ParserChecks(const Options& options)
+{
+  Log check;
+  const std::vector<std::string> scenes = options.GetScenes({ "src/scenes/dragon.txt", "src/scenes/subsurfacetest.txt" });
+
+  auto Measure = [](auto work) {
+    const auto start = std::chrono::steady_clock::now();
+    work();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  };
+
+  // Numbers have to come out as the same double atof returns, the shortcut only takes
+  // plain decimals it can convert exactly
+  {
+    const char* numbers[] = { "0", "-0", "1", "0.1", "0.35", "-7.5", "30", "1e-5", "2.5E+3", ".5", "5.", "-.5e2", "1e", "1e+",
+                              "3.4028235e38", "1e23", "1e-23", "9007199254740993", "0.1000000000000000055511151231257827",
+                              "123456789012345678901234567890", "0x1p3", "inf", "-nan", "abc", "12abc", "+3", "--1", "" };
+    bool same = true;
+    for (const char* number : numbers)
+    {
+      const SceneParser::Token token{ number, std::strlen(number) };
+      same &= SameDouble(SceneParser::ParseDouble(token), atof(number));
+      same &= std::strlen(number) > 10 || SceneParser::ParseInt(token) == atoi(number);
+    }
+    check(same, "numbers match atof and atoi");
+  }
+
+  // Line ends the way safeGetline takes them: \r\r\n is a line and an empty one
+  {
+    const std::string text = "MODEL 0\r\r\npath a.obj\r\n\rOBJECT\t1  x\n\n\vtrans 1 2 3\r\nlast";
+    SceneParser::Tokenizer tokenizer(text.data(), text.size());
+    std::vector<std::vector<std::string>> lines;
+    while (tokenizer.NextLine())
+    {
+      lines.emplace_back();
+      for (std::size_t i = 0; i < tokenizer.GetCount(); i++)
+      {
+        lines.back().push_back(tokenizer[i].ToString());
+      }
+    }
+    check(lines == LegacyTokens(text), "line ends and separators match safeGetline and tokenizeString");
+  }
+
+  printf("\n");
+  for (const auto& path : scenes)
+  {
+    SceneParser::MappedFile file;
+    if (!file.Open(path))
+    {
+      fprintf(stderr, "cannot read %s\n", path.c_str());
+      check.Record(false);
+      continue;
+    }
+    const std::string text(file.GetData(), file.GetSize());
+    printf("%s: %zu bytes\n", path.c_str(), text.size());
+
+    // every token and every number it holds the same as before
+    const std::vector<std::vector<std::string>> legacy = LegacyTokens(text);
+    std::size_t lineCount = 0;
+    bool sameTokens = true;
+    bool sameNumbers = true;
+    SceneParser::Tokenizer tokenizer(text.data(), text.size());
+    while (tokenizer.NextLine())
+    {
+      const std::vector<std::string>* expected = lineCount < legacy.size() ? &legacy[lineCount] : nullptr;
+      lineCount++;
+      const std::size_t count = expected != nullptr ? std::min(expected->size(), SceneParser::Tokenizer::MaxTokens) : 0;
+      sameTokens &= expected != nullptr && tokenizer.GetCount() == count;
+      for (std::size_t i = 0; sameTokens && i < count; i++)
+      {
+        sameTokens &= tokenizer[i] == (*expected)[i].c_str();
+        sameNumbers &= SameDouble(SceneParser::ParseDouble(tokenizer[i]), atof((*expected)[i].c_str()));
+      }
+    }
+    sameTokens &= lineCount == legacy.size();
+    check(sameTokens && sameNumbers, "  same lines, tokens and numbers as the old loader");
+
+    // the tokenizing and number parsing of the old loader against the new one, on the
+    // text in memory; the full parse adds building the scene description
+    const int iterations = std::max(1, static_cast<int>(4000000 / std::max<std::size_t>(text.size(), 1)));
+    volatile double sink = 0.0; // keeps the conversions from being optimized out
+    const double before = Measure([&]() {
+      double sum = 0.0;
+      for (int i = 0; i < iterations; i++)
+      {
+        std::istringstream stream(text);
+        std::string line;
+        while (utilityCore::safeGetline(stream, line))
+        {
+          for (const std::string& token : utilityCore::tokenizeString(line))
+          {
+            sum += atof(token.c_str());
+          }
+        }
+      }
+      sink = sum;
+    }) / iterations;
+    const double after = Measure([&]() {
+      double sum = 0.0;
+      for (int i = 0; i < iterations; i++)
+      {
+        SceneParser::Tokenizer lines(text.data(), text.size());
+        while (lines.NextLine())
+        {
+          for (std::size_t t = 0; t < lines.GetCount(); t++)
+          {
+            sum += SceneParser::ParseDouble(lines[t]);
+          }
+        }
+      }
+      sink = sum;
+    }) / iterations;
+    std::size_t objectCount = 0;
+    const double full = Measure([&]() {
+      for (int i = 0; i < iterations; i++)
+      {
+        SceneParser::SceneFile scene;
+        SceneParser::ParseBuffer(text.data(), text.size(), scene);
+        objectCount = scene.objects.size();
+      }
+    }) / iterations;
+    auto Throughput = [&](double milliseconds) { return text.size() / std::max(milliseconds, 1e-9) / 1e3; };
+    printf("  tokenize and convert: safeGetline/tokenizeString/atof %.3f ms (%.0f MB/s), Tokenizer/ParseDouble %.3f ms (%.0f MB/s), %.1fx\n",
+           before, Throughput(before), after, Throughput(after), before / std::max(after, 1e-9));
+    printf("  full parse: %.3f ms (%.0f MB/s), %zu objects\n", full, Throughput(full), objectCount);
+
+    // the models and textures of the scene, read on one thread and on all of them
+    SceneParser::SceneFile scene;
+    SceneParser::ParseBuffer(text.data(), text.size(), scene);
+    auto LoadAssets = [&](unsigned int threads) {
+      return Measure([&]() {
+        SceneParser::ForEachParallel(scene.assets.size(), threads, [&](std::size_t i) {
+          std::string error;
+          if (scene.assets[i].kind == SceneParser::AssetKind::Model)
+          {
+            SceneCore::Mesh mesh;
+            SceneCore::LoadObjMesh(scene.assets[i].path, mesh, error);
+          }
+          else
+          {
+            SceneCore::Texture texture;
+            SceneCore::LoadTexture(scene.assets[i].path, texture, error);
+          }
+        });
+      });
+    };
+    const double serial = LoadAssets(1);
+    const double parallel = LoadAssets(0);
+    printf("  %zu models and textures: %.1f ms on 1 thread, %.1f ms on %u, %.1fx\n", scene.assets.size(), serial, parallel,
+           std::max(1u, std::thread::hardware_concurrency()), serial / std::max(parallel, 1e-9));
+  }
+  return check.Result();
+}
+
+}
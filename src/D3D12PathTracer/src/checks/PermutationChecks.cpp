@@ -0,0 +1,172 @@
+#include "checks/Checks.h"
+#include "CpuPathTracer.h"
+#include "CpuRenderCommon.h"
+#include "SceneCore.h"
+#include "ShaderPermutation.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace Checks {
+
+int PermutationChecks(const Options& options)
+{
+  using namespace ShaderPermutation;
+  Log check;
+  const std::vector<std::string> scenes = options.GetScenes({ "src/scenes/cornell.txt", "src/scenes/room.txt" });
+
+  // The branch cascade of MyClosestHitShader: glass before reflective before refractive
+  // before emissive before microfacet, diffuse for the rest; exactly one material path
+  // per object.
+  {
+    const float values[] = { 0.0f, 0.5f };
+    bool cascade = true;
+    for (float reflectiveness : values)
+    {
+      for (float refractiveness : values)
+      {
+        for (float emittance : values)
+        {
+          for (float roughness : values)
+          {
+            for (bool normalMap : { false, true })
+            {
+              ObjectShading object;
+              object.reflectiveness = reflectiveness;
+              object.refractiveness = refractiveness;
+              object.emittance = emittance;
+              object.roughness = roughness;
+              object.normal_map = normalMap;
+              const std::uint32_t surface = emittance > 0.0f ? PermutationEmissive : (roughness > 0.0f ? PermutationMicrofacet : PermutationDiffuse);
+              const std::uint32_t expected = (normalMap ? static_cast<std::uint32_t>(PermutationNormalMapping) : 0u) |
+                (reflectiveness > 0.0f ? (refractiveness > 0.0f ? PermutationGlass : PermutationReflective)
+                                       : (refractiveness > 0.0f ? PermutationRefractive : surface));
+              cascade &= ClassifyObject(object) == expected;
+            }
+          }
+        }
+      }
+    }
+    check(cascade, "objects take the branch of the closest hit shader");
+    check(Analyze({}, CpuPathTracer::AntiAliasing | CpuPathTracer::NextEventEstimation) == PermutationAntiAliasing &&
+            Analyze({}, CpuPathTracer::DepthOfField | CpuPathTracer::RussianRoulette) == PermutationDepthOfField,
+          "only anti-aliasing and depth of field are features of a permutation");
+  }
+
+  // The shader has a default and a use for every define, and the sources come with all
+  // of their headers
+  std::vector<Source> sources;
+  std::string error;
+  if (!ReadSources("src/shaders/Raytracing.hlsl", sources, error))
+  {
+    printf("%s\n", error.c_str());
+    return 1;
+  }
+  {
+    bool declared = true;
+    for (const Define& define : GetDefines(PermutationAll))
+    {
+      // #ifndef, #define and at least one branch
+      const std::string& shader = sources[0].text;
+      std::size_t count = 0;
+      for (std::size_t at = shader.find(define.name); at != std::string::npos; at = shader.find(define.name, at + 1))
+      {
+        count++;
+      }
+      declared &= shader.find("#ifndef " + define.name) != std::string::npos && count >= 3;
+    }
+    check(declared, "Raytracing.hlsl defaults and tests every PERMUTATION_ define");
+    printf("  %zu sources:", sources.size());
+    for (const Source& source : sources)
+    {
+      printf(" %s", source.path.c_str());
+    }
+    printf("\n");
+    check(sources.size() >= 5, "the sources include the HlslCompat headers");
+  }
+
+  // Cache keys: one per permutation, stable, and different after any change of the inputs
+  const std::string target = "lib_6_3";
+  const std::vector<std::string> arguments = { "-Zpr", "-O3" };
+  const std::string compiler = "dxcompiler 1.4";
+  {
+    std::vector<std::uint64_t> keys;
+    for (std::uint32_t permutation = 0; permutation <= PermutationAll; permutation++)
+    {
+      keys.push_back(ComputeCacheKey(sources, GetDefines(permutation), target, arguments, compiler));
+    }
+    const std::uint64_t all = keys.back();
+    std::sort(keys.begin(), keys.end());
+    const std::string unique = std::to_string(keys.size()) + " permutations, " + std::to_string(keys.size()) + " keys";
+    check(std::unique(keys.begin(), keys.end()) == keys.end(), unique.c_str());
+    check(ComputeCacheKey(sources, GetDefines(PermutationAll), target, arguments, compiler) == all, "the key is the same for the same inputs");
+
+    std::vector<Source> edited = sources;
+    edited.back().text.back() ^= 1;
+    std::vector<std::string> otherArguments = arguments;
+    otherArguments[1] = "-O2";
+    check(ComputeCacheKey(edited, GetDefines(PermutationAll), target, arguments, compiler) != all &&
+            ComputeCacheKey(sources, GetDefines(PermutationAll), "lib_6_5", arguments, compiler) != all &&
+            ComputeCacheKey(sources, GetDefines(PermutationAll), target, otherArguments, compiler) != all &&
+            ComputeCacheKey(sources, GetDefines(PermutationAll), target, arguments, "dxcompiler 1.5") != all,
+          "a byte of an included header, the target, an argument or the compiler change it");
+  }
+
+  // Cache entries round trip, a wrong key or a truncated file is a miss
+  {
+    const std::string directory = "shader_cache_report";
+    const std::uint64_t key = 0x0123456789abcdefull;
+    const std::string path = GetCachePath(directory, "Raytracing", key);
+    std::vector<std::uint8_t> library(4096);
+    for (std::size_t i = 0; i < library.size(); i++)
+    {
+      library[i] = static_cast<std::uint8_t>(Sampling::SamplerHash(static_cast<std::uint32_t>(i)));
+    }
+    std::vector<std::uint8_t> loaded;
+    const bool stored = StoreCached(path, key, library);
+    const bool hit = LoadCached(path, key, loaded) && loaded == library;
+    const bool wrongKey = LoadCached(path, key + 1, loaded);
+    bool truncated = true;
+    {
+      std::string contents;
+      std::FILE* file = std::fopen(path.c_str(), "rb");
+      if (file != nullptr)
+      {
+        char buffer[8192];
+        contents.assign(buffer, std::fread(buffer, 1, sizeof(buffer), file));
+        std::fclose(file);
+        file = std::fopen(path.c_str(), "wb");
+        std::fwrite(contents.data(), 1, contents.size() - 1, file);
+        std::fclose(file);
+        truncated = LoadCached(path, key, loaded);
+      }
+    }
+    std::remove(path.c_str());
+    std::remove(directory.c_str());
+    printf("  %s\n", path.c_str());
+    check(stored && hit && !wrongKey && !truncated, "cache entries round trip, wrong keys and truncated files miss");
+  }
+
+  // What each scene would compile, with the features the GPU starts with
+  printf("\n");
+  const std::uint32_t features = CpuPathTracer::AntiAliasing | CpuPathTracer::NextEventEstimation;
+  for (const auto& path : scenes)
+  {
+    SceneCore::SceneData scene;
+    if (!CpuRender::LoadScene(path, scene))
+    {
+      check.Record(false);
+      continue;
+    }
+    const std::uint32_t permutation = AnalyzeScene(scene, features);
+    std::printf("%s: %s\n", path.c_str(), Describe(permutation).c_str());
+    std::printf("  compiled out: %s\n", Describe(PermutationAll & ~permutation).c_str());
+    std::printf("  cache entry: %s\n", GetCachePath("shader_cache", "Raytracing", ComputeCacheKey(sources, GetDefines(permutation), target, arguments, compiler)).c_str());
+  }
+  return check.Result();
+}
+
+}
@@ -0,0 +1,251 @@
+#include "checks/Checks.h"
+#include "CpuPathTracer.h"
+#include "CpuRenderCommon.h"
+#include "Profiler.h"
+#include "SceneCore.h"
+#include "json.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace Checks {
+
+int ProfileChecks(const Options&)
+{
+  Log check;
+  auto CountNamed = [](const std::vector<Profiler::Event>& events, const char* name) {
+    return std::count_if(events.begin(), events.end(), [&](const Profiler::Event& event) { return std::strcmp(event.name, name) == 0; });
+  };
+
+  std::vector<Profiler::Event> events;
+  Profiler::SetThreadName("main");
+  Profiler::Collect(events);
+  events.clear();
+
+  {
+    PROFILE_SCOPE("disabled");
+  }
+  Profiler::Collect(events);
+  check(events.empty(), "a disabled profiler records nothing");
+
+  Profiler::SetEnabled(true);
+  {
+    PROFILE_SCOPE("outer");
+    {
+      PROFILE_SCOPE("inner");
+    }
+  }
+  Profiler::Collect(events);
+  check(events.size() == 2 && std::strcmp(events[0].name, "inner") == 0 && events[0].depth == 1 && events[1].depth == 0 &&
+          events[1].begin <= events[0].begin && events[0].end <= events[1].end && events[0].track == events[1].track,
+        "nested scopes end inside each other one level deeper");
+
+  // Every thread gets a track of its own, named or not.
+  {
+    const unsigned int threadCount = 8;
+    const int perThread = 1000;
+    std::vector<std::thread> threads;
+    for (unsigned int t = 0; t < threadCount; t++)
+    {
+      threads.emplace_back([t]() {
+        if (t % 2 == 0)
+        {
+          Profiler::SetThreadName("report worker");
+        }
+        for (int i = 0; i < perThread; i++)
+        {
+          PROFILE_SCOPE("work");
+        }
+      });
+    }
+    for (auto& thread : threads)
+    {
+      thread.join();
+    }
+    events.clear();
+    Profiler::Collect(events);
+    std::map<std::uint32_t, int> perTrack;
+    for (const Profiler::Event& event : events)
+    {
+      perTrack[event.track]++;
+    }
+    const std::vector<Profiler::Track> tracks = Profiler::GetTracks();
+    const auto named = std::count_if(perTrack.begin(), perTrack.end(), [&](const std::pair<const std::uint32_t, int>& pair) {
+      return pair.first < tracks.size() && tracks[pair.first].name == "report worker";
+    });
+    check(events.size() == threadCount * perThread && perTrack.size() == threadCount &&
+            std::all_of(perTrack.begin(), perTrack.end(), [&](const std::pair<const std::uint32_t, int>& pair) { return pair.second == perThread; }) &&
+            named == threadCount / 2,
+          "threads record on tracks of their own, with their names");
+  }
+
+  // Producers never wait for the collector, whatever it misses it counts as dropped.
+  {
+    const unsigned int threadCount = 4;
+    const int perThread = 200000;
+    const std::uint64_t droppedBefore = Profiler::GetDroppedCount();
+    std::atomic<unsigned int> running{ threadCount };
+    std::vector<std::thread> threads;
+    for (unsigned int t = 0; t < threadCount; t++)
+    {
+      threads.emplace_back([&]() {
+        for (int i = 0; i < perThread; i++)
+        {
+          PROFILE_SCOPE("stress");
+        }
+        running--;
+      });
+    }
+    std::vector<Profiler::Event> collected;
+    std::size_t collects = 0;
+    while (running > 0)
+    {
+      Profiler::Collect(collected);
+      collects++;
+    }
+    for (auto& thread : threads)
+    {
+      thread.join();
+    }
+    Profiler::Collect(collected);
+    const std::uint64_t dropped = Profiler::GetDroppedCount() - droppedBefore;
+
+    std::map<std::uint32_t, std::int64_t> lastEnd;
+    bool ordered = true;
+    for (const Profiler::Event& event : collected)
+    {
+      std::int64_t& end = lastEnd[event.track];
+      ordered &= event.end >= end && std::strcmp(event.name, "stress") == 0;
+      end = event.end;
+    }
+    printf("  %u threads x %d scopes, %zu collects: %zu collected, %llu dropped\n", threadCount, perThread, collects, collected.size(),
+           static_cast<unsigned long long>(dropped));
+    check(collected.size() + dropped == std::uint64_t(threadCount) * perThread && ordered,
+          "concurrent collects lose no event and keep each track in order");
+  }
+
+  {
+    const std::uint64_t droppedBefore = Profiler::GetDroppedCount();
+    for (int i = 0; i < 20000; i++)
+    {
+      PROFILE_SCOPE("overflow");
+    }
+    events.clear();
+    Profiler::Collect(events);
+    const std::uint64_t dropped = Profiler::GetDroppedCount() - droppedBefore;
+    check(events.size() == 16384 && dropped == 20000 - 16384 && CountNamed(events, "overflow") == 16384,
+          "a full ring keeps the oldest events and counts the rest");
+  }
+
+  // A track that is not a thread, fed like the GPU timestamps.
+  Profiler::Ring* gpu = Profiler::AddTrack("GPU", true);
+  Profiler::Record(gpu, "Dispatch rays", 1000, 251000, 0);
+  Profiler::Record(gpu, "Denoise \"a-trous\"\\5", 251000, 300500, 0);
+  {
+    PROFILE_SCOPE("Load C:\\scenes\\cornell.txt");
+  }
+  events.clear();
+  Profiler::Collect(events);
+  const std::vector<Profiler::Track> tracks = Profiler::GetTracks();
+  bool parsed = false;
+  std::size_t complete = 0;
+  std::size_t gpuEvents = 0;
+  bool names = false;
+  bool times = false;
+  try
+  {
+    const nlohmann::json trace = nlohmann::json::parse(Profiler::ToChromeTrace(events, tracks));
+    parsed = true;
+    for (const auto& event : trace.at("traceEvents"))
+    {
+      if (event.at("ph") != "X")
+      {
+        continue;
+      }
+      complete++;
+      if (event.at("cat") == "gpu")
+      {
+        gpuEvents++;
+      }
+      const std::string name = event.at("name");
+      names |= name == "Denoise \"a-trous\"\\5";
+      times |= name == "Dispatch rays" && std::abs(event.at("ts").get<double>() - 1.0) < 1e-9 && std::abs(event.at("dur").get<double>() - 250.0) < 1e-9;
+    }
+  }
+  catch (const std::exception& e)
+  {
+    printf("  %s\n", e.what());
+  }
+  check(parsed && complete == events.size() && complete == 3 && gpuEvents == 2 && names && times,
+        "the chrome trace parses back with names, tracks and microseconds");
+
+  // What a scope costs, recorded and skipped.
+  {
+    const int count = 1000000;
+    events.clear();
+    events.reserve(count);
+    auto Time = [&]() {
+      const auto start = std::chrono::steady_clock::now();
+      for (int i = 0; i < count; i++)
+      {
+        PROFILE_SCOPE("cost");
+        if (i % 8192 == 8191)
+        {
+          Profiler::Collect(events);
+        }
+      }
+      Profiler::Collect(events);
+      return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+    };
+    const double enabled = Time();
+    Profiler::SetEnabled(false);
+    const double disabled = Time();
+    Profiler::SetEnabled(true);
+    printf("  %.1f ns per scope recorded, %.1f ns skipped\n", enabled, disabled);
+    check(CountNamed(events, "cost") == count, "a million scopes are all collected when collected in time");
+  }
+
+  // The phases of a headless render, what cpurender --profile writes out.
+  {
+    SceneCore::SceneData scene;
+    events.clear();
+    if (CpuRender::LoadScene("src/scenes/cornell.txt", scene))
+    {
+      CpuPathTracer::Settings settings;
+      settings.width = 64;
+      settings.height = 64;
+      settings.samples_per_pixel = 1;
+      settings.tile_size = 16;
+      CpuPathTracer::Renderer renderer(scene, settings);
+      renderer.Render();
+    }
+    Profiler::Collect(events);
+    std::map<std::uint32_t, int> tileTracks;
+    for (const Profiler::Event& event : events)
+    {
+      if (std::strcmp(event.name, "Tile") == 0)
+      {
+        tileTracks[event.track]++;
+      }
+    }
+    printf("  cornell: %zu events, tiles on %zu threads\n", events.size(), tileTracks.size());
+    check(CountNamed(events, "Load scene") == 1 && CountNamed(events, "Parse scene") == 1 && CountNamed(events, "Build BVH") == 1 &&
+            CountNamed(events, "Render") == 1 && CountNamed(events, "Tile") == 16 && events.size() > 20,
+          "loading, BVH build and render tiles of cornell are timed");
+  }
+
+  Profiler::SetEnabled(false);
+  return check.Result();
+}
+
+}
@@ -0,0 +1,173 @@
+#include "checks/Checks.h"
+#include "CpuPathTracer.h"
+#include "CpuRenderCommon.h"
+#include "SceneCore.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace Checks {
+
+namespace {
+
+// L2 star discrepancy of points in [0, 1)^2, Warnock's closed form.
+double StarDiscrepancy(const std::vector<glm::dvec2>& points)
+{
+  const double n = static_cast<double>(points.size());
+  double single = 0.0;
+  double pairs = 0.0;
+  for (const auto& a : points)
+  {
+    single += (1.0 - a.x * a.x) * (1.0 - a.y * a.y);
+    for (const auto& b : points)
+    {
+      pairs += (1.0 - std::max(a.x, b.x)) * (1.0 - std::max(a.y, b.y));
+    }
+  }
+  return std::sqrt(std::max(1.0 / 9.0 - single / (2.0 * n) + pairs / (n * n), 0.0));
+}
+
+double Rmse(const std::vector<glm::vec3>& image, const std::vector<glm::vec3>& reference)
+{
+  double sum = 0.0;
+  for (std::size_t i = 0; i < image.size(); i++)
+  {
+    const glm::vec3 d = image[i] - reference[i];
+    sum += glm::dot(d, d) / 3.0;
+  }
+  return std::sqrt(sum / std::max<std::size_t>(image.size(), 1));
+}
+
+// Slope of the least squares line through (log x, log y), -0.5 for plain Monte Carlo.
+double ConvergenceRate(const std::vector<double>& x, const std::vector<double>& y)
+{
+  double sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0;
+  const double n = static_cast<double>(x.size());
+  for (std::size_t i = 0; i < x.size(); i++)
+  {
+    const double lx = std::log(x[i]);
+    const double ly = std::log(std::max(y[i], 1e-12));
+    sx += lx;
+    sy += ly;
+    sxx += lx * lx;
+    sxy += lx * ly;
+  }
+  const double denominator = n * sxx - sx * sx;
+  return denominator != 0.0 ? (n * sxy - sx * sy) / denominator : 0.0;
+}
+
+}
+
+int SamplerChecks(const Options& options)
+{
+  CpuPathTracer::Settings settings = options.settings;
+  if (!options.size_given)
+  {
+    settings.width = 128;
+    settings.height = 72;
+  }
+  if (!options.spp_given)
+  {
+    settings.samples_per_pixel = 1024;
+  }
+  const std::string path = options.GetScenes({ "src/scenes/cornell.txt" })[0];
+
+  // Discrepancy of the first pair of dimensions and of a pair past the first Sobol
+  // set of four, averaged over a few pixels
+  const unsigned int pixelCount = 16;
+  const std::uint32_t pointCounts[] = { 16, 64, 256, 1024 };
+  const std::uint32_t dimensions[] = { 0, 4 };
+
+  printf("L2 star discrepancy, mean of %u pixels\n", pixelCount);
+  printf("  %-6s", "points");
+  for (std::uint32_t sampler = 0; sampler < CpuRender::c_samplerCount; sampler++)
+  {
+    printf(" %11s d0-1 %11s d4-5", CpuRender::c_samplerNames[sampler], CpuRender::c_samplerNames[sampler]);
+  }
+  printf("\n");
+
+  for (std::uint32_t count : pointCounts)
+  {
+    printf("  %-6u", count);
+    for (std::uint32_t sampler = 0; sampler < CpuRender::c_samplerCount; sampler++)
+    {
+      for (std::uint32_t dimension : dimensions)
+      {
+        double mean = 0.0;
+        std::vector<glm::dvec2> points(count);
+        for (unsigned int pixel = 0; pixel < pixelCount; pixel++)
+        {
+          const std::uint32_t x = 37 * pixel + 3;
+          const std::uint32_t y = 11 * pixel + 5;
+          for (std::uint32_t i = 0; i < count; i++)
+          {
+            points[i] = glm::dvec2(Sampling::SampleDimension(sampler, x, y, i, dimension), Sampling::SampleDimension(sampler, x, y, i, dimension + 1));
+          }
+          mean += StarDiscrepancy(points) / pixelCount;
+        }
+        printf(" %16.6f", mean);
+      }
+    }
+    printf("\n");
+  }
+
+  // Convergence of the whole path tracer against a high sample count render
+  SceneCore::SceneData scene;
+  if (!CpuRender::LoadScene(path, scene))
+  {
+    return 1;
+  }
+
+  CpuPathTracer::Settings referenceSettings = settings;
+  referenceSettings.sampler = Sampling::SobolSampler;
+  CpuPathTracer::Renderer reference(scene, referenceSettings);
+  reference.Render();
+  const std::vector<glm::vec3> referenceImage = reference.Resolve();
+  printf("\n%s: %ux%u, reference %u spp sobol, %.1f s\n", path.c_str(), settings.width, settings.height,
+         settings.samples_per_pixel, reference.GetStatistics().render_seconds);
+
+  const unsigned int sampleCounts[] = { 1, 4, 16, 64 };
+  printf("  %-10s", "RMSE");
+  for (unsigned int spp : sampleCounts)
+  {
+    printf(" %8u spp", spp);
+  }
+  printf("   rate\n");
+
+  double randomError = 0.0;
+  for (std::uint32_t sampler = 0; sampler < CpuRender::c_samplerCount; sampler++)
+  {
+    std::vector<double> x;
+    std::vector<double> y;
+    printf("  %-10s", CpuRender::c_samplerNames[sampler]);
+    for (unsigned int spp : sampleCounts)
+    {
+      CpuPathTracer::Settings samplerSettings = settings;
+      samplerSettings.sampler = sampler;
+      samplerSettings.samples_per_pixel = spp;
+      CpuPathTracer::Renderer renderer(scene, samplerSettings);
+      renderer.Render();
+
+      x.push_back(spp);
+      y.push_back(Rmse(renderer.Resolve(), referenceImage));
+      printf(" %12.5f", y.back());
+    }
+    printf("  %5.2f", ConvergenceRate(x, y));
+    if (sampler == Sampling::RandomSampler)
+    {
+      randomError = y.back();
+    }
+    else if (y.back() > 0.0)
+    {
+      printf("  %.2fx less error than random at %u spp", randomError / y.back(), sampleCounts[3]);
+    }
+    printf("\n");
+  }
+  return 0;
+}
+
+}
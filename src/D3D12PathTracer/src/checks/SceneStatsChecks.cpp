@@ -0,0 +1,170 @@
+#include "checks/Checks.h"
+#include "CpuRenderCommon.h"
+#include "DescriptorAllocator.h"
+#include "SceneCore.h"
+#include "SceneStats.h"
+#include "Utilities.h"
+#include "json.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace Checks {
+
+int SceneStatsChecks(const Options&)
+{
+  Log check;
+
+  SceneStats::Bounds cube;
+  cube.Add(glm::vec3(-1.0f));
+  cube.Add(glm::vec3(1.0f));
+  check(Near(cube.SurfaceArea(), 24.0) && Near(cube.Volume(), 8.0) && SceneStats::Bounds().Empty() && SceneStats::Bounds().SurfaceArea() == 0.0,
+        "surface area and volume of a cube, empty bounds have none");
+  const glm::mat4 turned = utilityCore::buildTransformationMatrix(glm::vec3(10.0f, 0.0f, 0.0f), glm::vec3(0.0f, 45.0f, 0.0f), glm::vec3(2.0f));
+  const SceneStats::Bounds moved = SceneStats::Transform(cube, turned);
+  check(Near(moved.max.x - moved.min.x, 4.0 * std::sqrt(2.0)) && Near(moved.max.y, 2.0) && Near(0.5 * (moved.min.x + moved.max.x), 10.0),
+        "transformed bounds hold the rotated, scaled and moved corners");
+
+  SceneStats::Bounds beside;
+  beside.Add(glm::vec3(1.0f, -1.0f, -1.0f));
+  beside.Add(glm::vec3(3.0f, 1.0f, 1.0f));
+  SceneStats::Bounds corner;
+  corner.Add(glm::vec3(1.0f, 1.0f, -1.0f));
+  corner.Add(glm::vec3(3.0f, 3.0f, 1.0f));
+  check(Near(SceneStats::Intersection(cube, beside).SurfaceArea(), 8.0) && SceneStats::Intersection(cube, corner).SurfaceArea() == 0.0,
+        "boxes sharing a face intersect in it, ones sharing an edge don't");
+
+  // Two triangles of a quad, one vertex per corner like LoadObjMesh
+  {
+    std::vector<SceneCore::Vertex> quad(6);
+    const glm::vec3 corners[6] = { { 0, 0, 0 }, { 1, 0, 0 }, { 1, 1, 0 }, { 0, 0, 0 }, { 1, 1, 0 }, { 0, 1, 0 } };
+    for (int i = 0; i < 6; i++)
+    {
+      quad[i].position = corners[i];
+      quad[i].normal = glm::vec3(0.0f, 0.0f, 1.0f);
+      quad[i].uv = glm::vec2(corners[i]);
+    }
+    SceneStats::Model model;
+    SceneStats::CountVertices(quad.data(), quad.size(), sizeof(SceneCore::Vertex), model);
+    check(model.vertices == 6 && model.unique_vertices == 4 && model.unique_positions == 4 && model.DuplicatedVertices() == 2,
+          "the corners of a quad are shared");
+    quad[3].normal = glm::vec3(0.0f, 1.0f, 0.0f);
+    SceneStats::CountVertices(quad.data(), quad.size(), sizeof(SceneCore::Vertex), model);
+    check(model.unique_vertices == 5 && model.unique_positions == 4 && model.bounds.max == glm::vec3(1.0f, 1.0f, 0.0f),
+          "a split normal makes a vertex of its own, not a position");
+
+    // packed positions, the last one has nothing after it to load
+    std::vector<glm::vec3> positions;
+    for (int i = 0; i < 7; i++)
+    {
+      positions.push_back(glm::vec3(float(i), float(-i * i), i == 6 ? 100.0f : 0.5f));
+    }
+    const SceneStats::Bounds packed = SceneStats::ComputeBounds(positions.data(), positions.size(), sizeof(glm::vec3));
+    const SceneStats::Bounds none = SceneStats::ComputeBounds(positions.data(), 0, sizeof(glm::vec3));
+    check(packed.min == glm::vec3(0.0f, -36.0f, 0.5f) && packed.max == glm::vec3(6.0f, 0.0f, 100.0f) && none.Empty(),
+          "bounds of packed and interleaved vertices, none of no vertices");
+  }
+
+  {
+    const SceneStats::ConstantBuffers info = SceneStats::GetConstantBuffers("Info", 10, SceneStats::c_infoBytes);
+    const SceneStats::ConstantBuffers material = SceneStats::GetConstantBuffers("Material", 3, SceneStats::c_materialBytes);
+    check(info.padded_size == 256 && info.wasted_bytes == 1280 && material.padded_size == 256 && material.wasted_bytes == 3 * 204 &&
+          SceneStats::GetConstantBuffers("Big", 1, 300).padded_size == 512, "constant buffers are padded to 256 bytes");
+  }
+
+  // Three objects, the first two overlap by half, the third stands apart
+  {
+    SceneStats::Report report;
+    report.models.push_back({});
+    report.models[0].id = 7;
+    report.models[0].triangles = 12;
+    report.models[0].bounds = cube;
+    for (int i = 0; i < 3; i++)
+    {
+      SceneStats::Object object;
+      object.id = i;
+      object.model = i < 2 ? 7 : -1;
+      object.diffuse_texture = 0;
+      object.normal_texture = i == 0 ? 0 : -1;
+      object.bounds = SceneStats::Transform(cube, utilityCore::buildTransformationMatrix(glm::vec3(i == 2 ? 10.0f : float(i), 0.0f, 0.0f),
+                                                                                          glm::vec3(0.0f), glm::vec3(1.0f)));
+      report.objects.push_back(object);
+    }
+    for (const char* kind : { "diffuse", "normal" })
+    {
+      SceneStats::Texture texture;
+      texture.id = 0;
+      texture.kind = kind;
+      texture.format = "R8G8B8A8_UNORM";
+      texture.mip_bytes = { SceneStats::Rgba8Bytes(4, 4), SceneStats::Rgba8Bytes(2, 2), SceneStats::Rgba8Bytes(1, 1) };
+      texture.bytes = 65536;
+      report.textures.push_back(texture);
+    }
+    SceneStats::Finish(report);
+    check(report.models[0].instances == 2 && report.instanced_triangles == 24 && report.instance_desc_bytes == 3 * 64,
+          "instances of a model are counted");
+    check(report.overlapping_pairs == 1 && report.objects[0].overlaps == 1 && report.objects[2].overlaps == 0 &&
+          Near(report.objects[1].overlap_ratio, 16.0 / 24.0), "the overlap of two objects is found, the third has none");
+    check(Near(report.area_ratio, 72.0 / report.bounds.SurfaceArea()) && Near(report.bounds.max.x, 11.0), "the scene bounds hold all objects");
+    check(report.textures[0].users == 3 && report.textures[1].users == 1 && report.texture_bytes == 2 * 65536 && report.formats.size() == 3 &&
+          report.formats[1].textures == 2 && report.formats[1].bytes == 2 * 16, "texture users and bytes per format and mip");
+  }
+
+  // A scene from its file: the cube of cornell repeats its corners
+  {
+    SceneCore::SceneData scene;
+    if (!CpuRender::LoadScene("src/scenes/cornell.txt", scene))
+    {
+      check(false, "cornell loads");
+      return check.Result();
+    }
+    const SceneStats::Report report = SceneStats::FromSceneData("src/scenes/cornell.txt", scene);
+    std::uint64_t triangles = 0;
+    for (const auto& mesh : scene.meshes)
+    {
+      triangles += mesh.second.indices.size() / 3;
+    }
+    const SceneStats::Model* crate = nullptr;
+    for (const SceneStats::Model& model : report.models)
+    {
+      crate = model.id == 0 ? &model : crate;
+    }
+    check(report.models.size() == scene.meshes.size() && report.triangles == triangles && crate != nullptr &&
+          crate->unique_vertices < crate->vertices && crate->blas.result_bytes > 0, "every model of cornell is there, the crate shares vertices");
+
+    std::uint32_t geometry = 0, objects = 0, materials = 0;
+    for (const SceneStats::Descriptors& range : report.descriptors)
+    {
+      geometry = range.range == DescriptorAllocator::GetRangeName(DescriptorAllocator::RangeGeometry) ? range.allocated : geometry;
+      objects = range.range == DescriptorAllocator::GetRangeName(DescriptorAllocator::RangeObjects) ? range.allocated : objects;
+      materials = range.range == DescriptorAllocator::GetRangeName(DescriptorAllocator::RangeMaterials) ? range.allocated : materials;
+    }
+    check(geometry == 3 * scene.meshes.size() && objects == scene.objects.size() && materials == scene.materials.size() &&
+          report.descriptor_high_water_mark % DescriptorAllocator::Allocator::ChunkSize == 0, "descriptors are those the app takes");
+    check(report.constant_wasted_bytes == scene.objects.size() * (256 - 128) + scene.materials.size() * (256 - 52),
+          "the padding of every info and material is counted");
+
+    bool contained = true;
+    for (std::size_t i = 0; i < scene.objects.size(); i++)
+    {
+      SceneCore::Object object = scene.objects[i];
+      object.UpdateTransforms();
+      const SceneCore::Mesh* mesh = SceneCore::SceneData::Find(scene.meshes, object.mesh);
+      for (std::size_t v = 0; mesh != nullptr && v < mesh->vertices.size(); v += 7)
+      {
+        const glm::vec3 p = glm::vec3(object.transform * glm::vec4(mesh->vertices[v].position, 1.0f));
+        const SceneStats::Bounds& b = report.objects[i].bounds;
+        contained &= glm::all(glm::greaterThanEqual(p, b.min - 1e-3f)) && glm::all(glm::lessThanEqual(p, b.max + 1e-3f));
+      }
+    }
+    check(contained, "object bounds hold their vertices in world space");
+
+    const nlohmann::json json = nlohmann::json::parse(SceneStats::ToJson(std::vector<SceneStats::Report>{ report }));
+    check(json.size() == 1 && json[0].at("models").size() == report.models.size() && json[0].at("objects").size() == report.objects.size() &&
+          json[0].at("totals").at("triangles").get<std::uint64_t>() == report.triangles, "the JSON holds every model and object");
+  }
+  return check.Result();
+}
+
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "Denoiser.h"
+#include "shaders/SamplingHlslCompat.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm/glm.hpp>
+
+namespace Checks {
+
+// Accumulation buffers of a made up scene where every pixel knows its exact color:
+// a checkered back wall, a floor with a soft shadow that no guide shows and a sphere
+// in front, lit by one directional light. Every sample is the exact color times an
+// exponentially distributed factor with mean one, like a path tracer with a lot of
+// variance, the guides are the exact first hits.
+struct SyntheticImage
+{
+  unsigned int width;
+  unsigned int height;
+  std::vector<glm::vec4> color;
+  std::vector<glm::vec3> moments;
+  std::vector<glm::vec4> albedo_depth;
+  std::vector<glm::vec3> normals;
+  std::vector<glm::vec3> reference;
+
+  SyntheticImage(unsigned int width, unsigned int height, unsigned int samples) :
+    width(width),
+    height(height)
+  {
+    const std::size_t pixelCount = static_cast<std::size_t>(width) * height;
+    color.assign(pixelCount, glm::vec4(0.0f));
+    moments.assign(pixelCount, glm::vec3(0.0f));
+    albedo_depth.assign(pixelCount, glm::vec4(0.0f));
+    normals.assign(pixelCount, glm::vec3(0.0f));
+    reference.assign(pixelCount, glm::vec3(0.0f));
+
+    const glm::vec3 light = glm::normalize(glm::vec3(-0.4f, 0.8f, -0.45f));
+    const glm::vec2 sphere(0.5f * width, 0.45f * height);
+    const float radius = 0.22f * height;
+    const float horizon = 0.7f * height;
+    for (unsigned int y = 0; y < height; y++)
+    {
+      for (unsigned int x = 0; x < width; x++)
+      {
+        const std::size_t i = static_cast<std::size_t>(y) * width + x;
+        const glm::vec2 position(x + 0.5f, y + 0.5f);
+        const glm::vec2 fromSphere = (position - sphere) / radius;
+        glm::vec3 normal;
+        glm::vec3 albedo;
+        float depth;
+        float shadow = 1.0f;
+        if (glm::dot(fromSphere, fromSphere) < 1.0f)
+        {
+          normal = glm::vec3(fromSphere.x, -fromSphere.y, -std::sqrt(1.0f - glm::dot(fromSphere, fromSphere)));
+          albedo = glm::vec3(0.9f, 0.3f, 0.2f);
+          depth = 5.0f + 2.0f * normal.z;
+        }
+        else if (position.y > horizon)
+        {
+          normal = glm::vec3(0.0f, 1.0f, 0.0f);
+          albedo = glm::vec3(0.6f);
+          depth = 9.0f - 5.0f * (position.y - horizon) / (height - horizon);
+          const glm::vec2 shadowCenter(0.62f * width, 0.85f * height);
+          const float distance = glm::length((position - shadowCenter) / glm::vec2(0.25f * width, 0.08f * height));
+          shadow = 0.15f + 0.85f * glm::smoothstep(0.8f, 1.2f, distance);
+        }
+        else
+        {
+          normal = glm::vec3(0.0f, 0.0f, -1.0f);
+          const bool checker = ((x / 16) + (y / 16)) % 2 == 0;
+          albedo = checker ? glm::vec3(0.8f) : glm::vec3(0.2f, 0.4f, 0.8f);
+          depth = 10.0f + 0.01f * position.y;
+        }
+
+        const float irradiance = 0.25f + 0.75f * shadow * std::max(glm::dot(normal, light), 0.0f);
+        reference[i] = albedo * irradiance;
+
+        std::uint32_t state = static_cast<std::uint32_t>(i) * 0x9e3779b9u + 1u;
+        for (unsigned int s = 0; s < samples; s++)
+        {
+          state = Sampling::SamplerHash(state);
+          const float u = Sampling::SamplerToFloat(state);
+          const glm::vec3 sample = reference[i] * -std::log(1.0f - u);
+          color[i] += glm::vec4(sample, 1.0f);
+          moments[i] += sample * sample;
+          albedo_depth[i] += glm::vec4(albedo, depth);
+          normals[i] += normal;
+        }
+      }
+    }
+  }
+
+  Denoiser::Input GetInput() const
+  {
+    Denoiser::Input input;
+    input.width = width;
+    input.height = height;
+    input.color = color.data();
+    input.moments = moments.data();
+    input.albedo_depth = albedo_depth.data();
+    input.normals = normals.data();
+    return input;
+  }
+
+  std::vector<glm::vec3> Resolve() const
+  {
+    std::vector<glm::vec3> image(color.size());
+    for (std::size_t i = 0; i < image.size(); i++)
+    {
+      image[i] = glm::vec3(color[i]) / std::max(color[i].w, 1.0f);
+    }
+    return image;
+  }
+};
+
+}
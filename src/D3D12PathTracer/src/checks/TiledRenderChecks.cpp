@@ -0,0 +1,217 @@
+#include "checks/Checks.h"
+#include "TiledRender.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace Checks {
+
+namespace {
+
+bool FileExists(const std::string& path)
+{
+  if (FILE* file = fopen(path.c_str(), "rb"))
+  {
+    fclose(file);
+    return true;
+  }
+  return false;
+}
+
+// The GPU accumulator read back for a tile: rgb sums and the sample count in w, rows
+// rowPitch floats apart like the readback footprint. The sums average to the pixel's
+// coordinates in the full image, so a misplaced tile shows where it went.
+std::vector<float> MakeAccumulation(const TiledRender::Tile& tile, std::size_t rowPitch, float samples)
+{
+  std::vector<float> accumulation(rowPitch * tile.height, -1.0f);
+  for (unsigned int y = 0; y < tile.height; y++)
+  {
+    for (unsigned int x = 0; x < tile.width; x++)
+    {
+      float* pixel = &accumulation[y * rowPitch + x * 4];
+      pixel[0] = static_cast<float>(tile.x + x) * samples;
+      pixel[1] = static_cast<float>(tile.y + y) * samples;
+      pixel[2] = static_cast<float>(tile.index) * samples;
+      pixel[3] = samples;
+    }
+  }
+  return accumulation;
+}
+
+}
+
+int TiledRenderChecks(const Options&)
+{
+  using namespace TiledRender;
+  Log check;
+
+  // Every pixel in exactly one tile, tiles row major, only the last column and row clipped
+  {
+    struct Case { unsigned int width, height, tileWidth, tileHeight; };
+    const Case cases[] = { { 7680, 4320, 512, 512 }, { 1000, 700, 256, 128 }, { 640, 360, 640, 360 }, { 300, 200, 1024, 1024 },
+                           { 97, 31, 16, 8 }, { 5, 3, 1, 1 }, { 64, 64, 0, 0 } };
+    bool covered = true;
+    bool ordered = true;
+    bool clipped = true;
+    for (const Case& c : cases)
+    {
+      const Tiler tiler(c.width, c.height, c.tileWidth, c.tileHeight);
+      const unsigned int tileWidth = c.tileWidth > 0 ? c.tileWidth : 1;
+      const unsigned int tileHeight = c.tileHeight > 0 ? c.tileHeight : 1;
+      std::vector<std::uint8_t> hits(static_cast<std::size_t>(c.width) * c.height, 0);
+      for (unsigned int index = 0; index < tiler.GetTileCount(); index++)
+      {
+        const Tile tile = tiler.GetTile(index);
+        const unsigned int column = index % tiler.GetTilesX();
+        const unsigned int row = index / tiler.GetTilesX();
+        ordered &= tile.index == index && tile.x == column * tileWidth && tile.y == row * tileHeight;
+        const bool lastColumn = column + 1 == tiler.GetTilesX();
+        const bool lastRow = row + 1 == tiler.GetTilesY();
+        clipped &= tile.width == (lastColumn ? c.width - tile.x : tileWidth) && tile.height == (lastRow ? c.height - tile.y : tileHeight);
+        clipped &= tile.width > 0 && tile.height > 0 && tile.x + tile.width <= c.width && tile.y + tile.height <= c.height;
+        for (unsigned int y = tile.y; y < tile.y + tile.height && y < c.height; y++)
+        {
+          for (unsigned int x = tile.x; x < tile.x + tile.width && x < c.width; x++)
+          {
+            hits[static_cast<std::size_t>(y) * c.width + x]++;
+          }
+        }
+      }
+      for (std::uint8_t count : hits)
+      {
+        covered &= count == 1;
+      }
+    }
+    check(covered, "the tiles cover every pixel once");
+    check(ordered, "tiles are row major from the top left");
+    check(clipped, "edge tiles are clipped to the image, the others are whole");
+  }
+
+  // Stitching: padded rows as read back, every pixel lands at its place in the file
+  {
+    const std::string path = "tiled_report.rgba32f";
+    const unsigned int width = 97;
+    const unsigned int height = 31;
+    const Tiler tiler(width, height, 16, 8);
+    DiskFramebuffer framebuffer;
+    bool opened = framebuffer.Open(path, width, height, false);
+    for (unsigned int index = tiler.GetTileCount(); index-- > 0;)
+    {
+      const Tile tile = tiler.GetTile(index);
+      const std::size_t rowPitch = 16 * 4 + 8;
+      const std::vector<float> accumulation = MakeAccumulation(tile, rowPitch, 1.0f);
+      framebuffer.WriteTile(tile, accumulation.data(), rowPitch);
+    }
+
+    bool placed = true;
+    std::vector<float> row(static_cast<std::size_t>(width) * 4);
+    for (unsigned int y = 0; y < height; y++)
+    {
+      framebuffer.ReadRow(y, row.data());
+      for (unsigned int x = 0; x < width; x++)
+      {
+        const unsigned int index = x / 16 + y / 8 * tiler.GetTilesX();
+        placed &= row[x * 4] == static_cast<float>(x) && row[x * 4 + 1] == static_cast<float>(y) &&
+                  row[x * 4 + 2] == static_cast<float>(index) && row[x * 4 + 3] == 1.0f;
+      }
+    }
+    framebuffer.Close();
+    check(opened && placed, "tiles written in any order stitch into place");
+
+    DiskFramebuffer reopened;
+    const bool kept = reopened.Open(path, width, height, true);
+    reopened.ReadRow(height - 1, row.data());
+    reopened.Close();
+    const bool resized = reopened.Open(path, width + 1, height, true);
+    std::vector<float> wider(static_cast<std::size_t>(width + 1) * 4);
+    reopened.ReadRow(height - 1, wider.data());
+    reopened.Close();
+    check(kept && row[(width - 1) * 4] == static_cast<float>(width - 1) && resized && wider[(width - 1) * 4] == 0.0f,
+          "a framebuffer of the right size is kept, another one cleared");
+    std::remove(path.c_str());
+  }
+
+  // A job: tiles clamped to the output, resolved averages, resume after a cancel
+  {
+    Settings settings;
+    settings.width = 100;
+    settings.height = 60;
+    settings.tile_width = 64;
+    settings.tile_height = 64;
+    settings.samples_per_pixel = 16;
+    settings.output_path = "tiled_report.png";
+    const std::string framebufferPath = settings.output_path + ".rgba32f";
+    const std::string manifestPath = settings.output_path + ".manifest";
+    std::remove(framebufferPath.c_str());
+    std::remove(manifestPath.c_str());
+
+    Job job;
+    bool started = job.Start(settings, 32, 24);
+    check(started && job.GetSettings().tile_width == 32 && job.GetSettings().tile_height == 24 && job.GetTileCount() == 12,
+          "tiles are clamped to the raytracing output");
+
+    std::vector<unsigned int> first;
+    for (int i = 0; i < 5 && job.HasNextTile(); i++)
+    {
+      const Tile tile = job.TakeNextTile();
+      const std::vector<float> accumulation = MakeAccumulation(tile, 32 * 4, 16.0f);
+      job.CompleteTile(tile, accumulation.data(), 32 * 4);
+      first.push_back(tile.index);
+    }
+    //taken but never completed, a crash in the middle of the tile
+    job.TakeNextTile();
+    job.Cancel();
+
+    started = job.Start(settings, 32, 24);
+    std::vector<unsigned int> rest;
+    while (started && job.HasNextTile())
+    {
+      const Tile tile = job.TakeNextTile();
+      const std::vector<float> accumulation = MakeAccumulation(tile, 32 * 4, 16.0f);
+      job.CompleteTile(tile, accumulation.data(), 32 * 4);
+      rest.push_back(tile.index);
+    }
+    check(first == std::vector<unsigned int>{ 0, 1, 2, 3, 4 } && !rest.empty() && rest.front() == 5 && rest.size() == 7,
+          "a resumed job renders the unfinished tiles, the lost one again");
+    check(job.IsFinished() && job.GetDoneCount() == 12, "the job finishes once every tile is done");
+
+    {
+      //the sums were 16 samples of the coordinates, the file holds their averages
+      DiskFramebuffer framebuffer;
+      bool resolved = framebuffer.Open(framebufferPath, settings.width, settings.height, true);
+      std::vector<float> row(static_cast<std::size_t>(settings.width) * 4);
+      for (unsigned int y = 0; resolved && y < settings.height; y++)
+      {
+        framebuffer.ReadRow(y, row.data());
+        for (unsigned int x = 0; x < settings.width; x++)
+        {
+          resolved &= row[x * 4] == static_cast<float>(x) && row[x * 4 + 1] == static_cast<float>(y) && row[x * 4 + 3] == 1.0f;
+        }
+      }
+      framebuffer.Close();
+      check(resolved, "the job stitches the averages of the tiles");
+    }
+
+    const bool saved = job.Finish();
+    check(saved && FileExists(settings.output_path) && !FileExists(framebufferPath) && !FileExists(manifestPath),
+          "finishing writes the png and drops the framebuffer and manifest");
+    std::remove(settings.output_path.c_str());
+
+    //a manifest of other settings is not trusted
+    job.Start(settings, 32, 24);
+    job.CompleteTile(job.TakeNextTile(), MakeAccumulation(Tiler(100, 60, 32, 24).GetTile(0), 32 * 4, 1.0f).data(), 32 * 4);
+    job.Cancel();
+    settings.samples_per_pixel = 32;
+    job.Start(settings, 32, 24);
+    check(job.GetDoneCount() == 0 && job.HasNextTile(), "a manifest of other settings starts over");
+    job.Cancel();
+    std::remove(framebufferPath.c_str());
+    std::remove(manifestPath.c_str());
+  }
+
+  return check.Result();
+}
+
+}
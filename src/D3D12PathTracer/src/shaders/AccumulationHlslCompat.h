@@ -0,0 +1,127 @@
+//
+// AccumulationHlslCompat.h - storage formats of the accumulation buffer, shared by Raytracing.hlsl,
+// Denoise.hlsl and the CPU report that measures their error.
+//
+//   Float32 - R32G32B32A32_FLOAT, the sums of all samples with the sample count in w
+//   Half    - R16G16B16A16_FLOAT running mean; what the half rounded off goes into an
+//             R10G10B10A2_UNORM texture in units of the half's spacing, the
+//             compensation term of Kahan summation kept between frames. The pair
+//             holds about 20 bits of mantissa in 12 bytes instead of 16.
+//   Packed  - R11G11B10_FLOAT running mean rounded stochastically, 4 bytes. Unbiased,
+//             but the rounding noise grows with the samples: a preview format.
+//
+// The formats that store a mean keep the sample count in w of the second moment, which
+// is R32G32B32A32_FLOAT in every format; Float32 writes it there too. Every value is
+// rounded here and not by the texture store, so the GPU stores exactly what the CPU
+// computes.
+//
+// Written in the part of the language HLSL and C++ have in common.
+//
+
+#ifndef ACCUMULATIONHLSLCOMPAT_H
+#define ACCUMULATIONHLSLCOMPAT_H
+
+#ifndef HLSL
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace Accumulation {
+
+typedef std::uint32_t uint;
+using std::floor;
+
+inline uint asuint(float value)
+{
+  uint bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+inline float asfloat(uint bits)
+{
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+#endif
+
+enum AccumulationFormat
+{
+  AccumulationFloat32 = 0,
+  AccumulationHalf = 1,
+  AccumulationPacked = 2,
+  AccumulationFormatCount = 3,
+};
+
+static const uint ACCUMULATION_HALF_MANTISSA_BITS = 10;
+static const float ACCUMULATION_HALF_MAX = 65504.0f;
+
+// R11G11B10: red and green have 6 mantissa bits, blue 5
+static const uint ACCUMULATION_PACKED_MANTISSA_BITS_RG = 6;
+static const uint ACCUMULATION_PACKED_MANTISSA_BITS_B = 5;
+static const float ACCUMULATION_PACKED_MAX_RG = 65024.0f;
+static const float ACCUMULATION_PACKED_MAX_B = 64512.0f;
+
+static const float ACCUMULATION_UNORM10_MAX = 1023.0f;
+
+// Spacing of the floats with mantissaBits around a value >= 0. All three small float
+// formats share the exponent range of half, below 2^-14 they are subnormal and the
+// spacing stays that of 2^-14.
+inline float AccumulationSpacing(float value, uint mantissaBits)
+{
+  uint exponent = asuint(value) >> 23;
+  exponent = exponent > 113u ? exponent : 113u; // 127 - 14
+  return asfloat((exponent - mantissaBits) << 23);
+}
+
+// value >= 0 on the grid of a float with mantissaBits: offset 0.5 rounds to nearest,
+// a uniform random offset rounds up with the probability of the remainder, which keeps
+// the expected value. The result is representable, the texture store does not round it.
+inline float AccumulationRound(float value, uint mantissaBits, float maxValue, float offset)
+{
+  value = value < maxValue ? value : maxValue;
+  value = value > 0.0f ? value : 0.0f;
+  float spacing = AccumulationSpacing(value, mantissaBits);
+  float rounded = floor(value / spacing + offset) * spacing;
+  return rounded < maxValue ? rounded : maxValue;
+}
+
+// The half of Half, rounded to nearest.
+inline float AccumulationEncodeHalf(float mean)
+{
+  return AccumulationRound(mean, ACCUMULATION_HALF_MANTISSA_BITS, ACCUMULATION_HALF_MAX, 0.5f);
+}
+
+// What rounding to half took off, in [-0.5, 0.5] half spacings, moved to [0, 1] and
+// rounded to what the UNORM store keeps.
+inline float AccumulationEncodeCompensation(float mean, float high)
+{
+  float residual = (mean - high) / AccumulationSpacing(high, ACCUMULATION_HALF_MANTISSA_BITS) + 0.5f;
+  residual = residual > 0.0f ? (residual < 1.0f ? residual : 1.0f) : 0.0f;
+  return floor(residual * ACCUMULATION_UNORM10_MAX + 0.5f) / ACCUMULATION_UNORM10_MAX;
+}
+
+inline float AccumulationDecodeHalf(float high, float compensation)
+{
+  return high + (compensation - 0.5f) * AccumulationSpacing(high, ACCUMULATION_HALF_MANTISSA_BITS);
+}
+
+// One channel of Packed, offset as in AccumulationRound.
+inline float AccumulationEncodePacked(float mean, uint channel, float offset)
+{
+  return channel < 2 ? AccumulationRound(mean, ACCUMULATION_PACKED_MANTISSA_BITS_RG, ACCUMULATION_PACKED_MAX_RG, offset)
+                     : AccumulationRound(mean, ACCUMULATION_PACKED_MANTISSA_BITS_B, ACCUMULATION_PACKED_MAX_B, offset);
+}
+
+// Bytes per pixel of the accumulation, the compensation included.
+inline uint AccumulationBytesPerPixel(uint format)
+{
+  return format == AccumulationHalf ? 12 : (format == AccumulationPacked ? 4 : 16);
+}
+
+#ifndef HLSL
+}
+#endif
+
+#endif // ACCUMULATIONHLSLCOMPAT_H
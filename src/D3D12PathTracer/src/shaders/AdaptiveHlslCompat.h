@@ -0,0 +1,40 @@
+//
+// AdaptiveHlslCompat.h - the error adaptive sampling retires tiles by, shared by the raygen
+// shader, which reports the worst pixel of every dispatched tile, and AdaptiveSampler, the
+// CPU reference of that report.
+//
+// Written in the part of the language HLSL and C++ have in common.
+//
+
+#ifndef ADAPTIVEHLSLCOMPAT_H
+#define ADAPTIVEHLSLCOMPAT_H
+
+#ifndef HLSL
+#include <cmath>
+
+namespace Adaptive {
+
+using std::sqrt;
+#endif
+
+// Side length in pixels of a tile of the adaptive work list.
+#define ADAPTIVE_TILE_SIZE (16)
+// Keeps dark pixels from dominating the relative error.
+#define ADAPTIVE_ERROR_EPSILON (0.001f)
+// Reported for pixels that don't have enough samples yet.
+#define ADAPTIVE_UNCONVERGED_ERROR (1.0e30f)
+
+// Relative standard error of the running mean of one color channel.
+inline float ComputeRelativeError(float sum, float sumSquared, float sampleCount)
+{
+  float mean = sum / sampleCount;
+  float variance = sumSquared / sampleCount - mean * mean;
+  variance = variance > 0.0f ? variance : 0.0f;
+  return sqrt(variance / sampleCount) / (mean + ADAPTIVE_ERROR_EPSILON);
+}
+
+#ifndef HLSL
+}
+#endif
+
+#endif // ADAPTIVEHLSLCOMPAT_H
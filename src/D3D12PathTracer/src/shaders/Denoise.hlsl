@@ -0,0 +1,244 @@
+//
+// Denoise.hlsl - SVGF a-trous filter over the accumulation buffer, run after the path tracer.
+//
+// One compute shader for all passes, DenoiseConstantBuffer::pass picks which:
+//   prepare  - averages the sums of the raygen shader, divides the albedo out and
+//              stores the guides and the variance of the mean
+//   variance - pixels with too few samples take the variance of their neighbourhood
+//   a-trous  - one iteration each, ping-ponging between the two filter buffers; the
+//              last one multiplies the albedo back in and writes the output
+//   resolve  - not part of the filter: writes the accumulation as Float32 sums into
+//              filter buffer 0, for readbacks of the Half and Packed formats
+// Same passes and weights as the CPU version in Denoiser.cpp.
+//
+
+#ifndef DENOISE_HLSL
+#define DENOISE_HLSL
+
+#define HLSL
+#include "DenoiseHlslCompat.h"
+#include "AccumulationHlslCompat.h"
+
+ConstantBuffer<DenoiseConstantBuffer> g_denoiseCB : register(b0);
+
+RWTexture2D<float4> Output : register(u0);
+RWTexture2D<float4> Accumulation : register(u1); // see AccumulationHlslCompat.h
+RWTexture2D<float4> SecondMoment : register(u2); // sums of squares, sample count in w
+RWTexture2D<float4> AlbedoDepth : register(u3);
+RWTexture2D<float4> NormalSum : register(u4);
+RWTexture2D<float4> Features : register(u5); // octahedral normal, depth, depth gradient
+RWTexture2D<float4> FilterBuffers[2] : register(u6); // illumination, luminance variance
+RWTexture2D<float4> Compensation : register(u8);
+
+float2 OctWrap(float2 v)
+{
+	return (1.0f - abs(v.yx)) * (v.xy >= 0.0f ? 1.0f : -1.0f);
+}
+
+float2 EncodeNormal(float3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	n.xy = n.z >= 0.0f ? n.xy : OctWrap(n.xy);
+	return n.xy;
+}
+
+float3 DecodeNormal(float2 e)
+{
+	float3 n = float3(e.x, e.y, 1.0f - abs(e.x) - abs(e.y));
+	float t = saturate(-n.z);
+	n.xy += n.xy >= 0.0f ? -t : t;
+	return normalize(n);
+}
+
+bool InImage(int2 p)
+{
+	return p.x >= 0 && p.y >= 0 && p.x < (int)g_denoiseCB.width && p.y < (int)g_denoiseCB.height;
+}
+
+float SampleCount(int2 p)
+{
+	return SecondMoment[p].w;
+}
+
+float3 AccumulatedMean(int2 p, float samples)
+{
+	float4 stored = Accumulation[p];
+	if (g_denoiseCB.accumulation_format == AccumulationHalf) {
+		float3 compensation = Compensation[p].rgb;
+		return float3(AccumulationDecodeHalf(stored.r, compensation.r), AccumulationDecodeHalf(stored.g, compensation.g),
+			AccumulationDecodeHalf(stored.b, compensation.b));
+	}
+	if (g_denoiseCB.accumulation_format == AccumulationPacked) {
+		return stored.rgb;
+	}
+	return stored.rgb / max(samples, 1.0f);
+}
+
+float AverageDepth(int2 p)
+{
+	float samples = SampleCount(p);
+	return samples > 0.0f ? AlbedoDepth[p].w / samples : 0.0f;
+}
+
+float3 AverageAlbedo(uint2 p)
+{
+	float3 albedo = AlbedoDepth[p].rgb / max(SampleCount(p), 1.0f);
+	return float3(DenoiseAlbedo(albedo.r), DenoiseAlbedo(albedo.g), DenoiseAlbedo(albedo.b));
+}
+
+// Depth change per pixel along one axis, the smaller side so silhouettes do not count.
+float AxisGradient(int2 p, int2 axis, float depth)
+{
+	float gradient = 1e30f;
+	if (InImage(p - axis)) {
+		gradient = min(gradient, abs(depth - AverageDepth(p - axis)));
+	}
+	if (InImage(p + axis)) {
+		gradient = min(gradient, abs(AverageDepth(p + axis) - depth));
+	}
+	return gradient < 1e30f ? gradient : 0.0f;
+}
+
+float TapWeight(float kernel, float cosine, float edgeDistance)
+{
+	return kernel * exp2(g_denoiseCB.sigma_normal * log2(max(cosine, DENOISE_MIN_COSINE)) - DENOISE_LOG2_E * edgeDistance);
+}
+
+void Prepare(int2 p)
+{
+	float samples = SampleCount(p);
+	if (samples <= 0.0f) {
+		Features[p] = float4(0, 0, 0, 0);
+		FilterBuffers[0][p] = float4(0, 0, 0, 0);
+		return;
+	}
+
+	float inverse = 1.0f / samples;
+	float3 mean = AccumulatedMean(p, samples);
+	float3 albedo = AverageAlbedo(p);
+	float depth = AlbedoDepth[p].w * inverse;
+	float3 normal = NormalSum[p].xyz;
+	float2 encoded = dot(normal, normal) > 0.0f ? EncodeNormal(normalize(normal)) : float2(0, 0);
+	float gradient = max(AxisGradient(p, int2(1, 0), depth), AxisGradient(p, int2(0, 1), depth));
+
+	// variance of the mean, the channels taken as fully correlated
+	float variance = -1.0f;
+	if (samples >= DENOISE_TEMPORAL_MIN_SAMPLES) {
+		float3 deviation = sqrt(max(SecondMoment[p].rgb * inverse - mean * mean, 0.0f) * inverse) / albedo;
+		float luminanceDeviation = DenoiseLuminance(deviation.r, deviation.g, deviation.b);
+		variance = luminanceDeviation * luminanceDeviation;
+	}
+
+	Features[p] = float4(encoded, depth, gradient);
+	FilterBuffers[0][p] = float4(mean / albedo, variance);
+}
+
+// Luminance variance of the neighbourhood on the same surface.
+void SpatialVariance(int2 p)
+{
+	float4 center = FilterBuffers[0][p];
+	if (center.w >= 0.0f) {
+		FilterBuffers[1][p] = center;
+		return;
+	}
+
+	float4 features = Features[p];
+	float3 normal = DecodeNormal(features.xy);
+	int radius = (int)DENOISE_VARIANCE_RADIUS;
+	float sumWeight = 0.0f;
+	float sumLuminance = 0.0f;
+	float sumSquares = 0.0f;
+	for (int dy = -radius; dy <= radius; dy++) {
+		for (int dx = -radius; dx <= radius; dx++) {
+			int2 q = p + int2(dx, dy);
+			if (!InImage(q)) {
+				continue;
+			}
+			float4 tapFeatures = Features[q];
+			float edgeDistance = DenoiseEdgeDistance(features.z, tapFeatures.z, features.w, length(float2(dx, dy)), 0.0f, 0.0f, 1.0f, g_denoiseCB.sigma_depth, 1.0f);
+			float weight = (dx == 0 && dy == 0) ? 1.0f : TapWeight(1.0f, dot(normal, DecodeNormal(tapFeatures.xy)), edgeDistance);
+			float3 tap = FilterBuffers[0][q].rgb;
+			float luminance = DenoiseLuminance(tap.r, tap.g, tap.b);
+			sumWeight += weight;
+			sumLuminance += weight * luminance;
+			sumSquares += weight * luminance * luminance;
+		}
+	}
+	float mean = sumLuminance / sumWeight;
+	FilterBuffers[1][p] = float4(center.rgb, max(sumSquares / sumWeight - mean * mean, 0.0f));
+}
+
+void Atrous(int2 p)
+{
+	uint source = g_denoiseCB.source;
+	int step = (int)g_denoiseCB.step;
+	float4 center = FilterBuffers[source][p];
+	float4 features = Features[p];
+	float3 normal = DecodeNormal(features.xy);
+	float luminance = DenoiseLuminance(center.r, center.g, center.b);
+
+	// prefiltered standard deviation the taps are judged by
+	float sum = 0.0f;
+	float sumKernel = 0.0f;
+	for (int vy = -1; vy <= 1; vy++) {
+		for (int vx = -1; vx <= 1; vx++) {
+			int2 q = p + int2(vx, vy);
+			if (InImage(q)) {
+				float kernel = c_varianceKernel[abs(vx)] * c_varianceKernel[abs(vy)];
+				sum += kernel * FilterBuffers[source][q].w;
+				sumKernel += kernel;
+			}
+		}
+	}
+	float deviation = sqrt(sum / sumKernel);
+
+	// the center tap always has an edge weight of one
+	float sumWeight = c_atrousKernel[0] * c_atrousKernel[0];
+	float4 sumColor = float4(center.rgb * sumWeight, center.w * sumWeight * sumWeight);
+	for (int dy = -2; dy <= 2; dy++) {
+		for (int dx = -2; dx <= 2; dx++) {
+			int2 q = p + int2(dx, dy) * step;
+			if ((dx == 0 && dy == 0) || !InImage(q)) {
+				continue;
+			}
+			float4 tap = FilterBuffers[source][q];
+			float4 tapFeatures = Features[q];
+			float edgeDistance = DenoiseEdgeDistance(features.z, tapFeatures.z, features.w, step * length(float2(dx, dy)),
+				luminance, DenoiseLuminance(tap.r, tap.g, tap.b), deviation, g_denoiseCB.sigma_depth, g_denoiseCB.sigma_luminance);
+			float weight = TapWeight(c_atrousKernel[abs(dx)] * c_atrousKernel[abs(dy)], dot(normal, DecodeNormal(tapFeatures.xy)), edgeDistance);
+			sumWeight += weight;
+			sumColor += float4(tap.rgb * weight, tap.w * weight * weight);
+		}
+	}
+
+	float4 filtered = float4(sumColor.rgb / sumWeight, sumColor.w / (sumWeight * sumWeight));
+	FilterBuffers[source ^ 1][p] = filtered;
+	if (g_denoiseCB.last) {
+		Output[p] = float4(clamp(filtered.rgb * AverageAlbedo(p), 0, 1), 0.0f);
+	}
+}
+
+[numthreads(DENOISE_THREAD_GROUP_SIZE, DENOISE_THREAD_GROUP_SIZE, 1)]
+void main(uint3 id : SV_DispatchThreadID)
+{
+	int2 p = int2(id.xy);
+	if (!InImage(p)) {
+		return;
+	}
+
+	if (g_denoiseCB.pass == DenoisePassPrepare) {
+		Prepare(p);
+	}
+	else if (g_denoiseCB.pass == DenoisePassVariance) {
+		SpatialVariance(p);
+	}
+	else if (g_denoiseCB.pass == DenoisePassAtrous) {
+		Atrous(p);
+	}
+	else {
+		float samples = SampleCount(p);
+		FilterBuffers[0][p] = float4(AccumulatedMean(p, samples) * samples, samples);
+	}
+}
+
+#endif // DENOISE_HLSL
@@ -0,0 +1,105 @@
+//
+// DenoiseHlslCompat.h - the edge-aware a-trous filter shared by Denoise.hlsl and the CPU denoiser.
+//
+// Spatiotemporal variance guided filtering after Schied et al., "Spatiotemporal
+// Variance-Guided Filtering: Real-Time Reconstruction for Path-Traced Global
+// Illumination" (HPG 2017), on the accumulation buffer of a still camera:
+//  - the color of the first hit is divided by its albedo, the filter smooths the
+//    illumination and multiplies the albedo back in, so textures stay sharp
+//  - the variance of every pixel comes from its accumulated moments, the samples of
+//    all iterations since the last reset; pixels with fewer than
+//    DENOISE_TEMPORAL_MIN_SAMPLES estimate it from their neighbours instead
+//  - every a-trous iteration spreads a 5x5 B3 spline kernel twice as far and weighs
+//    each tap by how close its depth, normal and illumination are to the center,
+//    the illumination relative to the standard deviation the center expects
+//
+// Written in the part of the language HLSL and C++ have in common.
+//
+
+#ifndef DENOISEHLSLCOMPAT_H
+#define DENOISEHLSLCOMPAT_H
+
+#ifndef HLSL
+#include <cmath>
+#include <cstdint>
+
+namespace Denoiser {
+
+typedef std::uint32_t uint;
+using std::abs;
+#endif
+
+enum DenoisePass
+{
+  DenoisePassPrepare = 0, // demodulated illumination, temporal variance and the guides
+  DenoisePassVariance = 1, // spatial variance where there are too few samples
+  DenoisePassAtrous = 2, // one a-trous iteration
+  DenoisePassResolve = 3, // Float32 sums of the accumulation into filter buffer 0
+};
+
+// Root constants of Denoise.hlsl.
+struct DenoiseConstantBuffer
+{
+  uint width;
+  uint height;
+  uint pass; // DenoisePass
+  uint step; // a-trous tap spacing in pixels
+  uint source; // filter buffer the pass reads, the other one is written
+  uint last; // the last a-trous iteration writes the remodulated color to the output
+  float sigma_luminance;
+  float sigma_normal;
+  float sigma_depth;
+  uint accumulation_format; // AccumulationFormat in AccumulationHlslCompat.h
+};
+
+static const uint DENOISE_MAX_ITERATIONS = 5;
+static const uint DENOISE_TEMPORAL_MIN_SAMPLES = 4;
+static const uint DENOISE_VARIANCE_RADIUS = 3; // 7x7 spatial variance estimate
+static const uint DENOISE_THREAD_GROUP_SIZE = 8;
+
+static const float DENOISE_DEFAULT_SIGMA_LUMINANCE = 4.0f;
+static const float DENOISE_DEFAULT_SIGMA_NORMAL = 128.0f;
+static const float DENOISE_DEFAULT_SIGMA_DEPTH = 1.0f;
+
+// Below this an albedo channel is taken as black and not divided out.
+static const float DENOISE_MIN_ALBEDO = 0.001f;
+
+// B3 spline by distance from the center tap, the 5x5 kernel is the outer product.
+static const float c_atrousKernel[3] = { 0.375f, 0.25f, 0.0625f };
+
+// 3x3 gaussian by distance from the center, prefilters the variance the taps are judged by.
+static const float c_varianceKernel[2] = { 0.5f, 0.25f };
+
+inline float DenoiseLuminance(float r, float g, float b)
+{
+  return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+}
+
+// What the illumination of an albedo channel is divided and multiplied by.
+inline float DenoiseAlbedo(float albedo)
+{
+  return albedo > DENOISE_MIN_ALBEDO ? albedo : 1.0f;
+}
+
+// How far a tap is from the center in depth and illumination, the weight falls off
+// with exp(-distance). depthGradient is how much the depth of the center changes per
+// pixel, pixels how far away the tap is on screen.
+inline float DenoiseEdgeDistance(float depthCenter, float depthTap, float depthGradient, float pixels,
+  float luminanceCenter, float luminanceTap, float standardDeviation, float sigmaDepth, float sigmaLuminance)
+{
+  float depthTerm = abs(depthCenter - depthTap) / (sigmaDepth * depthGradient * pixels + 1e-4f);
+  float luminanceTerm = abs(luminanceCenter - luminanceTap) / (sigmaLuminance * standardDeviation + 1e-4f);
+  return depthTerm + luminanceTerm;
+}
+
+// The whole edge stopping weight is one exp2: sigma_normal * log2(cosine) of the normal
+// weight pow(cosine, sigma_normal) minus the edge distance in powers of two. Normals at
+// right angles or facing away get the cosine of DENOISE_MIN_COSINE, a weight of nothing.
+static const float DENOISE_MIN_COSINE = 1e-8f;
+static const float DENOISE_LOG2_E = 1.44269504f;
+
+#ifndef HLSL
+}
+#endif
+
+#endif // DENOISEHLSLCOMPAT_H
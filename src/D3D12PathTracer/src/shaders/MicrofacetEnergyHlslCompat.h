@@ -0,0 +1,274 @@
+//
+// MicrofacetEnergyHlslCompat.h - directional albedo of the GGX lobe of MicrofacetHlslCompat.h,
+// generated by cpu_render --microfacet-lut, do not edit.
+//
+// A and B of E = F0 A + B, interleaved, on a 32 x 32 grid from 0 to 1: the cosine of wo
+// along a row, the roughness down the rows. 8192 visible normal samples per entry.
+//
+
+#ifndef MICROFACETENERGYHLSLCOMPAT_H
+#define MICROFACETENERGYHLSLCOMPAT_H
+
+static const uint MICROFACET_ENERGY_SIZE = 32;
+
+static const float c_microfacetEnergy[2048] =
+{
+  0.010817f, 0.941864f, 0.151314f, 0.848647f, 0.283600f, 0.716391f, 0.398876f, 0.601120f,
+  0.498816f, 0.501182f, 0.585000f, 0.414999f, 0.658899f, 0.341100f, 0.721874f, 0.278125f,
+  0.775185f, 0.224814f, 0.819988f, 0.180011f, 0.857346f, 0.142654f, 0.888227f, 0.111773f,
+  0.913512f, 0.086488f, 0.933999f, 0.066001f, 0.950405f, 0.049595f, 0.963374f, 0.036626f,
+  0.973475f, 0.026525f, 0.981214f, 0.018786f, 0.987031f, 0.012969f, 0.991308f, 0.008692f,
+  0.994375f, 0.005626f, 0.996507f, 0.003493f, 0.997937f, 0.002063f, 0.998855f, 0.001145f,
+  0.999413f, 0.000587f, 0.999728f, 0.000272f, 0.999891f, 0.000109f, 0.999964f, 0.000036f,
+  0.999992f, 0.000008f, 0.999999f, 0.000001f, 1.000000f, 0.000000f, 1.000000f, 0.000000f,
+  0.026643f, 0.953844f, 0.151811f, 0.847789f, 0.283816f, 0.716119f, 0.398993f, 0.600978f,
+  0.498886f, 0.501098f, 0.585043f, 0.414947f, 0.658925f, 0.341068f, 0.721890f, 0.278105f,
+  0.775194f, 0.224802f, 0.819993f, 0.180004f, 0.857347f, 0.142650f, 0.888226f, 0.111772f,
+  0.913510f, 0.086488f, 0.933997f, 0.066002f, 0.950403f, 0.049596f, 0.963371f, 0.036628f,
+  0.973473f, 0.026526f, 0.981212f, 0.018787f, 0.987029f, 0.012970f, 0.991307f, 0.008693f,
+  0.994373f, 0.005626f, 0.996506f, 0.003494f, 0.997937f, 0.002063f, 0.998855f, 0.001145f,
+  0.999413f, 0.000587f, 0.999728f, 0.000272f, 0.999891f, 0.000109f, 0.999964f, 0.000036f,
+  0.999991f, 0.000008f, 0.999999f, 0.000001f, 1.000000f, 0.000000f, 1.000000f, 0.000000f,
+  0.083681f, 0.911355f, 0.157677f, 0.832420f, 0.286452f, 0.711316f, 0.400417f, 0.598539f,
+  0.499766f, 0.499838f, 0.585555f, 0.414157f, 0.659204f, 0.340562f, 0.722072f, 0.277844f,
+  0.775283f, 0.224655f, 0.820022f, 0.179930f, 0.857338f, 0.142624f, 0.888194f, 0.111775f,
+  0.913466f, 0.086509f, 0.933947f, 0.066032f, 0.950353f, 0.049630f, 0.963325f, 0.036661f,
+  0.973431f, 0.026557f, 0.981175f, 0.018815f, 0.986998f, 0.012993f, 0.991282f, 0.008711f,
+  0.994353f, 0.005641f, 0.996491f, 0.003504f, 0.997925f, 0.002071f, 0.998846f, 0.001150f,
+  0.999407f, 0.000591f, 0.999724f, 0.000274f, 0.999888f, 0.000110f, 0.999962f, 0.000036f,
+  0.999990f, 0.000009f, 0.999998f, 0.000001f, 1.000000f, 0.000000f, 1.000000f, 0.000000f,
+  0.152982f, 0.844817f, 0.175142f, 0.779534f, 0.294341f, 0.692936f, 0.404827f, 0.589675f,
+  0.502326f, 0.494762f, 0.587042f, 0.411104f, 0.659975f, 0.338627f, 0.722355f, 0.276599f,
+  0.775339f, 0.223955f, 0.819927f, 0.179567f, 0.857111f, 0.142447f, 0.887882f, 0.111717f,
+  0.913104f, 0.086525f, 0.933560f, 0.066091f, 0.949959f, 0.049710f, 0.963022f, 0.036775f,
+  0.973149f, 0.026666f, 0.980914f, 0.018912f, 0.986757f, 0.013077f, 0.991061f, 0.008780f,
+  0.994152f, 0.005695f, 0.996306f, 0.003545f, 0.997756f, 0.002100f, 0.998689f, 0.001171f,
+  0.999259f, 0.000604f, 0.999584f, 0.000282f, 0.999754f, 0.000115f, 0.999832f, 0.000039f,
+  0.999863f, 0.000010f, 0.999873f, 0.000002f, 0.999876f, 0.000000f, 0.999878f, 0.000000f,
+  0.227154f, 0.771605f, 0.210241f, 0.700873f, 0.309809f, 0.652537f, 0.413350f, 0.568774f,
+  0.507237f, 0.482607f, 0.589852f, 0.403708f, 0.661501f, 0.334076f, 0.723066f, 0.273815f,
+  0.775383f, 0.222175f, 0.819584f, 0.178511f, 0.856501f, 0.141856f, 0.887138f, 0.111452f,
+  0.912285f, 0.086464f, 0.932760f, 0.066173f, 0.949283f, 0.049896f, 0.962299f, 0.036959f,
+  0.972485f, 0.026857f, 0.980343f, 0.019099f, 0.986241f, 0.013241f, 0.990592f, 0.008916f,
+  0.993725f, 0.005804f, 0.995917f, 0.003629f, 0.997398f, 0.002162f, 0.998359f, 0.001214f,
+  0.998951f, 0.000632f, 0.999305f, 0.000300f, 0.999581f, 0.000129f, 0.999680f, 0.000046f,
+  0.999722f, 0.000014f, 0.999739f, 0.000003f, 0.999747f, 0.000001f, 0.999751f, 0.000000f,
+  0.301727f, 0.697470f, 0.263903f, 0.627730f, 0.335366f, 0.593710f, 0.426768f, 0.532634f,
+  0.514733f, 0.460677f, 0.593970f, 0.390059f, 0.663423f, 0.325317f, 0.723548f, 0.268173f,
+  0.774982f, 0.218647f, 0.818548f, 0.176327f, 0.855256f, 0.140703f, 0.885742f, 0.110923f,
+  0.910762f, 0.086299f, 0.931225f, 0.066247f, 0.947765f, 0.050101f, 0.960866f, 0.037235f,
+  0.971096f, 0.027142f, 0.979038f, 0.019375f, 0.985028f, 0.013489f, 0.989474f, 0.009130f,
+  0.992746f, 0.005985f, 0.995070f, 0.003776f, 0.996661f, 0.002275f, 0.997687f, 0.001295f,
+  0.998360f, 0.000690f, 0.998792f, 0.000338f, 0.999022f, 0.000149f, 0.999139f, 0.000057f,
+  0.999198f, 0.000019f, 0.999228f, 0.000006f, 0.999246f, 0.000002f, 0.999259f, 0.000000f,
+  0.373893f, 0.625537f, 0.329403f, 0.564425f, 0.372694f, 0.530155f, 0.446791f, 0.484901f,
+  0.525372f, 0.428197f, 0.599285f, 0.368478f, 0.665579f, 0.311125f, 0.723716f, 0.258894f,
+  0.773846f, 0.212623f, 0.816633f, 0.172556f, 0.852817f, 0.138416f, 0.882998f, 0.109638f,
+  0.908017f, 0.085747f, 0.928412f, 0.066099f, 0.944955f, 0.050199f, 0.958300f, 0.037524f,
+  0.968794f, 0.027523f, 0.976878f, 0.019755f, 0.983092f, 0.013854f, 0.987760f, 0.009457f,
+  0.991202f, 0.006259f, 0.993659f, 0.003994f, 0.995363f, 0.002440f, 0.996488f, 0.001414f,
+  0.997253f, 0.000772f, 0.997740f, 0.000391f, 0.998017f, 0.000181f, 0.998172f, 0.000075f,
+  0.998260f, 0.000027f, 0.998383f, 0.000010f, 0.998452f, 0.000004f, 0.998494f, 0.000001f,
+  0.441923f, 0.557642f, 0.398497f, 0.506446f, 0.419782f, 0.470477f, 0.474571f, 0.433116f,
+  0.540466f, 0.388561f, 0.606562f, 0.339897f, 0.668069f, 0.291159f, 0.723196f, 0.245166f,
+  0.771522f, 0.203433f, 0.813206f, 0.166550f, 0.848779f, 0.134649f, 0.878649f, 0.107407f,
+  0.903503f, 0.084531f, 0.924044f, 0.065622f, 0.940808f, 0.050185f, 0.954266f, 0.037739f,
+  0.965023f, 0.027884f, 0.973351f, 0.020167f, 0.979799f, 0.014262f, 0.984719f, 0.009832f,
+  0.988360f, 0.006578f, 0.991089f, 0.004261f, 0.993014f, 0.002650f, 0.994309f, 0.001570f,
+  0.995176f, 0.000879f, 0.995812f, 0.000463f, 0.996214f, 0.000226f, 0.996586f, 0.000104f,
+  0.996828f, 0.000044f, 0.996980f, 0.000018f, 0.997083f, 0.000007f, 0.997184f, 0.000002f,
+  0.504824f, 0.494822f, 0.465458f, 0.451892f, 0.472120f, 0.416568f, 0.509220f, 0.383064f,
+  0.560859f, 0.346535f, 0.616899f, 0.307040f, 0.671760f, 0.266702f, 0.722566f, 0.227505f,
+  0.768154f, 0.191016f, 0.808173f, 0.158063f, 0.842670f, 0.128960f, 0.872032f, 0.103787f,
+  0.896759f, 0.082397f, 0.917412f, 0.064518f, 0.934385f, 0.049751f, 0.948155f, 0.037737f,
+  0.959168f, 0.028109f, 0.967972f, 0.020547f, 0.974844f, 0.014693f, 0.980146f, 0.010254f,
+  0.984181f, 0.006962f, 0.987238f, 0.004584f, 0.989452f, 0.002908f, 0.991031f, 0.001768f,
+  0.992162f, 0.001024f, 0.992997f, 0.000562f, 0.993588f, 0.000290f, 0.993998f, 0.000139f,
+  0.994354f, 0.000063f, 0.994656f, 0.000027f, 0.994867f, 0.000011f, 0.995070f, 0.000003f,
+  0.562120f, 0.437575f, 0.527289f, 0.400915f, 0.525144f, 0.367962f, 0.548056f, 0.337215f,
+  0.586003f, 0.305913f, 0.630951f, 0.273234f, 0.677570f, 0.239902f, 0.722601f, 0.207088f,
+  0.764307f, 0.175960f, 0.801799f, 0.147267f, 0.834814f, 0.121498f, 0.863400f, 0.098835f,
+  0.887818f, 0.079278f, 0.908402f, 0.062676f, 0.925534f, 0.048801f, 0.939611f, 0.037384f,
+  0.951107f, 0.028156f, 0.960414f, 0.020821f, 0.967800f, 0.015077f, 0.973620f, 0.010672f,
+  0.978095f, 0.007355f, 0.981570f, 0.004929f, 0.984214f, 0.003196f, 0.986187f, 0.001995f,
+  0.987643f, 0.001192f, 0.988751f, 0.000679f, 0.989583f, 0.000367f, 0.990286f, 0.000188f,
+  0.990805f, 0.000090f, 0.991211f, 0.000040f, 0.991541f, 0.000016f, 0.991879f, 0.000005f,
+  0.613697f, 0.386025f, 0.582699f, 0.354041f, 0.575629f, 0.324098f, 0.588082f, 0.295995f,
+  0.614204f, 0.268418f, 0.648328f, 0.240691f, 0.686037f, 0.212880f, 0.724257f, 0.185540f,
+  0.760944f, 0.159293f, 0.794946f, 0.134785f, 0.825661f, 0.112441f, 0.852837f, 0.092481f,
+  0.876474f, 0.074985f, 0.896791f, 0.059939f, 0.913994f, 0.047193f, 0.928401f, 0.036576f,
+  0.940345f, 0.027877f, 0.950176f, 0.020873f, 0.958137f, 0.015321f, 0.964502f, 0.011000f,
+  0.969545f, 0.007706f, 0.973553f, 0.005259f, 0.976691f, 0.003481f, 0.979149f, 0.002228f,
+  0.981107f, 0.001374f, 0.982589f, 0.000810f, 0.983766f, 0.000455f, 0.984724f, 0.000242f,
+  0.985528f, 0.000122f, 0.986175f, 0.000057f, 0.986728f, 0.000023f, 0.987254f, 0.000007f,
+  0.659683f, 0.340052f, 0.631465f, 0.311668f, 0.621587f, 0.284697f, 0.626707f, 0.259268f,
+  0.643385f, 0.234784f, 0.667888f, 0.210794f, 0.696923f, 0.187228f, 0.727862f, 0.164257f,
+  0.758815f, 0.142220f, 0.788534f, 0.121526f, 0.816132f, 0.102415f, 0.841194f, 0.085137f,
+  0.863520f, 0.069797f, 0.883122f, 0.056424f, 0.900065f, 0.044942f, 0.914548f, 0.035251f,
+  0.926795f, 0.027204f, 0.937043f, 0.020632f, 0.945572f, 0.015360f, 0.952541f, 0.011197f,
+  0.958224f, 0.007979f, 0.962854f, 0.005547f, 0.966598f, 0.003750f, 0.969623f, 0.002457f,
+  0.972075f, 0.001555f, 0.974043f, 0.000945f, 0.975696f, 0.000550f, 0.977040f, 0.000304f,
+  0.978178f, 0.000158f, 0.979137f, 0.000076f, 0.980016f, 0.000032f, 0.980774f, 0.000010f,
+  0.700366f, 0.299371f, 0.673804f, 0.273799f, 0.662213f, 0.249587f, 0.662219f, 0.226713f,
+  0.671648f, 0.204940f, 0.688103f, 0.183973f, 0.709280f, 0.163724f, 0.733149f, 0.144240f,
+  0.758097f, 0.125656f, 0.782913f, 0.108160f, 0.806745f, 0.091951f, 0.829059f, 0.077198f,
+  0.849458f, 0.063954f, 0.867788f, 0.052262f, 0.884045f, 0.042113f, 0.898243f, 0.033429f,
+  0.910548f, 0.026130f, 0.921100f, 0.020088f, 0.930034f, 0.015164f, 0.937577f, 0.011228f,
+  0.943870f, 0.008136f, 0.949122f, 0.005758f, 0.953524f, 0.003973f, 0.957198f, 0.002664f,
+  0.960238f, 0.001728f, 0.962751f, 0.001078f, 0.964906f, 0.000646f, 0.966719f, 0.000368f,
+  0.968282f, 0.000197f, 0.969667f, 0.000097f, 0.970879f, 0.000042f, 0.971969f, 0.000013f,
+  0.736129f, 0.263602f, 0.710141f, 0.240337f, 0.697319f, 0.218565f, 0.693619f, 0.198050f,
+  0.697559f, 0.178683f, 0.707574f, 0.160258f, 0.722037f, 0.142722f, 0.739485f, 0.126043f,
+  0.758651f, 0.110262f, 0.778478f, 0.095455f, 0.798194f, 0.081731f, 0.817197f, 0.069161f,
+  0.835070f, 0.057807f, 0.851594f, 0.047710f, 0.866632f, 0.038859f, 0.880125f, 0.031208f,
+  0.892077f, 0.024690f, 0.902574f, 0.019226f, 0.911707f, 0.014717f, 0.919619f, 0.011062f,
+  0.926431f, 0.008150f, 0.932255f, 0.005872f, 0.937211f, 0.004127f, 0.941470f, 0.002823f,
+  0.945130f, 0.001874f, 0.948266f, 0.001200f, 0.950962f, 0.000737f, 0.953316f, 0.000432f,
+  0.955373f, 0.000237f, 0.957210f, 0.000120f, 0.958852f, 0.000053f, 0.960338f, 0.000017f,
+  0.767404f, 0.232313f, 0.741076f, 0.210977f, 0.727040f, 0.191306f, 0.720555f, 0.172924f,
+  0.720316f, 0.155690f, 0.725190f, 0.139457f, 0.734102f, 0.124186f, 0.745965f, 0.109802f,
+  0.759796f, 0.096289f, 0.774806f, 0.083686f, 0.790298f, 0.072023f, 0.805761f, 0.061347f,
+  0.820784f, 0.051680f, 0.835080f, 0.043030f, 0.848424f, 0.035381f, 0.860709f, 0.028710f,
+  0.871885f, 0.022972f, 0.881960f, 0.018109f, 0.890971f, 0.014049f, 0.898953f, 0.010710f,
+  0.906016f, 0.008012f, 0.912202f, 0.005868f, 0.917644f, 0.004201f, 0.922395f, 0.002929f,
+  0.926564f, 0.001983f, 0.930248f, 0.001298f, 0.933518f, 0.000817f, 0.936422f, 0.000490f,
+  0.939002f, 0.000276f, 0.941340f, 0.000143f, 0.943454f, 0.000064f, 0.945386f, 0.000021f,
+  0.794642f, 0.205056f, 0.767166f, 0.185362f, 0.751791f, 0.167514f, 0.743009f, 0.151025f,
+  0.739487f, 0.135684f, 0.740265f, 0.121350f, 0.744581f, 0.107950f, 0.751709f, 0.095485f,
+  0.760870f, 0.083848f, 0.771464f, 0.073070f, 0.782951f, 0.063138f, 0.794862f, 0.054051f,
+  0.806820f, 0.045811f, 0.818539f, 0.038413f, 0.829819f, 0.031845f, 0.840509f, 0.026083f,
+  0.850487f, 0.021083f, 0.859721f, 0.016805f, 0.868206f, 0.013196f, 0.875924f, 0.010191f,
+  0.882915f, 0.007732f, 0.889217f, 0.005750f, 0.894889f, 0.004184f, 0.899979f, 0.002970f,
+  0.904579f, 0.002051f, 0.908716f, 0.001371f, 0.912433f, 0.000881f, 0.915814f, 0.000541f,
+  0.918882f, 0.000312f, 0.921704f, 0.000165f, 0.924284f, 0.000076f, 0.926668f, 0.000025f,
+  0.818285f, 0.181387f, 0.788989f, 0.163117f, 0.772085f, 0.146902f, 0.761230f, 0.132044f,
+  0.754918f, 0.118311f, 0.752383f, 0.105617f, 0.752974f, 0.093858f, 0.756124f, 0.082992f,
+  0.761230f, 0.072912f, 0.767890f, 0.063643f, 0.775657f, 0.055141f, 0.784153f, 0.047382f,
+  0.793035f, 0.040349f, 0.802077f, 0.034030f, 0.811069f, 0.028405f, 0.819850f, 0.023446f,
+  0.828310f, 0.019122f, 0.836344f, 0.015392f, 0.843915f, 0.012216f, 0.850991f, 0.009547f,
+  0.857574f, 0.007336f, 0.863656f, 0.005533f, 0.869273f, 0.004088f, 0.874448f, 0.002949f,
+  0.879223f, 0.002073f, 0.883599f, 0.001411f, 0.887637f, 0.000925f, 0.891374f, 0.000579f,
+  0.894831f, 0.000341f, 0.898042f, 0.000185f, 0.901040f, 0.000087f, 0.903843f, 0.000030f,
+  0.838757f, 0.160886f, 0.807043f, 0.143854f, 0.788352f, 0.129019f, 0.775488f, 0.115602f,
+  0.766759f, 0.103291f, 0.761454f, 0.092028f, 0.758899f, 0.081660f, 0.758668f, 0.072128f,
+  0.760344f, 0.063377f, 0.763559f, 0.055361f, 0.767959f, 0.048046f, 0.773250f, 0.041383f,
+  0.779181f, 0.035363f, 0.785576f, 0.029967f, 0.792192f, 0.025154f, 0.798888f, 0.020897f,
+  0.805557f, 0.017170f, 0.812107f, 0.013939f, 0.818461f, 0.011167f, 0.824571f, 0.008819f,
+  0.830400f, 0.006855f, 0.835936f, 0.005235f, 0.841180f, 0.003921f, 0.846122f, 0.002871f,
+  0.850790f, 0.002049f, 0.855170f, 0.001419f, 0.859295f, 0.000948f, 0.863183f, 0.000605f,
+  0.866855f, 0.000364f, 0.870325f, 0.000201f, 0.873609f, 0.000096f, 0.876722f, 0.000034f,
+  0.856449f, 0.143160f, 0.821802f, 0.127182f, 0.801107f, 0.113577f, 0.786168f, 0.101385f,
+  0.775263f, 0.090353f, 0.767453f, 0.080295f, 0.762211f, 0.071118f, 0.759126f, 0.062741f,
+  0.757810f, 0.055098f, 0.757997f, 0.048131f, 0.759435f, 0.041811f, 0.761847f, 0.036079f,
+  0.765044f, 0.030914f, 0.768854f, 0.026286f, 0.773095f, 0.022159f, 0.777651f, 0.018507f,
+  0.782395f, 0.015299f, 0.787254f, 0.012508f, 0.792150f, 0.010103f, 0.797004f, 0.008051f,
+  0.801783f, 0.006321f, 0.806455f, 0.004881f, 0.811005f, 0.003700f, 0.815415f, 0.002745f,
+  0.819675f, 0.001988f, 0.823774f, 0.001398f, 0.827715f, 0.000949f, 0.831510f, 0.000616f,
+  0.835160f, 0.000378f, 0.838670f, 0.000213f, 0.842051f, 0.000104f, 0.845311f, 0.000038f,
+  0.871719f, 0.127852f, 0.833693f, 0.112790f, 0.810736f, 0.100247f, 0.793692f, 0.089133f,
+  0.780635f, 0.079189f, 0.770568f, 0.070187f, 0.762936f, 0.062036f, 0.757309f, 0.054640f,
+  0.753435f, 0.047944f, 0.750983f, 0.041866f, 0.749760f, 0.036374f, 0.749577f, 0.031420f,
+  0.750254f, 0.026970f, 0.751628f, 0.022988f, 0.753591f, 0.019442f, 0.756015f, 0.016305f,
+  0.758803f, 0.013547f, 0.761865f, 0.011141f, 0.765124f, 0.009059f, 0.768537f, 0.007275f,
+  0.772038f, 0.005762f, 0.775601f, 0.004492f, 0.779191f, 0.003441f, 0.782769f, 0.002584f,
+  0.786327f, 0.001895f, 0.789850f, 0.001351f, 0.793322f, 0.000931f, 0.796748f, 0.000615f,
+  0.800110f, 0.000383f, 0.803417f, 0.000220f, 0.806656f, 0.000110f, 0.809829f, 0.000041f,
+  0.884889f, 0.114641f, 0.843114f, 0.100371f, 0.817653f, 0.088744f, 0.798420f, 0.078594f,
+  0.783202f, 0.069562f, 0.771004f, 0.061487f, 0.761153f, 0.054211f, 0.753302f, 0.047670f,
+  0.747079f, 0.041760f, 0.742301f, 0.036443f, 0.738706f, 0.031653f, 0.736180f, 0.027353f,
+  0.734565f, 0.023506f, 0.733708f, 0.020068f, 0.733505f, 0.017014f, 0.733872f, 0.014314f,
+  0.734723f, 0.011941f, 0.735941f, 0.009865f, 0.737508f, 0.008067f, 0.739351f, 0.006520f,
+  0.741424f, 0.005202f, 0.743679f, 0.004090f, 0.746081f, 0.003162f, 0.748602f, 0.002399f,
+  0.751209f, 0.001779f, 0.753882f, 0.001284f, 0.756616f, 0.000897f, 0.759399f, 0.000602f,
+  0.762212f, 0.000381f, 0.765041f, 0.000223f, 0.767874f, 0.000114f, 0.770713f, 0.000044f,
+  0.896243f, 0.103242f, 0.850372f, 0.089634f, 0.822196f, 0.078815f, 0.800659f, 0.069498f,
+  0.783297f, 0.061283f, 0.768975f, 0.053986f, 0.757070f, 0.047483f, 0.747116f, 0.041658f,
+  0.738785f, 0.036436f, 0.731874f, 0.031756f, 0.726179f, 0.027568f, 0.721522f, 0.023819f,
+  0.717808f, 0.020477f, 0.714888f, 0.017500f, 0.712666f, 0.014862f, 0.711103f, 0.012534f,
+  0.710059f, 0.010486f, 0.709500f, 0.008698f, 0.709362f, 0.007144f, 0.709588f, 0.005805f,
+  0.710129f, 0.004660f, 0.710950f, 0.003689f, 0.712012f, 0.002875f, 0.713302f, 0.002200f,
+  0.714774f, 0.001648f, 0.716402f, 0.001203f, 0.718173f, 0.000851f, 0.720070f, 0.000579f,
+  0.722070f, 0.000372f, 0.724157f, 0.000222f, 0.726336f, 0.000116f, 0.728584f, 0.000046f,
+  0.906032f, 0.093407f, 0.855755f, 0.080352f, 0.824701f, 0.070235f, 0.800729f, 0.061637f,
+  0.781153f, 0.054134f, 0.764775f, 0.047535f, 0.750855f, 0.041685f, 0.738901f, 0.036477f,
+  0.728634f, 0.031850f, 0.719768f, 0.027716f, 0.712107f, 0.024032f, 0.705530f, 0.020756f,
+  0.699889f, 0.017841f, 0.695084f, 0.015257f, 0.691020f, 0.012971f, 0.687619f, 0.010956f,
+  0.684788f, 0.009187f, 0.682499f, 0.007642f, 0.680702f, 0.006300f, 0.679317f, 0.005141f,
+  0.678318f, 0.004148f, 0.677651f, 0.003303f, 0.677319f, 0.002592f, 0.677259f, 0.001999f,
+  0.677451f, 0.001510f, 0.677876f, 0.001114f, 0.678512f, 0.000796f, 0.679340f, 0.000548f,
+  0.680335f, 0.000358f, 0.681492f, 0.000217f, 0.682783f, 0.000115f, 0.684202f, 0.000047f,
+  0.914476f, 0.084923f, 0.859527f, 0.072330f, 0.825435f, 0.062829f, 0.798921f, 0.054853f,
+  0.777100f, 0.047973f, 0.758626f, 0.041962f, 0.742719f, 0.036685f, 0.728877f, 0.032026f,
+  0.716722f, 0.027889f, 0.706027f, 0.024228f, 0.696587f, 0.020984f, 0.688225f, 0.018102f,
+  0.680815f, 0.015555f, 0.674266f, 0.013301f, 0.668477f, 0.011314f, 0.663380f, 0.009567f,
+  0.658904f, 0.008035f, 0.654984f, 0.006699f, 0.651564f, 0.005537f, 0.648629f, 0.004535f,
+  0.646130f, 0.003674f, 0.643996f, 0.002940f, 0.642226f, 0.002320f, 0.640785f, 0.001801f,
+  0.639650f, 0.001371f, 0.638789f, 0.001020f, 0.638188f, 0.000737f, 0.637822f, 0.000512f,
+  0.637677f, 0.000339f, 0.637739f, 0.000208f, 0.637992f, 0.000113f, 0.638407f, 0.000048f,
+  0.921763f, 0.077593f, 0.861905f, 0.065386f, 0.824611f, 0.056406f, 0.795459f, 0.048974f,
+  0.771338f, 0.042643f, 0.750766f, 0.037156f, 0.732896f, 0.032369f, 0.717193f, 0.028173f,
+  0.703259f, 0.024478f, 0.690834f, 0.021221f, 0.679698f, 0.018346f, 0.669664f, 0.015810f,
+  0.660634f, 0.013573f, 0.652463f, 0.011602f, 0.645104f, 0.009870f, 0.638421f, 0.008349f,
+  0.632413f, 0.007020f, 0.626973f, 0.005861f, 0.622068f, 0.004856f, 0.617654f, 0.003987f,
+  0.613701f, 0.003242f, 0.610158f, 0.002605f, 0.607002f, 0.002066f, 0.604195f, 0.001612f,
+  0.601735f, 0.001235f, 0.599576f, 0.000926f, 0.597701f, 0.000674f, 0.596098f, 0.000474f,
+  0.594755f, 0.000317f, 0.593643f, 0.000198f, 0.592742f, 0.000110f, 0.592055f, 0.000047f,
+  0.928057f, 0.071253f, 0.863058f, 0.059354f, 0.822435f, 0.050819f, 0.790569f, 0.043865f,
+  0.764114f, 0.038018f, 0.741418f, 0.032992f, 0.721607f, 0.028640f, 0.704072f, 0.024846f,
+  0.688417f, 0.021531f, 0.674323f, 0.018622f, 0.661573f, 0.016067f, 0.650003f, 0.013826f,
+  0.639434f, 0.011856f, 0.629791f, 0.010127f, 0.620951f, 0.008612f, 0.612850f, 0.007286f,
+  0.605400f, 0.006130f, 0.598570f, 0.005123f, 0.592286f, 0.004251f, 0.586503f, 0.003498f,
+  0.581208f, 0.002851f, 0.576334f, 0.002299f, 0.571864f, 0.001830f, 0.567774f, 0.001435f,
+  0.564036f, 0.001106f, 0.560628f, 0.000834f, 0.557516f, 0.000612f, 0.554687f, 0.000434f,
+  0.552142f, 0.000294f, 0.549851f, 0.000185f, 0.547790f, 0.000105f, 0.545959f, 0.000047f,
+  0.933501f, 0.065761f, 0.863157f, 0.054096f, 0.819101f, 0.045961f, 0.784463f, 0.039430f,
+  0.755601f, 0.033994f, 0.730800f, 0.029380f, 0.709034f, 0.025403f, 0.689715f, 0.021964f,
+  0.672384f, 0.018980f, 0.656689f, 0.016372f, 0.642421f, 0.014099f, 0.629369f, 0.012109f,
+  0.617399f, 0.010368f, 0.606371f, 0.008849f, 0.596175f, 0.007520f, 0.586760f, 0.006360f,
+  0.578012f, 0.005352f, 0.569900f, 0.004476f, 0.562351f, 0.003718f, 0.555347f, 0.003064f,
+  0.548817f, 0.002503f, 0.542722f, 0.002023f, 0.537063f, 0.001616f, 0.531791f, 0.001272f,
+  0.526861f, 0.000985f, 0.522283f, 0.000747f, 0.518019f, 0.000552f, 0.514045f, 0.000394f,
+  0.510379f, 0.000269f, 0.506956f, 0.000172f, 0.503784f, 0.000099f, 0.500847f, 0.000045f,
+  0.938214f, 0.060998f, 0.862337f, 0.049498f, 0.814760f, 0.041721f, 0.777301f, 0.035571f,
+  0.746012f, 0.030497f, 0.719076f, 0.026235f, 0.695398f, 0.022595f, 0.674321f, 0.019470f,
+  0.655339f, 0.016767f, 0.638119f, 0.014427f, 0.622408f, 0.012394f, 0.607964f, 0.010622f,
+  0.594669f, 0.009081f, 0.582356f, 0.007739f, 0.570931f, 0.006572f, 0.560305f, 0.005556f,
+  0.550389f, 0.004673f, 0.541122f, 0.003910f, 0.532457f, 0.003250f, 0.524333f, 0.002681f,
+  0.516702f, 0.002193f, 0.509540f, 0.001776f, 0.502796f, 0.001423f, 0.496460f, 0.001124f,
+  0.490498f, 0.000874f, 0.484879f, 0.000666f, 0.479584f, 0.000495f, 0.474593f, 0.000356f,
+  0.469884f, 0.000245f, 0.465446f, 0.000159f, 0.461273f, 0.000092f, 0.457329f, 0.000043f,
+  0.942300f, 0.056859f, 0.860715f, 0.045466f, 0.809546f, 0.038010f, 0.769222f, 0.032192f,
+  0.735500f, 0.027442f, 0.706430f, 0.023488f, 0.680848f, 0.020146f, 0.658058f, 0.017298f,
+  0.637482f, 0.014846f, 0.618799f, 0.012737f, 0.601700f, 0.010915f, 0.585971f, 0.009335f,
+  0.571428f, 0.007965f, 0.557945f, 0.006778f, 0.545393f, 0.005749f, 0.533681f, 0.004856f,
+  0.522715f, 0.004084f, 0.512415f, 0.003415f, 0.502750f, 0.002839f, 0.493656f, 0.002345f,
+  0.485063f, 0.001920f, 0.476959f, 0.001558f, 0.469297f, 0.001250f, 0.462046f, 0.000990f,
+  0.455180f, 0.000772f, 0.448663f, 0.000591f, 0.442478f, 0.000442f, 0.436615f, 0.000320f,
+  0.431036f, 0.000222f, 0.425730f, 0.000145f, 0.420685f, 0.000086f, 0.415883f, 0.000041f,
+  0.945848f, 0.053256f, 0.858413f, 0.041932f, 0.803580f, 0.034746f, 0.760361f, 0.029224f,
+  0.724213f, 0.024771f, 0.693028f, 0.021095f, 0.665584f, 0.018010f, 0.641090f, 0.015405f,
+  0.618996f, 0.013172f, 0.598905f, 0.011268f, 0.580494f, 0.009629f, 0.563559f, 0.008218f,
+  0.547871f, 0.006996f, 0.533327f, 0.005945f, 0.519742f, 0.005034f, 0.507050f, 0.004249f,
+  0.495150f, 0.003570f, 0.483956f, 0.002984f, 0.473434f, 0.002482f, 0.463484f, 0.002050f,
+  0.454091f, 0.001680f, 0.445191f, 0.001365f, 0.436749f, 0.001097f, 0.428738f, 0.000871f,
+  0.421110f, 0.000681f, 0.413870f, 0.000523f, 0.406958f, 0.000393f, 0.400379f, 0.000286f,
+  0.394089f, 0.000200f, 0.388080f, 0.000132f, 0.382353f, 0.000079f, 0.376854f, 0.000039f,
+  0.948932f, 0.050114f, 0.855520f, 0.038820f, 0.796971f, 0.031867f, 0.750837f, 0.026610f,
+  0.712256f, 0.022417f, 0.678987f, 0.018992f, 0.649718f, 0.016141f, 0.623604f, 0.013750f,
+  0.600036f, 0.011717f, 0.578599f, 0.009987f, 0.558992f, 0.008515f, 0.540911f, 0.007247f,
+  0.524194f, 0.006156f, 0.508639f, 0.005219f, 0.494173f, 0.004415f, 0.480610f, 0.003721f,
+  0.467899f, 0.003124f, 0.455930f, 0.002610f, 0.444657f, 0.002170f, 0.434019f, 0.001792f,
+  0.423946f, 0.001470f, 0.414391f, 0.001195f, 0.405328f, 0.000962f, 0.396702f, 0.000765f,
+  0.388496f, 0.000600f, 0.380668f, 0.000462f, 0.373209f, 0.000348f, 0.366067f, 0.000255f,
+  0.359259f, 0.000179f, 0.352720f, 0.000119f, 0.346461f, 0.000072f, 0.340462f, 0.000036f,
+  0.951619f, 0.047368f, 0.852113f, 0.036075f, 0.789802f, 0.029324f, 0.740753f, 0.024298f,
+  0.699772f, 0.020347f, 0.664463f, 0.017147f, 0.633395f, 0.014497f, 0.605709f, 0.012298f,
+  0.580764f, 0.010444f, 0.558052f, 0.008868f, 0.537304f, 0.007537f, 0.518213f, 0.006401f,
+  0.500506f, 0.005423f, 0.484129f, 0.004592f, 0.468809f, 0.003875f, 0.454526f, 0.003262f,
+  0.441079f, 0.002734f, 0.428513f, 0.002286f, 0.416614f, 0.001898f, 0.405404f, 0.001568f,
+  0.394773f, 0.001285f, 0.384723f, 0.001046f, 0.375172f, 0.000843f, 0.366093f, 0.000671f,
+  0.357446f, 0.000527f, 0.349214f, 0.000408f, 0.341343f, 0.000308f, 0.333830f, 0.000226f,
+  0.326633f, 0.000160f, 0.319748f, 0.000107f, 0.313153f, 0.000065f, 0.306819f, 0.000034f,
+};
+
+#endif // MICROFACETENERGYHLSLCOMPAT_H
@@ -0,0 +1,299 @@
+//
+// MicrofacetHlslCompat.h - the metal/roughness BSDF, shared by Raytracing.hlsl and the CPU
+// renderer, whose --microfacet-report checks it numerically.
+//
+// A GGX specular lobe over a Lambertian one:
+//
+//   D        - GGX (Trowbridge-Reitz) with alpha = roughness^2
+//   G        - Smith, height correlated (Heitz, "Understanding the Masking-Shadowing
+//              Function in Microfacet-Based BRDFs", JCGT 2014)
+//   F        - Schlick, F0 = lerp(0.04, base color, metallic)
+//   Sampling - the visible normals (Heitz, "Sampling the GGX Distribution of Visible
+//              Normals", JCGT 2018); the pdf of a reflected direction is
+//              G1(wo) D(wm) / (4 wo.z)
+//
+// A single scattering microfacet lobe loses the energy that bounces between microfacets
+// more than once, rough metals come out too dark. The directional albedo of the lobe
+// for F = 1 and for the Schlick weight alone, E = F0 A + B, is tabulated over the cosine
+// and the roughness in MicrofacetEnergyHlslCompat.h; the specular lobe is scaled by
+// 1 + F0 (1 / (A + B) - 1) (Turquin, "Practical multiple scattering compensation for
+// microfacet models", 2019) and the diffuse lobe gets what the dielectric specular lobe
+// leaves, 1 - E(0.04). A white metal and a white dielectric then reflect everything.
+//
+// Directions are in the frame of the shading normal, z up. Written in the part of the
+// language HLSL and C++ have in common.
+//
+
+#ifndef MICROFACETHLSLCOMPAT_H
+#define MICROFACETHLSLCOMPAT_H
+
+#ifndef HLSL
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace Microfacet {
+
+typedef std::uint32_t uint;
+using std::cos;
+using std::max;
+using std::min;
+using std::sin;
+using std::sqrt;
+
+struct float3
+{
+  float x, y, z;
+  float3() : x(0.0f), y(0.0f), z(0.0f) {}
+  float3(float x, float y, float z) : x(x), y(y), z(z) {}
+};
+
+inline float3 operator+(const float3& a, const float3& b) { return float3(a.x + b.x, a.y + b.y, a.z + b.z); }
+inline float3 operator-(const float3& a, const float3& b) { return float3(a.x - b.x, a.y - b.y, a.z - b.z); }
+inline float3 operator*(const float3& a, const float3& b) { return float3(a.x * b.x, a.y * b.y, a.z * b.z); }
+inline float3 operator*(const float3& a, float s) { return float3(a.x * s, a.y * s, a.z * s); }
+inline float3 operator*(float s, const float3& a) { return a * s; }
+inline float dot(const float3& a, const float3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline float3 cross(const float3& a, const float3& b) { return float3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x); }
+inline float3 normalize(const float3& a) { return a * (1.0f / sqrt(dot(a, a))); }
+inline float3 lerp(const float3& a, const float3& b, float t) { return a + (b - a) * t; }
+#endif
+
+#include "MicrofacetEnergyHlslCompat.h"
+
+static const float MICROFACET_PI = 3.14159265358979f;
+static const float MICROFACET_DIELECTRIC_F0 = 0.04f;
+
+// Below this the lobe is too narrow for float, a smoother surface is a mirror.
+static const float MICROFACET_MIN_ROUGHNESS = 0.02f;
+
+inline float MicrofacetClamp(float value, float low, float high)
+{
+  return value < low ? low : (value > high ? high : value);
+}
+
+inline float MicrofacetLuminance(float3 color)
+{
+  return dot(color, float3(0.2126f, 0.7152f, 0.0722f));
+}
+
+inline float MicrofacetAlpha(float roughness)
+{
+  float r = MicrofacetClamp(roughness, MICROFACET_MIN_ROUGHNESS, 1.0f);
+  return r * r;
+}
+
+inline float3 MicrofacetF0(float3 base, float metallic)
+{
+  return lerp(float3(MICROFACET_DIELECTRIC_F0, MICROFACET_DIELECTRIC_F0, MICROFACET_DIELECTRIC_F0), base, MicrofacetClamp(metallic, 0.0f, 1.0f));
+}
+
+inline float MicrofacetD(float alpha, float cosThetaM)
+{
+  float a2 = alpha * alpha;
+  float d = cosThetaM * cosThetaM * (a2 - 1.0f) + 1.0f;
+  return cosThetaM > 0.0f ? a2 / (MICROFACET_PI * d * d) : 0.0f;
+}
+
+inline float MicrofacetLambda(float alpha, float cosTheta)
+{
+  float c2 = cosTheta * cosTheta;
+  float tan2 = max(1.0f - c2, 0.0f) / max(c2, 1e-12f);
+  return 0.5f * (sqrt(1.0f + alpha * alpha * tan2) - 1.0f);
+}
+
+inline float MicrofacetG1(float alpha, float cosTheta)
+{
+  return 1.0f / (1.0f + MicrofacetLambda(alpha, cosTheta));
+}
+
+inline float MicrofacetG2(float alpha, float cosThetaO, float cosThetaI)
+{
+  return 1.0f / (1.0f + MicrofacetLambda(alpha, cosThetaO) + MicrofacetLambda(alpha, cosThetaI));
+}
+
+// (1 - cos)^5, F = F0 + (1 - F0) times this.
+inline float MicrofacetSchlickWeight(float cosTheta)
+{
+  float m = MicrofacetClamp(1.0f - cosTheta, 0.0f, 1.0f);
+  float m2 = m * m;
+  return m2 * m2 * m;
+}
+
+// A normal of the visible part of the microsurface seen from wo, u0 and u1 in [0, 1).
+inline float3 MicrofacetSampleVisibleNormal(float3 wo, float alpha, float u0, float u1)
+{
+  // stretch to the hemisphere configuration
+  float3 vh = normalize(float3(alpha * wo.x, alpha * wo.y, wo.z));
+  float lensq = vh.x * vh.x + vh.y * vh.y;
+  float3 t1 = lensq > 0.0f ? float3(-vh.y, vh.x, 0.0f) * (1.0f / sqrt(lensq)) : float3(1.0f, 0.0f, 0.0f);
+  float3 t2 = cross(vh, t1);
+
+  // a point on the projected disk, the half hidden behind the hemisphere squashed away
+  float r = sqrt(u0);
+  float phi = 2.0f * MICROFACET_PI * u1;
+  float p1 = r * cos(phi);
+  float p2 = r * sin(phi);
+  float s = 0.5f * (1.0f + vh.z);
+  p2 = (1.0f - s) * sqrt(max(1.0f - p1 * p1, 0.0f)) + s * p2;
+
+  float3 nh = p1 * t1 + p2 * t2 + sqrt(max(1.0f - p1 * p1 - p2 * p2, 0.0f)) * vh;
+  return normalize(float3(alpha * nh.x, alpha * nh.y, max(nh.z, 0.0f)));
+}
+
+// Density of the direction wo reflects into about a visible normal.
+inline float MicrofacetVisibleNormalPdf(float3 wo, float3 wi, float alpha)
+{
+  if (wo.z <= 0.0f || wi.z <= 0.0f)
+  {
+    return 0.0f;
+  }
+  float3 wm = normalize(wo + wi);
+  return MicrofacetG1(alpha, wo.z) * MicrofacetD(alpha, wm.z) / (4.0f * wo.z);
+}
+
+// A or B of the table at the cosine of wo, bilinear.
+inline float MicrofacetEnergyLookup(float cosTheta, float roughness, uint term)
+{
+  float last = (float)(MICROFACET_ENERGY_SIZE - 1);
+  float x = MicrofacetClamp(cosTheta, 0.0f, 1.0f) * last;
+  float y = MicrofacetClamp(roughness, 0.0f, 1.0f) * last;
+  uint x0 = (uint)x;
+  uint y0 = (uint)y;
+  uint x1 = min(x0 + 1, MICROFACET_ENERGY_SIZE - 1);
+  uint y1 = min(y0 + 1, MICROFACET_ENERGY_SIZE - 1);
+  float fx = x - (float)x0;
+  float fy = y - (float)y0;
+
+  float e00 = c_microfacetEnergy[2 * (y0 * MICROFACET_ENERGY_SIZE + x0) + term];
+  float e10 = c_microfacetEnergy[2 * (y0 * MICROFACET_ENERGY_SIZE + x1) + term];
+  float e01 = c_microfacetEnergy[2 * (y1 * MICROFACET_ENERGY_SIZE + x0) + term];
+  float e11 = c_microfacetEnergy[2 * (y1 * MICROFACET_ENERGY_SIZE + x1) + term];
+  return (e00 + (e10 - e00) * fx) * (1.0f - fy) + (e01 + (e11 - e01) * fx) * fy;
+}
+
+// The compensated directional albedo of the specular lobe for one channel of F0.
+inline float MicrofacetSpecularAlbedo(float f0, float cosTheta, float roughness)
+{
+  float a = MicrofacetEnergyLookup(cosTheta, roughness, 0);
+  float b = MicrofacetEnergyLookup(cosTheta, roughness, 1);
+  return (f0 * a + b) * (1.0f + f0 * (1.0f / max(a + b, 1e-4f) - 1.0f));
+}
+
+// How often MicrofacetSample picks the specular lobe: its share of the albedo.
+inline float MicrofacetSpecularProbability(float3 base, float metallic, float roughness, float cosThetaO)
+{
+  float specular = MicrofacetSpecularAlbedo(MicrofacetLuminance(MicrofacetF0(base, metallic)), cosThetaO, roughness);
+  float diffuse = (1.0f - MicrofacetClamp(metallic, 0.0f, 1.0f)) * MicrofacetLuminance(base) *
+                  (1.0f - MicrofacetSpecularAlbedo(MICROFACET_DIELECTRIC_F0, cosThetaO, roughness));
+  return specular + diffuse > 0.0f ? specular / (specular + diffuse) : 1.0f;
+}
+
+// The BSDF times the cosine of wi.
+inline float3 MicrofacetEvaluate(float3 base, float metallic, float roughness, float3 wo, float3 wi)
+{
+  if (wo.z <= 0.0f || wi.z <= 0.0f)
+  {
+    return float3(0.0f, 0.0f, 0.0f);
+  }
+  float alpha = MicrofacetAlpha(roughness);
+  float3 wm = normalize(wo + wi);
+  float3 f0 = MicrofacetF0(base, metallic);
+  float schlick = MicrofacetSchlickWeight(dot(wo, wm));
+  float3 fresnel = f0 + (float3(1.0f, 1.0f, 1.0f) - f0) * schlick;
+
+  float a = MicrofacetEnergyLookup(wo.z, roughness, 0);
+  float b = MicrofacetEnergyLookup(wo.z, roughness, 1);
+  float3 compensation = float3(1.0f, 1.0f, 1.0f) + f0 * (1.0f / max(a + b, 1e-4f) - 1.0f);
+  float specular = MicrofacetD(alpha, wm.z) * MicrofacetG2(alpha, wo.z, wi.z) / (4.0f * wo.z);
+
+  float diffuse = (1.0f - MicrofacetClamp(metallic, 0.0f, 1.0f)) * (1.0f - MicrofacetSpecularAlbedo(MICROFACET_DIELECTRIC_F0, wo.z, roughness)) *
+                  wi.z / MICROFACET_PI;
+  return fresnel * compensation * specular + base * diffuse;
+}
+
+// Density of MicrofacetSample, both lobes.
+inline float MicrofacetPdf(float3 base, float metallic, float roughness, float3 wo, float3 wi)
+{
+  if (wo.z <= 0.0f || wi.z <= 0.0f)
+  {
+    return 0.0f;
+  }
+  float specular = MicrofacetSpecularProbability(base, metallic, roughness, wo.z);
+  return specular * MicrofacetVisibleNormalPdf(wo, wi, MicrofacetAlpha(roughness)) + (1.0f - specular) * wi.z / MICROFACET_PI;
+}
+
+// u0 picks the lobe, u1 and u2 the direction. Below the surface (z <= 0) when the
+// reflection about the sampled normal goes there, the path ends.
+inline float3 MicrofacetSample(float3 base, float metallic, float roughness, float3 wo, float u0, float u1, float u2)
+{
+  if (u0 < MicrofacetSpecularProbability(base, metallic, roughness, wo.z))
+  {
+    float3 wm = MicrofacetSampleVisibleNormal(wo, MicrofacetAlpha(roughness), u1, u2);
+    return 2.0f * dot(wo, wm) * wm - wo;
+  }
+  float r = sqrt(u1);
+  float phi = 2.0f * MICROFACET_PI * u2;
+  return float3(r * cos(phi), r * sin(phi), sqrt(max(1.0f - u1, 0.0f)));
+}
+
+// A tangent of the unit normal n, the frame is tangent, cross(n, tangent), n
+// (Duff et al., "Building an Orthonormal Basis, Revisited", JCGT 2017).
+inline float3 MicrofacetTangent(float3 n)
+{
+  float s = n.z < 0.0f ? -1.0f : 1.0f;
+  float a = -1.0f / (s + n.z);
+  return float3(1.0f + s * n.x * n.x * a, s * n.x * n.y * a, -s * n.x);
+}
+
+inline float3 MicrofacetToLocal(float3 v, float3 tangent, float3 n)
+{
+  return float3(dot(v, tangent), dot(v, cross(n, tangent)), dot(v, n));
+}
+
+inline float3 MicrofacetToWorld(float3 v, float3 tangent, float3 n)
+{
+  return v.x * tangent + v.y * cross(n, tangent) + v.z * n;
+}
+
+#ifndef HLSL
+// One cell of the energy table: A and B of the lobe at the cosine and roughness,
+// integrated over samples visible normals of a Hammersley set.
+inline void ComputeMicrofacetEnergy(float cosTheta, float roughness, uint samples, float& a, float& b)
+{
+  // at grazing angles wo lies in the surface, a little above it the integral is the same
+  cosTheta = max(cosTheta, 1e-4f);
+  const float3 wo(sqrt(max(1.0f - cosTheta * cosTheta, 0.0f)), 0.0f, cosTheta);
+  const float alpha = MicrofacetAlpha(roughness);
+  double sumA = 0.0, sumB = 0.0;
+  for (uint i = 0; i < samples; i++)
+  {
+    uint bits = i;
+    bits = (bits << 16) | (bits >> 16);
+    bits = ((bits & 0x55555555u) << 1) | ((bits & 0xaaaaaaaau) >> 1);
+    bits = ((bits & 0x33333333u) << 2) | ((bits & 0xccccccccu) >> 2);
+    bits = ((bits & 0x0f0f0f0fu) << 4) | ((bits & 0xf0f0f0f0u) >> 4);
+    bits = ((bits & 0x00ff00ffu) << 8) | ((bits & 0xff00ff00u) >> 8);
+
+    const float3 wm = MicrofacetSampleVisibleNormal(wo, alpha, (i + 0.5f) / samples, bits * (1.0f / 4294967296.0f));
+    const float3 wi = 2.0f * dot(wo, wm) * wm - wo;
+    if (wi.z <= 0.0f)
+    {
+      continue;
+    }
+    // f cos / pdf of the visible normal sample with F = 1
+    const double weight = MicrofacetG2(alpha, wo.z, wi.z) / MicrofacetG1(alpha, wo.z);
+    const double schlick = MicrofacetSchlickWeight(dot(wo, wm));
+    sumA += (1.0 - schlick) * weight;
+    sumB += schlick * weight;
+  }
+  a = static_cast<float>(sumA / samples);
+  b = static_cast<float>(sumB / samples);
+}
+#endif
+
+#ifndef HLSL
+}
+#endif
+
+#endif // MICROFACETHLSLCOMPAT_H
@@ -0,0 +1,219 @@
+//
+// PackingHlslCompat.h - compact encodings of the ray payload and the vertex streams, shared by
+// Raytracing.hlsl, the scene upload and the CPU report that checks their precision.
+//
+//   Octahedral - a unit vector projected onto the octahedron, the lower half folded over
+//                the upper (Cigolle et al., "A Survey of Efficient Representations for
+//                Independent Unit Vectors", JCGT 2014), as two snorm16 in one uint. The
+//                directions of the payload and the quantized vertex normals.
+//   Half       - two floats as halves in one uint, the throughput of the payload.
+//   Unorm16    - two values in [0, 1] in one uint, the quantized texture coordinates
+//                relative to the bounds of their mesh.
+//
+// Written in the part of the language HLSL and C++ have in common.
+//
+
+#ifndef PACKINGHLSLCOMPAT_H
+#define PACKINGHLSLCOMPAT_H
+
+#ifndef HLSL
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace Packing {
+
+typedef std::uint32_t uint;
+using std::abs;
+using std::floor;
+using std::sqrt;
+
+struct float2
+{
+  float x, y;
+  float2() : x(0.0f), y(0.0f) {}
+  float2(float x, float y) : x(x), y(y) {}
+};
+
+struct float3
+{
+  float x, y, z;
+  float3() : x(0.0f), y(0.0f), z(0.0f) {}
+  float3(float x, float y, float z) : x(x), y(y), z(z) {}
+};
+
+inline uint asuint(float value)
+{
+  uint bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+inline float asfloat(uint bits)
+{
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// The HLSL intrinsics: round to nearest even, overflow to infinity, the half in the low 16 bits.
+inline uint f32tof16(float value)
+{
+  const uint bits = asuint(value);
+  const uint sign = (bits >> 16) & 0x8000u;
+  uint magnitude = bits & 0x7fffffffu;
+  if (magnitude >= (143u << 23)) // 65536, infinity and nan
+  {
+    return sign | (magnitude > 0x7f800000u ? 0x7e00u : 0x7c00u);
+  }
+  if (magnitude < (113u << 23)) // below 2^-14: adding 0.5 lines the denormal up with the low bits
+  {
+    return sign | (asuint(asfloat(magnitude) + 0.5f) - asuint(0.5f));
+  }
+  magnitude += 0xc8000fffu + ((magnitude >> 13) & 1u); // rebias the exponent, round to even
+  return sign | (magnitude >> 13);
+}
+
+inline float f16tof32(uint value)
+{
+  const uint sign = (value & 0x8000u) << 16;
+  const uint exponent = (value >> 10) & 0x1fu;
+  const uint mantissa = value & 0x3ffu;
+  if (exponent == 0)
+  {
+    return asfloat(sign | asuint(mantissa * 5.9604644775390625e-8f)); // 2^-24
+  }
+  return asfloat(sign | (exponent == 31 ? 0x7f800000u : (exponent + 112) << 23) | (mantissa << 13));
+}
+#endif
+
+enum VertexAttributeFormat
+{
+  VertexAttributesFloat = 0, // float3 normal, float2 uv
+  VertexAttributesQuantized = 1, // octahedral normal, unorm16 uv
+};
+
+// Bytes per vertex of the streams the closest hit shader reads. The positions are what
+// the acceleration structure is built from, the attributes are all a hit needs without
+// a normal map. The loaders fill the interleaved Vertex of RayTracingHlslCompat.h.
+static const uint VERTEX_INTERLEAVED_STRIDE = 32;
+static const uint VERTEX_POSITION_STRIDE = 12;
+static const uint VERTEX_ATTRIBUTES_STRIDE = 20;
+static const uint VERTEX_QUANTIZED_ATTRIBUTES_STRIDE = 8;
+
+// Two snorm16 of -32768, which PackSnorm16 never writes: no direction, decoded as zero.
+static const uint PACKING_NO_DIRECTION = 0x80008000u;
+
+static const float PACKING_HALF_MAX = 65504.0f;
+
+inline float PackingClamp(float value, float low, float high)
+{
+  return value < low ? low : (value > high ? high : value);
+}
+
+inline float PackingSignNotZero(float value)
+{
+  return value < 0.0f ? -1.0f : 1.0f;
+}
+
+inline uint PackSnorm16(float value)
+{
+  return (uint)(int)floor(PackingClamp(value, -1.0f, 1.0f) * 32767.0f + 0.5f) & 0xffffu;
+}
+
+inline float UnpackSnorm16(uint bits)
+{
+  float value = (float)((int)(bits << 16) >> 16) / 32767.0f;
+  return value > -1.0f ? value : -1.0f;
+}
+
+inline uint PackUnorm16(float value)
+{
+  return (uint)floor(PackingClamp(value, 0.0f, 1.0f) * 65535.0f + 0.5f);
+}
+
+inline float UnpackUnorm16(uint bits)
+{
+  return (float)(bits & 0xffffu) / 65535.0f;
+}
+
+// v does not have to be normalized, but must not be zero.
+inline uint PackOctahedral(float3 v)
+{
+  float l1 = abs(v.x) + abs(v.y) + abs(v.z);
+  float u = v.x / l1;
+  float w = v.y / l1;
+  if (v.z < 0.0f)
+  {
+    float folded = (1.0f - abs(w)) * PackingSignNotZero(u);
+    w = (1.0f - abs(u)) * PackingSignNotZero(w);
+    u = folded;
+  }
+  return PackSnorm16(u) | (PackSnorm16(w) << 16);
+}
+
+inline float3 UnpackOctahedral(uint packed)
+{
+  float u = UnpackSnorm16(packed & 0xffffu);
+  float w = UnpackSnorm16(packed >> 16);
+  float z = 1.0f - abs(u) - abs(w);
+  if (z < 0.0f)
+  {
+    float unfolded = (1.0f - abs(w)) * PackingSignNotZero(u);
+    w = (1.0f - abs(u)) * PackingSignNotZero(w);
+    u = unfolded;
+  }
+  float inverseLength = 1.0f / sqrt(u * u + w * w + z * z);
+  return float3(u * inverseLength, w * inverseLength, z * inverseLength);
+}
+
+// The same with the zero vector as PACKING_NO_DIRECTION, for normals that may be absent.
+inline uint PackOctahedralOrNone(float3 v)
+{
+  return (v.x == 0.0f && v.y == 0.0f && v.z == 0.0f) ? PACKING_NO_DIRECTION : PackOctahedral(v);
+}
+
+inline float3 UnpackOctahedralOrZero(uint packed)
+{
+  return packed == PACKING_NO_DIRECTION ? float3(0.0f, 0.0f, 0.0f) : UnpackOctahedral(packed);
+}
+
+// Clamped to the largest half so a bright throughput does not turn into infinity.
+inline uint PackHalf2(float x, float y)
+{
+  return f32tof16(PackingClamp(x, -PACKING_HALF_MAX, PACKING_HALF_MAX)) |
+         (f32tof16(PackingClamp(y, -PACKING_HALF_MAX, PACKING_HALF_MAX)) << 16);
+}
+
+inline float2 UnpackHalf2(uint packed)
+{
+  return float2(f16tof32(packed & 0xffffu), f16tof32(packed >> 16));
+}
+
+inline uint PackUnorm16x2(float x, float y)
+{
+  return PackUnorm16(x) | (PackUnorm16(y) << 16);
+}
+
+inline float2 UnpackUnorm16x2(uint packed)
+{
+  return float2(UnpackUnorm16(packed), UnpackUnorm16(packed >> 16));
+}
+
+// A texture coordinate relative to the bounds of its mesh, offset and scale as in the Info.
+inline uint PackTexCoord(float2 uv, float2 offset, float2 scale)
+{
+  return PackUnorm16x2((uv.x - offset.x) / scale.x, (uv.y - offset.y) / scale.y);
+}
+
+inline float2 UnpackTexCoord(uint packed, float2 offset, float2 scale)
+{
+  float2 unit = UnpackUnorm16x2(packed);
+  return float2(offset.x + unit.x * scale.x, offset.y + unit.y * scale.y);
+}
+
+#ifndef HLSL
+}
+#endif
+
+#endif // PACKINGHLSLCOMPAT_H
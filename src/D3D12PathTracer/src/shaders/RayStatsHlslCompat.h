@@ -0,0 +1,51 @@
+//
+// RayStatsHlslCompat.h - layout of the ray statistics buffer (PathStats in Raytracing.hlsl),
+// shared by the raygen shader, the application that reads it back and the CPU reference
+// that counts the same things.
+//
+// One uint per counter, summed over every path of a launch:
+//
+//   Paths, Segments   - always counted, what the average path length is made of
+//   ClosestHits       - segments that hit a surface and may bounce on
+//   LightHits         - segments that ended on an emitter
+//   Misses            - segments that left the scene
+//   ShadowRays        - next event estimation rays, ShadowOccluded of them were blocked
+//   Terminated        - paths russian roulette ended
+//   Depth + d         - segments traced at bounce d, the last bin holds every deeper one
+//
+// Everything past Segments is only counted with the RayStatistics feature. Segments is
+// ClosestHits + LightHits + Misses and the sum of the depth bins; the rays a frame
+// really traced are Segments + ShadowRays.
+//
+// Written in the part of the language HLSL and C++ have in common.
+//
+
+#ifndef RAYSTATSHLSLCOMPAT_H
+#define RAYSTATSHLSLCOMPAT_H
+
+#ifndef HLSL
+namespace RayStats {
+#endif
+
+// Depth bins of the buffer, paths deeper than this share the last one.
+#define RAY_STATS_MAX_DEPTH (16)
+
+enum RayStat
+{
+  RayStatPaths = 0,
+  RayStatSegments = 1,
+  RayStatClosestHits = 2,
+  RayStatLightHits = 3,
+  RayStatMisses = 4,
+  RayStatShadowRays = 5,
+  RayStatShadowOccluded = 6,
+  RayStatTerminated = 7,
+  RayStatDepth = 8,
+  RayStatCount = RayStatDepth + RAY_STATS_MAX_DEPTH,
+};
+
+#ifndef HLSL
+}
+#endif
+
+#endif // RAYSTATSHLSLCOMPAT_H
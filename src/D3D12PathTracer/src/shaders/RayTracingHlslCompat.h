@@ -19,12 +19,20 @@ using namespace DirectX;
 
 // Shader will use byte encoding to access indices.
 typedef UINT32 Index;
+
+#include <cmath>
 #endif
 
+#include "AdaptiveHlslCompat.h"
+
 enum Feature
 {
   AntiAliasing = 1,
   DepthOfField = 2,
+  AdaptiveSampling = 4,
+  NextEventEstimation = 8,
+  RussianRoulette = 16,
+  RayStatistics = 32, // the counters of RayStatsHlslCompat.h past paths and segments
 };
 
 struct SceneConstantBuffer
@@ -35,9 +43,20 @@ struct SceneConstantBuffer
   XMVECTOR lightPosition;
   XMVECTOR lightAmbientColor;
   XMVECTOR lightDiffuseColor;
-  UINT iteration;
+  UINT iteration; // dispatches into the accumulation since it was cleared, the first is 1
   UINT depth;
   UINT features;
+  UINT samples_per_launch;
+  UINT output_width;
+  UINT output_height;
+  UINT adaptive_tiles_x;
+  UINT adaptive_min_samples;
+  UINT tile_offset_x;
+  UINT tile_offset_y;
+  UINT light_count;
+  UINT rr_min_depth; // bounces before russian roulette may end a path
+  UINT sampler_type; // SamplerType in SamplingHlslCompat.h
+  UINT accumulation_format; // AccumulationFormat in AccumulationHlslCompat.h
 };
 
 struct CubeConstantBuffer
@@ -51,6 +70,20 @@ struct Vertex {
 	XMFLOAT2 texCoord;
 };
 
+// What the loaders fill in as Vertex goes to the GPU as two streams, the positions and
+// one of these, see PackingHlslCompat.h.
+struct VertexAttributes
+{
+  XMFLOAT3 normal;
+  XMFLOAT2 texCoord;
+};
+
+struct QuantizedVertexAttributes
+{
+  UINT normal; // octahedral
+  UINT texCoord; // unorm16 pair between uv_offset and uv_offset + uv_scale of the Info
+};
+
 // Holds data for a specific material
 struct Material 
 {
@@ -61,6 +94,8 @@ struct Material
   float emittance;
   XMFLOAT3 diffuse;
   XMFLOAT3 specular;
+  float metallic; // metal/roughness BSDF of MicrofacetHlslCompat.h if roughness > 0, diffuse is the base color
+  float roughness;
 };
 
 struct Info
@@ -71,7 +106,27 @@ struct Info
   UINT material_offset;
   UINT diffuse_sampler_offset;
   UINT normal_sampler_offset;
+  UINT light_offset; // first EmissiveTriangle of the object, -1 if it is not in the light list
   XMMATRIX rotation_scale_matrix;
+  XMFLOAT2 uv_offset; // bounds of the texture coordinates of the model, for quantized attributes
+  XMFLOAT2 uv_scale;
+  UINT attribute_format; // VertexAttributeFormat in PackingHlslCompat.h
+  UINT texture_metallic_roughness_offset; // in the diffuse textures, metallic in blue, roughness in green as in glTF
+  UINT metallic_roughness_sampler_offset;
+};
+
+// One world space emissive triangle of the light list, the list is also the alias table.
+// The emitting side is the one cross(v1 - v0, v2 - v0) points to.
+struct EmissiveTriangle
+{
+  XMFLOAT3 v0;
+  float area;
+  XMFLOAT3 v1;
+  float pdf; // probability of picking this triangle
+  XMFLOAT3 v2;
+  UINT alias;
+  XMFLOAT3 radiance;
+  float alias_probability; // probability of keeping this entry rather than its alias
 };
 
 #endif // RAYTRACINGHLSLCOMPAT_H
\ No newline at end of file
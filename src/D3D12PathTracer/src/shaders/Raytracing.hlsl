@@ -14,20 +14,64 @@
 
 #define HLSL
 #include "RayTracingHlslCompat.h"
+#include "SamplingHlslCompat.h"
+#include "AccumulationHlslCompat.h"
+#include "PackingHlslCompat.h"
+#include "MicrofacetHlslCompat.h"
+#include "RayStatsHlslCompat.h"
+
+// Paths the app may compile out for a scene that does not use them, see
+// ShaderPermutation.h. The build keeps all of them.
+#ifndef PERMUTATION_NORMAL_MAPPING
+#define PERMUTATION_NORMAL_MAPPING 1
+#endif
+#ifndef PERMUTATION_GLASS
+#define PERMUTATION_GLASS 1
+#endif
+#ifndef PERMUTATION_REFLECTIVE
+#define PERMUTATION_REFLECTIVE 1
+#endif
+#ifndef PERMUTATION_REFRACTIVE
+#define PERMUTATION_REFRACTIVE 1
+#endif
+#ifndef PERMUTATION_EMISSIVE
+#define PERMUTATION_EMISSIVE 1
+#endif
+#ifndef PERMUTATION_DIFFUSE
+#define PERMUTATION_DIFFUSE 1
+#endif
+#ifndef PERMUTATION_MICROFACET
+#define PERMUTATION_MICROFACET 1
+#endif
+#ifndef PERMUTATION_ANTI_ALIASING
+#define PERMUTATION_ANTI_ALIASING 1
+#endif
+#ifndef PERMUTATION_DEPTH_OF_FIELD
+#define PERMUTATION_DEPTH_OF_FIELD 1
+#endif
 
 //NULL OFFSET IF INDEX OFFSET IS -1
 #define NULL_OFFSET (-1)
 
 RaytracingAccelerationStructure Scene : register(t0, space0);
 RWTexture2D<float4> RenderTarget : register(u0);
-RWTexture2D<float4> RenderTarget2 : register(u1);
-StructuredBuffer<Vertex> Vertices[] : register(t0, space1);
+RWTexture2D<float4> RenderTarget2 : register(u1); // accumulation, in the format of AccumulationHlslCompat.h
+RWTexture2D<float4> SecondMoment : register(u2); // sums of squares, sample count in w
+RWByteAddressBuffer TileErrors : register(u3);
+RWByteAddressBuffer PathStats : register(u4); // RayStatsHlslCompat.h
+RWTexture2D<float4> AlbedoDepth : register(u5); // denoiser guides, sums over the samples like RenderTarget2
+RWTexture2D<float4> NormalSum : register(u6);
+RWTexture2D<float4> Compensation : register(u7); // rounding error of the Half accumulation
+ByteAddressBuffer ActiveTiles : register(t1, space0);
+StructuredBuffer<EmissiveTriangle> Lights : register(t2, space0);
+StructuredBuffer<float3> Positions[] : register(t0, space1);
 ByteAddressBuffer Indices[] : register(t0, space2);
 ConstantBuffer<Info> infos[] : register(b0, space3);
 ConstantBuffer<Material> materials[] : register(b0, space4);
 Texture2D text[] : register(t0, space5);
 Texture2D normal_text[] : register(t0, space6);
 SamplerState samplers[] : register(s0);
+ByteAddressBuffer VertexAttributeStreams[] : register(t0, space7); // VertexAttributeFormat of the info
 
 ConstantBuffer<SceneConstantBuffer> g_sceneCB : register(b0);
 ConstantBuffer<CubeConstantBuffer> g_cubeCB : register(b1);
@@ -44,6 +88,17 @@ static const float BLUE_WAVELENGTH_UM = 0.47f;
 static const float GREEN_WAVELENGTH_UM = 0.53f;
 
 static uint rng_state; // the current seed
+static uint rng_pixel; // pixel index, sample and next dimension of the low discrepancy samplers
+static uint rng_sample;
+static uint rng_dimension;
+
+// Ray statistics of this thread's paths, summed over the wave at the end of the raygen shader
+static uint stats_closest_hits = 0;
+static uint stats_light_hits = 0;
+static uint stats_misses = 0;
+static uint stats_shadow_rays = 0;
+static uint stats_shadow_occluded = 0;
+static uint stats_terminated = 0;
 static const float png_01_convert = (1.0f / 4294967296.0f); // to convert into a 01 distribution
 
 // Magic bit shifting algorithm from George Marsaglia's paper
@@ -69,21 +124,61 @@ uint wang_hash(uint seed)
 // Sets the seed of the pseudo-rng calls using the index of the pixel, the iteration number, and the current depth
 void ComputeRngSeed(uint index, uint iteration, uint depth) {
 	rng_state = uint(wang_hash((1 << 31) | (depth << 22) | iteration) ^ wang_hash(index));
+
+	// iterations count from 1, sequences from 0
+	rng_pixel = index;
+	rng_sample = iteration - 1;
+	rng_dimension = depth * SAMPLER_DIMENSIONS_PER_SEED;
 }
 
 // Returns a pseudo-rng float between 0 and 1. Must call ComputeRngSeed at least once.
+// The low discrepancy samplers give every call the next dimension of the sample.
 float Uniform01() {
+	if (g_sceneCB.sampler_type != RandomSampler) {
+		uint2 pixel = uint2(rng_pixel % g_sceneCB.output_width, rng_pixel / g_sceneCB.output_width);
+		return SampleDimension(g_sceneCB.sampler_type, pixel.x, pixel.y, rng_sample, rng_dimension++);
+	}
 	return float(rand_xorshift() * png_01_convert);
 }
 
 typedef BuiltInTriangleIntersectionAttributes MyAttributes;
+// Packed as in PackingHlslCompat.h, 44 bytes instead of 84. Go through the accessors
+// below for the color.
 struct RayPayload
 {
-    float4 color;
+	uint2 color; // halves: throughput, w the type of hit (-1 nothing or continue, 0 bounce, emittance of a light)
 	float3 rayOrigin;
-	float3 rayDir;
+	uint rayDir; // octahedral
+	uint hitNormal; // octahedral, set by diffuse bounces only, PACKING_NO_DIRECTION otherwise
+	float lightPdf; // solid angle pdf of light sampling the emitter that was hit, zero if it is not in the light list
+	uint2 feature; // halves: albedo and distance of the hit for the denoiser, zero on a miss
+	uint featureNormal; // octahedral, PACKING_NO_DIRECTION on a miss
 };
 
+float4 GetPayloadColor(RayPayload payload)
+{
+	return float4(UnpackHalf2(payload.color.x), UnpackHalf2(payload.color.y));
+}
+
+void SetPayloadColor(inout RayPayload payload, float4 color)
+{
+	payload.color = uint2(PackHalf2(color.r, color.g), PackHalf2(color.b, color.a));
+}
+
+RayPayload CreatePayload(float4 color)
+{
+	RayPayload payload = { uint2(0, 0), float3(0, 0, 0), PACKING_NO_DIRECTION, PACKING_NO_DIRECTION, 0.0f, uint2(0, 0), PACKING_NO_DIRECTION };
+	SetPayloadColor(payload, color);
+	return payload;
+}
+
+// The next ray leaves the hit a little along its direction.
+void SetPayloadRay(inout RayPayload payload, float3 hitPosition, float3 direction)
+{
+	payload.rayDir = PackOctahedral(direction);
+	payload.rayOrigin = hitPosition + direction * 0.01f;
+}
+
 // Retrieve hit world position.
 float3 HitWorldPosition()
 {
@@ -163,7 +258,7 @@ inline void GenerateCameraRay(uint2 index, out float3 origin, out float3 directi
     float2 xy = index + 0.5f; // center in the middle of the pixel.
 
     UINT features = g_sceneCB.features;
-    if (features & AntiAliasing)
+    if (PERMUTATION_ANTI_ALIASING && (features & AntiAliasing))
     {
       // Anti - aliasing
       float epsilonX = 0;
@@ -174,7 +269,7 @@ inline void GenerateCameraRay(uint2 index, out float3 origin, out float3 directi
       xy.y += epsilonY;
     }
 
-    float2 screenPos = xy / DispatchRaysDimensions().xy * 2.0 - 1.0;
+    float2 screenPos = xy / float2(g_sceneCB.output_width, g_sceneCB.output_height) * 2.0 - 1.0;
 
     // Invert Y for DirectX-style coordinates.
     screenPos.y = -screenPos.y;
@@ -186,7 +281,7 @@ inline void GenerateCameraRay(uint2 index, out float3 origin, out float3 directi
     origin = g_sceneCB.cameraPosition.xyz;
     direction = normalize(world.xyz - origin);
 
-    if (features & DepthOfField)
+    if (PERMUTATION_DEPTH_OF_FIELD && (features & DepthOfField))
     {
       	// Depth of Field
 	float lensRad = 0.5f;
@@ -257,14 +352,13 @@ float3 CalculateRandomDirectionInSphere(float3 normal)
 	return (bounceUpOrDown < 0.5f) ? newDirPos : newDirNeg;
 }
 
-void ReflectiveBounce(uint material_offset, float3 triangleNormal, float3 hitPosition, float hitType, RayPayload payload)
+void ReflectiveBounce(uint material_offset, float3 triangleNormal, float3 hitPosition, float hitType, inout RayPayload payload)
 {
 	float3 newDir = reflect(WorldRayDirection(), triangleNormal);
-	payload.rayDir = newDir;
-	payload.rayOrigin = hitPosition + payload.rayDir * 0.01f;
+	SetPayloadRay(payload, hitPosition, newDir);
 
-	float3 color = payload.color.rgb * materials[material_offset].specular;
-	payload.color = float4(color, hitType);
+	float3 color = GetPayloadColor(payload).rgb * materials[material_offset].specular;
+	SetPayloadColor(payload, float4(color, hitType));
 }
 
 // taken from https://en.wikipedia.org/wiki/Sellmeier_equation
@@ -287,7 +381,7 @@ float SellmeierEquation(float wavelength)
 	return sqrt(1.0f + term1 + term2 + term3);
 }
 
-void GlassBounce(uint material_offset, float3 triangleNormal, float3 hitPosition, float hitType, RayPayload payload)
+void GlassBounce(uint material_offset, float3 triangleNormal, float3 hitPosition, float hitType, inout RayPayload payload)
 {
 	float wavelength = 0.0f;
 	float rand = Uniform01();
@@ -295,19 +389,19 @@ void GlassBounce(uint material_offset, float3 triangleNormal, float3 hitPosition
 	{
 		// sample the red color and get red wavelength
 		wavelength = RED_WAVELENGTH_UM;
-		payload.color *= float4(3.0f, 0.00001f, 0.00001f, 0.0f);
+		SetPayloadColor(payload, GetPayloadColor(payload) * float4(3.0f, 0.00001f, 0.00001f, 0.0f));
 	}
 	else if (rand < 0.66666f)
 	{
 		// sample the green color
 		wavelength = GREEN_WAVELENGTH_UM;
-		payload.color *= float4(0.00001f, 3.0f, 0.00001f, 0.0f);
+		SetPayloadColor(payload, GetPayloadColor(payload) * float4(0.00001f, 3.0f, 0.00001f, 0.0f));
 	}
 	else
 	{
 		// sample the blue color
 		wavelength = BLUE_WAVELENGTH_UM;
-		payload.color *= float4(0.00001f, 0.00001f, 3.0f, 0.0f);
+		SetPayloadColor(payload, GetPayloadColor(payload) * float4(0.00001f, 0.00001f, 3.0f, 0.0f));
 	}
 
 	// TODO: Figure out if this is just editing the index of refraction or if this is actually correct
@@ -323,7 +417,7 @@ void GlassBounce(uint material_offset, float3 triangleNormal, float3 hitPosition
 
 	// internal total reflection
 	if (length(newDir) < 0.01f) {
-		payload.color *= 0;
+		SetPayloadColor(payload, float4(0, 0, 0, 0));
 		newDir = reflect(WorldRayDirection(), triangleNormal);
 	}
 
@@ -335,14 +429,13 @@ void GlassBounce(uint material_offset, float3 triangleNormal, float3 hitPosition
 
 	// based on coef, pick either a refraction or reflection
 	newDir = schlick_coef < Uniform01() ? reflect(WorldRayDirection(), triangleNormal) : newDir;
-	payload.rayDir = newDir;
-	payload.rayOrigin = hitPosition + payload.rayDir * 0.01f;
+	SetPayloadRay(payload, hitPosition, newDir);
 
-	float3 color = payload.color.rgb * materials[material_offset].specular;
-	payload.color = float4(color, hitType);
+	float3 color = GetPayloadColor(payload).rgb * materials[material_offset].specular;
+	SetPayloadColor(payload, float4(color, hitType));
 }
 
-void RefractiveBounce(uint material_offset, float3 triangleNormal, float3 hitPosition, float hitType, RayPayload payload)
+void RefractiveBounce(uint material_offset, float3 triangleNormal, float3 hitPosition, float hitType, inout RayPayload payload)
 {
 	float indexOfRefraction = materials[material_offset].eta; // TODO: Change this to be more general
 
@@ -356,7 +449,7 @@ void RefractiveBounce(uint material_offset, float3 triangleNormal, float3 hitPos
 
 	// internal total reflection
 	if (length(newDir) < 0.01f) {
-		payload.color *= 0;
+		SetPayloadColor(payload, float4(0, 0, 0, 0));
 		newDir = reflect(WorldRayDirection(), triangleNormal);
 	}
 
@@ -368,35 +461,69 @@ void RefractiveBounce(uint material_offset, float3 triangleNormal, float3 hitPos
 
 	// based on coef, pick either a refraction or reflection
 	newDir = schlick_coef < Uniform01() ? reflect(WorldRayDirection(), triangleNormal) : newDir;
-	payload.rayDir = newDir;
-	payload.rayOrigin = hitPosition + payload.rayDir * 0.01f;
+	SetPayloadRay(payload, hitPosition, newDir);
 
-	float3 color = payload.color.rgb * materials[material_offset].specular;
-	payload.color = float4(color, hitType);
+	float3 color = GetPayloadColor(payload).rgb * materials[material_offset].specular;
+	SetPayloadColor(payload, float4(color, hitType));
 }
 
-void DiffuseBounce(uint texture_offset, uint material_offset, uint sampler_offset, float emittance, float3 triangleNormal, float3 hitPosition, float hitType, float2 triangleUV, RayPayload payload)
+void DiffuseBounce(uint texture_offset, uint material_offset, uint sampler_offset, float emittance, float3 triangleNormal, float3 hitPosition, float hitType, float2 triangleUV, inout RayPayload payload)
 {
 	float3 newDir = CalculateRandomDirectionInHemisphere(triangleNormal);
-	payload.rayDir = newDir;
-	payload.rayOrigin = hitPosition + payload.rayDir * 0.01f;
+	SetPayloadRay(payload, hitPosition, newDir);
 
 	float3 color = BACKGROUND_COLOR.xyz;
 	if (texture_offset != NULL_OFFSET)
 	{
 		float3 tex = text[texture_offset].SampleLevel(samplers[sampler_offset], triangleUV, 0);
-		color = payload.color.rgb * tex.rgb;
+		color = GetPayloadColor(payload).rgb * tex.rgb;
 	}
 	else if (material_offset != NULL_OFFSET)
 	{
-		color = payload.color.rgb * materials[material_offset].diffuse;
+		color = GetPayloadColor(payload).rgb * materials[material_offset].diffuse;
 	}
 
-	payload.color = float4(color.xyz, emittance);
+	SetPayloadColor(payload, float4(color.xyz, emittance));
 }
 
 
-void TransmissiveBounce(uint texture_offset, uint material_offset, uint sampler_offset, float emittance, float3 triangleNormal, float3 hitPosition, float hitType, float2 triangleUV, RayPayload payload)
+// Metal/roughness bounce: a direction from the BSDF of MicrofacetHlslCompat.h, the path
+// weighted by f cos / pdf. The base color is the diffuse texture or color, metallic and
+// roughness are scaled by the blue and green of the metallic roughness texture.
+void MicrofacetBounce(uint instanceId, uint texture_offset, uint material_offset, uint sampler_offset, float3 triangleNormal, float3 hitPosition, float2 triangleUV, inout RayPayload payload)
+{
+	float3 base = materials[material_offset].diffuse;
+	if (texture_offset != NULL_OFFSET)
+	{
+		base = text[texture_offset].SampleLevel(samplers[sampler_offset], triangleUV, 0).rgb;
+	}
+	float metallic = materials[material_offset].metallic;
+	float roughness = materials[material_offset].roughness;
+	uint metallic_roughness_offset = infos[instanceId].texture_metallic_roughness_offset;
+	if (metallic_roughness_offset != NULL_OFFSET)
+	{
+		float3 texel = text[metallic_roughness_offset].SampleLevel(samplers[infos[instanceId].metallic_roughness_sampler_offset], triangleUV, 0).rgb;
+		metallic *= texel.b;
+		roughness *= texel.g;
+	}
+
+	// the side the ray comes from scatters
+	float3 normal = dot(WorldRayDirection(), triangleNormal) > 0.0f ? -triangleNormal : triangleNormal;
+	float3 tangent = MicrofacetTangent(normal);
+	float3 wo = MicrofacetToLocal(-normalize(WorldRayDirection()), tangent, normal);
+
+	float u0 = Uniform01();
+	float u1 = Uniform01();
+	float u2 = Uniform01();
+	float3 wi = MicrofacetSample(base, metallic, roughness, wo, u0, u1, u2);
+	float pdf = MicrofacetPdf(base, metallic, roughness, wo, wi);
+	float3 weight = pdf > 0.0f ? MicrofacetEvaluate(base, metallic, roughness, wo, wi) / pdf : float3(0, 0, 0);
+
+	SetPayloadRay(payload, hitPosition, MicrofacetToWorld(wi, tangent, normal));
+	SetPayloadColor(payload, float4(GetPayloadColor(payload).rgb * weight, 0.0f));
+}
+
+void TransmissiveBounce(uint texture_offset, uint material_offset, uint sampler_offset, float emittance, float3 triangleNormal, float3 hitPosition, float hitType, float2 triangleUV, inout RayPayload payload)
 {
 	// if we are inside the material
 	if (dot(WorldRayDirection(), triangleNormal) < 0.f)
@@ -431,7 +558,7 @@ void TransmissiveBounce(uint texture_offset, uint material_offset, uint sampler_
 		float distance = -log(Uniform01()) / scatteringCoefficient;
 		distance = clamp(distance, 0, tFar);
 
-		payload.color = float4(payload.color.rgb * exp(-absorptionCoefficient * distance), hitType);
+		SetPayloadColor(payload, float4(GetPayloadColor(payload).rgb * exp(-absorptionCoefficient * distance), hitType));
 
 		// If we are exiting the medium, take a refractive bounce
 		if (distance >= tFar)
@@ -442,8 +569,8 @@ void TransmissiveBounce(uint texture_offset, uint material_offset, uint sampler_
 		{
 			float3 scatterDirection = CalculateRandomDirectionInSphere(triangleNormal);
 
-			payload.rayOrigin += distance * payload.rayDir;
-			payload.rayDir = scatterDirection;
+			payload.rayOrigin += distance * UnpackOctahedral(payload.rayDir);
+			payload.rayDir = PackOctahedral(scatterDirection);
 		}
 	}
 	else // IF we are entering the medium, take a refractive bounce
@@ -453,24 +580,87 @@ void TransmissiveBounce(uint texture_offset, uint material_offset, uint sampler_
 	}
 }
 
-[shader("raygeneration")]
-void MyRaygenShader()
+// Power heuristic weight of a sample drawn with pdf a that pdf b could also have produced.
+float PowerHeuristic(float a, float b)
 {
-	// Path tracing depth
-	int depth = g_sceneCB.depth;
+	float a2 = a * a;
+	return a2 / (a2 + b * b);
+}
 
+// Picks a light from the alias table with one uniform number, same walk as LightList::Sample.
+uint SampleLightIndex(float u)
+{
+	float scaled = u * g_sceneCB.light_count;
+	uint index = min((uint)scaled, g_sceneCB.light_count - 1);
+	return (scaled - index) < Lights[index].alias_probability ? index : Lights[index].alias;
+}
+
+// Shadow ray. Closest hits are skipped, so only the miss shader touches the payload.
+bool IsVisible(float3 origin, float3 target)
+{
+	float3 toTarget = target - origin;
+	float dist = length(toTarget);
+
+	RayDesc ray;
+	ray.Origin = origin;
+	ray.Direction = toTarget / dist;
+	ray.TMin = 0.001;
+	ray.TMax = max(dist - 0.01f, 0.001f);
+
+	RayPayload shadowPayload = CreatePayload(float4(0, 0, 0, 0));
+	TraceRay(Scene, RAY_FLAG_CULL_BACK_FACING_TRIANGLES | RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH | RAY_FLAG_SKIP_CLOSEST_HIT_SHADER, ~0, 0, 1, 0, ray, shadowPayload);
+	bool visible = GetPayloadColor(shadowPayload).w < 0;
+	stats_shadow_rays += 1;
+	stats_shadow_occluded += visible ? 0 : 1;
+	return visible;
+}
+
+// Next event estimation at a diffuse hit, throughput already holds the albedo of the hit.
+// Weighted against the cosine weighted bounce landing on the same point.
+float3 SampleDirectLight(float3 position, float3 normal, float3 throughput)
+{
+	EmissiveTriangle light = Lights[SampleLightIndex(Uniform01())];
+
+	// Uniform point on the triangle
+	float su = sqrt(Uniform01());
+	float v = Uniform01();
+	float3 lightPoint = light.v0 * (1.0f - su) + light.v1 * (su * (1.0f - v)) + light.v2 * (su * v);
+
+	float3 origin = position + normal * 0.01f;
+	float3 toLight = lightPoint - origin;
+	float dist2 = dot(toLight, toLight);
+	float3 wi = toLight * rsqrt(dist2);
+
+	float cosSurface = dot(normal, wi);
+	float cosLight = dot(normalize(cross(light.v1 - light.v0, light.v2 - light.v0)), -wi);
+	if (cosSurface <= 0.0f || cosLight <= 0.0f || light.pdf <= 0.0f) {
+		return float3(0, 0, 0);
+	}
+
+	float lightPdf = light.pdf / light.area * dist2 / cosLight;
+	float bouncePdf = cosSurface * INV_PI;
+
+	if (!IsVisible(origin, lightPoint)) {
+		return float3(0, 0, 0);
+	}
+
+	return throughput * INV_PI * light.radiance * cosSurface * PowerHeuristic(lightPdf, bouncePdf) / lightPdf;
+}
+
+// Traces a single path through the given pixel and returns the gathered color.
+// segments is incremented for every path segment traced (shadow rays not included),
+// the first hit adds its albedo, distance and normal to the denoiser guides.
+float3 TracePath(uint2 pixel, uint id, uint sampleIndex, int depth, inout uint segments, inout float4 albedoDepth, inout float3 normalSum)
+{
 	// Set the seed of the prng factory
-	uint2 samplePt = DispatchRaysIndex().xy;
-	uint2 sampleDim = DispatchRaysDimensions().xy;
-	uint id = samplePt.x + sampleDim.x * samplePt.y;
-	ComputeRngSeed(id, g_sceneCB.iteration, depth);
+	ComputeRngSeed(id, sampleIndex, depth);
 
 	// Ray state to be filled before the first TraceRay()
 	float3 rayDir;
 	float3 origin;
     
     // Generate a ray for a camera pixel corresponding to an index from the dispatched 2D grid.
-    GenerateCameraRay(DispatchRaysIndex().xy, origin, rayDir);
+    GenerateCameraRay(pixel, origin, rayDir);
 
 	// Ray to be traced
     RayDesc ray;
@@ -480,8 +670,14 @@ void MyRaygenShader()
     ray.TMax = 10000.0;
 
 	// Payload: color with w coord indicating type of hit, origin of the new ray, direction of new ray
-    RayPayload payload = { float4(INITIAL_COLOR.rgb, -1.0f), float3(0, 0, 0), float3(0, 0, 0)};
+    RayPayload payload = CreatePayload(float4(INITIAL_COLOR.rgb, -1.0f));
 
+	bool nextEventEstimation = (g_sceneCB.features & NextEventEstimation) && g_sceneCB.light_count > 0;
+
+	// Light gathered so far, and the solid angle pdf of the last bounce if light
+	// sampling could have produced it too (zero for camera rays and specular bounces)
+	float3 radiance = float3(0, 0, 0);
+	float bouncePdf = 0.0f;
 
 	// for loop over path tracing depth
 	// given pay load data (missed, hit something), do something
@@ -491,39 +687,250 @@ void MyRaygenShader()
 	// case 4: no more tracing and didnt hit light: stop here
 	for (int i = 0; i < depth; i++) {
 		TraceRay(Scene, RAY_FLAG_CULL_BACK_FACING_TRIANGLES, ~0, 0, 1, 0, ray, payload);
-		ComputeRngSeed(id, g_sceneCB.iteration, i);
+		ComputeRngSeed(id, sampleIndex, i);
+		segments += 1;
+		if (i == 0) {
+			albedoDepth += float4(UnpackHalf2(payload.feature.x), UnpackHalf2(payload.feature.y));
+			normalSum += UnpackOctahedralOrZero(payload.featureNormal);
+		}
+
+		float4 color = GetPayloadColor(payload);
+		stats_closest_hits += color.w == 0 ? 1 : 0;
+		stats_light_hits += color.w > 0 ? 1 : 0;
+		stats_misses += color.w < 0 ? 1 : 0;
+		if (color.w == 0) {
+			float3 rayDir = UnpackOctahedral(payload.rayDir);
+			bouncePdf = 0.0f;
+			if (nextEventEstimation && payload.hitNormal != PACKING_NO_DIRECTION) {
+				float3 hitNormal = UnpackOctahedral(payload.hitNormal);
+				// a light sample stands for a path one bounce longer, none at the last bounce
+				if (i < depth - 1) {
+					float3 hitPosition = payload.rayOrigin - rayDir * 0.01f;
+					radiance += SampleDirectLight(hitPosition, hitNormal, color.rgb);
+				}
+				bouncePdf = max(dot(hitNormal, rayDir), 0.0f) * INV_PI;
+			}
 
+			// Russian roulette: past the minimum depth a path survives with a probability that
+			// follows its throughput, survivors are reweighted so the estimate stays unbiased.
+			// Paths with no throughput left always end here.
+			if ((g_sceneCB.features & RussianRoulette) && i >= (int)g_sceneCB.rr_min_depth && i < depth - 1) {
+				float survival = min(max(color.r, max(color.g, color.b)), 1.0f);
+				if (Uniform01() >= survival) {
+					stats_terminated += 1;
+					break;
+				}
+				color.rgb /= survival;
+			}
 
-		if (payload.color.w == 0) {
 			// new ray has to be edited here
 			ray.Origin = payload.rayOrigin;
-			ray.Direction = payload.rayDir;
-			payload.color = float4(payload.color.rgb, -1.0f);
+			ray.Direction = rayDir;
+			SetPayloadColor(payload, float4(color.rgb, -1.0f));
 			if (i == depth - 1) {
 				// if this is the final depth, then stop here with a black color
-				payload.color = BACKGROUND_COLOR;
+				SetPayloadColor(payload, BACKGROUND_COLOR);
 			}
 		}
 		else {
 			// hit light or nothing, either way stop here
-			payload.color = float4(payload.color.rgb, 0.0f);
+			if (color.w > 0) {
+				float weight = 1.0f;
+				if (bouncePdf > 0.0f && payload.lightPdf > 0.0f) {
+					weight = PowerHeuristic(bouncePdf, payload.lightPdf);
+				}
+				radiance += color.rgb * weight;
+			}
 			break;
 		}
 	}
 
 	// TODO: Stream Compact here ?? thrust::remove_if on the payload
 
+	return radiance;
+}
+
+// Sum of the samples of a pixel from the accumulation.
+float3 LoadAccumulation(uint2 pixel, float sampleCount)
+{
+	float4 stored = RenderTarget2[pixel];
+	if (g_sceneCB.accumulation_format == AccumulationHalf) {
+		float3 compensation = Compensation[pixel].rgb;
+		float3 mean = float3(AccumulationDecodeHalf(stored.r, compensation.r), AccumulationDecodeHalf(stored.g, compensation.g),
+			AccumulationDecodeHalf(stored.b, compensation.b));
+		return mean * sampleCount;
+	}
+	if (g_sceneCB.accumulation_format == AccumulationPacked) {
+		return stored.rgb * sampleCount;
+	}
+	return stored.rgb;
+}
+
+void StoreAccumulation(uint2 pixel, float3 sum, float sampleCount, uint id)
+{
+	float3 mean = sum / max(sampleCount, 1.0f);
+	if (g_sceneCB.accumulation_format == AccumulationHalf) {
+		float3 high = float3(AccumulationEncodeHalf(mean.r), AccumulationEncodeHalf(mean.g), AccumulationEncodeHalf(mean.b));
+		RenderTarget2[pixel] = float4(high, 0.0f);
+		Compensation[pixel] = float4(AccumulationEncodeCompensation(mean.r, high.r), AccumulationEncodeCompensation(mean.g, high.g),
+			AccumulationEncodeCompensation(mean.b, high.b), 0.0f);
+	}
+	else if (g_sceneCB.accumulation_format == AccumulationPacked) {
+		// one rounding offset per pixel and sample, hashed so the sampler's dimensions stay untouched
+		float offset = SamplerToFloat(SamplerHash(SamplerHashCombine(SamplerHash(id), (uint)sampleCount)));
+		RenderTarget2[pixel] = float4(AccumulationEncodePacked(mean.r, 0, offset), AccumulationEncodePacked(mean.g, 1, offset),
+			AccumulationEncodePacked(mean.b, 2, offset), 0.0f);
+	}
+	else {
+		RenderTarget2[pixel] = float4(sum, sampleCount);
+	}
+}
+
+[shader("raygeneration")]
+void MyRaygenShader()
+{
+	// Path tracing depth
+	int depth = g_sceneCB.depth;
+
+	uint2 pixel = DispatchRaysIndex().xy;
+	uint tileIndex = 0;
+
+	// Adaptive sampling dispatches ADAPTIVE_TILE_SIZE wide and ADAPTIVE_TILE_SIZE * active tiles tall,
+	// every block of rows maps to one entry of the active tile list
+	if (g_sceneCB.features & AdaptiveSampling) {
+		tileIndex = ActiveTiles.Load((pixel.y / ADAPTIVE_TILE_SIZE) * 4);
+		uint2 tileOrigin = uint2(tileIndex % g_sceneCB.adaptive_tiles_x, tileIndex / g_sceneCB.adaptive_tiles_x) * ADAPTIVE_TILE_SIZE;
+		pixel = tileOrigin + uint2(pixel.x, pixel.y % ADAPTIVE_TILE_SIZE);
+
+		// edge tiles hang over the image
+		if (pixel.x >= g_sceneCB.output_width || pixel.y >= g_sceneCB.output_height) {
+			return;
+		}
+	}
+
+	// Tiled rendering dispatches one tile of a larger image, the camera ray and the seed
+	// come from the pixel in the full image while the tile is stored at the origin
+	uint2 imagePixel = pixel + uint2(g_sceneCB.tile_offset_x, g_sceneCB.tile_offset_y);
+	uint id = imagePixel.x + g_sceneCB.output_width * imagePixel.y;
+
+	// The first dispatch after the camera moved starts every sum over, which saves
+	// clearing the buffers with copies. Pixels outside the dispatch keep stale sums
+	// until their tile is dispatched, the first dispatch covers every tile.
+	float4 accumulated = float4(0, 0, 0, 0);
+	float3 moments = float3(0, 0, 0);
+	float4 albedoDepth = float4(0, 0, 0, 0);
+	float3 normalSum = float3(0, 0, 0);
+	uint sampleCount = 0;
+	if (g_sceneCB.iteration > 1) {
+		float4 secondMoment = SecondMoment[pixel];
+		moments = secondMoment.xyz;
+		sampleCount = (uint)secondMoment.w;
+		accumulated.xyz = LoadAccumulation(pixel, secondMoment.w);
+		albedoDepth = AlbedoDepth[pixel];
+		normalSum = NormalSum[pixel].xyz;
+	}
+	uint segments = 0;
+
+	// Segments traced at every bounce, wave totals. The samples of a launch run in lockstep
+	// over the wave, so the histogram is reduced once per sample and stays uniform.
+	bool rayStatistics = (g_sceneCB.features & RayStatistics) != 0;
+	uint depthRays[RAY_STATS_MAX_DEPTH];
+	[unroll]
+	for (int bin = 0; bin < RAY_STATS_MAX_DEPTH; bin++) {
+		depthRays[bin] = 0;
+	}
+
+	for (uint s = 0; s < g_sceneCB.samples_per_launch; s++) {
+		sampleCount += 1;
+		uint previousSegments = segments;
+		float3 color = TracePath(imagePixel, id, sampleCount, depth, segments, albedoDepth, normalSum);
+		accumulated.xyz += color;
+		moments += color * color;
+
+		if (rayStatistics) {
+			uint pathLength = segments - previousSegments;
+			[unroll]
+			for (int bounce = 0; bounce < RAY_STATS_MAX_DEPTH - 1; bounce++) {
+				depthRays[bounce] += WaveActiveCountBits(pathLength > (uint)bounce);
+			}
+			depthRays[RAY_STATS_MAX_DEPTH - 1] += WaveActiveSum(max(pathLength, RAY_STATS_MAX_DEPTH - 1) - (RAY_STATS_MAX_DEPTH - 1));
+		}
+	}
+
 	// Write the raytraced color to the output texture.
-	float3 color = float3(RenderTarget2[DispatchRaysIndex().xy].xyz);
-        color += payload.color.xyz;
-        RenderTarget2[DispatchRaysIndex().xy] = float4(color.xyz, 0.0f);
+	StoreAccumulation(pixel, accumulated.xyz, sampleCount, id);
+	SecondMoment[pixel] = float4(moments, sampleCount);
+	AlbedoDepth[pixel] = albedoDepth;
+	NormalSum[pixel] = float4(normalSum, 0.0f);
 
         // Average output color
-	float r = clamp(color.r / g_sceneCB.iteration, 0, 1);
-	float g = clamp(color.g / g_sceneCB.iteration, 0, 1);
-	float b = clamp(color.b / g_sceneCB.iteration, 0, 1);
-	float4 avgColor = float4(r, g, b, 0.0f);
-	RenderTarget[DispatchRaysIndex().xy] = avgColor;
+	float3 avgColor = clamp(accumulated.xyz / max(sampleCount, 1), 0, 1);
+	RenderTarget[pixel] = float4(avgColor, 0.0f);
+
+	// Report the worst pixel of the tile, positive floats keep their order as uints
+	if (g_sceneCB.features & AdaptiveSampling) {
+		float error = ADAPTIVE_UNCONVERGED_ERROR;
+		if (sampleCount >= g_sceneCB.adaptive_min_samples) {
+			error = max(ComputeRelativeError(accumulated.x, moments.x, sampleCount),
+				max(ComputeRelativeError(accumulated.y, moments.y, sampleCount),
+					ComputeRelativeError(accumulated.z, moments.z, sampleCount)));
+		}
+		uint previous;
+		TileErrors.InterlockedMax(tileIndex * 4, asuint(error), previous);
+	}
+
+	// Path statistics: paths and segments traced this launch, one pair of atomics per wave
+	uint wavePaths = WaveActiveSum(g_sceneCB.samples_per_launch);
+	uint waveSegments = WaveActiveSum(segments);
+	if (WaveIsFirstLane()) {
+		PathStats.InterlockedAdd(RayStatPaths * 4, wavePaths);
+		PathStats.InterlockedAdd(RayStatSegments * 4, waveSegments);
+	}
+
+	// Ray statistics: the rest of the counters, also one atomic per counter and wave
+	if (rayStatistics) {
+		uint waveClosestHits = WaveActiveSum(stats_closest_hits);
+		uint waveLightHits = WaveActiveSum(stats_light_hits);
+		uint waveMisses = WaveActiveSum(stats_misses);
+		uint waveShadowRays = WaveActiveSum(stats_shadow_rays);
+		uint waveShadowOccluded = WaveActiveSum(stats_shadow_occluded);
+		uint waveTerminated = WaveActiveSum(stats_terminated);
+		if (WaveIsFirstLane()) {
+			PathStats.InterlockedAdd(RayStatClosestHits * 4, waveClosestHits);
+			PathStats.InterlockedAdd(RayStatLightHits * 4, waveLightHits);
+			PathStats.InterlockedAdd(RayStatMisses * 4, waveMisses);
+			PathStats.InterlockedAdd(RayStatShadowRays * 4, waveShadowRays);
+			PathStats.InterlockedAdd(RayStatShadowOccluded * 4, waveShadowOccluded);
+			PathStats.InterlockedAdd(RayStatTerminated * 4, waveTerminated);
+			[unroll]
+			for (int d = 0; d < RAY_STATS_MAX_DEPTH; d++) {
+				if (depthRays[d] > 0) {
+					PathStats.InterlockedAdd((RayStatDepth + d) * 4, depthRays[d]);
+				}
+			}
+		}
+	}
+}
+
+// Normal and texture coordinates of a vertex from the attribute stream of the model, in
+// the layout of VertexAttributes or QuantizedVertexAttributes.
+void LoadVertexAttributes(uint instanceId, uint model_offset, uint index, bool textured, out float3 normal, out float2 uv)
+{
+	uv = float2(0, 0);
+	if (infos[instanceId].attribute_format == VertexAttributesQuantized) {
+		uint2 packed = VertexAttributeStreams[model_offset].Load2(index * VERTEX_QUANTIZED_ATTRIBUTES_STRIDE);
+		normal = UnpackOctahedralOrZero(packed.x);
+		if (textured) {
+			uv = UnpackTexCoord(packed.y, infos[instanceId].uv_offset, infos[instanceId].uv_scale);
+		}
+	}
+	else {
+		uint address = index * VERTEX_ATTRIBUTES_STRIDE;
+		normal = asfloat(VertexAttributeStreams[model_offset].Load3(address));
+		if (textured) {
+			uv = asfloat(VertexAttributeStreams[model_offset].Load2(address + 12));
+		}
+	}
 }
 
 [shader("closesthit")]
@@ -541,11 +948,15 @@ void MyClosestHitShader(inout RayPayload payload, in MyAttributes attr)
 	uint normal_sampler_offset = infos[instanceId].normal_sampler_offset;
 	float4x4 rotation_scale_matrix = infos[instanceId].rotation_scale_matrix;
 
+	payload.hitNormal = PACKING_NO_DIRECTION;
+	payload.lightPdf = 0.0f;
+
 	float eta = 0;
 	float reflectiveness = 0;
 	float refractiveness = 0;
 	float specular_exp = 0;
 	float emittance = 0;
+	float roughness = 0;
 
 	if (material_offset != NULL_OFFSET)
 	{
@@ -554,6 +965,7 @@ void MyClosestHitShader(inout RayPayload payload, in MyAttributes attr)
 		refractiveness = materials[material_offset].refractiveness;
 		specular_exp = materials[material_offset].specularExp;
 		emittance = materials[material_offset].emittance;
+		roughness = materials[material_offset].roughness;
 	}
 
 	// Get the base index of the triangle's first 16 bit index.
@@ -567,36 +979,31 @@ void MyClosestHitShader(inout RayPayload payload, in MyAttributes attr)
 	// Load up 3 16 bit indices for the triangle.
 	const uint3 indices = Indices[model_offset].Load3(baseIndex);
 
-        float3 vertexPosition[3] = {
-		Vertices[model_offset][indices[0]].position,
-		Vertices[model_offset][indices[1]].position,
-		Vertices[model_offset][indices[2]].position
-	};
-
-
-	// Retrieve corresponding vertex normals for the triangle vertices.
-	float3 vertexNormals[3] = {
-		Vertices[model_offset][indices[0]].normal,
-		Vertices[model_offset][indices[1]].normal,
-		Vertices[model_offset][indices[2]].normal
-	};
+	// Retrieve corresponding vertex normals and uvs for the triangle vertices, the uvs only if a texture reads them.
+	bool normalMapped = PERMUTATION_NORMAL_MAPPING && texture_normal_offset != NULL_OFFSET;
+	bool textured = texture_offset != NULL_OFFSET || normalMapped || infos[instanceId].texture_metallic_roughness_offset != NULL_OFFSET;
+	float3 vertexNormals[3];
+	float2 vertexUVs[3];
+	LoadVertexAttributes(instanceId, model_offset, indices[0], textured, vertexNormals[0], vertexUVs[0]);
+	LoadVertexAttributes(instanceId, model_offset, indices[1], textured, vertexNormals[1], vertexUVs[1]);
+	LoadVertexAttributes(instanceId, model_offset, indices[2], textured, vertexNormals[2], vertexUVs[2]);
 
         // Compute the triangle's normal.
 	// This is redundant and done for illustration purposes 
 	// as all the per-vertex normals are the same and match triangle's normal in this sample. 
         float3 triangleNormal = HitAttribute(vertexNormals, attr);
 
-	float2 vertexUVs[3] = {
-		Vertices[model_offset][indices[0]].texCoord,
-		Vertices[model_offset][indices[1]].texCoord,
-		Vertices[model_offset][indices[2]].texCoord
-	};
-
         float2 triangleUV = HitAttribute2D(vertexUVs, attr);
 
         //if texture map, then sample that instead
-        if (texture_normal_offset != NULL_OFFSET)
+        if (normalMapped)
         {
+          float3 vertexPosition[3] = {
+            Positions[model_offset][indices[0]],
+            Positions[model_offset][indices[1]],
+            Positions[model_offset][indices[2]]
+          };
+
           triangleNormal = normal_text[texture_normal_offset].SampleLevel(samplers[normal_sampler_offset], triangleUV, 0);
           triangleNormal.z = -triangleNormal.z;
           triangleNormal = (triangleNormal * 2.0) - 1.0;
@@ -634,7 +1041,27 @@ void MyClosestHitShader(inout RayPayload payload, in MyAttributes attr)
           triangleNormal = normalize(triangleNormal);
         }
 
-	if (reflectiveness > 0.0f && refractiveness > 0.0f) // Do both a R E F L E C C and a R E F R A C C with fresnel effects
+	// Denoiser guides: what the illumination of this hit gets multiplied by, the
+	// specular color for mirrors and glass
+	float3 albedo = float3(0, 0, 0);
+	if (reflectiveness > 0.0f || refractiveness > 0.0f)
+	{
+		albedo = materials[material_offset].specular;
+	}
+	else if (texture_offset != NULL_OFFSET)
+	{
+		albedo = text[texture_offset].SampleLevel(samplers[diffuse_sampler_offset], triangleUV, 0).rgb;
+	}
+	else if (material_offset != NULL_OFFSET)
+	{
+		albedo = materials[material_offset].diffuse;
+	}
+	payload.feature = uint2(PackHalf2(albedo.r, albedo.g), PackHalf2(albedo.b, RayTCurrent() * length(WorldRayDirection())));
+	payload.featureNormal = PackOctahedral(triangleNormal);
+
+	// A permutation without a path never sees an object that takes it, the analysis of the
+	// scene put it in otherwise.
+	if (PERMUTATION_GLASS && reflectiveness > 0.0f && refractiveness > 0.0f) // Do both a R E F L E C C and a R E F R A C C with fresnel effects
 	{
 		float indexOfRefraction = materials[material_offset].eta; // TODO: Change this to be more general
 
@@ -652,41 +1079,62 @@ void MyClosestHitShader(inout RayPayload payload, in MyAttributes attr)
 			GlassBounce(material_offset, triangleNormal, hitPosition, hitType, payload);
 		}
 	}
-	else if (reflectiveness > 0.0f) // do a R E F L E C C
+	else if (PERMUTATION_REFLECTIVE && reflectiveness > 0.0f) // do a R E F L E C C
 	{
 		//TransmissiveBounce(texture_offset, material_offset, diffuse_sampler_offset, emittance, triangleNormal, hitPosition, hitType, triangleUV, payload);
 		ReflectiveBounce(material_offset, triangleNormal, hitPosition, hitType, payload);
 	}
-	else if (refractiveness > 0.0f) // Do a R E F R A C C
+	else if (PERMUTATION_REFRACTIVE && refractiveness > 0.0f) // Do a R E F R A C C
 	{
 		RefractiveBounce(material_offset, triangleNormal, hitPosition, hitType, payload);
 	}
-	else if (emittance > 0.0f) // I think this means its a light
+	else if (PERMUTATION_EMISSIVE && emittance > 0.0f) // I think this means its a light
 	{
 
 		float3 color = BACKGROUND_COLOR.xyz;
 		if (texture_offset != NULL_OFFSET)
 		{
 			float3 tex = text[texture_offset].SampleLevel(samplers[diffuse_sampler_offset], triangleUV, 0);
-			color = payload.color.rgb * tex.rgb;
+			color = GetPayloadColor(payload).rgb * tex.rgb;
 		}
 		else if (material_offset != NULL_OFFSET)
 		{
-			color = payload.color.rgb * materials[material_offset].diffuse;
+			color = GetPayloadColor(payload).rgb * materials[material_offset].diffuse;
 		}
 		
-		payload.color = float4(color.xyz, emittance);
+		SetPayloadColor(payload, float4(color.xyz, emittance));
+
+		// How likely light sampling was to pick this point, for the MIS weight in TracePath
+		uint light_offset = infos[instanceId].light_offset;
+		if (light_offset != NULL_OFFSET && g_sceneCB.light_count > 0)
+		{
+			EmissiveTriangle light = Lights[light_offset + PrimitiveIndex()];
+			float3 rayDir = normalize(WorldRayDirection());
+			float dist = RayTCurrent() * length(WorldRayDirection());
+			float cosLight = abs(dot(normalize(cross(light.v1 - light.v0, light.v2 - light.v0)), rayDir));
+			if (light.area > 0.0f && cosLight > 0.0f)
+			{
+				payload.lightPdf = light.pdf / light.area * dist * dist / cosLight;
+			}
+		}
+	}
+	else if (PERMUTATION_MICROFACET && roughness > 0.0f) // metal/roughness, no light sampling: the payload has no room for the BSDF
+	{
+		MicrofacetBounce(instanceId, texture_offset, material_offset, diffuse_sampler_offset, triangleNormal, hitPosition, triangleUV, payload);
 	}
-	else // Do a diffuse bounce
+	else if (PERMUTATION_DIFFUSE) // Do a diffuse bounce
 	{
 		DiffuseBounce(texture_offset, material_offset, diffuse_sampler_offset, emittance, triangleNormal, hitPosition, hitType, triangleUV, payload);
+		payload.hitNormal = PackOctahedral(triangleNormal);
 	}
 }
 
 [shader("miss")]
 void MyMissShader(inout RayPayload payload)
 {
-	payload.color = float4(BACKGROUND_COLOR.xyz, -1.0f); // -1 to indicate hit nothing
+	SetPayloadColor(payload, float4(BACKGROUND_COLOR.xyz, -1.0f)); // -1 to indicate hit nothing
+	payload.feature = uint2(0, 0);
+	payload.featureNormal = PACKING_NO_DIRECTION;
 }
 
 #endif // RAYTRACING_HLSL
\ No newline at end of file
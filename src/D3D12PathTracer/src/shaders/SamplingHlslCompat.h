@@ -0,0 +1,199 @@
+//
+// SamplingHlslCompat.h - the samplers behind Uniform01, shared by Raytracing.hlsl and the CPU reference.
+//
+// SampleDimension is stateless: the value for one dimension of one sample of one pixel.
+// Uniform01 in the shader (and Renderer::Rng on the CPU) hands out consecutive
+// dimensions, every ComputeRngSeed starts a new block of SAMPLER_DIMENSIONS_PER_SEED.
+//
+// SobolSampler is Owen scrambled Sobol after Burley, "Practical Hash-based Owen
+// Scrambling" (JCGT 2020): the first four Sobol dimensions, the sample index shuffled
+// and every dimension scrambled with hashed seeds, later dimensions reuse the four
+// under new seeds. Each pixel has its own seeds.
+//
+// BlueNoiseSampler shares one scrambled sequence between all pixels and gives every
+// pixel a chunk of it in a randomly permuted Morton order (Ahmed and Wonka, "Screen-Space
+// Blue-Noise Diffusion of Monte Carlo Sampling Error via Hierarchical Ordering of Pixels",
+// 2020). Neighbouring pixels then take neighbouring chunks of a low discrepancy sequence,
+// which spreads their error as blue noise without a noise texture.
+//
+// Written in the part of the language HLSL and C++ have in common.
+//
+
+#ifndef SAMPLINGHLSLCOMPAT_H
+#define SAMPLINGHLSLCOMPAT_H
+
+#ifndef HLSL
+#include <cstdint>
+
+namespace Sampling {
+
+typedef std::uint32_t uint;
+#endif
+
+enum SamplerType
+{
+  RandomSampler = 0, // xorshift reseeded at every bounce, the original generator
+  SobolSampler = 1,
+  BlueNoiseSampler = 2,
+};
+
+// Dimensions between two ComputeRngSeed calls, a bounce draws fewer than this.
+static const uint SAMPLER_DIMENSIONS_PER_SEED = 16;
+
+// Samples per pixel the blue noise sampler stratifies as one chunk, later samples
+// start another pass over the sequence with new seeds.
+static const uint BLUE_NOISE_SAMPLE_BITS = 8;
+
+// Direction numbers of the first four Sobol dimensions (Joe and Kuo), one row of 32 bits each.
+static const uint c_sobolDirections[128] =
+{
+  0x80000000u, 0x40000000u, 0x20000000u, 0x10000000u, 0x08000000u, 0x04000000u, 0x02000000u, 0x01000000u,
+  0x00800000u, 0x00400000u, 0x00200000u, 0x00100000u, 0x00080000u, 0x00040000u, 0x00020000u, 0x00010000u,
+  0x00008000u, 0x00004000u, 0x00002000u, 0x00001000u, 0x00000800u, 0x00000400u, 0x00000200u, 0x00000100u,
+  0x00000080u, 0x00000040u, 0x00000020u, 0x00000010u, 0x00000008u, 0x00000004u, 0x00000002u, 0x00000001u,
+
+  0x80000000u, 0xc0000000u, 0xa0000000u, 0xf0000000u, 0x88000000u, 0xcc000000u, 0xaa000000u, 0xff000000u,
+  0x80800000u, 0xc0c00000u, 0xa0a00000u, 0xf0f00000u, 0x88880000u, 0xcccc0000u, 0xaaaa0000u, 0xffff0000u,
+  0x80008000u, 0xc000c000u, 0xa000a000u, 0xf000f000u, 0x88008800u, 0xcc00cc00u, 0xaa00aa00u, 0xff00ff00u,
+  0x80808080u, 0xc0c0c0c0u, 0xa0a0a0a0u, 0xf0f0f0f0u, 0x88888888u, 0xccccccccu, 0xaaaaaaaau, 0xffffffffu,
+
+  0x80000000u, 0xc0000000u, 0x60000000u, 0x90000000u, 0xe8000000u, 0x5c000000u, 0x8e000000u, 0xc5000000u,
+  0x68800000u, 0x9cc00000u, 0xee600000u, 0x55900000u, 0x80680000u, 0xc09c0000u, 0x60ee0000u, 0x90550000u,
+  0xe8808000u, 0x5cc0c000u, 0x8e606000u, 0xc5909000u, 0x6868e800u, 0x9c9c5c00u, 0xeeee8e00u, 0x5555c500u,
+  0x8000e880u, 0xc0005cc0u, 0x60008e60u, 0x9000c590u, 0xe8006868u, 0x5c009c9cu, 0x8e00eeeeu, 0xc5005555u,
+
+  0x80000000u, 0xc0000000u, 0x20000000u, 0x50000000u, 0xf8000000u, 0x74000000u, 0xa2000000u, 0x93000000u,
+  0xd8800000u, 0x25400000u, 0x59e00000u, 0xe6d00000u, 0x78080000u, 0xb40c0000u, 0x82020000u, 0xc3050000u,
+  0x208f8000u, 0x51474000u, 0xfbea2000u, 0x75d93000u, 0xa0858800u, 0x914e5400u, 0xdbe79e00u, 0x25db6d00u,
+  0x58800080u, 0xe54000c0u, 0x79e00020u, 0xb6d00050u, 0x800800f8u, 0xc00c0074u, 0x200200a2u, 0x50050093u,
+};
+
+// The 24 orders of the four quadrants of a quadtree node, 2 bits per quadrant.
+static const uint c_quadrantPermutations[24] =
+{
+  0xe4u, 0xb4u, 0xd8u, 0x78u, 0x9cu, 0x6cu, 0xe1u, 0xb1u, 0xc9u, 0x39u, 0x8du, 0x2du,
+  0xd2u, 0x72u, 0xc6u, 0x36u, 0x4eu, 0x1eu, 0x93u, 0x63u, 0x87u, 0x27u, 0x4bu, 0x1bu,
+};
+
+#ifdef HLSL
+uint SamplerReverseBits(uint x)
+{
+  return reversebits(x);
+}
+#else
+inline uint SamplerReverseBits(uint x)
+{
+  x = (x << 16) | (x >> 16);
+  x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+  x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+  x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+  x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+  return x;
+}
+#endif
+
+// lowbias32 by Chris Wellons
+inline uint SamplerHash(uint x)
+{
+  x ^= x >> 16;
+  x *= 0x7feb352du;
+  x ^= x >> 15;
+  x *= 0x846ca68bu;
+  x ^= x >> 16;
+  return x;
+}
+
+inline uint SamplerHashCombine(uint seed, uint value)
+{
+  return seed ^ (value + 0x9e3779b9u + (seed << 6) + (seed >> 2));
+}
+
+// [0, 1) from the top 24 bits, so the result never rounds up to 1.
+inline float SamplerToFloat(uint x)
+{
+  return float(x >> 8) * (1.0f / 16777216.0f);
+}
+
+// Point index of one of the first four Sobol dimensions.
+inline uint Sobol(uint index, uint dimension)
+{
+  uint x = 0;
+  uint bit = 0;
+  while (index != 0)
+  {
+    if ((index & 1u) != 0)
+    {
+      x ^= c_sobolDirections[dimension * 32 + bit];
+    }
+    index >>= 1;
+    bit++;
+  }
+  return x;
+}
+
+// Owen scrambling with the Laine-Karras hash as improved by Burley, every bit is
+// flipped depending on all the bits above it.
+inline uint NestedUniformScramble(uint x, uint seed)
+{
+  x = SamplerReverseBits(x);
+  x += seed;
+  x ^= x * 0x6c50b47cu;
+  x ^= x * 0xb82f1e52u;
+  x ^= x * 0xc7afe638u;
+  x ^= x * 0x8d22f6e6u;
+  return SamplerReverseBits(x);
+}
+
+inline float SobolOwen(uint index, uint dimension, uint seed)
+{
+  uint setSeed = SamplerHashCombine(seed, SamplerHash(dimension / 4));
+  uint shuffled = NestedUniformScramble(index, setSeed);
+  uint x = Sobol(shuffled, dimension % 4);
+  return SamplerToFloat(NestedUniformScramble(x, SamplerHashCombine(setSeed, dimension % 4)));
+}
+
+// Morton code of the low 12 bits of a pixel, the quadrants of every quadtree node in a
+// random order of their own. Nearby pixels still get nearby codes.
+inline uint ScrambledMorton(uint x, uint y, uint seed)
+{
+  uint code = 0;
+  for (int level = 11; level >= 0; level--)
+  {
+    uint digit = ((x >> level) & 1u) | (((y >> level) & 1u) << 1);
+    uint node = code | (1u << (2 * (11 - level))); // the leading one tells the levels apart
+    uint permutation = c_quadrantPermutations[SamplerHash(SamplerHashCombine(seed, node)) % 24];
+    code = (code << 2) | ((permutation >> (2 * digit)) & 3u);
+  }
+  return code;
+}
+
+inline float BlueNoiseSobol(uint pixelX, uint pixelY, uint sampleIndex, uint dimension)
+{
+  uint pass = sampleIndex >> BLUE_NOISE_SAMPLE_BITS;
+  uint setSeed = SamplerHashCombine(SamplerHash(dimension / 4), pass);
+  uint index = (ScrambledMorton(pixelX, pixelY, setSeed) << BLUE_NOISE_SAMPLE_BITS) | (sampleIndex & ((1u << BLUE_NOISE_SAMPLE_BITS) - 1u));
+  uint x = Sobol(index, dimension % 4);
+  return SamplerToFloat(NestedUniformScramble(x, SamplerHashCombine(setSeed, dimension % 4)));
+}
+
+// Random number in [0, 1) for one dimension of sample sampleIndex (from 0) of a pixel.
+// RandomSampler returns hashed white noise here, the renderers keep their xorshift for it.
+inline float SampleDimension(uint sampler, uint pixelX, uint pixelY, uint sampleIndex, uint dimension)
+{
+  uint pixelSeed = SamplerHash(pixelX ^ SamplerHash(pixelY));
+  if (sampler == SobolSampler)
+  {
+    return SobolOwen(sampleIndex, dimension, pixelSeed);
+  }
+  if (sampler == BlueNoiseSampler)
+  {
+    return BlueNoiseSobol(pixelX, pixelY, sampleIndex, dimension);
+  }
+  return SamplerToFloat(SamplerHash(SamplerHashCombine(SamplerHashCombine(pixelSeed, sampleIndex), dimension)));
+}
+
+#ifndef HLSL
+}
+#endif
+
+#endif // SAMPLINGHLSLCOMPAT_H
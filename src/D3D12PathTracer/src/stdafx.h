@@ -55,6 +55,7 @@
 #endif
 
 #include "DXSampleHelper.h"
+#include "FrameFenceRing.h"
 #include "DeviceResources.h"
 
 #include "imgui/imgui.h"